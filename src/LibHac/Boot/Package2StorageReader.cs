@@ -167,7 +167,7 @@ public class Package2StorageReader : IDisposable
         {
             byte[] array = buffer.Array;
             var hashBuffer = new Buffer32();
-            var sha = new Sha256Generator();
+            using var sha = new Sha256Generator();
 
             // Verify hashes match for all payloads.
             for (int i = 0; i < Package2Header.PayloadCount; i++)
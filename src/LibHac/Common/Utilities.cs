@@ -1,7 +1,9 @@
 using System;
 using System.IO;
 using System.Numerics;
+using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
 using System.Text;
 
 namespace LibHac.Common;
@@ -40,14 +42,65 @@ public static class Utilities
     public static bool IsZeros(this byte[] array) => ((ReadOnlySpan<byte>)array).IsZeros();
     public static bool IsZeros(this Span<byte> span) => ((ReadOnlySpan<byte>)span).IsZeros();
 
+    /// <summary>
+    /// Checks if every byte in <paramref name="span"/> is zero.
+    /// </summary>
+    /// <remarks>Large spans are checked 128 bytes at a time by ORing together four vectors,
+    /// so all-zero data only needs one comparison per 128 bytes.</remarks>
     public static bool IsZeros(this ReadOnlySpan<byte> span)
     {
-        for (int i = 0; i < span.Length; i++)
+        ref byte start = ref MemoryMarshal.GetReference(span);
+        nuint length = (nuint)span.Length;
+        nuint i = 0;
+
+        if (Vector256.IsHardwareAccelerated && length >= (nuint)Vector256<byte>.Count)
         {
-            if (span[i] != 0)
+            nuint unrolledSize = (nuint)Vector256<byte>.Count * 4;
+
+            for (; i + unrolledSize <= length; i += unrolledSize)
             {
-                return false;
+                Vector256<byte> combined = Vector256.LoadUnsafe(ref start, i) |
+                                           Vector256.LoadUnsafe(ref start, i + (nuint)Vector256<byte>.Count) |
+                                           Vector256.LoadUnsafe(ref start, i + (nuint)Vector256<byte>.Count * 2) |
+                                           Vector256.LoadUnsafe(ref start, i + (nuint)Vector256<byte>.Count * 3);
+
+                if (combined != Vector256<byte>.Zero)
+                    return false;
+            }
+
+            for (; i + (nuint)Vector256<byte>.Count <= length; i += (nuint)Vector256<byte>.Count)
+            {
+                if (Vector256.LoadUnsafe(ref start, i) != Vector256<byte>.Zero)
+                    return false;
+            }
+
+            // Check the remaining bytes with a final vector that overlaps the previous one
+            return i == length ||
+                   Vector256.LoadUnsafe(ref start, length - (nuint)Vector256<byte>.Count) == Vector256<byte>.Zero;
+        }
+
+        if (Vector128.IsHardwareAccelerated && length >= (nuint)Vector128<byte>.Count)
+        {
+            for (; i + (nuint)Vector128<byte>.Count <= length; i += (nuint)Vector128<byte>.Count)
+            {
+                if (Vector128.LoadUnsafe(ref start, i) != Vector128<byte>.Zero)
+                    return false;
             }
+
+            return i == length ||
+                   Vector128.LoadUnsafe(ref start, length - (nuint)Vector128<byte>.Count) == Vector128<byte>.Zero;
+        }
+
+        for (; i + sizeof(ulong) <= length; i += sizeof(ulong))
+        {
+            if (Unsafe.ReadUnaligned<ulong>(ref Unsafe.Add(ref start, i)) != 0)
+                return false;
+        }
+
+        for (; i < length; i++)
+        {
+            if (Unsafe.Add(ref start, i) != 0)
+                return false;
         }
 
         return true;
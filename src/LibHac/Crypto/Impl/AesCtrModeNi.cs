@@ -23,6 +23,9 @@ public struct AesCtrModeNi
         Iv = Unsafe.ReadUnaligned<Vector128<byte>>(ref MemoryMarshal.GetReference(iv));
     }
 
+    // Tiered compilation can leave this loop running unoptimized code for a long time, which is
+    // an order of magnitude slower than the optimized version
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
     public int Transform(ReadOnlySpan<byte> input, Span<byte> output)
     {
         int length = Math.Min(input.Length, output.Length);
@@ -35,33 +38,29 @@ public struct AesCtrModeNi
         Vector128<byte> byteSwapMask = Vector128.Create(0x706050403020100ul, 0x8090A0B0C0D0E0Ful).AsByte();
         var inc = Vector128.Create(0ul, 1ul);
 
+        // Each counter in a batch of 8 is calculated from the batch's base counter
+        // so the additions don't depend on each other
+        var inc2 = Vector128.Create(0ul, 2ul);
+        var inc3 = Vector128.Create(0ul, 3ul);
+        var inc4 = Vector128.Create(0ul, 4ul);
+        var inc5 = Vector128.Create(0ul, 5ul);
+        var inc6 = Vector128.Create(0ul, 6ul);
+        var inc7 = Vector128.Create(0ul, 7ul);
+        var inc8 = Vector128.Create(0ul, 8ul);
+
         Vector128<byte> iv = Iv;
         Vector128<ulong> bSwappedIv = Ssse3.Shuffle(iv, byteSwapMask).AsUInt64();
 
         while (remaining >= 8 * Aes.BlockSize)
         {
             Vector128<byte> b0 = iv;
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b1 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b2 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b3 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b4 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b5 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b6 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
-
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
-            Vector128<byte> b7 = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
+            Vector128<byte> b1 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc).AsByte(), byteSwapMask);
+            Vector128<byte> b2 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc2).AsByte(), byteSwapMask);
+            Vector128<byte> b3 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc3).AsByte(), byteSwapMask);
+            Vector128<byte> b4 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc4).AsByte(), byteSwapMask);
+            Vector128<byte> b5 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc5).AsByte(), byteSwapMask);
+            Vector128<byte> b6 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc6).AsByte(), byteSwapMask);
+            Vector128<byte> b7 = Ssse3.Shuffle(Sse2.Add(bSwappedIv, inc7).AsByte(), byteSwapMask);
 
             _aesCore.EncryptBlocks8(b0, b1, b2, b3, b4, b5, b6, b7,
                 out b0, out b1, out b2, out b3, out b4, out b5, out b6, out b7);
@@ -76,7 +75,7 @@ public struct AesCtrModeNi
             Unsafe.Add(ref outBlock, 7) = Sse2.Xor(Unsafe.Add(ref inBlock, 7), b7);
 
             // Increase the counter
-            bSwappedIv = Sse2.Add(bSwappedIv, inc);
+            bSwappedIv = Sse2.Add(bSwappedIv, inc8);
             iv = Ssse3.Shuffle(bSwappedIv.AsByte(), byteSwapMask);
 
             inBlock = ref Unsafe.Add(ref inBlock, 8);
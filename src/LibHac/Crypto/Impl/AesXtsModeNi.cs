@@ -25,6 +25,9 @@ public struct AesXtsModeNi
         Iv = Unsafe.ReadUnaligned<Vector128<byte>>(ref MemoryMarshal.GetReference(iv));
     }
 
+    // Tiered compilation can leave these loops running unoptimized code for a long time, which is
+    // an order of magnitude slower than the optimized version
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
     public int Encrypt(ReadOnlySpan<byte> input, Span<byte> output)
     {
         int length = Math.Min(input.Length, output.Length);
@@ -40,6 +43,16 @@ public struct AesXtsModeNi
 
         Vector128<byte> tweak = _tweakAesCore.EncryptBlock(Iv);
 
+        if (Pclmulqdq.IsSupported && remainingBlocks > 7)
+        {
+            int processedBlocks = TransformBlocksParallelTweaks(ref inBlock, ref outBlock, ref tweak, mask,
+                remainingBlocks, false);
+
+            inBlock = ref Unsafe.Add(ref inBlock, processedBlocks);
+            outBlock = ref Unsafe.Add(ref outBlock, processedBlocks);
+            remainingBlocks -= processedBlocks;
+        }
+
         while (remainingBlocks > 7)
         {
             Vector128<byte> b0 = Sse2.Xor(tweak, Unsafe.Add(ref inBlock, 0));
@@ -105,6 +118,7 @@ public struct AesXtsModeNi
         return length;
     }
 
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
     public int Decrypt(ReadOnlySpan<byte> input, Span<byte> output)
     {
         int length = Math.Min(input.Length, output.Length);
@@ -122,6 +136,16 @@ public struct AesXtsModeNi
 
         Vector128<byte> tweak = _tweakAesCore.EncryptBlock(Iv);
 
+        if (Pclmulqdq.IsSupported && remainingBlocks > 7)
+        {
+            int processedBlocks = TransformBlocksParallelTweaks(ref inBlock, ref outBlock, ref tweak, mask,
+                remainingBlocks, true);
+
+            inBlock = ref Unsafe.Add(ref inBlock, processedBlocks);
+            outBlock = ref Unsafe.Add(ref outBlock, processedBlocks);
+            remainingBlocks -= processedBlocks;
+        }
+
         while (remainingBlocks > 7)
         {
             Vector128<byte> b0 = Sse2.Xor(tweak, Unsafe.Add(ref inBlock, 0));
@@ -187,6 +211,79 @@ public struct AesXtsModeNi
         return length;
     }
 
+    /// <summary>
+    /// Processes as many batches of 8 blocks as possible. Instead of deriving each tweak from the previous one,
+    /// each of the 8 tweaks is multiplied by x^8 to get its value for the next batch. This removes the
+    /// dependency chain between the tweaks, so they can be calculated in parallel.
+    /// </summary>
+    /// <returns>The number of blocks that were processed.</returns>
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    private readonly int TransformBlocksParallelTweaks(ref Vector128<byte> inBlock, ref Vector128<byte> outBlock,
+        ref Vector128<byte> tweak, Vector128<byte> mask, int blockCount, bool decrypting)
+    {
+        Debug.Assert(Pclmulqdq.IsSupported);
+
+        Vector128<byte> tweak0 = tweak;
+        Vector128<byte> tweak1 = Gf128Mul(tweak0, mask);
+        Vector128<byte> tweak2 = Gf128Mul(tweak1, mask);
+        Vector128<byte> tweak3 = Gf128Mul(tweak2, mask);
+        Vector128<byte> tweak4 = Gf128Mul(tweak3, mask);
+        Vector128<byte> tweak5 = Gf128Mul(tweak4, mask);
+        Vector128<byte> tweak6 = Gf128Mul(tweak5, mask);
+        Vector128<byte> tweak7 = Gf128Mul(tweak6, mask);
+
+        int processedBlocks = 0;
+
+        while (blockCount - processedBlocks > 7)
+        {
+            ref Vector128<byte> inBlocks = ref Unsafe.Add(ref inBlock, processedBlocks);
+            ref Vector128<byte> outBlocks = ref Unsafe.Add(ref outBlock, processedBlocks);
+
+            Vector128<byte> b0 = Sse2.Xor(tweak0, Unsafe.Add(ref inBlocks, 0));
+            Vector128<byte> b1 = Sse2.Xor(tweak1, Unsafe.Add(ref inBlocks, 1));
+            Vector128<byte> b2 = Sse2.Xor(tweak2, Unsafe.Add(ref inBlocks, 2));
+            Vector128<byte> b3 = Sse2.Xor(tweak3, Unsafe.Add(ref inBlocks, 3));
+            Vector128<byte> b4 = Sse2.Xor(tweak4, Unsafe.Add(ref inBlocks, 4));
+            Vector128<byte> b5 = Sse2.Xor(tweak5, Unsafe.Add(ref inBlocks, 5));
+            Vector128<byte> b6 = Sse2.Xor(tweak6, Unsafe.Add(ref inBlocks, 6));
+            Vector128<byte> b7 = Sse2.Xor(tweak7, Unsafe.Add(ref inBlocks, 7));
+
+            if (decrypting)
+            {
+                _dataAesCore.DecryptBlocks8(b0, b1, b2, b3, b4, b5, b6, b7,
+                    out b0, out b1, out b2, out b3, out b4, out b5, out b6, out b7);
+            }
+            else
+            {
+                _dataAesCore.EncryptBlocks8(b0, b1, b2, b3, b4, b5, b6, b7,
+                    out b0, out b1, out b2, out b3, out b4, out b5, out b6, out b7);
+            }
+
+            Unsafe.Add(ref outBlocks, 0) = Sse2.Xor(tweak0, b0);
+            Unsafe.Add(ref outBlocks, 1) = Sse2.Xor(tweak1, b1);
+            Unsafe.Add(ref outBlocks, 2) = Sse2.Xor(tweak2, b2);
+            Unsafe.Add(ref outBlocks, 3) = Sse2.Xor(tweak3, b3);
+            Unsafe.Add(ref outBlocks, 4) = Sse2.Xor(tweak4, b4);
+            Unsafe.Add(ref outBlocks, 5) = Sse2.Xor(tweak5, b5);
+            Unsafe.Add(ref outBlocks, 6) = Sse2.Xor(tweak6, b6);
+            Unsafe.Add(ref outBlocks, 7) = Sse2.Xor(tweak7, b7);
+
+            tweak0 = Gf128MulX8(tweak0);
+            tweak1 = Gf128MulX8(tweak1);
+            tweak2 = Gf128MulX8(tweak2);
+            tweak3 = Gf128MulX8(tweak3);
+            tweak4 = Gf128MulX8(tweak4);
+            tweak5 = Gf128MulX8(tweak5);
+            tweak6 = Gf128MulX8(tweak6);
+            tweak7 = Gf128MulX8(tweak7);
+
+            processedBlocks += 8;
+        }
+
+        tweak = tweak0;
+        return processedBlocks;
+    }
+
     // ReSharper disable once RedundantAssignment
     private void DecryptPartialFinalBlock(ref Vector128<byte> input, ref Vector128<byte> output,
         Vector128<byte> tweak, Vector128<byte> mask, int finalBlockLength)
@@ -255,4 +352,18 @@ public struct AesXtsModeNi
 
         return Sse2.Xor(tmp1, tmp2);
     }
+
+    /// <summary>
+    /// Multiplies a tweak by x^8. The tweak is shifted left by a byte and
+    /// the byte that was shifted out is reduced with a carry-less multiply.
+    /// </summary>
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static Vector128<byte> Gf128MulX8(Vector128<byte> tweak)
+    {
+        Vector128<byte> shifted = Sse2.ShiftLeftLogical128BitLane(tweak, 1);
+        Vector128<ulong> carry = Sse2.ShiftRightLogical128BitLane(tweak, 15).AsUInt64();
+        Vector128<ulong> reduced = Pclmulqdq.CarrylessMultiply(carry, Vector128.CreateScalar(0x87ul), 0x00);
+
+        return Sse2.Xor(shifted, reduced.AsByte());
+    }
 }
\ No newline at end of file
@@ -1,38 +1,44 @@
 ﻿using System;
 using System.Diagnostics;
 using System.Security.Cryptography;
-using LibHac.Common;
+using LibHac.Common.FixedArrays;
 
 namespace LibHac.Crypto.Impl;
 
-public struct Sha256Impl
+public struct Sha256Impl : IDisposable
 {
-    private SHA256 _baseHash;
+    private IncrementalHash _baseHash;
     private HashState _state;
+    private Array32<byte> _hash;
 
     public void Initialize()
     {
         if (_state == HashState.Initial)
         {
-            _baseHash = SHA256.Create();
+            _baseHash = IncrementalHash.CreateHash(HashAlgorithmName.SHA256);
         }
-        else
+        else if (_state == HashState.Initialized)
         {
-            _baseHash.Initialize();
+            // Discard any data that has already been added to the hash
+            Span<byte> discardedHash = stackalloc byte[Sha256.DigestSize];
+            _baseHash.GetHashAndReset(discardedHash);
         }
 
         _state = HashState.Initialized;
     }
 
+    public void Dispose()
+    {
+        _baseHash?.Dispose();
+        _baseHash = null;
+        _state = HashState.Initial;
+    }
+
     public void Update(ReadOnlySpan<byte> data)
     {
         Debug.Assert(_state == HashState.Initialized);
 
-        using var rented = new RentedArray<byte>(data.Length);
-
-        data.CopyTo(rented.Span);
-
-        _baseHash.TransformBlock(rented.Array, 0, data.Length, null, 0);
+        _baseHash.AppendData(data);
     }
 
     public void GetHash(Span<byte> hashBuffer)
@@ -42,10 +48,10 @@ public struct Sha256Impl
 
         if (_state == HashState.Initialized)
         {
-            _baseHash.TransformFinalBlock(new byte[0], 0, 0);
+            _baseHash.GetHashAndReset(_hash);
             _state = HashState.Done;
         }
 
-        _baseHash.Hash.CopyTo(hashBuffer);
+        _hash[..].CopyTo(hashBuffer);
     }
-}
\ No newline at end of file
+}
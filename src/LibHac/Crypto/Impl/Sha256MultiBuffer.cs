@@ -0,0 +1,453 @@
+﻿using System;
+using System.Buffers.Binary;
+using System.Diagnostics;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.X86;
+
+namespace LibHac.Crypto.Impl;
+
+/// <summary>
+/// Calculates the SHA-256 hashes of multiple equal-length messages at once by processing
+/// each message in a separate 32-bit lane of a vector register.
+/// </summary>
+/// <remarks>Message <c>i</c> consists of an optional prefix shared by every message followed by
+/// the <c>i</c>th block of the input data. All of the data for each message's final padded
+/// chunks is assembled in a small stack buffer, so no allocations are done.
+/// The kernels skip tiered compilation because unoptimized vector code is several times slower
+/// than scalar hashing and the long-running loops may never be promoted.</remarks>
+public static class Sha256MultiBuffer
+{
+    private const int ChunkSize = 0x40;
+    private const int WordCount = ChunkSize / sizeof(uint);
+
+    public static bool IsAvx2Supported => Avx2.IsSupported;
+    public static bool IsSsse3Supported => Ssse3.IsSupported;
+
+    private static ReadOnlySpan<uint> InitialState =>
+    [
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    ];
+
+    private static ReadOnlySpan<uint> RoundConstants =>
+    [
+        0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+        0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+        0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+        0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+        0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+        0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+        0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+        0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+    ];
+
+    /// <summary>
+    /// Hashes 8 consecutive <paramref name="blockSize"/>-byte blocks of <paramref name="data"/> using AVX2.
+    /// </summary>
+    /// <param name="prefix">Data that is hashed before each block. May be empty.</param>
+    /// <param name="data">The data to hash. Must be at least 8 blocks long.</param>
+    /// <param name="blockSize">The size of each block.</param>
+    /// <param name="hashBuffer">The buffer that will receive the 8 hashes.</param>
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    public static void HashEightAvx2(ReadOnlySpan<byte> prefix, ReadOnlySpan<byte> data, int blockSize,
+        Span<byte> hashBuffer)
+    {
+        const int laneCount = 8;
+
+        Debug.Assert(Avx2.IsSupported);
+        Debug.Assert(blockSize > 0);
+        Debug.Assert(data.Length >= blockSize * laneCount);
+        Debug.Assert(hashBuffer.Length >= Sha256.DigestSize * laneCount);
+
+        long messageSize = (long)prefix.Length + blockSize;
+        int chunkCount = GetChunkCount(messageSize);
+
+        Span<Vector256<uint>> state = stackalloc Vector256<uint>[8];
+        Span<Vector256<uint>> schedule = stackalloc Vector256<uint>[WordCount];
+        Span<byte> chunkBuffer = stackalloc byte[ChunkSize * laneCount];
+
+        for (int i = 0; i < state.Length; i++)
+        {
+            state[i] = Vector256.Create(InitialState[i]);
+        }
+
+        ref byte dataRef = ref MemoryMarshal.GetReference(data);
+
+        for (int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            long dataOffset = (long)chunk * ChunkSize - prefix.Length;
+
+            if (dataOffset >= 0 && dataOffset + ChunkSize <= blockSize)
+            {
+                LoadScheduleAvx2(schedule, ref Unsafe.Add(ref dataRef, (nint)dataOffset), blockSize);
+            }
+            else
+            {
+                for (int lane = 0; lane < laneCount; lane++)
+                {
+                    FillChunk(chunkBuffer.Slice(lane * ChunkSize, ChunkSize), prefix,
+                        data.Slice(lane * blockSize, blockSize), chunk, chunkCount);
+                }
+
+                LoadScheduleAvx2(schedule, ref MemoryMarshal.GetReference(chunkBuffer), ChunkSize);
+            }
+
+            Compress(state, schedule);
+        }
+
+        Transpose8Avx2(state);
+
+        Vector256<byte> byteSwapMask = GetByteSwapMask256();
+
+        for (int lane = 0; lane < laneCount; lane++)
+        {
+            Vector256<byte> hash = Avx2.Shuffle(state[lane].AsByte(), byteSwapMask);
+            hash.StoreUnsafe(ref MemoryMarshal.GetReference(hashBuffer), (nuint)(lane * Sha256.DigestSize));
+        }
+    }
+
+    /// <summary>
+    /// Hashes 4 consecutive <paramref name="blockSize"/>-byte blocks of <paramref name="data"/> using SSSE3.
+    /// </summary>
+    /// <param name="prefix">Data that is hashed before each block. May be empty.</param>
+    /// <param name="data">The data to hash. Must be at least 4 blocks long.</param>
+    /// <param name="blockSize">The size of each block.</param>
+    /// <param name="hashBuffer">The buffer that will receive the 4 hashes.</param>
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    public static void HashFourSsse3(ReadOnlySpan<byte> prefix, ReadOnlySpan<byte> data, int blockSize,
+        Span<byte> hashBuffer)
+    {
+        const int laneCount = 4;
+
+        Debug.Assert(Ssse3.IsSupported);
+        Debug.Assert(blockSize > 0);
+        Debug.Assert(data.Length >= blockSize * laneCount);
+        Debug.Assert(hashBuffer.Length >= Sha256.DigestSize * laneCount);
+
+        long messageSize = (long)prefix.Length + blockSize;
+        int chunkCount = GetChunkCount(messageSize);
+
+        Span<Vector128<uint>> state = stackalloc Vector128<uint>[8];
+        Span<Vector128<uint>> schedule = stackalloc Vector128<uint>[WordCount];
+        Span<byte> chunkBuffer = stackalloc byte[ChunkSize * laneCount];
+
+        for (int i = 0; i < state.Length; i++)
+        {
+            state[i] = Vector128.Create(InitialState[i]);
+        }
+
+        ref byte dataRef = ref MemoryMarshal.GetReference(data);
+
+        for (int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            long dataOffset = (long)chunk * ChunkSize - prefix.Length;
+
+            if (dataOffset >= 0 && dataOffset + ChunkSize <= blockSize)
+            {
+                LoadScheduleSsse3(schedule, ref Unsafe.Add(ref dataRef, (nint)dataOffset), blockSize);
+            }
+            else
+            {
+                for (int lane = 0; lane < laneCount; lane++)
+                {
+                    FillChunk(chunkBuffer.Slice(lane * ChunkSize, ChunkSize), prefix,
+                        data.Slice(lane * blockSize, blockSize), chunk, chunkCount);
+                }
+
+                LoadScheduleSsse3(schedule, ref MemoryMarshal.GetReference(chunkBuffer), ChunkSize);
+            }
+
+            Compress(state, schedule);
+        }
+
+        Vector128<byte> byteSwapMask = GetByteSwapMask128();
+
+        // The state is stored as 8 vectors of 4 lanes. Transpose each half separately.
+        for (int half = 0; half < 2; half++)
+        {
+            Span<Vector128<uint>> words = state.Slice(half * 4, 4);
+            Transpose4(words);
+
+            for (int lane = 0; lane < laneCount; lane++)
+            {
+                Vector128<byte> hashHalf = Ssse3.Shuffle(words[lane].AsByte(), byteSwapMask);
+                hashHalf.StoreUnsafe(ref MemoryMarshal.GetReference(hashBuffer),
+                    (nuint)(lane * Sha256.DigestSize + half * Vector128<byte>.Count));
+            }
+        }
+    }
+
+    private static int GetChunkCount(long messageSize)
+    {
+        // Each message is followed by a 0x80 byte and the 8-byte message length
+        return (int)((messageSize + 1 + sizeof(ulong) + ChunkSize - 1) / ChunkSize);
+    }
+
+    /// <summary>
+    /// Builds a chunk of a padded message for chunks that contain any prefix or padding bytes.
+    /// </summary>
+    private static void FillChunk(Span<byte> destination, ReadOnlySpan<byte> prefix, ReadOnlySpan<byte> block,
+        int chunkIndex, int chunkCount)
+    {
+        long messageSize = (long)prefix.Length + block.Length;
+        long chunkStart = (long)chunkIndex * ChunkSize;
+
+        destination.Clear();
+
+        for (int i = 0; i < ChunkSize; i++)
+        {
+            long position = chunkStart + i;
+
+            if (position < prefix.Length)
+            {
+                destination[i] = prefix[(int)position];
+            }
+            else if (position < messageSize)
+            {
+                destination[i] = block[(int)(position - prefix.Length)];
+            }
+            else
+            {
+                if (position == messageSize)
+                    destination[i] = 0x80;
+
+                break;
+            }
+        }
+
+        if (chunkIndex == chunkCount - 1)
+        {
+            BinaryPrimitives.WriteUInt64BigEndian(destination.Slice(ChunkSize - sizeof(ulong)),
+                (ulong)messageSize * 8);
+        }
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    private static void LoadScheduleAvx2(Span<Vector256<uint>> schedule, ref byte source, int laneStride)
+    {
+        Vector256<byte> byteSwapMask = GetByteSwapMask256();
+        Span<Vector256<uint>> words = stackalloc Vector256<uint>[8];
+
+        for (int half = 0; half < 2; half++)
+        {
+            for (int lane = 0; lane < words.Length; lane++)
+            {
+                Vector256<byte> row = Vector256.LoadUnsafe(ref source, (nuint)(lane * laneStride + half * 32));
+                words[lane] = Avx2.Shuffle(row, byteSwapMask).AsUInt32();
+            }
+
+            Transpose8Avx2(words);
+            words.CopyTo(schedule.Slice(half * 8));
+        }
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    private static void LoadScheduleSsse3(Span<Vector128<uint>> schedule, ref byte source, int laneStride)
+    {
+        Vector128<byte> byteSwapMask = GetByteSwapMask128();
+
+        for (int quarter = 0; quarter < 4; quarter++)
+        {
+            Span<Vector128<uint>> words = schedule.Slice(quarter * 4, 4);
+
+            for (int lane = 0; lane < words.Length; lane++)
+            {
+                Vector128<byte> row = Vector128.LoadUnsafe(ref source, (nuint)(lane * laneStride + quarter * 16));
+                words[lane] = Ssse3.Shuffle(row, byteSwapMask).AsUInt32();
+            }
+
+            Transpose4(words);
+        }
+    }
+
+    private static Vector256<byte> GetByteSwapMask256()
+    {
+        return Vector256.Create(0x0405060700010203, 0x0C0D0E0F08090A0B, 0x0405060700010203, 0x0C0D0E0F08090A0B)
+            .AsByte();
+    }
+
+    private static Vector128<byte> GetByteSwapMask128()
+    {
+        return Vector128.Create(0x0405060700010203, 0x0C0D0E0F08090A0B).AsByte();
+    }
+
+    /// <summary>
+    /// Transposes an 8x8 matrix of 32-bit values so that row <c>i</c> holds column <c>i</c> of the input.
+    /// </summary>
+    private static void Transpose8Avx2(Span<Vector256<uint>> rows)
+    {
+        Vector256<uint> t0 = Avx2.UnpackLow(rows[0], rows[1]);
+        Vector256<uint> t1 = Avx2.UnpackHigh(rows[0], rows[1]);
+        Vector256<uint> t2 = Avx2.UnpackLow(rows[2], rows[3]);
+        Vector256<uint> t3 = Avx2.UnpackHigh(rows[2], rows[3]);
+        Vector256<uint> t4 = Avx2.UnpackLow(rows[4], rows[5]);
+        Vector256<uint> t5 = Avx2.UnpackHigh(rows[4], rows[5]);
+        Vector256<uint> t6 = Avx2.UnpackLow(rows[6], rows[7]);
+        Vector256<uint> t7 = Avx2.UnpackHigh(rows[6], rows[7]);
+
+        Vector256<uint> u0 = Avx2.UnpackLow(t0.AsUInt64(), t2.AsUInt64()).AsUInt32();
+        Vector256<uint> u1 = Avx2.UnpackHigh(t0.AsUInt64(), t2.AsUInt64()).AsUInt32();
+        Vector256<uint> u2 = Avx2.UnpackLow(t1.AsUInt64(), t3.AsUInt64()).AsUInt32();
+        Vector256<uint> u3 = Avx2.UnpackHigh(t1.AsUInt64(), t3.AsUInt64()).AsUInt32();
+        Vector256<uint> u4 = Avx2.UnpackLow(t4.AsUInt64(), t6.AsUInt64()).AsUInt32();
+        Vector256<uint> u5 = Avx2.UnpackHigh(t4.AsUInt64(), t6.AsUInt64()).AsUInt32();
+        Vector256<uint> u6 = Avx2.UnpackLow(t5.AsUInt64(), t7.AsUInt64()).AsUInt32();
+        Vector256<uint> u7 = Avx2.UnpackHigh(t5.AsUInt64(), t7.AsUInt64()).AsUInt32();
+
+        rows[0] = Avx2.Permute2x128(u0, u4, 0x20);
+        rows[1] = Avx2.Permute2x128(u1, u5, 0x20);
+        rows[2] = Avx2.Permute2x128(u2, u6, 0x20);
+        rows[3] = Avx2.Permute2x128(u3, u7, 0x20);
+        rows[4] = Avx2.Permute2x128(u0, u4, 0x31);
+        rows[5] = Avx2.Permute2x128(u1, u5, 0x31);
+        rows[6] = Avx2.Permute2x128(u2, u6, 0x31);
+        rows[7] = Avx2.Permute2x128(u3, u7, 0x31);
+    }
+
+    /// <summary>
+    /// Transposes a 4x4 matrix of 32-bit values so that row <c>i</c> holds column <c>i</c> of the input.
+    /// </summary>
+    private static void Transpose4(Span<Vector128<uint>> rows)
+    {
+        Vector128<uint> t0 = Sse2.UnpackLow(rows[0], rows[1]);
+        Vector128<uint> t1 = Sse2.UnpackHigh(rows[0], rows[1]);
+        Vector128<uint> t2 = Sse2.UnpackLow(rows[2], rows[3]);
+        Vector128<uint> t3 = Sse2.UnpackHigh(rows[2], rows[3]);
+
+        rows[0] = Sse2.UnpackLow(t0.AsUInt64(), t2.AsUInt64()).AsUInt32();
+        rows[1] = Sse2.UnpackHigh(t0.AsUInt64(), t2.AsUInt64()).AsUInt32();
+        rows[2] = Sse2.UnpackLow(t1.AsUInt64(), t3.AsUInt64()).AsUInt32();
+        rows[3] = Sse2.UnpackHigh(t1.AsUInt64(), t3.AsUInt64()).AsUInt32();
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    private static void Compress(Span<Vector256<uint>> state, Span<Vector256<uint>> w)
+    {
+        Vector256<uint> a = state[0];
+        Vector256<uint> b = state[1];
+        Vector256<uint> c = state[2];
+        Vector256<uint> d = state[3];
+        Vector256<uint> e = state[4];
+        Vector256<uint> f = state[5];
+        Vector256<uint> g = state[6];
+        Vector256<uint> h = state[7];
+
+        ref Vector256<uint> wRef = ref MemoryMarshal.GetReference(w);
+        ReadOnlySpan<uint> k = RoundConstants;
+
+        for (int t = 0; t < 64; t++)
+        {
+            ref Vector256<uint> wt = ref Unsafe.Add(ref wRef, t & 15);
+
+            if (t >= 16)
+            {
+                Vector256<uint> w2 = Unsafe.Add(ref wRef, (t - 2) & 15);
+                Vector256<uint> w7 = Unsafe.Add(ref wRef, (t - 7) & 15);
+                Vector256<uint> w15 = Unsafe.Add(ref wRef, (t - 15) & 15);
+
+                Vector256<uint> s0 = Rotr(w15, 7) ^ Rotr(w15, 18) ^ (w15 >>> 3);
+                Vector256<uint> s1 = Rotr(w2, 17) ^ Rotr(w2, 19) ^ (w2 >>> 10);
+
+                wt = wt + s0 + w7 + s1;
+            }
+
+            Vector256<uint> sigma1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+            Vector256<uint> ch = Vector256.ConditionalSelect(e, f, g);
+            Vector256<uint> t1 = h + sigma1 + ch + Vector256.Create(k[t]) + wt;
+
+            Vector256<uint> sigma0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+            Vector256<uint> maj = (a & b) | (c & (a | b));
+            Vector256<uint> t2 = sigma0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    private static void Compress(Span<Vector128<uint>> state, Span<Vector128<uint>> w)
+    {
+        Vector128<uint> a = state[0];
+        Vector128<uint> b = state[1];
+        Vector128<uint> c = state[2];
+        Vector128<uint> d = state[3];
+        Vector128<uint> e = state[4];
+        Vector128<uint> f = state[5];
+        Vector128<uint> g = state[6];
+        Vector128<uint> h = state[7];
+
+        ref Vector128<uint> wRef = ref MemoryMarshal.GetReference(w);
+        ReadOnlySpan<uint> k = RoundConstants;
+
+        for (int t = 0; t < 64; t++)
+        {
+            ref Vector128<uint> wt = ref Unsafe.Add(ref wRef, t & 15);
+
+            if (t >= 16)
+            {
+                Vector128<uint> w2 = Unsafe.Add(ref wRef, (t - 2) & 15);
+                Vector128<uint> w7 = Unsafe.Add(ref wRef, (t - 7) & 15);
+                Vector128<uint> w15 = Unsafe.Add(ref wRef, (t - 15) & 15);
+
+                Vector128<uint> s0 = Rotr(w15, 7) ^ Rotr(w15, 18) ^ (w15 >>> 3);
+                Vector128<uint> s1 = Rotr(w2, 17) ^ Rotr(w2, 19) ^ (w2 >>> 10);
+
+                wt = wt + s0 + w7 + s1;
+            }
+
+            Vector128<uint> sigma1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+            Vector128<uint> ch = Vector128.ConditionalSelect(e, f, g);
+            Vector128<uint> t1 = h + sigma1 + ch + Vector128.Create(k[t]) + wt;
+
+            Vector128<uint> sigma0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+            Vector128<uint> maj = (a & b) | (c & (a | b));
+            Vector128<uint> t2 = sigma0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static Vector256<uint> Rotr(Vector256<uint> value, int count)
+    {
+        return (value >>> count) | (value << (32 - count));
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static Vector128<uint> Rotr(Vector128<uint> value, int count)
+    {
+        return (value >>> count) | (value << (32 - count));
+    }
+}
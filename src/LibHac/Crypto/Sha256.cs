@@ -1,5 +1,9 @@
 ﻿using System;
+using System.Runtime.Intrinsics.X86;
+using System.Security.Cryptography;
 using LibHac.Crypto.Impl;
+using LibHac.Diag;
+using LibHac.Util;
 
 namespace LibHac.Crypto;
 
@@ -7,6 +11,8 @@ public static class Sha256
 {
     public const int DigestSize = 0x20;
 
+    private static readonly bool IsShaNiSupportedValue = GetShaNiSupport();
+
     /// <summary>
     /// Creates an uninitialized SHA-256 <see cref="IHash"/> object.
     /// </summary>
@@ -18,10 +24,114 @@ public static class Sha256
 
     public static void GenerateSha256Hash(ReadOnlySpan<byte> data, Span<byte> hashBuffer)
     {
-        var sha256 = new Sha256Impl();
-        sha256.Initialize();
+        SHA256.HashData(data, hashBuffer);
+    }
+
+    /// <summary>
+    /// Returns <see langword="true"/> if the CPU has the SHA extensions. The platform's
+    /// SHA-256 implementation will use them for single-buffer hashing when available.
+    /// </summary>
+    public static bool IsShaNiSupported() => IsShaNiSupportedValue;
+
+    /// <summary>
+    /// Returns <see langword="true"/> if <see cref="GenerateSha256Hashes(ReadOnlySpan{byte},ReadOnlySpan{byte},int,Span{byte},bool)"/>
+    /// will hash multiple blocks at once by default. Multi-buffer hashing is only preferred on CPUs with AVX2
+    /// but without the SHA extensions.
+    /// </summary>
+    public static bool IsMultiBufferPreferred() => Sha256MultiBuffer.IsAvx2Supported && !IsShaNiSupported();
+
+    /// <summary>
+    /// Splits <paramref name="data"/> into blocks of <paramref name="blockSize"/> bytes and calculates
+    /// the SHA-256 hash of each one.
+    /// </summary>
+    /// <param name="data">The data to hash. The final block may be smaller than <paramref name="blockSize"/>.</param>
+    /// <param name="blockSize">The size of each block.</param>
+    /// <param name="hashBuffer">The buffer that will receive the hashes of each block.</param>
+    public static void GenerateSha256Hashes(ReadOnlySpan<byte> data, int blockSize, Span<byte> hashBuffer)
+    {
+        GenerateSha256Hashes(ReadOnlySpan<byte>.Empty, data, blockSize, hashBuffer, IsMultiBufferPreferred());
+    }
+
+    /// <summary>
+    /// Splits <paramref name="data"/> into blocks of <paramref name="blockSize"/> bytes and calculates
+    /// the SHA-256 hash of <paramref name="prefix"/> followed by each block.
+    /// </summary>
+    /// <param name="prefix">Data that is hashed before each block, such as a salt. May be empty.</param>
+    /// <param name="data">The data to hash. The final block may be smaller than <paramref name="blockSize"/>.</param>
+    /// <param name="blockSize">The size of each block.</param>
+    /// <param name="hashBuffer">The buffer that will receive the hashes of each block.</param>
+    /// <param name="useMultiBuffer">If <see langword="true"/>, hash 8 or 4 full blocks at a time
+    /// when supported by the CPU.</param>
+    public static void GenerateSha256Hashes(ReadOnlySpan<byte> prefix, ReadOnlySpan<byte> data, int blockSize,
+        Span<byte> hashBuffer, bool useMultiBuffer)
+    {
+        Assert.SdkRequiresGreater(blockSize, 0);
+
+        int blockCount = (int)BitUtil.DivideUp(data.Length, blockSize);
+        int fullBlockCount = data.Length / blockSize;
+
+        Assert.SdkRequiresGreaterEqual(hashBuffer.Length, blockCount * DigestSize);
+
+        int hashedCount = 0;
+
+        if (useMultiBuffer && Sha256MultiBuffer.IsAvx2Supported)
+        {
+            while (fullBlockCount - hashedCount >= 8)
+            {
+                Sha256MultiBuffer.HashEightAvx2(prefix, data.Slice(hashedCount * blockSize), blockSize,
+                    hashBuffer.Slice(hashedCount * DigestSize));
+
+                hashedCount += 8;
+            }
+        }
+
+        if (useMultiBuffer && Sha256MultiBuffer.IsSsse3Supported)
+        {
+            while (fullBlockCount - hashedCount >= 4)
+            {
+                Sha256MultiBuffer.HashFourSsse3(prefix, data.Slice(hashedCount * blockSize), blockSize,
+                    hashBuffer.Slice(hashedCount * DigestSize));
+
+                hashedCount += 4;
+            }
+        }
+
+        if (hashedCount == blockCount)
+            return;
+
+        if (prefix.IsEmpty)
+        {
+            for (; hashedCount < blockCount; hashedCount++)
+            {
+                int offset = hashedCount * blockSize;
+                int size = Math.Min(blockSize, data.Length - offset);
+
+                SHA256.HashData(data.Slice(offset, size), hashBuffer.Slice(hashedCount * DigestSize, DigestSize));
+            }
+        }
+        else
+        {
+            using var hash = IncrementalHash.CreateHash(HashAlgorithmName.SHA256);
+
+            for (; hashedCount < blockCount; hashedCount++)
+            {
+                int offset = hashedCount * blockSize;
+                int size = Math.Min(blockSize, data.Length - offset);
+
+                hash.AppendData(prefix);
+                hash.AppendData(data.Slice(offset, size));
+                hash.GetHashAndReset(hashBuffer.Slice(hashedCount * DigestSize, DigestSize));
+            }
+        }
+    }
+
+    private static bool GetShaNiSupport()
+    {
+        if (!X86Base.IsSupported || X86Base.CpuId(0, 0).Eax < 7)
+            return false;
 
-        sha256.Update(data);
-        sha256.GetHash(hashBuffer);
+        // CPUID leaf 7, sub-leaf 0: EBX bit 29 indicates support for the SHA extensions
+        (int _, int ebx, int _, int _) = X86Base.CpuId(7, 0);
+        return (ebx & (1 << 29)) != 0;
     }
-}
\ No newline at end of file
+}
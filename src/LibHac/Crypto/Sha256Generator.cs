@@ -3,7 +3,7 @@ using LibHac.Crypto.Impl;
 
 namespace LibHac.Crypto;
 
-public class Sha256Generator : IHash
+public class Sha256Generator : IHash, IDisposable
 {
     public const int HashSize = Sha256.DigestSize;
 
@@ -28,4 +28,9 @@ public class Sha256Generator : IHash
     {
         _baseHash.GetHash(hashBuffer);
     }
+
+    public void Dispose()
+    {
+        _baseHash.Dispose();
+    }
 }
\ No newline at end of file
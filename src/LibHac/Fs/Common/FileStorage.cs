@@ -1,5 +1,7 @@
 ﻿using System;
 using System.Runtime.CompilerServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs.Fsa;
@@ -66,6 +68,32 @@ public class FileStorage : IStorage
         return _baseFile.Read(out _, offset, destination, ReadOption.None);
     }
 
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (destination.Length == 0)
+            return new ValueTask<Result>(Result.Success);
+
+        Result res = UpdateSize();
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        res = CheckAccessRange(offset, destination.Length, _fileSize);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        ValueTask<(Result Result, long BytesRead)> readTask =
+            _baseFile.ReadAsync(offset, destination, ReadOption.None, cancellationToken);
+
+        if (readTask.IsCompletedSuccessfully)
+            return new ValueTask<Result>(readTask.Result.Result);
+
+        return AwaitRead(readTask);
+
+        static async ValueTask<Result> AwaitRead(ValueTask<(Result Result, long BytesRead)> task)
+        {
+            return (await task.ConfigureAwait(false)).Result;
+        }
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         if (source.Length == 0)
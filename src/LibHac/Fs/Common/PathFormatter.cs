@@ -387,6 +387,23 @@ public static class PathFormatter
 
     public static Result IsNormalized(out bool isNormalized, out int normalizedLength, ReadOnlySpan<byte> path,
         PathFlags flags)
+    {
+        // Simple paths are normalized no matter which flags are set
+        if (PathScanner.IsSimpleNormalizedPath(path, out int simplePathLength))
+        {
+            isNormalized = true;
+            normalizedLength = simplePathLength;
+            return Result.Success;
+        }
+
+        return IsNormalizedImpl(out isNormalized, out normalizedLength, path, flags);
+    }
+
+    /// <summary>
+    /// Checks if a path is normalized without first trying the <see cref="PathScanner"/> fast path.
+    /// </summary>
+    internal static Result IsNormalizedImpl(out bool isNormalized, out int normalizedLength, ReadOnlySpan<byte> path,
+        PathFlags flags)
     {
         UnsafeHelpers.SkipParamInit(out isNormalized, out normalizedLength);
 
@@ -223,6 +223,22 @@ public static class PathNormalizer
 
     public static Result IsNormalized(out bool isNormalized, out int outNormalizedLength, ReadOnlySpan<byte> path,
         bool allowAllCharacters)
+    {
+        if (PathScanner.IsSimpleNormalizedPath(path, out int simplePathLength))
+        {
+            isNormalized = true;
+            outNormalizedLength = simplePathLength;
+            return Result.Success;
+        }
+
+        return IsNormalizedImpl(out isNormalized, out outNormalizedLength, path, allowAllCharacters);
+    }
+
+    /// <summary>
+    /// Checks if a path is normalized one character at a time without trying the <see cref="PathScanner"/> fast path.
+    /// </summary>
+    internal static Result IsNormalizedImpl(out bool isNormalized, out int outNormalizedLength,
+        ReadOnlySpan<byte> path, bool allowAllCharacters)
     {
         UnsafeHelpers.SkipParamInit(out isNormalized, out outNormalizedLength);
 
@@ -0,0 +1,173 @@
+﻿using System;
+using System.Numerics;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using static LibHac.Fs.StringTraits;
+
+// ReSharper disable once CheckNamespace
+namespace LibHac.Fs;
+
+/// <summary>
+/// Quickly identifies simple paths that are already normalized so the full normalization checks can be skipped.
+/// </summary>
+/// <remarks><para>A simple path starts with a directory separator, contains only ASCII characters, contains no
+/// backslashes, drive separators or invalid characters, contains no empty or dot-prefixed segments
+/// and doesn't end with a directory separator. Any such path is normalized for every set of <see cref="PathFlags"/>.
+/// Paths that don't match are left for the regular checks, even if they're normalized.</para>
+/// <para>Paths are classified 32 or 16 bytes at a time when vector instructions are available.</para>
+/// <para>LibHac addition.</para></remarks>
+internal static class PathScanner
+{
+    /// <summary>
+    /// Checks if <paramref name="path"/> is a simple path that is already normalized.
+    /// </summary>
+    /// <param name="path">The path to check. The path ends at the first null terminator or
+    /// at the end of the span.</param>
+    /// <param name="length">If this function returns <see langword="true"/>,
+    /// the length of the path excluding the null terminator.</param>
+    /// <returns><see langword="true"/> if the path is a simple normalized path.</returns>
+    public static bool IsSimpleNormalizedPath(ReadOnlySpan<byte> path, out int length)
+    {
+        length = 0;
+
+        if (path.Length == 0 || path[0] != DirectorySeparator)
+            return false;
+
+        ref byte start = ref MemoryMarshal.GetReference(path);
+        int i = 0;
+        int end = -1;
+
+        // Each chunk is compared against the chunk starting one byte later to find separators followed
+        // by another separator or a dot, so there must be one byte past the end of the current chunk.
+        if (Vector256.IsHardwareAccelerated)
+        {
+            while (end < 0 && i + Vector256<byte>.Count < path.Length)
+            {
+                Vector256<byte> current = Vector256.LoadUnsafe(ref start, (nuint)i);
+                Vector256<byte> next = Vector256.LoadUnsafe(ref start, (nuint)i + 1);
+
+                uint terminatorMask = Vector256.Equals(current, Vector256<byte>.Zero).ExtractMostSignificantBits();
+                uint rejectMask = GetRejectedCharacters(current, next).ExtractMostSignificantBits();
+
+                if (!TryProcessChunk(terminatorMask, rejectMask, ref i, ref end, Vector256<byte>.Count))
+                    return false;
+            }
+        }
+
+        if (Vector128.IsHardwareAccelerated)
+        {
+            while (end < 0 && i + Vector128<byte>.Count < path.Length)
+            {
+                Vector128<byte> current = Vector128.LoadUnsafe(ref start, (nuint)i);
+                Vector128<byte> next = Vector128.LoadUnsafe(ref start, (nuint)i + 1);
+
+                uint terminatorMask = Vector128.Equals(current, Vector128<byte>.Zero).ExtractMostSignificantBits();
+                uint rejectMask = GetRejectedCharacters(current, next).ExtractMostSignificantBits();
+
+                if (!TryProcessChunk(terminatorMask, rejectMask, ref i, ref end, Vector128<byte>.Count))
+                    return false;
+            }
+        }
+
+        for (; end < 0 && i < path.Length; i++)
+        {
+            byte c = Unsafe.Add(ref start, i);
+
+            if (c == NullTerminator)
+            {
+                end = i;
+                break;
+            }
+
+            if (IsRejectedCharacter(c))
+                return false;
+
+            if (c == DirectorySeparator && i + 1 < path.Length)
+            {
+                byte nextChar = Unsafe.Add(ref start, i + 1);
+
+                if (nextChar == DirectorySeparator || nextChar == Dot)
+                    return false;
+            }
+        }
+
+        if (end < 0)
+            end = path.Length;
+
+        // The root directory is the only normalized path ending in a separator
+        if (end > 1 && path[end - 1] == DirectorySeparator)
+            return false;
+
+        length = end;
+        return true;
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static bool TryProcessChunk(uint terminatorMask, uint rejectMask, ref int position, ref int end,
+        int chunkSize)
+    {
+        if (terminatorMask != 0)
+        {
+            // Only the characters before the null terminator are part of the path
+            int terminatorIndex = BitOperations.TrailingZeroCount(terminatorMask);
+            uint pathCharacters = (1u << terminatorIndex) - 1;
+
+            if ((rejectMask & pathCharacters) != 0)
+                return false;
+
+            end = position + terminatorIndex;
+            return true;
+        }
+
+        if (rejectMask != 0)
+            return false;
+
+        position += chunkSize;
+        return true;
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static Vector256<byte> GetRejectedCharacters(Vector256<byte> current, Vector256<byte> next)
+    {
+        Vector256<byte> rejected = Vector256.GreaterThanOrEqual(current, Vector256.Create((byte)0x80));
+        rejected |= Vector256.Equals(current, Vector256.Create(AltDirectorySeparator));
+        rejected |= Vector256.Equals(current, Vector256.Create(DriveSeparator));
+        rejected |= Vector256.Equals(current, Vector256.Create((byte)'*'));
+        rejected |= Vector256.Equals(current, Vector256.Create((byte)'?'));
+        rejected |= Vector256.Equals(current, Vector256.Create((byte)'<'));
+        rejected |= Vector256.Equals(current, Vector256.Create((byte)'>'));
+        rejected |= Vector256.Equals(current, Vector256.Create((byte)'|'));
+
+        Vector256<byte> isSeparator = Vector256.Equals(current, Vector256.Create(DirectorySeparator));
+        Vector256<byte> isNextSpecial = Vector256.Equals(next, Vector256.Create(DirectorySeparator)) |
+                                        Vector256.Equals(next, Vector256.Create(Dot));
+
+        return rejected | (isSeparator & isNextSpecial);
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static Vector128<byte> GetRejectedCharacters(Vector128<byte> current, Vector128<byte> next)
+    {
+        Vector128<byte> rejected = Vector128.GreaterThanOrEqual(current, Vector128.Create((byte)0x80));
+        rejected |= Vector128.Equals(current, Vector128.Create(AltDirectorySeparator));
+        rejected |= Vector128.Equals(current, Vector128.Create(DriveSeparator));
+        rejected |= Vector128.Equals(current, Vector128.Create((byte)'*'));
+        rejected |= Vector128.Equals(current, Vector128.Create((byte)'?'));
+        rejected |= Vector128.Equals(current, Vector128.Create((byte)'<'));
+        rejected |= Vector128.Equals(current, Vector128.Create((byte)'>'));
+        rejected |= Vector128.Equals(current, Vector128.Create((byte)'|'));
+
+        Vector128<byte> isSeparator = Vector128.Equals(current, Vector128.Create(DirectorySeparator));
+        Vector128<byte> isNextSpecial = Vector128.Equals(next, Vector128.Create(DirectorySeparator)) |
+                                        Vector128.Equals(next, Vector128.Create(Dot));
+
+        return rejected | (isSeparator & isNextSpecial);
+    }
+
+    private static bool IsRejectedCharacter(byte c)
+    {
+        return c >= 0x80 || c is AltDirectorySeparator or DriveSeparator or (byte)'*' or (byte)'?' or (byte)'<'
+            or (byte)'>' or (byte)'|';
+    }
+}
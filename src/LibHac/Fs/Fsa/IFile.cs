@@ -1,5 +1,7 @@
 ﻿using System;
 using System.Runtime.CompilerServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 
 namespace LibHac.Fs.Fsa;
@@ -70,6 +72,34 @@ public abstract class IFile : IDisposable
         return Read(out bytesRead, offset, destination, ReadOption.None);
     }
 
+    /// <summary>
+    /// Asynchronously reads a sequence of bytes from the current <see cref="IFile"/>.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <param name="offset">The offset in the <see cref="IFile"/> at which to begin reading.</param>
+    /// <param name="destination">The buffer where the read bytes will be stored.
+    /// The number of bytes read will be no larger than the length of the buffer. The buffer must not be
+    /// accessed until the returned task has completed.</param>
+    /// <param name="option">Options for reading from the <see cref="IFile"/>.</param>
+    /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+    /// <returns>The <see cref="Result"/> of the requested operation and, if it was successful, the total number
+    /// of bytes read into the buffer.</returns>
+    /// <exception cref="OperationCanceledException"><paramref name="cancellationToken"/> was canceled.</exception>
+    public ValueTask<(Result Result, long BytesRead)> ReadAsync(long offset, Memory<byte> destination,
+        ReadOption option = default, CancellationToken cancellationToken = default)
+    {
+        if (destination.IsEmpty)
+            return new ValueTask<(Result, long)>((Result.Success, 0));
+
+        if (offset < 0)
+            return new ValueTask<(Result, long)>((ResultFs.OutOfRange.Log(), 0));
+
+        if (long.MaxValue - offset < destination.Length)
+            return new ValueTask<(Result, long)>((ResultFs.OutOfRange.Log(), 0));
+
+        return DoReadAsync(offset, destination, option, cancellationToken);
+    }
+
     /// <summary>
     /// Writes a sequence of bytes to the current <see cref="IFile"/>.
     /// </summary>
@@ -212,6 +242,21 @@ public abstract class IFile : IDisposable
     }
 
     protected abstract Result DoRead(out long bytesRead, long offset, Span<byte> destination, in ReadOption option);
+
+    /// <summary>
+    /// Asynchronously reads from the file. The default implementation calls <see cref="DoRead"/> synchronously.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    protected virtual ValueTask<(Result Result, long BytesRead)> DoReadAsync(long offset, Memory<byte> destination,
+        ReadOption option, CancellationToken cancellationToken)
+    {
+        if (cancellationToken.IsCancellationRequested)
+            return ValueTask.FromCanceled<(Result, long)>(cancellationToken);
+
+        Result res = DoRead(out long bytesRead, offset, destination.Span, in option);
+        return new ValueTask<(Result, long)>((res, bytesRead));
+    }
+
     protected abstract Result DoWrite(long offset, ReadOnlySpan<byte> source, in WriteOption option);
     protected abstract Result DoFlush();
     protected abstract Result DoSetSize(long size);
@@ -1,5 +1,7 @@
 ﻿using System;
 using System.Runtime.CompilerServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Util;
 
 namespace LibHac.Fs;
@@ -22,6 +24,28 @@ public abstract class IStorage : IDisposable
     /// <returns>The <see cref="Result"/> of the operation.</returns>
     public abstract Result Read(long offset, Span<byte> destination);
 
+    /// <summary>
+    /// Asynchronously reads a sequence of bytes from the current <see cref="IStorage"/>.
+    /// </summary>
+    /// <remarks>The default implementation calls <see cref="Read"/> synchronously. Storages that can wait on
+    /// their base storage without blocking a thread override this method.
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="offset">The offset in the <see cref="IStorage"/> at which to begin reading.</param>
+    /// <param name="destination">The buffer where the read bytes will be stored.
+    /// The number of bytes read will be equal to the length of the buffer. The buffer must not be
+    /// accessed until the returned task has completed.</param>
+    /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    /// <exception cref="OperationCanceledException"><paramref name="cancellationToken"/> was canceled.</exception>
+    public virtual ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (cancellationToken.IsCancellationRequested)
+            return ValueTask.FromCanceled<Result>(cancellationToken);
+
+        return new ValueTask<Result>(Read(offset, destination.Span));
+    }
+
     /// <summary>
     /// Writes a sequence of bytes to the current <see cref="IStorage"/>.
     /// </summary>
@@ -1,4 +1,6 @@
 ﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Diag;
 
@@ -168,6 +170,18 @@ public class SubStorage : IStorage
         return Result.Success;
     }
 
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (!IsValid()) return new ValueTask<Result>(ResultFs.NotInitialized.Log());
+        if (destination.Length == 0) return new ValueTask<Result>(Result.Success);
+
+        Result res = CheckAccessRange(offset, destination.Length, _size);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        return BaseStorage.ReadAsync(_offset + offset, destination, cancellationToken);
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         if (!IsValid()) return ResultFs.NotInitialized.Log();
@@ -1,5 +1,7 @@
 ﻿using System;
 using System.Runtime.CompilerServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Diag;
 
@@ -138,6 +140,18 @@ public struct ValueSubStorage : IDisposable
         return Result.Success;
     }
 
+    public readonly ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (!IsValid()) return new ValueTask<Result>(ResultFs.NotInitialized.Log());
+        if (destination.Length == 0) return new ValueTask<Result>(Result.Success);
+
+        Result res = IStorage.CheckAccessRange(offset, destination.Length, _size);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        return _baseStorage.ReadAsync(_offset + offset, destination, cancellationToken);
+    }
+
     public readonly Result Write(long offset, ReadOnlySpan<byte> source)
     {
         if (!IsValid()) return ResultFs.NotInitialized.Log();
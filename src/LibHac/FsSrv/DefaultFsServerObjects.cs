@@ -34,11 +34,11 @@ public class DefaultFsServerObjects
 
         var memoryResource = new ArrayPoolMemoryResource();
         IBufferManager bufferManager = null;
-        IHash256GeneratorFactorySelector ncaHashGeneratorFactorySelector = null;
+        IHash256GeneratorFactorySelector ncaHashGeneratorFactorySelector = new Sha256HashGeneratorFactorySelector();
 
         creators.RomFileSystemCreator = new RomFileSystemCreator();
         creators.PartitionFileSystemCreator = new PartitionFileSystemCreator();
-        creators.StorageOnNcaCreator = new StorageOnNcaCreator(memoryResource, bufferManager, InitializeNcaReader, new NcaCompressionConfiguration(), ncaHashGeneratorFactorySelector);
+        creators.StorageOnNcaCreator = new StorageOnNcaCreator(memoryResource, bufferManager, InitializeNcaReader, CompressionConfiguration.GetNcaCompressionConfiguration(), ncaHashGeneratorFactorySelector);
         creators.TargetManagerFileSystemCreator = new TargetManagerFileSystemCreator();
         creators.SubDirectoryFileSystemCreator = new SubDirectoryFileSystemCreator();
         creators.SaveDataFileSystemCreator = new SaveDataFileSystemCreator(fsServer, null, randomGenerator);
@@ -57,8 +57,8 @@ public class DeepRetryStorage : IStorage
         ref UniqueRef<IUniqueLock> mountCountSemaphore,
         bool deepRetryEnabled, FileSystemServer fsServer)
     {
-        // Missing: Getting the thread pool via GetRegisteredThreadPool()
-        _asyncStorage = new AsynchronousAccessStorage(in baseStorage, accessSplitter.Get);
+        _asyncStorage = new AsynchronousAccessStorage(in baseStorage, accessSplitter.Get,
+            fsServer.GetRegisteredThreadPool());
         _accessSplitter = SharedRef<IAsynchronousAccessSplitter>.CreateCopy(in accessSplitter);
         _parent = SharedRef<IRomFileSystemAccessFailureManager>.CreateCopy(in parent);
         _mountCountLock = UniqueRef<IUniqueLock>.Create(ref mountCountSemaphore);
@@ -75,8 +75,8 @@ public class DeepRetryStorage : IStorage
         ref UniqueRef<IUniqueLock> mountCountSemaphore,
         in Hash hash, ulong programId, StorageId storageId, FileSystemServer fsServer)
     {
-        // Missing: Getting the thread pool via GetRegisteredThreadPool()
-        _asyncStorage = new AsynchronousAccessStorage(in baseStorage, accessSplitter.Get);
+        _asyncStorage = new AsynchronousAccessStorage(in baseStorage, accessSplitter.Get,
+            fsServer.GetRegisteredThreadPool());
         _accessSplitter = SharedRef<IAsynchronousAccessSplitter>.CreateCopy(in accessSplitter);
         _parent = SharedRef<IRomFileSystemAccessFailureManager>.CreateCopy(in parent);
         _mountCountLock = UniqueRef<IUniqueLock>.Create(ref mountCountSemaphore);
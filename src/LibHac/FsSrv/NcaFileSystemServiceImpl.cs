@@ -98,7 +98,7 @@ file static class Anonymous
 
         Assert.SdkAssert(reader1 is not null || reader2 is not null);
 
-        var generator = new Sha256Generator();
+        using var generator = new Sha256Generator();
         generator.Initialize();
 
         if (reader1 is not null)
@@ -124,6 +124,17 @@ public class AesCtrCounterExtendedStorage : IStorage
         return _table.IsInitialized();
     }
 
+    /// <summary>
+    /// Sets the cache used to keep decoded nodes of the counter table in memory.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <param name="cache">The cache to use. May be shared with other storages.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        _table.SetNodeCache(cache);
+    }
+
     // ReSharper disable once UnusedMember.Local
     private Result Initialize(MemoryResource allocator, ReadOnlySpan<byte> key, uint secureValue,
         ref readonly ValueSubStorage dataStorage, ref readonly ValueSubStorage tableStorage)
@@ -2,6 +2,8 @@
 using System.Buffers.Binary;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Common.FixedArrays;
 using LibHac.Crypto;
@@ -85,13 +87,43 @@ public class AesCtrStorage : IStorage
         Result res = _baseStorage.Read(offset, destination);
         if (res.IsFailure()) return res.Miss();
 
+        return Decrypt(offset, destination);
+    }
+
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (destination.Length == 0)
+            return new ValueTask<Result>(Result.Success);
+
+        // Reads cannot contain any partial blocks.
+        if (!Alignment.IsAligned(offset, (uint)BlockSize))
+            return new ValueTask<Result>(ResultFs.InvalidArgument.Log());
+
+        if (!Alignment.IsAligned(destination.Length, (uint)BlockSize))
+            return new ValueTask<Result>(ResultFs.InvalidArgument.Log());
+
+        return ReadAsyncImpl(offset, destination, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncImpl(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken)
+    {
+        Result res = await _baseStorage.ReadAsync(offset, destination, cancellationToken).ConfigureAwait(false);
+        if (res.IsFailure()) return res.Miss();
+
+        return Decrypt(offset, destination.Span);
+    }
+
+    private Result Decrypt(long offset, Span<byte> buffer)
+    {
         using var changePriority = new ScopedThreadPriorityChanger(1, ScopedThreadPriorityChanger.Mode.Relative);
 
         Array16<byte> counter = _iv;
         Utility.AddCounter(counter, (ulong)offset / (uint)BlockSize);
 
-        int decSize = Aes.DecryptCtr128(destination, destination, _key, counter);
-        if (decSize != destination.Length)
+        int decSize = Aes.DecryptCtr128(buffer, buffer, _key, counter);
+        if (decSize != buffer.Length)
             return ResultFs.UnexpectedInAesCtrStorageA.Log();
 
         return Result.Success;
@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
@@ -40,7 +41,7 @@ public interface IAsynchronousAccessSplitter : IDisposable
         if (res.IsFailure()) return res.Miss();
         Assert.SdkNotEqual(startOffset, offsetAppropriate);
 
-        nextOffset = Math.Min(startOffset, offsetAppropriate);
+        nextOffset = Math.Min(endOffset, offsetAppropriate);
         return Result.Success;
     }
 
@@ -89,10 +90,19 @@ public class DefaultAsynchronousAccessSplitter : IAsynchronousAccessSplitter
     }
 }
 
+/// <summary>
+/// Splits large reads into chunks using an <see cref="IAsynchronousAccessSplitter"/> and reads the chunks
+/// from the base storage in parallel on an <see cref="IThreadPool"/>.
+/// </summary>
+/// <remarks><para>Based on nnSdk 13.4.0 (FS 13.1.0)</para>
+/// <para>If no thread pool is given, all requests are passed directly to the base storage.</para></remarks>
 public class AsynchronousAccessStorage : IStorage
 {
+    // Chunks are aligned to this size so they line up with the blocks used by the storages below this one
+    private const long AccessAlignment = 0x4000;
+
     private SharedRef<IStorage> _baseStorage;
-    // private ThreadPool _threadPool;
+    private IThreadPool _threadPool;
     private IAsynchronousAccessSplitter _baseStorageAccessSplitter;
 
     public AsynchronousAccessStorage(ref readonly SharedRef<IStorage> baseStorage) : this(in baseStorage,
@@ -100,9 +110,16 @@ public class AsynchronousAccessStorage : IStorage
     {
     }
 
-    public AsynchronousAccessStorage(ref readonly SharedRef<IStorage> baseStorage, IAsynchronousAccessSplitter baseStorageAccessSplitter)
+    public AsynchronousAccessStorage(ref readonly SharedRef<IStorage> baseStorage,
+        IAsynchronousAccessSplitter baseStorageAccessSplitter) : this(in baseStorage, baseStorageAccessSplitter, null)
+    {
+    }
+
+    public AsynchronousAccessStorage(ref readonly SharedRef<IStorage> baseStorage,
+        IAsynchronousAccessSplitter baseStorageAccessSplitter, IThreadPool threadPool)
     {
         _baseStorage = SharedRef<IStorage>.CreateCopy(in baseStorage);
+        _threadPool = threadPool;
         _baseStorageAccessSplitter = baseStorageAccessSplitter;
 
         Assert.SdkRequiresNotNull(in _baseStorage);
@@ -121,15 +138,83 @@ public class AsynchronousAccessStorage : IStorage
         _baseStorageAccessSplitter = baseStorageAccessSplitter;
     }
 
-    // Todo: Implement
     public override Result Read(long offset, Span<byte> destination)
     {
-        return _baseStorage.Get.Read(offset, destination).Ret();
+        if (_threadPool is null || destination.Length <= _threadPool.GetMinimumSplitSize())
+        {
+            return _baseStorage.Get.Read(offset, destination).Ret();
+        }
+
+        return ReadImpl(offset, destination).Ret();
+    }
+
+    private unsafe Result ReadImpl(long offset, Span<byte> destination)
+    {
+        // Split the request into enough chunks to give every thread in the pool and the calling thread some work
+        long chunkSize = BitUtil.DivideUp(destination.Length, _threadPool.GetThreadCount() + 1);
+        long accessSize = Alignment.AlignUp(Math.Max(chunkSize, _threadPool.GetMinimumSplitSize()), AccessAlignment);
+
+        long endOffset = offset + destination.Length;
+
+        Result res = _baseStorageAccessSplitter.QueryInvocationCount(out long invocationCount, offset, endOffset,
+            accessSize, AccessAlignment);
+        if (res.IsFailure()) return res.Miss();
+
+        if (invocationCount <= 1)
+        {
+            return _baseStorage.Get.Read(offset, destination).Ret();
+        }
+
+        var splitOffsets = new List<long>((int)invocationCount + 1) { offset };
+        long currentOffset = offset;
+
+        while (currentOffset < endOffset)
+        {
+            res = _baseStorageAccessSplitter.QueryNextOffset(out currentOffset, currentOffset, endOffset, accessSize,
+                AccessAlignment);
+            if (res.IsFailure()) return res.Miss();
+
+            splitOffsets.Add(currentOffset);
+        }
+
+        fixed (byte* buffer = destination)
+        {
+            var work = new SplitReadWork(_baseStorage.Get, buffer, offset, splitOffsets);
+
+            res = _threadPool.Execute(work, splitOffsets.Count - 1);
+            if (res.IsFailure()) return res.Miss();
+        }
+
+        return Result.Success;
     }
 
-    private Result ReadImpl(long offset, Span<byte> destination)
+    /// <summary>
+    /// Reads the chunk of a split request between two of the split offsets.
+    /// </summary>
+    private sealed unsafe class SplitReadWork : IThreadPoolWork
     {
-        throw new NotImplementedException();
+        private readonly IStorage _baseStorage;
+        private readonly byte* _buffer;
+        private readonly long _offset;
+        private readonly List<long> _splitOffsets;
+
+        public SplitReadWork(IStorage baseStorage, byte* buffer, long offset, List<long> splitOffsets)
+        {
+            _baseStorage = baseStorage;
+            _buffer = buffer;
+            _offset = offset;
+            _splitOffsets = splitOffsets;
+        }
+
+        public Result Run(int index)
+        {
+            long chunkOffset = _splitOffsets[index];
+            int chunkSize = (int)(_splitOffsets[index + 1] - chunkOffset);
+
+            var chunkBuffer = new Span<byte>(_buffer + (chunkOffset - _offset), chunkSize);
+
+            return _baseStorage.Read(chunkOffset, chunkBuffer).Ret();
+        }
     }
 
     public override Result Write(long offset, ReadOnlySpan<byte> source)
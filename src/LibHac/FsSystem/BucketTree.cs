@@ -1,8 +1,11 @@
 ﻿using System;
 using System.Buffers.Binary;
 using System.Diagnostics.CodeAnalysis;
+using System.Numerics;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using System.Threading;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
@@ -149,6 +152,10 @@ public partial class BucketTree : IDisposable
     private int _offsetCount;
     private int _entrySetCount;
     private OffsetCache _offsetCache;
+    private BucketTreeNodeCache _nodeCache;
+    private readonly long _nodeCacheId = Interlocked.Increment(ref _nextNodeCacheId);
+
+    private static long _nextNodeCacheId;
 
     public struct ContinuousReadingInfo
     {
@@ -289,6 +296,100 @@ public partial class BucketTree : IDisposable
         }
     }
 
+    /// <summary>
+    /// An L2 node or entry set that has been read from storage and verified. The virtual offsets of its
+    /// entries are stored contiguously so they can be searched without reading strided entries.
+    /// </summary>
+    internal sealed class DecodedNode
+    {
+        // Once the search range is this small the remaining offsets are all compared at once instead of bisected
+        private const int VectorSearchThreshold = 32;
+
+        public readonly NodeHeader Header;
+        public readonly long[] Offsets;
+
+        /// <summary>The raw node data. <see langword="null"/> for L2 nodes because they only contain offsets.</summary>
+        public readonly byte[] Data;
+
+        public long Size => Offsets.Length * sizeof(long) + (Data?.Length ?? 0);
+
+        public DecodedNode(in NodeHeader header, long[] offsets, byte[] data)
+        {
+            Header = header;
+            Offsets = offsets;
+            Data = data;
+        }
+
+        /// <summary>
+        /// Returns the index of the last entry with an offset less than or equal to
+        /// <paramref name="virtualAddress"/>, or -1 if there is no such entry.
+        /// </summary>
+        public int FindIndex(long virtualAddress)
+        {
+            ReadOnlySpan<long> offsets = Offsets;
+            int start = 0;
+            int count = offsets.Length;
+
+            while (count > VectorSearchThreshold)
+            {
+                int half = count / 2;
+
+                if (offsets[start + half] <= virtualAddress)
+                {
+                    start += half + 1;
+                    count -= half + 1;
+                }
+                else
+                {
+                    count = half;
+                }
+            }
+
+            return start + CountLessEqual(offsets.Slice(start, count), virtualAddress) - 1;
+        }
+
+        public ReadOnlySpan<byte> GetEntry(int index, long entrySize)
+        {
+            return Data.AsSpan((int)GetBucketTreeEntryOffset(0, entrySize, index), (int)entrySize);
+        }
+
+        private static int CountLessEqual(ReadOnlySpan<long> offsets, long value)
+        {
+            ref long start = ref MemoryMarshal.GetReference(offsets);
+            int count = 0;
+            int i = 0;
+
+            if (Vector256.IsHardwareAccelerated)
+            {
+                Vector256<long> target = Vector256.Create(value);
+
+                for (; i + Vector256<long>.Count <= offsets.Length; i += Vector256<long>.Count)
+                {
+                    Vector256<long> current = Vector256.LoadUnsafe(ref start, (nuint)i);
+                    count += BitOperations.PopCount(Vector256.LessThanOrEqual(current, target).ExtractMostSignificantBits());
+                }
+            }
+            else if (Vector128.IsHardwareAccelerated)
+            {
+                Vector128<long> target = Vector128.Create(value);
+
+                for (; i + Vector128<long>.Count <= offsets.Length; i += Vector128<long>.Count)
+                {
+                    Vector128<long> current = Vector128.LoadUnsafe(ref start, (nuint)i);
+                    count += BitOperations.PopCount(Vector128.LessThanOrEqual(current, target).ExtractMostSignificantBits());
+                }
+            }
+
+            for (; i < offsets.Length; i++)
+            {
+                if (offsets[i] <= value)
+                    count++;
+            }
+
+            return count;
+        }
+    }
+
     private struct OffsetCache
     {
         public OffsetCache()
@@ -478,6 +579,20 @@ public partial class BucketTree : IDisposable
 
     public int GetEntryCount() => _entryCount;
 
+    public BucketTreeNodeCache GetNodeCache() => _nodeCache;
+
+    /// <summary>
+    /// Sets the cache used to keep decoded L2 nodes and entry sets in memory.
+    /// </summary>
+    /// <remarks>Node caching is disabled until a cache is set.</remarks>
+    /// <param name="cache">The cache to use. May be shared with other trees.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        _nodeCache?.Invalidate(_nodeCacheId);
+        _nodeCache = cache;
+    }
+
     public Result GetOffsets(out Offsets offsets)
     {
         UnsafeHelpers.SkipParamInit(out offsets);
@@ -586,6 +701,7 @@ public partial class BucketTree : IDisposable
             _entryStorage.Dispose();
 
             _nodeL1.Free();
+            _nodeCache?.Invalidate(_nodeCacheId);
 
             _nodeSize = 0;
             _entrySize = 0;
@@ -627,6 +743,8 @@ public partial class BucketTree : IDisposable
         res = _entryStorage.OperateRange(OperationId.InvalidateCache, 0, long.MaxValue);
         if (res.IsFailure()) return res.Miss();
 
+        _nodeCache?.Invalidate(_nodeCacheId);
+
         _offsetCache.IsInitialized = false;
         return Result.Success;
     }
@@ -674,6 +792,63 @@ public partial class BucketTree : IDisposable
         return Result.Success;
     }
 
+    private Result GetL2Node(out DecodedNode node, int nodeIndex)
+    {
+        // L2 nodes and entry sets share the cache so they need different keys
+        long nodeKey = (long)nodeIndex << 1;
+
+        if (_nodeCache is not null && _nodeCache.TryGet(_nodeCacheId, nodeKey, out node))
+            return Result.Success;
+
+        Result res = ReadNode(out node, ref _nodeStorage, (nodeIndex + 1) * _nodeSize, nodeIndex, sizeof(long),
+            keepData: false);
+        if (res.IsFailure()) return res.Miss();
+
+        _nodeCache?.Add(_nodeCacheId, nodeKey, node);
+        return Result.Success;
+    }
+
+    private Result GetEntrySetNode(out DecodedNode node, int entrySetIndex)
+    {
+        long nodeKey = ((long)entrySetIndex << 1) | 1;
+
+        if (_nodeCache is not null && _nodeCache.TryGet(_nodeCacheId, nodeKey, out node))
+            return Result.Success;
+
+        Result res = ReadNode(out node, ref _entryStorage, entrySetIndex * _nodeSize, entrySetIndex, _entrySize,
+            keepData: true);
+        if (res.IsFailure()) return res.Miss();
+
+        _nodeCache?.Add(_nodeCacheId, nodeKey, node);
+        return Result.Success;
+    }
+
+    private Result ReadNode(out DecodedNode node, ref ValueSubStorage storage, long offset, int nodeIndex,
+        long entrySize, bool keepData)
+    {
+        node = null;
+
+        byte[] buffer = new byte[_nodeSize];
+
+        Result res = storage.Read(offset, buffer);
+        if (res.IsFailure()) return res.Miss();
+
+        NodeHeader header = MemoryMarshal.Read<NodeHeader>(buffer);
+        res = header.Verify(nodeIndex, _nodeSize, entrySize);
+        if (res.IsFailure()) return res.Miss();
+
+        long[] offsets = new long[header.EntryCount];
+
+        for (int i = 0; i < offsets.Length; i++)
+        {
+            long entryOffset = GetBucketTreeEntryOffset(0, entrySize, i);
+            offsets[i] = BinaryPrimitives.ReadInt64LittleEndian(buffer.AsSpan((int)entryOffset));
+        }
+
+        node = new DecodedNode(in header, offsets, keepData ? buffer : null);
+        return Result.Success;
+    }
+
     private bool IsExistL2() => _offsetCount < _entrySetCount;
     private bool IsExistOffsetL2OnL1() => IsExistL2() && _nodeL1.GetHeader().EntryCount < _offsetCount;
 
@@ -708,14 +883,25 @@ public partial class BucketTree : IDisposable
             return ResultFs.OutOfRange.Log();
 
         // Create a pooled buffer for our scan.
-        using var pool = new PooledBuffer((int)_nodeSize, 1);
+        // Entry sets are taken from the node cache instead when it's enabled.
+        using var pool = new PooledBuffer();
         var buffer = Span<byte>.Empty;
 
+        if (_nodeCache is null)
+            pool.Allocate((int)_nodeSize, 1);
+
         Result res = _entryStorage.GetSize(out long entryStorageSize);
         if (res.IsFailure()) return res.Miss();
 
         // Read the node.
-        if (_nodeSize <= pool.GetSize())
+        if (_nodeCache is not null)
+        {
+            res = GetEntrySetNode(out DecodedNode entrySet, param.EntrySet.Index);
+            if (res.IsFailure()) return res.Miss();
+
+            buffer = entrySet.Data;
+        }
+        else if (_nodeSize <= pool.GetSize())
         {
             buffer = pool.GetBuffer();
             long ofs = param.EntrySet.Index * _nodeSize;
@@ -849,6 +1035,7 @@ public partial class BucketTree : IDisposable
         private int _entryIndex;
         private int _entrySetCount;
         private EntrySetHeader _entrySet;
+        private DecodedNode _entrySetNode;
 
         [StructLayout(LayoutKind.Explicit)]
         private struct EntrySetHeader
@@ -875,10 +1062,13 @@ public partial class BucketTree : IDisposable
             _entryIndex = -1;
             _entrySetCount = 0;
             _entrySet = new EntrySetHeader();
+            _entrySetNode = null;
         }
 
         public void Dispose()
         {
+            _entrySetNode = null;
+
             if (!_entry.IsNull)
             {
                 _tree.GetAllocator().Deallocate(ref _entry);
@@ -1007,6 +1197,9 @@ public partial class BucketTree : IDisposable
 
         private Result FindEntrySet(out int entrySetIndex, long virtualAddress, int nodeIndex)
         {
+            if (_tree._nodeCache is not null)
+                return FindEntrySetWithNode(out entrySetIndex, virtualAddress, nodeIndex);
+
             long nodeSize = _tree._nodeSize;
 
             using var pool = new PooledBuffer((int)nodeSize, 1);
@@ -1022,6 +1215,22 @@ public partial class BucketTree : IDisposable
             }
         }
 
+        private Result FindEntrySetWithNode(out int entrySetIndex, long virtualAddress, int nodeIndex)
+        {
+            UnsafeHelpers.SkipParamInit(out entrySetIndex);
+
+            Result res = _tree.GetL2Node(out DecodedNode node, nodeIndex);
+            if (res.IsFailure()) return res.Miss();
+
+            int index = node.FindIndex(virtualAddress);
+
+            if (index < 0)
+                return ResultFs.InvalidBucketTreeVirtualOffset.Log();
+
+            entrySetIndex = _tree.GetEntrySetIndex(node.Header.Index, index);
+            return Result.Success;
+        }
+
         private Result FindEntrySetWithBuffer(out int entrySetIndex, long virtualAddress, int nodeIndex,
             Span<byte> buffer)
         {
@@ -1085,6 +1294,9 @@ public partial class BucketTree : IDisposable
 
         private Result FindEntry(long virtualAddress, int entrySetIndex)
         {
+            if (_tree._nodeCache is not null)
+                return FindEntryWithNode(virtualAddress, entrySetIndex);
+
             long entrySetSize = _tree._nodeSize;
 
             using var pool = new PooledBuffer((int)entrySetSize, 1);
@@ -1100,6 +1312,27 @@ public partial class BucketTree : IDisposable
             }
         }
 
+        private Result FindEntryWithNode(long virtualAddress, int entrySetIndex)
+        {
+            Result res = _tree.GetEntrySetNode(out DecodedNode entrySet, entrySetIndex);
+            if (res.IsFailure()) return res.Miss();
+
+            int entryIndex = entrySet.FindIndex(virtualAddress);
+
+            if (entryIndex < 0)
+                return ResultFs.InvalidBucketTreeVirtualOffset.Log();
+
+            // Copy the data into entry.
+            entrySet.GetEntry(entryIndex, _tree._entrySize).CopyTo(_entry.Span);
+
+            // Set our entry set/index.
+            _entrySet = MemoryMarshal.Read<EntrySetHeader>(entrySet.Data);
+            _entrySetNode = entrySet;
+            _entryIndex = entryIndex;
+
+            return Result.Success;
+        }
+
         private Result FindEntryWithBuffer(long virtualAddress, int entrySetIndex, Span<byte> buffer)
         {
             // Calculate entry set extents.
@@ -1196,9 +1429,8 @@ public partial class BucketTree : IDisposable
                 long end = _entrySet.Info.End;
 
                 long entrySetSize = _tree._nodeSize;
-                long entrySetOffset = entrySetIndex * entrySetSize;
 
-                res = _tree._entryStorage.Read(entrySetOffset, SpanHelpers.AsByteSpan(ref _entrySet));
+                res = ReadEntrySetHeader(entrySetIndex);
                 if (res.IsFailure()) return res.Miss();
 
                 res = _entrySet.Header.Verify(entrySetIndex, entrySetSize, _tree._entrySize);
@@ -1215,10 +1447,7 @@ public partial class BucketTree : IDisposable
             }
 
             // Read the new entry
-            long entrySize = _tree._entrySize;
-            long entryOffset = GetBucketTreeEntryOffset(_entrySet.Info.Index, _tree._nodeSize, entrySize, entryIndex);
-
-            res = _tree._entryStorage.Read(entryOffset, _entry.Span);
+            res = ReadEntry(entryIndex);
             if (res.IsFailure()) return res.Miss();
 
             // Note that we changed index.
@@ -1246,9 +1475,8 @@ public partial class BucketTree : IDisposable
 
                 long entrySetSize = _tree._nodeSize;
                 int entrySetIndex = _entrySet.Info.Index - 1;
-                long entrySetOffset = entrySetIndex * entrySetSize;
 
-                res = _tree._entryStorage.Read(entrySetOffset, SpanHelpers.AsByteSpan(ref _entrySet));
+                res = ReadEntrySetHeader(entrySetIndex);
                 if (res.IsFailure()) return res.Miss();
 
                 res = _entrySet.Header.Verify(entrySetIndex, entrySetSize, _tree._entrySize);
@@ -1267,10 +1495,7 @@ public partial class BucketTree : IDisposable
             entryIndex--;
 
             // Read the new entry
-            long entrySize = _tree._entrySize;
-            long entryOffset = GetBucketTreeEntryOffset(_entrySet.Info.Index, _tree._nodeSize, entrySize, entryIndex);
-
-            res = _tree._entryStorage.Read(entryOffset, _entry.Span);
+            res = ReadEntry(entryIndex);
             if (res.IsFailure()) return res.Miss();
 
             // Note that we changed index.
@@ -1278,6 +1503,38 @@ public partial class BucketTree : IDisposable
             return Result.Success;
         }
 
+        private Result ReadEntrySetHeader(int entrySetIndex)
+        {
+            if (_tree._nodeCache is not null)
+            {
+                Result res = _tree.GetEntrySetNode(out DecodedNode entrySet, entrySetIndex);
+                if (res.IsFailure()) return res.Miss();
+
+                _entrySet = MemoryMarshal.Read<EntrySetHeader>(entrySet.Data);
+                _entrySetNode = entrySet;
+                return Result.Success;
+            }
+
+            long entrySetOffset = entrySetIndex * _tree._nodeSize;
+            return _tree._entryStorage.Read(entrySetOffset, SpanHelpers.AsByteSpan(ref _entrySet));
+        }
+
+        private readonly Result ReadEntry(int entryIndex)
+        {
+            long entrySize = _tree._entrySize;
+
+            if (_entrySetNode is not null)
+            {
+                Assert.SdkEqual(_entrySetNode.Header.Index, _entrySet.Info.Index);
+
+                _entrySetNode.GetEntry(entryIndex, entrySize).CopyTo(_entry.Span);
+                return Result.Success;
+            }
+
+            long entryOffset = GetBucketTreeEntryOffset(_entrySet.Info.Index, _tree._nodeSize, entrySize, entryIndex);
+            return _tree._entryStorage.Read(entryOffset, _entry.Span);
+        }
+
         public readonly Result ScanContinuousReading<TEntry>(out ContinuousReadingInfo info, long offset, long size)
             where TEntry : unmanaged, IContinuousReadingEntry
         {
@@ -0,0 +1,168 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+using LibHac.Diag;
+using LibHac.Os;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// A size-bounded LRU cache of decoded <see cref="BucketTree"/> L2 nodes and entry sets.
+/// </summary>
+/// <remarks><para>A single cache can be shared between any number of <see cref="BucketTree"/>s.
+/// Trees don't use a cache unless one is given to them with <see cref="BucketTree.SetNodeCache"/>.
+/// Nodes are keyed by an ID unique to each tree, so the cache doesn't keep the trees alive.</para>
+/// <para>Cached nodes are never modified, so a node returned by the cache can still be used after it's evicted.</para>
+/// <para>This class is thread-safe.</para></remarks>
+public sealed class BucketTreeNodeCache
+{
+    /// <summary>
+    /// A suggested capacity for a cache used by a single <see cref="BucketTree"/>.
+    /// </summary>
+    public const long DefaultCapacity = 1024 * 256;
+
+    private readonly record struct Key(long TreeId, long NodeKey);
+
+    private readonly struct CacheEntry
+    {
+        public readonly Key Key;
+        public readonly BucketTree.DecodedNode Node;
+
+        public CacheEntry(Key key, BucketTree.DecodedNode node)
+        {
+            Key = key;
+            Node = node;
+        }
+    }
+
+    private readonly Dictionary<Key, LinkedListNode<CacheEntry>> _entries;
+    private readonly LinkedList<CacheEntry> _lruList;
+    private SdkMutexType _mutex;
+    private long _size;
+
+    private long _hitCount;
+    private long _missCount;
+    private long _evictionCount;
+
+    /// <summary>The maximum total size of the nodes in the cache.</summary>
+    public long Capacity { get; }
+
+    /// <summary>The total size of the nodes currently in the cache.</summary>
+    public long Size => Volatile.Read(ref _size);
+
+    /// <summary>The number of node lookups that were found in the cache.</summary>
+    public long HitCount => Interlocked.Read(ref _hitCount);
+
+    /// <summary>The number of node lookups that had to read the node from storage.</summary>
+    public long MissCount => Interlocked.Read(ref _missCount);
+
+    /// <summary>The number of nodes that were removed to make room for newer ones.</summary>
+    public long EvictionCount => Interlocked.Read(ref _evictionCount);
+
+    /// <param name="capacity">The maximum total size in bytes of the nodes to keep in the cache.
+    /// Each cached node uses up to 1.5 times the tree's node size.</param>
+    public BucketTreeNodeCache(long capacity)
+    {
+        Assert.SdkRequiresLessEqual(0, capacity);
+
+        Capacity = capacity;
+        _entries = new Dictionary<Key, LinkedListNode<CacheEntry>>();
+        _lruList = new LinkedList<CacheEntry>();
+        _mutex = new SdkMutexType();
+    }
+
+    internal bool TryGet(long treeId, long nodeKey, out BucketTree.DecodedNode node)
+    {
+        using (ScopedLock.Lock(ref _mutex))
+        {
+            if (_entries.TryGetValue(new Key(treeId, nodeKey), out LinkedListNode<CacheEntry> listNode))
+            {
+                _lruList.Remove(listNode);
+                _lruList.AddFirst(listNode);
+
+                Interlocked.Increment(ref _hitCount);
+                node = listNode.ValueRef.Node;
+                return true;
+            }
+        }
+
+        Interlocked.Increment(ref _missCount);
+        node = null;
+        return false;
+    }
+
+    internal void Add(long treeId, long nodeKey, BucketTree.DecodedNode node)
+    {
+        if (node.Size > Capacity)
+            return;
+
+        var key = new Key(treeId, nodeKey);
+
+        using ScopedLock<SdkMutexType> lk = ScopedLock.Lock(ref _mutex);
+
+        // Another thread may have added the same node while we were reading it
+        if (_entries.ContainsKey(key))
+            return;
+
+        while (_size + node.Size > Capacity)
+        {
+            LinkedListNode<CacheEntry> lru = _lruList.Last;
+            Assert.SdkNotNull(lru);
+
+            RemoveEntry(lru);
+            Interlocked.Increment(ref _evictionCount);
+        }
+
+        _entries.Add(key, _lruList.AddFirst(new CacheEntry(key, node)));
+        _size += node.Size;
+    }
+
+    /// <summary>
+    /// Removes all cached nodes belonging to the tree with the ID <paramref name="treeId"/>.
+    /// </summary>
+    internal void Invalidate(long treeId)
+    {
+        using ScopedLock<SdkMutexType> lk = ScopedLock.Lock(ref _mutex);
+
+        LinkedListNode<CacheEntry> current = _lruList.First;
+
+        while (current is not null)
+        {
+            LinkedListNode<CacheEntry> next = current.Next;
+
+            if (current.ValueRef.Key.TreeId == treeId)
+                RemoveEntry(current);
+
+            current = next;
+        }
+    }
+
+    /// <summary>
+    /// Removes all nodes from the cache.
+    /// </summary>
+    public void Clear()
+    {
+        using ScopedLock<SdkMutexType> lk = ScopedLock.Lock(ref _mutex);
+
+        _entries.Clear();
+        _lruList.Clear();
+        _size = 0;
+    }
+
+    /// <summary>
+    /// Resets <see cref="HitCount"/>, <see cref="MissCount"/> and <see cref="EvictionCount"/> to 0.
+    /// </summary>
+    public void ResetCounters()
+    {
+        Interlocked.Exchange(ref _hitCount, 0);
+        Interlocked.Exchange(ref _missCount, 0);
+        Interlocked.Exchange(ref _evictionCount, 0);
+    }
+
+    private void RemoveEntry(LinkedListNode<CacheEntry> listNode)
+    {
+        _entries.Remove(listNode.ValueRef.Key);
+        _lruList.Remove(listNode);
+        _size -= listNode.ValueRef.Node.Size;
+    }
+}
@@ -1,6 +1,8 @@
 ﻿using System;
+using System.Diagnostics;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Threading;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
@@ -15,7 +17,9 @@ namespace LibHac.FsSystem;
 /// <summary>
 /// An <see cref="IStorage"/> that provides buffered access to a base <see cref="IStorage"/>.
 /// </summary>
-/// <remarks>Based on nnSdk 13.4.0 (FS 13.1.0)</remarks>
+/// <remarks><para>Based on nnSdk 13.4.0 (FS 13.1.0)</para>
+/// <para>LibHac addition: Sequential reads can be detected and read ahead of the reader.
+/// See <see cref="EnableReadAhead(int)"/>.</para></remarks>
 public class BufferedStorage : IStorage
 {
     private const long InvalidOffset = long.MaxValue;
@@ -937,6 +941,43 @@ public class BufferedStorage : IStorage
         }
     }
 
+    /// <summary>
+    /// Pauses read-ahead in a <see cref="FsSystem.BufferedStorage"/> until disposed.
+    /// </summary>
+    private readonly ref struct ScopedReadAheadPause
+    {
+        private readonly BufferedStorage _bufferedStorage;
+
+        public ScopedReadAheadPause(BufferedStorage bufferedStorage)
+        {
+            _bufferedStorage = bufferedStorage;
+            _bufferedStorage.PauseReadAhead();
+        }
+
+        public void Dispose() => _bufferedStorage.ResumeReadAhead();
+    }
+
+    /// <summary>
+    /// Runs a queued read-ahead request on an <see cref="IThreadPool"/>.
+    /// </summary>
+    private sealed class ReadAheadWork : IThreadPoolWork
+    {
+        private readonly BufferedStorage _bufferedStorage;
+        private readonly long _requestId;
+
+        public ReadAheadWork(BufferedStorage bufferedStorage, long requestId)
+        {
+            _bufferedStorage = bufferedStorage;
+            _requestId = requestId;
+        }
+
+        public Result Run(int index)
+        {
+            _bufferedStorage.RunReadAhead(_requestId);
+            return Result.Success;
+        }
+    }
+
     private ValueSubStorage _baseStorage;
     private IBufferManager _bufferManager;
     private long _blockSize;
@@ -947,6 +988,16 @@ public class BufferedStorage : IStorage
     private int _nextFetchCacheIndex;
     private SdkMutexType _mutex;
     private bool _bulkReadEnabled;
+    private ReadAheadController _readAhead;
+    private IThreadPool _readAheadThreadPool;
+    private readonly object _readAheadLocker = new();
+    private int _readAheadPauseCount;
+    private bool _isReadAheadQueued;
+    private bool _isReadAheadRunning;
+    private long _readAheadRequestId;
+    private ReadAheadController _pendingReadAhead;
+    private long _pendingReadAheadBlockIndex;
+    private int _pendingReadAheadBlockCount;
 
     /// <summary>
     /// The <see cref="Cache"/> at which new <see cref="SharedCache"/>s will begin iterating.
@@ -997,6 +1048,9 @@ public class BufferedStorage : IStorage
         Assert.SdkRequires(BitUtil.IsPowerOfTwo(blockSize));
         Assert.SdkRequiresLess(0, bufferCount);
 
+        // Wait for any read-ahead that's still using the old caches
+        using var readAheadPause = new ScopedReadAheadPause(this);
+
         // Get the base storage size.
         Result res = baseStorage.GetSize(out _baseStorageSize);
         if (res.IsFailure()) return res.Miss();
@@ -1035,6 +1089,7 @@ public class BufferedStorage : IStorage
 
         _nextFetchCacheIndex = 0;
         _nextAcquireCacheIndex = 0;
+        _readAhead?.Reset();
         return Result.Success;
     }
 
@@ -1043,6 +1098,9 @@ public class BufferedStorage : IStorage
     /// </summary>
     public void FinalizeObject()
     {
+        // Wait for any read-ahead that's still using the caches
+        using var readAheadPause = new ScopedReadAheadPause(this);
+
         using (var emptyStorage = new ValueSubStorage())
         {
             _baseStorage.Set(in emptyStorage);
@@ -1076,7 +1134,14 @@ public class BufferedStorage : IStorage
             return Result.Success;
 
         // Do the read.
-        return ReadCore(offset, destination).Miss();
+        Result res = ReadCore(offset, destination);
+        if (res.IsFailure()) return res.Miss();
+
+        ReadAheadController readAhead = _readAhead;
+        if (readAhead is not null)
+            UpdateReadAhead(readAhead, offset, destination.Length);
+
+        return Result.Success;
     }
 
     public override Result Write(long offset, ReadOnlySpan<byte> source)
@@ -1087,7 +1152,9 @@ public class BufferedStorage : IStorage
         if (source.Length == 0)
             return Result.Success;
 
-        // Do the read.
+        using var readAheadPause = new ScopedReadAheadPause(this);
+
+        // Do the write.
         return WriteCore(offset, source).Miss();
     }
 
@@ -1103,6 +1170,8 @@ public class BufferedStorage : IStorage
     {
         Assert.SdkRequires(IsInitialized());
 
+        using var readAheadPause = new ScopedReadAheadPause(this);
+
         Result res;
         long prevSize = _baseStorageSize;
         if (prevSize < size)
@@ -1194,9 +1263,14 @@ public class BufferedStorage : IStorage
     {
         Assert.SdkRequires(IsInitialized());
 
+        // Read-ahead could otherwise add data it read before the invalidation
+        using var readAheadPause = new ScopedReadAheadPause(this);
+
         using var cache = new SharedCache(this);
         while (cache.AcquireNextValidCache())
             cache.Invalidate();
+
+        _readAhead?.Reset();
     }
 
     /// <summary>
@@ -1207,6 +1281,54 @@ public class BufferedStorage : IStorage
 
     public void EnableBulkRead() => _bulkReadEnabled = true;
 
+    /// <summary>
+    /// Enables reading blocks ahead of sequential reads. The blocks are read from the base storage with a
+    /// single read, so a base storage that verifies or decrypts data can process them in one pass.
+    /// </summary>
+    /// <remarks><para>Only reads of a single block or less are tracked, because larger reads bypass the cache.
+    /// The read-ahead window is limited to half the number of caches so prefetched blocks aren't evicted
+    /// before they're read. Read-ahead isn't enabled if there are fewer than 2 caches.</para>
+    /// <para>Blocks are read ahead on the thread that triggered the read-ahead after its own read is done.
+    /// Use <see cref="EnableReadAhead(int, IThreadPool)"/> to read ahead on another thread.</para>
+    /// <para>Read-ahead is paused while the storage is written to, resized or has its cache invalidated.
+    /// Prefetched blocks are read from the base storage before they're added to the cache, so a write reaching
+    /// the base storage in between could otherwise be hidden by the older prefetched data.</para>
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="maxBlockCount">The maximum number of blocks to read ahead.</param>
+    public void EnableReadAhead(int maxBlockCount)
+    {
+        EnableReadAhead(maxBlockCount, null);
+    }
+
+    /// <summary>
+    /// Enables reading blocks ahead of sequential reads, queueing the reads on <paramref name="threadPool"/>
+    /// so they don't delay the read that triggered them. See <see cref="EnableReadAhead(int)"/>.
+    /// </summary>
+    /// <remarks><para>Only one read-ahead runs at a time. Requests made while one is running are merged and
+    /// run once it's done. If the thread pool has been disposed, blocks are read ahead on the reading thread.</para>
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="maxBlockCount">The maximum number of blocks to read ahead.</param>
+    /// <param name="threadPool">The thread pool to read ahead on, or <see langword="null"/> to read ahead on
+    /// the reading thread. The caller keeps ownership of the thread pool and must not dispose it before
+    /// this storage.</param>
+    public void EnableReadAhead(int maxBlockCount, IThreadPool threadPool)
+    {
+        Assert.SdkRequires(IsInitialized());
+        Assert.SdkRequiresGreater(maxBlockCount, 0);
+
+        int windowBlockCount = Math.Min(maxBlockCount, _cacheCount / 2);
+
+        _readAheadThreadPool = threadPool;
+        _readAhead = windowBlockCount > 0 ? new ReadAheadController(windowBlockCount) : null;
+    }
+
+    /// <summary>
+    /// Gets the read-ahead statistics for this storage.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <returns>The statistics, or empty statistics if read-ahead isn't enabled.</returns>
+    public ReadAheadStatistics GetReadAheadStatistics() => _readAhead?.GetStatistics() ?? default;
+
     /// <summary>
     /// Flushes the cache to the base <see cref="IStorage"/> if less than 1/8 of the
     /// <see cref="IBufferManager"/>'s space can be used for allocation.
@@ -1345,6 +1467,7 @@ public class BufferedStorage : IStorage
                 if (!cache.AcquireNextOverlappedCache(currentOffset, currentSize))
                 {
                     // The block wasn't in the cache. Read the block from the base storage
+                    StorageTracer.ReportCacheMiss();
                     Result res = PrepareAllocation();
                     if (res.IsFailure()) return res.Miss();
 
@@ -1373,6 +1496,10 @@ public class BufferedStorage : IStorage
                     res = ControlDirtiness();
                     if (res.IsFailure()) return res.Miss();
                 }
+                else
+                {
+                    StorageTracer.ReportCacheHit();
+                }
 
                 // Copy the data from the cache buffer to the destination buffer
                 cache.Read(currentOffset, currentDestination);
@@ -1447,6 +1574,7 @@ public class BufferedStorage : IStorage
             if (!cache.AcquireNextOverlappedCache(offset, currentSize))
                 break;
 
+            StorageTracer.ReportCacheHit();
             cache.Read(offset, buffer.Slice((int)bufferOffset, (int)currentSize));
             offset += currentSize;
             bufferOffset += currentSize;
@@ -1488,6 +1616,7 @@ public class BufferedStorage : IStorage
             if (!cache.AcquireNextOverlappedCache(currentOffset, currentSize))
                 break;
 
+            StorageTracer.ReportCacheHit();
             int currentBufferOffset = (int)(bufferOffset + currentOffset - offset);
             cache.Read(currentOffset, buffer.Slice(currentBufferOffset, (int)currentSize));
             size -= currentSize;
@@ -1627,6 +1756,257 @@ public class BufferedStorage : IStorage
         return Result.Success;
     }
 
+    /// <summary>
+    /// Records a completed read with the read-ahead controller and requests a read-ahead if it detected a
+    /// sequential stream.
+    /// </summary>
+    /// <param name="readAhead">The read-ahead controller to record the read with.</param>
+    /// <param name="offset">The offset of the read.</param>
+    /// <param name="size">The size of the read.</param>
+    private void UpdateReadAhead(ReadAheadController readAhead, long offset, long size)
+    {
+        size = Math.Min(size, _baseStorageSize - offset);
+        if (size <= 0 || size > _blockSize)
+            return;
+
+        long blockIndex = offset / _blockSize;
+        int blockCount = (int)((offset + size - 1) / _blockSize - blockIndex + 1);
+
+        int readAheadBlockCount = readAhead.OnRead(blockIndex, blockCount, out long readAheadBlockIndex);
+        if (readAheadBlockCount == 0)
+            return;
+
+        IThreadPool threadPool;
+        long requestId;
+
+        lock (_readAheadLocker)
+        {
+            if (_readAheadPauseCount != 0)
+                return;
+
+            // Extend the pending request if this one continues it. Otherwise the newer request replaces it.
+            if (_pendingReadAheadBlockCount != 0 && _pendingReadAhead == readAhead &&
+                _pendingReadAheadBlockIndex + _pendingReadAheadBlockCount == readAheadBlockIndex)
+            {
+                _pendingReadAheadBlockCount += readAheadBlockCount;
+            }
+            else
+            {
+                _pendingReadAhead = readAhead;
+                _pendingReadAheadBlockIndex = readAheadBlockIndex;
+                _pendingReadAheadBlockCount = readAheadBlockCount;
+            }
+
+            // A queued or running read-ahead will pick up the pending request
+            if (_isReadAheadQueued || _isReadAheadRunning)
+                return;
+
+            _isReadAheadQueued = true;
+            requestId = ++_readAheadRequestId;
+            threadPool = _readAheadThreadPool;
+        }
+
+        if (threadPool is null || !threadPool.TryQueue(new ReadAheadWork(this, requestId)))
+        {
+            RunReadAhead(requestId);
+        }
+    }
+
+    /// <summary>
+    /// Runs a queued read-ahead request and any requests that are made while it's running.
+    /// </summary>
+    /// <param name="requestId">The ID the request was queued with. Nothing is done if the request
+    /// was canceled before it started.</param>
+    private void RunReadAhead(long requestId)
+    {
+        lock (_readAheadLocker)
+        {
+            if (!_isReadAheadQueued || _readAheadRequestId != requestId)
+                return;
+
+            _isReadAheadQueued = false;
+            _isReadAheadRunning = true;
+        }
+
+        bool isFinished = false;
+
+        try
+        {
+            while (TryGetPendingReadAhead(out ReadAheadController readAhead, out long blockIndex, out int blockCount))
+            {
+                // Read-ahead failures don't affect any reads. Any errors will be returned if the blocks are actually read.
+                ReadAhead(readAhead, blockIndex, blockCount).IgnoreResult();
+            }
+
+            isFinished = true;
+        }
+        finally
+        {
+            if (!isFinished)
+            {
+                lock (_readAheadLocker)
+                {
+                    _isReadAheadRunning = false;
+                    Monitor.PulseAll(_readAheadLocker);
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Takes the pending read-ahead request, or marks read-ahead as no longer running if there isn't one
+    /// or read-ahead is paused.
+    /// </summary>
+    private bool TryGetPendingReadAhead(out ReadAheadController readAhead, out long blockIndex, out int blockCount)
+    {
+        lock (_readAheadLocker)
+        {
+            if (_readAheadPauseCount != 0 || _pendingReadAheadBlockCount == 0)
+            {
+                readAhead = null;
+                blockIndex = 0;
+                blockCount = 0;
+
+                _isReadAheadRunning = false;
+                Monitor.PulseAll(_readAheadLocker);
+                return false;
+            }
+
+            readAhead = _pendingReadAhead;
+            blockIndex = _pendingReadAheadBlockIndex;
+            blockCount = _pendingReadAheadBlockCount;
+
+            _pendingReadAhead = null;
+            _pendingReadAheadBlockCount = 0;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Cancels any read-ahead that hasn't started and waits for any that's running to finish.
+    /// No new read-ahead is started until <see cref="ResumeReadAhead"/> is called.
+    /// </summary>
+    private void PauseReadAhead()
+    {
+        lock (_readAheadLocker)
+        {
+            _readAheadPauseCount++;
+
+            _pendingReadAhead = null;
+            _pendingReadAheadBlockCount = 0;
+            _isReadAheadQueued = false;
+
+            while (_isReadAheadRunning)
+            {
+                Monitor.Wait(_readAheadLocker);
+            }
+        }
+    }
+
+    private void ResumeReadAhead()
+    {
+        lock (_readAheadLocker)
+        {
+            Assert.SdkAssert(_readAheadPauseCount > 0);
+            _readAheadPauseCount--;
+        }
+    }
+
+    /// <summary>
+    /// Reads blocks from the base <see cref="IStorage"/> with a single read and adds them to the cache.
+    /// </summary>
+    /// <remarks>Only the first run of blocks in the range that aren't already cached is read.
+    /// Reading over a cached block could replace its unflushed data with older data from the base storage.</remarks>
+    /// <param name="readAhead">The read-ahead controller to record the prefetched blocks with.</param>
+    /// <param name="blockIndex">The index of the first block to read.</param>
+    /// <param name="blockCount">The number of blocks to read.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    private Result ReadAhead(ReadAheadController readAhead, long blockIndex, int blockCount)
+    {
+        Result res;
+
+        long storageBlockCount = BitUtil.DivideUp(_baseStorageSize, _blockSize);
+        blockCount = (int)Math.Min(blockCount, storageBlockCount - blockIndex);
+
+        // Skip any blocks at the start of the range that are already cached
+        while (blockCount > 0 && IsBlockCached(blockIndex))
+        {
+            blockIndex++;
+            blockCount--;
+        }
+
+        // Stop at the next cached block
+        int readBlockCount = 0;
+        while (readBlockCount < blockCount && !IsBlockCached(blockIndex + readBlockCount))
+        {
+            readBlockCount++;
+        }
+
+        if (readBlockCount == 0)
+            return Result.Success;
+
+        long offset = blockIndex * _blockSize;
+        long size = Math.Min(readBlockCount * _blockSize, _baseStorageSize - offset);
+
+        using var pooledBuffer = new PooledBuffer((int)size, (int)_blockSize);
+        if (pooledBuffer.GetSize() < size)
+        {
+            readBlockCount = pooledBuffer.GetSize() / (int)_blockSize;
+            size = readBlockCount * _blockSize;
+        }
+
+        Span<byte> workBuffer = pooledBuffer.GetBuffer().Slice(0, (int)size);
+
+        long startTimestamp = Stopwatch.GetTimestamp();
+
+        res = _baseStorage.Read(offset, workBuffer);
+        if (res.IsFailure()) return res.Miss();
+
+        long elapsedTicks = Stopwatch.GetTimestamp() - startTimestamp;
+
+        res = PrepareAllocation();
+        if (res.IsFailure()) return res.Miss();
+
+        for (int i = 0; i < readBlockCount; i++)
+        {
+            long blockOffset = offset + i * _blockSize;
+
+            using var cache = new SharedCache(this);
+
+            // Another thread may have cached the block while it was being read.
+            if (cache.AcquireNextOverlappedCache(blockOffset, 1))
+                continue;
+
+            while (true)
+            {
+                if (!cache.AcquireFetchableCache())
+                    return ResultFs.OutOfResource.Log();
+
+                using var fetchCache = new UniqueCache(this);
+                (Result Result, bool wasUpgradeSuccessful) upgradeResult = fetchCache.Upgrade(in cache);
+                if (upgradeResult.Result.IsFailure())
+                    return upgradeResult.Result.Miss();
+
+                if (upgradeResult.wasUpgradeSuccessful)
+                {
+                    res = fetchCache.FetchFromBuffer(blockOffset, workBuffer.Slice((int)(blockOffset - offset)));
+                    if (res.IsFailure()) return res.Miss();
+                    break;
+                }
+            }
+        }
+
+        readAhead.OnPrefetched(blockIndex, readBlockCount, elapsedTicks);
+
+        return ControlDirtiness().Miss();
+    }
+
+    private bool IsBlockCached(long blockIndex)
+    {
+        using var cache = new SharedCache(this);
+        return cache.AcquireNextOverlappedCache(blockIndex * _blockSize, 1);
+    }
+
     private Result WriteCore(long offset, ReadOnlySpan<byte> source)
     {
         Assert.SdkRequiresNotNull(_caches);
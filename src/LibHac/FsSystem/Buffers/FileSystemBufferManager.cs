@@ -1,7 +1,9 @@
 ﻿using System;
 using System.Collections.Generic;
+using System.Numerics;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Threading;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
@@ -16,7 +18,11 @@ namespace LibHac.FsSystem;
 /// <summary>
 /// An <see cref="IBufferManager"/> that uses a <see cref="FileSystemBuddyHeap"/> as an allocator.
 /// </summary>
-/// <remarks>Based on nnSdk 13.4.0 (FS 13.1.0)</remarks>
+/// <remarks><para>Based on nnSdk 13.4.0 (FS 13.1.0)</para>
+/// <para>Addition: When created with a shard count greater than 1 the cache handle table is split into
+/// independently locked shards, and freed buffers of the smallest orders are kept in per-shard magazines in front
+/// of the buddy heap. Only magazine refills and flushes take the heap lock. The shard used by an operation is chosen
+/// from the current processor.</para></remarks>
 public class FileSystemBufferManager : IBufferManager
 {
     private class CacheHandleTable : IDisposable
@@ -40,7 +46,7 @@ public class FileSystemBufferManager : IBufferManager
             public readonly BufferAttribute GetBufferAttribute() => _attribute;
         }
 
-        private struct AttrInfo
+        public struct AttrInfo
         {
             private int _level;
             private int _cacheCount;
@@ -67,6 +73,24 @@ public class FileSystemBufferManager : IBufferManager
             }
         }
 
+        // Addition: The attribute accounting of a sharded table. Every shard counts its buffers in the same list, so
+        // the minimum cache count and size kept by eviction apply to the whole cache like they do for a single table.
+        public class SharedAttrInfo
+        {
+            public readonly SdkMutex Mutex;
+            public readonly LinkedList<AttrInfo> List;
+            public readonly int CacheCountMin;
+            public readonly int CacheSizeMin;
+
+            public SharedAttrInfo(int maxCacheCount)
+            {
+                Mutex = new SdkMutex();
+                List = new LinkedList<AttrInfo>();
+                CacheCountMin = maxCacheCount / 16;
+                CacheSizeMin = CacheCountMin * 0x100;
+            }
+        }
+
         private Entry[] _entries;
         private int _entryCount;
         private int _entryCountMax;
@@ -76,6 +100,12 @@ public class FileSystemBufferManager : IBufferManager
         private int _totalCacheSize;
         private CacheHandle _currentHandle;
 
+        // Addition: Used when the table is one shard of a sharded table
+        private StrongBox<CacheHandle> _sharedHandleCounter;
+        private int _shardIndex;
+        private int _shardShift;
+        private SharedAttrInfo _sharedAttrInfo;
+
         public CacheHandleTable()
         {
             _attrList = new LinkedList<AttrInfo>();
@@ -130,6 +160,28 @@ public class FileSystemBufferManager : IBufferManager
             return Result.Success;
         }
 
+        public Result Initialize(int maxCacheCount, StrongBox<CacheHandle> sharedHandleCounter, int shardIndex,
+            int shardShift, SharedAttrInfo sharedAttrInfo)
+        {
+            Assert.SdkRequiresNotNull(sharedHandleCounter);
+            Assert.SdkRequiresNotNull(sharedAttrInfo);
+            Assert.SdkRequiresInRange(shardIndex, 0, 1 << shardShift);
+
+            Result res = Initialize(maxCacheCount);
+            if (res.IsFailure()) return res.Miss();
+
+            _sharedHandleCounter = sharedHandleCounter;
+            _shardIndex = shardIndex;
+            _shardShift = shardShift;
+
+            _sharedAttrInfo = sharedAttrInfo;
+            _attrList = sharedAttrInfo.List;
+            _cacheCountMin = sharedAttrInfo.CacheCountMin;
+            _cacheSizeMin = sharedAttrInfo.CacheSizeMin;
+
+            return Result.Success;
+        }
+
         public void FinalizeObject()
         {
             if (_entries is null)
@@ -169,6 +221,8 @@ public class FileSystemBufferManager : IBufferManager
             if (Unsafe.IsNullRef(ref entry))
                 return false;
 
+            using UniqueLock<SdkMutex> lk = LockAttrInfo();
+
             // Get the attr info. If we have one, increment.
             ref AttrInfo attrInfo = ref FindAttrInfo(attr);
             if (!Unsafe.IsNullRef(ref attrInfo))
@@ -203,6 +257,7 @@ public class FileSystemBufferManager : IBufferManager
             {
                 if (_entries[i].GetHandle() == handle)
                 {
+                    using UniqueLock<SdkMutex> lk = LockAttrInfo();
                     UnregisterCore(out buffer, ref _entries[i]);
                     return true;
                 }
@@ -239,6 +294,8 @@ public class FileSystemBufferManager : IBufferManager
                 return ccm < attrInfo.GetCacheCount() && csm + entry.GetSize() <= attrInfo.GetCacheSize();
             }
 
+            using UniqueLock<SdkMutex> lk = LockAttrInfo();
+
             // Find an entry, falling back to the first entry.
             ref Entry entry = ref Unsafe.NullRef<Entry>();
             for (int i = 0; i < _entryCount; i++)
@@ -292,7 +349,14 @@ public class FileSystemBufferManager : IBufferManager
         public CacheHandle PublishCacheHandle()
         {
             Assert.SdkRequires(_entries != null);
-            return ++_currentHandle;
+
+            if (_sharedHandleCounter is null)
+                return ++_currentHandle;
+
+            // Shard handles keep the shard index in their low bits so they can be routed back to the shard that
+            // issued them. The counter is shared by all shards so handles from different shards are ordered by age.
+            CacheHandle count = Interlocked.Increment(ref _sharedHandleCounter.Value);
+            return count << _shardShift | (uint)_shardIndex;
         }
 
         public int GetTotalCacheSize()
@@ -300,6 +364,13 @@ public class FileSystemBufferManager : IBufferManager
             return _totalCacheSize;
         }
 
+        public CacheHandle GetOldestHandle()
+        {
+            Assert.SdkRequiresNotNull(_entries);
+
+            return _entryCount == 0 ? CacheHandle.MaxValue : _entries[0].GetHandle();
+        }
+
         private ref Entry AcquireEntry(Buffer buffer, BufferAttribute attr)
         {
             // Validate pre-conditions.
@@ -342,6 +413,13 @@ public class FileSystemBufferManager : IBufferManager
             _entryCount--;
         }
 
+        private UniqueLock<SdkMutex> LockAttrInfo()
+        {
+            // Shards update the shared attribute list while holding only their own lock.
+            // A single table is protected by the buffer manager's lock.
+            return _sharedAttrInfo is null ? default : new UniqueLock<SdkMutex>(_sharedAttrInfo.Mutex);
+        }
+
         private ref AttrInfo FindAttrInfo(BufferAttribute attr)
         {
             LinkedListNode<AttrInfo> curNode = _attrList.First;
@@ -360,6 +438,40 @@ public class FileSystemBufferManager : IBufferManager
         }
     }
 
+    private class CacheShard
+    {
+        public SdkMutexType Mutex;
+        public readonly CacheHandleTable Table;
+
+        public CacheShard()
+        {
+            Mutex = new SdkMutexType();
+            Table = new CacheHandleTable();
+        }
+    }
+
+    private class Magazine
+    {
+        public SdkMutexType Mutex;
+        public readonly Buffer[] Buffers;
+        public int Count;
+
+        public Magazine(int capacity)
+        {
+            Mutex = new SdkMutexType();
+            Buffers = new Buffer[capacity];
+        }
+    }
+
+    /// <summary>The maximum number of shards a <see cref="FileSystemBufferManager"/> can be split into.</summary>
+    public const int ShardCountMax = 64;
+
+    private const int MagazineOrderCount = 4;
+    private const int MagazineCapacityMax = 8;
+
+    // All magazines of a single order may hold at most this fraction of the heap
+    private const int MagazineHeapFractionShift = 4;
+
     private FileSystemBuddyHeap _buddyHeap;
     private CacheHandleTable _cacheTable;
     private int _totalSize;
@@ -368,46 +480,132 @@ public class FileSystemBufferManager : IBufferManager
     private int _retriedCount;
     private SdkMutexType _mutex;
 
-    public FileSystemBufferManager()
+    // Addition: Sharded mode. _mutex only guards the buddy heap in this mode.
+    private readonly int _shardCount;
+    private CacheShard[] _cacheShards;
+    private Magazine[] _magazines;
+    private int _freeSize;
+    private int _totalCacheSize;
+
+    public FileSystemBufferManager() : this(1) { }
+
+    /// <summary>
+    /// Creates a <see cref="FileSystemBufferManager"/> that can be used concurrently by about
+    /// <paramref name="shardCount"/> threads without them serializing on a single lock.
+    /// </summary>
+    /// <param name="shardCount">The number of cache table shards and magazine sets. This is rounded up to a power
+    /// of 2 and clamped to <see cref="ShardCountMax"/>. A value of 1 gives the original single-lock behavior.</param>
+    public FileSystemBufferManager(int shardCount)
     {
         _buddyHeap = new FileSystemBuddyHeap();
         _cacheTable = new CacheHandleTable();
         _mutex = new SdkMutexType();
+        _shardCount = (int)BitOperations.RoundUpToPowerOf2((uint)Math.Clamp(shardCount, 1, ShardCountMax));
     }
 
+    /// <summary>
+    /// The shard count to use for a <see cref="FileSystemBufferManager"/> shared by every processor in the system.
+    /// </summary>
+    public static int DefaultShardCount =>
+        (int)BitOperations.RoundUpToPowerOf2((uint)Math.Min(Environment.ProcessorCount, ShardCountMax));
+
+    public int GetShardCount() => _shardCount;
+
     public override void Dispose()
     {
+        if (_cacheShards is not null)
+        {
+            foreach (CacheShard shard in _cacheShards)
+            {
+                shard.Table.Dispose();
+            }
+        }
+
         _cacheTable.Dispose();
         _buddyHeap.Dispose();
         base.Dispose();
     }
 
+    private Result InitializeCacheTable(int maxCacheCount)
+    {
+        if (_shardCount == 1)
+            return _cacheTable.Initialize(maxCacheCount);
+
+        var handleCounter = new StrongBox<CacheHandle>();
+        var attrInfo = new CacheHandleTable.SharedAttrInfo(maxCacheCount);
+        int shardShift = BitOperations.Log2((uint)_shardCount);
+
+        _cacheShards = new CacheShard[_shardCount];
+
+        for (int i = 0; i < _cacheShards.Length; i++)
+        {
+            // Split the entries as evenly as possible so the total stays the same.
+            int shardCacheCount = maxCacheCount / _shardCount + (i < maxCacheCount % _shardCount ? 1 : 0);
+
+            _cacheShards[i] = new CacheShard();
+            Result res = _cacheShards[i].Table.Initialize(shardCacheCount, handleCounter, i, shardShift, attrInfo);
+            if (res.IsFailure()) return res.Miss();
+        }
+
+        return Result.Success;
+    }
+
+    private void InitializeStats()
+    {
+        _totalSize = (int)_buddyHeap.GetTotalFreeSize();
+        _peakFreeSize = _totalSize;
+        _peakTotalAllocatableSize = _totalSize;
+
+        if (_shardCount == 1)
+            return;
+
+        _freeSize = _totalSize;
+        _magazines = new Magazine[_shardCount * MagazineOrderCount];
+
+        for (int order = 0; order < MagazineOrderCount; order++)
+        {
+            // Limit how much of the heap can sit in magazines. Orders too large to get any magazine space
+            // always go straight to the heap.
+            int capacity = 0;
+            if (order <= _buddyHeap.GetOrderMax())
+            {
+                long orderBytes = (long)_buddyHeap.GetBytesFromOrder(order);
+                long capacityLimit = (_totalSize >> MagazineHeapFractionShift) / (orderBytes * _shardCount);
+                capacity = (int)Math.Min(capacityLimit, MagazineCapacityMax);
+            }
+
+            if (capacity == 0)
+                continue;
+
+            for (int shard = 0; shard < _shardCount; shard++)
+            {
+                _magazines[shard * MagazineOrderCount + order] = new Magazine(capacity);
+            }
+        }
+    }
+
     public Result Initialize(int maxCacheCount, Memory<byte> heapBuffer, int blockSize)
     {
-        Result res = _cacheTable.Initialize(maxCacheCount);
+        Result res = InitializeCacheTable(maxCacheCount);
         if (res.IsFailure()) return res.Miss();
 
         res = _buddyHeap.Initialize(heapBuffer, blockSize);
         if (res.IsFailure()) return res.Miss();
 
-        _totalSize = (int)_buddyHeap.GetTotalFreeSize();
-        _peakFreeSize = _totalSize;
-        _peakTotalAllocatableSize = _totalSize;
+        InitializeStats();
 
         return Result.Success;
     }
 
     public Result Initialize(int maxCacheCount, Memory<byte> heapBuffer, int blockSize, int maxOrder)
     {
-        Result res = _cacheTable.Initialize(maxCacheCount);
+        Result res = InitializeCacheTable(maxCacheCount);
         if (res.IsFailure()) return res.Miss();
 
         res = _buddyHeap.Initialize(heapBuffer, blockSize, maxOrder);
         if (res.IsFailure()) return res.Miss();
 
-        _totalSize = (int)_buddyHeap.GetTotalFreeSize();
-        _peakFreeSize = _totalSize;
-        _peakTotalAllocatableSize = _totalSize;
+        InitializeStats();
 
         return Result.Success;
     }
@@ -417,15 +615,13 @@ public class FileSystemBufferManager : IBufferManager
         // Note: We can't use an external buffer for the cache handle table since it contains managed pointers,
         // so pass the work buffer directly to the buddy heap.
 
-        Result res = _cacheTable.Initialize(maxCacheCount);
+        Result res = InitializeCacheTable(maxCacheCount);
         if (res.IsFailure()) return res.Miss();
 
         res = _buddyHeap.Initialize(heapBuffer, blockSize, workBuffer);
         if (res.IsFailure()) return res.Miss();
 
-        _totalSize = (int)_buddyHeap.GetTotalFreeSize();
-        _peakFreeSize = _totalSize;
-        _peakTotalAllocatableSize = _totalSize;
+        InitializeStats();
 
         return Result.Success;
     }
@@ -436,21 +632,22 @@ public class FileSystemBufferManager : IBufferManager
         // Note: We can't use an external buffer for the cache handle table since it contains managed pointers,
         // so pass the work buffer directly to the buddy heap.
 
-        Result res = _cacheTable.Initialize(maxCacheCount);
+        Result res = InitializeCacheTable(maxCacheCount);
         if (res.IsFailure()) return res.Miss();
 
         res = _buddyHeap.Initialize(heapBuffer, blockSize, maxOrder, workBuffer);
         if (res.IsFailure()) return res.Miss();
 
-        _totalSize = (int)_buddyHeap.GetTotalFreeSize();
-        _peakFreeSize = _totalSize;
-        _peakTotalAllocatableSize = _totalSize;
+        InitializeStats();
 
         return Result.Success;
     }
 
     protected override Buffer DoAllocateBuffer(int size, BufferAttribute attribute)
     {
+        if (_cacheShards is not null)
+            return AllocateBufferSharded(size, attribute);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return AllocateBufferImpl(size, attribute);
@@ -493,6 +690,12 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override void DoDeallocateBuffer(Buffer buffer)
     {
+        if (_cacheShards is not null)
+        {
+            DeallocateBufferSharded(buffer);
+            return;
+        }
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         DeallocateBufferImpl(buffer);
@@ -507,6 +710,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override CacheHandle DoRegisterCache(Buffer buffer, BufferAttribute attribute)
     {
+        if (_cacheShards is not null)
+            return RegisterCacheSharded(buffer, attribute);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return RegisterCacheImpl(buffer, attribute);
@@ -539,6 +745,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override Buffer DoAcquireCache(CacheHandle handle)
     {
+        if (_cacheShards is not null)
+            return AcquireCacheSharded(handle);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return AcquireCacheImpl(handle);
@@ -566,6 +775,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override int DoGetFreeSize()
     {
+        if (_cacheShards is not null)
+            return Volatile.Read(ref _freeSize);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return GetFreeSizeImpl();
@@ -578,6 +790,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override int DoGetTotalAllocatableSize()
     {
+        if (_cacheShards is not null)
+            return Volatile.Read(ref _freeSize) + Volatile.Read(ref _totalCacheSize);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return GetTotalAllocatableSizeImpl();
@@ -590,6 +805,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override int DoGetFreeSizePeak()
     {
+        if (_cacheShards is not null)
+            return Volatile.Read(ref _peakFreeSize);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return GetFreeSizePeakImpl();
@@ -602,6 +820,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override int DoGetTotalAllocatableSizePeak()
     {
+        if (_cacheShards is not null)
+            return Volatile.Read(ref _peakTotalAllocatableSize);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return GetTotalAllocatableSizePeakImpl();
@@ -614,6 +835,9 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override int DoGetRetriedCount()
     {
+        if (_cacheShards is not null)
+            return Volatile.Read(ref _retriedCount);
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         return GetRetriedCountImpl();
@@ -626,6 +850,15 @@ public class FileSystemBufferManager : IBufferManager
 
     protected override void DoClearPeak()
     {
+        if (_cacheShards is not null)
+        {
+            int freeSize = Volatile.Read(ref _freeSize);
+            Volatile.Write(ref _peakFreeSize, freeSize);
+            Volatile.Write(ref _peakTotalAllocatableSize, freeSize + Volatile.Read(ref _totalCacheSize));
+            Volatile.Write(ref _retriedCount, 0);
+            return;
+        }
+
         using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
 
         ClearPeakImpl();
@@ -637,4 +870,292 @@ public class FileSystemBufferManager : IBufferManager
         _peakTotalAllocatableSize = GetTotalAllocatableSizeImpl();
         _retriedCount = 0;
     }
+
+    private int GetCurrentShardIndex()
+    {
+        return System.Threading.Thread.GetCurrentProcessorId() & (_shardCount - 1);
+    }
+
+    private Magazine GetMagazine(int shardIndex, int order)
+    {
+        if (order >= MagazineOrderCount)
+            return null;
+
+        return _magazines[shardIndex * MagazineOrderCount + order];
+    }
+
+    private static void UpdatePeak(ref int peak, int value)
+    {
+        int current = Volatile.Read(ref peak);
+
+        while (value < current)
+        {
+            int previous = Interlocked.CompareExchange(ref peak, value, current);
+            if (previous == current)
+                break;
+
+            current = previous;
+        }
+    }
+
+    private Buffer AllocateBufferSharded(int size, BufferAttribute attribute)
+    {
+        int order = _buddyHeap.GetOrderFromBytes((nuint)size);
+        Assert.SdkAssert(order >= 0);
+
+        Buffer buffer = AllocateFromMagazine(GetCurrentShardIndex(), order);
+        bool isMagazinesDrained = false;
+
+        while (buffer.IsNull)
+        {
+            // Buffers sitting in magazines can't be coalesced by the heap.
+            // Return them to the heap before evicting anything from the cache.
+            if (!isMagazinesDrained)
+            {
+                isMagazinesDrained = true;
+
+                if (DrainMagazines())
+                {
+                    buffer = AllocateFromHeap(order);
+                    continue;
+                }
+            }
+
+            // Not enough space in heap. Deallocate cached buffer and try again.
+            Interlocked.Increment(ref _retriedCount);
+
+            if (!UnregisterOldestSharded(out Buffer deallocateBuffer, attribute, size))
+            {
+                // No cached buffers left to deallocate.
+                return Buffer.Empty;
+            }
+
+            Interlocked.Add(ref _freeSize, deallocateBuffer.Length);
+            Interlocked.Add(ref _totalCacheSize, -deallocateBuffer.Length);
+            FreeToHeap(deallocateBuffer);
+
+            buffer = AllocateFromHeap(order);
+        }
+
+        // Successfully allocated a buffer.
+        int allocatedSize = (int)_buddyHeap.GetBytesFromOrder(order);
+        Assert.SdkAssert(size <= allocatedSize);
+
+        // Update heap stats
+        int freeSize = Interlocked.Add(ref _freeSize, -allocatedSize);
+        UpdatePeak(ref _peakFreeSize, freeSize);
+        UpdatePeak(ref _peakTotalAllocatableSize, freeSize + Volatile.Read(ref _totalCacheSize));
+
+        return buffer;
+    }
+
+    private Buffer AllocateFromMagazine(int shardIndex, int order)
+    {
+        Magazine magazine = GetMagazine(shardIndex, order);
+        if (magazine is null)
+            return AllocateFromHeap(order);
+
+        using var lk = new ScopedLock<SdkMutexType>(ref magazine.Mutex);
+
+        if (magazine.Count == 0)
+        {
+            // Refill half of the magazine with a single trip to the heap.
+            using var heapLock = new ScopedLock<SdkMutexType>(ref _mutex);
+
+            int refillCount = Math.Max(magazine.Buffers.Length / 2, 1);
+            while (magazine.Count < refillCount)
+            {
+                Buffer newBuffer = _buddyHeap.AllocateBufferByOrder(order);
+                if (newBuffer.IsNull)
+                    break;
+
+                magazine.Buffers[magazine.Count++] = newBuffer;
+            }
+
+            if (magazine.Count == 0)
+                return Buffer.Empty;
+        }
+
+        magazine.Count--;
+        Buffer buffer = magazine.Buffers[magazine.Count];
+        magazine.Buffers[magazine.Count] = Buffer.Empty;
+
+        return buffer;
+    }
+
+    private Buffer AllocateFromHeap(int order)
+    {
+        using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
+
+        return _buddyHeap.AllocateBufferByOrder(order);
+    }
+
+    private void DeallocateBufferSharded(Buffer buffer)
+    {
+        Assert.SdkRequires(BitUtil.IsPowerOfTwo(buffer.Length));
+
+        Interlocked.Add(ref _freeSize, buffer.Length);
+        ReleaseToMagazine(GetCurrentShardIndex(), buffer);
+    }
+
+    private void ReleaseToMagazine(int shardIndex, Buffer buffer)
+    {
+        Magazine magazine = GetMagazine(shardIndex, _buddyHeap.GetOrderFromBytes((nuint)buffer.Length));
+        if (magazine is null)
+        {
+            FreeToHeap(buffer);
+            return;
+        }
+
+        using var lk = new ScopedLock<SdkMutexType>(ref magazine.Mutex);
+
+        if (magazine.Count == magazine.Buffers.Length)
+        {
+            // Return the older half of the magazine to the heap with a single trip to the heap.
+            int flushCount = Math.Max(magazine.Count / 2, 1);
+
+            using (new ScopedLock<SdkMutexType>(ref _mutex))
+            {
+                for (int i = 0; i < flushCount; i++)
+                {
+                    _buddyHeap.Free(magazine.Buffers[i]);
+                }
+            }
+
+            Array.Copy(magazine.Buffers, flushCount, magazine.Buffers, 0, magazine.Count - flushCount);
+            Array.Clear(magazine.Buffers, magazine.Count - flushCount, flushCount);
+            magazine.Count -= flushCount;
+        }
+
+        magazine.Buffers[magazine.Count++] = buffer;
+    }
+
+    private void FreeToHeap(Buffer buffer)
+    {
+        using var lk = new ScopedLock<SdkMutexType>(ref _mutex);
+
+        _buddyHeap.Free(buffer);
+    }
+
+    private bool DrainMagazines()
+    {
+        bool isAnyDrained = false;
+
+        foreach (Magazine magazine in _magazines)
+        {
+            if (magazine is null)
+                continue;
+
+            using var lk = new ScopedLock<SdkMutexType>(ref magazine.Mutex);
+
+            if (magazine.Count == 0)
+                continue;
+
+            using (new ScopedLock<SdkMutexType>(ref _mutex))
+            {
+                for (int i = 0; i < magazine.Count; i++)
+                {
+                    _buddyHeap.Free(magazine.Buffers[i]);
+                }
+            }
+
+            Array.Clear(magazine.Buffers, 0, magazine.Count);
+            magazine.Count = 0;
+            isAnyDrained = true;
+        }
+
+        return isAnyDrained;
+    }
+
+    private CacheHandle RegisterCacheSharded(Buffer buffer, BufferAttribute attribute)
+    {
+        int shardIndex = GetCurrentShardIndex();
+
+        while (true)
+        {
+            // Prefer the current processor's shard, but use any shard with a free entry before evicting anything.
+            for (int i = 0; i < _shardCount; i++)
+            {
+                CacheShard shard = _cacheShards[(shardIndex + i) & (_shardCount - 1)];
+                using var lk = new ScopedLock<SdkMutexType>(ref shard.Mutex);
+
+                if (shard.Table.Register(out CacheHandle handle, buffer, attribute))
+                {
+                    Interlocked.Add(ref _totalCacheSize, buffer.Length);
+                    return handle;
+                }
+            }
+
+            // Unregister a buffer and try registering again.
+            Interlocked.Increment(ref _retriedCount);
+
+            if (!UnregisterOldestSharded(out Buffer deallocateBuffer, attribute, 0))
+            {
+                // Can't unregister any existing buffers.
+                // Register the input buffer to /dev/null.
+                DeallocateBufferSharded(buffer);
+                return _cacheShards[shardIndex].Table.PublishCacheHandle();
+            }
+
+            // Deallocate the unregistered buffer.
+            Interlocked.Add(ref _freeSize, deallocateBuffer.Length);
+            Interlocked.Add(ref _totalCacheSize, -deallocateBuffer.Length);
+            ReleaseToMagazine(shardIndex, deallocateBuffer);
+        }
+    }
+
+    private bool UnregisterOldestSharded(out Buffer buffer, BufferAttribute attribute, int requiredSize)
+    {
+        UnsafeHelpers.SkipParamInit(out buffer);
+
+        while (true)
+        {
+            // Handles from every shard come from the same counter, so the shard with the smallest first handle
+            // holds the oldest entry. Other threads may change the shards while we look, so this is approximate.
+            int oldestShardIndex = -1;
+            CacheHandle oldestHandle = CacheHandle.MaxValue;
+
+            for (int i = 0; i < _cacheShards.Length; i++)
+            {
+                CacheShard shard = _cacheShards[i];
+                using var lk = new ScopedLock<SdkMutexType>(ref shard.Mutex);
+
+                CacheHandle handle = shard.Table.GetOldestHandle();
+                if (handle < oldestHandle)
+                {
+                    oldestHandle = handle;
+                    oldestShardIndex = i;
+                }
+            }
+
+            if (oldestShardIndex < 0)
+                return false;
+
+            CacheShard oldestShard = _cacheShards[oldestShardIndex];
+            using (new ScopedLock<SdkMutexType>(ref oldestShard.Mutex))
+            {
+                if (oldestShard.Table.UnregisterOldest(out buffer, attribute, requiredSize))
+                    return true;
+            }
+
+            // The shard was emptied by another thread. Look again.
+        }
+    }
+
+    private Buffer AcquireCacheSharded(CacheHandle handle)
+    {
+        CacheShard shard = _cacheShards[(int)(handle & (CacheHandle)(_shardCount - 1))];
+        Buffer range;
+
+        using (new ScopedLock<SdkMutexType>(ref shard.Mutex))
+        {
+            if (!shard.Table.Unregister(out range, handle))
+                return Buffer.Empty;
+        }
+
+        int totalCacheSize = Interlocked.Add(ref _totalCacheSize, -range.Length);
+        UpdatePeak(ref _peakTotalAllocatableSize, Volatile.Read(ref _freeSize) + totalCacheSize);
+
+        return range;
+    }
 }
\ No newline at end of file
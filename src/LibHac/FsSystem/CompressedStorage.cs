@@ -1,10 +1,12 @@
 ﻿// ReSharper disable UnusedMember.Local NotAccessedField.Local
 using System;
 using System.Runtime.CompilerServices;
+using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
 using LibHac.FsSystem.Impl;
 using LibHac.Os;
+using LibHac.Util;
 using Buffer = LibHac.Mem.Buffer;
 using CacheHandle = System.UInt64;
 
@@ -64,6 +66,17 @@ public class CompressedStorage : IStorage, IAsynchronousAccessSplitter
             throw new NotImplementedException();
         }
 
+        /// <summary>
+        /// Sets the cache used to keep decoded nodes of the compression table in memory.
+        /// </summary>
+        /// <remarks>LibHac addition.</remarks>
+        /// <param name="cache">The cache to use. May be shared with other storages.
+        /// <see langword="null"/> disables node caching.</param>
+        public void SetNodeCache(BucketTreeNodeCache cache)
+        {
+            _bucketTree.SetNodeCache(cache);
+        }
+
         public Result Initialize(MemoryResource allocatorForBucketTree, ref readonly ValueSubStorage dataStorage,
             ref readonly ValueSubStorage nodeStorage, ref readonly ValueSubStorage entryStorage,
             int bucketTreeEntryCount, long blockSizeMax, long continuousReadingSizeMax,
@@ -118,7 +131,80 @@ public class CompressedStorage : IStorage, IAsynchronousAccessSplitter
         public Result QueryAppropriateOffsetForAsynchronousAccess(out long offsetAppropriate, long offset,
             long accessSize, long alignmentSize)
         {
-            throw new NotImplementedException();
+            Assert.SdkRequires(IsInitialized());
+            Assert.SdkRequiresLess(0, accessSize);
+            Assert.SdkRequiresLess(0, alignmentSize);
+
+            UnsafeHelpers.SkipParamInit(out offsetAppropriate);
+
+            Result res = _bucketTree.GetOffsets(out BucketTree.Offsets offsets);
+            if (res.IsFailure()) return res.Miss();
+
+            if (!offsets.IsInclude(offset))
+                return ResultFs.OutOfRange.Log();
+
+            using var visitor = new BucketTree.Visitor();
+
+            res = _bucketTree.Find(ref visitor.Ref, offset);
+            if (res.IsFailure()) return res.Miss();
+
+            long entryOffset = visitor.Get<Entry>().VirtualOffset;
+            if (entryOffset < 0 || !offsets.IsInclude(entryOffset))
+                return ResultFs.UnexpectedInCompressedStorageA.Log();
+
+            long targetOffset = offset + accessSize;
+            Entry currentEntry = visitor.Get<Entry>();
+
+            // Find the entry that contains the target offset
+            while (true)
+            {
+                Entry nextEntry = default;
+                long nextEntryOffset;
+
+                if (visitor.CanMoveNext())
+                {
+                    res = visitor.MoveNext();
+                    if (res.IsFailure()) return res.Miss();
+
+                    nextEntry = visitor.Get<Entry>();
+                    nextEntryOffset = nextEntry.VirtualOffset;
+
+                    if (!offsets.IsInclude(nextEntryOffset))
+                        return ResultFs.UnexpectedInCompressedStorageA.Log();
+                }
+                else
+                {
+                    nextEntryOffset = offsets.EndOffset;
+                }
+
+                if (nextEntryOffset >= targetOffset || nextEntryOffset == offsets.EndOffset)
+                {
+                    if (nextEntryOffset <= targetOffset)
+                    {
+                        offsetAppropriate = nextEntryOffset;
+                        return Result.Success;
+                    }
+
+                    // Entries that don't require block alignment can be split anywhere inside them
+                    if (!CompressionTypeUtility.IsBlockAlignmentRequired(currentEntry.CompressionType))
+                    {
+                        long alignedOffset = Alignment.AlignDown(targetOffset, alignmentSize);
+
+                        if (alignedOffset > offset && alignedOffset > currentEntry.VirtualOffset)
+                        {
+                            offsetAppropriate = alignedOffset;
+                            return Result.Success;
+                        }
+                    }
+
+                    // Compressed entries must be decompressed as a whole, so split the request at the start of the
+                    // entry. If the request starts in this entry, split it at the end of the entry instead.
+                    offsetAppropriate = currentEntry.VirtualOffset > offset ? currentEntry.VirtualOffset : nextEntryOffset;
+                    return Result.Success;
+                }
+
+                currentEntry = nextEntry;
+            }
         }
 
         private DecompressorFunction GetDecompressor(CompressionType type)
@@ -315,6 +401,17 @@ public class CompressedStorage : IStorage, IAsynchronousAccessSplitter
         return Result.Success;
     }
 
+    /// <summary>
+    /// Sets the cache used to keep decoded nodes of the compression table in memory.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <param name="cache">The cache to use. May be shared with other storages.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        _core.SetNodeCache(cache);
+    }
+
     public void FinalizeObject()
     {
         _cacheManager.FinalizeObject();
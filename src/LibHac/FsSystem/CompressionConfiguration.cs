@@ -0,0 +1,40 @@
+﻿using LibHac.Fs;
+using LibHac.Util;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// Provides the decompressors used for compressed NCA sections.
+/// </summary>
+/// <remarks>Based on nnSdk 17.5.0 (FS 17.0.0)</remarks>
+public static class CompressionConfiguration
+{
+    private static readonly DecompressorFunction Lz4Decompressor = DecompressLz4;
+
+    public static NcaCompressionConfiguration GetNcaCompressionConfiguration()
+    {
+        return new NcaCompressionConfiguration { GetDecompressorFunc = GetNcaDecompressorFunction };
+    }
+
+    public static DecompressorFunction GetNcaDecompressorFunction(CompressionType type)
+    {
+        switch (type)
+        {
+            case CompressionType.Lz4:
+                return Lz4Decompressor;
+            default:
+                return null;
+        }
+    }
+
+    private static Result DecompressLz4(DecompressionTask task)
+    {
+        if (!Lz4.TryDecompress(task.Source, task.Destination, out int bytesWritten) ||
+            bytesWritten != task.Destination.Length)
+        {
+            return ResultFs.UnexpectedInCompressedStorageC.Log();
+        }
+
+        return Result.Success;
+    }
+}
@@ -138,30 +138,30 @@ public class HierarchicalSha256Storage : IStorage
 
         using var changeThreadPriority = new ScopedThreadPriorityChanger(1, ScopedThreadPriorityChanger.Mode.Relative);
 
-        Span<byte> hash = stackalloc byte[HashSize];
-        ReadOnlySpan<byte> hashBuffer = _hashBuffer.Span;
+        // Generate the hashes of every block that was read at once so they can be calculated in parallel.
+        int blockCount = (int)BitUtil.DivideUp(reducedSize, _hashTargetBlockSize);
+        using var hashes = new RentedArray<byte>(blockCount * HashSize);
 
-        long currentOffset = offset;
-        long remainingSize = reducedSize;
-        while (remainingSize > 0)
-        {
-            long currentSize = Math.Min(_hashTargetBlockSize, remainingSize);
-            res = _hashGeneratorFactory.GenerateHash(hash, destination.Slice((int)(currentOffset - offset), (int)currentSize));
-            if (res.IsFailure()) return res.Miss();
+        res = _hashGeneratorFactory.GenerateHashes(hashes.Span, destination.Slice(0, (int)reducedSize),
+            _hashTargetBlockSize);
+        if (res.IsFailure()) return res.Miss();
 
-            Assert.SdkAssert((currentOffset >> _log2SizeRatio) < _hashBuffer.Length);
+        ReadOnlySpan<byte> hashBuffer = _hashBuffer.Span;
 
-            using (new ScopedLock<SdkMutexType>(ref _mutex))
+        using (new ScopedLock<SdkMutexType>(ref _mutex))
+        {
+            for (int i = 0; i < blockCount; i++)
             {
-                if (!CryptoUtil.IsSameBytes(hash, hashBuffer.Slice((int)(currentOffset >> _log2SizeRatio)), HashSize))
+                long currentOffset = offset + (long)i * _hashTargetBlockSize;
+                Assert.SdkAssert((currentOffset >> _log2SizeRatio) < _hashBuffer.Length);
+
+                if (!CryptoUtil.IsSameBytes(hashes.Span.Slice(i * HashSize, HashSize),
+                        hashBuffer.Slice((int)(currentOffset >> _log2SizeRatio)), HashSize))
                 {
                     destination.Clear();
                     return ResultFs.HierarchicalSha256HashVerificationFailed.Log();
                 }
             }
-
-            currentOffset += currentSize;
-            remainingSize -= currentOffset;
         }
 
         return Result.Success;
@@ -2,6 +2,7 @@
 using System;
 using LibHac.Common;
 using LibHac.Diag;
+using LibHac.Util;
 
 namespace LibHac.FsSystem;
 
@@ -64,8 +65,65 @@ public abstract class IHash256GeneratorFactory : IDisposable
         return DoGenerateHash(hashBuffer, data).Ret();
     }
 
+    /// <summary>
+    /// Splits <paramref name="data"/> into blocks of <paramref name="blockSize"/> bytes and generates the hash of
+    /// <paramref name="salt"/> followed by each block. The final block may be a partial block.
+    /// </summary>
+    /// <remarks>This function is a LibHac addition. Implementations may hash several blocks at once.</remarks>
+    /// <param name="hashBuffer">The buffer that will receive the hashes of each block.</param>
+    /// <param name="data">The data to hash.</param>
+    /// <param name="blockSize">The size of each block.</param>
+    /// <param name="salt">Data that is hashed before each block. May be empty.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result GenerateHashes(Span<byte> hashBuffer, ReadOnlySpan<byte> data, int blockSize,
+        ReadOnlySpan<byte> salt = default)
+    {
+        Assert.SdkRequiresGreater(blockSize, 0);
+        Assert.SdkRequiresGreaterEqual(hashBuffer.Length, BitUtil.DivideUp(data.Length, blockSize) * IHash256Generator.HashSize);
+
+        return DoGenerateHashes(hashBuffer, data, blockSize, salt).Ret();
+    }
+
     protected abstract Result DoCreate(ref UniqueRef<IHash256Generator> outGenerator);
     protected abstract Result DoGenerateHash(Span<byte> hashBuffer, ReadOnlySpan<byte> data);
+
+    protected virtual Result DoGenerateHashes(Span<byte> hashBuffer, ReadOnlySpan<byte> data, int blockSize,
+        ReadOnlySpan<byte> salt)
+    {
+        int hashSize = (int)IHash256Generator.HashSize;
+        int blockCount = (int)BitUtil.DivideUp(data.Length, blockSize);
+
+        if (salt.IsEmpty)
+        {
+            for (int i = 0; i < blockCount; i++)
+            {
+                int offset = i * blockSize;
+                ReadOnlySpan<byte> block = data.Slice(offset, Math.Min(blockSize, data.Length - offset));
+
+                Result res = DoGenerateHash(hashBuffer.Slice(i * hashSize, hashSize), block);
+                if (res.IsFailure()) return res.Miss();
+            }
+
+            return Result.Success;
+        }
+
+        using var generator = new UniqueRef<IHash256Generator>();
+        Result resCreate = DoCreate(ref generator.Ref);
+        if (resCreate.IsFailure()) return resCreate.Miss();
+
+        for (int i = 0; i < blockCount; i++)
+        {
+            int offset = i * blockSize;
+            ReadOnlySpan<byte> block = data.Slice(offset, Math.Min(blockSize, data.Length - offset));
+
+            generator.Get.Initialize();
+            generator.Get.Update(salt);
+            generator.Get.Update(block);
+            generator.Get.GetHash(hashBuffer.Slice(i * hashSize, hashSize));
+        }
+
+        return Result.Success;
+    }
 }
 
 /// <summary>
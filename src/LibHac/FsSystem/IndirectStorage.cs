@@ -120,6 +120,17 @@ public class IndirectStorage : IStorage
         return _table.IsInitialized();
     }
 
+    /// <summary>
+    /// Sets the cache used to keep decoded nodes of the relocation table in memory.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <param name="cache">The cache to use. May be shared with other storages.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        _table.SetNodeCache(cache);
+    }
+
     public Result Initialize(MemoryResource allocator, ref readonly ValueSubStorage tableStorage)
     {
         Unsafe.SkipInit(out BucketTree.Header header);
@@ -1,5 +1,8 @@
 ﻿using System;
 using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Common.FixedArrays;
 using LibHac.Crypto;
@@ -164,6 +167,68 @@ public class IntegrityVerificationStorage : IStorage
         if (destination.Length == 0)
             return Result.Success;
 
+        Result res = PrepareRead(out int readSize, offset, destination);
+        if (res.IsFailure()) return res.Miss();
+
+        // Read all of the data to be validated.
+        res = _dataStorage.Read(offset, destination.Slice(0, readSize));
+        if (res.IsFailure())
+        {
+            destination.Clear();
+            return res.Log();
+        }
+
+        return VerifyReadData(offset, destination);
+    }
+
+    /// <summary>
+    /// Reads data asynchronously and validates its hashes once the data has been read.
+    /// </summary>
+    /// <remarks>Only the read from the data storage is asynchronous. The block hashes are read synchronously
+    /// since they're usually small and cached.
+    /// <para>LibHac addition.</para></remarks>
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        Assert.SdkRequiresNotEqual(0, destination.Length);
+
+        Assert.SdkRequiresAligned(offset, _verificationBlockSize);
+        Assert.SdkRequiresAligned(destination.Length, _verificationBlockSize);
+
+        if (destination.Length == 0)
+            return new ValueTask<Result>(Result.Success);
+
+        Result res = PrepareRead(out int readSize, offset, destination.Span);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        return ReadAsyncImpl(offset, destination, readSize, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncImpl(long offset, Memory<byte> destination, int readSize,
+        CancellationToken cancellationToken)
+    {
+        Result res = await _dataStorage.ReadAsync(offset, destination.Slice(0, readSize), cancellationToken)
+            .ConfigureAwait(false);
+
+        if (res.IsFailure())
+        {
+            destination.Span.Clear();
+            return res.Log();
+        }
+
+        return VerifyReadData(offset, destination.Span);
+    }
+
+    /// <summary>
+    /// Checks the range of a read and clears the padding of a partial last block.
+    /// </summary>
+    /// <param name="readSize">The number of bytes that should be read from the data storage.</param>
+    /// <param name="offset">The offset of the read.</param>
+    /// <param name="destination">The buffer the data will be read into.</param>
+    private Result PrepareRead(out int readSize, long offset, Span<byte> destination)
+    {
+        UnsafeHelpers.SkipParamInit(out readSize);
+
         Result res = _dataStorage.GetSize(out long dataSize);
         if (res.IsFailure()) return res.Miss();
 
@@ -174,7 +239,7 @@ public class IntegrityVerificationStorage : IStorage
         res = CheckAccessRange(offset, destination.Length, alignedDataSize);
         if (res.IsFailure()) return res.Miss();
 
-        int readSize = destination.Length;
+        readSize = destination.Length;
         if (offset + readSize > dataSize)
         {
             // All reads to this storage must be aligned to the block size, but if the last data block is a partial block
@@ -191,26 +256,24 @@ public class IntegrityVerificationStorage : IStorage
             readSize = (int)(dataSize - offset);
         }
 
-        // Read all of the data to be validated.
-        res = _dataStorage.Read(offset, destination.Slice(0, readSize));
-        if (res.IsFailure())
-        {
-            destination.Clear();
-            return res.Log();
-        }
+        return Result.Success;
+    }
 
+    /// <summary>
+    /// Validates the hashes of the data blocks that were read into <paramref name="destination"/>.
+    /// </summary>
+    private Result VerifyReadData(long offset, Span<byte> destination)
+    {
         // Validate the hashes of the read data blocks.
         Result verifyHashResult = Result.Success;
 
-        using var hashGenerator = new UniqueRef<IHash256Generator>();
-        res = _hashGeneratorFactory.Create(ref hashGenerator.Ref);
-        if (res.IsFailure()) return res.Miss();
-
         int signatureCount = destination.Length >> _verificationBlockOrder;
         using var signatureBuffer =
             new PooledBuffer(signatureCount * Unsafe.SizeOf<BlockHash>(), Unsafe.SizeOf<BlockHash>());
         int bufferCount = (int)Math.Min(signatureCount, signatureBuffer.GetSize() / (uint)Unsafe.SizeOf<BlockHash>());
 
+        using var actualHashBuffer = new RentedArray<BlockHash>(bufferCount);
+
         // Loop over each block while validating their signatures
         int verifiedCount = 0;
         while (verifiedCount < signatureCount)
@@ -222,11 +285,20 @@ public class IntegrityVerificationStorage : IStorage
 
             using var changePriority = new ScopedThreadPriorityChanger(1, ScopedThreadPriorityChanger.Mode.Relative);
 
-            for (int i = 1; i < currentCount && currentResult.IsSuccess(); i++)
+            // Calculate the hashes of every block in this batch at once so they can be hashed in parallel.
+            Span<BlockHash> actualHashes = actualHashBuffer.Span.Slice(0, currentCount);
+
+            if (currentResult.IsSuccess())
+            {
+                currentResult = CalcBlockHashes(actualHashes,
+                    destination.Slice(verifiedCount << _verificationBlockOrder, currentCount << _verificationBlockOrder));
+            }
+
+            for (int i = 0; i < currentCount && currentResult.IsSuccess(); i++)
             {
                 int verifiedSize = (verifiedCount + i) << _verificationBlockOrder;
                 ref BlockHash blockHash = ref signatureBuffer.GetBuffer<BlockHash>()[i];
-                currentResult = VerifyHash(destination.Slice(verifiedCount), ref blockHash, ref hashGenerator.Ref);
+                currentResult = VerifyHash(ref blockHash, in actualHashes[i]);
 
                 if (ResultFs.IntegrityVerificationStorageCorrupted.Includes(currentResult))
                 {
@@ -567,11 +639,33 @@ public class IntegrityVerificationStorage : IStorage
         }
     }
 
-    private Result VerifyHash(ReadOnlySpan<byte> buffer, ref BlockHash hash,
-        ref UniqueRef<IHash256Generator> hashGenerator)
+    /// <summary>
+    /// Calculates the hashes of consecutive verification blocks in <paramref name="buffer"/>.
+    /// </summary>
+    private Result CalcBlockHashes(Span<BlockHash> outHashes, ReadOnlySpan<byte> buffer)
     {
-        Assert.SdkRequiresGreaterEqual(buffer.Length, HashSize);
+        Assert.SdkRequiresEqual(outHashes.Length, buffer.Length >> _verificationBlockOrder);
+
+        ReadOnlySpan<byte> salt = _isWritable && _hashSalt.HasValue ? _hashSalt.ValueRo.HashRo : default;
 
+        Result res = _hashGeneratorFactory.GenerateHashes(MemoryMarshal.Cast<BlockHash, byte>(outHashes), buffer,
+            _verificationBlockSize, salt);
+        if (res.IsFailure()) return res.Miss();
+
+        if (_isWritable)
+        {
+            // The hashes of all writable blocks have the validation bit set.
+            for (int i = 0; i < outHashes.Length; i++)
+            {
+                SetValidationBit(ref outHashes[i]);
+            }
+        }
+
+        return Result.Success;
+    }
+
+    private Result VerifyHash(ref BlockHash hash, in BlockHash actualHash)
+    {
         // Writable storages allow using an all-zeros hash to indicate an empty block.
         if (_isWritable)
         {
@@ -582,8 +676,6 @@ public class IntegrityVerificationStorage : IStorage
                 return ResultFs.ClearedRealDataVerificationFailed.Log();
         }
 
-        CalcBlockHash(out BlockHash actualHash, buffer, ref hashGenerator);
-
         if (!CryptoUtil.IsSameBytes(SpanHelpers.AsReadOnlyByteSpan(in hash),
                 SpanHelpers.AsReadOnlyByteSpan(in actualHash), Unsafe.SizeOf<BlockHash>()))
         {
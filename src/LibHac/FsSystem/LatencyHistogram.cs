@@ -0,0 +1,188 @@
+﻿using System;
+using System.Numerics;
+using System.Threading;
+using LibHac.Diag;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// A fixed-size histogram of non-negative values with a bounded relative error, in the style of HdrHistogram.
+/// </summary>
+/// <remarks><para>Values below <see cref="SubBucketCount"/> are counted exactly. Larger values are grouped into
+/// buckets covering each power of 2, with each of those buckets split into <see cref="SubBucketCount"/>
+/// linear sub-buckets. A recorded value's bucket is never more than 1/<see cref="SubBucketCount"/>
+/// of the value away from the value itself.</para>
+/// <para>Recording is lock-free and may be done from multiple threads at once. Reading the histogram while
+/// values are being recorded returns a result that may not include some of those values.</para></remarks>
+public sealed class LatencyHistogram
+{
+    private const int SubBucketBits = 4;
+
+    /// <summary>The number of linear sub-buckets each power of 2 is split into.</summary>
+    public const int SubBucketCount = 1 << SubBucketBits;
+
+    private const int BucketCount = SubBucketCount + (64 - SubBucketBits) * SubBucketCount;
+
+    private readonly long[] _counts;
+    private long _totalCount;
+    private long _totalValue;
+    private long _maxValue;
+
+    /// <summary>The number of values that have been recorded.</summary>
+    public long TotalCount => Interlocked.Read(ref _totalCount);
+
+    /// <summary>The largest value that has been recorded, or 0 if no values have been recorded.</summary>
+    public long MaxValue => Interlocked.Read(ref _maxValue);
+
+    /// <summary>The mean of all recorded values, or 0 if no values have been recorded.</summary>
+    public double Mean
+    {
+        get
+        {
+            long count = TotalCount;
+            return count == 0 ? 0 : (double)Interlocked.Read(ref _totalValue) / count;
+        }
+    }
+
+    public LatencyHistogram()
+    {
+        _counts = new long[BucketCount];
+    }
+
+    /// <summary>
+    /// Adds a value to the histogram. Negative values are recorded as 0.
+    /// </summary>
+    /// <param name="value">The value to record.</param>
+    public void Record(long value)
+    {
+        if (value < 0)
+            value = 0;
+
+        Interlocked.Increment(ref _counts[GetBucketIndex(value)]);
+        Interlocked.Increment(ref _totalCount);
+        Interlocked.Add(ref _totalValue, value);
+
+        long currentMax = Volatile.Read(ref _maxValue);
+        while (value > currentMax)
+        {
+            long previousMax = Interlocked.CompareExchange(ref _maxValue, value, currentMax);
+            if (previousMax == currentMax)
+                break;
+
+            currentMax = previousMax;
+        }
+    }
+
+    /// <summary>
+    /// Gets the value that <paramref name="percentile"/> percent of the recorded values are less than or equal to.
+    /// </summary>
+    /// <param name="percentile">The percentile to get, from 0 to 100.</param>
+    /// <returns>The largest value in the bucket containing the requested percentile, limited to
+    /// <see cref="MaxValue"/>. Returns 0 if no values have been recorded.</returns>
+    public long GetValueAtPercentile(double percentile)
+    {
+        Assert.SdkRequires(percentile >= 0 && percentile <= 100);
+
+        long totalCount = 0;
+        for (int i = 0; i < _counts.Length; i++)
+        {
+            totalCount += Volatile.Read(ref _counts[i]);
+        }
+
+        if (totalCount == 0)
+            return 0;
+
+        // Use the nearest-rank method
+        long targetRank = Math.Max(1, (long)Math.Ceiling(percentile / 100 * totalCount));
+        long rank = 0;
+
+        for (int i = 0; i < _counts.Length; i++)
+        {
+            rank += Volatile.Read(ref _counts[i]);
+
+            if (rank >= targetRank)
+                return Math.Min(GetBucketHighestValue(i), MaxValue);
+        }
+
+        return MaxValue;
+    }
+
+    /// <summary>
+    /// Adds all the values recorded in another histogram to this one.
+    /// </summary>
+    /// <param name="other">The histogram to add.</param>
+    public void Add(LatencyHistogram other)
+    {
+        for (int i = 0; i < _counts.Length; i++)
+        {
+            long count = Volatile.Read(ref other._counts[i]);
+
+            if (count != 0)
+                Interlocked.Add(ref _counts[i], count);
+        }
+
+        Interlocked.Add(ref _totalCount, other.TotalCount);
+        Interlocked.Add(ref _totalValue, Interlocked.Read(ref other._totalValue));
+
+        long otherMax = other.MaxValue;
+        long currentMax = Volatile.Read(ref _maxValue);
+        while (otherMax > currentMax)
+        {
+            long previousMax = Interlocked.CompareExchange(ref _maxValue, otherMax, currentMax);
+            if (previousMax == currentMax)
+                break;
+
+            currentMax = previousMax;
+        }
+    }
+
+    /// <summary>
+    /// Creates a copy of the histogram's current values.
+    /// </summary>
+    /// <returns>The created copy.</returns>
+    public LatencyHistogram Clone()
+    {
+        var copy = new LatencyHistogram();
+        copy.Add(this);
+        return copy;
+    }
+
+    /// <summary>
+    /// Removes all recorded values from the histogram.
+    /// </summary>
+    public void Reset()
+    {
+        for (int i = 0; i < _counts.Length; i++)
+        {
+            Volatile.Write(ref _counts[i], 0);
+        }
+
+        Volatile.Write(ref _totalCount, 0);
+        Volatile.Write(ref _totalValue, 0);
+        Volatile.Write(ref _maxValue, 0);
+    }
+
+    private static int GetBucketIndex(long value)
+    {
+        if (value < SubBucketCount)
+            return (int)value;
+
+        int exponent = BitOperations.Log2((ulong)value);
+        int shift = exponent - SubBucketBits;
+        int subBucket = (int)(value >> shift) - SubBucketCount;
+
+        return SubBucketCount + shift * SubBucketCount + subBucket;
+    }
+
+    private static long GetBucketHighestValue(int index)
+    {
+        if (index < SubBucketCount)
+            return index;
+
+        int shift = (index - SubBucketCount) / SubBucketCount;
+        int subBucket = (index - SubBucketCount) % SubBucketCount;
+        ulong highestValue = ((ulong)(SubBucketCount + subBucket + 1) << shift) - 1;
+
+        return (long)Math.Min(highestValue, long.MaxValue);
+    }
+}
@@ -1,9 +1,12 @@
 ﻿using System;
 using System.IO;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Fs;
 using LibHac.Fs.Fsa;
 using LibHac.Tools.FsSystem;
+using Microsoft.Win32.SafeHandles;
 
 namespace LibHac.FsSystem;
 
@@ -11,22 +14,54 @@ public class LocalFile : IFile
 {
     private FileStream Stream { get; }
     private StreamFile File { get; }
+    private SafeFileHandle Handle { get; }
+    private LocalFileMapping Mapping { get; }
     private OpenMode Mode { get; }
 
-    public LocalFile(string path, OpenMode mode)
-    {
-        LocalFileSystem.OpenFileInternal(out FileStream stream, path, mode).ThrowIfFailure();
+    public LocalFile(string path, OpenMode mode) : this(path, mode, LocalFileIoMode.Stream) { }
+
+    public LocalFile(string path, OpenMode mode, LocalFileIoMode ioMode)
+        : this(OpenFile(path, mode, ioMode), mode, ioMode) { }
+
+    public LocalFile(FileStream stream, OpenMode mode) : this(stream, mode, LocalFileIoMode.Stream) { }
 
+    /// <summary>
+    /// Creates a <see cref="LocalFile"/> that takes ownership of an open <see cref="FileStream"/>.
+    /// </summary>
+    /// <remarks>Streams used with <see cref="LocalFileIoMode.RandomAccess"/> or
+    /// <see cref="LocalFileIoMode.MemoryMapped"/> don't need their own buffer and should be opened with a buffer
+    /// size of 0.</remarks>
+    public LocalFile(FileStream stream, OpenMode mode, LocalFileIoMode ioMode)
+    {
         Mode = mode;
         Stream = stream;
-        File = new StreamFile(Stream, mode);
+
+        if (ioMode == LocalFileIoMode.Stream)
+        {
+            File = new StreamFile(Stream, mode);
+            return;
+        }
+
+        try
+        {
+            if (ioMode == LocalFileIoMode.MemoryMapped && mode == OpenMode.Read)
+            {
+                Mapping = LocalFileMapping.Create(Stream);
+            }
+
+            Handle = Stream.SafeFileHandle;
+        }
+        catch
+        {
+            Stream.Dispose();
+            throw;
+        }
     }
 
-    public LocalFile(FileStream stream, OpenMode mode)
+    private static FileStream OpenFile(string path, OpenMode mode, LocalFileIoMode ioMode)
     {
-        Mode = mode;
-        Stream = stream;
-        File = new StreamFile(Stream, mode);
+        LocalFileSystem.OpenFileInternal(out FileStream stream, path, mode, ioMode).ThrowIfFailure();
+        return stream;
     }
 
     protected override Result DoRead(out long bytesRead, long offset, Span<byte> destination,
@@ -37,7 +72,30 @@ public class LocalFile : IFile
         Result res = DryRead(out long toRead, offset, destination.Length, in option, Mode);
         if (res.IsFailure()) return res.Miss();
 
-        return File.Read(out bytesRead, offset, destination.Slice(0, (int)toRead), option);
+        if (File is not null)
+            return File.Read(out bytesRead, offset, destination.Slice(0, (int)toRead), option);
+
+        if (Mapping is not null)
+        {
+            Mapping.GetSpan(offset, (int)toRead).CopyTo(destination);
+            bytesRead = toRead;
+            return Result.Success;
+        }
+
+        return LocalFileIo.Read(out bytesRead, Handle, offset, destination.Slice(0, (int)toRead));
+    }
+
+    protected override ValueTask<(Result Result, long BytesRead)> DoReadAsync(long offset, Memory<byte> destination,
+        ReadOption option, CancellationToken cancellationToken)
+    {
+        // Streams and memory mappings don't have an asynchronous path that's any faster than reading synchronously
+        if (Handle is null || Mapping is not null)
+            return base.DoReadAsync(offset, destination, option, cancellationToken);
+
+        Result res = DryRead(out long toRead, offset, destination.Length, in option, Mode);
+        if (res.IsFailure()) return new ValueTask<(Result, long)>((res.Miss(), 0));
+
+        return LocalFileIo.ReadAsync(Handle, offset, destination.Slice(0, (int)toRead), cancellationToken);
     }
 
     protected override Result DoWrite(long offset, ReadOnlySpan<byte> source, in WriteOption option)
@@ -45,14 +103,29 @@ public class LocalFile : IFile
         Result res = DryWrite(out _, offset, source.Length, in option, Mode);
         if (res.IsFailure()) return res.Miss();
 
-        return File.Write(offset, source, option);
+        if (File is not null)
+            return File.Write(offset, source, option);
+
+        res = LocalFileIo.Write(Handle, offset, source);
+        if (res.IsFailure()) return res.Miss();
+
+        if (option.HasFlushFlag())
+        {
+            return Flush();
+        }
+
+        return Result.Success;
     }
 
     protected override Result DoFlush()
     {
         try
         {
-            return File.Flush();
+            if (File is not null)
+                return File.Flush();
+
+            Stream.Flush();
+            return Result.Success;
         }
         catch (Exception ex) when (ex.HResult < 0)
         {
@@ -66,7 +139,16 @@ public class LocalFile : IFile
 
         try
         {
-            return File.GetSize(out size);
+            if (File is not null)
+                return File.GetSize(out size);
+
+            if (Mapping is not null)
+            {
+                size = Mapping.Length;
+                return Result.Success;
+            }
+
+            return LocalFileIo.GetLength(out size, Handle);
         }
         catch (Exception ex) when (ex.HResult < 0)
         {
@@ -83,7 +165,14 @@ public class LocalFile : IFile
     {
         try
         {
-            File.SetSize(size);
+            if (File is not null)
+            {
+                File.SetSize(size);
+            }
+            else
+            {
+                Stream.SetLength(size);
+            }
         }
         catch (Exception ex) when (ex.HResult < 0)
         {
@@ -95,9 +184,10 @@ public class LocalFile : IFile
 
     public override void Dispose()
     {
+        Mapping?.Dispose();
         File?.Dispose();
         Stream?.Dispose();
 
         base.Dispose();
     }
-}
\ No newline at end of file
+}
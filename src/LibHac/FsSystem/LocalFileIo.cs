@@ -0,0 +1,223 @@
+﻿using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Common;
+using LibHac.Fs;
+using Microsoft.Win32.SafeHandles;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// Specifies how a <see cref="LocalStorage"/> or <see cref="LocalFile"/> accesses the file it wraps.
+/// </summary>
+public enum LocalFileIoMode
+{
+    /// <summary>
+    /// Accesses go through a <see cref="FileStream"/>. Concurrent accesses are serialized on the stream's position.
+    /// </summary>
+    Stream,
+
+    /// <summary>
+    /// Accesses use positional I/O with no shared file position, so concurrent reads don't block each other.
+    /// </summary>
+    RandomAccess,
+
+    /// <summary>
+    /// Files opened as read-only are mapped into memory and reads are copied directly from the mapping.
+    /// Files opened for writing and empty files use <see cref="RandomAccess"/> instead.
+    /// Other processes can't open mapped files for writing while they're open.
+    /// </summary>
+    MemoryMapped,
+
+    /// <summary>
+    /// Like <see cref="RandomAccess"/>, but files are opened for asynchronous I/O so asynchronous reads don't
+    /// block a thread while waiting on the OS on platforms that support it. Synchronous accesses are slightly
+    /// slower than with <see cref="RandomAccess"/>.
+    /// </summary>
+    Asynchronous
+}
+
+/// <summary>
+/// Helper functions for accessing local files without using a <see cref="FileStream"/>'s position.
+/// </summary>
+internal static class LocalFileIo
+{
+    /// <summary>
+    /// Gets the buffer size a <see cref="FileStream"/> should be opened with for the specified mode.
+    /// Streams used for positional I/O don't need their own buffer.
+    /// </summary>
+    public static int GetFileStreamBufferSize(LocalFileIoMode ioMode)
+    {
+        return ioMode == LocalFileIoMode.Stream ? 4096 : 0;
+    }
+
+    /// <summary>
+    /// Gets the <see cref="FileOptions"/> a <see cref="FileStream"/> should be opened with for the specified mode.
+    /// </summary>
+    public static FileOptions GetFileOptions(LocalFileIoMode ioMode)
+    {
+        return ioMode == LocalFileIoMode.Asynchronous ? FileOptions.Asynchronous : FileOptions.None;
+    }
+
+    /// <summary>
+    /// Reads from <paramref name="handle"/> until <paramref name="destination"/> is full or the end
+    /// of the file is reached.
+    /// </summary>
+    public static Result Read(out long bytesRead, SafeFileHandle handle, long offset, Span<byte> destination)
+    {
+        bytesRead = 0;
+
+        try
+        {
+            while (destination.Length > 0)
+            {
+                int currentBytesRead = RandomAccess.Read(handle, destination, offset);
+                if (currentBytesRead == 0)
+                    break;
+
+                bytesRead += currentBytesRead;
+                offset += currentBytesRead;
+                destination = destination.Slice(currentBytesRead);
+            }
+        }
+        catch (Exception ex) when (ex.HResult < 0)
+        {
+            return HResult.HResultToHorizonResult(ex.HResult).Log();
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Asynchronously reads from <paramref name="handle"/> until <paramref name="destination"/> is full or the end
+    /// of the file is reached.
+    /// </summary>
+    public static async ValueTask<(Result Result, long BytesRead)> ReadAsync(SafeFileHandle handle, long offset,
+        Memory<byte> destination, CancellationToken cancellationToken)
+    {
+        long bytesRead = 0;
+
+        try
+        {
+            while (destination.Length > 0)
+            {
+                int currentBytesRead = await RandomAccess.ReadAsync(handle, destination, offset, cancellationToken)
+                    .ConfigureAwait(false);
+
+                if (currentBytesRead == 0)
+                    break;
+
+                bytesRead += currentBytesRead;
+                offset += currentBytesRead;
+                destination = destination.Slice(currentBytesRead);
+            }
+        }
+        catch (Exception ex) when (ex.HResult < 0 && ex is not OperationCanceledException)
+        {
+            return (HResult.HResultToHorizonResult(ex.HResult).Log(), bytesRead);
+        }
+
+        return (Result.Success, bytesRead);
+    }
+
+    public static Result Write(SafeFileHandle handle, long offset, ReadOnlySpan<byte> source)
+    {
+        try
+        {
+            RandomAccess.Write(handle, source, offset);
+        }
+        catch (Exception ex) when (ex.HResult < 0)
+        {
+            return HResult.HResultToHorizonResult(ex.HResult).Log();
+        }
+
+        return Result.Success;
+    }
+
+    public static Result GetLength(out long length, SafeFileHandle handle)
+    {
+        try
+        {
+            length = RandomAccess.GetLength(handle);
+        }
+        catch (Exception ex) when (ex.HResult < 0)
+        {
+            length = 0;
+            return HResult.HResultToHorizonResult(ex.HResult).Log();
+        }
+
+        return Result.Success;
+    }
+}
+
+/// <summary>
+/// A read-only view of an entire local file mapped into memory.
+/// </summary>
+internal sealed unsafe class LocalFileMapping : IDisposable
+{
+    private MemoryMappedFile _file;
+    private MemoryMappedViewAccessor _view;
+    private byte* _pointer;
+
+    public long Length { get; }
+
+    private LocalFileMapping(MemoryMappedFile file, MemoryMappedViewAccessor view, long length)
+    {
+        _file = file;
+        _view = view;
+        Length = length;
+
+        byte* pointer = null;
+        _view.SafeMemoryMappedViewHandle.AcquirePointer(ref pointer);
+        _pointer = pointer + _view.PointerOffset;
+    }
+
+    /// <summary>
+    /// Maps the file <paramref name="stream"/> refers to into memory.
+    /// </summary>
+    /// <returns>The new mapping, or <see langword="null"/> if the file is empty and can't be mapped.</returns>
+    public static LocalFileMapping Create(FileStream stream)
+    {
+        long length = stream.Length;
+        if (length == 0)
+            return null;
+
+        MemoryMappedFile file = MemoryMappedFile.CreateFromFile(stream, null, 0, MemoryMappedFileAccess.Read,
+            HandleInheritability.None, leaveOpen: true);
+
+        try
+        {
+            MemoryMappedViewAccessor view = file.CreateViewAccessor(0, length, MemoryMappedFileAccess.Read);
+            return new LocalFileMapping(file, view, length);
+        }
+        catch
+        {
+            file.Dispose();
+            throw;
+        }
+    }
+
+    public void Dispose()
+    {
+        if (_pointer != null)
+        {
+            _pointer = null;
+            _view.SafeMemoryMappedViewHandle.ReleasePointer();
+        }
+
+        _view?.Dispose();
+        _file?.Dispose();
+        _view = null;
+        _file = null;
+    }
+
+    /// <summary>
+    /// Gets a span over the mapped file. The span must not be used after the mapping is disposed.
+    /// </summary>
+    public ReadOnlySpan<byte> GetSpan(long offset, int size)
+    {
+        return new ReadOnlySpan<byte>(_pointer + offset, size);
+    }
+}
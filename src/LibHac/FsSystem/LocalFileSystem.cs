@@ -37,6 +37,7 @@ public class LocalFileSystem : IAttributeFileSystem
     private string _rootPathUtf16;
     private readonly FileSystemClient _fsClient;
     private PathMode _mode;
+    private LocalFileIoMode _fileIoMode = LocalFileIoMode.Stream;
     private readonly bool _useUnixTime;
 
     public LocalFileSystem() : this(true) { }
@@ -56,19 +57,30 @@ public class LocalFileSystem : IAttributeFileSystem
     /// The directory will be created if it does not exist.
     /// </summary>
     /// <param name="rootPath">The path that will be the root of the <see cref="LocalFileSystem"/>.</param>
-    public LocalFileSystem(string rootPath)
+    public LocalFileSystem(string rootPath) : this(rootPath, LocalFileIoMode.Stream) { }
+
+    /// <summary>
+    /// Opens a directory on local storage as an <see cref="IFileSystem"/>.
+    /// The directory will be created if it does not exist.
+    /// </summary>
+    /// <param name="rootPath">The path that will be the root of the <see cref="LocalFileSystem"/>.</param>
+    /// <param name="fileIoMode">Specifies how files opened from the file system are accessed.</param>
+    public LocalFileSystem(string rootPath, LocalFileIoMode fileIoMode)
     {
+        _fileIoMode = fileIoMode;
+
         Result res = Initialize(rootPath, PathMode.DefaultCaseSensitivity, true);
         if (res.IsFailure())
             throw new HorizonResultException(res, "Error creating LocalFileSystem.");
     }
 
     public static Result Create(out LocalFileSystem fileSystem, string rootPath,
-        PathMode pathMode = PathMode.DefaultCaseSensitivity, bool ensurePathExists = true)
+        PathMode pathMode = PathMode.DefaultCaseSensitivity, bool ensurePathExists = true,
+        LocalFileIoMode fileIoMode = LocalFileIoMode.Stream)
     {
         UnsafeHelpers.SkipParamInit(out fileSystem);
 
-        var localFs = new LocalFileSystem();
+        var localFs = new LocalFileSystem { _fileIoMode = fileIoMode };
         Result res = localFs.Initialize(rootPath, pathMode, ensurePathExists);
         if (res.IsFailure()) return res.Miss();
 
@@ -394,10 +406,10 @@ public class LocalFileSystem : IAttributeFileSystem
         FileStream fileStream = null;
 
         res = TargetLockedAvoidance.RetryToAvoidTargetLocked(() =>
-            OpenFileInternal(out fileStream, fullPath, mode), _fsClient);
+            OpenFileInternal(out fileStream, fullPath, mode, _fileIoMode), _fsClient);
         if (res.IsFailure()) return res.Miss();
 
-        outFile.Reset(new LocalFile(fileStream, mode));
+        outFile.Reset(new LocalFile(fileStream, mode, _fileIoMode));
         return Result.Success;
     }
 
@@ -578,16 +590,23 @@ public class LocalFileSystem : IAttributeFileSystem
         return (FileAccess)(mode & OpenMode.ReadWrite);
     }
 
-    internal static FileShare GetFileShare(OpenMode mode)
+    internal static FileShare GetFileShare(OpenMode mode, LocalFileIoMode ioMode)
     {
-        return mode.HasFlag(OpenMode.Write) ? FileShare.Read : FileShare.ReadWrite;
+        // Another process truncating a mapped file would crash on the next access to the mapping
+        // instead of returning an error, so don't let other processes write to mapped files.
+        if (mode.HasFlag(OpenMode.Write) || ioMode == LocalFileIoMode.MemoryMapped)
+            return FileShare.Read;
+
+        return FileShare.ReadWrite;
     }
 
-    internal static Result OpenFileInternal(out FileStream stream, string path, OpenMode mode)
+    internal static Result OpenFileInternal(out FileStream stream, string path, OpenMode mode,
+        LocalFileIoMode ioMode)
     {
         try
         {
-            stream = new FileStream(path, FileMode.Open, GetFileAccess(mode), GetFileShare(mode));
+            stream = new FileStream(path, FileMode.Open, GetFileAccess(mode), GetFileShare(mode, ioMode),
+                LocalFileIo.GetFileStreamBufferSize(ioMode), LocalFileIo.GetFileOptions(ioMode));
             return Result.Success;
         }
         catch (Exception ex) when (ex.HResult < 0)
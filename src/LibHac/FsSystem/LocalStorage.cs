@@ -1,45 +1,159 @@
 ﻿using System;
 using System.IO;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
 using LibHac.Tools.FsSystem;
+using Microsoft.Win32.SafeHandles;
 
 namespace LibHac.FsSystem;
 
+/// <summary>
+/// An <see cref="IStorage"/> that accesses a file on the local file system.
+/// </summary>
+/// <remarks>How the file is accessed is chosen with a <see cref="LocalFileIoMode"/>.
+/// <see cref="LocalFileIoMode.Stream"/> is used by default.</remarks>
 public class LocalStorage : IStorage
 {
     private string Path { get; }
     private FileStream Stream { get; }
     private StreamStorage Storage { get; }
+    private SafeFileHandle Handle { get; }
+    private LocalFileMapping Mapping { get; }
 
     public LocalStorage(string path, FileAccess access) : this(path, access, FileMode.Open) { }
 
     public LocalStorage(string path, FileAccess access, FileMode mode)
+        : this(path, access, mode, LocalFileIoMode.Stream) { }
+
+    public LocalStorage(string path, FileAccess access, LocalFileIoMode ioMode)
+        : this(path, access, FileMode.Open, ioMode) { }
+
+    public LocalStorage(string path, FileAccess access, FileMode mode, LocalFileIoMode ioMode)
     {
         Path = path;
-        Stream = new FileStream(Path, mode, access);
-        Storage = new StreamStorage(Stream, false);
+        Stream = new FileStream(Path, mode, access, FileShare.Read, LocalFileIo.GetFileStreamBufferSize(ioMode),
+            LocalFileIo.GetFileOptions(ioMode));
+
+        try
+        {
+            if (ioMode == LocalFileIoMode.Stream)
+            {
+                Storage = new StreamStorage(Stream, false);
+                return;
+            }
+
+            if (ioMode == LocalFileIoMode.MemoryMapped && access == FileAccess.Read)
+            {
+                Mapping = LocalFileMapping.Create(Stream);
+            }
+
+            Handle = Stream.SafeFileHandle;
+        }
+        catch
+        {
+            Stream.Dispose();
+            throw;
+        }
     }
 
     public override void Dispose()
     {
+        Mapping?.Dispose();
         Storage?.Dispose();
         Stream?.Dispose();
         base.Dispose();
     }
 
+    /// <summary>
+    /// Gets a span that refers directly to the contents of a memory-mapped file without copying them.
+    /// </summary>
+    /// <param name="span">If the operation succeeds, the requested range of the file. The span must not be
+    /// used after the <see cref="LocalStorage"/> is disposed.</param>
+    /// <param name="offset">The offset in the file of the range to get.</param>
+    /// <param name="size">The size of the range to get.</param>
+    /// <returns><see cref="Result.Success"/>: The operation was successful.<br/>
+    /// <see cref="ResultFs.UnsupportedOperation"/>: The storage isn't memory-mapped.<br/>
+    /// <see cref="ResultFs.OutOfRange"/>: The range is outside the file.</returns>
+    public Result GetMappedSpan(out ReadOnlySpan<byte> span, long offset, int size)
+    {
+        span = default;
+
+        if (Mapping is null)
+            return ResultFs.UnsupportedOperation.Log();
+
+        Result res = CheckAccessRange(offset, size, Mapping.Length);
+        if (res.IsFailure()) return res.Miss();
+
+        span = Mapping.GetSpan(offset, size);
+        return Result.Success;
+    }
+
     public override Result Read(long offset, Span<byte> destination)
     {
-        return Storage.Read(offset, destination);
+        Result res;
+
+        if (Storage is not null)
+            return Storage.Read(offset, destination);
+
+        if (Mapping is not null)
+        {
+            res = CheckAccessRange(offset, destination.Length, Mapping.Length);
+            if (res.IsFailure()) return res.Miss();
+
+            Mapping.GetSpan(offset, destination.Length).CopyTo(destination);
+            return Result.Success;
+        }
+
+        res = LocalFileIo.Read(out long bytesRead, Handle, offset, destination);
+        if (res.IsFailure()) return res.Miss();
+
+        if (bytesRead != destination.Length)
+            return ResultFs.OutOfRange.Log();
+
+        return Result.Success;
+    }
+
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        // Streams and memory mappings don't have an asynchronous path that's any faster than reading synchronously
+        if (Handle is null || Mapping is not null)
+            return base.ReadAsync(offset, destination, cancellationToken);
+
+        return ReadAsyncImpl(offset, destination, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncImpl(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken)
+    {
+        (Result res, long bytesRead) = await LocalFileIo.ReadAsync(Handle, offset, destination, cancellationToken)
+            .ConfigureAwait(false);
+        if (res.IsFailure()) return res.Miss();
+
+        if (bytesRead != destination.Length)
+            return ResultFs.OutOfRange.Log();
+
+        return Result.Success;
     }
 
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
-        return Storage.Write(offset, source);
+        if (Storage is not null)
+            return Storage.Write(offset, source);
+
+        if (Mapping is not null)
+            return ResultFs.UnsupportedOperation.Log();
+
+        return LocalFileIo.Write(Handle, offset, source);
     }
 
     public override Result Flush()
     {
-        return Storage.Flush();
+        if (Storage is not null)
+            return Storage.Flush();
+
+        return Result.Success;
     }
 
     public override Result SetSize(long size)
@@ -49,7 +163,16 @@ public class LocalStorage : IStorage
 
     public override Result GetSize(out long size)
     {
-        return Storage.GetSize(out size);
+        if (Storage is not null)
+            return Storage.GetSize(out size);
+
+        if (Mapping is not null)
+        {
+            size = Mapping.Length;
+            return Result.Success;
+        }
+
+        return LocalFileIo.GetLength(out size, Handle);
     }
 
     public override Result OperateRange(Span<byte> outBuffer, OperationId operationId, long offset, long size,
@@ -57,4 +180,4 @@ public class LocalStorage : IStorage
     {
         throw new NotImplementedException();
     }
-}
\ No newline at end of file
+}
@@ -234,7 +234,7 @@ public class PartitionFileSystemCore<TMetaData, TFormat, THeader, TEntry> : IFil
 
                 // Prepare a buffer for our calculated hash.
                 Span<byte> hash = stackalloc byte[Sha256Generator.HashSize];
-                var sha = new Sha256Generator();
+                using var sha = new Sha256Generator();
 
                 if (offset <= hashTargetStart && hashTargetEnd <= readEnd)
                 {
@@ -321,7 +321,7 @@ namespace LibHac.FsSystem
             if (res.IsFailure()) return res.Miss();
 
             Span<byte> hashBuffer = stackalloc byte[Sha256Generator.HashSize];
-            var generator = new Sha256Generator();
+            using var generator = new Sha256Generator();
             generator.Initialize();
             generator.Update(metaDataSpan);
             if (salt.HasValue)
@@ -0,0 +1,322 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// Detects sequential reads of a block-based storage and decides which blocks should be read ahead of the reader.
+/// </summary>
+/// <remarks><para>Up to <see cref="StreamCount"/> sequential streams are tracked at once so interleaved readers don't
+/// look random to each other. A stream is considered sequential once it has been continued
+/// <see cref="DetectionThreshold"/> times in a row. More blocks are requested when the reader gets within half a
+/// window of the end of the prefetched blocks.</para>
+/// <para>The window is sized from the observed throughput. Each stream tracks how long the reader takes per block,
+/// and the storage reports how long each read-ahead took. The window covers the blocks the reader gets through in
+/// twice the read-ahead time, so the reader doesn't catch up with the prefetched data before the next read-ahead
+/// finishes. A reader that's at least as fast as the base storage gets the maximum window. Until the first read-ahead
+/// has been timed, the window is <see cref="InitialWindowBlockCount"/> blocks.</para>
+/// <para>A read that doesn't continue any stream replaces the least recently used stream, dropping its window.</para>
+/// <para>The controller doesn't read anything itself. Storages call <see cref="OnRead"/> for each read, read
+/// the returned blocks and report them with <see cref="OnPrefetched"/>. Prefetched blocks that are later read
+/// are counted as hits, and prefetched blocks that are pushed out of the tracked set before being read
+/// are counted as wasted.</para>
+/// <para>This class is thread-safe.</para>
+/// <para>LibHac addition.</para></remarks>
+public class ReadAheadController
+{
+    public const int StreamCount = 4;
+    public const int DetectionThreshold = 2;
+    public const int InitialWindowBlockCount = 2;
+
+    // The weight given to each new timing when updating the average read and read-ahead times
+    private const double TimingWeight = 0.25;
+
+    private struct Stream
+    {
+        public long NextBlockIndex;
+        public long PrefetchEndBlockIndex;
+        public int SequentialCount;
+        public int WindowBlockCount;
+        public long LastAccess;
+        public long LastReadTimestamp;
+        public double ReadTicksPerBlock;
+    }
+
+    private readonly object _locker = new();
+    private readonly int _maxWindowBlockCount;
+    private readonly Func<long> _getTimestamp;
+    private double _prefetchTicks;
+    private readonly Stream[] _streams;
+    private long _accessCounter;
+
+    // The prefetched blocks that haven't been read yet. The ring holds them in the order they were prefetched
+    // so the oldest can be dropped once the set is full.
+    private readonly HashSet<long> _outstandingBlocks;
+    private readonly long[] _outstandingRing;
+    private int _outstandingRingPosition;
+
+    private long _sequentialStreamCount;
+    private long _randomReadCount;
+    private long _prefetchCount;
+    private long _prefetchedBlockCount;
+    private long _prefetchHitCount;
+    private long _wastedBlockCount;
+
+    /// <summary>
+    /// Creates a new <see cref="ReadAheadController"/>.
+    /// </summary>
+    /// <param name="maxWindowBlockCount">The maximum number of blocks to read ahead of a stream.
+    /// This should be small enough that prefetched blocks aren't evicted from the cache before they're read.</param>
+    public ReadAheadController(int maxWindowBlockCount) : this(maxWindowBlockCount, Stopwatch.GetTimestamp) { }
+
+    /// <summary>
+    /// Creates a new <see cref="ReadAheadController"/> that times reads with the provided clock.
+    /// </summary>
+    /// <param name="maxWindowBlockCount">The maximum number of blocks to read ahead of a stream.</param>
+    /// <param name="getTimestamp">Returns the current time in <see cref="Stopwatch"/> ticks.</param>
+    internal ReadAheadController(int maxWindowBlockCount, Func<long> getTimestamp)
+    {
+        if (maxWindowBlockCount <= 0)
+            throw new ArgumentOutOfRangeException(nameof(maxWindowBlockCount), "Window size must be positive.");
+
+        _maxWindowBlockCount = maxWindowBlockCount;
+        _getTimestamp = getTimestamp;
+        _streams = new Stream[StreamCount];
+        _outstandingBlocks = new HashSet<long>();
+        _outstandingRing = new long[maxWindowBlockCount * 2 * StreamCount];
+
+        Reset();
+    }
+
+    public int MaxWindowBlockCount => _maxWindowBlockCount;
+
+    /// <summary>
+    /// Records a read of one or more consecutive blocks and determines which blocks should be read ahead.
+    /// </summary>
+    /// <param name="blockIndex">The index of the first block being read.</param>
+    /// <param name="blockCount">The number of blocks being read.</param>
+    /// <param name="prefetchBlockIndex">If the return value is nonzero, the index of the first block to prefetch.</param>
+    /// <returns>The number of blocks to prefetch. The range may extend past the end of the storage,
+    /// so the caller must clamp it.</returns>
+    public int OnRead(long blockIndex, int blockCount, out long prefetchBlockIndex)
+    {
+        prefetchBlockIndex = 0;
+
+        lock (_locker)
+        {
+            long endBlockIndex = blockIndex + blockCount;
+            long timestamp = _getTimestamp();
+            _accessCounter++;
+
+            for (long i = blockIndex; i < endBlockIndex; i++)
+            {
+                if (_outstandingBlocks.Remove(i))
+                    _prefetchHitCount++;
+            }
+
+            int streamIndex = FindStream(blockIndex);
+
+            if (streamIndex < 0)
+            {
+                // Reads that don't continue a stream start a new one in place of the least recently used stream
+                _randomReadCount++;
+
+                ref Stream newStream = ref _streams[FindLeastRecentlyUsedStream()];
+                newStream.NextBlockIndex = endBlockIndex;
+                newStream.PrefetchEndBlockIndex = endBlockIndex;
+                newStream.SequentialCount = 0;
+                newStream.WindowBlockCount = 0;
+                newStream.LastAccess = _accessCounter;
+                newStream.LastReadTimestamp = timestamp;
+                newStream.ReadTicksPerBlock = 0;
+
+                return 0;
+            }
+
+            ref Stream stream = ref _streams[streamIndex];
+            stream.LastAccess = _accessCounter;
+
+            // Repeated reads of the stream's last block don't move it forward
+            if (endBlockIndex <= stream.NextBlockIndex)
+                return 0;
+
+            double ticksPerBlock = (double)(timestamp - stream.LastReadTimestamp) / (endBlockIndex - stream.NextBlockIndex);
+            stream.ReadTicksPerBlock = stream.SequentialCount == 0
+                ? ticksPerBlock
+                : stream.ReadTicksPerBlock + (ticksPerBlock - stream.ReadTicksPerBlock) * TimingWeight;
+
+            stream.LastReadTimestamp = timestamp;
+            stream.NextBlockIndex = endBlockIndex;
+            stream.SequentialCount++;
+
+            if (stream.SequentialCount < DetectionThreshold)
+                return 0;
+
+            if (stream.WindowBlockCount == 0)
+            {
+                _sequentialStreamCount++;
+            }
+            else
+            {
+                // Wait until the reader is within half a window of the end of the prefetched blocks
+                if (stream.PrefetchEndBlockIndex - stream.NextBlockIndex > stream.WindowBlockCount / 2)
+                    return 0;
+            }
+
+            stream.WindowBlockCount = CalculateWindowBlockCount(in stream);
+
+            long startBlockIndex = Math.Max(stream.PrefetchEndBlockIndex, stream.NextBlockIndex);
+            long prefetchEndBlockIndex = stream.NextBlockIndex + stream.WindowBlockCount;
+
+            if (prefetchEndBlockIndex <= startBlockIndex)
+                return 0;
+
+            stream.PrefetchEndBlockIndex = prefetchEndBlockIndex;
+
+            prefetchBlockIndex = startBlockIndex;
+            return (int)(prefetchEndBlockIndex - startBlockIndex);
+        }
+    }
+
+    /// <summary>
+    /// Records that blocks were read ahead and added to the cache.
+    /// </summary>
+    /// <param name="blockIndex">The index of the first prefetched block.</param>
+    /// <param name="blockCount">The number of prefetched blocks.</param>
+    /// <param name="elapsedTicks">How long the read-ahead took in <see cref="Stopwatch"/> ticks.</param>
+    public void OnPrefetched(long blockIndex, int blockCount, long elapsedTicks)
+    {
+        lock (_locker)
+        {
+            _prefetchTicks = _prefetchCount == 0
+                ? elapsedTicks
+                : _prefetchTicks + (elapsedTicks - _prefetchTicks) * TimingWeight;
+
+            _prefetchCount++;
+            _prefetchedBlockCount += blockCount;
+
+            for (long i = blockIndex; i < blockIndex + blockCount; i++)
+            {
+                if (!_outstandingBlocks.Add(i))
+                    continue;
+
+                // Drop the oldest prefetched block if it still hasn't been read
+                long droppedBlockIndex = _outstandingRing[_outstandingRingPosition];
+                if (droppedBlockIndex != -1 && _outstandingBlocks.Remove(droppedBlockIndex))
+                    _wastedBlockCount++;
+
+                _outstandingRing[_outstandingRingPosition] = i;
+                _outstandingRingPosition = (_outstandingRingPosition + 1) % _outstandingRing.Length;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Forgets all tracked streams. Any prefetched blocks that haven't been read are counted as wasted.
+    /// Should be called when the storage's cache is invalidated.
+    /// </summary>
+    public void Reset()
+    {
+        lock (_locker)
+        {
+            _wastedBlockCount += _outstandingBlocks.Count;
+            _outstandingBlocks.Clear();
+            _outstandingRing.AsSpan().Fill(-1);
+            _outstandingRingPosition = 0;
+
+            for (int i = 0; i < _streams.Length; i++)
+            {
+                _streams[i] = default;
+                _streams[i].NextBlockIndex = -1;
+            }
+        }
+    }
+
+    public ReadAheadStatistics GetStatistics()
+    {
+        lock (_locker)
+        {
+            return new ReadAheadStatistics
+            {
+                SequentialStreamCount = _sequentialStreamCount,
+                RandomReadCount = _randomReadCount,
+                PrefetchCount = _prefetchCount,
+                PrefetchedBlockCount = _prefetchedBlockCount,
+                PrefetchHitCount = _prefetchHitCount,
+                WastedBlockCount = _wastedBlockCount
+            };
+        }
+    }
+
+    private int CalculateWindowBlockCount(ref readonly Stream stream)
+    {
+        int minWindowBlockCount = Math.Min(InitialWindowBlockCount, _maxWindowBlockCount);
+
+        if (_prefetchCount == 0)
+            return minWindowBlockCount;
+
+        // The reader is at least as fast as the clock can measure
+        if (stream.ReadTicksPerBlock <= 0)
+            return _maxWindowBlockCount;
+
+        // More blocks are requested when half the window is left, so the window has to last twice the read-ahead time
+        double windowBlockCount = Math.Ceiling(2 * _prefetchTicks / stream.ReadTicksPerBlock);
+
+        return (int)Math.Clamp(windowBlockCount, minWindowBlockCount, _maxWindowBlockCount);
+    }
+
+    private int FindStream(long blockIndex)
+    {
+        for (int i = 0; i < _streams.Length; i++)
+        {
+            long nextBlockIndex = _streams[i].NextBlockIndex;
+
+            // Small reads that don't end on a block boundary will read the stream's last block again
+            if (nextBlockIndex != -1 && (blockIndex == nextBlockIndex || blockIndex == nextBlockIndex - 1))
+                return i;
+        }
+
+        return -1;
+    }
+
+    private int FindLeastRecentlyUsedStream()
+    {
+        int lruIndex = 0;
+
+        for (int i = 1; i < _streams.Length; i++)
+        {
+            if (_streams[i].LastAccess < _streams[lruIndex].LastAccess)
+                lruIndex = i;
+        }
+
+        return lruIndex;
+    }
+}
+
+/// <summary>
+/// The statistics recorded by a <see cref="ReadAheadController"/>.
+/// </summary>
+public readonly struct ReadAheadStatistics
+{
+    /// <summary>The number of times a stream of reads was detected as sequential.</summary>
+    public long SequentialStreamCount { get; init; }
+
+    /// <summary>The number of reads that didn't continue any tracked stream.</summary>
+    public long RandomReadCount { get; init; }
+
+    /// <summary>The number of read-ahead operations that were performed.</summary>
+    public long PrefetchCount { get; init; }
+
+    /// <summary>The total number of blocks that were read ahead.</summary>
+    public long PrefetchedBlockCount { get; init; }
+
+    /// <summary>The number of prefetched blocks that were later read.</summary>
+    public long PrefetchHitCount { get; init; }
+
+    /// <summary>The number of prefetched blocks that were dropped before being read.</summary>
+    public long WastedBlockCount { get; init; }
+
+    /// <summary>The fraction of prefetched blocks that were later read, or 0 if nothing was prefetched.</summary>
+    public double Accuracy => PrefetchedBlockCount == 0 ? 0 : (double)PrefetchHitCount / PrefetchedBlockCount;
+}
@@ -1,5 +1,6 @@
 ﻿using System;
 using System.Collections.Generic;
+using System.Diagnostics;
 using LibHac.Common;
 using LibHac.Diag;
 using LibHac.Fs;
@@ -15,19 +16,24 @@ namespace LibHac.FsSystem;
 /// Only reads that access a single block will use the cache. Reads that access multiple blocks will
 /// be passed down to the base <see cref="IStorage"/> to be handled without caching.
 /// </summary>
-/// <remarks>Based on nnSdk 13.4.0 (FS 13.1.0)</remarks>
+/// <remarks><para>Based on nnSdk 13.4.0 (FS 13.1.0)</para>
+/// <para>LibHac addition: Sequential single-block reads can be detected and read ahead of the reader.
+/// See <see cref="EnableReadAhead"/>.</para></remarks>
 public class ReadOnlyBlockCacheStorage : IStorage
 {
     private SdkMutexType _mutex;
     private BlockCache _blockCache;
     private SharedRef<IStorage> _baseStorage;
     private int _blockSize;
+    private int _cacheBlockCount;
+    private ReadAheadController _readAhead;
 
     public ReadOnlyBlockCacheStorage(ref readonly SharedRef<IStorage> baseStorage, int blockSize, Memory<byte> buffer,
         int cacheBlockCount)
     {
         _baseStorage = SharedRef<IStorage>.CreateCopy(in baseStorage);
         _blockSize = blockSize;
+        _cacheBlockCount = cacheBlockCount;
         _blockCache = new BlockCache();
         _mutex = new SdkMutexType();
 
@@ -61,18 +67,37 @@ public class ReadOnlyBlockCacheStorage : IStorage
 
         if (destination.Length == _blockSize)
         {
+            long blockIndex = offset / _blockSize;
+
+            int readAheadBlockCount = 0;
+            long readAheadBlockIndex = 0;
+
+            ReadAheadController readAhead = _readAhead;
+            if (readAhead is not null)
+                readAheadBlockCount = readAhead.OnRead(blockIndex, 1, out readAheadBlockIndex);
+
             // Search the cache for the requested block.
+            bool found;
             using (new ScopedLock<SdkMutexType>(ref _mutex))
             {
-                bool found = _blockCache.FindValueAndUpdateMru(out Memory<byte> cachedBuffer, offset / _blockSize);
+                found = _blockCache.FindValueAndUpdateMru(out Memory<byte> cachedBuffer, blockIndex);
                 if (found)
                 {
+                    StorageTracer.ReportCacheHit();
                     cachedBuffer.Span.CopyTo(destination);
-                    return Result.Success;
                 }
             }
 
+            if (found)
+            {
+                if (readAheadBlockCount > 0)
+                    ReadAhead(readAhead, readAheadBlockIndex, readAheadBlockCount);
+
+                return Result.Success;
+            }
+
             // The block wasn't in the cache. Read from the base storage.
+            StorageTracer.ReportCacheMiss();
             Result res = _baseStorage.Get.Read(offset, destination);
             if (res.IsFailure()) return res.Miss();
 
@@ -81,9 +106,12 @@ public class ReadOnlyBlockCacheStorage : IStorage
             {
                 LinkedListNode<BlockCache.Node> lru = _blockCache.PopLruNode();
                 destination.CopyTo(lru.ValueRef.Value.Span);
-                _blockCache.PushMruNode(lru, offset / _blockSize);
+                _blockCache.PushMruNode(lru, blockIndex);
             }
 
+            if (readAheadBlockCount > 0)
+                ReadAhead(readAhead, readAheadBlockIndex, readAheadBlockCount);
+
             return Result.Success;
         }
         else
@@ -127,6 +155,8 @@ public class ReadOnlyBlockCacheStorage : IStorage
                 LinkedListNode<BlockCache.Node> lru = _blockCache.PopLruNode();
                 _blockCache.PushMruNode(lru, -1);
             }
+
+            _readAhead?.Reset();
         }
         else
         {
@@ -137,4 +167,77 @@ public class ReadOnlyBlockCacheStorage : IStorage
         // Pass the request to the base storage.
         return _baseStorage.Get.OperateRange(outBuffer, operationId, offset, size, inBuffer);
     }
+
+    /// <summary>
+    /// Enables reading blocks ahead of sequential single-block reads. The blocks are read from the base
+    /// storage with a single read and added to the cache.
+    /// </summary>
+    /// <remarks><para>The read-ahead window is limited to half the number of cached blocks so prefetched blocks
+    /// aren't evicted before they're read. Read-ahead isn't enabled if the cache holds fewer than 2 blocks.</para>
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="maxBlockCount">The maximum number of blocks to read ahead.</param>
+    public void EnableReadAhead(int maxBlockCount)
+    {
+        Assert.SdkRequiresGreater(maxBlockCount, 0);
+
+        int windowBlockCount = Math.Min(maxBlockCount, _cacheBlockCount / 2);
+
+        _readAhead = windowBlockCount > 0 ? new ReadAheadController(windowBlockCount) : null;
+    }
+
+    /// <summary>
+    /// Gets the read-ahead statistics for this storage.
+    /// </summary>
+    /// <remarks>LibHac addition.</remarks>
+    /// <returns>The statistics, or empty statistics if read-ahead isn't enabled.</returns>
+    public ReadAheadStatistics GetReadAheadStatistics() => _readAhead?.GetStatistics() ?? default;
+
+    private void ReadAhead(ReadAheadController readAhead, long blockIndex, int blockCount)
+    {
+        if (_baseStorage.Get.GetSize(out long baseStorageSize).IsFailure())
+            return;
+
+        blockCount = (int)Math.Min(blockCount, baseStorageSize / _blockSize - blockIndex);
+
+        // Skip any blocks at the start of the range that are already cached.
+        using (new ScopedLock<SdkMutexType>(ref _mutex))
+        {
+            while (blockCount > 0 && _blockCache.FindValueAndUpdateMru(out _, blockIndex))
+            {
+                blockIndex++;
+                blockCount--;
+            }
+        }
+
+        if (blockCount <= 0)
+            return;
+
+        using var pooledBuffer = new PooledBuffer(blockCount * _blockSize, _blockSize);
+        blockCount = Math.Min(blockCount, pooledBuffer.GetSize() / _blockSize);
+
+        Span<byte> buffer = pooledBuffer.GetBuffer().Slice(0, blockCount * _blockSize);
+
+        long startTimestamp = Stopwatch.GetTimestamp();
+
+        // Errors are ignored here. They'll be returned if the blocks are actually read.
+        if (_baseStorage.Get.Read(blockIndex * _blockSize, buffer).IsFailure())
+            return;
+
+        long elapsedTicks = Stopwatch.GetTimestamp() - startTimestamp;
+
+        using (new ScopedLock<SdkMutexType>(ref _mutex))
+        {
+            for (int i = 0; i < blockCount; i++)
+            {
+                if (_blockCache.FindValueAndUpdateMru(out _, blockIndex + i))
+                    continue;
+
+                LinkedListNode<BlockCache.Node> lru = _blockCache.PopLruNode();
+                buffer.Slice(i * _blockSize, _blockSize).CopyTo(lru.ValueRef.Value.Span);
+                _blockCache.PushMruNode(lru, blockIndex + i);
+            }
+        }
+
+        readAhead.OnPrefetched(blockIndex, blockCount, elapsedTicks);
+    }
 }
\ No newline at end of file
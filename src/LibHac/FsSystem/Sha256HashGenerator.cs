@@ -0,0 +1,75 @@
+﻿using System;
+using LibHac.Common;
+using LibHac.Crypto;
+using LibHac.Crypto.Impl;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// Generates SHA-256 hashes for a stream of data.
+/// </summary>
+public class Sha256HashGenerator : IHash256Generator
+{
+    private Sha256Impl _baseHash;
+
+    public override void Dispose()
+    {
+        _baseHash.Dispose();
+        base.Dispose();
+    }
+
+    protected override void DoInitialize()
+    {
+        _baseHash.Initialize();
+    }
+
+    protected override void DoUpdate(ReadOnlySpan<byte> data)
+    {
+        _baseHash.Update(data);
+    }
+
+    protected override void DoGetHash(Span<byte> hashBuffer)
+    {
+        _baseHash.GetHash(hashBuffer);
+    }
+}
+
+/// <summary>
+/// Creates <see cref="Sha256HashGenerator"/> objects and generates SHA-256 hashes of in-memory data.
+/// </summary>
+/// <remarks>Hashes of multiple equal-sized blocks are calculated several blocks at a time
+/// when <see cref="Sha256.IsMultiBufferPreferred"/> returns <see langword="true"/>.</remarks>
+public class Sha256HashGeneratorFactory : IHash256GeneratorFactory
+{
+    protected override Result DoCreate(ref UniqueRef<IHash256Generator> outGenerator)
+    {
+        outGenerator.Reset(new Sha256HashGenerator());
+        return Result.Success;
+    }
+
+    protected override Result DoGenerateHash(Span<byte> hashBuffer, ReadOnlySpan<byte> data)
+    {
+        Sha256.GenerateSha256Hash(data, hashBuffer);
+        return Result.Success;
+    }
+
+    protected override Result DoGenerateHashes(Span<byte> hashBuffer, ReadOnlySpan<byte> data, int blockSize,
+        ReadOnlySpan<byte> salt)
+    {
+        Sha256.GenerateSha256Hashes(salt, data, blockSize, hashBuffer, Sha256.IsMultiBufferPreferred());
+        return Result.Success;
+    }
+}
+
+/// <summary>
+/// Returns a <see cref="Sha256HashGeneratorFactory"/> for <see cref="HashAlgorithmType.Sha2"/>.
+/// </summary>
+public class Sha256HashGeneratorFactorySelector : IHash256GeneratorFactorySelector
+{
+    private readonly Sha256HashGeneratorFactory _factory = new();
+
+    protected override IHash256GeneratorFactory DoGetFactory(HashAlgorithmType type)
+    {
+        return type == HashAlgorithmType.Sha2 ? _factory : null;
+    }
+}
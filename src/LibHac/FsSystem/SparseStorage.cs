@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using LibHac.Diag;
 using LibHac.Fs;
 
@@ -81,6 +82,59 @@ public class SparseStorage : IndirectStorage
         SetZeroStorage();
     }
 
+    /// <summary>
+    /// Gets the ranges of the storage that have no stored data and are always read as zeros.
+    /// </summary>
+    /// <remarks>Adjacent ranges are merged, and the ranges are returned in order of their offsets.
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="outRanges">The list the ranges will be added to.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result GetZeroRanges(List<(long Offset, long Size)> outRanges)
+    {
+        Assert.SdkRequires(IsInitialized());
+
+        Result res = GetEntryTable().GetOffsets(out BucketTree.Offsets offsets);
+        if (res.IsFailure()) return res.Miss();
+
+        long tableSize = offsets.EndOffset - offsets.StartOffset;
+
+        if (GetEntryTable().IsEmpty())
+        {
+            if (tableSize > 0)
+                outRanges.Add((offsets.StartOffset, tableSize));
+
+            return Result.Success;
+        }
+
+        res = GetEntryList(Span<Entry>.Empty, out int entryCount, offsets.StartOffset, tableSize);
+        if (res.IsFailure()) return res.Miss();
+
+        var entries = new Entry[entryCount];
+
+        res = GetEntryList(entries, out entryCount, offsets.StartOffset, tableSize);
+        if (res.IsFailure()) return res.Miss();
+
+        for (int i = 0; i < entryCount; i++)
+        {
+            if (entries[i].StorageIndex != 1)
+                continue;
+
+            long start = entries[i].GetVirtualOffset();
+            long end = i + 1 < entryCount ? entries[i + 1].GetVirtualOffset() : offsets.EndOffset;
+
+            if (outRanges.Count > 0 && outRanges[^1].Offset + outRanges[^1].Size == start)
+            {
+                outRanges[^1] = (outRanges[^1].Offset, end - outRanges[^1].Offset);
+            }
+            else
+            {
+                outRanges.Add((start, end - start));
+            }
+        }
+
+        return Result.Success;
+    }
+
     private void SetZeroStorage()
     {
         SetStorage(1, _zeroStorage, 0, long.MaxValue);
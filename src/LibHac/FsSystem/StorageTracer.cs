@@ -0,0 +1,467 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// The kind of operation recorded by a <see cref="StorageTracer"/>.
+/// </summary>
+public enum StorageTraceOperation
+{
+    Read,
+    Write,
+    Other
+}
+
+/// <summary>
+/// Records per-layer statistics for a stack of <see cref="IStorage"/>s and <see cref="IFileSystem"/>s.
+/// </summary>
+/// <remarks><para>Layers are added to the tracer by wrapping them with <see cref="WrapStorage"/> or
+/// <see cref="WrapFileSystem"/>. Every layer wrapped with the same name shares the same statistics, so
+/// opening the same kind of stack multiple times aggregates the results of all the stacks.</para>
+/// <para>Each layer records its operation counts, bytes transferred, cache hits and misses, and
+/// the latency of its reads and writes. A layer's parent is the first layer observed calling into it,
+/// and the time a layer spends outside of its children is recorded as its self time.</para>
+/// <para>Tracing is opt-in: code that builds storage stacks should skip wrapping entirely when it
+/// doesn't have a tracer. A disabled tracer forwards every call without recording anything.</para>
+/// <para>While any tracer is enabled, every cache hit and miss in the process looks up the layer being traced.
+/// Dispose a tracer once it's no longer needed so that lookup is skipped again.</para>
+/// <para>This class is thread-safe.</para></remarks>
+public class StorageTracer : IDisposable
+{
+    private static readonly double NanosecondsPerTick = 1_000_000_000.0 / Stopwatch.Frequency;
+
+    // The number of enabled tracers. Checked before doing any work when a cache reports a hit or miss.
+    private static int _enabledTracerCount;
+
+    [ThreadStatic] private static Layer _currentLayer;
+    [ThreadStatic] private static long _currentChildTicks;
+
+    private readonly object _locker = new();
+    private readonly Dictionary<string, Layer> _layers = new(StringComparer.Ordinal);
+    private readonly List<Layer> _layerList = new();
+    private bool _isEnabled;
+    private bool _isDisposed;
+
+    public StorageTracer(bool isEnabled = true)
+    {
+        IsEnabled = isEnabled;
+    }
+
+    /// <summary>
+    /// Whether the tracer records statistics. Layers that are already wrapped only forward their calls
+    /// while the tracer is disabled.
+    /// </summary>
+    /// <exception cref="ObjectDisposedException">The tracer is enabled after it has been disposed.</exception>
+    public bool IsEnabled
+    {
+        get => Volatile.Read(ref _isEnabled);
+        set
+        {
+            lock (_locker)
+            {
+                if (_isEnabled == value)
+                    return;
+
+                ObjectDisposedException.ThrowIf(value && _isDisposed, this);
+
+                Volatile.Write(ref _isEnabled, value);
+
+                if (value)
+                {
+                    Interlocked.Increment(ref _enabledTracerCount);
+                }
+                else
+                {
+                    Interlocked.Decrement(ref _enabledTracerCount);
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Disables the tracer. Layers that are already wrapped keep forwarding their calls, and the statistics
+    /// recorded so far can still be read.
+    /// </summary>
+    public void Dispose()
+    {
+        lock (_locker)
+        {
+            IsEnabled = false;
+            _isDisposed = true;
+        }
+    }
+
+    /// <summary>
+    /// Wraps a storage so its operations are recorded under the specified layer name.
+    /// </summary>
+    /// <param name="storage">The storage to wrap.</param>
+    /// <param name="layerName">The name of the layer to record the storage's operations under.</param>
+    /// <param name="leaveOpen"><see langword="true"/> to leave <paramref name="storage"/> open
+    /// when the returned storage is disposed.</param>
+    /// <returns>The wrapped storage.</returns>
+    public IStorage WrapStorage(IStorage storage, string layerName, bool leaveOpen = false)
+    {
+        return new TracingStorage(storage, this, GetOrCreateLayer(layerName), leaveOpen);
+    }
+
+    /// <summary>
+    /// Wraps a file system so the operations of the files opened from it are recorded under the
+    /// specified layer name.
+    /// </summary>
+    /// <param name="fileSystem">The file system to wrap. The returned file system will hold a reference to it.</param>
+    /// <param name="layerName">The name of the layer to record the file system's operations under.</param>
+    /// <returns>The wrapped file system.</returns>
+    public IFileSystem WrapFileSystem(IFileSystem fileSystem, string layerName)
+    {
+        using var baseFileSystem = new SharedRef<IFileSystem>(fileSystem);
+        return new TracingFileSystem(in baseFileSystem, this, GetOrCreateLayer(layerName));
+    }
+
+    /// <summary>
+    /// Gets the storage wrapped by a storage returned from <see cref="WrapStorage"/>.
+    /// Storages that aren't wrapped are returned as-is.
+    /// </summary>
+    /// <param name="storage">The storage to unwrap.</param>
+    /// <returns>The innermost storage that isn't a tracing wrapper.</returns>
+    public static IStorage Unwrap(IStorage storage)
+    {
+        while (storage is TracingStorage tracingStorage)
+        {
+            storage = tracingStorage.BaseStorage;
+        }
+
+        return storage;
+    }
+
+    /// <summary>
+    /// Creates a snapshot of the statistics recorded for each layer.
+    /// </summary>
+    /// <returns>The created snapshot.</returns>
+    public StorageTraceSnapshot GetSnapshot()
+    {
+        Layer[] layers;
+
+        lock (_locker)
+        {
+            layers = _layerList.ToArray();
+        }
+
+        var layerSnapshots = new StorageLayerSnapshot[layers.Length];
+
+        for (int i = 0; i < layers.Length; i++)
+        {
+            layerSnapshots[i] = layers[i].CreateSnapshot();
+        }
+
+        return new StorageTraceSnapshot(layerSnapshots);
+    }
+
+    /// <summary>
+    /// Clears the statistics recorded for each layer.
+    /// </summary>
+    public void Reset()
+    {
+        lock (_locker)
+        {
+            foreach (Layer layer in _layerList)
+            {
+                layer.Reset();
+            }
+        }
+    }
+
+    /// <summary>
+    /// Records a cache hit on the layer currently being traced on this thread, if any.
+    /// </summary>
+    /// <remarks>Caching storages call this when a lookup is satisfied from their cache. The call is
+    /// ignored when no <see cref="StorageTracer"/> is enabled.</remarks>
+    public static void ReportCacheHit()
+    {
+        if (Volatile.Read(ref _enabledTracerCount) == 0)
+            return;
+
+        Layer layer = _currentLayer;
+        if (layer is not null)
+            Interlocked.Increment(ref layer.CacheHitCount);
+    }
+
+    /// <summary>
+    /// Records a cache miss on the layer currently being traced on this thread, if any.
+    /// </summary>
+    /// <remarks>Caching storages call this when a lookup has to go to their base storage. The call is
+    /// ignored when no <see cref="StorageTracer"/> is enabled.</remarks>
+    public static void ReportCacheMiss()
+    {
+        if (Volatile.Read(ref _enabledTracerCount) == 0)
+            return;
+
+        Layer layer = _currentLayer;
+        if (layer is not null)
+            Interlocked.Increment(ref layer.CacheMissCount);
+    }
+
+    internal static Scope BeginOperation(Layer layer)
+    {
+        var scope = new Scope(_currentLayer, _currentChildTicks, Stopwatch.GetTimestamp());
+
+        layer.ObserveParent(scope.ParentLayer);
+        _currentLayer = layer;
+        _currentChildTicks = 0;
+
+        return scope;
+    }
+
+    internal static void EndOperation(Layer layer, in Scope scope, StorageTraceOperation operation, long byteCount,
+        Result result)
+    {
+        long elapsedTicks = Stopwatch.GetTimestamp() - scope.StartTimestamp;
+        long selfTicks = elapsedTicks - _currentChildTicks;
+
+        layer.Record(operation, byteCount, elapsedTicks, selfTicks, result.IsSuccess());
+
+        _currentLayer = scope.ParentLayer;
+        _currentChildTicks = scope.ParentChildTicks + elapsedTicks;
+    }
+
+    /// <summary>
+    /// Records an asynchronous operation that started at <paramref name="startTimestamp"/>.
+    /// </summary>
+    /// <remarks>Asynchronous operations can't be attributed to a parent operation, so all of their
+    /// time is counted as self time.</remarks>
+    internal static void RecordAsyncOperation(Layer layer, long startTimestamp, StorageTraceOperation operation,
+        long byteCount, Result result)
+    {
+        long elapsedTicks = Stopwatch.GetTimestamp() - startTimestamp;
+        layer.Record(operation, byteCount, elapsedTicks, elapsedTicks, result.IsSuccess());
+    }
+
+    private Layer GetOrCreateLayer(string name)
+    {
+        lock (_locker)
+        {
+            if (!_layers.TryGetValue(name, out Layer layer))
+            {
+                layer = new Layer(name);
+                _layers.Add(name, layer);
+                _layerList.Add(layer);
+            }
+
+            return layer;
+        }
+    }
+
+    private static double TicksToNanoseconds(long ticks) => ticks * NanosecondsPerTick;
+
+    internal readonly struct Scope
+    {
+        public readonly Layer ParentLayer;
+        public readonly long ParentChildTicks;
+        public readonly long StartTimestamp;
+
+        public Scope(Layer parentLayer, long parentChildTicks, long startTimestamp)
+        {
+            ParentLayer = parentLayer;
+            ParentChildTicks = parentChildTicks;
+            StartTimestamp = startTimestamp;
+        }
+    }
+
+    internal sealed class Layer
+    {
+        public readonly string Name;
+        private Layer _parent;
+
+        public long ReadCount;
+        public long ReadBytes;
+        public long WriteCount;
+        public long WriteBytes;
+        public long OtherCount;
+        public long FailureCount;
+        public long CacheHitCount;
+        public long CacheMissCount;
+        public long TotalTicks;
+        public long SelfTicks;
+
+        // Latencies are recorded in nanoseconds
+        public readonly LatencyHistogram ReadLatency = new();
+        public readonly LatencyHistogram WriteLatency = new();
+
+        public Layer(string name)
+        {
+            Name = name;
+        }
+
+        public void ObserveParent(Layer parent)
+        {
+            if (parent is null || parent == this || Volatile.Read(ref _parent) is not null)
+                return;
+
+            Interlocked.CompareExchange(ref _parent, parent, null);
+        }
+
+        public void Record(StorageTraceOperation operation, long byteCount, long elapsedTicks, long selfTicks,
+            bool isSuccess)
+        {
+            switch (operation)
+            {
+                case StorageTraceOperation.Read:
+                    Interlocked.Increment(ref ReadCount);
+                    Interlocked.Add(ref ReadBytes, byteCount);
+                    ReadLatency.Record((long)TicksToNanoseconds(elapsedTicks));
+                    break;
+                case StorageTraceOperation.Write:
+                    Interlocked.Increment(ref WriteCount);
+                    Interlocked.Add(ref WriteBytes, byteCount);
+                    WriteLatency.Record((long)TicksToNanoseconds(elapsedTicks));
+                    break;
+                default:
+                    Interlocked.Increment(ref OtherCount);
+                    break;
+            }
+
+            if (!isSuccess)
+                Interlocked.Increment(ref FailureCount);
+
+            Interlocked.Add(ref TotalTicks, elapsedTicks);
+            Interlocked.Add(ref SelfTicks, selfTicks);
+        }
+
+        public StorageLayerSnapshot CreateSnapshot()
+        {
+            return new StorageLayerSnapshot
+            {
+                Name = Name,
+                ParentName = Volatile.Read(ref _parent)?.Name,
+                ReadCount = Interlocked.Read(ref ReadCount),
+                ReadBytes = Interlocked.Read(ref ReadBytes),
+                WriteCount = Interlocked.Read(ref WriteCount),
+                WriteBytes = Interlocked.Read(ref WriteBytes),
+                OtherCount = Interlocked.Read(ref OtherCount),
+                FailureCount = Interlocked.Read(ref FailureCount),
+                CacheHitCount = Interlocked.Read(ref CacheHitCount),
+                CacheMissCount = Interlocked.Read(ref CacheMissCount),
+                TotalNanoseconds = TicksToNanoseconds(Interlocked.Read(ref TotalTicks)),
+                SelfNanoseconds = TicksToNanoseconds(Interlocked.Read(ref SelfTicks)),
+                ReadLatency = ReadLatency.Clone(),
+                WriteLatency = WriteLatency.Clone()
+            };
+        }
+
+        public void Reset()
+        {
+            Interlocked.Exchange(ref ReadCount, 0);
+            Interlocked.Exchange(ref ReadBytes, 0);
+            Interlocked.Exchange(ref WriteCount, 0);
+            Interlocked.Exchange(ref WriteBytes, 0);
+            Interlocked.Exchange(ref OtherCount, 0);
+            Interlocked.Exchange(ref FailureCount, 0);
+            Interlocked.Exchange(ref CacheHitCount, 0);
+            Interlocked.Exchange(ref CacheMissCount, 0);
+            Interlocked.Exchange(ref TotalTicks, 0);
+            Interlocked.Exchange(ref SelfTicks, 0);
+            ReadLatency.Reset();
+            WriteLatency.Reset();
+        }
+    }
+}
+
+/// <summary>
+/// The statistics recorded for a single layer by a <see cref="StorageTracer"/>.
+/// </summary>
+public class StorageLayerSnapshot
+{
+    public string Name { get; init; }
+
+    /// <summary>The name of the layer that called into this layer, or <see langword="null"/>
+    /// if this layer was only called from outside the traced stack.</summary>
+    public string ParentName { get; init; }
+
+    public long ReadCount { get; init; }
+    public long ReadBytes { get; init; }
+    public long WriteCount { get; init; }
+    public long WriteBytes { get; init; }
+
+    /// <summary>The number of operations other than reads and writes, such as flushes and size queries.</summary>
+    public long OtherCount { get; init; }
+
+    /// <summary>The number of operations that returned a failure <see cref="Result"/>.</summary>
+    public long FailureCount { get; init; }
+
+    public long CacheHitCount { get; init; }
+    public long CacheMissCount { get; init; }
+
+    /// <summary>The total time spent in this layer's operations, including the time spent in child layers.</summary>
+    public double TotalNanoseconds { get; init; }
+
+    /// <summary>The time spent in this layer's operations, excluding the time spent in child layers.</summary>
+    public double SelfNanoseconds { get; init; }
+
+    /// <summary>The latencies of this layer's reads in nanoseconds.</summary>
+    public LatencyHistogram ReadLatency { get; init; }
+
+    /// <summary>The latencies of this layer's writes in nanoseconds.</summary>
+    public LatencyHistogram WriteLatency { get; init; }
+
+    public long OperationCount => ReadCount + WriteCount + OtherCount;
+}
+
+/// <summary>
+/// A point-in-time copy of the statistics recorded by a <see cref="StorageTracer"/>.
+/// </summary>
+public class StorageTraceSnapshot
+{
+    /// <summary>All the traced layers, in the order they were first wrapped.</summary>
+    public IReadOnlyList<StorageLayerSnapshot> Layers { get; }
+
+    public StorageTraceSnapshot(IReadOnlyList<StorageLayerSnapshot> layers)
+    {
+        Layers = layers;
+    }
+
+    /// <summary>
+    /// Gets the layer with the specified name.
+    /// </summary>
+    /// <param name="name">The name of the layer to find.</param>
+    /// <returns>The found layer, or <see langword="null"/> if no layer has that name.</returns>
+    public StorageLayerSnapshot FindLayer(string name)
+    {
+        foreach (StorageLayerSnapshot layer in Layers)
+        {
+            if (layer.Name == name)
+                return layer;
+        }
+
+        return null;
+    }
+
+    /// <summary>
+    /// Gets the layers that weren't observed being called from another traced layer.
+    /// </summary>
+    public IEnumerable<StorageLayerSnapshot> GetRootLayers()
+    {
+        foreach (StorageLayerSnapshot layer in Layers)
+        {
+            if (layer.ParentName is null)
+                yield return layer;
+        }
+    }
+
+    /// <summary>
+    /// Gets the layers whose parent is the specified layer.
+    /// </summary>
+    /// <param name="parent">The parent layer.</param>
+    public IEnumerable<StorageLayerSnapshot> GetChildLayers(StorageLayerSnapshot parent)
+    {
+        foreach (StorageLayerSnapshot layer in Layers)
+        {
+            if (layer.ParentName == parent.Name && layer != parent)
+                yield return layer;
+        }
+    }
+}
@@ -0,0 +1,290 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.ExceptionServices;
+using System.Threading;
+using LibHac.Diag;
+using LibHac.FsSrv;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// A single piece of work that is split into multiple parts which can be run on different threads.
+/// </summary>
+public interface IThreadPoolWork
+{
+    /// <summary>
+    /// Runs one part of the work.
+    /// </summary>
+    /// <param name="index">The index of the part to run.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    Result Run(int index);
+}
+
+/// <summary>
+/// A pool of threads used to process the chunks of split requests in parallel.
+/// </summary>
+/// <remarks>LibHac addition. Used by <see cref="AsynchronousAccessStorage"/> in place of nnSdk's FS thread pool.
+/// </remarks>
+public interface IThreadPool : IDisposable
+{
+    /// <summary>
+    /// Gets the number of threads in the pool, not including the thread that calls <see cref="Execute"/>.
+    /// </summary>
+    int GetThreadCount();
+
+    /// <summary>
+    /// Gets the smallest size that a request should be split into when running it on the pool.
+    /// </summary>
+    long GetMinimumSplitSize();
+
+    /// <summary>
+    /// Runs every part of <paramref name="work"/> using the threads in the pool and the calling thread,
+    /// returning once all parts have finished.
+    /// </summary>
+    /// <param name="work">The work to run.</param>
+    /// <param name="workCount">The number of parts <paramref name="work"/> is split into.</param>
+    /// <returns>The <see cref="Result"/> of the first part that failed, or <see cref="Result.Success"/>
+    /// if all parts succeeded.</returns>
+    Result Execute(IThreadPoolWork work, int workCount);
+
+    /// <summary>
+    /// Queues <paramref name="work"/> to run on one of the threads in the pool and returns without waiting for it.
+    /// Only part 0 of the work is run.
+    /// </summary>
+    /// <remarks>The result of the work and any exception it throws are ignored, so the work must handle its
+    /// own failures. Work that has been queued is still run if the pool is disposed before it starts.</remarks>
+    /// <param name="work">The work to run.</param>
+    /// <returns><see langword="true"/> if the work was queued, or <see langword="false"/> if the pool
+    /// has been disposed.</returns>
+    bool TryQueue(IThreadPoolWork work);
+}
+
+internal struct ThreadPoolGlobals
+{
+    public IThreadPool RegisteredThreadPool;
+}
+
+public static class ThreadPoolGlobalMethods
+{
+    /// <summary>
+    /// Registers the thread pool that storages created by the FS server will use to process requests in parallel.
+    /// The caller keeps ownership of the thread pool and must not dispose it while the server is using it.
+    /// </summary>
+    /// <remarks>No thread pool is registered by default, so requests are only split across threads
+    /// after a pool is registered.</remarks>
+    /// <param name="fsSrv">The <see cref="FileSystemServer"/> to register the thread pool with.</param>
+    /// <param name="threadPool">The thread pool to register, or <see langword="null"/> to process
+    /// all requests on the calling thread.</param>
+    public static void RegisterThreadPool(this FileSystemServer fsSrv, IThreadPool threadPool)
+    {
+        fsSrv.Globals.ThreadPool.RegisteredThreadPool = threadPool;
+    }
+
+    public static IThreadPool GetRegisteredThreadPool(this FileSystemServer fsSrv)
+    {
+        return fsSrv.Globals.ThreadPool.RegisteredThreadPool;
+    }
+}
+
+/// <summary>
+/// An <see cref="IThreadPool"/> that runs work on a fixed number of dedicated threads.
+/// </summary>
+/// <remarks>LibHac addition.</remarks>
+public class WorkerThreadPool : IThreadPool
+{
+    public const long DefaultMinimumSplitSize = 0x40000;
+
+    private readonly Thread[] _threads;
+    private readonly long _minimumSplitSize;
+    private readonly Queue<Job> _pendingJobs;
+    private readonly object _locker;
+    private bool _isDisposed;
+
+    /// <summary>
+    /// Creates a new <see cref="WorkerThreadPool"/> and starts its threads.
+    /// </summary>
+    /// <param name="threadCount">The number of threads to create.</param>
+    /// <param name="minimumSplitSize">The smallest size that requests should be split into.</param>
+    public WorkerThreadPool(int threadCount, long minimumSplitSize = DefaultMinimumSplitSize)
+    {
+        Assert.SdkRequiresLess(0, threadCount);
+        Assert.SdkRequiresLess(0, minimumSplitSize);
+
+        _minimumSplitSize = minimumSplitSize;
+        _pendingJobs = new Queue<Job>();
+        _locker = new object();
+        _threads = new Thread[threadCount];
+
+        for (int i = 0; i < _threads.Length; i++)
+        {
+            _threads[i] = new Thread(WorkerThreadMain) { IsBackground = true, Name = $"LibHac FS worker {i}" };
+            _threads[i].Start();
+        }
+    }
+
+    public void Dispose()
+    {
+        lock (_locker)
+        {
+            if (_isDisposed)
+                return;
+
+            _isDisposed = true;
+            Monitor.PulseAll(_locker);
+        }
+
+        foreach (Thread thread in _threads)
+        {
+            thread.Join();
+        }
+    }
+
+    public int GetThreadCount() => _threads.Length;
+    public long GetMinimumSplitSize() => _minimumSplitSize;
+
+    public Result Execute(IThreadPoolWork work, int workCount)
+    {
+        Assert.SdkRequiresNotNull(work);
+        Assert.SdkRequiresLessEqual(0, workCount);
+
+        if (workCount <= 1)
+        {
+            return workCount == 0 ? Result.Success : work.Run(0);
+        }
+
+        var job = new Job(work, workCount);
+
+        // The calling thread will also run parts of the job, so don't wake more threads than needed
+        int helperCount = Math.Min(_threads.Length, workCount - 1);
+
+        lock (_locker)
+        {
+            if (!_isDisposed)
+            {
+                for (int i = 0; i < helperCount; i++)
+                {
+                    _pendingJobs.Enqueue(job);
+                }
+
+                Monitor.PulseAll(_locker);
+            }
+        }
+
+        job.Run();
+        return job.WaitForCompletion();
+    }
+
+    public bool TryQueue(IThreadPoolWork work)
+    {
+        Assert.SdkRequiresNotNull(work);
+
+        lock (_locker)
+        {
+            if (_isDisposed)
+                return false;
+
+            _pendingJobs.Enqueue(new Job(work, 1));
+            Monitor.Pulse(_locker);
+        }
+
+        return true;
+    }
+
+    private void WorkerThreadMain()
+    {
+        while (true)
+        {
+            Job job;
+
+            lock (_locker)
+            {
+                while (_pendingJobs.Count == 0 && !_isDisposed)
+                {
+                    Monitor.Wait(_locker);
+                }
+
+                // Queued jobs have nobody waiting on them, so they're run before exiting.
+                // Any other pending jobs will be finished by the threads that are waiting on them.
+                if (_pendingJobs.Count == 0)
+                    return;
+
+                job = _pendingJobs.Dequeue();
+            }
+
+            job.Run();
+        }
+    }
+
+    private sealed class Job
+    {
+        private readonly IThreadPoolWork _work;
+        private readonly int _workCount;
+        private readonly object _locker;
+        private int _nextIndex;
+        private int _remainingCount;
+        private Result _result;
+        private ExceptionDispatchInfo _exception;
+
+        public Job(IThreadPoolWork work, int workCount)
+        {
+            _work = work;
+            _workCount = workCount;
+            _locker = new object();
+            _nextIndex = -1;
+            _remainingCount = workCount;
+            _result = Result.Success;
+        }
+
+        public void Run()
+        {
+            int index;
+
+            while ((index = Interlocked.Increment(ref _nextIndex)) < _workCount)
+            {
+                try
+                {
+                    Result res = _work.Run(index);
+
+                    if (res.IsFailure())
+                    {
+                        lock (_locker)
+                        {
+                            if (_result.IsSuccess())
+                                _result = res;
+                        }
+                    }
+                }
+                catch (Exception ex)
+                {
+                    lock (_locker)
+                    {
+                        _exception ??= ExceptionDispatchInfo.Capture(ex);
+                    }
+                }
+
+                if (Interlocked.Decrement(ref _remainingCount) == 0)
+                {
+                    lock (_locker)
+                    {
+                        Monitor.PulseAll(_locker);
+                    }
+                }
+            }
+        }
+
+        public Result WaitForCompletion()
+        {
+            // Waiting on a monitor means the job doesn't own a wait handle that would need to be disposed
+            lock (_locker)
+            {
+                while (Volatile.Read(ref _remainingCount) != 0)
+                {
+                    Monitor.Wait(_locker);
+                }
+            }
+
+            _exception?.Throw();
+            return _result;
+        }
+    }
+}
@@ -0,0 +1,256 @@
+﻿using System;
+using System.Diagnostics;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using Layer = LibHac.FsSystem.StorageTracer.Layer;
+using Scope = LibHac.FsSystem.StorageTracer.Scope;
+
+namespace LibHac.FsSystem;
+
+/// <summary>
+/// Forwards all calls to a base <see cref="IStorage"/>, recording them in a <see cref="StorageTracer"/> layer.
+/// </summary>
+/// <remarks>Created by <see cref="StorageTracer.WrapStorage"/>.</remarks>
+internal sealed class TracingStorage : IStorage
+{
+    private readonly IStorage _baseStorage;
+    private readonly StorageTracer _tracer;
+    private readonly Layer _layer;
+    private readonly bool _leaveOpen;
+
+    public IStorage BaseStorage => _baseStorage;
+
+    public TracingStorage(IStorage baseStorage, StorageTracer tracer, Layer layer, bool leaveOpen)
+    {
+        _baseStorage = baseStorage;
+        _tracer = tracer;
+        _layer = layer;
+        _leaveOpen = leaveOpen;
+    }
+
+    public override void Dispose()
+    {
+        if (!_leaveOpen)
+        {
+            _baseStorage.Dispose();
+        }
+
+        base.Dispose();
+    }
+
+    public override Result Read(long offset, Span<byte> destination)
+    {
+        if (!_tracer.IsEnabled)
+            return _baseStorage.Read(offset, destination);
+
+        Scope scope = StorageTracer.BeginOperation(_layer);
+        Result res = ResultFs.NotInitialized.Value;
+
+        try
+        {
+            res = _baseStorage.Read(offset, destination);
+            return res;
+        }
+        finally
+        {
+            StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Read, destination.Length, res);
+        }
+    }
+
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (!_tracer.IsEnabled)
+            return _baseStorage.ReadAsync(offset, destination, cancellationToken);
+
+        return ReadAsyncTraced(offset, destination, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncTraced(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken)
+    {
+        long startTimestamp = Stopwatch.GetTimestamp();
+        Result res = ResultFs.NotInitialized.Value;
+
+        try
+        {
+            res = await _baseStorage.ReadAsync(offset, destination, cancellationToken).ConfigureAwait(false);
+            return res;
+        }
+        finally
+        {
+            StorageTracer.RecordAsyncOperation(_layer, startTimestamp, StorageTraceOperation.Read,
+                destination.Length, res);
+        }
+    }
+
+    public override Result Write(long offset, ReadOnlySpan<byte> source)
+    {
+        if (!_tracer.IsEnabled)
+            return _baseStorage.Write(offset, source);
+
+        Scope scope = StorageTracer.BeginOperation(_layer);
+        Result res = ResultFs.NotInitialized.Value;
+
+        try
+        {
+            res = _baseStorage.Write(offset, source);
+            return res;
+        }
+        finally
+        {
+            StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Write, source.Length, res);
+        }
+    }
+
+    public override Result Flush()
+    {
+        if (!_tracer.IsEnabled)
+            return _baseStorage.Flush();
+
+        Scope scope = StorageTracer.BeginOperation(_layer);
+        Result res = ResultFs.NotInitialized.Value;
+
+        try
+        {
+            res = _baseStorage.Flush();
+            return res;
+        }
+        finally
+        {
+            StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Other, 0, res);
+        }
+    }
+
+    public override Result SetSize(long size)
+    {
+        return _baseStorage.SetSize(size);
+    }
+
+    public override Result GetSize(out long size)
+    {
+        return _baseStorage.GetSize(out size);
+    }
+
+    public override Result OperateRange(Span<byte> outBuffer, OperationId operationId, long offset, long size,
+        ReadOnlySpan<byte> inBuffer)
+    {
+        if (!_tracer.IsEnabled)
+            return _baseStorage.OperateRange(outBuffer, operationId, offset, size, inBuffer);
+
+        Scope scope = StorageTracer.BeginOperation(_layer);
+        Result res = ResultFs.NotInitialized.Value;
+
+        try
+        {
+            res = _baseStorage.OperateRange(outBuffer, operationId, offset, size, inBuffer);
+            return res;
+        }
+        finally
+        {
+            StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Other, 0, res);
+        }
+    }
+}
+
+/// <summary>
+/// Forwards all calls to a base <see cref="IFileSystem"/>, recording the operations of the files opened
+/// from it in a <see cref="StorageTracer"/> layer.
+/// </summary>
+/// <remarks>Created by <see cref="StorageTracer.WrapFileSystem"/>.</remarks>
+internal sealed class TracingFileSystem : ForwardingFileSystem
+{
+    private readonly StorageTracer _tracer;
+    private readonly Layer _layer;
+
+    public TracingFileSystem(ref readonly SharedRef<IFileSystem> baseFileSystem, StorageTracer tracer, Layer layer)
+        : base(in baseFileSystem)
+    {
+        _tracer = tracer;
+        _layer = layer;
+    }
+
+    protected override Result DoOpenFile(ref UniqueRef<IFile> outFile, ref readonly Path path, OpenMode mode)
+    {
+        using var baseFile = new UniqueRef<IFile>();
+
+        if (!_tracer.IsEnabled)
+        {
+            Result res = BaseFileSystem.Get.OpenFile(ref baseFile.Ref, in path, mode);
+            if (res.IsFailure()) return res.Miss();
+        }
+        else
+        {
+            Scope scope = StorageTracer.BeginOperation(_layer);
+            Result res = ResultFs.NotInitialized.Value;
+
+            try
+            {
+                res = BaseFileSystem.Get.OpenFile(ref baseFile.Ref, in path, mode);
+                if (res.IsFailure()) return res.Miss();
+            }
+            finally
+            {
+                StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Other, 0, res);
+            }
+        }
+
+        outFile.Reset(new TracingFile(ref baseFile.Ref, _tracer, _layer));
+        return Result.Success;
+    }
+
+    private sealed class TracingFile : ForwardingFile
+    {
+        private readonly StorageTracer _tracer;
+        private readonly Layer _layer;
+
+        public TracingFile(ref UniqueRef<IFile> baseFile, StorageTracer tracer, Layer layer) : base(ref baseFile)
+        {
+            _tracer = tracer;
+            _layer = layer;
+        }
+
+        protected override Result DoRead(out long bytesRead, long offset, Span<byte> destination,
+            in ReadOption option)
+        {
+            if (!_tracer.IsEnabled)
+                return BaseFile.Get.Read(out bytesRead, offset, destination, in option);
+
+            Scope scope = StorageTracer.BeginOperation(_layer);
+            Result res = ResultFs.NotInitialized.Value;
+            bytesRead = 0;
+
+            try
+            {
+                res = BaseFile.Get.Read(out bytesRead, offset, destination, in option);
+                return res;
+            }
+            finally
+            {
+                StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Read, bytesRead, res);
+            }
+        }
+
+        protected override Result DoWrite(long offset, ReadOnlySpan<byte> source, in WriteOption option)
+        {
+            if (!_tracer.IsEnabled)
+                return BaseFile.Get.Write(offset, source, in option);
+
+            Scope scope = StorageTracer.BeginOperation(_layer);
+            Result res = ResultFs.NotInitialized.Value;
+
+            try
+            {
+                res = BaseFile.Get.Write(offset, source, in option);
+                return res;
+            }
+            finally
+            {
+                StorageTracer.EndOperation(_layer, in scope, StorageTraceOperation.Write, source.Length, res);
+            }
+        }
+    }
+}
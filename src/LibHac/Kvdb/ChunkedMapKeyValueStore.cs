@@ -0,0 +1,1158 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using LibHac.Common;
+using LibHac.Diag;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using Buffer = LibHac.Mem.Buffer;
+
+namespace LibHac.Kvdb;
+
+/// <summary>
+/// Represents a collection of keys and values that are sorted by the key,
+/// and may be saved and loaded from an archive file on disk.
+/// </summary>
+/// <remarks><para>Has the same interface as <see cref="FlatMapKeyValueStore{TKey}"/>, but is intended for stores with
+/// many entries that are frequently modified. Entries are kept in a list of small sorted chunks so adding or removing
+/// an entry only moves the entries in a single chunk instead of every entry after it.</para>
+/// <para>Saving the store appends the entries changed since the last save to the log file imkvdb.log instead of
+/// rewriting the whole archive. The archive is only rewritten and the log deleted once the log has grown large
+/// enough relative to the number of entries in the store. Loading reads the archive and then replays the log.</para>
+/// <para>An entry accessed through an <see cref="Iterator"/> is recorded in the log on the next save because its
+/// value may have been modified through the returned reference.</para>
+/// <para>The log is a LibHac addition that FS doesn't read, so this store must not be used for databases that
+/// are shared with FS, such as the save data indexer's.</para></remarks>
+/// <typeparam name="TKey">The type of the keys in the keys in the key-value store.</typeparam>
+public class ChunkedMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IEquatable<TKey>, IComparable<TKey>
+{
+    private const int Alignment = 0x10;
+
+    // The number of log entries allowed before the archive is rewritten is the larger of this value and a
+    // quarter of the number of entries in the store. Keeping the log small relative to the archive keeps
+    // the total size of the database files well below twice the size of the archive.
+    private const int CompactionLogEntryCountMin = 64;
+    private const int CompactionLogEntryCountShift = 2;
+
+    private const int DeletedValueSize = -1;
+
+    private FileSystemClient _fsClient;
+    private Index _index;
+    private BoundedString<Size768> _archivePath;
+    private BoundedString<Size768> _logPath;
+    private MemoryResource _memoryResource;
+    private MemoryResource _memoryResourceForAutoBuffers;
+
+    private HashSet<TKey> _modifiedKeys;
+    private bool _isCompactionRequired;
+    private int _logEntryCount;
+    private long _logSize;
+
+    private static ReadOnlySpan<byte> ArchiveFileName => "/imkvdb.arc"u8;
+    private static ReadOnlySpan<byte> LogFileName => "/imkvdb.log"u8;
+
+    public int Count => _index.Count;
+
+    public ChunkedMapKeyValueStore()
+    {
+        _index = new Index();
+        _modifiedKeys = new HashSet<TKey>();
+
+        Unsafe.SkipInit(out _archivePath);
+        _archivePath.Get()[0] = 0;
+
+        Unsafe.SkipInit(out _logPath);
+        _logPath.Get()[0] = 0;
+    }
+
+    /// <summary>
+    /// Initializes a <see cref="ChunkedMapKeyValueStore{T}"/>. Reads and writes the store to and from the files
+    /// imkvdb.arc and imkvdb.log in the specified <paramref name="rootPath"/> directory. This directory must exist
+    /// when calling <see cref="Initialize"/>, but it is not required for either file to exist.
+    /// </summary>
+    /// <param name="fsClient">The <see cref="FileSystemClient"/> to use for reading and writing the archive.</param>
+    /// <param name="rootPath">The directory path used to load and save the archive file. Directory must already exist.</param>
+    /// <param name="capacity">The maximum number of entries that can be stored.</param>
+    /// <param name="memoryResource"><see cref="MemoryResource"/> for allocating buffers to hold entries and values.</param>
+    /// <param name="autoBufferMemoryResource"><see cref="MemoryResource"/> for allocating temporary buffers
+    /// when reading and writing the store to a file.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result Initialize(FileSystemClient fsClient, U8Span rootPath, int capacity,
+        MemoryResource memoryResource, MemoryResource autoBufferMemoryResource)
+    {
+        // The root path must be an existing directory
+        Result res = fsClient.GetEntryType(out DirectoryEntryType rootEntryType, rootPath);
+        if (res.IsFailure()) return res.Miss();
+
+        if (rootEntryType == DirectoryEntryType.File)
+            return ResultFs.PathNotFound.Log();
+
+        var sb = new U8StringBuilder(_archivePath.Get());
+        sb.Append(rootPath).Append(ArchiveFileName);
+
+        sb = new U8StringBuilder(_logPath.Get());
+        sb.Append(rootPath).Append(LogFileName);
+
+        res = _index.Initialize(capacity, memoryResource);
+        if (res.IsFailure()) return res.Miss();
+
+        _fsClient = fsClient;
+        _memoryResource = memoryResource;
+        _memoryResourceForAutoBuffers = autoBufferMemoryResource;
+
+        return Result.Success;
+    }
+
+    public void Dispose()
+    {
+        _index.Dispose();
+    }
+
+    /// <summary>
+    /// Clears all entries in the <see cref="ChunkedMapKeyValueStore{T}"/> and loads all entries
+    /// from the database archive and log files, if they exist.
+    /// </summary>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result Load()
+    {
+        // Clear any existing entries.
+        _index.Clear();
+        ResetLogState();
+
+        var buffer = new AutoBuffer();
+
+        try
+        {
+            Result res = KeyValueArchiveFile.ReadFile(_fsClient, ref buffer, new U8Span(_archivePath.Get()),
+                _memoryResourceForAutoBuffers);
+            if (res.IsFailure())
+            {
+                // If the file is not found, we don't have any entries to load from the archive.
+                if (!ResultFs.PathNotFound.Includes(res))
+                    return res;
+            }
+            else
+            {
+                res = KeyValueArchiveFile.LoadFrom<TKey, Index>(ref _index, buffer.Get(), _memoryResource);
+                if (res.IsFailure()) return res.Miss();
+            }
+        }
+        finally
+        {
+            buffer.Dispose();
+        }
+
+        var logBuffer = new AutoBuffer();
+
+        try
+        {
+            Result res = KeyValueArchiveFile.ReadFile(_fsClient, ref logBuffer, new U8Span(_logPath.Get()),
+                _memoryResourceForAutoBuffers);
+            if (res.IsFailure())
+            {
+                // If the file is not found, there are no changes to apply to the archive.
+                if (ResultFs.PathNotFound.Includes(res))
+                    return Result.Success.LogConverted(res);
+
+                return res;
+            }
+
+            res = ReplayLog(logBuffer.Get());
+            if (res.IsFailure()) return res.Miss();
+
+            _logSize = logBuffer.Get().Length;
+            return Result.Success;
+        }
+        finally
+        {
+            logBuffer.Dispose();
+        }
+    }
+
+    /// <summary>
+    /// Saves all changes made to the <see cref="ChunkedMapKeyValueStore{T}"/> since it was last loaded or saved.
+    /// The changes are appended to the database log file, or the database archive file is rewritten
+    /// if the log has grown too large.
+    /// </summary>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result Save()
+    {
+        if (_isCompactionRequired || IsCompactionRequired(_logEntryCount + _modifiedKeys.Count))
+            return Compact();
+
+        if (_modifiedKeys.Count == 0)
+            return Result.Success;
+
+        return AppendLog();
+    }
+
+    /// <summary>
+    /// Writes all entries in the <see cref="ChunkedMapKeyValueStore{T}"/> to a database archive file
+    /// and deletes the database log file.
+    /// </summary>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result Compact()
+    {
+        Result res = KeyValueArchiveFile.Save<TKey, ConstIterator>(_fsClient, new U8Span(_archivePath.Get()),
+            _index.Count, GetBeginConstIterator(), _memoryResourceForAutoBuffers);
+        if (res.IsFailure()) return res.Miss();
+
+        // The archive now contains every change in the log.
+        res = _fsClient.DeleteFile(new U8Span(_logPath.Get()));
+        if (res.IsFailure() && !ResultFs.PathNotFound.Includes(res))
+            return res.Miss();
+
+        ResetLogState();
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Gets the value associated with the specified key.
+    /// </summary>
+    /// <param name="valueSize">If the method returns successfully, contains the size of
+    /// the value written to <paramref name="valueBuffer"/>. This may be smaller than the
+    /// actual length of the value if <paramref name="valueBuffer"/> was not large enough.</param>
+    /// <param name="key">The key of the value to get.</param>
+    /// <param name="valueBuffer">If the method returns successfully, contains the value
+    /// associated with the specified key. Otherwise, the buffer will not be modified.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    /// <remarks>Possible <see cref="Result"/>s:<br/>
+    /// <see cref="ResultKvdb.KeyNotFound"/>
+    /// The specified key was not found in the <see cref="ChunkedMapKeyValueStore{T}"/>.</remarks>
+    public Result Get(out int valueSize, in TKey key, Span<byte> valueBuffer)
+    {
+        UnsafeHelpers.SkipParamInit(out valueSize);
+
+        // Find entry.
+        if (!_index.TryGetValue(in key, out Buffer storedValue))
+            return ResultKvdb.KeyNotFound.Log();
+
+        // Truncate the output if the buffer is too small.
+        ReadOnlySpan<byte> value = storedValue.Span;
+        int size = Math.Min(valueBuffer.Length, value.Length);
+
+        value.Slice(0, size).CopyTo(valueBuffer);
+        valueSize = size;
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Adds the specified key and value to the <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// The existing value is replaced if the key already exists.
+    /// </summary>
+    /// <param name="key">The key to add.</param>
+    /// <param name="value">The value to add.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public Result Set(in TKey key, ReadOnlySpan<byte> value)
+    {
+        Result res = _index.Set(in key, value);
+        if (res.IsFailure()) return res.Miss();
+
+        AddModifiedKey(in key);
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Adds multiple keys and values to the <see cref="ChunkedMapKeyValueStore{T}"/>. Existing values are
+    /// replaced if a key already exists. If a key is given more than once, the last value given for it is used.
+    /// </summary>
+    /// <remarks>The new entries are sorted and merged with the existing entries in a single pass, which is
+    /// much faster than calling <see cref="Set"/> for each entry when adding many entries at once.
+    /// No entries are added if the operation fails.</remarks>
+    /// <param name="keys">The keys to add.</param>
+    /// <param name="values">The values to add. Must contain <paramref name="valueSize"/> bytes
+    /// for each key in <paramref name="keys"/>, in the same order as the keys.</param>
+    /// <param name="valueSize">The size of each value in <paramref name="values"/>.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    /// <remarks>Possible <see cref="Result"/>s:<br/>
+    /// <see cref="ResultKvdb.OutOfKeyResource"/>
+    /// The new entries would cause the store to exceed its capacity.<br/>
+    /// <see cref="ResultKvdb.AllocationFailed"/>
+    /// The memory for the new values could not be allocated.</remarks>
+    public Result SetRange(ReadOnlySpan<TKey> keys, ReadOnlySpan<byte> values, int valueSize)
+    {
+        Assert.SdkRequiresLessEqual(0, valueSize);
+        Assert.SdkRequiresEqual((long)keys.Length * valueSize, values.Length);
+
+        Result res = _index.SetRange(keys, values, valueSize);
+        if (res.IsFailure()) return res.Miss();
+
+        for (int i = 0; i < keys.Length; i++)
+        {
+            AddModifiedKey(in keys[i]);
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Deletes an element from the <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// </summary>
+    /// <param name="key">The key of the element to delete.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    /// <remarks>Possible <see cref="Result"/>s:<br/>
+    /// <see cref="ResultKvdb.KeyNotFound"/>
+    /// The specified key was not found in the <see cref="ChunkedMapKeyValueStore{T}"/>.</remarks>
+    public Result Delete(in TKey key)
+    {
+        if (!_index.Delete(in key))
+            return ResultKvdb.KeyNotFound.Log();
+
+        AddModifiedKey(in key);
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Creates an <see cref="Iterator"/> that starts at the first element in the <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// </summary>
+    /// <returns>The created iterator.</returns>
+    public Iterator GetBeginIterator()
+    {
+        return new Iterator(this, _index, 0);
+    }
+
+    /// <summary>
+    /// Creates an <see cref="Iterator"/> that starts at the first element equal to or greater than
+    /// <paramref name="key"/> in the <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// </summary>
+    /// <param name="key">The key at which to begin iteration.</param>
+    /// <returns>The created iterator.</returns>
+    public Iterator GetLowerBoundIterator(in TKey key)
+    {
+        return new Iterator(this, _index, _index.GetLowerBoundPosition(in key));
+    }
+
+    /// <summary>
+    /// Fixes an iterator's current position and total length so that after an entry
+    /// is added or removed, the iterator will still be on the same entry.
+    /// </summary>
+    /// <param name="iterator">The iterator to fix.</param>
+    /// <param name="key">The key that was added or removed.</param>
+    public void FixIterator(ref Iterator iterator, in TKey key)
+    {
+        int keyPosition = _index.GetLowerBoundPosition(in key);
+        iterator.Fix(keyPosition, _index.Count);
+    }
+
+    private void AddModifiedKey(in TKey key)
+    {
+        if (_isCompactionRequired)
+            return;
+
+        _modifiedKeys.Add(key);
+
+        // Stop tracking individual keys once we know the archive will be rewritten on the next save.
+        if (IsCompactionRequired(_logEntryCount + _modifiedKeys.Count))
+        {
+            _isCompactionRequired = true;
+            _modifiedKeys.Clear();
+        }
+    }
+
+    private bool IsCompactionRequired(int logEntryCount)
+    {
+        int maxLogEntryCount = Math.Max(_index.Count >> CompactionLogEntryCountShift, CompactionLogEntryCountMin);
+        return logEntryCount > maxLogEntryCount;
+    }
+
+    private void ResetLogState()
+    {
+        _modifiedKeys.Clear();
+        _isCompactionRequired = false;
+        _logEntryCount = 0;
+        _logSize = 0;
+    }
+
+    /// <summary>
+    /// Applies each change in a database log to the entries loaded from the archive.
+    /// </summary>
+    /// <param name="buffer">The buffer containing the database log.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    private Result ReplayLog(ReadOnlySpan<byte> buffer)
+    {
+        int entryHeaderSize = Unsafe.SizeOf<KeyValueArchiveEntryHeader>();
+        int keySize = Unsafe.SizeOf<TKey>();
+        int offset = 0;
+
+        while (offset < buffer.Length)
+        {
+            if (buffer.Length - offset < entryHeaderSize + keySize)
+                return ResultKvdb.InvalidKeyValue.Log();
+
+            ref readonly KeyValueArchiveEntryHeader header =
+                ref MemoryMarshal.AsRef<KeyValueArchiveEntryHeader>(buffer.Slice(offset, entryHeaderSize));
+
+            if (!header.IsValid() || header.KeySize != keySize || header.ValueSize < DeletedValueSize)
+                return ResultKvdb.InvalidKeyValue.Log();
+
+            offset += entryHeaderSize;
+
+            TKey key = MemoryMarshal.Read<TKey>(buffer.Slice(offset, keySize));
+            offset += keySize;
+
+            if (header.ValueSize == DeletedValueSize)
+            {
+                _index.Delete(in key);
+            }
+            else
+            {
+                if (buffer.Length - offset < header.ValueSize)
+                    return ResultKvdb.InvalidKeyValue.Log();
+
+                Result res = _index.Set(in key, buffer.Slice(offset, header.ValueSize));
+                if (res.IsFailure()) return res.Miss();
+
+                offset += header.ValueSize;
+            }
+
+            _logEntryCount++;
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Appends an entry to the database log for each key modified since the last save. Keys that
+    /// are still in the store are written with their current value, and removed keys are written
+    /// as deletions. All deletions are written before the values so replaying the log never needs
+    /// room for more entries than the store had before or after the save.
+    /// </summary>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    private Result AppendLog()
+    {
+        int entryHeaderSize = Unsafe.SizeOf<KeyValueArchiveEntryHeader>();
+        int keySize = Unsafe.SizeOf<TKey>();
+
+        long logDataSize = 0;
+        foreach (TKey key in _modifiedKeys)
+        {
+            logDataSize += entryHeaderSize + keySize;
+
+            if (_index.TryGetValue(in key, out Buffer value))
+                logDataSize += value.Length;
+        }
+
+        var buffer = new AutoBuffer();
+        Result res = buffer.Initialize(logDataSize, _memoryResourceForAutoBuffers);
+        if (res.IsFailure()) return res.Miss();
+
+        try
+        {
+            Span<byte> span = buffer.Get();
+            int offset = 0;
+
+            for (int pass = 0; pass < 2; pass++)
+            {
+                bool writeValues = pass == 1;
+
+                foreach (TKey key in _modifiedKeys)
+                {
+                    bool exists = _index.TryGetValue(in key, out Buffer value);
+                    if (exists != writeValues)
+                        continue;
+
+                    var header = new KeyValueArchiveEntryHeader(keySize, exists ? value.Length : DeletedValueSize);
+                    MemoryMarshal.Write(span.Slice(offset), in header);
+                    offset += entryHeaderSize;
+
+                    MemoryMarshal.Write(span.Slice(offset), in key);
+                    offset += keySize;
+
+                    if (exists)
+                    {
+                        value.Span.CopyTo(span.Slice(offset));
+                        offset += value.Length;
+                    }
+                }
+            }
+
+            var path = new U8Span(_logPath.Get());
+
+            if (_logSize == 0)
+            {
+                // Remove any leftover log from before the store was loaded.
+                _fsClient.DeleteFile(path).IgnoreResult();
+
+                res = _fsClient.CreateFile(path, 0);
+                if (res.IsFailure()) return res.Miss();
+            }
+
+            res = _fsClient.OpenFile(out FileHandle file, path, OpenMode.Write | OpenMode.AllowAppend);
+            if (res.IsFailure()) return res.Miss();
+
+            try
+            {
+                res = _fsClient.WriteFile(file, _logSize, span, WriteOption.Flush);
+                if (res.IsFailure()) return res.Miss();
+            }
+            finally
+            {
+                _fsClient.CloseFile(file);
+            }
+
+            _logSize += span.Length;
+            _logEntryCount += _modifiedKeys.Count;
+            _modifiedKeys.Clear();
+
+            return Result.Success;
+        }
+        finally
+        {
+            buffer.Dispose();
+        }
+    }
+
+    private ConstIterator GetBeginConstIterator()
+    {
+        return new ConstIterator(new Iterator(null, _index, 0));
+    }
+
+    /// <summary>
+    /// Represents a key-value pair contained in a <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// </summary>
+    public struct KeyValue
+    {
+        public TKey Key;
+        public Buffer Value;
+
+        public KeyValue(in TKey key, Buffer value)
+        {
+            Key = key;
+            Value = value;
+        }
+    }
+
+    /// <summary>
+    /// A sorted run of entries in an <see cref="Index"/>.
+    /// </summary>
+    internal sealed class Chunk
+    {
+        public readonly KeyValue[] Entries = new KeyValue[Index.ChunkCapacity];
+        public int Count;
+
+        public ref readonly TKey LastKey => ref Entries[Count - 1].Key;
+    }
+
+    /// <summary>
+    /// Manages the sorted list of <see cref="KeyValue"/> entries in a <see cref="ChunkedMapKeyValueStore{T}"/>.
+    /// </summary>
+    /// <remarks>Entries are split into chunks holding up to <see cref="ChunkCapacity"/> entries each.
+    /// A key is found by binary searching the chunks by their last key, then binary searching the entries
+    /// in that chunk. Inserting into a full chunk splits it in half, and empty chunks are removed.</remarks>
+    internal sealed class Index : IDisposable, IKeyValueArchiveIndex<TKey>
+    {
+        public const int ChunkCapacity = 128;
+
+        // Chunks created when loading entries in bulk are left partially empty
+        // so entries can be added afterward without immediately splitting them.
+        private const int BulkLoadChunkCount = ChunkCapacity * 3 / 4;
+
+        private List<Chunk> _chunks;
+        private int _count;
+        private int _capacity;
+        private MemoryResource _memoryResource;
+
+        /// <summary>
+        /// The number of elements currently in the <see cref="Index"/>.
+        /// </summary>
+        public int Count => _count;
+
+        /// <summary>
+        /// Incremented every time entries are added or removed. Used by iterators to know
+        /// when their cached chunk location is no longer valid.
+        /// </summary>
+        public int Version { get; private set; }
+
+        public int ChunkCount => _chunks.Count;
+
+        /// <summary>
+        /// Initializes the <see cref="Index"/>
+        /// </summary>
+        /// <param name="capacity">The maximum number of elements the <see cref="Index"/> will be able to hold.</param>
+        /// <param name="memoryResource">The <see cref="MemoryResource"/> that will be used to allocate
+        /// memory for values added to the <see cref="Index"/>.</param>
+        /// <returns>The <see cref="Result"/> of the operation.</returns>
+        public Result Initialize(int capacity, MemoryResource memoryResource)
+        {
+            // Initialize must only be called once.
+            Assert.SdkRequiresNull(_chunks);
+            Assert.SdkRequiresNotNull(memoryResource);
+
+            _chunks = new List<Chunk>();
+            _capacity = capacity;
+            _memoryResource = memoryResource;
+
+            return Result.Success;
+        }
+
+        public void Dispose()
+        {
+            if (_chunks != null)
+            {
+                Clear();
+                _chunks = null;
+            }
+        }
+
+        public Chunk GetChunk(int chunkIndex) => _chunks[chunkIndex];
+
+        public bool TryGetValue(in TKey key, out Buffer value)
+        {
+            if (!TryFind(in key, out int chunkIndex, out int entryIndex))
+            {
+                value = default;
+                return false;
+            }
+
+            value = _chunks[chunkIndex].Entries[entryIndex].Value;
+            return true;
+        }
+
+        /// <summary>
+        /// Adds the specified key and value to the <see cref="Index"/>.
+        /// The existing value is replaced if the key already exists.
+        /// </summary>
+        /// <param name="key">The key to add.</param>
+        /// <param name="value">The value to add.</param>
+        /// <returns>The <see cref="Result"/> of the operation.</returns>
+        public Result Set(in TKey key, ReadOnlySpan<byte> value)
+        {
+            bool keyExists = TryFind(in key, out int chunkIndex, out int entryIndex);
+
+            if (!keyExists && _count >= _capacity)
+                return ResultKvdb.OutOfKeyResource.Log();
+
+            // Allocate new value.
+            Buffer newValue = _memoryResource.Allocate(value.Length, Alignment);
+            if (newValue.IsNull)
+                return ResultKvdb.AllocationFailed.Log();
+
+            value.CopyTo(newValue.Span);
+
+            if (keyExists)
+            {
+                // Key already exists. Free the old value and replace it in place.
+                ref KeyValue entry = ref _chunks[chunkIndex].Entries[entryIndex];
+                _memoryResource.Deallocate(ref entry.Value, Alignment);
+                entry.Value = newValue;
+
+                return Result.Success;
+            }
+
+            Insert(chunkIndex, entryIndex, new KeyValue(in key, newValue));
+            return Result.Success;
+        }
+
+        /// <summary>
+        /// Adds multiple keys and values to the <see cref="Index"/> by merging
+        /// them with the existing entries and rebuilding the chunk list.
+        /// </summary>
+        public Result SetRange(ReadOnlySpan<TKey> keys, ReadOnlySpan<byte> values, int valueSize)
+        {
+            if (keys.IsEmpty)
+                return Result.Success;
+
+            // Sort the new entries by key. Sorting the order array along with the keys lets us find each value,
+            // and a stable sort means the last value given for a key comes last within each run of equal keys.
+            TKey[] sortedKeys = keys.ToArray();
+            int[] order = new int[keys.Length];
+
+            for (int i = 0; i < order.Length; i++)
+            {
+                order[i] = i;
+            }
+
+            Array.Sort(sortedKeys, order);
+            StableSortRuns(sortedKeys, order);
+
+            // Count how many of the new keys aren't already in the index.
+            int newKeyCount = 0;
+            for (int i = 0; i < sortedKeys.Length; i++)
+            {
+                if (i + 1 < sortedKeys.Length && sortedKeys[i].Equals(sortedKeys[i + 1]))
+                    continue;
+
+                if (!TryFind(in sortedKeys[i], out _, out _))
+                    newKeyCount++;
+            }
+
+            if (newKeyCount > _capacity - _count)
+                return ResultKvdb.OutOfKeyResource.Log();
+
+            // Allocate all the new values before modifying anything so the index is unchanged on failure.
+            var newEntries = new KeyValue[sortedKeys.Length];
+            int newEntryCount = 0;
+
+            for (int i = 0; i < sortedKeys.Length; i++)
+            {
+                // Only keep the last value for each key.
+                if (i + 1 < sortedKeys.Length && sortedKeys[i].Equals(sortedKeys[i + 1]))
+                    continue;
+
+                Buffer newValue = _memoryResource.Allocate(valueSize, Alignment);
+                if (newValue.IsNull)
+                {
+                    for (int j = 0; j < newEntryCount; j++)
+                    {
+                        _memoryResource.Deallocate(ref newEntries[j].Value, Alignment);
+                    }
+
+                    return ResultKvdb.AllocationFailed.Log();
+                }
+
+                values.Slice(order[i] * valueSize, valueSize).CopyTo(newValue.Span);
+                newEntries[newEntryCount++] = new KeyValue(in sortedKeys[i], newValue);
+            }
+
+            // Merge the existing entries with the new ones.
+            List<Chunk> oldChunks = _chunks;
+            _chunks = new List<Chunk>(oldChunks.Count + newEntryCount / BulkLoadChunkCount + 1);
+            _count = 0;
+
+            int oldChunkIndex = 0;
+            int oldEntryIndex = 0;
+            int newIndex = 0;
+
+            while (oldChunkIndex < oldChunks.Count || newIndex < newEntryCount)
+            {
+                if (oldChunkIndex == oldChunks.Count)
+                {
+                    AppendBulk(in newEntries[newIndex++]);
+                    continue;
+                }
+
+                ref KeyValue oldEntry = ref oldChunks[oldChunkIndex].Entries[oldEntryIndex];
+
+                int c = newIndex == newEntryCount ? -1 : oldEntry.Key.CompareTo(newEntries[newIndex].Key);
+
+                if (c < 0)
+                {
+                    AppendBulk(in oldEntry);
+                }
+                else if (c == 0)
+                {
+                    // Replace the existing value.
+                    _memoryResource.Deallocate(ref oldEntry.Value, Alignment);
+                    AppendBulk(in newEntries[newIndex++]);
+                }
+                else
+                {
+                    AppendBulk(in newEntries[newIndex++]);
+                    continue;
+                }
+
+                if (++oldEntryIndex == oldChunks[oldChunkIndex].Count)
+                {
+                    oldChunkIndex++;
+                    oldEntryIndex = 0;
+                }
+            }
+
+            Version++;
+            return Result.Success;
+        }
+
+        /// <summary>
+        /// Adds the specified key and value to the end of the list.
+        /// Does not verify that the list will be sorted properly. The caller must make sure the sorting will be correct.
+        /// Used when populating a new <see cref="Index"/> with already sorted entries.
+        /// </summary>
+        /// <param name="key">The key to add.</param>
+        /// <param name="value">The value to add.</param>
+        /// <returns>The <see cref="Result"/> of the operation.</returns>
+        public Result AppendUnsafe(in TKey key, Buffer value)
+        {
+            if (_count >= _capacity)
+                return ResultKvdb.OutOfKeyResource.Log();
+
+            if (_count > 0)
+            {
+                // The key being added must be greater than the last key in the list.
+                Assert.SdkGreater(key, _chunks[^1].LastKey);
+            }
+
+            AppendBulk(new KeyValue(in key, value));
+            Version++;
+
+            return Result.Success;
+        }
+
+        /// <summary>
+        /// Removes all keys and values from the <see cref="Index"/>.
+        /// </summary>
+        public void Clear()
+        {
+            foreach (Chunk chunk in _chunks)
+            {
+                Span<KeyValue> entries = chunk.Entries.AsSpan(0, chunk.Count);
+
+                for (int i = 0; i < entries.Length; i++)
+                {
+                    _memoryResource.Deallocate(ref entries[i].Value, Alignment);
+                }
+            }
+
+            _chunks.Clear();
+            _count = 0;
+            Version++;
+        }
+
+        /// <summary>
+        /// Deletes an element from the <see cref="Index"/>.
+        /// </summary>
+        /// <param name="key">The key of the element to delete.</param>
+        /// <returns><see langword="true"/> if the item was found and deleted.
+        /// <see langword="false"/> if the key was not in the store.</returns>
+        public bool Delete(in TKey key)
+        {
+            // Make sure the key was found.
+            if (!TryFind(in key, out int chunkIndex, out int entryIndex))
+                return false;
+
+            Chunk chunk = _chunks[chunkIndex];
+
+            // Free the value buffer and shift the remaining elements in the chunk down
+            _memoryResource.Deallocate(ref chunk.Entries[entryIndex].Value, Alignment);
+
+            Array.Copy(chunk.Entries, entryIndex + 1, chunk.Entries, entryIndex, chunk.Count - (entryIndex + 1));
+            chunk.Count--;
+            chunk.Entries[chunk.Count] = default;
+
+            if (chunk.Count == 0)
+                _chunks.RemoveAt(chunkIndex);
+
+            _count--;
+            Version++;
+
+            return true;
+        }
+
+        /// <summary>
+        /// Returns the position in the sorted list of the first element greater than or equal to <paramref name="key"/>.
+        /// </summary>
+        /// <param name="key">The key to search for.</param>
+        /// <returns>The position of the element.</returns>
+        public int GetLowerBoundPosition(in TKey key)
+        {
+            FindLowerBound(in key, out int chunkIndex, out int entryIndex);
+
+            int position = entryIndex;
+            for (int i = 0; i < chunkIndex; i++)
+            {
+                position += _chunks[i].Count;
+            }
+
+            return position;
+        }
+
+        /// <summary>
+        /// Finds the chunk and entry at the specified position in the sorted list.
+        /// </summary>
+        public void Locate(int position, out int chunkIndex, out int entryIndex)
+        {
+            if ((uint)position >= (uint)_count)
+                throw new IndexOutOfRangeException();
+
+            chunkIndex = 0;
+            while (position >= _chunks[chunkIndex].Count)
+            {
+                position -= _chunks[chunkIndex].Count;
+                chunkIndex++;
+            }
+
+            entryIndex = position;
+        }
+
+        private bool TryFind(in TKey key, out int chunkIndex, out int entryIndex)
+        {
+            FindLowerBound(in key, out chunkIndex, out entryIndex);
+
+            return chunkIndex != _chunks.Count && _chunks[chunkIndex].Entries[entryIndex].Key.Equals(key);
+        }
+
+        /// <summary>
+        /// Finds the location of the first element greater than or equal to <paramref name="key"/>.
+        /// If all elements are less than the key, the chunk index will be the number of chunks.
+        /// </summary>
+        private void FindLowerBound(in TKey key, out int chunkIndex, out int entryIndex)
+        {
+            // Find the first chunk whose last key is greater than or equal to the key
+            int lo = 0;
+            int hi = _chunks.Count - 1;
+
+            TKey tempItem = key;
+
+            while (lo <= hi)
+            {
+                int i = (int)(((uint)hi + (uint)lo) >> 1);
+
+                if (tempItem.CompareTo(_chunks[i].LastKey) > 0)
+                {
+                    lo = i + 1;
+                }
+                else
+                {
+                    hi = i - 1;
+                }
+            }
+
+            chunkIndex = lo;
+
+            if (chunkIndex == _chunks.Count)
+            {
+                entryIndex = 0;
+                return;
+            }
+
+            Chunk chunk = _chunks[chunkIndex];
+            entryIndex = BinarySearch(ref MemoryMarshal.GetArrayDataReference(chunk.Entries), chunk.Count, in key);
+        }
+
+        private void Insert(int chunkIndex, int entryIndex, in KeyValue entry)
+        {
+            if (_chunks.Count == 0)
+            {
+                _chunks.Add(new Chunk());
+            }
+            else if (chunkIndex == _chunks.Count)
+            {
+                // The key is greater than every existing key. Add it to the end of the last chunk.
+                chunkIndex--;
+                entryIndex = _chunks[chunkIndex].Count;
+            }
+
+            Chunk chunk = _chunks[chunkIndex];
+
+            if (chunk.Count == ChunkCapacity)
+            {
+                // Split the full chunk in half and insert into whichever half the entry belongs in.
+                const int splitIndex = ChunkCapacity / 2;
+
+                var newChunk = new Chunk();
+                Array.Copy(chunk.Entries, splitIndex, newChunk.Entries, 0, ChunkCapacity - splitIndex);
+                Array.Clear(chunk.Entries, splitIndex, ChunkCapacity - splitIndex);
+                newChunk.Count = ChunkCapacity - splitIndex;
+                chunk.Count = splitIndex;
+
+                _chunks.Insert(chunkIndex + 1, newChunk);
+
+                if (entryIndex > splitIndex)
+                {
+                    chunk = newChunk;
+                    entryIndex -= splitIndex;
+                }
+            }
+
+            Array.Copy(chunk.Entries, entryIndex, chunk.Entries, entryIndex + 1, chunk.Count - entryIndex);
+            chunk.Entries[entryIndex] = entry;
+            chunk.Count++;
+
+            _count++;
+            Version++;
+        }
+
+        private void AppendBulk(in KeyValue entry)
+        {
+            if (_chunks.Count == 0 || _chunks[^1].Count >= BulkLoadChunkCount)
+                _chunks.Add(new Chunk());
+
+            Chunk chunk = _chunks[^1];
+            chunk.Entries[chunk.Count++] = entry;
+            _count++;
+        }
+
+        /// <summary>
+        /// <see cref="Array.Sort{TKey,TValue}(TKey[],TValue[],IComparer{TKey})"/> isn't stable, so sort
+        /// the original indexes within each run of equal keys to restore the order they were given in.
+        /// </summary>
+        private static void StableSortRuns(TKey[] keys, int[] order)
+        {
+            int runStart = 0;
+
+            for (int i = 1; i <= keys.Length; i++)
+            {
+                if (i < keys.Length && keys[i].Equals(keys[runStart]))
+                    continue;
+
+                if (i - runStart > 1)
+                    Array.Sort(order, runStart, i - runStart);
+
+                runStart = i;
+            }
+        }
+
+        private static int BinarySearch(ref KeyValue spanStart, int length, in TKey item)
+        {
+            // A tweaked version of .NET's SpanHelpers.BinarySearch
+            int lo = 0;
+            int hi = length - 1;
+
+            TKey tempItem = item;
+
+            while (lo <= hi)
+            {
+                int i = (int)(((uint)hi + (uint)lo) >> 1);
+
+                int c = tempItem.CompareTo(Unsafe.Add(ref spanStart, i).Key);
+                if (c == 0)
+                {
+                    return i;
+                }
+                else if (c > 0)
+                {
+                    lo = i + 1;
+                }
+                else
+                {
+                    hi = i - 1;
+                }
+            }
+
+            // If not found, return the index of the first element that is greater than item
+            return lo;
+        }
+    }
+
+    /// <summary>
+    /// Iterates through the elements in a <see cref="ChunkedMapKeyValueStore{TKey}"/>.
+    /// </summary>
+    /// <remarks>The iterator tracks its position in the sorted list of entries the same way an iterator for
+    /// <see cref="FlatMapKeyValueStore{TKey}"/> does, and caches the location of that position in the index.
+    /// The cached location is found again if entries have been added or removed since it was last used.</remarks>
+    public struct Iterator
+    {
+        private ChunkedMapKeyValueStore<TKey> _store;
+        private Index _index;
+        private int _position;
+        private int _length;
+
+        private Chunk _chunk;
+        private int _chunkIndex;
+        private int _entryIndex;
+        private int _version;
+
+        internal Iterator(ChunkedMapKeyValueStore<TKey> store, Index index, int startPosition)
+        {
+            _store = store;
+            _index = index;
+            _position = startPosition;
+            _length = index.Count;
+
+            _chunk = null;
+            _chunkIndex = 0;
+            _entryIndex = 0;
+            _version = 0;
+        }
+
+        public ref KeyValue Get() => ref GetEntry();
+        public Span<byte> GetValue() => GetEntry().Value.Span;
+
+        public ref T GetValue<T>() where T : unmanaged
+        {
+            return ref SpanHelpers.AsStruct<T>(GetEntry().Value.Span);
+        }
+
+        public void Next()
+        {
+            _position++;
+
+            if (_chunk is null || _version != _index.Version)
+                return;
+
+            // Move the cached location along with the position if it's still valid.
+            if (++_entryIndex == _chunk.Count)
+            {
+                _chunkIndex++;
+                _entryIndex = 0;
+                _chunk = _chunkIndex < _index.ChunkCount ? _index.GetChunk(_chunkIndex) : null;
+            }
+        }
+
+        public bool IsEnd() => _position == _length;
+
+        /// <summary>
+        /// Fixes the iterator current position and total length so that after an entry
+        /// is added or removed, the iterator will still be on the same entry.
+        /// </summary>
+        /// <param name="entryIndex">The position of the added or removed entry.</param>
+        /// <param name="newLength">The new length of the list.</param>
+        public void Fix(int entryIndex, int newLength)
+        {
+            if (newLength > _length)
+            {
+                // An entry was added. entryIndex is the position of the new entry.
+
+                // Only one entry can be added at a time.
+                Assert.SdkEqual(newLength, _length + 1);
+
+                if (entryIndex <= _position)
+                {
+                    // The new entry was added at or before the iterator's current position.
+                    // Increment the position so we continue to be on the same entry.
+                    _position++;
+                }
+
+                _length = newLength;
+            }
+            else if (newLength < _length)
+            {
+                // An entry was removed. entryIndex is the position where the removed entry used to be.
+
+                // Only one entry can be removed at a time.
+                Assert.SdkEqual(newLength, _length - 1);
+
+                if (entryIndex < _position)
+                {
+                    // The removed entry was before the iterator's current position.
+                    // Decrement the position so we continue to be on the same entry.
+                    // If the entry at the iterator's current position was removed,
+                    // the iterator will now be at the next entry.
+                    _position--;
+                }
+
+                _length = newLength;
+            }
+
+            _chunk = null;
+        }
+
+        private ref KeyValue GetEntry()
+        {
+            if (_chunk is null || _version != _index.Version)
+            {
+                _index.Locate(_position, out _chunkIndex, out _entryIndex);
+                _chunk = _index.GetChunk(_chunkIndex);
+                _version = _index.Version;
+            }
+
+            ref KeyValue entry = ref _chunk.Entries[_entryIndex];
+
+            // The caller may modify the value through the returned reference, so make sure it's saved.
+            _store?.AddModifiedKey(in entry.Key);
+
+            return ref entry;
+        }
+    }
+
+    /// <summary>
+    /// Iterates through the elements in a <see cref="ChunkedMapKeyValueStore{TKey}"/>.
+    /// </summary>
+    public struct ConstIterator : IKeyValueArchiveIterator<TKey>
+    {
+        private Iterator _iterator;
+
+        internal ConstIterator(Iterator iterator)
+        {
+            _iterator = iterator;
+        }
+
+        public ref readonly KeyValue Get() => ref _iterator.Get();
+        public ReadOnlySpan<byte> GetValue() => _iterator.GetValue();
+
+        public void Next() => _iterator.Next();
+        public bool IsEnd() => _iterator.IsEnd();
+
+        ref readonly TKey IKeyValueArchiveIterator<TKey>.GetKey() => ref _iterator.Get().Key;
+    }
+}
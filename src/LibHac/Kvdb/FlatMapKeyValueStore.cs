@@ -90,7 +90,8 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
 
         try
         {
-            Result res = ReadArchive(ref buffer);
+            Result res = KeyValueArchiveFile.ReadFile(_fsClient, ref buffer, new U8Span(_archivePath.Get()),
+                _memoryResourceForAutoBuffers);
             if (res.IsFailure())
             {
                 // If the file is not found, we don't have any entries to load.
@@ -100,7 +101,7 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
                 return res;
             }
 
-            res = LoadFrom(buffer.Get());
+            res = KeyValueArchiveFile.LoadFrom<TKey, Index>(ref _index, buffer.Get(), _memoryResource);
             if (res.IsFailure()) return res.Miss();
 
             return Result.Success;
@@ -117,25 +118,8 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
     /// <returns>The <see cref="Result"/> of the operation.</returns>
     public Result Save()
     {
-        // Create a buffer to hold the archive.
-        var buffer = new AutoBuffer();
-        Result res = buffer.Initialize(CalculateArchiveSize(), _memoryResourceForAutoBuffers);
-        if (res.IsFailure()) return res.Miss();
-
-        try
-        {
-            // Write the archive to the buffer.
-            Span<byte> span = buffer.Get();
-            var writer = new KeyValueArchiveBufferWriter(span);
-            SaveTo(ref writer);
-
-            // Save the buffer to disk.
-            return CommitArchive(span);
-        }
-        finally
-        {
-            buffer.Dispose();
-        }
+        return KeyValueArchiveFile.Save<TKey, ConstIterator>(_fsClient, new U8Span(_archivePath.Get()), _index.Count,
+            _index.GetBeginConstIterator(), _memoryResourceForAutoBuffers);
     }
 
     /// <summary>
@@ -231,141 +215,6 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
         _index.FixIterator(ref iterator, in key);
     }
 
-    /// <summary>
-    /// Reads the database archive file into the provided buffer.
-    /// </summary>
-    /// <param name="buffer">The buffer the file will be read into.</param>
-    /// <returns>The <see cref="Result"/> of the operation.</returns>
-    private Result ReadArchive(ref AutoBuffer buffer)
-    {
-        Result res = _fsClient.OpenFile(out FileHandle file, new U8Span(_archivePath.Get()), OpenMode.Read);
-        if (res.IsFailure()) return res.Miss();
-
-        try
-        {
-            res = _fsClient.GetFileSize(out long archiveSize, file);
-            if (res.IsFailure()) return res.Miss();
-
-            res = buffer.Initialize(archiveSize, _memoryResourceForAutoBuffers);
-            if (res.IsFailure()) return res.Miss();
-
-            res = _fsClient.ReadFile(file, 0, buffer.Get());
-            if (res.IsFailure()) return res.Miss();
-
-            return Result.Success;
-        }
-        finally
-        {
-            _fsClient.CloseFile(file);
-        }
-    }
-
-    /// <summary>
-    /// Loads all key-value pairs from a key-value archive.
-    /// All keys in the archive are assumed to be in ascending order.
-    /// </summary>
-    /// <param name="buffer">The buffer containing the key-value archive.</param>
-    /// <returns>The <see cref="Result"/> of the operation.</returns>
-    private Result LoadFrom(ReadOnlySpan<byte> buffer)
-    {
-        var reader = new KeyValueArchiveBufferReader(buffer);
-
-        Result res = reader.ReadEntryCount(out int entryCount);
-        if (res.IsFailure()) return res.Miss();
-
-        for (int i = 0; i < entryCount; i++)
-        {
-            // Get size of key/value.
-            res = reader.GetKeyValueSize(out _, out int valueSize);
-            if (res.IsFailure()) return res.Miss();
-
-            // Allocate memory for value.
-            Buffer newValue = _memoryResource.Allocate(valueSize, Alignment);
-            if (newValue.IsNull)
-                return ResultKvdb.AllocationFailed.Log();
-
-            bool success = false;
-            try
-            {
-                // Read key and value.
-                Unsafe.SkipInit(out TKey key);
-
-                res = reader.ReadKeyValue(SpanHelpers.AsByteSpan(ref key), newValue.Span);
-                if (res.IsFailure()) return res.Miss();
-
-                res = _index.AppendUnsafe(in key, newValue);
-                if (res.IsFailure()) return res.Miss();
-
-                success = true;
-            }
-            finally
-            {
-                // Deallocate the buffer if we didn't succeed.
-                if (!success)
-                    _memoryResource.Deallocate(ref newValue, Alignment);
-            }
-        }
-
-        return Result.Success;
-    }
-
-    private void SaveTo(ref KeyValueArchiveBufferWriter writer)
-    {
-        writer.WriteHeader(_index.Count);
-
-        ConstIterator iterator = _index.GetBeginConstIterator();
-        while (!iterator.IsEnd())
-        {
-            ReadOnlySpan<byte> key = SpanHelpers.AsReadOnlyByteSpan(in iterator.Get().Key);
-            writer.WriteEntry(key, iterator.GetValue());
-
-            iterator.Next();
-        }
-    }
-
-    private Result CommitArchive(ReadOnlySpan<byte> buffer)
-    {
-        var path = new U8Span(_archivePath.Get());
-
-        // Try to delete the archive, but allow deletion failure.
-        _fsClient.DeleteFile(path).IgnoreResult();
-
-        // Create new archive.
-        Result res = _fsClient.CreateFile(path, buffer.Length);
-        if (res.IsFailure()) return res.Miss();
-
-        // Write data to the archive.
-        res = _fsClient.OpenFile(out FileHandle file, path, OpenMode.Write);
-        if (res.IsFailure()) return res.Miss();
-
-        try
-        {
-            res = _fsClient.WriteFile(file, 0, buffer, WriteOption.Flush);
-            if (res.IsFailure()) return res.Miss();
-        }
-        finally
-        {
-            _fsClient.CloseFile(file);
-        }
-
-        return Result.Success;
-    }
-
-    private long CalculateArchiveSize()
-    {
-        var calculator = new KeyValueArchiveSizeCalculator();
-        calculator.Initialize();
-        ConstIterator iterator = _index.GetBeginConstIterator();
-
-        while (!iterator.IsEnd())
-        {
-            calculator.AddEntry(Unsafe.SizeOf<TKey>(), iterator.GetValue().Length);
-            iterator.Next();
-        }
-
-        return calculator.Size;
-    }
-
     /// <summary>
     /// Represents a key-value pair contained in a <see cref="FlatMapKeyValueStore{T}"/>.
     /// </summary>
@@ -384,7 +233,7 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
     /// <summary>
     /// Manages the sorted list of <see cref="KeyValue"/> entries in a <see cref="FlatMapKeyValueStore{T}"/>.
     /// </summary>
-    private struct Index : IDisposable
+    private struct Index : IDisposable, IKeyValueArchiveIndex<TKey>
     {
         private int _count;
         private int _capacity;
@@ -702,7 +551,7 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
     /// <summary>
     /// Iterates through the elements in a <see cref="FlatMapKeyValueStore{TKey}"/>.
     /// </summary>
-    public struct ConstIterator
+    public struct ConstIterator : IKeyValueArchiveIterator<TKey>
     {
         private KeyValue[] _entries;
         private int _index;
@@ -720,5 +569,7 @@ public class FlatMapKeyValueStore<TKey> : IDisposable where TKey : unmanaged, IE
 
         public void Next() => _index++;
         public bool IsEnd() => _index == _length;
+
+        ref readonly TKey IKeyValueArchiveIterator<TKey>.GetKey() => ref _entries[_index].Key;
     }
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+﻿using System;
+using System.Runtime.CompilerServices;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using Buffer = LibHac.Mem.Buffer;
+
+namespace LibHac.Kvdb;
+
+/// <summary>
+/// The entries of a key-value store that can be loaded from a key-value archive.
+/// </summary>
+internal interface IKeyValueArchiveIndex<TKey> where TKey : unmanaged
+{
+    /// <summary>
+    /// Adds an entry after every existing entry without checking the order of the keys.
+    /// </summary>
+    Result AppendUnsafe(in TKey key, Buffer value);
+}
+
+/// <summary>
+/// Iterates through the entries of a key-value store in key order so they can be written to a key-value archive.
+/// </summary>
+internal interface IKeyValueArchiveIterator<TKey> where TKey : unmanaged
+{
+    ref readonly TKey GetKey();
+    ReadOnlySpan<byte> GetValue();
+    void Next();
+    bool IsEnd();
+}
+
+/// <summary>
+/// Reads and writes the key-value archive files used by <see cref="FlatMapKeyValueStore{TKey}"/>
+/// and <see cref="ChunkedMapKeyValueStore{TKey}"/>.
+/// </summary>
+/// <remarks>LibHac addition.</remarks>
+internal static class KeyValueArchiveFile
+{
+    private const int Alignment = 0x10;
+
+    /// <summary>
+    /// Reads a database file into the provided buffer.
+    /// </summary>
+    /// <param name="fsClient">The <see cref="FileSystemClient"/> used to read the file.</param>
+    /// <param name="buffer">The buffer the file will be read into.</param>
+    /// <param name="path">The path of the file to read.</param>
+    /// <param name="memoryResource">The <see cref="MemoryResource"/> used to allocate <paramref name="buffer"/>.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public static Result ReadFile(FileSystemClient fsClient, ref AutoBuffer buffer, U8Span path,
+        MemoryResource memoryResource)
+    {
+        Result res = fsClient.OpenFile(out FileHandle file, path, OpenMode.Read);
+        if (res.IsFailure()) return res.Miss();
+
+        try
+        {
+            res = fsClient.GetFileSize(out long fileSize, file);
+            if (res.IsFailure()) return res.Miss();
+
+            res = buffer.Initialize(fileSize, memoryResource);
+            if (res.IsFailure()) return res.Miss();
+
+            res = fsClient.ReadFile(file, 0, buffer.Get());
+            if (res.IsFailure()) return res.Miss();
+
+            return Result.Success;
+        }
+        finally
+        {
+            fsClient.CloseFile(file);
+        }
+    }
+
+    /// <summary>
+    /// Loads all key-value pairs from a key-value archive.
+    /// All keys in the archive are assumed to be in ascending order.
+    /// </summary>
+    /// <param name="index">The entries the key-value pairs will be added to.</param>
+    /// <param name="buffer">The buffer containing the key-value archive.</param>
+    /// <param name="memoryResource">The <see cref="MemoryResource"/> used to allocate the values.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public static Result LoadFrom<TKey, TIndex>(ref TIndex index, ReadOnlySpan<byte> buffer,
+        MemoryResource memoryResource) where TKey : unmanaged where TIndex : IKeyValueArchiveIndex<TKey>
+    {
+        var reader = new KeyValueArchiveBufferReader(buffer);
+
+        Result res = reader.ReadEntryCount(out int entryCount);
+        if (res.IsFailure()) return res.Miss();
+
+        for (int i = 0; i < entryCount; i++)
+        {
+            // Get size of key/value.
+            res = reader.GetKeyValueSize(out _, out int valueSize);
+            if (res.IsFailure()) return res.Miss();
+
+            // Allocate memory for value.
+            Buffer newValue = memoryResource.Allocate(valueSize, Alignment);
+            if (newValue.IsNull)
+                return ResultKvdb.AllocationFailed.Log();
+
+            bool success = false;
+            try
+            {
+                // Read key and value.
+                Unsafe.SkipInit(out TKey key);
+
+                res = reader.ReadKeyValue(SpanHelpers.AsByteSpan(ref key), newValue.Span);
+                if (res.IsFailure()) return res.Miss();
+
+                res = index.AppendUnsafe(in key, newValue);
+                if (res.IsFailure()) return res.Miss();
+
+                success = true;
+            }
+            finally
+            {
+                // Deallocate the buffer if we didn't succeed.
+                if (!success)
+                    memoryResource.Deallocate(ref newValue, Alignment);
+            }
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Writes every entry from <paramref name="iterator"/> to a new key-value archive file,
+    /// replacing the existing archive.
+    /// </summary>
+    /// <param name="fsClient">The <see cref="FileSystemClient"/> used to write the file.</param>
+    /// <param name="path">The path of the archive file.</param>
+    /// <param name="entryCount">The number of entries in <paramref name="iterator"/>.</param>
+    /// <param name="iterator">An iterator at the first entry to write.</param>
+    /// <param name="memoryResource">The <see cref="MemoryResource"/> used to allocate the archive buffer.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
+    public static Result Save<TKey, TIterator>(FileSystemClient fsClient, U8Span path, int entryCount,
+        TIterator iterator, MemoryResource memoryResource)
+        where TKey : unmanaged where TIterator : IKeyValueArchiveIterator<TKey>
+    {
+        // Create a buffer to hold the archive.
+        var buffer = new AutoBuffer();
+        Result res = buffer.Initialize(CalculateArchiveSize<TKey, TIterator>(iterator), memoryResource);
+        if (res.IsFailure()) return res.Miss();
+
+        try
+        {
+            // Write the archive to the buffer.
+            Span<byte> span = buffer.Get();
+            var writer = new KeyValueArchiveBufferWriter(span);
+            SaveTo<TKey, TIterator>(ref writer, entryCount, iterator);
+
+            // Save the buffer to disk.
+            return CommitArchive(fsClient, path, span);
+        }
+        finally
+        {
+            buffer.Dispose();
+        }
+    }
+
+    private static void SaveTo<TKey, TIterator>(ref KeyValueArchiveBufferWriter writer, int entryCount,
+        TIterator iterator) where TKey : unmanaged where TIterator : IKeyValueArchiveIterator<TKey>
+    {
+        writer.WriteHeader(entryCount);
+
+        while (!iterator.IsEnd())
+        {
+            ReadOnlySpan<byte> key = SpanHelpers.AsReadOnlyByteSpan(in iterator.GetKey());
+            writer.WriteEntry(key, iterator.GetValue());
+
+            iterator.Next();
+        }
+    }
+
+    private static Result CommitArchive(FileSystemClient fsClient, U8Span path, ReadOnlySpan<byte> buffer)
+    {
+        // Try to delete the archive, but allow deletion failure.
+        fsClient.DeleteFile(path).IgnoreResult();
+
+        // Create new archive.
+        Result res = fsClient.CreateFile(path, buffer.Length);
+        if (res.IsFailure()) return res.Miss();
+
+        // Write data to the archive.
+        res = fsClient.OpenFile(out FileHandle file, path, OpenMode.Write);
+        if (res.IsFailure()) return res.Miss();
+
+        try
+        {
+            res = fsClient.WriteFile(file, 0, buffer, WriteOption.Flush);
+            if (res.IsFailure()) return res.Miss();
+        }
+        finally
+        {
+            fsClient.CloseFile(file);
+        }
+
+        return Result.Success;
+    }
+
+    private static long CalculateArchiveSize<TKey, TIterator>(TIterator iterator)
+        where TKey : unmanaged where TIterator : IKeyValueArchiveIterator<TKey>
+    {
+        var calculator = new KeyValueArchiveSizeCalculator();
+        calculator.Initialize();
+
+        while (!iterator.IsEnd())
+        {
+            calculator.AddEntry(Unsafe.SizeOf<TKey>(), iterator.GetValue().Length);
+            iterator.Next();
+        }
+
+        return calculator.Size;
+    }
+}
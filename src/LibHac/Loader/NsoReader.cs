@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Buffers;
 using System.Runtime.CompilerServices;
 using LibHac.Common;
 using LibHac.Common.FixedArrays;
@@ -71,21 +72,41 @@ public class NsoReader
             return ResultLoader.InvalidNso.Log();
 
         // Load data from file.
-        uint loadAddress = isCompressed ? (uint)buffer.Length - fileSize : 0;
-
-        Result res = NsoFile.Read(out long bytesRead, segment.FileOffset, buffer.Slice((int)loadAddress), ReadOption.None);
-        if (res.IsFailure()) return res.Miss();
-
-        if (bytesRead != fileSize)
-            return ResultLoader.InvalidNso.Log();
+        if (!isCompressed)
+        {
+            Result res = NsoFile.Read(out long bytesRead, segment.FileOffset, buffer, ReadOption.None);
+            if (res.IsFailure()) return res.Miss();
 
-        // Uncompress if necessary.
-        if (isCompressed)
+            if (bytesRead != fileSize)
+                return ResultLoader.InvalidNso.Log();
+        }
+        else
         {
-            // todo: Fix in-place decompression
-            // Lz4.Decompress(buffer.Slice((int)loadAddress), buffer);
-            byte[] decomp = Lz4.Decompress(buffer.Slice((int)loadAddress).ToArray(), buffer.Length);
-            decomp.CopyTo(buffer);
+            // Read the compressed data into a separate buffer and decompress it into the output buffer.
+            // Decompressing in place isn't used because the output could overrun the compressed data that
+            // hasn't been read yet.
+            byte[] compressedBuffer = ArrayPool<byte>.Shared.Rent((int)fileSize);
+
+            try
+            {
+                Span<byte> compressedData = compressedBuffer.AsSpan(0, (int)fileSize);
+
+                Result res = NsoFile.Read(out long bytesRead, segment.FileOffset, compressedData, ReadOption.None);
+                if (res.IsFailure()) return res.Miss();
+
+                if (bytesRead != fileSize)
+                    return ResultLoader.InvalidNso.Log();
+
+                if (!Lz4.TryDecompress(compressedData, buffer.Slice(0, (int)segment.Size), out int bytesWritten))
+                    return ResultLoader.InvalidNso.Log();
+
+                if (bytesWritten != segment.Size)
+                    return ResultLoader.InvalidNso.Log();
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(compressedBuffer);
+            }
         }
 
         // Check hash if necessary.
@@ -15,6 +15,7 @@ using LibHac.Tools.FsSystem.NcaUtils;
 using LibHac.Tools.Ncm;
 using LibHac.Util;
 using KeyType = LibHac.Common.Keys.KeyType;
+using NcaHeader = LibHac.Tools.FsSystem.NcaUtils.NcaHeader;
 using SaveDataFileSystem = LibHac.Tools.FsSystem.Save.SaveDataFileSystem;
 
 namespace LibHac.Tools.Fs;
@@ -30,11 +31,41 @@ public class SwitchFs : IDisposable
     public Dictionary<ulong, Title> Titles { get; } = new Dictionary<ulong, Title>();
     public Dictionary<ulong, Application> Applications { get; } = new Dictionary<ulong, Application>();
 
+    private readonly int _threadCount;
+    private readonly SwitchFsMetadataCache _metadataCache;
+    private readonly Dictionary<SwitchFsNca, SwitchFsMetadataCache.Entry> _cacheEntries = new();
+
+    // The file system below the ConcatenationFileSystem, and the content directory's path in it.
+    // Used to get the time stamps of the internal files of split NCAs.
+    private readonly IAttributeFileSystem _concatenationBaseFs;
+    private readonly string _concatenationContentPath;
+
     public SwitchFs(KeySet keySet, IFileSystem contentFileSystem, IFileSystem saveFileSystem)
+        : this(keySet, contentFileSystem, saveFileSystem, 1, null) { }
+
+    /// <summary>
+    /// Opens all the NCAs and saves in the given file systems.
+    /// </summary>
+    /// <param name="keySet">The keys to use when decrypting NCAs and saves.</param>
+    /// <param name="contentFileSystem">The file system containing the NCAs.</param>
+    /// <param name="saveFileSystem">The file system containing the saves. May be <see langword="null"/>.</param>
+    /// <param name="threadCount">The number of threads to use when reading the NCAs' metadata.</param>
+    /// <param name="metadataCache">If not <see langword="null"/>, NCA metadata is read from this cache when
+    /// possible, and any metadata that had to be read from the NCAs is added to it.</param>
+    public SwitchFs(KeySet keySet, IFileSystem contentFileSystem, IFileSystem saveFileSystem, int threadCount,
+        SwitchFsMetadataCache metadataCache)
+        : this(keySet, contentFileSystem, saveFileSystem, threadCount, metadataCache, null, null) { }
+
+    private SwitchFs(KeySet keySet, IFileSystem contentFileSystem, IFileSystem saveFileSystem, int threadCount,
+        SwitchFsMetadataCache metadataCache, IAttributeFileSystem concatenationBaseFs, string concatenationContentPath)
     {
         KeySet = keySet;
         ContentFs = contentFileSystem;
         SaveFs = saveFileSystem;
+        _threadCount = Math.Max(threadCount, 1);
+        _metadataCache = metadataCache;
+        _concatenationBaseFs = concatenationBaseFs;
+        _concatenationContentPath = concatenationContentPath;
 
         OpenAllSaves();
         OpenAllNcas();
@@ -43,8 +74,10 @@ public class SwitchFs : IDisposable
         CreateApplications();
     }
 
-    public static SwitchFs OpenSdCard(KeySet keySet, ref UniqueRef<IAttributeFileSystem> fileSystem)
+    public static SwitchFs OpenSdCard(KeySet keySet, ref UniqueRef<IAttributeFileSystem> fileSystem,
+        int threadCount = 1, SwitchFsMetadataCache metadataCache = null)
     {
+        IAttributeFileSystem baseFs = fileSystem.Get;
         var concatFs = new ConcatenationFileSystem(ref fileSystem);
 
         using var contentDirPath = new LibHac.Fs.Path();
@@ -67,11 +100,14 @@ public class SwitchFs : IDisposable
 
         var encContentFs = new AesXtsFileSystem(contentDirFs, keySet.SdCardEncryptionKeys[1].DataRo.ToArray(), 0x4000);
 
-        return new SwitchFs(keySet, encContentFs, encSaveFs);
+        return new SwitchFs(keySet, encContentFs, encSaveFs, threadCount, metadataCache, baseFs,
+            "/Nintendo/Contents");
     }
 
-    public static SwitchFs OpenNandPartition(KeySet keySet, ref UniqueRef<IAttributeFileSystem> fileSystem)
+    public static SwitchFs OpenNandPartition(KeySet keySet, ref UniqueRef<IAttributeFileSystem> fileSystem,
+        int threadCount = 1, SwitchFsMetadataCache metadataCache = null)
     {
+        IAttributeFileSystem baseFs = fileSystem.Get;
         var concatFs = new ConcatenationFileSystem(ref fileSystem);
         SubdirectoryFileSystem saveDirFs = null;
         SubdirectoryFileSystem contentDirFs;
@@ -91,53 +127,170 @@ public class SwitchFs : IDisposable
         contentDirFs = new SubdirectoryFileSystem(concatFs);
         contentDirFs.Initialize(in contentsPath).ThrowIfFailure();
 
-        return new SwitchFs(keySet, contentDirFs, saveDirFs);
+        return new SwitchFs(keySet, contentDirFs, saveDirFs, threadCount, metadataCache, baseFs, "/Contents");
     }
 
-    public static SwitchFs OpenNcaDirectory(KeySet keySet, IFileSystem fileSystem)
+    public static SwitchFs OpenNcaDirectory(KeySet keySet, IFileSystem fileSystem, int threadCount = 1,
+        SwitchFsMetadataCache metadataCache = null)
     {
-        return new SwitchFs(keySet, fileSystem, null);
+        return new SwitchFs(keySet, fileSystem, null, threadCount, metadataCache);
     }
 
     private void OpenAllNcas()
     {
         // Todo: give warning if directories named "*.nca" are found or manually fix the archive bit
-        IEnumerable<DirectoryEntryEx> files = ContentFs.EnumerateEntries("*.nca", SearchOptions.RecurseSubdirectories)
-            .Where(x => x.Type == DirectoryEntryType.File);
+        DirectoryEntryEx[] files = ContentFs.EnumerateEntries("*.nca", SearchOptions.RecurseSubdirectories)
+            .Where(x => x.Type == DirectoryEntryType.File).ToArray();
+
+        var ncas = new SwitchFsNca[files.Length];
+        var cacheEntries = new SwitchFsMetadataCache.Entry[files.Length];
+        string[] errors = new string[files.Length];
 
-        foreach (DirectoryEntryEx fileEntry in files)
+        ParallelUtils.For(files.Length, _threadCount,
+            i => ncas[i] = OpenNca(files[i], out cacheEntries[i], out errors[i]));
+
+        // Add the NCAs in enumeration order so the results don't depend on the thread count
+        for (int i = 0; i < files.Length; i++)
         {
-            SwitchFsNca nca = null;
-            try
-            {
-                using var ncaFile = new UniqueRef<IFile>();
-                ContentFs.OpenFile(ref ncaFile.Ref, fileEntry.FullPath.ToU8Span(), OpenMode.Read).ThrowIfFailure();
+            if (errors[i] != null) Console.WriteLine(errors[i]);
 
-                nca = new SwitchFsNca(new Nca(KeySet, ncaFile.Release().AsStorage()));
+            SwitchFsNca nca = ncas[i];
+            if (nca?.NcaId == null) continue;
+
+            Ncas.Add(nca.NcaId, nca);
+
+            if (cacheEntries[i] != null)
+                _cacheEntries.Add(nca, cacheEntries[i]);
+        }
+    }
+
+    private SwitchFsNca OpenNca(DirectoryEntryEx fileEntry, out SwitchFsMetadataCache.Entry cacheEntry,
+        out string error)
+    {
+        cacheEntry = null;
+        error = null;
 
-                nca.NcaId = GetNcaFilename(fileEntry.Name, nca);
-                string extension = nca.Nca.Header.ContentType == NcaContentType.Meta ? ".cnmt.nca" : ".nca";
-                nca.Filename = nca.NcaId + extension;
+        try
+        {
+            using var ncaFile = new UniqueRef<IFile>();
+            ContentFs.OpenFile(ref ncaFile.Ref, fileEntry.FullPath.ToU8Span(), OpenMode.Read).ThrowIfFailure();
+            IStorage ncaStorage = ncaFile.Release().AsStorage();
+
+            Nca nca;
+            bool hasModifiedTime = TryGetModifiedTime(fileEntry.FullPath, out long modifiedTime,
+                out long[] internalFileTimeStamps);
+
+            if (hasModifiedTime && _metadataCache.TryGet(fileEntry.FullPath, fileEntry.Size, modifiedTime,
+                    internalFileTimeStamps, out cacheEntry))
+            {
+                nca = new Nca(KeySet, ncaStorage, new NcaHeader(cacheEntry.Header, cacheEntry.IsHeaderEncrypted));
             }
-            catch (MissingKeyException ex)
+            else
             {
-                if (ex.Name == null)
-                {
-                    Console.WriteLine($"{ex.Message} File:\n{fileEntry}");
-                }
-                else
+                nca = new Nca(KeySet, ncaStorage);
+
+                if (hasModifiedTime)
                 {
-                    string name = ex.Type == KeyType.Title ? $"Title key for rights ID {ex.Name}" : ex.Name;
-                    Console.WriteLine($"{ex.Message}\nKey: {name}\nFile: {fileEntry}");
+                    cacheEntry = new SwitchFsMetadataCache.Entry(fileEntry.Size, modifiedTime, internalFileTimeStamps,
+                        nca.Header.GetDecryptedHeader().ToArray(), nca.Header.IsEncrypted);
+
+                    _metadataCache.Add(fileEntry.FullPath, cacheEntry);
                 }
             }
-            catch (Exception ex)
+
+            var switchFsNca = new SwitchFsNca(nca);
+
+            switchFsNca.NcaId = GetNcaFilename(fileEntry.Name, switchFsNca);
+            string extension = nca.Header.ContentType == NcaContentType.Meta ? ".cnmt.nca" : ".nca";
+            switchFsNca.Filename = switchFsNca.NcaId + extension;
+
+            return switchFsNca;
+        }
+        catch (MissingKeyException ex)
+        {
+            if (ex.Name == null)
             {
-                Console.WriteLine($"{ex.Message} File: {fileEntry.FullPath}");
+                error = $"{ex.Message} File:\n{fileEntry}";
+            }
+            else
+            {
+                string name = ex.Type == KeyType.Title ? $"Title key for rights ID {ex.Name}" : ex.Name;
+                error = $"{ex.Message}\nKey: {name}\nFile: {fileEntry}";
             }
+        }
+        catch (Exception ex)
+        {
+            error = $"{ex.Message} File: {fileEntry.FullPath}";
+        }
+
+        return null;
+    }
+
+    /// <summary>
+    /// Gets the modification time of a file if metadata caching is enabled
+    /// and the content file system supports file time stamps.
+    /// </summary>
+    /// <remarks>The time stamp of a split NCA is its directory's, which doesn't change when one of the NCA's
+    /// internal files is rewritten. The size and modification time of each internal file are returned in
+    /// <paramref name="internalFileTimeStamps"/> so changes to them can be detected.</remarks>
+    private bool TryGetModifiedTime(string path, out long modifiedTime, out long[] internalFileTimeStamps)
+    {
+        modifiedTime = 0;
+        internalFileTimeStamps = null;
+
+        if (_metadataCache is null)
+            return false;
+
+        using var pathNormalized = new LibHac.Fs.Path();
+        if (pathNormalized.InitializeWithNormalization(path.ToU8Span()).IsFailure())
+            return false;
+
+        if (ContentFs.GetFileTimeStampRaw(out FileTimeStampRaw timeStamp, in pathNormalized).IsFailure())
+            return false;
+
+        modifiedTime = timeStamp.Modified;
+
+        if (_concatenationBaseFs is null)
+            return true;
+
+        return TryGetInternalFileTimeStamps(_concatenationContentPath + path, out internalFileTimeStamps);
+    }
+
+    private bool TryGetInternalFileTimeStamps(string path, out long[] timeStamps)
+    {
+        timeStamps = null;
+
+        using var pathNormalized = new LibHac.Fs.Path();
+        if (pathNormalized.InitializeWithNormalization(path.ToU8Span()).IsFailure())
+            return false;
 
-            if (nca?.NcaId != null) Ncas.Add(nca.NcaId, nca);
+        if (_concatenationBaseFs.GetFileAttributes(out NxFileAttributes attributes, in pathNormalized).IsFailure())
+            return false;
+
+        // Files that aren't split don't have any internal files
+        if (!attributes.HasFlag(NxFileAttributes.Directory))
+            return true;
+
+        DirectoryEntryEx[] internalFiles = _concatenationBaseFs.EnumerateEntries(path, "*", SearchOptions.Default)
+            .OrderBy(x => x.Name, StringComparer.Ordinal).ToArray();
+
+        timeStamps = new long[internalFiles.Length * 2];
+
+        for (int i = 0; i < internalFiles.Length; i++)
+        {
+            using var internalFilePath = new LibHac.Fs.Path();
+            if (internalFilePath.InitializeWithNormalization(internalFiles[i].FullPath.ToU8Span()).IsFailure())
+                return false;
+
+            if (_concatenationBaseFs.GetFileTimeStampRaw(out FileTimeStampRaw timeStamp, in internalFilePath)
+                .IsFailure())
+                return false;
+
+            timeStamps[i * 2] = internalFiles[i].Size;
+            timeStamps[i * 2 + 1] = timeStamp.Modified;
         }
+
+        return true;
     }
 
     private void OpenAllSaves()
@@ -170,19 +323,37 @@ public class SwitchFs : IDisposable
 
     private void ReadTitles()
     {
-        foreach (SwitchFsNca nca in Ncas.Values.Where(x => x.Nca.Header.ContentType == NcaContentType.Meta))
+        SwitchFsNca[] metaNcas = Ncas.Values.Where(x => x.Nca.Header.ContentType == NcaContentType.Meta).ToArray();
+        var metadataList = new Cnmt[metaNcas.Length];
+        string[] errors = new string[metaNcas.Length];
+
+        ParallelUtils.For(metaNcas.Length, _threadCount, i =>
         {
             try
             {
-                var title = new Title();
+                metadataList[i] = new Cnmt(new MemoryStream(ReadCnmt(metaNcas[i])));
+            }
+            catch (Exception ex)
+            {
+                errors[i] = $"{ex.Message} File: {metaNcas[i].Filename}";
+            }
+        });
 
-                IFileSystem fs = nca.OpenFileSystem(NcaSectionType.Data, IntegrityCheckLevel.ErrorOnInvalid);
-                string cnmtPath = fs.EnumerateEntries("/", "*.cnmt").Single().FullPath;
+        for (int i = 0; i < metaNcas.Length; i++)
+        {
+            SwitchFsNca nca = metaNcas[i];
 
-                using var file = new UniqueRef<IFile>();
-                fs.OpenFile(ref file.Ref, cnmtPath.ToU8Span(), OpenMode.Read).ThrowIfFailure();
+            if (errors[i] != null)
+            {
+                Console.WriteLine(errors[i]);
+                continue;
+            }
 
-                var metadata = new Cnmt(file.Release().AsStream());
+            try
+            {
+                var title = new Title();
+
+                Cnmt metadata = metadataList[i];
                 title.Id = metadata.TitleId;
                 title.Version = metadata.TitleVersion;
                 title.Metadata = metadata;
@@ -219,9 +390,48 @@ public class SwitchFs : IDisposable
         }
     }
 
+    private byte[] ReadCnmt(SwitchFsNca nca)
+    {
+        _cacheEntries.TryGetValue(nca, out SwitchFsMetadataCache.Entry cacheEntry);
+
+        if (cacheEntry?.Cnmt != null)
+            return cacheEntry.Cnmt;
+
+        IFileSystem fs = nca.OpenFileSystem(NcaSectionType.Data, IntegrityCheckLevel.ErrorOnInvalid);
+        string cnmtPath = fs.EnumerateEntries("/", "*.cnmt").Single().FullPath;
+
+        using var file = new UniqueRef<IFile>();
+        fs.OpenFile(ref file.Ref, cnmtPath.ToU8Span(), OpenMode.Read).ThrowIfFailure();
+
+        file.Get.GetSize(out long fileSize).ThrowIfFailure();
+        byte[] cnmt = new byte[fileSize];
+
+        file.Get.Read(out long bytesRead, 0, cnmt).ThrowIfFailure();
+        if (bytesRead != fileSize)
+            throw new InvalidDataException("Unable to read the entire CNMT.");
+
+        if (cacheEntry != null)
+            _metadataCache.SetCnmt(cacheEntry, cnmt);
+
+        return cnmt;
+    }
+
     private void ReadControls()
     {
-        foreach (Title title in Titles.Values.Where(x => x.ControlNca != null))
+        Title[] titles = Titles.Values.Where(x => x.ControlNca != null).ToArray();
+
+        ParallelUtils.For(titles.Length, _threadCount, i => ReadControl(titles[i]));
+    }
+
+    private void ReadControl(Title title)
+    {
+        _cacheEntries.TryGetValue(title.ControlNca, out SwitchFsMetadataCache.Entry cacheEntry);
+
+        if (cacheEntry?.Nacp != null && cacheEntry.Nacp.Length == title.Control.ByteSpan.Length)
+        {
+            cacheEntry.Nacp.CopyTo(title.Control.ByteSpan);
+        }
+        else
         {
             IFileSystem romfs = title.ControlNca.OpenFileSystem(NcaSectionType.Data, IntegrityCheckLevel.ErrorOnInvalid);
 
@@ -232,21 +442,24 @@ public class SwitchFs : IDisposable
                 control.Get.Read(out _, 0, title.Control.ByteSpan).ThrowIfFailure();
             }
 
-            int i = 0;
-            bool nameSet = false;
-            foreach (ref readonly ApplicationControlProperty.ApplicationTitle desc in title.Control.Value.Title)
+            if (cacheEntry != null)
+                _metadataCache.SetNacp(cacheEntry, title.Control.ByteSpan.ToArray());
+        }
+
+        int i = 0;
+        bool nameSet = false;
+        foreach (ref readonly ApplicationControlProperty.ApplicationTitle desc in title.Control.Value.Title)
+        {
+            if (!desc.NameString.IsEmpty())
             {
-                if (!desc.NameString.IsEmpty())
+                if (!nameSet)
                 {
-                    if (!nameSet)
-                    {
-                        title.Name = desc.NameString.ToString();
-                        nameSet = true;
-                    }
-                    title.Languages.Add((ApplicationControlProperty.Language)i);
+                    title.Name = desc.NameString.ToString();
+                    nameSet = true;
                 }
-                i++;
+                title.Languages.Add((ApplicationControlProperty.Language)i);
             }
+            i++;
         }
     }
 
@@ -340,15 +553,15 @@ public class SwitchFsNca
         return OpenFileSystem(Nca.GetSectionIndexFromType(type, Nca.Header.ContentType), integrityCheckLevel);
     }
 
-    public Validity VerifyNca(IProgressReport logger = null, bool quiet = false)
+    public Validity VerifyNca(IProgressReport logger = null, bool quiet = false, int threadCount = 1)
     {
         if (BaseNca != null)
         {
-            return BaseNca.VerifyNca(Nca, logger, quiet);
+            return BaseNca.VerifyNca(Nca, logger, quiet, threadCount);
         }
         else
         {
-            return Nca.VerifyNca(logger, quiet);
+            return Nca.VerifyNca(logger, quiet, threadCount);
         }
     }
 }
@@ -0,0 +1,303 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+using System.Threading;
+using LibHac.Tools.FsSystem.NcaUtils;
+
+namespace LibHac.Tools.Fs;
+
+/// <summary>
+/// Caches the decrypted NCA headers, CNMTs and NACPs read while opening a <see cref="SwitchFs"/>
+/// so an unchanged dump can be reopened without decrypting or parsing any NCAs.
+/// </summary>
+/// <remarks><para>Entries are keyed by the NCA's path in the content file system along with its size and
+/// modification time. The size and modification time of each internal file of a split NCA are also part of
+/// the key. An NCA whose size or modification time has changed is read from the file system again.
+/// NCAs on file systems that don't report modification times are never cached.</para>
+/// <para>A cache file should only be used with a single dump. This class is thread-safe.</para></remarks>
+public sealed class SwitchFsMetadataCache
+{
+    private const uint Magic = 0x434D4653; // SFMC
+    private const int FormatVersion = 2;
+
+    internal sealed class Entry
+    {
+        public readonly long Size;
+        public readonly long ModifiedTime;
+        public readonly long[] InternalFileTimeStamps;
+        public readonly byte[] Header;
+        public readonly bool IsHeaderEncrypted;
+        public byte[] Cnmt;
+        public byte[] Nacp;
+
+        public Entry(long size, long modifiedTime, long[] internalFileTimeStamps, byte[] header,
+            bool isHeaderEncrypted)
+        {
+            Size = size;
+            ModifiedTime = modifiedTime;
+            InternalFileTimeStamps = internalFileTimeStamps;
+            Header = header;
+            IsHeaderEncrypted = isHeaderEncrypted;
+        }
+    }
+
+    private readonly Dictionary<string, Entry> _entries = new Dictionary<string, Entry>(StringComparer.Ordinal);
+    private readonly object _locker = new object();
+    private long _hitCount;
+    private long _missCount;
+
+    /// <summary>The number of NCAs in the cache.</summary>
+    public int Count
+    {
+        get
+        {
+            lock (_locker)
+            {
+                return _entries.Count;
+            }
+        }
+    }
+
+    /// <summary>The number of NCAs that were found in the cache and didn't need to be read.</summary>
+    public long HitCount => Interlocked.Read(ref _hitCount);
+
+    /// <summary>The number of NCAs that weren't in the cache or had changed since they were cached.</summary>
+    public long MissCount => Interlocked.Read(ref _missCount);
+
+    /// <summary><see langword="true"/> if the cache has been changed since it was loaded or last saved.</summary>
+    public bool IsModified { get; private set; }
+
+    /// <summary>
+    /// Loads a cache from the specified file. If the file doesn't exist or isn't a valid cache,
+    /// an empty cache is returned.
+    /// </summary>
+    public static SwitchFsMetadataCache Load(string path)
+    {
+        var cache = new SwitchFsMetadataCache();
+
+        if (!File.Exists(path))
+            return cache;
+
+        try
+        {
+            using var stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.Read);
+            cache.Read(stream);
+        }
+        catch (Exception ex) when (ex is InvalidDataException or EndOfStreamException or IOException)
+        {
+            cache.Clear();
+        }
+
+        return cache;
+    }
+
+    /// <summary>
+    /// Saves the cache to the specified file. The file is replaced only once the new cache has been fully written.
+    /// </summary>
+    public void Save(string path)
+    {
+        string tempPath = path + ".tmp";
+
+        using (var stream = new FileStream(tempPath, FileMode.Create, FileAccess.Write))
+        {
+            Write(stream);
+        }
+
+        File.Move(tempPath, path, true);
+    }
+
+    /// <summary>
+    /// Replaces the contents of the cache with a cache read from <paramref name="stream"/>.
+    /// </summary>
+    /// <exception cref="InvalidDataException">The stream doesn't contain a valid cache.</exception>
+    public void Read(Stream stream)
+    {
+        using var reader = new BinaryReader(stream, Encoding.UTF8, true);
+
+        if (reader.ReadUInt32() != Magic || reader.ReadInt32() != FormatVersion)
+            throw new InvalidDataException("The NCA metadata cache is not valid.");
+
+        int count = reader.ReadInt32();
+        if (count < 0)
+            throw new InvalidDataException("The NCA metadata cache is not valid.");
+
+        var entries = new Dictionary<string, Entry>(count, StringComparer.Ordinal);
+
+        for (int i = 0; i < count; i++)
+        {
+            string path = reader.ReadString();
+            long size = reader.ReadInt64();
+            long modifiedTime = reader.ReadInt64();
+            long[] internalFileTimeStamps = ReadInt64s(reader);
+            bool isHeaderEncrypted = reader.ReadBoolean();
+
+            var entry = new Entry(size, modifiedTime, internalFileTimeStamps, ReadBytes(reader), isHeaderEncrypted);
+            entry.Cnmt = ReadBytes(reader);
+            entry.Nacp = ReadBytes(reader);
+
+            if (entry.Header?.Length != NcaHeader.HeaderSize)
+                throw new InvalidDataException("The NCA metadata cache is not valid.");
+
+            entries[path] = entry;
+        }
+
+        lock (_locker)
+        {
+            _entries.Clear();
+
+            foreach (KeyValuePair<string, Entry> entry in entries)
+            {
+                _entries.Add(entry.Key, entry.Value);
+            }
+
+            IsModified = false;
+        }
+    }
+
+    /// <summary>
+    /// Writes the contents of the cache to <paramref name="stream"/>.
+    /// </summary>
+    public void Write(Stream stream)
+    {
+        using var writer = new BinaryWriter(stream, Encoding.UTF8, true);
+
+        lock (_locker)
+        {
+            writer.Write(Magic);
+            writer.Write(FormatVersion);
+            writer.Write(_entries.Count);
+
+            foreach (KeyValuePair<string, Entry> pair in _entries)
+            {
+                Entry entry = pair.Value;
+
+                writer.Write(pair.Key);
+                writer.Write(entry.Size);
+                writer.Write(entry.ModifiedTime);
+                WriteInt64s(writer, entry.InternalFileTimeStamps);
+                writer.Write(entry.IsHeaderEncrypted);
+                WriteBytes(writer, entry.Header);
+                WriteBytes(writer, entry.Cnmt);
+                WriteBytes(writer, entry.Nacp);
+            }
+
+            IsModified = false;
+        }
+    }
+
+    /// <summary>
+    /// Removes all entries from the cache.
+    /// </summary>
+    public void Clear()
+    {
+        lock (_locker)
+        {
+            IsModified |= _entries.Count != 0;
+            _entries.Clear();
+        }
+    }
+
+    internal bool TryGet(string path, long size, long modifiedTime, long[] internalFileTimeStamps, out Entry entry)
+    {
+        lock (_locker)
+        {
+            if (_entries.TryGetValue(path, out entry) && entry.Size == size && entry.ModifiedTime == modifiedTime &&
+                entry.InternalFileTimeStamps.AsSpan().SequenceEqual(internalFileTimeStamps))
+            {
+                Interlocked.Increment(ref _hitCount);
+                return true;
+            }
+
+            Interlocked.Increment(ref _missCount);
+            entry = null;
+            return false;
+        }
+    }
+
+    internal void Add(string path, Entry entry)
+    {
+        lock (_locker)
+        {
+            _entries[path] = entry;
+            IsModified = true;
+        }
+    }
+
+    internal void SetCnmt(Entry entry, byte[] cnmt)
+    {
+        lock (_locker)
+        {
+            entry.Cnmt = cnmt;
+            IsModified = true;
+        }
+    }
+
+    internal void SetNacp(Entry entry, byte[] nacp)
+    {
+        lock (_locker)
+        {
+            entry.Nacp = nacp;
+            IsModified = true;
+        }
+    }
+
+    private static byte[] ReadBytes(BinaryReader reader)
+    {
+        int length = reader.ReadInt32();
+
+        if (length < 0)
+            return null;
+
+        byte[] data = reader.ReadBytes(length);
+        if (data.Length != length)
+            throw new EndOfStreamException();
+
+        return data;
+    }
+
+    private static long[] ReadInt64s(BinaryReader reader)
+    {
+        int length = reader.ReadInt32();
+
+        if (length < 0)
+            return null;
+
+        long[] values = new long[length];
+
+        for (int i = 0; i < values.Length; i++)
+        {
+            values[i] = reader.ReadInt64();
+        }
+
+        return values;
+    }
+
+    private static void WriteInt64s(BinaryWriter writer, long[] values)
+    {
+        if (values is null)
+        {
+            writer.Write(-1);
+            return;
+        }
+
+        writer.Write(values.Length);
+
+        foreach (long value in values)
+        {
+            writer.Write(value);
+        }
+    }
+
+    private static void WriteBytes(BinaryWriter writer, byte[] data)
+    {
+        if (data is null)
+        {
+            writer.Write(-1);
+            return;
+        }
+
+        writer.Write(data.Length);
+        writer.Write(data);
+    }
+}
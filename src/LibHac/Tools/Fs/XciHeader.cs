@@ -182,7 +182,7 @@ public class XciHeader
 
             Optional<byte> salt = CompatibilityType == 0 ? new Optional<byte>() : CompatibilityType;
             
-            var generator = new Sha256Generator();
+            using var generator = new Sha256Generator();
             generator.Initialize();
             generator.Update(headerBytes);
             if (salt.HasValue)
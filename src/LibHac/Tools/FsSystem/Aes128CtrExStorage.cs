@@ -37,6 +37,16 @@ public class Aes128CtrExStorage : Aes128CtrStorage
         res.ThrowIfFailure();
     }
 
+    /// <summary>
+    /// Sets the cache used to keep decoded nodes of the counter table in memory.
+    /// </summary>
+    /// <param name="cache">The cache to use. May be shared with other storages.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        Table.SetNodeCache(cache);
+    }
+
     public override Result Read(long offset, Span<byte> destination)
     {
         if (destination.Length == 0)
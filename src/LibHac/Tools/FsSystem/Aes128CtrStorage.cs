@@ -1,6 +1,8 @@
 ﻿using System;
 using System.Buffers;
 using System.Buffers.Binary;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
 
 namespace LibHac.Tools.FsSystem;
@@ -73,6 +75,21 @@ public class Aes128CtrStorage : SectorStorage
         return Result.Success;
     }
 
+    public override async ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        Result res = await base.ReadAsync(offset, destination, cancellationToken).ConfigureAwait(false);
+        if (res.IsFailure()) return res.Miss();
+
+        lock (_locker)
+        {
+            UpdateCounter(_counterOffset + offset);
+            _decryptor.TransformBlock(destination.Span);
+        }
+
+        return Result.Success;
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         byte[] encrypted = ArrayPool<byte>.Shared.Rent(source.Length);
@@ -1,4 +1,6 @@
 using System;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
 
 namespace LibHac.Tools.FsSystem;
@@ -16,6 +18,7 @@ public class Aes128XtsStorage : SectorStorage
     private readonly byte[] _key2;
 
     private readonly bool _decryptRead;
+    private readonly object _locker = new object();
 
     public Aes128XtsStorage(IStorage baseStorage, Span<byte> key, int sectorSize, bool leaveOpen, bool decryptRead = true)
         : base(baseStorage, sectorSize, leaveOpen)
@@ -44,31 +47,61 @@ public class Aes128XtsStorage : SectorStorage
 
     public override Result Read(long offset, Span<byte> destination)
     {
-        int size = destination.Length;
-        long sectorIndex = offset / SectorSize;
+        Result res = base.Read(offset, destination);
+        if (res.IsFailure()) return res.Miss();
 
-        if (_readTransform == null) _readTransform = new Aes128XtsTransform(_key1, _key2, _decryptRead);
+        TransformRead(offset, destination);
+        return Result.Success;
+    }
 
-        Result res = base.Read(offset, _tempBuffer.AsSpan(0, size));
+    public override async ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        Result res = await base.ReadAsync(offset, destination, cancellationToken).ConfigureAwait(false);
         if (res.IsFailure()) return res.Miss();
 
-        _readTransform.TransformBlock(_tempBuffer, 0, size, (ulong)sectorIndex);
-        _tempBuffer.AsSpan(0, size).CopyTo(destination);
-
+        TransformRead(offset, destination.Span);
         return Result.Success;
     }
 
+    /// <summary>
+    /// Transforms data read from the base storage in place, one sector at a time.
+    /// </summary>
+    private void TransformRead(long offset, Span<byte> buffer)
+    {
+        long sectorIndex = offset / SectorSize;
+
+        // The transform and the work buffer are shared, but the base storage is read without holding the lock
+        lock (_locker)
+        {
+            if (_readTransform == null) _readTransform = new Aes128XtsTransform(_key1, _key2, _decryptRead);
+
+            for (int position = 0; position < buffer.Length; position += SectorSize, sectorIndex++)
+            {
+                int size = Math.Min(SectorSize, buffer.Length - position);
+                Span<byte> sector = buffer.Slice(position, size);
+
+                sector.CopyTo(_tempBuffer);
+                _readTransform.TransformBlock(_tempBuffer, 0, size, (ulong)sectorIndex);
+                _tempBuffer.AsSpan(0, size).CopyTo(sector);
+            }
+        }
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         int size = source.Length;
         long sectorIndex = offset / SectorSize;
 
-        if (_writeTransform == null) _writeTransform = new Aes128XtsTransform(_key1, _key2, !_decryptRead);
+        lock (_locker)
+        {
+            if (_writeTransform == null) _writeTransform = new Aes128XtsTransform(_key1, _key2, !_decryptRead);
 
-        source.CopyTo(_tempBuffer);
-        _writeTransform.TransformBlock(_tempBuffer, 0, size, (ulong)sectorIndex);
+            source.CopyTo(_tempBuffer);
+            _writeTransform.TransformBlock(_tempBuffer, 0, size, (ulong)sectorIndex);
 
-        return base.Write(offset, _tempBuffer.AsSpan(0, size));
+            return base.Write(offset, _tempBuffer.AsSpan(0, size));
+        }
     }
 
     public override Result Flush()
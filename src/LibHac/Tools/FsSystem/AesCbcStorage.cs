@@ -1,4 +1,6 @@
 ﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Crypto;
 using LibHac.Fs;
@@ -42,6 +44,29 @@ public class AesCbcStorage : SectorStorage
         return Result.Success;
     }
 
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        Result res = CheckAccessRange(offset, destination.Length, _size);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        return ReadAsyncImpl(offset, destination, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncImpl(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken)
+    {
+        Result res = await base.ReadAsync(offset, destination, cancellationToken).ConfigureAwait(false);
+        if (res.IsFailure()) return res.Miss();
+
+        res = GetDecryptor(out ICipher cipher, offset);
+        if (res.IsFailure()) return res.Miss();
+
+        cipher.Transform(destination.Span, destination.Span);
+
+        return Result.Success;
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         return ResultFs.UnsupportedOperation.Log();
@@ -1,21 +1,81 @@
 ﻿using System;
+using System.Buffers;
 using System.Collections.Generic;
+using System.Numerics;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Util;
 
 namespace LibHac.Tools.FsSystem;
 
+/// <summary>
+/// Caches fixed-size blocks of a base <see cref="IStorage"/> in memory.
+/// </summary>
+/// <remarks><para>The cache can be split into shards that each have their own lock. A block is always stored in the
+/// same shard, so threads accessing different blocks rarely wait on each other. The constructors that don't take
+/// a shard count create a single shard, which never reads from the base storage on more than one thread at
+/// a time. <see cref="GetRecommendedShardCount"/> returns a shard count suited to the current machine.</para>
+/// <para>Each shard keeps its blocks in a single buffer and evicts blocks using the CLOCK (second chance)
+/// algorithm: accessing a block marks it as referenced, and the eviction scan skips a referenced block once
+/// before evicting it.</para>
+/// <para>Threads that access blocks in different shards read from the base storage at the same time, so the base
+/// storage must support concurrent reads when there is more than one shard. Reads and writes that span multiple
+/// blocks lock one shard at a time, so they aren't atomic with respect to other operations on the storage.</para></remarks>
 public class CachedStorage : IStorage
 {
+    private const int MinBlocksPerShard = 2;
+    private const int MaxShardCount = 16;
+
+    // Shards with more blocks than this use a dictionary instead of a linear search to find blocks
+    private const int MaxLinearSearchBlockCount = 8;
+
     private IStorage BaseStorage { get; }
     private int BlockSize { get; }
     private long Length { get; set; }
     private bool LeaveOpen { get; }
 
-    private LinkedList<CacheBlock> Blocks { get; } = new LinkedList<CacheBlock>();
-    private Dictionary<long, LinkedListNode<CacheBlock>> BlockDict { get; } = new Dictionary<long, LinkedListNode<CacheBlock>>();
+    private readonly Shard[] _shards;
+    private readonly int _shardMask;
+
+    /// <summary>The number of block lookups that were found in the cache.</summary>
+    public long HitCount => SumShardCounters(static s => s.HitCount);
+
+    /// <summary>The number of block lookups that had to be read from the base storage.</summary>
+    public long MissCount => SumShardCounters(static s => s.MissCount);
+
+    /// <summary>The number of cached blocks that were evicted to make room for another block.</summary>
+    public long EvictionCount => SumShardCounters(static s => s.EvictionCount);
 
     public CachedStorage(IStorage baseStorage, int blockSize, int cacheSize, bool leaveOpen)
+        : this(baseStorage, blockSize, cacheSize, 1, leaveOpen) { }
+
+    public CachedStorage(SectorStorage baseStorage, int cacheSize, bool leaveOpen)
+        : this(baseStorage, baseStorage.SectorSize, cacheSize, leaveOpen) { }
+
+    /// <summary>
+    /// Creates a new <see cref="CachedStorage"/> with the specified number of shards.
+    /// </summary>
+    /// <param name="baseStorage">The storage to cache.</param>
+    /// <param name="blockSize">The size of each cached block.</param>
+    /// <param name="cacheSize">The total number of blocks to cache.</param>
+    /// <param name="shardCount">The number of shards to split the cache into. Must be a power of 2
+    /// no larger than <paramref name="cacheSize"/>.</param>
+    /// <param name="leaveOpen"><see langword="true"/> to leave <paramref name="baseStorage"/> open
+    /// when this storage is disposed.</param>
+    public CachedStorage(IStorage baseStorage, int blockSize, int cacheSize, int shardCount, bool leaveOpen)
     {
+        if (blockSize <= 0)
+            throw new ArgumentOutOfRangeException(nameof(blockSize), "Block size must be positive.");
+
+        if (cacheSize <= 0)
+            throw new ArgumentOutOfRangeException(nameof(cacheSize), "Cache size must be positive.");
+
+        if (shardCount <= 0 || shardCount > cacheSize || !BitUtil.IsPowerOfTwo(shardCount))
+            throw new ArgumentOutOfRangeException(nameof(shardCount),
+                "Shard count must be a power of 2 no larger than the cache size.");
+
         BaseStorage = baseStorage;
         BlockSize = blockSize;
         LeaveOpen = leaveOpen;
@@ -23,15 +83,37 @@ public class CachedStorage : IStorage
         BaseStorage.GetSize(out long baseSize).ThrowIfFailure();
         Length = baseSize;
 
-        for (int i = 0; i < cacheSize; i++)
+        _shards = new Shard[shardCount];
+        _shardMask = shardCount - 1;
+
+        for (int i = 0; i < _shards.Length; i++)
         {
-            var block = new CacheBlock { Buffer = new byte[blockSize], Index = -1 };
-            Blocks.AddLast(block);
+            int shardBlockCount = cacheSize / shardCount + (i < cacheSize % shardCount ? 1 : 0);
+            _shards[i] = new Shard(shardBlockCount);
         }
     }
 
-    public CachedStorage(SectorStorage baseStorage, int cacheSize, bool leaveOpen)
-        : this(baseStorage, baseStorage.SectorSize, cacheSize, leaveOpen) { }
+    /// <summary>
+    /// Creates a new <see cref="CachedStorage"/> that caches as many blocks as will fit in
+    /// <paramref name="cacheBudget"/> bytes.
+    /// </summary>
+    /// <param name="baseStorage">The storage to cache.</param>
+    /// <param name="blockSize">The size of each cached block.</param>
+    /// <param name="cacheBudget">The maximum number of bytes to use for cached data.
+    /// At least one block will always be cached.</param>
+    /// <param name="leaveOpen"><see langword="true"/> to leave <paramref name="baseStorage"/> open
+    /// when this storage is disposed.</param>
+    /// <returns>The created <see cref="CachedStorage"/>.</returns>
+    public static CachedStorage CreateWithByteBudget(IStorage baseStorage, int blockSize, long cacheBudget,
+        bool leaveOpen)
+    {
+        if (blockSize <= 0)
+            throw new ArgumentOutOfRangeException(nameof(blockSize), "Block size must be positive.");
+
+        int cacheSize = (int)Math.Clamp(cacheBudget / blockSize, 1, int.MaxValue / blockSize);
+
+        return new CachedStorage(baseStorage, blockSize, cacheSize, leaveOpen);
+    }
 
     public override Result Read(long offset, Span<byte> destination)
     {
@@ -42,22 +124,85 @@ public class CachedStorage : IStorage
         Result res = CheckAccessRange(offset, destination.Length, Length);
         if (res.IsFailure()) return res.Miss();
 
-        lock (Blocks)
+        while (remaining > 0)
         {
-            while (remaining > 0)
+            long blockIndex = inOffset / BlockSize;
+            int blockPos = (int)(inOffset % BlockSize);
+            int bytesToRead = (int)Math.Min(remaining, BlockSize - blockPos);
+
+            Shard shard = GetShard(blockIndex);
+
+            lock (shard.Locker)
             {
-                long blockIndex = inOffset / BlockSize;
-                int blockPos = (int)(inOffset % BlockSize);
-                CacheBlock block = GetBlock(blockIndex);
+                int entryIndex = GetBlock(shard, blockIndex);
+
+                shard.GetBlockBuffer(entryIndex, BlockSize).Slice(blockPos, bytesToRead)
+                    .CopyTo(destination.Slice(outOffset));
+            }
+
+            outOffset += bytesToRead;
+            inOffset += bytesToRead;
+            remaining -= bytesToRead;
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Reads data asynchronously, awaiting the base storage for any blocks that aren't in the cache.
+    /// </summary>
+    /// <remarks>Shard locks aren't held while waiting on the base storage. If another read caches the same
+    /// block in the meantime, the block that's already in the cache is used. If a block in the same shard was
+    /// written back to the base storage in the meantime, the block is read again while holding the lock.</remarks>
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        Result res = CheckAccessRange(offset, destination.Length, Length);
+        if (res.IsFailure()) return new ValueTask<Result>(res.Miss());
+
+        return ReadAsyncImpl(offset, destination, cancellationToken);
+    }
+
+    private async ValueTask<Result> ReadAsyncImpl(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken)
+    {
+        long remaining = destination.Length;
+        long inOffset = offset;
+        int outOffset = 0;
 
-                int bytesToRead = (int)Math.Min(remaining, BlockSize - blockPos);
+        while (remaining > 0)
+        {
+            long blockIndex = inOffset / BlockSize;
+            int blockPos = (int)(inOffset % BlockSize);
+            int bytesToRead = (int)Math.Min(remaining, BlockSize - blockPos);
 
-                block.Buffer.AsSpan(blockPos, bytesToRead).CopyTo(destination.Slice(outOffset));
+            Shard shard = GetShard(blockIndex);
+            Memory<byte> outBuffer = destination.Slice(outOffset, bytesToRead);
 
-                outOffset += bytesToRead;
-                inOffset += bytesToRead;
-                remaining -= bytesToRead;
+            if (!TryReadCachedBlock(shard, blockIndex, blockPos, outBuffer.Span, out long flushGeneration))
+            {
+                int blockLength = GetBlockLength(blockIndex);
+                byte[] blockBuffer = ArrayPool<byte>.Shared.Rent(blockLength);
+
+                try
+                {
+                    Result res = await BaseStorage
+                        .ReadAsync(blockIndex * BlockSize, blockBuffer.AsMemory(0, blockLength), cancellationToken)
+                        .ConfigureAwait(false);
+                    if (res.IsFailure()) return res.Miss();
+
+                    AddReadBlock(shard, blockIndex, blockBuffer.AsSpan(0, blockLength), flushGeneration, blockPos,
+                        outBuffer.Span);
+                }
+                finally
+                {
+                    ArrayPool<byte>.Shared.Return(blockBuffer);
+                }
             }
+
+            outOffset += bytesToRead;
+            inOffset += bytesToRead;
+            remaining -= bytesToRead;
         }
 
         return Result.Success;
@@ -72,24 +217,27 @@ public class CachedStorage : IStorage
         Result res = CheckAccessRange(offset, source.Length, Length);
         if (res.IsFailure()) return res.Miss();
 
-        lock (Blocks)
+        while (remaining > 0)
         {
-            while (remaining > 0)
-            {
-                long blockIndex = inOffset / BlockSize;
-                int blockPos = (int)(inOffset % BlockSize);
-                CacheBlock block = GetBlock(blockIndex);
+            long blockIndex = inOffset / BlockSize;
+            int blockPos = (int)(inOffset % BlockSize);
+            int bytesToWrite = (int)Math.Min(remaining, BlockSize - blockPos);
 
-                int bytesToWrite = (int)Math.Min(remaining, BlockSize - blockPos);
+            Shard shard = GetShard(blockIndex);
 
-                source.Slice(outOffset, bytesToWrite).CopyTo(block.Buffer.AsSpan(blockPos));
+            lock (shard.Locker)
+            {
+                int entryIndex = GetBlock(shard, blockIndex);
 
-                block.Dirty = true;
+                source.Slice(outOffset, bytesToWrite)
+                    .CopyTo(shard.GetBlockBuffer(entryIndex, BlockSize).Slice(blockPos));
 
-                outOffset += bytesToWrite;
-                inOffset += bytesToWrite;
-                remaining -= bytesToWrite;
+                shard.Entries[entryIndex].Dirty = true;
             }
+
+            outOffset += bytesToWrite;
+            inOffset += bytesToWrite;
+            remaining -= bytesToWrite;
         }
 
         return Result.Success;
@@ -97,11 +245,14 @@ public class CachedStorage : IStorage
 
     public override Result Flush()
     {
-        lock (Blocks)
+        foreach (Shard shard in _shards)
         {
-            foreach (CacheBlock cacheItem in Blocks)
+            lock (shard.Locker)
             {
-                FlushBlock(cacheItem);
+                for (int i = 0; i < shard.Entries.Length; i++)
+                {
+                    FlushBlock(shard, i);
+                }
             }
         }
 
@@ -143,45 +294,134 @@ public class CachedStorage : IStorage
         base.Dispose();
     }
 
-    private CacheBlock GetBlock(long blockIndex)
+    private Shard GetShard(long blockIndex)
     {
-        if (BlockDict.TryGetValue(blockIndex, out LinkedListNode<CacheBlock> node))
+        return _shards[(int)(blockIndex & _shardMask)];
+    }
+
+    /// <summary>
+    /// Gets the entry holding the specified block, reading the block into the cache if needed.
+    /// The shard's lock must be held by the caller.
+    /// </summary>
+    private int GetBlock(Shard shard, long blockIndex)
+    {
+        int entryIndex = shard.Find(blockIndex);
+
+        if (entryIndex >= 0)
         {
-            if (Blocks.First != node)
+            shard.Entries[entryIndex].Referenced = true;
+            shard.HitCount++;
+            StorageTracer.ReportCacheHit();
+            return entryIndex;
+        }
+
+        shard.MissCount++;
+        StorageTracer.ReportCacheMiss();
+
+        entryIndex = EvictBlock(shard);
+
+        ReadBlock(shard, entryIndex, blockIndex);
+        shard.Add(blockIndex, entryIndex);
+
+        return entryIndex;
+    }
+
+    /// <summary>
+    /// Copies part of a block to <paramref name="destination"/> if the block is in the cache.
+    /// Otherwise, outputs the shard's flush generation to pass to <see cref="AddReadBlock"/>
+    /// after the block is read from the base storage.
+    /// </summary>
+    /// <returns><see langword="true"/> if the block was in the cache.</returns>
+    private bool TryReadCachedBlock(Shard shard, long blockIndex, int blockPos, Span<byte> destination,
+        out long flushGeneration)
+    {
+        lock (shard.Locker)
+        {
+            flushGeneration = shard.FlushGeneration;
+
+            int entryIndex = shard.Find(blockIndex);
+            if (entryIndex < 0)
+                return false;
+
+            shard.Entries[entryIndex].Referenced = true;
+            shard.HitCount++;
+            StorageTracer.ReportCacheHit();
+
+            shard.GetBlockBuffer(entryIndex, BlockSize).Slice(blockPos, destination.Length).CopyTo(destination);
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Adds a block that was read from the base storage without holding the shard's lock to the cache
+    /// and copies part of it to <paramref name="destination"/>. <paramref name="flushGeneration"/> is the shard's
+    /// flush generation from before the block was read.
+    /// </summary>
+    private void AddReadBlock(Shard shard, long blockIndex, ReadOnlySpan<byte> blockData, long flushGeneration,
+        int blockPos, Span<byte> destination)
+    {
+        lock (shard.Locker)
+        {
+            // Another read might have cached the block first. Its copy might contain newer written data.
+            int entryIndex = shard.Find(blockIndex);
+
+            if (entryIndex >= 0)
             {
-                Blocks.Remove(node);
-                Blocks.AddFirst(node);
+                shard.Entries[entryIndex].Referenced = true;
+                shard.HitCount++;
+                StorageTracer.ReportCacheHit();
             }
+            else
+            {
+                shard.MissCount++;
+                StorageTracer.ReportCacheMiss();
 
-            return node!.Value;
-        }
+                // If the block was written back after it was read, the data we have may be stale.
+                bool isBlockDataStale = shard.FlushGeneration != flushGeneration;
 
-        // An inactive node shouldn't be null, but we'll fix it if it is anyway
-        node = Blocks.Last ??
-               new LinkedListNode<CacheBlock>(new CacheBlock { Buffer = new byte[BlockSize], Index = -1 });
+                entryIndex = EvictBlock(shard);
 
-        FlushBlock(node.Value);
+                if (isBlockDataStale)
+                {
+                    ReadBlock(shard, entryIndex, blockIndex);
+                }
+                else
+                {
+                    blockData.CopyTo(shard.GetBlockBuffer(entryIndex, BlockSize));
+                    InitializeEntry(shard, entryIndex, blockIndex, blockData.Length);
+                }
 
-        CacheBlock block = node.Value;
-        Blocks.RemoveLast();
+                shard.Add(blockIndex, entryIndex);
+            }
 
-        if (block.Index != -1)
-        {
-            BlockDict.Remove(block.Index);
+            shard.GetBlockBuffer(entryIndex, BlockSize).Slice(blockPos, destination.Length).CopyTo(destination);
         }
+    }
 
-        FlushBlock(block);
-        ReadBlock(block, blockIndex);
+    /// <summary>
+    /// Selects an entry to hold a new block, flushing and removing the block it currently holds.
+    /// The shard's lock must be held by the caller.
+    /// </summary>
+    private int EvictBlock(Shard shard)
+    {
+        int entryIndex = shard.SelectVictim();
+        ref CacheEntry entry = ref shard.Entries[entryIndex];
 
-        Blocks.AddFirst(node);
-        BlockDict.Add(blockIndex, node);
+        if (entry.BlockIndex != -1)
+        {
+            FlushBlock(shard, entryIndex);
+            shard.Remove(entry.BlockIndex);
+            shard.EvictionCount++;
+
+            entry.BlockIndex = -1;
+        }
 
-        return block;
+        return entryIndex;
     }
 
-    private void ReadBlock(CacheBlock block, long index)
+    private int GetBlockLength(long blockIndex)
     {
-        long offset = index * BlockSize;
+        long offset = blockIndex * BlockSize;
         int length = BlockSize;
 
         if (Length != -1)
@@ -189,26 +429,160 @@ public class CachedStorage : IStorage
             length = (int)Math.Min(Length - offset, length);
         }
 
-        BaseStorage.Read(offset, block.Buffer.AsSpan(0, length)).ThrowIfFailure();
-        block.Length = length;
-        block.Index = index;
-        block.Dirty = false;
+        return length;
+    }
+
+    private void ReadBlock(Shard shard, int entryIndex, long blockIndex)
+    {
+        long offset = blockIndex * BlockSize;
+        int length = GetBlockLength(blockIndex);
+
+        BaseStorage.Read(offset, shard.GetBlockBuffer(entryIndex, BlockSize).Slice(0, length)).ThrowIfFailure();
+
+        InitializeEntry(shard, entryIndex, blockIndex, length);
     }
 
-    private void FlushBlock(CacheBlock block)
+    private static void InitializeEntry(Shard shard, int entryIndex, long blockIndex, int length)
     {
-        if (!block.Dirty) return;
+        ref CacheEntry entry = ref shard.Entries[entryIndex];
+        entry.BlockIndex = blockIndex;
+        entry.Length = length;
+        entry.Dirty = false;
+        entry.Referenced = true;
+    }
+
+    private void FlushBlock(Shard shard, int entryIndex)
+    {
+        ref CacheEntry entry = ref shard.Entries[entryIndex];
+        if (!entry.Dirty) return;
+
+        long offset = entry.BlockIndex * BlockSize;
+        BaseStorage.Write(offset, shard.GetBlockBuffer(entryIndex, BlockSize).Slice(0, entry.Length))
+            .ThrowIfFailure();
 
-        long offset = block.Index * BlockSize;
-        BaseStorage.Write(offset, block.Buffer.AsSpan(0, block.Length)).ThrowIfFailure();
-        block.Dirty = false;
+        entry.Dirty = false;
+        shard.FlushGeneration++;
     }
 
-    private class CacheBlock
+    private long SumShardCounters(Func<Shard, long> counterSelector)
     {
-        public long Index { get; set; }
-        public byte[] Buffer { get; set; }
-        public int Length { get; set; }
-        public bool Dirty { get; set; }
+        long total = 0;
+
+        foreach (Shard shard in _shards)
+        {
+            lock (shard.Locker)
+            {
+                total += counterSelector(shard);
+            }
+        }
+
+        return total;
+    }
+
+    /// <summary>
+    /// Gets the number of shards to use for a cache of <paramref name="cacheSize"/> blocks that will be accessed
+    /// by many threads. The base storage of a cache with more than one shard must support concurrent reads.
+    /// </summary>
+    /// <param name="cacheSize">The total number of blocks to cache.</param>
+    /// <returns>A power of 2 no larger than the processor count that leaves each shard at least 2 blocks,
+    /// or 1 if the cache is too small to shard.</returns>
+    public static int GetRecommendedShardCount(int cacheSize)
+    {
+        int maxShardCount = Math.Min(cacheSize / MinBlocksPerShard, Math.Min(Environment.ProcessorCount, MaxShardCount));
+
+        if (maxShardCount <= 1)
+            return 1;
+
+        return 1 << BitOperations.Log2((uint)maxShardCount);
+    }
+
+    private struct CacheEntry
+    {
+        public long BlockIndex;
+        public int Length;
+        public bool Dirty;
+        public bool Referenced;
+    }
+
+    private sealed class Shard
+    {
+        public readonly object Locker = new object();
+        public readonly CacheEntry[] Entries;
+        public long HitCount;
+        public long MissCount;
+        public long EvictionCount;
+
+        // Incremented each time one of the shard's blocks is written to the base storage
+        public long FlushGeneration;
+
+        private readonly Dictionary<long, int> _entryLookup;
+        private byte[] _buffer;
+        private int _clockHand;
+
+        public Shard(int blockCount)
+        {
+            Entries = new CacheEntry[blockCount];
+
+            for (int i = 0; i < Entries.Length; i++)
+            {
+                Entries[i].BlockIndex = -1;
+            }
+
+            if (blockCount > MaxLinearSearchBlockCount)
+            {
+                _entryLookup = new Dictionary<long, int>(blockCount);
+            }
+        }
+
+        public Span<byte> GetBlockBuffer(int entryIndex, int blockSize)
+        {
+            // Don't allocate the buffer until it's used because many storages are opened but never read
+            _buffer ??= new byte[Entries.Length * blockSize];
+
+            return _buffer.AsSpan(entryIndex * blockSize, blockSize);
+        }
+
+        public int Find(long blockIndex)
+        {
+            if (_entryLookup is not null)
+            {
+                return _entryLookup.GetValueOrDefault(blockIndex, -1);
+            }
+
+            for (int i = 0; i < Entries.Length; i++)
+            {
+                if (Entries[i].BlockIndex == blockIndex)
+                    return i;
+            }
+
+            return -1;
+        }
+
+        public void Add(long blockIndex, int entryIndex)
+        {
+            _entryLookup?.Add(blockIndex, entryIndex);
+        }
+
+        public void Remove(long blockIndex)
+        {
+            _entryLookup?.Remove(blockIndex);
+        }
+
+        public int SelectVictim()
+        {
+            while (true)
+            {
+                int entryIndex = _clockHand;
+                ref CacheEntry entry = ref Entries[entryIndex];
+
+                _clockHand = entryIndex + 1 == Entries.Length ? 0 : entryIndex + 1;
+
+                if (entry.BlockIndex == -1 || !entry.Referenced)
+                    return entryIndex;
+
+                // Give the block a second chance
+                entry.Referenced = false;
+            }
+        }
     }
-}
\ No newline at end of file
+}
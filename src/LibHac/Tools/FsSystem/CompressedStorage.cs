@@ -1,5 +1,6 @@
 ﻿using System;
 using System.Buffers;
+using System.Collections.Generic;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 using LibHac.Common;
@@ -10,6 +11,14 @@ using LibHac.Util;
 
 namespace LibHac.Tools.FsSystem;
 
+/// <summary>
+/// Reads a compressed NCA section.
+/// </summary>
+/// <remarks><para>Compressed entries that are completely covered by a read are decompressed straight into the
+/// destination buffer. Entries that are only partially read are decompressed into a small cache so that
+/// sequential reads through an entry only decompress it once.</para>
+/// <para>When a read covers multiple compressed entries, the entries are decompressed in parallel
+/// using up to <see cref="DecompressionThreadCount"/> threads.</para></remarks>
 internal class CompressedStorage : IStorage
 {
     [StructLayout(LayoutKind.Sequential)]
@@ -22,8 +31,28 @@ internal class CompressedStorage : IStorage
         public uint PhysicalSize;
     }
 
+    /// <summary>
+    /// A compressed entry that needs to be decompressed as part of a read.
+    /// </summary>
+    private struct EntryRead
+    {
+        public Entry Entry;
+        public int EntrySize;
+        public int OffsetInEntry;
+        public int ReadSize;
+        public int DestinationOffset;
+
+        public readonly bool IsPartialRead => OffsetInEntry != 0 || ReadSize != EntrySize;
+    }
+
     public static readonly int NodeSize = 0x4000;
 
+    // The number of partially read entries to keep decompressed
+    private const int DecompressedEntryCacheCount = 4;
+
+    // The maximum amount of decompressed data to process in a single parallel batch
+    private const int DecompressionBatchSize = 0x400000;
+
     public static long QueryEntryStorageSize(int entryCount)
     {
         return BucketTree.QueryEntryStorageSize(NodeSize, Unsafe.SizeOf<Entry>(), entryCount);
@@ -36,21 +65,60 @@ internal class CompressedStorage : IStorage
 
     private readonly BucketTree _bucketTree;
     private ValueSubStorage _dataStorage;
+    private GetDecompressorFunction _getDecompressorFunction;
+    private readonly DecompressedEntryCache _entryCache;
+
+    /// <summary>
+    /// The maximum number of threads used to decompress the entries covered by a single read.
+    /// A value of 1 or less decompresses every entry on the calling thread.
+    /// </summary>
+    public int DecompressionThreadCount { get; set; } = Environment.ProcessorCount;
 
     public CompressedStorage()
     {
         _bucketTree = new BucketTree();
         _dataStorage = new ValueSubStorage();
+        _entryCache = new DecompressedEntryCache(DecompressedEntryCacheCount);
+    }
+
+    public override void Dispose()
+    {
+        _entryCache.Dispose();
+        _dataStorage.Dispose();
+        _bucketTree.Dispose();
+
+        base.Dispose();
+    }
+
+    /// <summary>
+    /// Sets the cache used to keep decoded nodes of the compression table in memory.
+    /// </summary>
+    /// <param name="cache">The cache to use. May be shared with other storages.
+    /// <see langword="null"/> disables node caching.</param>
+    public void SetNodeCache(BucketTreeNodeCache cache)
+    {
+        _bucketTree.SetNodeCache(cache);
     }
 
     public Result Initialize(MemoryResource allocatorForBucketTree, ref readonly ValueSubStorage dataStorage,
         ref readonly ValueSubStorage nodeStorage, ref readonly ValueSubStorage entryStorage, int bucketTreeEntryCount)
     {
+        return Initialize(allocatorForBucketTree, in dataStorage, in nodeStorage, in entryStorage, bucketTreeEntryCount,
+            CompressionConfiguration.GetNcaDecompressorFunction).Ret();
+    }
+
+    public Result Initialize(MemoryResource allocatorForBucketTree, ref readonly ValueSubStorage dataStorage,
+        ref readonly ValueSubStorage nodeStorage, ref readonly ValueSubStorage entryStorage, int bucketTreeEntryCount,
+        GetDecompressorFunction getDecompressorFunc)
+    {
+        Assert.SdkRequiresNotNull(getDecompressorFunc);
+
         Result res = _bucketTree.Initialize(allocatorForBucketTree, in nodeStorage, in entryStorage, NodeSize,
             Unsafe.SizeOf<Entry>(), bucketTreeEntryCount);
         if (res.IsFailure()) return res.Miss();
 
         _dataStorage.Set(in dataStorage);
+        _getDecompressorFunction = getDecompressorFunc;
 
         return Result.Success;
     }
@@ -78,8 +146,9 @@ internal class CompressedStorage : IStorage
         long currentOffset = offset;
         long endOffset = offset + destination.Length;
 
-        byte[] workBufferEnc = null;
-        byte[] workBufferDec = null;
+        // Compressed entries are collected into batches that are decompressed together
+        List<EntryRead> pendingEntries = null;
+        long pendingSize = 0;
 
         while (currentOffset < endOffset)
         {
@@ -119,24 +188,10 @@ internal class CompressedStorage : IStorage
             long toWriteSize = Math.Min(remainingSize, currentEntrySize - dataOffsetInEntry);
             Assert.SdkLessEqual(toWriteSize, destination.Length);
 
-            Span<byte> entryDestination = destination.Slice((int)(currentOffset - offset), (int)toWriteSize);
+            int destinationOffset = (int)(currentOffset - offset);
+            Span<byte> entryDestination = destination.Slice(destinationOffset, (int)toWriteSize);
 
-            if (currentEntry.CompressionType == CompressionType.Lz4)
-            {
-                EnsureBufferSize(ref workBufferEnc, (int)currentEntry.PhysicalSize);
-                EnsureBufferSize(ref workBufferDec, (int)currentEntrySize);
-
-                Span<byte> encBuffer = workBufferEnc.AsSpan(0, (int)currentEntry.PhysicalSize);
-                Span<byte> decBuffer = workBufferDec.AsSpan(0, (int)currentEntrySize);
-
-                res = _dataStorage.Read(currentEntry.PhysicalOffset, encBuffer);
-                if (res.IsFailure()) return res.Miss();
-
-                Lz4.Decompress(encBuffer, decBuffer);
-
-                decBuffer.Slice((int)dataOffsetInEntry, (int)toWriteSize).CopyTo(entryDestination);
-            }
-            else if (currentEntry.CompressionType == CompressionType.None)
+            if (currentEntry.CompressionType == CompressionType.None)
             {
                 res = _dataStorage.Read(currentEntry.PhysicalOffset + dataOffsetInEntry, entryDestination);
                 if (res.IsFailure()) return res.Miss();
@@ -145,32 +200,152 @@ internal class CompressedStorage : IStorage
             {
                 entryDestination.Clear();
             }
+            else if (!_entryCache.TryRead(currentEntryOffset, dataOffsetInEntry, entryDestination))
+            {
+                if (currentEntrySize > int.MaxValue)
+                    return ResultFs.UnexpectedInCompressedStorageA.Log();
+
+                pendingEntries ??= new List<EntryRead>();
+                pendingEntries.Add(new EntryRead
+                {
+                    Entry = currentEntry,
+                    EntrySize = (int)currentEntrySize,
+                    OffsetInEntry = (int)dataOffsetInEntry,
+                    ReadSize = (int)toWriteSize,
+                    DestinationOffset = destinationOffset
+                });
+
+                pendingSize += currentEntrySize;
+
+                if (pendingSize >= DecompressionBatchSize)
+                {
+                    res = DecompressEntries(pendingEntries, destination);
+                    if (res.IsFailure()) return res.Miss();
+
+                    pendingEntries.Clear();
+                    pendingSize = 0;
+                }
+            }
 
             currentOffset += toWriteSize;
         }
 
-        if (workBufferDec is not null)
-            ArrayPool<byte>.Shared.Return(workBufferDec);
-
-        if (workBufferEnc is not null)
-            ArrayPool<byte>.Shared.Return(workBufferEnc);
+        if (pendingEntries is not null && pendingEntries.Count != 0)
+        {
+            res = DecompressEntries(pendingEntries, destination);
+            if (res.IsFailure()) return res.Miss();
+        }
 
         return Result.Success;
+    }
+
+    private unsafe Result DecompressEntries(List<EntryRead> entries, Span<byte> destination)
+    {
+        byte[][] compressedBuffers = new byte[entries.Count][];
+        byte[][] decompressedBuffers = new byte[entries.Count][];
 
-        static void EnsureBufferSize(ref byte[] buffer, int requiredSize)
+        try
         {
-            if (buffer is null || buffer.Length < requiredSize)
+            // Read all the compressed data up front so only the decompression is done in parallel
+            for (int i = 0; i < entries.Count; i++)
             {
-                if (buffer is not null)
+                EntryRead entry = entries[i];
+                int physicalSize = (int)entry.Entry.PhysicalSize;
+
+                compressedBuffers[i] = ArrayPool<byte>.Shared.Rent(physicalSize);
+
+                Result res = _dataStorage.Read(entry.Entry.PhysicalOffset, compressedBuffers[i].AsSpan(0, physicalSize));
+                if (res.IsFailure()) return res.Miss();
+
+                if (entry.IsPartialRead)
+                {
+                    decompressedBuffers[i] = ArrayPool<byte>.Shared.Rent(entry.EntrySize);
+                }
+            }
+
+            fixed (byte* pDestination = destination)
+            {
+                var destinationAddress = (nint)pDestination;
+                int destinationLength = destination.Length;
+
+                if (entries.Count == 1 || DecompressionThreadCount <= 1)
+                {
+                    for (int i = 0; i < entries.Count; i++)
+                    {
+                        Result res = DecompressEntry(i);
+                        if (res.IsFailure()) return res.Miss();
+                    }
+                }
+                else
+                {
+                    var results = new Result[entries.Count];
+
+                    ParallelUtils.For(entries.Count, DecompressionThreadCount, i => results[i] = DecompressEntry(i));
+
+                    foreach (Result res in results)
+                    {
+                        if (res.IsFailure()) return res.Miss();
+                    }
+                }
+
+                Result DecompressEntry(int index)
                 {
-                    ArrayPool<byte>.Shared.Return(buffer);
+                    EntryRead entry = entries[index];
+                    var output = new Span<byte>((byte*)destinationAddress, destinationLength);
+
+                    Span<byte> decompressDestination = entry.IsPartialRead
+                        ? decompressedBuffers[index].AsSpan(0, entry.EntrySize)
+                        : output.Slice(entry.DestinationOffset, entry.ReadSize);
+
+                    Result res = Decompress(entry.Entry.CompressionType, decompressDestination,
+                        compressedBuffers[index].AsSpan(0, (int)entry.Entry.PhysicalSize));
+                    if (res.IsFailure()) return res.Miss();
+
+                    if (entry.IsPartialRead)
+                    {
+                        decompressDestination.Slice(entry.OffsetInEntry, entry.ReadSize)
+                            .CopyTo(output.Slice(entry.DestinationOffset));
+                    }
+
+                    return Result.Success;
                 }
+            }
 
-                buffer = ArrayPool<byte>.Shared.Rent(requiredSize);
+            // Keep the partially read entries around for the next read
+            for (int i = 0; i < entries.Count; i++)
+            {
+                if (decompressedBuffers[i] is not null)
+                {
+                    _entryCache.Add(entries[i].Entry.VirtualOffset, entries[i].EntrySize, decompressedBuffers[i]);
+                    decompressedBuffers[i] = null;
+                }
             }
 
-            Assert.SdkGreaterEqual(buffer.Length, requiredSize);
+            return Result.Success;
         }
+        finally
+        {
+            for (int i = 0; i < entries.Count; i++)
+            {
+                if (compressedBuffers[i] is not null)
+                    ArrayPool<byte>.Shared.Return(compressedBuffers[i]);
+
+                if (decompressedBuffers[i] is not null)
+                    ArrayPool<byte>.Shared.Return(decompressedBuffers[i]);
+            }
+        }
+    }
+
+    private Result Decompress(CompressionType type, Span<byte> destination, ReadOnlySpan<byte> source)
+    {
+        DecompressorFunction decompressor = CompressionTypeUtility.IsUnknownType(type)
+            ? null
+            : _getDecompressorFunction(type);
+
+        if (decompressor is null)
+            return ResultFs.UnexpectedInCompressedStorageB.Log();
+
+        return decompressor(new DecompressionTask { Destination = destination, Source = source }).Ret();
     }
 
     public override Result Write(long offset, ReadOnlySpan<byte> source)
@@ -204,4 +379,104 @@ internal class CompressedStorage : IStorage
     {
         throw new NotImplementedException();
     }
-}
\ No newline at end of file
+
+    /// <summary>
+    /// Holds the decompressed data of the most recently used partially read entries.
+    /// </summary>
+    private class DecompressedEntryCache : IDisposable
+    {
+        private struct CacheEntry
+        {
+            public long VirtualOffset;
+            public int Size;
+            public byte[] Buffer;
+            public long LastAccess;
+        }
+
+        private readonly object _locker = new();
+        private readonly CacheEntry[] _entries;
+        private long _accessCount;
+
+        public DecompressedEntryCache(int count)
+        {
+            _entries = new CacheEntry[count];
+        }
+
+        public void Dispose()
+        {
+            lock (_locker)
+            {
+                for (int i = 0; i < _entries.Length; i++)
+                {
+                    if (_entries[i].Buffer is not null)
+                        ArrayPool<byte>.Shared.Return(_entries[i].Buffer);
+
+                    _entries[i] = default;
+                }
+            }
+        }
+
+        public bool TryRead(long entryOffset, long offsetInEntry, Span<byte> destination)
+        {
+            lock (_locker)
+            {
+                for (int i = 0; i < _entries.Length; i++)
+                {
+                    ref CacheEntry entry = ref _entries[i];
+
+                    if (entry.Buffer is null || entry.VirtualOffset != entryOffset)
+                        continue;
+
+                    if (offsetInEntry + destination.Length > entry.Size)
+                        return false;
+
+                    entry.Buffer.AsSpan((int)offsetInEntry, destination.Length).CopyTo(destination);
+                    entry.LastAccess = ++_accessCount;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /// <summary>
+        /// Adds a decompressed entry to the cache. The cache takes ownership of <paramref name="buffer"/>,
+        /// which must have been rented from <see cref="ArrayPool{T}.Shared"/>.
+        /// </summary>
+        public void Add(long entryOffset, int size, byte[] buffer)
+        {
+            byte[] bufferToReturn;
+
+            lock (_locker)
+            {
+                int index = 0;
+
+                for (int i = 0; i < _entries.Length; i++)
+                {
+                    // Replace an existing copy of the same entry if another thread already added it
+                    if (_entries[i].Buffer is not null && _entries[i].VirtualOffset == entryOffset)
+                    {
+                        index = i;
+                        break;
+                    }
+
+                    if (_entries[i].LastAccess < _entries[index].LastAccess)
+                        index = i;
+                }
+
+                bufferToReturn = _entries[index].Buffer;
+
+                _entries[index] = new CacheEntry
+                {
+                    VirtualOffset = entryOffset,
+                    Size = size,
+                    Buffer = buffer,
+                    LastAccess = ++_accessCount
+                };
+            }
+
+            if (bufferToReturn is not null)
+                ArrayPool<byte>.Shared.Return(bufferToReturn);
+        }
+    }
+}
@@ -0,0 +1,219 @@
+﻿using System;
+using System.Buffers;
+using System.Collections.Generic;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Common;
+using LibHac.Util;
+
+namespace LibHac.Tools.FsSystem;
+
+/// <summary>
+/// Copies data in large chunks, reading upcoming chunks while earlier chunks are being written.
+/// </summary>
+/// <remarks>Reading a chunk from the source usually includes decrypting and verifying it, so reading several
+/// chunks ahead lets that work run in parallel with the writes. The number of chunks in flight is bounded so
+/// memory usage doesn't depend on the size of the data being copied.</remarks>
+public static class CopyPipeline
+{
+    public const int DefaultChunkSize = 0x100000;
+
+    /// <summary>
+    /// Files at least this large are split into chunks that are read by multiple threads
+    /// instead of being copied alongside other files.
+    /// </summary>
+    public const long LargeFileThreshold = DefaultChunkSize * 16;
+
+    public delegate Result ReadFunction(long offset, Span<byte> destination);
+    public delegate Result WriteFunction(long offset, ReadOnlySpan<byte> source);
+    public delegate Result CopyFileFunction(int index, int readerCount);
+
+    /// <summary>
+    /// Copies <paramref name="size"/> bytes using <paramref name="read"/> and <paramref name="write"/>.
+    /// </summary>
+    /// <remarks>Up to <paramref name="readerCount"/> chunks are read concurrently on the thread pool while completed
+    /// chunks are written in order on the calling thread. Even with a single reader the next chunk is read while the
+    /// current one is written. <paramref name="read"/> must be safe to call from multiple threads when
+    /// <paramref name="readerCount"/> is greater than 1.</remarks>
+    /// <param name="read">Reads the data at the specified offset.</param>
+    /// <param name="write">Writes the data at the specified offset.</param>
+    /// <param name="size">The number of bytes to copy.</param>
+    /// <param name="readerCount">The maximum number of chunks to read concurrently.</param>
+    /// <param name="logger">An optional <see cref="IProgressReport"/> that each written chunk is added to.</param>
+    /// <param name="chunkSize">The size of each chunk.</param>
+    /// <returns>The <see cref="Result"/> of the first read or write that failed, or <see cref="Result.Success"/>.</returns>
+    public static Result Copy(ReadFunction read, WriteFunction write, long size, int readerCount,
+        IProgressReport logger = null, int chunkSize = DefaultChunkSize)
+    {
+        if (size <= chunkSize)
+            return CopySingleChunk(read, write, size, logger);
+
+        long chunkCount = BitUtil.DivideUp(size, chunkSize);
+        readerCount = (int)Math.Min(Math.Max(readerCount, 1), chunkCount);
+
+        // One extra slot lets a chunk be written while the readers fill the others
+        int slotCount = readerCount + 1;
+
+        var buffers = new byte[slotCount][];
+        var reads = new Task<Result>[slotCount];
+
+        Task<Result> StartRead(long chunk, int slot)
+        {
+            long offset = chunk * chunkSize;
+            int length = (int)Math.Min(chunkSize, size - offset);
+            byte[] buffer = buffers[slot];
+
+            return Task.Run(() => read(offset, buffer.AsSpan(0, length)));
+        }
+
+        try
+        {
+            for (int i = 0; i < slotCount; i++)
+            {
+                buffers[i] = ArrayPool<byte>.Shared.Rent(chunkSize);
+            }
+
+            for (int i = 0; i < readerCount; i++)
+            {
+                reads[i] = StartRead(i, i);
+            }
+
+            for (long chunk = 0; chunk < chunkCount; chunk++)
+            {
+                int slot = (int)(chunk % slotCount);
+                long offset = chunk * chunkSize;
+                int length = (int)Math.Min(chunkSize, size - offset);
+
+                // Clear the slot first so a read that throws isn't waited on again below
+                Task<Result> readTask = reads[slot];
+                reads[slot] = null;
+
+                Result res = readTask.GetAwaiter().GetResult();
+                if (res.IsFailure()) return res.Miss();
+
+                // The next chunk goes in the slot that was written last iteration
+                long nextChunk = chunk + readerCount;
+                if (nextChunk < chunkCount)
+                {
+                    int nextSlot = (int)(nextChunk % slotCount);
+                    reads[nextSlot] = StartRead(nextChunk, nextSlot);
+                }
+
+                res = write(offset, buffers[slot].AsSpan(0, length));
+                if (res.IsFailure()) return res.Miss();
+
+                logger?.ReportAdd(length);
+            }
+
+            return Result.Success;
+        }
+        finally
+        {
+            try
+            {
+                // Reads that are still running after a failure may throw, and those exceptions shouldn't be lost
+                ParallelUtils.WaitAll(reads);
+            }
+            finally
+            {
+                // Buffers can't be returned to the pool until every read using them has finished
+                foreach (byte[] buffer in buffers)
+                {
+                    if (buffer is not null)
+                        ArrayPool<byte>.Shared.Return(buffer);
+                }
+            }
+        }
+    }
+
+    private static Result CopySingleChunk(ReadFunction read, WriteFunction write, long size, IProgressReport logger)
+    {
+        if (size <= 0)
+            return Result.Success;
+
+        byte[] buffer = ArrayPool<byte>.Shared.Rent((int)size);
+        try
+        {
+            Span<byte> data = buffer.AsSpan(0, (int)size);
+
+            Result res = read(0, data);
+            if (res.IsFailure()) return res.Miss();
+
+            res = write(0, data);
+            if (res.IsFailure()) return res.Miss();
+
+            logger?.ReportAdd(size);
+            return Result.Success;
+        }
+        finally
+        {
+            ArrayPool<byte>.Shared.Return(buffer);
+        }
+    }
+
+    /// <summary>
+    /// Calls <paramref name="copyFile"/> for each file in <paramref name="fileSizes"/> using up to
+    /// <paramref name="threadCount"/> threads.
+    /// </summary>
+    /// <remarks>Files smaller than <see cref="LargeFileThreshold"/> are copied concurrently, each with a single
+    /// reader. Larger files are then copied one at a time, each with <paramref name="threadCount"/> readers.
+    /// No new files are started after a copy fails.</remarks>
+    /// <param name="fileSizes">The size of each file to copy.</param>
+    /// <param name="threadCount">The maximum number of threads to use.</param>
+    /// <param name="copyFile">Copies the file at the specified index using the specified number of readers.</param>
+    /// <returns>The <see cref="Result"/> of the first copy that failed, or <see cref="Result.Success"/>.</returns>
+    public static Result CopyFiles(IReadOnlyList<long> fileSizes, int threadCount, CopyFileFunction copyFile)
+    {
+        var smallFiles = new List<int>();
+        var largeFiles = new List<int>();
+
+        for (int i = 0; i < fileSizes.Count; i++)
+        {
+            if (fileSizes[i] >= LargeFileThreshold)
+            {
+                largeFiles.Add(i);
+            }
+            else
+            {
+                smallFiles.Add(i);
+            }
+        }
+
+        // Start the biggest files first so one of them doesn't end up running alone at the end
+        smallFiles.Sort((a, b) => fileSizes[b].CompareTo(fileSizes[a]));
+
+        int nextFile = -1;
+        Result firstFailure = Result.Success;
+        int hasFailed = 0;
+
+        void CopySmallFiles()
+        {
+            int file;
+            while (Volatile.Read(ref hasFailed) == 0 && (file = Interlocked.Increment(ref nextFile)) < smallFiles.Count)
+            {
+                Result res = copyFile(smallFiles[file], 1);
+
+                if (res.IsFailure() && Interlocked.Exchange(ref hasFailed, 1) == 0)
+                {
+                    firstFailure = res;
+                }
+            }
+        }
+
+        if (smallFiles.Count > 0)
+        {
+            // Each worker claims files until none are left
+            ParallelUtils.For(Math.Min(threadCount, smallFiles.Count), threadCount, _ => CopySmallFiles());
+
+            if (firstFailure.IsFailure()) return firstFailure.Miss();
+        }
+
+        foreach (int file in largeFiles)
+        {
+            Result res = copyFile(file, threadCount);
+            if (res.IsFailure()) return res.Miss();
+        }
+
+        return Result.Success;
+    }
+}
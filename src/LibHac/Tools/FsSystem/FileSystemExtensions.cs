@@ -16,8 +16,23 @@ namespace LibHac.Tools.FsSystem;
 
 public static class FileSystemExtensions
 {
+    /// <summary>
+    /// Copies the contents of a directory in <paramref name="sourceFs"/> to a directory in <paramref name="destFs"/>.
+    /// </summary>
+    /// <remarks>When <paramref name="threadCount"/> is greater than 1, the directory tree is created first and the
+    /// files are then copied concurrently using <see cref="CopyPipeline"/>. Reads from <paramref name="sourceFs"/>
+    /// must be thread-safe in that case.</remarks>
+    /// <param name="sourceFs">The file system to copy from.</param>
+    /// <param name="destFs">The file system to copy to.</param>
+    /// <param name="sourcePath">The path of the directory to copy.</param>
+    /// <param name="destPath">The path of the directory to copy to.</param>
+    /// <param name="logger">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    /// <param name="options">The options used when creating the destination files.</param>
+    /// <param name="threadCount">The maximum number of threads to use. A value of 1 or less will
+    /// copy one file at a time on the calling thread.</param>
+    /// <returns>The <see cref="Result"/> of the operation.</returns>
     public static Result CopyDirectory(this IFileSystem sourceFs, IFileSystem destFs, string sourcePath, string destPath,
-        IProgressReport logger = null, CreateFileOptions options = CreateFileOptions.None)
+        IProgressReport logger = null, CreateFileOptions options = CreateFileOptions.None, int threadCount = 1)
     {
         const int bufferSize = 0x100000;
 
@@ -31,6 +46,19 @@ public static class FileSystemExtensions
         res = InitializeFromString(ref destPathNormalized.Ref(), destPath);
         if (res.IsFailure()) return res.Miss();
 
+        if (threadCount > 1)
+        {
+            try
+            {
+                return CopyDirectoryParallel(destFs, sourceFs, in destPathNormalized, in sourcePathNormalized,
+                    ref directoryEntryBuffer, threadCount, logger, options);
+            }
+            finally
+            {
+                logger?.SetTotal(0);
+            }
+        }
+
         byte[] workBuffer = ArrayPool<byte>.Shared.Rent(bufferSize);
         try
         {
@@ -44,27 +72,28 @@ public static class FileSystemExtensions
         }
     }
 
-    public static Result CopyDirectoryRecursively(IFileSystem destinationFileSystem, IFileSystem sourceFileSystem,
-        ref readonly Path destinationPath, ref readonly Path sourcePath, ref DirectoryEntry dirEntry,
-        Span<byte> workBuffer, IProgressReport logger = null, CreateFileOptions option = CreateFileOptions.None)
+    private static Result OnEnterCopyDirectory(ref readonly Path path, in DirectoryEntry entry,
+        ref Utility.FsIterationTaskClosure closure)
     {
-        static Result OnEnterDir(ref readonly Path path, in DirectoryEntry entry,
-            ref Utility.FsIterationTaskClosure closure)
-        {
-            Result res = closure.DestinationPathBuffer.AppendChild(entry.Name);
-            if (res.IsFailure()) return res.Miss();
+        Result res = closure.DestinationPathBuffer.AppendChild(entry.Name);
+        if (res.IsFailure()) return res.Miss();
 
-            res = closure.DestFileSystem.CreateDirectory(in closure.DestinationPathBuffer);
-            if (res.IsFailure() && !ResultFs.PathAlreadyExists.Includes(res)) return res.Miss();
+        res = closure.DestFileSystem.CreateDirectory(in closure.DestinationPathBuffer);
+        if (res.IsFailure() && !ResultFs.PathAlreadyExists.Includes(res)) return res.Miss();
 
-            return Result.Success;
-        }
+        return Result.Success;
+    }
 
-        static Result OnExitDir(ref readonly Path path, in DirectoryEntry entry, ref Utility.FsIterationTaskClosure closure)
-        {
-            return closure.DestinationPathBuffer.RemoveChild();
-        }
+    private static Result OnExitCopyDirectory(ref readonly Path path, in DirectoryEntry entry,
+        ref Utility.FsIterationTaskClosure closure)
+    {
+        return closure.DestinationPathBuffer.RemoveChild();
+    }
 
+    public static Result CopyDirectoryRecursively(IFileSystem destinationFileSystem, IFileSystem sourceFileSystem,
+        ref readonly Path destinationPath, ref readonly Path sourcePath, ref DirectoryEntry dirEntry,
+        Span<byte> workBuffer, IProgressReport logger = null, CreateFileOptions option = CreateFileOptions.None)
+    {
         Result OnFile(ref readonly Path path, in DirectoryEntry entry, ref Utility.FsIterationTaskClosure closure)
         {
             logger?.LogMessage(path.ToString());
@@ -87,13 +116,124 @@ public static class FileSystemExtensions
         Result res = taskClosure.DestinationPathBuffer.Initialize(in destinationPath);
         if (res.IsFailure()) return res.Miss();
 
-        res = Utility.IterateDirectoryRecursively(sourceFileSystem, in sourcePath, ref dirEntry, OnEnterDir,
-            OnExitDir, OnFile, ref taskClosure);
+        res = Utility.IterateDirectoryRecursively(sourceFileSystem, in sourcePath, ref dirEntry, OnEnterCopyDirectory,
+            OnExitCopyDirectory, OnFile, ref taskClosure);
 
         taskClosure.DestinationPathBuffer.Dispose();
         return res;
     }
 
+    private static Result CopyDirectoryParallel(IFileSystem destinationFileSystem, IFileSystem sourceFileSystem,
+        ref readonly Path destinationPath, ref readonly Path sourcePath, ref DirectoryEntry dirEntry, int threadCount,
+        IProgressReport logger, CreateFileOptions option)
+    {
+        var sourceFiles = new List<string>();
+        var destFiles = new List<string>();
+        var fileSizes = new List<long>();
+
+        Result OnFile(ref readonly Path path, in DirectoryEntry entry, ref Utility.FsIterationTaskClosure closure)
+        {
+            Result result = closure.DestinationPathBuffer.AppendChild(entry.Name);
+            if (result.IsFailure()) return result;
+
+            result = CreateOrOverwriteFile(closure.DestFileSystem, in closure.DestinationPathBuffer, entry.Size,
+                option);
+            if (result.IsFailure()) return result;
+
+            sourceFiles.Add(path.ToString());
+            destFiles.Add(closure.DestinationPathBuffer.ToString());
+            fileSizes.Add(entry.Size);
+
+            return closure.DestinationPathBuffer.RemoveChild();
+        }
+
+        // Create the directory tree and the destination files up front so the copies
+        // don't modify the destination file system's entries concurrently
+        var taskClosure = new Utility.FsIterationTaskClosure();
+        taskClosure.SourceFileSystem = sourceFileSystem;
+        taskClosure.DestFileSystem = destinationFileSystem;
+
+        Result res = taskClosure.DestinationPathBuffer.Initialize(in destinationPath);
+        if (res.IsFailure()) return res.Miss();
+
+        res = Utility.IterateDirectoryRecursively(sourceFileSystem, in sourcePath, ref dirEntry, OnEnterCopyDirectory,
+            OnExitCopyDirectory, OnFile, ref taskClosure);
+
+        taskClosure.DestinationPathBuffer.Dispose();
+        if (res.IsFailure()) return res.Miss();
+
+        long totalSize = 0;
+
+        foreach (long size in fileSizes)
+        {
+            totalSize += size;
+        }
+
+        logger?.SetTotal(totalSize);
+
+        return CopyPipeline.CopyFiles(fileSizes, threadCount, (index, readerCount) =>
+        {
+            logger?.LogMessage(sourceFiles[index]);
+
+            Result copyResult = CopyFilePipelined(destinationFileSystem, sourceFileSystem, destFiles[index],
+                sourceFiles[index], readerCount, logger);
+            if (copyResult.IsFailure()) return copyResult.Miss();
+
+            return Result.Success;
+        });
+    }
+
+    private static Result CopyFilePipelined(IFileSystem destFileSystem, IFileSystem sourceFileSystem, string destPath,
+        string sourcePath, int readerCount, IProgressReport logger)
+    {
+        using var sourcePathNormalized = new Path();
+        Result res = InitializeFromString(ref sourcePathNormalized.Ref(), sourcePath);
+        if (res.IsFailure()) return res.Miss();
+
+        using var destPathNormalized = new Path();
+        res = InitializeFromString(ref destPathNormalized.Ref(), destPath);
+        if (res.IsFailure()) return res.Miss();
+
+        using var sourceFile = new UniqueRef<IFile>();
+        res = sourceFileSystem.OpenFile(ref sourceFile.Ref, in sourcePathNormalized, OpenMode.Read);
+        if (res.IsFailure()) return res.Miss();
+
+        res = sourceFile.Get.GetSize(out long fileSize);
+        if (res.IsFailure()) return res.Miss();
+
+        using var destFile = new UniqueRef<IFile>();
+        res = destFileSystem.OpenFile(ref destFile.Ref, in destPathNormalized, OpenMode.Write);
+        if (res.IsFailure()) return res.Miss();
+
+        IFile source = sourceFile.Get;
+        IFile dest = destFile.Get;
+
+        Result Read(long offset, Span<byte> destination)
+        {
+            Result result = source.Read(out long bytesRead, offset, destination, ReadOption.None);
+            if (result.IsFailure()) return result.Miss();
+
+            // The file size was checked before copying, so every chunk should be read in full
+            if (bytesRead != destination.Length)
+                return ResultFs.OutOfRange.Log();
+
+            return Result.Success;
+        }
+
+        Result Write(long offset, ReadOnlySpan<byte> data)
+        {
+            Result result = dest.Write(offset, data, WriteOption.None);
+            if (result.IsFailure()) return result.Miss();
+
+            return Result.Success;
+        }
+
+        res = CopyPipeline.Copy(Read, Write, fileSize, readerCount, logger);
+        if (res.IsFailure()) return res.Miss();
+
+        return Result.Success;
+    }
+
     public static Result CopyFile(IFileSystem destFileSystem, IFileSystem sourceFileSystem, ref readonly Path destPath,
         ref readonly Path sourcePath, Span<byte> workBuffer, IProgressReport logger = null,
         CreateFileOptions option = CreateFileOptions.None)
@@ -136,11 +276,12 @@ public static class FileSystemExtensions
         return Result.Success;
     }
 
-    public static void Extract(this IFileSystem source, string destinationPath, IProgressReport logger = null)
+    public static void Extract(this IFileSystem source, string destinationPath, IProgressReport logger = null,
+        int threadCount = 1)
     {
         var destFs = new LocalFileSystem(destinationPath);
 
-        source.CopyDirectory(destFs, "/", "/", logger).ThrowIfFailure();
+        source.CopyDirectory(destFs, "/", "/", logger, threadCount: threadCount).ThrowIfFailure();
     }
 
     public static IEnumerable<DirectoryEntryEx> EnumerateEntries(this IFileSystem fileSystem)
@@ -0,0 +1,485 @@
+﻿using System;
+using System.Buffers;
+using System.Collections.Generic;
+using System.Threading.Tasks;
+using LibHac.Common;
+using LibHac.Crypto;
+using LibHac.Fs;
+using LibHac.Util;
+
+namespace LibHac.Tools.FsSystem;
+
+/// <summary>
+/// Writes the data level of a hierarchical integrity image to a storage and builds its hash levels
+/// as the data is written, so the data only has to be produced once.
+/// </summary>
+/// <remarks><para>Written data is collected into batches. Each full batch is written to the destination storage
+/// and then hashed on the thread pool while the next batches are filled. Up to <c>threadCount</c> batches
+/// are hashed at the same time.</para>
+/// <para>The levels use the same layout as an NCA RomFS section: five hash levels followed by the data level,
+/// each starting on a block boundary. Partial blocks are padded with zeros before they're hashed.</para></remarks>
+public class HierarchicalIntegrityImageWriter : IDisposable
+{
+    public const int DefaultBlockSizePower = 14;
+
+    private const int IvfcVersion = 2;
+    private const int HashLevelCount = 5;
+    private const int BatchSize = 0x100000;
+
+    private readonly IStorage _destination;
+    private readonly long _destinationSize;
+    private readonly int _blockSize;
+    private readonly int _blockSizePower;
+    private readonly bool _hashInParallel;
+
+    private readonly Batch[] _batches;
+    private int _currentBatch;
+
+    private byte[] _dataHashes = Array.Empty<byte>();
+    private readonly SortedSet<long> _patchedBlocks = new SortedSet<long>();
+
+    /// <summary>The number of bytes of the data level that have been written.</summary>
+    public long Position { get; private set; }
+
+    /// <summary>
+    /// Creates a new <see cref="HierarchicalIntegrityImageWriter"/>.
+    /// </summary>
+    /// <param name="destination">The storage the data level will be written to. It must be large enough
+    /// to hold all the written data.</param>
+    /// <param name="threadCount">The maximum number of batches to hash at the same time. A value of 1 or less
+    /// will hash the data on the calling thread.</param>
+    /// <param name="blockSizePower">The block size of each level as a power of 2.</param>
+    public HierarchicalIntegrityImageWriter(IStorage destination, int threadCount,
+        int blockSizePower = DefaultBlockSizePower)
+    {
+        if (blockSizePower < 9 || blockSizePower > 20)
+            throw new ArgumentOutOfRangeException(nameof(blockSizePower));
+
+        destination.GetSize(out _destinationSize).ThrowIfFailure();
+
+        _destination = destination;
+        _blockSizePower = blockSizePower;
+        _blockSize = 1 << blockSizePower;
+        _hashInParallel = threadCount > 1;
+
+        // One extra batch lets the next batch be filled while the others are being hashed
+        _batches = new Batch[Math.Max(threadCount, 1) + 1];
+
+        for (int i = 0; i < _batches.Length; i++)
+        {
+            _batches[i] = new Batch(BatchSize / _blockSize * Sha256.DigestSize);
+        }
+    }
+
+    /// <summary>
+    /// Appends data to the data level.
+    /// </summary>
+    public Result Write(ReadOnlySpan<byte> source)
+    {
+        while (!source.IsEmpty)
+        {
+            Batch batch = _batches[_currentBatch];
+            batch.Buffer ??= ArrayPool<byte>.Shared.Rent(BatchSize);
+
+            int toCopy = Math.Min(source.Length, BatchSize - batch.Length);
+            source.Slice(0, toCopy).CopyTo(batch.Buffer.AsSpan(batch.Length));
+
+            batch.Length += toCopy;
+            Position += toCopy;
+            source = source.Slice(toCopy);
+
+            if (batch.Length == BatchSize)
+            {
+                Result res = SubmitBatch();
+                if (res.IsFailure()) return res.Miss();
+            }
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Appends <paramref name="count"/> zero bytes to the data level.
+    /// </summary>
+    public Result WriteZeros(long count)
+    {
+        ReadOnlySpan<byte> zeros = stackalloc byte[0x100];
+
+        while (count > 0)
+        {
+            int toWrite = (int)Math.Min(count, zeros.Length);
+
+            Result res = Write(zeros.Slice(0, toWrite));
+            if (res.IsFailure()) return res.Miss();
+
+            count -= toWrite;
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Discards all data written after <paramref name="position"/>. Later writes continue from that position.
+    /// </summary>
+    /// <remarks>If the position is in a batch that has already been written to the destination,
+    /// the start of its block is read back from the destination so the block can be hashed again.</remarks>
+    public Result Rewind(long position)
+    {
+        if (position < 0 || position > Position)
+            return ResultFs.OutOfRange.Log();
+
+        Result res = CompleteAllBatches();
+        if (res.IsFailure()) return res.Miss();
+
+        Batch batch = _batches[_currentBatch];
+
+        if (position < batch.Offset)
+        {
+            long blockOffset = Alignment.AlignDown(position, (uint)_blockSize);
+            int length = (int)(position - blockOffset);
+
+            batch.Buffer ??= ArrayPool<byte>.Shared.Rent(BatchSize);
+
+            res = _destination.Read(blockOffset, batch.Buffer.AsSpan(0, length));
+            if (res.IsFailure()) return res.Miss();
+
+            batch.Offset = blockOffset;
+        }
+
+        batch.Length = (int)(position - batch.Offset);
+        Position = position;
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Overwrites data that has already been written. The affected blocks are hashed again
+    /// when the image is finished.
+    /// </summary>
+    public Result Patch(long offset, ReadOnlySpan<byte> source)
+    {
+        if (offset < 0 || offset + source.Length > Position)
+            return ResultFs.OutOfRange.Log();
+
+        Batch batch = _batches[_currentBatch];
+
+        // Data in the current batch hasn't been written or hashed yet
+        if (offset + source.Length > batch.Offset)
+        {
+            int skip = (int)Math.Max(batch.Offset - offset, 0);
+            source.Slice(skip).CopyTo(batch.Buffer.AsSpan((int)(offset + skip - batch.Offset)));
+            source = source.Slice(0, skip);
+        }
+
+        if (source.IsEmpty)
+            return Result.Success;
+
+        Result res = _destination.Write(offset, source);
+        if (res.IsFailure()) return res.Miss();
+
+        for (long block = offset >> _blockSizePower; block <= (offset + source.Length - 1) >> _blockSizePower; block++)
+        {
+            _patchedBlocks.Add(block);
+        }
+
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Writes any remaining data and builds the hash levels.
+    /// </summary>
+    /// <param name="image">If successful, the completed image.</param>
+    public Result Finish(out HierarchicalIntegrityImage image)
+    {
+        image = null;
+
+        if (_batches[_currentBatch].Length != 0)
+        {
+            Result res = SubmitBatch();
+            if (res.IsFailure()) return res.Miss();
+        }
+
+        Result rc = CompleteAllBatches();
+        if (rc.IsFailure()) return rc.Miss();
+
+        rc = RehashPatchedBlocks();
+        if (rc.IsFailure()) return rc.Miss();
+
+        long dataSize = Position;
+        long dataBlockCount = BitUtil.DivideUp(dataSize, _blockSize);
+
+        // Index 0 is the level just below the master hash
+        var levels = new byte[HashLevelCount][];
+        levels[HashLevelCount - 1] = _dataHashes.AsSpan(0, (int)(dataBlockCount * Sha256.DigestSize)).ToArray();
+
+        for (int i = HashLevelCount - 2; i >= 0; i--)
+        {
+            levels[i] = HashLevel(levels[i + 1]);
+        }
+
+        byte[] masterHash = HashLevel(levels[0]);
+
+        var header = new IvfcHeader
+        {
+            Magic = "IVFC",
+            Version = IvfcVersion,
+            MasterHashSize = masterHash.Length,
+            NumLevels = HashLevelCount + 2,
+            SaltSource = new byte[0x20],
+            MasterHash = masterHash
+        };
+
+        long levelOffset = 0;
+
+        for (int i = 0; i < header.LevelHeaders.Length; i++)
+        {
+            long levelSize = i < HashLevelCount ? levels[i].Length : dataSize;
+
+            header.LevelHeaders[i] = new IvfcLevelHeader
+            {
+                Offset = levelOffset,
+                Size = levelSize,
+                BlockSizePower = _blockSizePower
+            };
+
+            levelOffset = Alignment.AlignUp(levelOffset + levelSize, (uint)_blockSize);
+        }
+
+        byte[] hashData = new byte[header.LevelHeaders[HashLevelCount].Offset];
+
+        for (int i = 0; i < HashLevelCount; i++)
+        {
+            levels[i].CopyTo(hashData.AsSpan((int)header.LevelHeaders[i].Offset));
+        }
+
+        image = new HierarchicalIntegrityImage(header, new MemoryStorage(hashData),
+            new SubStorage(_destination, 0, dataSize));
+
+        return Result.Success;
+    }
+
+    public void Dispose()
+    {
+        // The batch buffers can't be returned until nothing is hashing them
+        var hashTasks = new List<Task>(_batches.Length);
+
+        foreach (Batch batch in _batches)
+        {
+            hashTasks.Add(batch.HashTask);
+            batch.HashTask = null;
+        }
+
+        try
+        {
+            ParallelUtils.WaitAll(hashTasks);
+        }
+        finally
+        {
+            foreach (Batch batch in _batches)
+            {
+                if (batch.Buffer is not null)
+                {
+                    ArrayPool<byte>.Shared.Return(batch.Buffer);
+                    batch.Buffer = null;
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Writes the current batch to the destination, starts hashing it and moves to the next batch.
+    /// </summary>
+    private Result SubmitBatch()
+    {
+        Batch batch = _batches[_currentBatch];
+
+        if (batch.Offset + batch.Length > _destinationSize)
+            return ResultFs.OutOfRange.Log();
+
+        Result res = _destination.Write(batch.Offset, batch.Buffer.AsSpan(0, batch.Length));
+        if (res.IsFailure()) return res.Miss();
+
+        // Only the final batch can end with a partial block
+        int hashedSize = Alignment.AlignUp(batch.Length, (uint)_blockSize);
+        batch.Buffer.AsSpan(batch.Length, hashedSize - batch.Length).Clear();
+
+        if (_hashInParallel)
+        {
+            batch.HashTask = Task.Run(() => HashBatch(batch, hashedSize));
+        }
+        else
+        {
+            HashBatch(batch, hashedSize);
+        }
+
+        long nextOffset = batch.Offset + batch.Length;
+
+        _currentBatch = (_currentBatch + 1) % _batches.Length;
+        Batch nextBatch = _batches[_currentBatch];
+
+        res = CompleteBatch(nextBatch);
+        if (res.IsFailure()) return res.Miss();
+
+        nextBatch.Offset = nextOffset;
+        nextBatch.Length = 0;
+
+        return Result.Success;
+    }
+
+    private void HashBatch(Batch batch, int hashedSize)
+    {
+        Sha256.GenerateSha256Hashes(ReadOnlySpan<byte>.Empty, batch.Buffer.AsSpan(0, hashedSize), _blockSize,
+            batch.Hashes, Sha256.IsMultiBufferPreferred());
+
+        batch.HashedSize = hashedSize;
+    }
+
+    /// <summary>
+    /// Waits for a submitted batch to be hashed and copies its hashes to the data level hashes.
+    /// </summary>
+    private Result CompleteBatch(Batch batch)
+    {
+        if (batch.HashTask is not null)
+        {
+            try
+            {
+                ParallelUtils.WaitAll([batch.HashTask]);
+            }
+            finally
+            {
+                batch.HashTask = null;
+            }
+        }
+
+        if (batch.HashedSize == 0)
+            return Result.Success;
+
+        long firstBlock = batch.Offset >> _blockSizePower;
+        int hashesSize = batch.HashedSize / _blockSize * Sha256.DigestSize;
+        long requiredSize = firstBlock * Sha256.DigestSize + hashesSize;
+
+        if (requiredSize > _dataHashes.Length)
+        {
+            if (requiredSize > Array.MaxLength)
+                return ResultFs.OutOfRange.Log();
+
+            Array.Resize(ref _dataHashes, (int)Math.Min(Math.Max(requiredSize, _dataHashes.Length * 2L), Array.MaxLength));
+        }
+
+        batch.Hashes.AsSpan(0, hashesSize).CopyTo(_dataHashes.AsSpan((int)(firstBlock * Sha256.DigestSize)));
+        batch.HashedSize = 0;
+
+        return Result.Success;
+    }
+
+    private Result CompleteAllBatches()
+    {
+        for (int i = 1; i <= _batches.Length; i++)
+        {
+            // Complete the batches in the order they were submitted
+            Result res = CompleteBatch(_batches[(_currentBatch + i) % _batches.Length]);
+            if (res.IsFailure()) return res.Miss();
+        }
+
+        return Result.Success;
+    }
+
+    private Result RehashPatchedBlocks()
+    {
+        using var block = new RentedArray<byte>(_blockSize);
+
+        foreach (long blockIndex in _patchedBlocks)
+        {
+            long offset = blockIndex << _blockSizePower;
+            if (offset >= Position)
+                break;
+
+            int length = (int)Math.Min(_blockSize, Position - offset);
+
+            Result res = _destination.Read(offset, block.Span.Slice(0, length));
+            if (res.IsFailure()) return res.Miss();
+
+            block.Span.Slice(length).Clear();
+
+            Sha256.GenerateSha256Hash(block.Span,
+                _dataHashes.AsSpan((int)(blockIndex * Sha256.DigestSize), Sha256.DigestSize));
+        }
+
+        _patchedBlocks.Clear();
+        return Result.Success;
+    }
+
+    /// <summary>
+    /// Calculates the hashes of each block of a level, padding the final block with zeros.
+    /// </summary>
+    private byte[] HashLevel(ReadOnlySpan<byte> level)
+    {
+        int blockCount = Math.Max((int)BitUtil.DivideUp(level.Length, _blockSize), 1);
+        byte[] hashes = new byte[blockCount * Sha256.DigestSize];
+
+        int fullBlocksSize = level.Length / _blockSize * _blockSize;
+        Sha256.GenerateSha256Hashes(level.Slice(0, fullBlocksSize), _blockSize, hashes);
+
+        if (fullBlocksSize != level.Length || level.IsEmpty)
+        {
+            using var lastBlock = new RentedArray<byte>(_blockSize);
+            lastBlock.Span.Clear();
+            level.Slice(fullBlocksSize).CopyTo(lastBlock.Span);
+
+            Sha256.GenerateSha256Hash(lastBlock.Span, hashes.AsSpan(hashes.Length - Sha256.DigestSize));
+        }
+
+        return hashes;
+    }
+
+    private sealed class Batch
+    {
+        public byte[] Buffer;
+        public readonly byte[] Hashes;
+        public long Offset;
+        public int Length;
+        public int HashedSize;
+        public Task HashTask;
+
+        public Batch(int hashesSize)
+        {
+            Hashes = new byte[hashesSize];
+        }
+    }
+}
+
+/// <summary>
+/// A hierarchical integrity image created by a <see cref="HierarchicalIntegrityImageWriter"/>.
+/// </summary>
+public class HierarchicalIntegrityImage
+{
+    /// <summary>The header describing the location of each level in <see cref="Storage"/>.</summary>
+    public IvfcHeader Header { get; }
+
+    /// <summary>The hash levels, laid out at the offsets in <see cref="Header"/>.</summary>
+    public IStorage HashStorage { get; }
+
+    /// <summary>The data level.</summary>
+    public IStorage DataStorage { get; }
+
+    /// <summary>The hash levels followed by the data level.</summary>
+    public IStorage Storage { get; }
+
+    public HierarchicalIntegrityImage(IvfcHeader header, IStorage hashStorage, IStorage dataStorage)
+    {
+        Header = header;
+        HashStorage = hashStorage;
+        DataStorage = dataStorage;
+        Storage = new ConcatenationStorage(new List<IStorage> { hashStorage, dataStorage }, true);
+    }
+
+    /// <summary>
+    /// Opens a <see cref="HierarchicalIntegrityVerificationStorage"/> that verifies <see cref="Storage"/>
+    /// against the master hash.
+    /// </summary>
+    public HierarchicalIntegrityVerificationStorage OpenVerificationStorage(IntegrityCheckLevel integrityCheckLevel)
+    {
+        return new HierarchicalIntegrityVerificationStorage(Header, new MemoryStorage(Header.MasterHash), Storage,
+            IntegrityStorageType.RomFs, integrityCheckLevel, true);
+    }
+}
@@ -3,6 +3,8 @@ using System.Collections.Generic;
 using System.IO;
 using System.Security.Cryptography;
 using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Fs;
 using LibHac.Util;
@@ -103,6 +105,12 @@ public class HierarchicalIntegrityVerificationStorage : IStorage
         return DataLevel.Read(offset, destination);
     }
 
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        return DataLevel.ReadAsync(offset, destination, cancellationToken);
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         return DataLevel.Write(offset, source);
@@ -182,6 +190,85 @@ public class HierarchicalIntegrityVerificationStorage : IStorage
         return result;
     }
 
+    /// <summary>
+    /// Checks the hashes of all unchecked blocks in every level using multiple threads and returns the
+    /// <see cref="Validity"/> of the data. Each level is split into ranges of blocks which are hashed
+    /// concurrently, starting with the level closest to the master hash.
+    /// </summary>
+    /// <remarks>Every block in a level is checked before the result of that level is evaluated,
+    /// so the returned value and the contents of <see cref="LevelValidities"/> don't depend on
+    /// the number of threads used.</remarks>
+    /// <param name="returnOnError">If <see langword="true"/>, return without checking any lower levels
+    /// after a level containing an invalid block is found.</param>
+    /// <param name="threadCount">The maximum number of threads to use. A value of 1 or less will
+    /// check every level on the calling thread.</param>
+    /// <param name="logger">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    /// <returns>The <see cref="Validity"/> of the data.</returns>
+    public Validity Validate(bool returnOnError, int threadCount, IProgressReport logger = null)
+    {
+        threadCount = Math.Max(threadCount, 1);
+
+        long totalBlocks = 0;
+
+        foreach (IntegrityVerificationStorage storage in IntegrityStorages)
+        {
+            totalBlocks += storage.SectorCount;
+        }
+
+        var result = Validity.Valid;
+
+        logger?.SetTotal(totalBlocks);
+
+        foreach (IntegrityVerificationStorage storage in IntegrityStorages)
+        {
+            Validity levelValidity = ValidateLevelParallel(storage, threadCount, logger);
+
+            if (levelValidity == Validity.Invalid)
+            {
+                result = Validity.Invalid;
+                if (returnOnError) break;
+            }
+        }
+
+        logger?.SetTotal(0);
+        return result;
+    }
+
+    private static Validity ValidateLevelParallel(IntegrityVerificationStorage storage, int threadCount,
+        IProgressReport logger)
+    {
+        int blockCount = storage.SectorCount;
+        int blocksPerChunk = Math.Max(ParallelValidationChunkSize / storage.SectorSize, 1);
+        int chunkCount = (int)BitUtil.DivideUp(blockCount, blocksPerChunk);
+
+        int nextChunk = -1;
+        bool isInvalid = false;
+
+        void ValidateChunks()
+        {
+            using var buffer = new RentedArray<byte>(blocksPerChunk * storage.SectorSize);
+
+            int chunk;
+            while ((chunk = Interlocked.Increment(ref nextChunk)) < chunkCount)
+            {
+                int startBlock = chunk * blocksPerChunk;
+                int count = Math.Min(blocksPerChunk, blockCount - startBlock);
+
+                if (storage.ValidateBlocks(startBlock, count, buffer.Span) == Validity.Invalid)
+                {
+                    Volatile.Write(ref isInvalid, true);
+                }
+
+                logger?.ReportAdd(count);
+            }
+        }
+
+        // Each worker claims chunks until none are left
+        ParallelUtils.For(Math.Min(threadCount, chunkCount), threadCount, _ => ValidateChunks());
+
+        return isInvalid ? Validity.Invalid : Validity.Valid;
+    }
+
     public void FsTrim()
     {
         foreach (IntegrityVerificationStorage level in IntegrityStorages)
@@ -190,6 +277,9 @@ public class HierarchicalIntegrityVerificationStorage : IStorage
         }
     }
 
+    // The amount of data each worker reads and hashes at once when validating in parallel
+    private const int ParallelValidationChunkSize = 0x100000;
+
     private static readonly string[] SaltSources =
     [
         "HierarchicalIntegrityVerificationStorage::Master",
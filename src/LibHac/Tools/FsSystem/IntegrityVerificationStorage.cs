@@ -1,6 +1,8 @@
 ﻿using System;
 using System.Buffers;
 using System.IO;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Common;
 using LibHac.Crypto;
 using LibHac.Fs;
@@ -19,7 +21,7 @@ public class IntegrityVerificationStorage : SectorStorage
     private byte[] Salt { get; }
     private IntegrityStorageType Type { get; }
 
-    private readonly IHash _hash = Sha256.CreateSha256Generator();
+    private readonly Sha256Generator _hash = new Sha256Generator();
     private readonly object _locker = new object();
 
     public IntegrityVerificationStorage(IntegrityVerificationInfo info, IStorage hashStorage,
@@ -100,7 +102,12 @@ public class IntegrityVerificationStorage : SectorStorage
                 }
             }
 
-            byte[] hash = DoHash(dataBuffer, 0, bytesToHash);
+            Span<byte> hash = stackalloc byte[DigestSize];
+
+            lock (_locker)
+            {
+                DoHash(_hash, dataBuffer.AsSpan(0, bytesToHash), hash);
+            }
 
             Validity validity = Utilities.SpansEqual(hashBuffer, hash) ? Validity.Valid : Validity.Invalid;
             BlockValidities[blockIndex] = validity;
@@ -129,6 +136,33 @@ public class IntegrityVerificationStorage : SectorStorage
         return ReadImpl(offset, destination, integrityCheckLevel);
     }
 
+    /// <summary>
+    /// Reads a block asynchronously if its hash has already been checked. Blocks that still need to be
+    /// verified, and all blocks of save data, are read synchronously.
+    /// </summary>
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        if (cancellationToken.IsCancellationRequested)
+            return ValueTask.FromCanceled<Result>(cancellationToken);
+
+        int count = destination.Length;
+
+        if (count < 0 || count > SectorSize)
+            throw new ArgumentOutOfRangeException(nameof(destination), "Length is invalid.");
+
+        long blockIndex = offset / SectorSize;
+        Validity validity = BlockValidities[blockIndex];
+
+        bool canReadDirectly = Type != IntegrityStorageType.Save &&
+                               (validity == Validity.Valid || IntegrityCheckLevel == IntegrityCheckLevel.None);
+
+        if (!canReadDirectly)
+            return new ValueTask<Result>(ReadImpl(offset, destination.Span, IntegrityCheckLevel));
+
+        return BaseStorage.ReadAsync(offset, destination, cancellationToken);
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         long blockIndex = offset / SectorSize;
@@ -143,11 +177,16 @@ public class IntegrityVerificationStorage : SectorStorage
         try
         {
             source.CopyTo(dataBuffer);
-            byte[] hash = DoHash(dataBuffer, 0, toWrite);
+            Span<byte> hash = stackalloc byte[DigestSize];
+
+            lock (_locker)
+            {
+                DoHash(_hash, dataBuffer.AsSpan(0, toWrite), hash);
+            }
 
             if (Type == IntegrityStorageType.Save && source.IsZeros())
             {
-                Array.Clear(hash, 0, DigestSize);
+                hash.Clear();
             }
 
             BaseStorage.Write(offset, source);
@@ -163,29 +202,97 @@ public class IntegrityVerificationStorage : SectorStorage
         return Result.Success;
     }
 
-    private byte[] DoHash(byte[] buffer, int offset, int count)
+    /// <summary>
+    /// Checks the hashes of any unchecked blocks in the specified range and records the results
+    /// in <see cref="BlockValidities"/>. Calls that use non-overlapping block ranges may be run concurrently.
+    /// </summary>
+    /// <param name="startBlock">The index of the first block to check.</param>
+    /// <param name="blockCount">The number of blocks to check.</param>
+    /// <param name="dataBuffer">A work buffer at least <paramref name="blockCount"/> blocks long.</param>
+    /// <returns><see cref="Validity.Invalid"/> if any block in the range is invalid;
+    /// otherwise <see cref="Validity.Valid"/>.</returns>
+    internal Validity ValidateBlocks(int startBlock, int blockCount, Span<byte> dataBuffer)
     {
-        lock (_locker)
+        GetSize(out long storageSize).ThrowIfFailure();
+
+        long startOffset = (long)startBlock * SectorSize;
+        int readSize = (int)Math.Min(storageSize - startOffset, (long)blockCount * SectorSize);
+
+        using var expectedHashes = new RentedArray<byte>(blockCount * DigestSize);
+        HashStorage.Read((long)startBlock * DigestSize, expectedHashes.Span).ThrowIfFailure();
+        BaseStorage.Read(startOffset, dataBuffer.Slice(0, readSize)).ThrowIfFailure();
+
+        int hashedSize = readSize;
+
+        // Partition FS hashes don't pad out an incomplete block
+        if (readSize < blockCount * SectorSize && Type != IntegrityStorageType.PartitionFs)
+        {
+            // Pad out unused portion of the last block
+            hashedSize = blockCount * SectorSize;
+            dataBuffer.Slice(readSize, hashedSize - readSize).Clear();
+        }
+
+        // Hash every block in the range at once so multiple blocks can be hashed in parallel
+        using var actualHashes = new RentedArray<byte>(blockCount * DigestSize);
+        ReadOnlySpan<byte> salt = Type == IntegrityStorageType.Save ? Salt : default;
+
+        Sha256.GenerateSha256Hashes(salt, dataBuffer.Slice(0, hashedSize), SectorSize, actualHashes.Span,
+            Sha256.IsMultiBufferPreferred());
+
+        var result = Validity.Valid;
+
+        for (int i = 0; i < blockCount; i++)
         {
-            _hash.Initialize();
+            int blockIndex = startBlock + i;
 
-            if (Type == IntegrityStorageType.Save)
+            if (BlockValidities[blockIndex] == Validity.Unchecked)
             {
-                _hash.Update(Salt);
-            }
+                ReadOnlySpan<byte> expectedHash = expectedHashes.Span.Slice(i * DigestSize, DigestSize);
+
+                if (Type == IntegrityStorageType.Save && Utilities.IsZeros(expectedHash))
+                {
+                    BlockValidities[blockIndex] = Validity.Valid;
+                    continue;
+                }
 
-            _hash.Update(buffer.AsSpan(offset, count));
+                Span<byte> actualHash = actualHashes.Span.Slice(i * DigestSize, DigestSize);
 
-            byte[] hash = new byte[Sha256.DigestSize];
-            _hash.GetHash(hash);
+                if (Type == IntegrityStorageType.Save)
+                {
+                    // This bit is set on all save hashes
+                    actualHash[0x1F] |= 0b10000000;
+                }
 
-            if (Type == IntegrityStorageType.Save)
+                BlockValidities[blockIndex] = Utilities.SpansEqual(expectedHash, actualHash)
+                    ? Validity.Valid
+                    : Validity.Invalid;
+            }
+
+            if (BlockValidities[blockIndex] == Validity.Invalid)
             {
-                // This bit is set on all save hashes
-                hash[0x1F] |= 0b10000000;
+                result = Validity.Invalid;
             }
+        }
 
-            return hash;
+        return result;
+    }
+
+    private void DoHash(IHash hash, ReadOnlySpan<byte> data, Span<byte> outHash)
+    {
+        hash.Initialize();
+
+        if (Type == IntegrityStorageType.Save)
+        {
+            hash.Update(Salt);
+        }
+
+        hash.Update(data);
+        hash.GetHash(outHash);
+
+        if (Type == IntegrityStorageType.Save)
+        {
+            // This bit is set on all save hashes
+            outHash[0x1F] |= 0b10000000;
         }
     }
 
@@ -197,6 +304,12 @@ public class IntegrityVerificationStorage : SectorStorage
         return base.Flush();
     }
 
+    public override void Dispose()
+    {
+        _hash.Dispose();
+        base.Dispose();
+    }
+
     public void FsTrim()
     {
         if (Type != IntegrityStorageType.Save) return;
@@ -29,11 +29,54 @@ public class Nca
 
     public NcaHeader Header { get; }
 
-    public Nca(KeySet keySet, IStorage storage)
+    /// <summary>
+    /// The tracer that records the layers of the storages opened from this NCA,
+    /// or <see langword="null"/> if they aren't traced.
+    /// </summary>
+    public StorageTracer Tracer { get; }
+
+    /// <summary>
+    /// The maximum number of threads that compressed sections use to decompress the data covered by a read.
+    /// Only affects storages opened after it's set.
+    /// </summary>
+    public int DecompressionThreadCount { get; set; } = Environment.ProcessorCount;
+
+    /// <summary>
+    /// The thread pool used to split large reads of the storages and file systems opened from this NCA
+    /// across multiple threads, or <see langword="null"/> to do each read on the calling thread.
+    /// Only affects storages opened after it's set. The caller keeps ownership of the thread pool.
+    /// </summary>
+    public IThreadPool ReadThreadPool { get; set; }
+
+    /// <summary>
+    /// The cache used to keep the decoded nodes of this NCA's sparse, patch, AES-CTR-Ex and compression tables
+    /// in memory, or <see langword="null"/> to read each node from storage when it's needed.
+    /// May be shared with other NCAs. Only affects storages opened after it's set.
+    /// </summary>
+    public BucketTreeNodeCache NodeCache { get; set; }
+
+    public Nca(KeySet keySet, IStorage storage) : this(keySet, storage, (StorageTracer)null) { }
+
+    /// <summary>
+    /// Creates an <see cref="Nca"/> whose storage layers are recorded in <paramref name="tracer"/>.
+    /// </summary>
+    /// <param name="keySet">The keys used to decrypt the NCA.</param>
+    /// <param name="storage">The storage containing the NCA.</param>
+    /// <param name="tracer">The tracer to record the storage layers in.
+    /// May be <see langword="null"/> to disable tracing.</param>
+    public Nca(KeySet keySet, IStorage storage, StorageTracer tracer)
+    {
+        KeySet = keySet;
+        Tracer = tracer;
+        BaseStorage = tracer is null ? storage : tracer.WrapStorage(storage, "NCA file", leaveOpen: true);
+        Header = new NcaHeader(keySet, BaseStorage);
+    }
+
+    internal Nca(KeySet keySet, IStorage storage, NcaHeader header)
     {
         KeySet = keySet;
         BaseStorage = storage;
-        Header = new NcaHeader(keySet, storage);
+        Header = header;
     }
 
     public byte[] GetDecryptedKey(int index)
@@ -166,71 +209,153 @@ public class Nca
 
         BaseStorage.GetSize(out long ncaStorageSize).ThrowIfFailure();
 
+        if (Header.GetFsHeader(index).ExistsSparseLayer())
+        {
+            return Trace(OpenSparseStorage(index), "Sparse");
+        }
+
+        if (!IsSubRange(offset, size, ncaStorageSize))
+        {
+            throw new InvalidDataException(
+                $"Section offset (0x{offset:x}) and length (0x{size:x}) fall outside the total NCA length (0x{ncaStorageSize:x}).");
+        }
+
+        return BaseStorage.Slice(offset, size);
+    }
+
+    private SparseStorage OpenSparseStorage(int index)
+    {
+        long offset = Header.GetSectionStartOffset(index);
+        long size = Header.GetSectionSize(index);
+
+        BaseStorage.GetSize(out long ncaStorageSize).ThrowIfFailure();
+
         NcaFsHeader fsHeader = Header.GetFsHeader(index);
+        ref NcaSparseInfo sparseInfo = ref fsHeader.GetSparseInfo();
+
+        Unsafe.SkipInit(out BucketTree.Header header);
+        sparseInfo.MetaHeader[..].CopyTo(SpanHelpers.AsByteSpan(ref header));
+        header.Verify().ThrowIfFailure();
+
+        var sparseStorage = new SparseStorage();
 
-        if (fsHeader.ExistsSparseLayer())
+        if (header.EntryCount == 0)
         {
-            ref NcaSparseInfo sparseInfo = ref fsHeader.GetSparseInfo();
+            sparseStorage.Initialize(size);
+            return sparseStorage;
+        }
 
-            Unsafe.SkipInit(out BucketTree.Header header);
-            sparseInfo.MetaHeader[..].CopyTo(SpanHelpers.AsByteSpan(ref header));
-            header.Verify().ThrowIfFailure();
+        long dataSize = sparseInfo.GetPhysicalSize();
 
-            var sparseStorage = new SparseStorage();
+        if (!IsSubRange(sparseInfo.PhysicalOffset, dataSize, ncaStorageSize))
+        {
+            throw new InvalidDataException(
+                $"Section offset (0x{offset:x}) and length (0x{size:x}) fall outside the total NCA length (0x{ncaStorageSize:x}).");
+        }
 
-            if (header.EntryCount == 0)
-            {
-                sparseStorage.Initialize(size);
-            }
-            else
-            {
-                long dataSize = sparseInfo.GetPhysicalSize();
+        IStorage baseStorage = BaseStorage.Slice(sparseInfo.PhysicalOffset, dataSize);
+        baseStorage.GetSize(out long baseStorageSize).ThrowIfFailure();
 
-                if (!IsSubRange(sparseInfo.PhysicalOffset, dataSize, ncaStorageSize))
-                {
-                    throw new InvalidDataException(
-                        $"Section offset (0x{offset:x}) and length (0x{size:x}) fall outside the total NCA length (0x{ncaStorageSize:x}).");
-                }
+        long metaOffset = sparseInfo.MetaOffset;
+        long metaSize = sparseInfo.MetaSize;
 
-                IStorage baseStorage = BaseStorage.Slice(sparseInfo.PhysicalOffset, dataSize);
-                baseStorage.GetSize(out long baseStorageSize).ThrowIfFailure();
+        if (metaOffset - sparseInfo.PhysicalOffset + metaSize > baseStorageSize)
+            ResultFs.NcaBaseStorageOutOfRangeB.Value.ThrowIfFailure();
 
-                long metaOffset = sparseInfo.MetaOffset;
-                long metaSize = sparseInfo.MetaSize;
+        IStorage metaStorageEncrypted = baseStorage.Slice(metaOffset, metaSize);
 
-                if (metaOffset - sparseInfo.PhysicalOffset + metaSize > baseStorageSize)
-                    ResultFs.NcaBaseStorageOutOfRangeB.Value.ThrowIfFailure();
+        ulong upperCounter = sparseInfo.MakeAesCtrUpperIv(new NcaAesCtrUpperIv(fsHeader.Counter)).Value;
+        IStorage metaStorage = OpenAesCtrStorage(metaStorageEncrypted, index, sparseInfo.PhysicalOffset + metaOffset, upperCounter);
 
-                IStorage metaStorageEncrypted = baseStorage.Slice(metaOffset, metaSize);
+        long nodeOffset = 0;
+        long nodeSize = IndirectStorage.QueryNodeStorageSize(header.EntryCount);
+        // ReSharper disable once UselessBinaryOperation
+        long entryOffset = nodeOffset + nodeSize;
+        long entrySize = IndirectStorage.QueryEntryStorageSize(header.EntryCount);
 
-                ulong upperCounter = sparseInfo.MakeAesCtrUpperIv(new NcaAesCtrUpperIv(fsHeader.Counter)).Value;
-                IStorage metaStorage = OpenAesCtrStorage(metaStorageEncrypted, index, sparseInfo.PhysicalOffset + metaOffset, upperCounter);
+        using var nodeStorage = new ValueSubStorage(metaStorage, nodeOffset, nodeSize);
+        using var entryStorage = new ValueSubStorage(metaStorage, entryOffset, entrySize);
 
-                long nodeOffset = 0;
-                long nodeSize = IndirectStorage.QueryNodeStorageSize(header.EntryCount);
-                // ReSharper disable once UselessBinaryOperation
-                long entryOffset = nodeOffset + nodeSize;
-                long entrySize = IndirectStorage.QueryEntryStorageSize(header.EntryCount);
+        sparseStorage.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage, header.EntryCount).ThrowIfFailure();
+        sparseStorage.SetNodeCache(NodeCache);
 
-                using var nodeStorage = new ValueSubStorage(metaStorage, nodeOffset, nodeSize);
-                using var entryStorage = new ValueSubStorage(metaStorage, entryOffset, entrySize);
+        using var dataStorage = new ValueSubStorage(baseStorage, 0, sparseInfo.GetPhysicalSize());
+        sparseStorage.SetDataStorage(in dataStorage);
 
-                sparseStorage.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage, header.EntryCount).ThrowIfFailure();
+        return sparseStorage;
+    }
 
-                using var dataStorage = new ValueSubStorage(baseStorage, 0, sparseInfo.GetPhysicalSize());
-                sparseStorage.SetDataStorage(in dataStorage);
-            }
+    /// <summary>
+    /// Gets the ranges of a section that were removed by its sparse layer and aren't stored in the NCA.
+    /// </summary>
+    /// <remarks><para>The ranges are relative to the storage returned by <see cref="OpenRawStorage(int)"/>
+    /// if <paramref name="raw"/> is <see langword="true"/>, or to the storage returned by
+    /// <see cref="OpenStorage(int, IntegrityCheckLevel)"/> otherwise. Nothing is added if the section has
+    /// no sparse layer, or if the opened storage doesn't map linearly onto the sparse layer
+    /// because the section is compressed.</para>
+    /// <para>The removed ranges are read as the decryption of zeros, so they don't hold any of the section's
+    /// data and can be skipped when copying it.</para>
+    /// <para>LibHac addition.</para></remarks>
+    /// <param name="index">The index of the section.</param>
+    /// <param name="raw">Whether the ranges should be relative to the raw section storage.</param>
+    /// <param name="outRanges">The list the ranges will be added to, in order of their offsets.</param>
+    public void GetSparseZeroRanges(int index, bool raw, List<(long Offset, long Size)> outRanges)
+    {
+        if (!SectionExists(index)) throw new ArgumentException(string.Format(Messages.NcaSectionMissing, index), nameof(index));
 
-            return sparseStorage;
+        NcaFsHeader fsHeader = GetFsHeader(index);
+
+        if (Header.IsNca0() || !fsHeader.ExistsSparseLayer())
+            return;
+
+        // Get the range of the raw section that the opened storage reads from
+        long dataOffset = 0;
+        long dataSize = long.MaxValue;
+
+        if (!raw)
+        {
+            if (fsHeader.ExistsCompressionLayer())
+                return;
+
+            if (fsHeader.EncryptionType == NcaEncryptionType.AesCtrEx)
+            {
+                dataSize = fsHeader.GetPatchInfo().RelocationTreeOffset;
+            }
+            else if (fsHeader.HashType == NcaHashType.Sha256)
+            {
+                NcaFsIntegrityInfoSha256 info = fsHeader.GetIntegrityInfoSha256();
+                dataOffset = info.GetLevelOffset(info.LevelCount - 1);
+                dataSize = info.GetLevelSize(info.LevelCount - 1);
+            }
+            else if (fsHeader.HashType == NcaHashType.Ivfc)
+            {
+                NcaFsIntegrityInfoIvfc info = fsHeader.GetIntegrityInfoIvfc();
+                dataOffset = info.GetLevelOffset(info.LevelCount - 2);
+                dataSize = info.GetLevelSize(info.LevelCount - 2);
+            }
+            else
+            {
+                return;
+            }
         }
 
-        if (!IsSubRange(offset, size, ncaStorageSize))
+        var sparseRanges = new List<(long Offset, long Size)>();
+
+        using (SparseStorage sparseStorage = OpenSparseStorage(index))
         {
-            throw new InvalidDataException(
-                $"Section offset (0x{offset:x}) and length (0x{size:x}) fall outside the total NCA length (0x{ncaStorageSize:x}).");
+            sparseStorage.GetZeroRanges(sparseRanges).ThrowIfFailure();
         }
 
-        return BaseStorage.Slice(offset, size);
+        long dataEnd = dataSize == long.MaxValue ? long.MaxValue : dataOffset + dataSize;
+
+        foreach ((long rangeOffset, long rangeSize) in sparseRanges)
+        {
+            long start = Math.Max(rangeOffset, dataOffset);
+            long end = Math.Min(rangeOffset + rangeSize, dataEnd);
+
+            if (start < end)
+                outRanges.Add((start - dataOffset, end - start));
+        }
     }
 
     private IStorage OpenDecryptedStorage(IStorage baseStorage, int index, bool decrypting)
@@ -261,7 +386,8 @@ public class Nca
         byte[] key1 = GetContentKey(NcaKeyType.AesXts1);
 
         // todo: Handle xts for nca version 3
-        return new CachedStorage(new Aes128XtsStorage(baseStorage, key0, key1, sectorSize, true, decrypting), 2, true);
+        return Trace(new CachedStorage(new Aes128XtsStorage(baseStorage, key0, key1, sectorSize, true, decrypting), 2, true),
+            "AES-XTS");
     }
     // ReSharper restore UnusedParameter.Local
 
@@ -271,7 +397,7 @@ public class Nca
         byte[] counter = Aes128CtrStorage.CreateCounter(upperCounter, Header.GetSectionStartOffset(index));
 
         var aesStorage = new Aes128CtrStorage(baseStorage, key, offset, counter, true);
-        return new CachedStorage(aesStorage, 0x4000, 4, true);
+        return Trace(new CachedStorage(aesStorage, 0x4000, 4, true), "AES-CTR");
     }
 
     private IStorage OpenAesCtrExStorage(IStorage baseStorage, int index, bool decrypting)
@@ -317,10 +443,11 @@ public class Nca
         var tableNodeStorage = new SubStorage(cachedBucketTreeData, 0, nodeStorageSize);
         var tableEntryStorage = new SubStorage(cachedBucketTreeData, nodeStorageSize, entryStorageSize);
 
-        IStorage decStorage = new Aes128CtrExStorage(baseStorage.Slice(0, dataSize), tableNodeStorage,
+        var decStorage = new Aes128CtrExStorage(baseStorage.Slice(0, dataSize), tableNodeStorage,
             tableEntryStorage, treeHeader.EntryCount, key, counterEx, true);
+        decStorage.SetNodeCache(NodeCache);
 
-        return new ConcatenationStorage(new[] { decStorage, outputBucketTreeData }, true);
+        return Trace(new ConcatenationStorage(new[] { decStorage, outputBucketTreeData }, true), "AES-CTR-Ex");
     }
 
     public IStorage OpenRawStorage(int index, bool openEncrypted)
@@ -371,11 +498,12 @@ public class Nca
 
         var storage = new IndirectStorage();
         storage.Initialize(new ArrayPoolMemoryResource(), in tableNodeStorage, in tableEntryStorage, treeHeader.EntryCount).ThrowIfFailure();
+        storage.SetNodeCache(NodeCache);
 
         storage.SetStorage(0, baseStorage, 0, baseSize);
         storage.SetStorage(1, patchStorage, 0, patchSize);
 
-        return storage;
+        return Trace(storage, "Indirect (patch)");
     }
 
     public IStorage OpenStorage(int index, IntegrityCheckLevel integrityCheckLevel)
@@ -384,6 +512,16 @@ public class Nca
     }
 
     public IStorage OpenStorage(int index, IntegrityCheckLevel integrityCheckLevel, bool leaveCompressed)
+    {
+        return OpenAsynchronousAccessStorage(OpenSynchronousStorage(index, integrityCheckLevel, leaveCompressed));
+    }
+
+    /// <summary>
+    /// Opens a section's storage without the <see cref="AsynchronousAccessStorage"/> layer added when
+    /// <see cref="ReadThreadPool"/> is set, so callers can reach the verification storage below it.
+    /// </summary>
+    internal IStorage OpenSynchronousStorage(int index, IntegrityCheckLevel integrityCheckLevel,
+        bool leaveCompressed)
     {
         IStorage rawStorage = OpenRawStorage(index);
         NcaFsHeader header = GetFsHeader(index);
@@ -397,7 +535,7 @@ public class Nca
 
         if (!leaveCompressed && header.ExistsCompressionLayer())
         {
-            returnStorage = OpenCompressedStorage(header, returnStorage);
+            returnStorage = Trace(OpenCompressedStorage(header, returnStorage), "Compressed");
         }
 
         return returnStorage;
@@ -410,6 +548,17 @@ public class Nca
 
     public IStorage OpenStorageWithPatch(Nca patchNca, int index, IntegrityCheckLevel integrityCheckLevel,
         bool leaveCompressed)
+    {
+        return OpenAsynchronousAccessStorage(
+            OpenSynchronousStorageWithPatch(patchNca, index, integrityCheckLevel, leaveCompressed));
+    }
+
+    /// <summary>
+    /// Opens a patched section's storage without the <see cref="AsynchronousAccessStorage"/> layer added when
+    /// <see cref="ReadThreadPool"/> is set, so callers can reach the verification storage below it.
+    /// </summary>
+    internal IStorage OpenSynchronousStorageWithPatch(Nca patchNca, int index,
+        IntegrityCheckLevel integrityCheckLevel, bool leaveCompressed)
     {
         IStorage rawStorage = OpenRawStorageWithPatch(patchNca, index);
         NcaFsHeader header = patchNca.GetFsHeader(index);
@@ -418,13 +567,25 @@ public class Nca
 
         if (!leaveCompressed && header.ExistsCompressionLayer())
         {
-            returnStorage = OpenCompressedStorage(header, returnStorage);
+            returnStorage = Trace(OpenCompressedStorage(header, returnStorage), "Compressed");
         }
 
         return returnStorage;
     }
 
-    private static IStorage OpenCompressedStorage(NcaFsHeader header, IStorage baseStorage)
+    private IStorage OpenAsynchronousAccessStorage(IStorage baseStorage)
+    {
+        if (ReadThreadPool is null)
+            return baseStorage;
+
+        using var sharedBaseStorage = new SharedRef<IStorage>(baseStorage);
+        var asyncStorage = new AsynchronousAccessStorage(in sharedBaseStorage,
+            IAsynchronousAccessSplitter.GetDefaultAsynchronousAccessSplitter(), ReadThreadPool);
+
+        return Trace(asyncStorage, "Asynchronous access");
+    }
+
+    private IStorage OpenCompressedStorage(NcaFsHeader header, IStorage baseStorage)
     {
         ref NcaCompressionInfo compressionInfo = ref header.GetCompressionInfo();
 
@@ -446,9 +607,14 @@ public class Nca
 
         var compressedStorage = new CompressedStorage();
         compressedStorage.Initialize(new ArrayPoolMemoryResource(), in dataStorage, in nodeStorage, in entryStorage,
-            bucketTreeHeader.EntryCount).ThrowIfFailure();
+            bucketTreeHeader.EntryCount, CompressionConfiguration.GetNcaDecompressorFunction).ThrowIfFailure();
 
-        return new CachedStorage(compressedStorage, 0x4000, 32, true);
+        compressedStorage.DecompressionThreadCount = DecompressionThreadCount;
+        compressedStorage.SetNodeCache(NodeCache);
+
+        // CompressedStorage caches decompressed entries itself, so it isn't wrapped in a CachedStorage.
+        // Passing large reads straight through lets it decompress multiple entries in parallel.
+        return compressedStorage;
     }
 
     private IStorage CreateVerificationStorage(IntegrityCheckLevel integrityCheckLevel, NcaFsHeader header,
@@ -457,8 +623,8 @@ public class Nca
         switch (header.HashType)
         {
             case NcaHashType.Sha256:
-                return InitIvfcForPartitionFs(header.GetIntegrityInfoSha256(), rawStorage, integrityCheckLevel,
-                    true);
+                return Trace(InitIvfcForPartitionFs(header.GetIntegrityInfoSha256(), rawStorage,
+                    integrityCheckLevel, true), "SHA-256 verification");
             case NcaHashType.Ivfc:
                 // The FS header of an NCA0 section with IVFC verification must be manually skipped
                 if (Header.IsNca0())
@@ -466,7 +632,8 @@ public class Nca
                     rawStorage = rawStorage.Slice(0x200);
                 }
 
-                return InitIvfcForRomFs(header.GetIntegrityInfoIvfc(), rawStorage, integrityCheckLevel, true);
+                return Trace(InitIvfcForRomFs(header.GetIntegrityInfoIvfc(), rawStorage, integrityCheckLevel, true),
+                    "IVFC verification");
             default:
                 throw new ArgumentOutOfRangeException();
         }
@@ -495,14 +662,24 @@ public class Nca
             case NcaFormatType.Pfs0:
                 var pfs = new PartitionFileSystem();
                 pfs.Initialize(storage).ThrowIfFailure();
-                return pfs;
+                return Trace(pfs, "PartitionFS");
             case NcaFormatType.Romfs:
-                return new RomFsFileSystem(storage);
+                return Trace(new RomFsFileSystem(storage), "RomFS");
             default:
                 throw new ArgumentOutOfRangeException();
         }
     }
 
+    private IStorage Trace(IStorage storage, string layerName)
+    {
+        return Tracer is null ? storage : Tracer.WrapStorage(storage, layerName);
+    }
+
+    private IFileSystem Trace(IFileSystem fileSystem, string layerName)
+    {
+        return Tracer is null ? fileSystem : Tracer.WrapFileSystem(fileSystem, layerName);
+    }
+
     public IFileSystem OpenFileSystem(NcaSectionType type, IntegrityCheckLevel integrityCheckLevel)
     {
         return OpenFileSystem(GetSectionIndexFromType(type), integrityCheckLevel);
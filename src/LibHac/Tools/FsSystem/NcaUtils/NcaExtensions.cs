@@ -5,6 +5,7 @@ using LibHac.Common;
 using LibHac.Crypto;
 using LibHac.Fs;
 using LibHac.Fs.Fsa;
+using LibHac.FsSystem;
 
 namespace LibHac.Tools.FsSystem.NcaUtils;
 
@@ -135,13 +136,14 @@ public static class NcaExtensions
         return Validity.Valid;
     }
 
-    public static Validity VerifyNca(this Nca nca, IProgressReport logger = null, bool quiet = false)
+    public static Validity VerifyNca(this Nca nca, IProgressReport logger = null, bool quiet = false,
+        int threadCount = 1)
     {
         for (int i = 0; i < 3; i++)
         {
             if (nca.CanOpenSection(i))
             {
-                Validity sectionValidity = VerifySection(nca, i, logger, quiet);
+                Validity sectionValidity = VerifySection(nca, i, logger, quiet, threadCount);
 
                 if (sectionValidity == Validity.Invalid) return Validity.Invalid;
             }
@@ -150,29 +152,40 @@ public static class NcaExtensions
         return Validity.Valid;
     }
 
-    public static Validity VerifySection(this Nca nca, int index, IProgressReport logger = null, bool quiet = false)
+    public static Validity VerifySection(this Nca nca, int index, IProgressReport logger = null, bool quiet = false,
+        int threadCount = 1)
     {
         NcaFsHeader sect = nca.GetFsHeader(index);
         NcaHashType hashType = sect.HashType;
         if (hashType != NcaHashType.Sha256 && hashType != NcaHashType.Ivfc) return Validity.Unchecked;
 
-        var stream = nca.OpenStorage(index, IntegrityCheckLevel.IgnoreOnInvalid, true)
-            as HierarchicalIntegrityVerificationStorage;
+        var stream = StorageTracer.Unwrap(nca.OpenSynchronousStorage(index, IntegrityCheckLevel.IgnoreOnInvalid,
+            true)) as HierarchicalIntegrityVerificationStorage;
         if (stream == null) return Validity.Unchecked;
 
         if (!quiet) logger?.LogMessage($"Verifying section {index}...");
-        Validity validity = stream.Validate(true, logger);
 
-        return validity;
+        return ValidateSectionStorage(stream, threadCount, logger);
     }
 
-    public static Validity VerifyNca(this Nca nca, Nca patchNca, IProgressReport logger = null, bool quiet = false)
+    private static Validity ValidateSectionStorage(HierarchicalIntegrityVerificationStorage stream, int threadCount,
+        IProgressReport logger)
+    {
+        // A single thread keeps the data level scan that stops at the first invalid block
+        if (threadCount <= 1)
+            return stream.Validate(true, logger);
+
+        return stream.Validate(true, threadCount, logger);
+    }
+
+    public static Validity VerifyNca(this Nca nca, Nca patchNca, IProgressReport logger = null, bool quiet = false,
+        int threadCount = 1)
     {
         for (int i = 0; i < 3; i++)
         {
             if (patchNca.CanOpenSection(i))
             {
-                Validity sectionValidity = VerifySection(nca, patchNca, i, logger, quiet);
+                Validity sectionValidity = VerifySection(nca, patchNca, i, logger, quiet, threadCount);
 
                 if (sectionValidity == Validity.Invalid) return Validity.Invalid;
             }
@@ -181,19 +194,19 @@ public static class NcaExtensions
         return Validity.Valid;
     }
 
-    public static Validity VerifySection(this Nca nca, Nca patchNca, int index, IProgressReport logger = null, bool quiet = false)
+    public static Validity VerifySection(this Nca nca, Nca patchNca, int index, IProgressReport logger = null,
+        bool quiet = false, int threadCount = 1)
     {
         NcaFsHeader sect = nca.GetFsHeader(index);
         NcaHashType hashType = sect.HashType;
         if (hashType != NcaHashType.Sha256 && hashType != NcaHashType.Ivfc) return Validity.Unchecked;
 
-        var stream = nca.OpenStorageWithPatch(patchNca, index, IntegrityCheckLevel.IgnoreOnInvalid, true)
-            as HierarchicalIntegrityVerificationStorage;
+        var stream = StorageTracer.Unwrap(nca.OpenSynchronousStorageWithPatch(patchNca, index,
+            IntegrityCheckLevel.IgnoreOnInvalid, true)) as HierarchicalIntegrityVerificationStorage;
         if (stream == null) return Validity.Unchecked;
 
         if (!quiet) logger?.LogMessage($"Verifying section {index}...");
-        Validity validity = stream.Validate(true, logger);
 
-        return validity;
+        return ValidateSectionStorage(stream, threadCount, logger);
     }
 }
\ No newline at end of file
@@ -33,6 +33,24 @@ public struct NcaHeader
         FormatVersion = DetectNcaVersion(_header.Span);
     }
 
+    /// <summary>
+    /// Creates an <see cref="NcaHeader"/> from a header that has already been decrypted.
+    /// </summary>
+    /// <param name="decryptedHeader">The <see cref="HeaderSize"/>-byte decrypted header.
+    /// The header is copied, so the array may be reused by the caller.</param>
+    /// <param name="isEncrypted">Whether the NCA the header came from is encrypted.</param>
+    internal NcaHeader(byte[] decryptedHeader, bool isEncrypted)
+    {
+        if (decryptedHeader.Length != HeaderSize || !CheckIfDecrypted(decryptedHeader))
+            throw new InvalidDataException("The decrypted NCA header is not valid.");
+
+        _header = decryptedHeader.AsSpan().ToArray();
+        IsEncrypted = isEncrypted;
+        FormatVersion = DetectNcaVersion(_header.Span);
+    }
+
+    internal ReadOnlySpan<byte> GetDecryptedHeader() => _header.Span;
+
     private ref NcaHeaderStruct Header => ref Unsafe.As<byte, NcaHeaderStruct>(ref _header.Span[0]);
 
     public Span<byte> Signature1 => _header.Span.Slice(0, 0x100);
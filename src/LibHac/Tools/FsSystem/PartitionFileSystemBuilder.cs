@@ -67,9 +67,18 @@ public class PartitionFileSystemBuilder
         Entries.Add(entry);
     }
 
-    public IStorage Build(PartitionFileSystemType type)
+    public IStorage Build(PartitionFileSystemType type) => Build(type, 1);
+
+    /// <summary>
+    /// Builds the partition file system.
+    /// </summary>
+    /// <param name="type">The type of partition file system to build.</param>
+    /// <param name="threadCount">The maximum number of threads to use when hashing the files
+    /// of a <see cref="PartitionFileSystemType.Hashed"/> partition.</param>
+    /// <returns>The built partition file system.</returns>
+    public IStorage Build(PartitionFileSystemType type, int threadCount)
     {
-        byte[] meta = BuildMetaData(type);
+        byte[] meta = BuildMetaData(type, threadCount);
 
         var sources = new List<IStorage>();
         sources.Add(new MemoryStorage(meta));
@@ -79,9 +88,9 @@ public class PartitionFileSystemBuilder
         return new ConcatenationStorage(sources, true);
     }
 
-    private byte[] BuildMetaData(PartitionFileSystemType type)
+    private byte[] BuildMetaData(PartitionFileSystemType type, int threadCount)
     {
-        if (type == PartitionFileSystemType.Hashed) CalculateHashes();
+        if (type == PartitionFileSystemType.Hashed) CalculateHashes(threadCount);
 
         int entryTableSize = Entries.Count * GetEntrySize(type);
         int stringTableSize = CalcStringTableSize(HeaderSize + entryTableSize, type);
@@ -158,31 +167,29 @@ public class PartitionFileSystemBuilder
         }
     }
 
-    private void CalculateHashes()
+    private void CalculateHashes(int threadCount)
     {
-        IHash sha = Sha256.CreateSha256Generator();
+        // Each hash only covers data from its own file, so the files can be read and hashed in parallel
+        ParallelUtils.For(Entries.Count, threadCount, i => CalculateHash(Entries[i]));
+    }
 
-        foreach (Entry entry in Entries)
+    private static void CalculateHash(Entry entry)
+    {
+        if (entry.HashLength == 0)
         {
-            if (entry.HashLength == 0)
-            {
-                entry.HashLength = (int)Math.Min(DefaultHashTargetSize, entry.Length);
-            }
-
-            byte[] data = new byte[entry.HashLength];
-            entry.File.Read(out long bytesRead, entry.HashOffset, data);
-
-            if (bytesRead != entry.HashLength)
-            {
-                throw new ArgumentOutOfRangeException();
-            }
+            entry.HashLength = (int)Math.Min(DefaultHashTargetSize, entry.Length);
+        }
 
-            entry.Hash = new byte[Sha256.DigestSize];
+        byte[] data = new byte[entry.HashLength];
+        entry.File.Read(out long bytesRead, entry.HashOffset, data);
 
-            sha.Initialize();
-            sha.Update(data);
-            sha.GetHash(entry.Hash);
+        if (bytesRead != entry.HashLength)
+        {
+            throw new ArgumentOutOfRangeException();
         }
+
+        entry.Hash = new byte[Sha256.DigestSize];
+        Sha256.GenerateSha256Hash(data, entry.Hash);
     }
 
     public static int GetEntrySize(PartitionFileSystemType type)
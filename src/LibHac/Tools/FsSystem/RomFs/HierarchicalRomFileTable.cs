@@ -199,6 +199,65 @@ public class HierarchicalRomFileTable<T> where T : unmanaged
         return true;
     }
 
+    /// <summary>
+    /// Returns the next file in a directory and updates the enumerator's position
+    /// without allocating a string for the file's name.
+    /// </summary>
+    /// <param name="position">The current position of the directory enumerator.
+    /// This position will be updated when the method returns.</param>
+    /// <param name="info">When this method returns, contains the file's metadata.</param>
+    /// <param name="name">When this method returns, contains the file's UTF-8 name. Only valid until
+    /// the table is modified.</param>
+    /// <returns><see langword="true"/> if the next file was successfully returned.
+    /// <see langword="false"/> if there are no more files to enumerate.</returns>
+    internal bool FindNextFileEntry(ref FindPosition position, out T info, out ReadOnlySpan<byte> name)
+    {
+        if (position.NextFile == -1)
+        {
+            UnsafeHelpers.SkipParamInit(out info);
+            name = default;
+            return false;
+        }
+
+        ref FileRomEntry entry = ref FileTable.GetValueReference(position.NextFile, out Span<byte> nameBytes);
+        position.NextFile = entry.NextSibling;
+        info = entry.Info;
+        name = nameBytes;
+
+        return true;
+    }
+
+    /// <summary>
+    /// Returns the next child directory in a directory and updates the enumerator's position
+    /// without allocating a string for the directory's name.
+    /// </summary>
+    /// <param name="position">The current position of the directory enumerator.
+    /// This position will be updated when the method returns.</param>
+    /// <param name="childPosition">When this method returns, contains the initial position of an enumerator
+    /// for the child directory.</param>
+    /// <param name="name">When this method returns, contains the directory's UTF-8 name. Only valid until
+    /// the table is modified.</param>
+    /// <returns><see langword="true"/> if the next directory was successfully returned.
+    /// <see langword="false"/> if there are no more directories to enumerate.</returns>
+    internal bool FindNextDirectoryEntry(ref FindPosition position, out FindPosition childPosition,
+        out ReadOnlySpan<byte> name)
+    {
+        if (position.NextDirectory == -1)
+        {
+            UnsafeHelpers.SkipParamInit(out childPosition);
+            name = default;
+            return false;
+        }
+
+        ref DirectoryRomEntry entry =
+            ref DirectoryTable.GetValueReference(position.NextDirectory, out Span<byte> nameBytes);
+        position.NextDirectory = entry.NextSibling;
+        childPosition = entry.Pos;
+        name = nameBytes;
+
+        return true;
+    }
+
     /// <summary>
     /// Adds a file to the file table. If the file already exists
     /// its <see cref="RomFileInfo"/> will be updated.
@@ -1,7 +1,9 @@
 ﻿using System;
+using System.Buffers;
 using System.Collections.Generic;
 using System.IO;
 using System.Linq;
+using System.Security.Cryptography;
 using LibHac.Common;
 using LibHac.Fs;
 using LibHac.Fs.Fsa;
@@ -21,8 +23,10 @@ public class RomFsBuilder
     private const int FileAlignment = 0x10;
     private const int HeaderSize = 0x50;
     private const int HeaderWithPaddingSize = 0x200;
+    private const int CopyBufferSize = 0x100000;
 
     private List<IStorage> Sources { get; } = new List<IStorage>();
+    private List<FileSource> Files { get; } = new List<FileSource>();
     private HierarchicalRomFileTable<RomFileInfo> FileTable { get; } = new HierarchicalRomFileTable<RomFileInfo>();
     private long CurrentOffset { get; set; }
 
@@ -62,6 +66,7 @@ public class RomFsBuilder
 
         IStorage fileStorage = file.AsStorage();
         Sources.Add(fileStorage);
+        Files.Add(new FileSource(path, fileStorage, fileSize));
 
         long newOffset = CurrentOffset + fileSize;
         CurrentOffset = Alignment.AlignUp(newOffset, FileAlignment);
@@ -114,4 +119,151 @@ public class RomFsBuilder
             fileLength += table.Length;
         }
     }
+
+    /// <summary>
+    /// Returns the size of the RomFS produced by <see cref="Build"/>. A RomFS written by
+    /// <see cref="BuildWithIntegrity"/> is never larger than this.
+    /// </summary>
+    public long GetSize()
+    {
+        FileTable.TrimExcess();
+
+        return HeaderWithPaddingSize + CurrentOffset + FileTable.GetDirectoryBuckets().Length +
+               FileTable.GetDirectoryEntries().Length + FileTable.GetFileBuckets().Length +
+               FileTable.GetFileEntries().Length;
+    }
+
+    /// <summary>
+    /// Writes a RomFS containing all the currently added files to <paramref name="destination"/>
+    /// and builds the hierarchical integrity levels for it.
+    /// </summary>
+    /// <remarks><para>Each file is read once. Blocks of the RomFS are hashed on other threads
+    /// while later files are being read.</para>
+    /// <para>When deduplicating, a file with the same contents as an earlier file is given the earlier file's
+    /// data offset. Only files that are the same size as another file are hashed to find duplicates.
+    /// Because a duplicate isn't found until it has been read, its data is written and then discarded.</para></remarks>
+    /// <param name="destination">The storage to write the RomFS to. It must be at least
+    /// <see cref="GetSize"/> bytes long.</param>
+    /// <param name="deduplicate">If <see langword="true"/>, files with identical contents will share
+    /// a single copy of their data.</param>
+    /// <param name="threadCount">The maximum number of threads to use for hashing. A value of 1 or less
+    /// will hash the data on the calling thread.</param>
+    /// <returns>The integrity image. Its data level contains the RomFS.</returns>
+    public HierarchicalIntegrityImage BuildWithIntegrity(IStorage destination, bool deduplicate, int threadCount)
+    {
+        var fileTable = new HierarchicalRomFileTable<RomFileInfo>();
+        HashSet<long> duplicateSizes = deduplicate ? GetDuplicateFileSizes() : null;
+        var writtenFiles = new Dictionary<(long Size, string Hash), long>();
+
+        using var writer = new HierarchicalIntegrityImageWriter(destination, threadCount);
+        byte[] buffer = ArrayPool<byte>.Shared.Rent(CopyBufferSize);
+
+        try
+        {
+            writer.WriteZeros(HeaderWithPaddingSize).ThrowIfFailure();
+
+            foreach (FileSource file in Files)
+            {
+                long fileOffset = writer.Position - HeaderWithPaddingSize;
+                bool canBeDuplicate = duplicateSizes?.Contains(file.Size) == true;
+
+                using IncrementalHash contentHash =
+                    canBeDuplicate ? IncrementalHash.CreateHash(HashAlgorithmName.SHA256) : null;
+
+                for (long offset = 0; offset < file.Size; offset += CopyBufferSize)
+                {
+                    Span<byte> data = buffer.AsSpan(0, (int)Math.Min(CopyBufferSize, file.Size - offset));
+
+                    file.Storage.Read(offset, data).ThrowIfFailure();
+                    writer.Write(data).ThrowIfFailure();
+                    contentHash?.AppendData(data);
+                }
+
+                var fileInfo = new RomFileInfo { Offset = fileOffset, Length = file.Size };
+
+                if (canBeDuplicate)
+                {
+                    (long, string) key = (file.Size, Convert.ToHexString(contentHash.GetHashAndReset()));
+
+                    if (writtenFiles.TryGetValue(key, out long existingOffset))
+                    {
+                        writer.Rewind(HeaderWithPaddingSize + fileOffset).ThrowIfFailure();
+                        fileInfo.Offset = existingOffset;
+                    }
+                    else
+                    {
+                        writtenFiles.Add(key, fileOffset);
+                    }
+                }
+
+                if (fileInfo.Offset == fileOffset)
+                {
+                    writer.WriteZeros(Alignment.AlignUp(writer.Position, FileAlignment) - writer.Position)
+                        .ThrowIfFailure();
+                }
+
+                fileTable.AddFile(file.Path, ref fileInfo);
+            }
+
+            fileTable.TrimExcess();
+
+            byte[] header = new byte[HeaderSize];
+            var headerWriter = new BinaryWriter(new MemoryStream(header));
+
+            headerWriter.Write((long)HeaderSize);
+
+            WriteTable(fileTable.GetDirectoryBuckets());
+            WriteTable(fileTable.GetDirectoryEntries());
+            WriteTable(fileTable.GetFileBuckets());
+            WriteTable(fileTable.GetFileEntries());
+
+            headerWriter.Write((long)HeaderWithPaddingSize);
+
+            writer.Patch(0, header).ThrowIfFailure();
+            writer.Finish(out HierarchicalIntegrityImage image).ThrowIfFailure();
+
+            return image;
+
+            void WriteTable(byte[] table)
+            {
+                headerWriter.Write(writer.Position);
+                headerWriter.Write((long)table.Length);
+                writer.Write(table).ThrowIfFailure();
+            }
+        }
+        finally
+        {
+            ArrayPool<byte>.Shared.Return(buffer);
+        }
+    }
+
+    private HashSet<long> GetDuplicateFileSizes()
+    {
+        var seenSizes = new HashSet<long>();
+        var duplicateSizes = new HashSet<long>();
+
+        foreach (FileSource file in Files)
+        {
+            if (file.Size != 0 && !seenSizes.Add(file.Size))
+            {
+                duplicateSizes.Add(file.Size);
+            }
+        }
+
+        return duplicateSizes;
+    }
+
+    private class FileSource
+    {
+        public string Path { get; }
+        public IStorage Storage { get; }
+        public long Size { get; }
+
+        public FileSource(string path, IStorage storage, long size)
+        {
+            Path = path;
+            Storage = storage;
+            Size = size;
+        }
+    }
 }
\ No newline at end of file
@@ -85,4 +85,68 @@ public class RomFsDirectory : IDirectory
 
         return Result.Success;
     }
+}
+
+/// <summary>
+/// Enumerates a directory in a <see cref="RomFsPathIndex"/>.
+/// </summary>
+internal class RomFsIndexedDirectory : IDirectory
+{
+    private readonly RomFsPathIndex _index;
+    private readonly int _directoryIndex;
+    private readonly OpenDirectoryMode _mode;
+    private int _position;
+
+    public RomFsIndexedDirectory(RomFsPathIndex index, int directoryIndex, OpenDirectoryMode mode)
+    {
+        _index = index;
+        _directoryIndex = directoryIndex;
+        _mode = mode;
+    }
+
+    protected override Result DoRead(out long entriesRead, Span<DirectoryEntry> entryBuffer)
+    {
+        ReadOnlySpan<RomFsIndexEntry> children = _index.GetChildren(_directoryIndex);
+        int i = 0;
+
+        while (i < entryBuffer.Length && _position < children.Length)
+        {
+            ref readonly RomFsIndexEntry child = ref children[_position++];
+
+            if (!IsEntryIncluded(in child))
+                continue;
+
+            ref DirectoryEntry entry = ref entryBuffer[i++];
+
+            StringUtils.Copy(entry.Name, _index.GetName(in child));
+            entry.Name[PathTool.EntryNameLengthMax] = 0;
+
+            entry.Type = child.Type;
+            entry.Size = child.IsDirectory ? 0 : child.Size;
+        }
+
+        entriesRead = i;
+        return Result.Success;
+    }
+
+    protected override Result DoGetEntryCount(out long entryCount)
+    {
+        long count = 0;
+
+        foreach (ref readonly RomFsIndexEntry child in _index.GetChildren(_directoryIndex))
+        {
+            if (IsEntryIncluded(in child))
+                count++;
+        }
+
+        entryCount = count;
+        return Result.Success;
+    }
+
+    private bool IsEntryIncluded(in RomFsIndexEntry entry)
+    {
+        return entry.IsDirectory
+            ? _mode.HasFlag(OpenDirectoryMode.Directory)
+            : _mode.HasFlag(OpenDirectoryMode.File);
+    }
 }
\ No newline at end of file
@@ -12,6 +12,13 @@ public class RomFsFileSystem : IFileSystem
     public HierarchicalRomFileTable<RomFileInfo> FileTable { get; }
     private IStorage BaseStorage { get; }
     private SharedRef<IStorage> _baseStorageShared;
+    private readonly Lazy<RomFsPathIndex> _pathIndex;
+
+    /// <summary>
+    /// If <see langword="true"/>, paths are looked up using a <see cref="RomFsPathIndex"/> instead of
+    /// the RomFS's file table. The index is built the first time it's used.
+    /// </summary>
+    public bool UsePathIndex { get; set; }
 
     public RomFsFileSystem(IStorage storage)
     {
@@ -24,6 +31,7 @@ public class RomFsFileSystem : IFileSystem
         IStorage fileEntryTable = storage.Slice(Header.FileMetaTableOffset, Header.FileMetaTableSize);
 
         FileTable = new HierarchicalRomFileTable<RomFileInfo>(dirHashTable, dirEntryTable, fileHashTable, fileEntryTable);
+        _pathIndex = new Lazy<RomFsPathIndex>(() => RomFsPathIndex.Create(FileTable));
     }
 
     public RomFsFileSystem(ref readonly SharedRef<IStorage> storage) : this(storage.Get)
@@ -37,10 +45,30 @@ public class RomFsFileSystem : IFileSystem
         base.Dispose();
     }
 
+    /// <summary>
+    /// Gets the <see cref="RomFsPathIndex"/> for this file system, building it if needed.
+    /// </summary>
+    /// <returns>The path index.</returns>
+    public RomFsPathIndex GetPathIndex() => _pathIndex.Value;
+
+    private static ReadOnlySpan<byte> GetPathBytes(ref readonly Path path) =>
+        path.GetString().Slice(0, path.GetLength());
+
     protected override Result DoGetEntryType(out DirectoryEntryType entryType, ref readonly Path path)
     {
         UnsafeHelpers.SkipParamInit(out entryType);
 
+        if (UsePathIndex)
+        {
+            RomFsPathIndex index = GetPathIndex();
+
+            if (!index.TryGetEntry(GetPathBytes(in path), out RomFsIndexEntry entry))
+                return ResultFs.PathNotFound.Log();
+
+            entryType = entry.Type;
+            return Result.Success;
+        }
+
         if (FileTable.TryOpenFile(path.ToString(), out RomFileInfo _))
         {
             entryType = DirectoryEntryType.File;
@@ -64,6 +92,18 @@ public class RomFsFileSystem : IFileSystem
     protected override Result DoOpenDirectory(ref UniqueRef<IDirectory> outDirectory, ref readonly Path path,
         OpenDirectoryMode mode)
     {
+        if (UsePathIndex)
+        {
+            RomFsPathIndex index = GetPathIndex();
+            int entryIndex = index.FindEntry(GetPathBytes(in path));
+
+            if (entryIndex < 0 || !index.Entries[entryIndex].IsDirectory)
+                return ResultFs.PathNotFound.Log();
+
+            outDirectory.Reset(new RomFsIndexedDirectory(index, entryIndex, mode));
+            return Result.Success;
+        }
+
         if (!FileTable.TryOpenDirectory(path.ToString(), out FindPosition position))
         {
             return ResultFs.PathNotFound.Log();
@@ -75,7 +115,16 @@ public class RomFsFileSystem : IFileSystem
 
     protected override Result DoOpenFile(ref UniqueRef<IFile> outFile, ref readonly Path path, OpenMode mode)
     {
-        if (!FileTable.TryOpenFile(path.ToString(), out RomFileInfo info))
+        RomFileInfo info;
+
+        if (UsePathIndex)
+        {
+            if (!GetPathIndex().TryGetEntry(GetPathBytes(in path), out RomFsIndexEntry entry) || entry.IsDirectory)
+                return ResultFs.PathNotFound.Log();
+
+            info = new RomFileInfo { Offset = entry.Offset, Length = entry.Size };
+        }
+        else if (!FileTable.TryOpenFile(path.ToString(), out info))
         {
             return ResultFs.PathNotFound.Log();
         }
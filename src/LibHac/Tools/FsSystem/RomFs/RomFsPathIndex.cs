@@ -0,0 +1,255 @@
+﻿using System;
+using System.Buffers;
+using System.Collections.Generic;
+using System.Numerics;
+using System.Runtime.InteropServices;
+using LibHac.Fs;
+
+namespace LibHac.Tools.FsSystem.RomFs;
+
+/// <summary>
+/// An entry in a <see cref="RomFsPathIndex"/>.
+/// </summary>
+[StructLayout(LayoutKind.Sequential)]
+public readonly struct RomFsIndexEntry
+{
+    /// <summary>For files, the offset of the file's data from the start of the RomFS data section.</summary>
+    public readonly long Offset;
+    /// <summary>For files, the size of the file.</summary>
+    public readonly long Size;
+    /// <summary>For directories, the index of the directory's first child. Child directories come before
+    /// child files.</summary>
+    public readonly int FirstChild;
+    /// <summary>For directories, the number of child directories and files.</summary>
+    public readonly int ChildCount;
+    /// <summary>The index of the entry's parent directory. -1 for the root directory.</summary>
+    public readonly int Parent;
+    internal readonly int PathOffset;
+    internal readonly short PathLength;
+    internal readonly short NameLength;
+    public readonly DirectoryEntryType Type;
+
+    internal RomFsIndexEntry(DirectoryEntryType type, int parent, int pathOffset, int pathLength, int nameLength,
+        long offset, long size, int firstChild, int childCount)
+    {
+        Type = type;
+        Parent = parent;
+        PathOffset = pathOffset;
+        PathLength = (short)pathLength;
+        NameLength = (short)nameLength;
+        Offset = offset;
+        Size = size;
+        FirstChild = firstChild;
+        ChildCount = childCount;
+    }
+
+    public bool IsDirectory => Type == DirectoryEntryType.Directory;
+}
+
+/// <summary>
+/// An in-memory index that maps the full paths of every entry in a RomFS to the entry's metadata.
+/// </summary>
+/// <remarks><para>Looking up a path in a <see cref="HierarchicalRomFileTable{T}"/> hashes and searches for each
+/// component of the path separately. The index hashes the full path once and looks it up in a single open
+/// addressing table.</para>
+/// <para>Entries are stored in one array in breadth-first order so the children of each directory are contiguous.
+/// All paths are stored in one UTF-8 buffer. <see cref="Entries"/> can be used to enumerate the entire
+/// file system without allocating.</para></remarks>
+public class RomFsPathIndex
+{
+    private const int EmptyBucket = -1;
+
+    private readonly RomFsIndexEntry[] _entries;
+    private readonly byte[] _pathBuffer;
+    private readonly int[] _buckets;
+    private readonly uint[] _bucketHashes;
+    private readonly int _bucketMask;
+
+    /// <summary>All entries in the index in breadth-first order. The root directory is always the first entry.</summary>
+    public ReadOnlySpan<RomFsIndexEntry> Entries => _entries;
+
+    public int FileCount { get; }
+    public int DirectoryCount { get; }
+
+    private RomFsPathIndex(RomFsIndexEntry[] entries, byte[] pathBuffer, int fileCount)
+    {
+        _entries = entries;
+        _pathBuffer = pathBuffer;
+        FileCount = fileCount;
+        DirectoryCount = entries.Length - fileCount;
+
+        // Keep the table at most half full so probe sequences stay short
+        int bucketCount = (int)BitOperations.RoundUpToPowerOf2((uint)Math.Max(entries.Length * 2, 16));
+        _buckets = new int[bucketCount];
+        _bucketHashes = new uint[bucketCount];
+        _bucketMask = bucketCount - 1;
+
+        _buckets.AsSpan().Fill(EmptyBucket);
+
+        for (int i = 0; i < entries.Length; i++)
+        {
+            uint hash = GetHash(GetPath(i));
+            int bucket = (int)(hash & _bucketMask);
+
+            while (_buckets[bucket] != EmptyBucket)
+            {
+                bucket = (bucket + 1) & _bucketMask;
+            }
+
+            _buckets[bucket] = i;
+            _bucketHashes[bucket] = hash;
+        }
+    }
+
+    /// <summary>
+    /// Creates a <see cref="RomFsPathIndex"/> containing every entry in a file table.
+    /// </summary>
+    /// <param name="table">The file table to index.</param>
+    /// <returns>The created <see cref="RomFsPathIndex"/>.</returns>
+    public static RomFsPathIndex Create(HierarchicalRomFileTable<RomFileInfo> table)
+    {
+        if (!table.TryOpenDirectory("/", out FindPosition rootPosition))
+            throw new ArgumentException("The file table has no root directory.", nameof(table));
+
+        var entries = new List<RomFsIndexEntry>();
+        var positions = new List<FindPosition>();
+        var paths = new ArrayBufferWriter<byte>();
+        int fileCount = 0;
+
+        paths.GetSpan(1)[0] = StringTraits.DirectorySeparator;
+        paths.Advance(1);
+        entries.Add(new RomFsIndexEntry(DirectoryEntryType.Directory, -1, 0, 1, 0, 0, 0, 0, 0));
+        positions.Add(rootPosition);
+
+        // Children are added right after their siblings, so processing the directories in order
+        // produces a breadth-first layout with each directory's children stored contiguously.
+        for (int i = 0; i < entries.Count; i++)
+        {
+            RomFsIndexEntry parent = entries[i];
+            if (!parent.IsDirectory)
+                continue;
+
+            FindPosition position = positions[i];
+            int firstChild = entries.Count;
+
+            while (table.FindNextDirectoryEntry(ref position, out FindPosition childPosition,
+                       out ReadOnlySpan<byte> name))
+            {
+                AddEntry(DirectoryEntryType.Directory, i, name, default);
+                positions.Add(childPosition);
+            }
+
+            while (table.FindNextFileEntry(ref position, out RomFileInfo info, out ReadOnlySpan<byte> name))
+            {
+                AddEntry(DirectoryEntryType.File, i, name, info);
+                positions.Add(default);
+                fileCount++;
+            }
+
+            entries[i] = new RomFsIndexEntry(parent.Type, parent.Parent, parent.PathOffset, parent.PathLength,
+                parent.NameLength, 0, 0, firstChild, entries.Count - firstChild);
+        }
+
+        return new RomFsPathIndex(entries.ToArray(), paths.WrittenSpan.ToArray(), fileCount);
+
+        void AddEntry(DirectoryEntryType type, int parentIndex, ReadOnlySpan<byte> name, RomFileInfo info)
+        {
+            RomFsIndexEntry parent = entries[parentIndex];
+            int pathOffset = paths.WrittenCount;
+
+            // Don't add a second separator after the root directory's path
+            ReadOnlySpan<byte> parentPath = parentIndex == 0
+                ? ReadOnlySpan<byte>.Empty
+                : paths.WrittenSpan.Slice(parent.PathOffset, parent.PathLength);
+
+            int pathLength = parentPath.Length + 1 + name.Length;
+
+            if (pathLength > short.MaxValue)
+                throw new NotSupportedException("RomFS paths longer than 32767 bytes are not supported.");
+
+            // The parent path remains valid if getting the span reallocates the buffer
+            Span<byte> pathBuffer = paths.GetSpan(pathLength);
+            parentPath.CopyTo(pathBuffer);
+            pathBuffer[parentPath.Length] = StringTraits.DirectorySeparator;
+            name.CopyTo(pathBuffer.Slice(parentPath.Length + 1));
+            paths.Advance(pathLength);
+
+            entries.Add(new RomFsIndexEntry(type, parentIndex, pathOffset, pathLength, name.Length, info.Offset,
+                info.Length, 0, 0));
+        }
+    }
+
+    /// <summary>
+    /// Finds the entry with the specified path.
+    /// </summary>
+    /// <param name="path">The normalized UTF-8 path of the entry, without a null terminator.</param>
+    /// <returns>The index of the entry in <see cref="Entries"/>, or -1 if the path doesn't exist.</returns>
+    public int FindEntry(ReadOnlySpan<byte> path)
+    {
+        uint hash = GetHash(path);
+        int bucket = (int)(hash & _bucketMask);
+
+        while (true)
+        {
+            int entryIndex = _buckets[bucket];
+
+            if (entryIndex == EmptyBucket)
+                return -1;
+
+            if (_bucketHashes[bucket] == hash && GetPath(entryIndex).SequenceEqual(path))
+                return entryIndex;
+
+            bucket = (bucket + 1) & _bucketMask;
+        }
+    }
+
+    /// <summary>
+    /// Finds the entry with the specified path.
+    /// </summary>
+    /// <param name="path">The normalized UTF-8 path of the entry, without a null terminator.</param>
+    /// <param name="entry">If the path exists, contains the entry when this method returns.</param>
+    /// <returns><see langword="true"/> if the path exists; otherwise <see langword="false"/>.</returns>
+    public bool TryGetEntry(ReadOnlySpan<byte> path, out RomFsIndexEntry entry)
+    {
+        int index = FindEntry(path);
+
+        if (index < 0)
+        {
+            entry = default;
+            return false;
+        }
+
+        entry = _entries[index];
+        return true;
+    }
+
+    /// <summary>
+    /// Gets the child entries of a directory. Child directories come before child files.
+    /// </summary>
+    /// <param name="directoryIndex">The index of the directory in <see cref="Entries"/>.</param>
+    /// <returns>The directory's children.</returns>
+    public ReadOnlySpan<RomFsIndexEntry> GetChildren(int directoryIndex)
+    {
+        ref readonly RomFsIndexEntry entry = ref _entries[directoryIndex];
+
+        return _entries.AsSpan(entry.FirstChild, entry.ChildCount);
+    }
+
+    /// <summary>Gets the full UTF-8 path of the entry at the specified index.</summary>
+    public ReadOnlySpan<byte> GetPath(int index) => GetPath(in _entries[index]);
+
+    /// <summary>Gets the full UTF-8 path of an entry.</summary>
+    public ReadOnlySpan<byte> GetPath(in RomFsIndexEntry entry) =>
+        _pathBuffer.AsSpan(entry.PathOffset, entry.PathLength);
+
+    /// <summary>Gets the UTF-8 name of an entry. The root directory's name is empty.</summary>
+    public ReadOnlySpan<byte> GetName(in RomFsIndexEntry entry) =>
+        _pathBuffer.AsSpan(entry.PathOffset + entry.PathLength - entry.NameLength, entry.NameLength);
+
+    private static uint GetHash(ReadOnlySpan<byte> path)
+    {
+        var hashCode = new HashCode();
+        hashCode.AddBytes(path);
+        return (uint)hashCode.ToHashCode();
+    }
+}
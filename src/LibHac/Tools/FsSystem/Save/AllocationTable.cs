@@ -17,6 +17,12 @@ public class AllocationTable
 
     public AllocationTableHeader Header { get; }
 
+    /// <summary>
+    /// Incremented every time an entry in the table is written. Used by <see cref="AllocationTableStorage"/>
+    /// to know when its cached layout of a list may be out of date.
+    /// </summary>
+    public int Version { get; private set; }
+
     public IStorage GetBaseStorage() => BaseStorage;
     public IStorage GetHeaderStorage() => HeaderStorage;
 
@@ -379,6 +385,7 @@ public class AllocationTable
         ref AllocationTableEntry newEntry = ref GetEntryFromBytes(bytes);
         newEntry = entry;
 
+        Version++;
         BaseStorage.Write(offset, bytes).ThrowIfFailure();
     }
 
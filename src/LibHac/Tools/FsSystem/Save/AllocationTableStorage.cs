@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.IO;
 using LibHac.Fs;
 using LibHac.Util;
@@ -12,7 +13,71 @@ public class AllocationTableStorage : IStorage
     internal int InitialBlock { get; private set; }
     private AllocationTable Fat { get; }
 
-    private long _length;
+    private ExtentMap _extentMap;
+
+    /// <summary>
+    /// A run of the list's blocks that are contiguous in both the virtual and physical address space.
+    /// </summary>
+    private readonly struct Extent
+    {
+        public readonly int VirtualBlock;
+        public readonly int PhysicalBlock;
+        public readonly int BlockCount;
+
+        public Extent(int virtualBlock, int physicalBlock, int blockCount)
+        {
+            VirtualBlock = virtualBlock;
+            PhysicalBlock = physicalBlock;
+            BlockCount = blockCount;
+        }
+    }
+
+    /// <summary>
+    /// The layout of the list at a specific <see cref="AllocationTable.Version"/>.
+    /// </summary>
+    private sealed class ExtentMap
+    {
+        public readonly Extent[] Extents;
+        public readonly int TableVersion;
+        public readonly long Length;
+
+        public ExtentMap(Extent[] extents, int tableVersion, long length)
+        {
+            Extents = extents;
+            TableVersion = tableVersion;
+            Length = length;
+        }
+
+        /// <summary>
+        /// Returns the index of the extent containing <paramref name="block"/>, or -1 if the block isn't in the list.
+        /// </summary>
+        public int FindExtent(int block)
+        {
+            Extent[] extents = Extents;
+            int low = 0;
+            int high = extents.Length - 1;
+
+            while (low <= high)
+            {
+                int mid = low + (high - low) / 2;
+
+                if (block < extents[mid].VirtualBlock)
+                {
+                    high = mid - 1;
+                }
+                else if (block >= extents[mid].VirtualBlock + extents[mid].BlockCount)
+                {
+                    low = mid + 1;
+                }
+                else
+                {
+                    return mid;
+                }
+            }
+
+            return -1;
+        }
+    }
 
     public AllocationTableStorage(IStorage data, AllocationTable table, int blockSize, int initialBlock)
     {
@@ -20,13 +85,18 @@ public class AllocationTableStorage : IStorage
         BlockSize = blockSize;
         Fat = table;
         InitialBlock = initialBlock;
-
-        _length = initialBlock == -1 ? 0 : (long)table.GetListLength(initialBlock) * blockSize;
     }
 
     public override Result Read(long offset, Span<byte> destination)
     {
-        var iterator = new AllocationTableIterator(Fat, InitialBlock);
+        if (destination.Length == 0)
+            return Result.Success;
+
+        ExtentMap map = GetExtentMap();
+
+        int extentIndex = map.FindExtent(GetBlockIndex(offset));
+        if (extentIndex < 0)
+            return ResultFs.InvalidAllocationTableOffset.Log();
 
         long inPos = offset;
         int outPos = 0;
@@ -34,18 +104,16 @@ public class AllocationTableStorage : IStorage
 
         while (remaining > 0)
         {
-            int blockNum = (int)(inPos / BlockSize);
-
-            if (!iterator.Seek(blockNum))
-            {
+            if (extentIndex >= map.Extents.Length)
                 return ResultFs.InvalidAllocationTableOffset.Log();
-            }
 
-            int segmentPos = (int)(inPos - (long)iterator.VirtualBlock * BlockSize);
-            long physicalOffset = (long)iterator.PhysicalBlock * BlockSize + segmentPos;
+            Extent extent = map.Extents[extentIndex];
+
+            long segmentPos = inPos - (long)extent.VirtualBlock * BlockSize;
+            long physicalOffset = (long)extent.PhysicalBlock * BlockSize + segmentPos;
 
-            int remainingInSegment = iterator.CurrentSegmentSize * BlockSize - segmentPos;
-            int bytesToRead = Math.Min(remaining, remainingInSegment);
+            long remainingInSegment = (long)extent.BlockCount * BlockSize - segmentPos;
+            int bytesToRead = (int)Math.Min(remaining, remainingInSegment);
 
             Result res = BaseStorage.Read(physicalOffset, destination.Slice(outPos, bytesToRead));
             if (res.IsFailure()) return res.Miss();
@@ -53,6 +121,7 @@ public class AllocationTableStorage : IStorage
             outPos += bytesToRead;
             inPos += bytesToRead;
             remaining -= bytesToRead;
+            extentIndex++;
         }
 
         return Result.Success;
@@ -60,7 +129,14 @@ public class AllocationTableStorage : IStorage
 
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
-        var iterator = new AllocationTableIterator(Fat, InitialBlock);
+        if (source.Length == 0)
+            return Result.Success;
+
+        ExtentMap map = GetExtentMap();
+
+        int extentIndex = map.FindExtent(GetBlockIndex(offset));
+        if (extentIndex < 0)
+            return ResultFs.InvalidAllocationTableOffset.Log();
 
         long inPos = offset;
         int outPos = 0;
@@ -68,18 +144,16 @@ public class AllocationTableStorage : IStorage
 
         while (remaining > 0)
         {
-            int blockNum = (int)(inPos / BlockSize);
-
-            if (!iterator.Seek(blockNum))
-            {
+            if (extentIndex >= map.Extents.Length)
                 return ResultFs.InvalidAllocationTableOffset.Log();
-            }
 
-            int segmentPos = (int)(inPos - (long)iterator.VirtualBlock * BlockSize);
-            long physicalOffset = (long)iterator.PhysicalBlock * BlockSize + segmentPos;
+            Extent extent = map.Extents[extentIndex];
+
+            long segmentPos = inPos - (long)extent.VirtualBlock * BlockSize;
+            long physicalOffset = (long)extent.PhysicalBlock * BlockSize + segmentPos;
 
-            int remainingInSegment = iterator.CurrentSegmentSize * BlockSize - segmentPos;
-            int bytesToWrite = Math.Min(remaining, remainingInSegment);
+            long remainingInSegment = (long)extent.BlockCount * BlockSize - segmentPos;
+            int bytesToWrite = (int)Math.Min(remaining, remainingInSegment);
 
             Result res = BaseStorage.Write(physicalOffset, source.Slice(outPos, bytesToWrite));
             if (res.IsFailure()) return res.Miss();
@@ -87,11 +161,75 @@ public class AllocationTableStorage : IStorage
             outPos += bytesToWrite;
             inPos += bytesToWrite;
             remaining -= bytesToWrite;
+            extentIndex++;
         }
 
         return Result.Success;
     }
 
+    private int GetBlockIndex(long offset)
+    {
+        long block = offset / BlockSize;
+        return offset < 0 || block > int.MaxValue ? -1 : (int)block;
+    }
+
+    /// <summary>
+    /// Gets the layout of the list, walking the list in the allocation table if it has changed
+    /// since the last time the layout was built.
+    /// </summary>
+    private ExtentMap GetExtentMap()
+    {
+        ExtentMap map = _extentMap;
+
+        if (map is not null && map.TableVersion == Fat.Version)
+            return map;
+
+        map = BuildExtentMap();
+        _extentMap = map;
+
+        return map;
+    }
+
+    private ExtentMap BuildExtentMap()
+    {
+        int tableVersion = Fat.Version;
+        var extents = new List<Extent>();
+        long blockCount = 0;
+
+        if (InitialBlock >= 0)
+        {
+            var iterator = new AllocationTableIterator(Fat, InitialBlock);
+
+            int tableSize = Fat.Header.AllocationTableBlockCount;
+            int nodesIterated = 0;
+
+            do
+            {
+                // Merge segments that directly follow the previous one in the base storage
+                if (extents.Count > 0 && extents[^1].PhysicalBlock + extents[^1].BlockCount == iterator.PhysicalBlock)
+                {
+                    Extent previous = extents[^1];
+                    extents[^1] = new Extent(previous.VirtualBlock, previous.PhysicalBlock,
+                        previous.BlockCount + iterator.CurrentSegmentSize);
+                }
+                else
+                {
+                    extents.Add(new Extent(iterator.VirtualBlock, iterator.PhysicalBlock, iterator.CurrentSegmentSize));
+                }
+
+                blockCount += iterator.CurrentSegmentSize;
+                nodesIterated++;
+
+                if (nodesIterated > tableSize)
+                {
+                    throw new InvalidDataException("Cycle detected in allocation table.");
+                }
+            } while (iterator.MoveNext());
+        }
+
+        return new ExtentMap(extents.ToArray(), tableVersion, blockCount * BlockSize);
+    }
+
     public override Result Flush()
     {
         return BaseStorage.Flush();
@@ -99,13 +237,13 @@ public class AllocationTableStorage : IStorage
 
     public override Result GetSize(out long size)
     {
-        size = _length;
+        size = GetExtentMap().Length;
         return Result.Success;
     }
 
     public override Result SetSize(long size)
     {
-        int oldBlockCount = (int)BitUtil.DivideUp(_length, BlockSize);
+        int oldBlockCount = (int)BitUtil.DivideUp(GetExtentMap().Length, BlockSize);
         int newBlockCount = (int)BitUtil.DivideUp(size, BlockSize);
 
         if (oldBlockCount == newBlockCount) return Result.Success;
@@ -115,7 +253,7 @@ public class AllocationTableStorage : IStorage
             InitialBlock = Fat.Allocate(newBlockCount);
             if (InitialBlock == -1) throw new IOException("Not enough space to resize file.");
 
-            _length = (long)newBlockCount * BlockSize;
+            _extentMap = null;
 
             return Result.Success;
         }
@@ -125,7 +263,7 @@ public class AllocationTableStorage : IStorage
             Fat.Free(InitialBlock);
 
             InitialBlock = int.MinValue;
-            _length = 0;
+            _extentMap = null;
 
             return Result.Success;
         }
@@ -143,7 +281,8 @@ public class AllocationTableStorage : IStorage
             Fat.Free(oldBlocks);
         }
 
-        _length = (long)newBlockCount * BlockSize;
+        // The table was modified, so the layout will be rebuilt on the next access
+        _extentMap = null;
 
         return Result.Success;
     }
@@ -1,4 +1,6 @@
 ﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
 using LibHac.Util;
 
@@ -33,6 +35,13 @@ public class SectorStorage : IStorage
         return BaseStorage.Read(offset, destination);
     }
 
+    public override ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+        CancellationToken cancellationToken = default)
+    {
+        ValidateSize(destination.Length, offset);
+        return BaseStorage.ReadAsync(offset, destination, cancellationToken);
+    }
+
     public override Result Write(long offset, ReadOnlySpan<byte> source)
     {
         ValidateSize(source.Length, offset);
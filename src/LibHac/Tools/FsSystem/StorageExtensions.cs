@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.IO;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
@@ -6,11 +7,17 @@ using LibHac.Common;
 using LibHac.Fs;
 using LibHac.Fs.Fsa;
 using LibHac.FsSystem;
+using LibHac.Util;
 
 namespace LibHac.Tools.FsSystem;
 
 public static class StorageExtensions
 {
+    /// <summary>
+    /// The granularity used to find zero-filled data when writing sparse output.
+    /// </summary>
+    public const int SparseBlockSize = 0x1000;
+
     public static IStorage Slice(this IStorage storage, long start)
     {
         storage.GetSize(out long length).ThrowIfFailure();
@@ -140,6 +147,53 @@ public static class StorageExtensions
         }
     }
 
+    /// <summary>
+    /// Writes the contents of <paramref name="input"/> to a file.
+    /// </summary>
+    /// <param name="input">The storage to write.</param>
+    /// <param name="filename">The path of the file to create.</param>
+    /// <param name="sparse">If <see langword="true"/>, blocks containing only zeros are skipped instead
+    /// of being written. See <see cref="CopyToStreamSparse(IStorage, Stream, long, IProgressReport, int)"/>.</param>
+    /// <param name="progress">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    public static void WriteAllBytes(this IStorage input, string filename, bool sparse, IProgressReport progress = null)
+    {
+        input.WriteAllBytes(filename, sparse, null, progress);
+    }
+
+    /// <summary>
+    /// Writes the contents of <paramref name="input"/> to a file.
+    /// </summary>
+    /// <param name="input">The storage to write.</param>
+    /// <param name="filename">The path of the file to create.</param>
+    /// <param name="sparse">If <see langword="true"/>, blocks containing only zeros are skipped instead
+    /// of being written. See <see cref="CopyToStreamSparse(IStorage, Stream, long, IReadOnlyList{ValueTuple{long, long}}, IProgressReport, int)"/>.</param>
+    /// <param name="zeroRanges">The ranges of <paramref name="input"/> to skip without reading them if
+    /// <paramref name="sparse"/> is <see langword="true"/>, in order of their offsets. May be <see langword="null"/>.</param>
+    /// <param name="progress">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    public static void WriteAllBytes(this IStorage input, string filename, bool sparse,
+        IReadOnlyList<(long Offset, long Size)> zeroRanges, IProgressReport progress = null)
+    {
+        if (!sparse)
+        {
+            input.WriteAllBytes(filename, progress);
+            return;
+        }
+
+        input.GetSize(out long inputSize).ThrowIfFailure();
+
+        using (var outFile = new FileStream(filename, FileMode.Create, FileAccess.Write))
+        {
+            if (zeroRanges is null)
+            {
+                input.CopyToStreamSparse(outFile, inputSize, progress);
+            }
+            else
+            {
+                input.CopyToStreamSparse(outFile, inputSize, zeroRanges, progress);
+            }
+        }
+    }
+
     public static byte[] ToArray(this IStorage storage)
     {
         if (storage == null) return new byte[0];
@@ -192,6 +246,165 @@ public static class StorageExtensions
         CopyToStream(input, output, inputSize, bufferSize: bufferSize);
     }
 
+    /// <summary>
+    /// Copies <paramref name="length"/> bytes of <paramref name="input"/> to <paramref name="output"/>,
+    /// seeking past blocks that contain only zeros instead of writing them.
+    /// </summary>
+    /// <remarks><para>On file systems that support sparse files the skipped blocks become holes that don't
+    /// take up any disk space. Blocks are <see cref="SparseBlockSize"/> bytes and are aligned to the
+    /// start of the copied data.</para>
+    /// <para>If <paramref name="input"/> is a <see cref="SparseStorage"/>, the ranges it doesn't store any data
+    /// for are skipped without being read. All other data is read and checked for zeros. Storages that only
+    /// contain a sparse layer further down, such as NCA sections, can pass its ranges to the
+    /// <see cref="CopyToStreamSparse(IStorage, Stream, long, IReadOnlyList{ValueTuple{long, long}}, IProgressReport, int)"/>
+    /// overload instead.</para>
+    /// <para>If <paramref name="output"/> can't seek, all the data is written.</para></remarks>
+    /// <param name="input">The storage to copy.</param>
+    /// <param name="output">The stream to write to. Any existing data in the skipped ranges is left as-is.</param>
+    /// <param name="length">The number of bytes to copy.</param>
+    /// <param name="progress">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    /// <param name="bufferSize">The maximum number of bytes to read from <paramref name="input"/> at once.</param>
+    /// <returns>The number of bytes that were skipped.</returns>
+    public static long CopyToStreamSparse(this IStorage input, Stream output, long length,
+        IProgressReport progress = null, int bufferSize = 0x100000)
+    {
+        var zeroRanges = new List<(long Offset, long Size)>();
+
+        if (input is SparseStorage sparseStorage && output.CanSeek)
+        {
+            sparseStorage.GetZeroRanges(zeroRanges).ThrowIfFailure();
+        }
+
+        return input.CopyToStreamSparse(output, length, zeroRanges, progress, bufferSize);
+    }
+
+    /// <summary>
+    /// Copies <paramref name="length"/> bytes of <paramref name="input"/> to <paramref name="output"/>,
+    /// seeking past <paramref name="zeroRanges"/> and blocks that contain only zeros instead of writing them.
+    /// </summary>
+    /// <remarks><para>The data in <paramref name="zeroRanges"/> is never read, and the ranges are left as holes
+    /// in the output even if <paramref name="input"/> would return something other than zeros for them.
+    /// For example, the ranges returned by <see cref="NcaUtils.Nca.GetSparseZeroRanges"/> are read as the
+    /// decryption of zeros because the NCA doesn't store any data for them.</para>
+    /// <para>If <paramref name="output"/> can't seek, all the data is written.</para></remarks>
+    /// <param name="input">The storage to copy.</param>
+    /// <param name="output">The stream to write to. Any existing data in the skipped ranges is left as-is.</param>
+    /// <param name="length">The number of bytes to copy.</param>
+    /// <param name="zeroRanges">The ranges of <paramref name="input"/> to skip, in order of their offsets.</param>
+    /// <param name="progress">An optional <see cref="IProgressReport"/> for reporting progress.</param>
+    /// <param name="bufferSize">The maximum number of bytes to read from <paramref name="input"/> at once.</param>
+    /// <returns>The number of bytes that were skipped.</returns>
+    public static long CopyToStreamSparse(this IStorage input, Stream output, long length,
+        IReadOnlyList<(long Offset, long Size)> zeroRanges, IProgressReport progress = null,
+        int bufferSize = 0x100000)
+    {
+        if (!output.CanSeek)
+        {
+            input.CopyToStream(output, length, progress, bufferSize);
+            return 0;
+        }
+
+        using var buffer = new RentedArray<byte>(bufferSize);
+        int rentedBufferSize = buffer.Array.Length;
+
+        long inOffset = 0;
+        long skippedBytes = 0;
+        int zeroRangeIndex = 0;
+
+        progress?.SetTotal(length);
+
+        while (inOffset < length)
+        {
+            while (zeroRangeIndex < zeroRanges.Count &&
+                   zeroRanges[zeroRangeIndex].Offset + zeroRanges[zeroRangeIndex].Size <= inOffset)
+            {
+                zeroRangeIndex++;
+            }
+
+            long nextZeroRange = length;
+
+            if (zeroRangeIndex < zeroRanges.Count)
+            {
+                (long zeroOffset, long zeroSize) = zeroRanges[zeroRangeIndex];
+
+                if (zeroOffset <= inOffset)
+                {
+                    long toSkip = Math.Min(zeroOffset + zeroSize, length) - inOffset;
+
+                    output.Seek(toSkip, SeekOrigin.Current);
+                    skippedBytes += toSkip;
+                    inOffset += toSkip;
+                    progress?.ReportAdd(toSkip);
+                    continue;
+                }
+
+                nextZeroRange = Math.Min(zeroOffset, length);
+            }
+
+            int toCopy = (int)Math.Min(rentedBufferSize, nextZeroRange - inOffset);
+            Span<byte> data = buffer.Array.AsSpan(0, toCopy);
+
+            input.Read(inOffset, data).ThrowIfFailure();
+            skippedBytes += WriteSparse(output, data, inOffset);
+
+            inOffset += toCopy;
+            progress?.ReportAdd(toCopy);
+        }
+
+        // Extend the stream if the data ended with skipped blocks
+        if (output.Position > output.Length)
+        {
+            output.SetLength(output.Position);
+        }
+
+        progress?.SetTotal(0);
+        return skippedBytes;
+    }
+
+    /// <summary>
+    /// Writes runs of blocks that contain data and seeks past runs of zero blocks.
+    /// </summary>
+    /// <returns>The number of bytes that were skipped.</returns>
+    private static long WriteSparse(Stream output, ReadOnlySpan<byte> data, long dataOffset)
+    {
+        long skippedBytes = 0;
+        int position = 0;
+
+        while (position < data.Length)
+        {
+            int runStart = position;
+            bool isZeroRun = IsZeroBlock(data, dataOffset, position, out int blockSize);
+            position += blockSize;
+
+            while (position < data.Length && IsZeroBlock(data, dataOffset, position, out blockSize) == isZeroRun)
+            {
+                position += blockSize;
+            }
+
+            if (isZeroRun)
+            {
+                output.Seek(position - runStart, SeekOrigin.Current);
+                skippedBytes += position - runStart;
+            }
+            else
+            {
+                output.Write(data.Slice(runStart, position - runStart));
+            }
+        }
+
+        return skippedBytes;
+
+        static bool IsZeroBlock(ReadOnlySpan<byte> data, long dataOffset, int position, out int blockSize)
+        {
+            // Keep blocks aligned to the output even if the data doesn't start on a block boundary
+            int blockEnd = (int)Math.Min(Alignment.AlignDown(dataOffset + position + SparseBlockSize, SparseBlockSize)
+                                         - dataOffset, data.Length);
+            blockSize = blockEnd - position;
+
+            return data.Slice(position, blockSize).IsZeros();
+        }
+    }
+
     public static IStorage AsStorage(this Stream stream)
     {
         if (stream == null) return null;
@@ -1,143 +1,211 @@
-// https://github.com/Ryujinx/Ryujinx/blob/0254a84f90ea03037be15b8fd1f9e0a4be5577e9/Ryujinx.HLE/Loaders/Compression/Lz4.cs
-
 using System;
+using System.IO;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
 
 namespace LibHac.Util;
 
+/// <summary>
+/// Decodes LZ4 blocks.
+/// </summary>
+/// <remarks>Literals and non-overlapping matches are copied in 16-byte chunks. When there is enough space left in
+/// the output buffer a chunk may be written past the end of the current sequence. Those bytes are overwritten
+/// by later sequences, but any bytes in the output buffer past the end of the decompressed data
+/// may be modified.</remarks>
 public static class Lz4
 {
+    private const int MinMatchLength = 4;
+    private const int WideCopySize = 16;
+
     public static byte[] Decompress(byte[] cmp, int decLength)
     {
         byte[] dec = new byte[decLength];
 
-        int cmpPos = 0;
-        int decPos = 0;
-
-        int GetLength(int length)
-        {
-            byte sum;
-
-            if (length == 0xf)
-            {
-                do
-                {
-                    length += sum = cmp[cmpPos++];
-                } while (sum == 0xff);
-            }
+        Decompress(cmp, dec);
 
-            return length;
-        }
+        return dec;
+    }
 
-        do
-        {
-            byte token = cmp[cmpPos++];
+    /// <summary>
+    /// Decompresses an LZ4 block into <paramref name="destination"/>.
+    /// </summary>
+    /// <param name="source">The compressed block.</param>
+    /// <param name="destination">The buffer to write the decompressed data to.</param>
+    /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+    /// <exception cref="InvalidDataException">The compressed data is invalid or
+    /// <paramref name="destination"/> is too small.</exception>
+    public static int Decompress(ReadOnlySpan<byte> source, Span<byte> destination)
+    {
+        if (!TryDecompress(source, destination, out int bytesWritten))
+            throw new InvalidDataException("Invalid LZ4 compressed data.");
 
-            int encCount = (token >> 0) & 0xf;
-            int litCount = (token >> 4) & 0xf;
+        return bytesWritten;
+    }
 
-            //Copy literal chunk
-            litCount = GetLength(litCount);
+    /// <summary>
+    /// Decompresses an LZ4 block into <paramref name="destination"/>.
+    /// </summary>
+    /// <param name="source">The compressed block.</param>
+    /// <param name="destination">The buffer to write the decompressed data to.</param>
+    /// <param name="bytesWritten">If successful, the number of bytes written to <paramref name="destination"/>.</param>
+    /// <returns><see langword="true"/> if the block was successfully decompressed. <see langword="false"/> if
+    /// the compressed data is invalid or <paramref name="destination"/> is too small.</returns>
+    [MethodImpl(MethodImplOptions.AggressiveOptimization)]
+    public static bool TryDecompress(ReadOnlySpan<byte> source, Span<byte> destination, out int bytesWritten)
+    {
+        bytesWritten = 0;
 
-            Buffer.BlockCopy(cmp, cmpPos, dec, decPos, litCount);
+        ref byte src = ref MemoryMarshal.GetReference(source);
+        ref byte dst = ref MemoryMarshal.GetReference(destination);
+        int srcLength = source.Length;
+        int dstLength = destination.Length;
 
-            cmpPos += litCount;
-            decPos += litCount;
+        int srcPos = 0;
+        int dstPos = 0;
 
-            if (cmpPos >= cmp.Length)
-            {
-                break;
-            }
+        // Stop once the output buffer is full even if there's still input left
+        while (srcPos < srcLength && dstPos < dstLength)
+        {
+            int token = Unsafe.Add(ref src, srcPos++);
 
-            //Copy compressed chunk
-            int back = cmp[cmpPos++] << 0 |
-                       cmp[cmpPos++] << 8;
+            // Copy the literals
+            int literalLength = token >> 4;
 
-            encCount = GetLength(encCount) + 4;
+            if (literalLength == 0xF && !TryReadLength(ref src, srcLength, ref srcPos, ref literalLength, srcLength))
+                return false;
 
-            int encPos = decPos - back;
+            if (literalLength > srcLength - srcPos || literalLength > dstLength - dstPos)
+                return false;
 
-            if (encCount <= back)
+            if (literalLength <= WideCopySize && srcLength - srcPos >= WideCopySize &&
+                dstLength - dstPos >= WideCopySize)
             {
-                Buffer.BlockCopy(dec, encPos, dec, decPos, encCount);
-
-                decPos += encCount;
+                Copy16(ref Unsafe.Add(ref dst, dstPos), ref Unsafe.Add(ref src, srcPos));
             }
             else
             {
-                while (encCount-- > 0)
-                {
-                    dec[decPos++] = dec[encPos++];
-                }
+                Unsafe.CopyBlockUnaligned(ref Unsafe.Add(ref dst, dstPos), ref Unsafe.Add(ref src, srcPos),
+                    (uint)literalLength);
             }
-        } while (cmpPos < cmp.Length &&
-                 decPos < dec.Length);
 
-        return dec;
-    }
+            srcPos += literalLength;
+            dstPos += literalLength;
 
-    public static void Decompress(ReadOnlySpan<byte> cmp, Span<byte> dec)
-    {
-        int cmpPos = 0;
-        int decPos = 0;
+            // The last sequence in a block only contains literals
+            if (srcPos >= srcLength)
+                break;
 
-        // ReSharper disable once VariableHidesOuterVariable
-        int GetLength(int length, ReadOnlySpan<byte> cmp)
-        {
-            byte sum;
+            // Copy the match
+            if (srcLength - srcPos < 2)
+                return false;
 
-            if (length == 0xf)
-            {
-                do
-                {
-                    length += sum = cmp[cmpPos++];
-                } while (sum == 0xff);
-            }
+            int matchOffset = Unsafe.Add(ref src, srcPos) | Unsafe.Add(ref src, srcPos + 1) << 8;
+            srcPos += 2;
+
+            if (matchOffset == 0 || matchOffset > dstPos)
+                return false;
+
+            int matchLength = token & 0xF;
 
-            return length;
+            if (matchLength == 0xF && !TryReadLength(ref src, srcLength, ref srcPos, ref matchLength, dstLength))
+                return false;
+
+            matchLength += MinMatchLength;
+
+            if (matchLength > dstLength - dstPos)
+                return false;
+
+            CopyMatch(ref dst, dstLength, dstPos, matchOffset, matchLength);
+            dstPos += matchLength;
         }
 
+        bytesWritten = dstPos;
+        return true;
+    }
+
+    private static bool TryReadLength(ref byte src, int srcLength, ref int srcPos, ref int length, int maxLength)
+    {
+        int value;
+
         do
         {
-            byte token = cmp[cmpPos++];
+            if (srcPos >= srcLength)
+                return false;
 
-            int encCount = (token >> 0) & 0xf;
-            int litCount = (token >> 4) & 0xf;
+            value = Unsafe.Add(ref src, srcPos++);
+            length += value;
 
-            //Copy literal chunk
-            litCount = GetLength(litCount, cmp);
+            if (length > maxLength)
+                return false;
+        } while (value == 0xFF);
 
-            cmp.Slice(cmpPos, litCount).CopyTo(dec.Slice(decPos));
+        return true;
+    }
 
-            cmpPos += litCount;
-            decPos += litCount;
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static void CopyMatch(ref byte dst, int dstLength, int dstPos, int matchOffset, int matchLength)
+    {
+        ref byte output = ref Unsafe.Add(ref dst, dstPos);
+        ref byte match = ref Unsafe.Add(ref dst, dstPos - matchOffset);
+
+        if (matchOffset >= WideCopySize)
+        {
+            // Each chunk only reads bytes that have already been written, so the match can be copied
+            // 16 bytes at a time even if it overlaps the output
+            int i = 0;
 
-            if (cmpPos >= cmp.Length)
+            for (; i + WideCopySize <= matchLength; i += WideCopySize)
             {
-                break;
+                Copy16(ref Unsafe.Add(ref output, i), ref Unsafe.Add(ref match, i));
             }
 
-            //Copy compressed chunk
-            int back = cmp[cmpPos++] << 0 |
-                       cmp[cmpPos++] << 8;
+            if (i == matchLength)
+                return;
 
-            encCount = GetLength(encCount, cmp) + 4;
+            if (dstLength - dstPos - i >= WideCopySize)
+            {
+                Copy16(ref Unsafe.Add(ref output, i), ref Unsafe.Add(ref match, i));
+                return;
+            }
 
-            int encPos = decPos - back;
+            for (; i < matchLength; i++)
+            {
+                Unsafe.Add(ref output, i) = Unsafe.Add(ref match, i);
+            }
+        }
+        else if (matchOffset >= sizeof(ulong))
+        {
+            int i = 0;
 
-            if (encCount <= back)
+            for (; i + sizeof(ulong) <= matchLength; i += sizeof(ulong))
             {
-                dec.Slice(encPos, encCount).CopyTo(dec.Slice(decPos));
+                Unsafe.WriteUnaligned(ref Unsafe.Add(ref output, i),
+                    Unsafe.ReadUnaligned<ulong>(ref Unsafe.Add(ref match, i)));
+            }
 
-                decPos += encCount;
+            for (; i < matchLength; i++)
+            {
+                Unsafe.Add(ref output, i) = Unsafe.Add(ref match, i);
             }
-            else
+        }
+        else if (matchOffset == 1)
+        {
+            // A run of a single byte
+            Unsafe.InitBlockUnaligned(ref output, match, (uint)matchLength);
+        }
+        else
+        {
+            for (int i = 0; i < matchLength; i++)
             {
-                while (encCount-- > 0)
-                {
-                    dec[decPos++] = dec[encPos++];
-                }
+                Unsafe.Add(ref output, i) = Unsafe.Add(ref match, i);
             }
-        } while (cmpPos < cmp.Length &&
-                 decPos < dec.Length);
+        }
+    }
+
+    [MethodImpl(MethodImplOptions.AggressiveInlining)]
+    private static void Copy16(ref byte destination, ref byte source)
+    {
+        Unsafe.WriteUnaligned(ref destination, Unsafe.ReadUnaligned<Vector128<byte>>(ref source));
     }
-}
\ No newline at end of file
+}
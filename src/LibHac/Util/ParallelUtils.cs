@@ -0,0 +1,86 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.ExceptionServices;
+using System.Threading.Tasks;
+
+namespace LibHac.Util;
+
+/// <summary>
+/// Helpers for running work on multiple threads that throw the original exception when a single
+/// piece of work fails instead of wrapping it in an <see cref="AggregateException"/>.
+/// </summary>
+/// <remarks>LibHac addition.</remarks>
+public static class ParallelUtils
+{
+    /// <summary>
+    /// Runs <paramref name="body"/> for each index in [0, <paramref name="count"/>) using up to
+    /// <paramref name="threadCount"/> threads.
+    /// </summary>
+    /// <remarks>The indexes are run in order on the calling thread if <paramref name="threadCount"/>
+    /// or <paramref name="count"/> is 1 or less. If exactly one call throws, that exception is rethrown
+    /// with its original stack trace. If more than one call throws, an <see cref="AggregateException"/> is thrown.</remarks>
+    /// <param name="count">The number of indexes to run.</param>
+    /// <param name="threadCount">The maximum number of threads to use.</param>
+    /// <param name="body">The work to run for each index.</param>
+    public static void For(int count, int threadCount, Action<int> body)
+    {
+        if (threadCount <= 1 || count <= 1)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                body(i);
+            }
+
+            return;
+        }
+
+        try
+        {
+            var options = new ParallelOptions { MaxDegreeOfParallelism = threadCount };
+            Parallel.For(0, count, options, body);
+        }
+        catch (AggregateException ex) when (ex.InnerExceptions.Count == 1)
+        {
+            ExceptionDispatchInfo.Capture(ex.InnerException!).Throw();
+        }
+    }
+
+    /// <summary>
+    /// Waits for every task in <paramref name="tasks"/> to complete. <see langword="null"/> tasks are skipped.
+    /// </summary>
+    /// <remarks>All the tasks are waited for even if some of them fail, so anything they use can safely be
+    /// released afterward. Failures are thrown the same way as <see cref="For"/>.</remarks>
+    /// <param name="tasks">The tasks to wait for.</param>
+    public static void WaitAll(IEnumerable<Task> tasks)
+    {
+        List<Exception> exceptions = null;
+
+        foreach (Task task in tasks)
+        {
+            if (task is null)
+                continue;
+
+            // Wait for the task to complete without throwing so the remaining tasks are still waited for
+            task.ConfigureAwait(ConfigureAwaitOptions.SuppressThrowing).GetAwaiter().GetResult();
+
+            if (task.IsFaulted)
+            {
+                exceptions ??= new List<Exception>();
+                exceptions.AddRange(task.Exception!.InnerExceptions);
+            }
+            else if (task.IsCanceled)
+            {
+                exceptions ??= new List<Exception>();
+                exceptions.Add(new TaskCanceledException(task));
+            }
+        }
+
+        if (exceptions is null)
+            return;
+
+        if (exceptions.Count == 1)
+            ExceptionDispatchInfo.Capture(exceptions[0]).Throw();
+
+        throw new AggregateException(exceptions);
+    }
+}
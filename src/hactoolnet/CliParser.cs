@@ -2,6 +2,7 @@
 using System.Globalization;
 using System.Linq;
 using System.Text;
+using LibHac.FsSystem;
 using LibHac.Util;
 
 namespace hactoolnet;
@@ -26,6 +27,8 @@ internal static class CliParser
         new CliOption("consolekeys", 1, (o, a) => o.ConsoleKeyFile = a[0]),
         new CliOption("accesslog", 1, (o, a) => o.AccessLog = a[0]),
         new CliOption("resultlog", 1, (o, a) => o.ResultLog = a[0]),
+        new CliOption("storagetrace", 0, (o, _) => o.StorageTrace = true),
+        new CliOption("sparse", 0, (o, _) => o.SparseOutput = true),
         new CliOption("section0", 1, (o, a) => o.SectionOut[0] = a[0]),
         new CliOption("section1", 1, (o, a) => o.SectionOut[1] = a[0]),
         new CliOption("section2", 1, (o, a) => o.SectionOut[2] = a[0]),
@@ -49,6 +52,7 @@ internal static class CliParser
         new CliOption("uncompressed", 1, (o, a) => o.UncompressedOut = a[0]),
         new CliOption("nspout", 1, (o, a) => o.NspOut = a[0]),
         new CliOption("sdseed", 1, (o, a) => o.SdSeed = a[0]),
+        new CliOption("metacache", 1, (o, a) => o.MetadataCache = a[0]),
         new CliOption("sdpath", 1, (o, a) => o.SdPath = a[0]),
         new CliOption("basenca", 1, (o, a) => o.BaseNca = a[0]),
         new CliOption("basetitlekey", 1, (o, a) => o.BaseTitleKey = ParseTitleKey(o, a[0])),
@@ -72,7 +76,12 @@ internal static class CliParser
         new CliOption("extractini1", 0, (o, _) => o.ExtractIni1 = true),
         new CliOption("title", 1, (o, a) => o.TitleId = ParseTitleId(o, a[0])),
         new CliOption("bench", 1, (o, a) => o.BenchType = a[0]),
+        new CliOption("benchthreads", 1, (o, a) => o.BenchThreadCounts = ParseThreadCounts(o, a[0])),
+        new CliOption("benchjson", 1, (o, a) => o.BenchJsonOut = a[0]),
+        new CliOption("benchbaseline", 1, (o, a) => o.BenchBaseline = a[0]),
         new CliOption("cpufreq", 1, (o, a) => o.CpuFrequencyGhz = ParseDouble(o, a[0])),
+        new CliOption("threads", 1, (o, a) => o.ThreadCount = ParseThreadCount(o, a[0])),
+        new CliOption("io", 1, (o, a) => o.IoMode = ParseIoMode(o, a[0])),
 
         new CliOption("replacefile", 2, (o, a) =>
         {
@@ -241,6 +250,52 @@ internal static class CliParser
         return value;
     }
 
+    private static int ParseThreadCount(Options options, string input)
+    {
+        if (!int.TryParse(input, out int value) || value < 0)
+        {
+            options.ParseErrorMessage ??= $"Could not parse thread count \"{input}\"";
+            return default;
+        }
+
+        // A thread count of 0 means use every available core
+        return value == 0 ? Environment.ProcessorCount : value;
+    }
+
+    private static int[] ParseThreadCounts(Options options, string input)
+    {
+        string[] values = input.Split(',', StringSplitOptions.RemoveEmptyEntries | StringSplitOptions.TrimEntries);
+        int[] threadCounts = new int[values.Length];
+
+        for (int i = 0; i < values.Length; i++)
+        {
+            threadCounts[i] = ParseThreadCount(options, values[i]);
+        }
+
+        if (threadCounts.Length == 0 || threadCounts.Contains(0))
+        {
+            options.ParseErrorMessage ??= $"Could not parse thread counts \"{input}\"";
+            return default;
+        }
+
+        return threadCounts;
+    }
+
+    private static LocalFileIoMode ParseIoMode(Options options, string input)
+    {
+        switch (input.ToLowerInvariant())
+        {
+            case "stream": return LocalFileIoMode.Stream;
+            case "random": return LocalFileIoMode.RandomAccess;
+            case "mmap": return LocalFileIoMode.MemoryMapped;
+            case "async": return LocalFileIoMode.Asynchronous;
+        }
+
+        options.ParseErrorMessage ??= "Specified I/O mode is invalid.";
+
+        return default;
+    }
+
     private static string GetShortVersion()
     {
         return $"hactoolnet {VersionInfo.Version}";
@@ -271,6 +326,10 @@ internal static class CliParser
         sb.AppendLine("  -t, --intype=type    Specify input file type [nca, xci, romfs, pfs0, pk11, pk21, ini1, kip1, switchfs, save, ndv0, keygen, romfsbuild, pfsbuild]");
         sb.AppendLine("  --titlekeys <file>   Load title keys from an external file.");
         sb.AppendLine("  --accesslog <file>   Specify the access log file path.");
+        sb.AppendLine("  --storagetrace       Print a per-layer breakdown of the time spent in the NCA storage stack.");
+        sb.AppendLine("  --sparse             Skip zero-filled blocks when writing raw storage output, creating sparse files.");
+        sb.AppendLine("  --threads <count>    Number of threads to use when verifying, extracting or scanning NCAs. 0 uses all CPU cores. (Default: 1)");
+        sb.AppendLine("  --io <mode>          How input files are read [stream, random, mmap, async]. (Default: random)");
         sb.AppendLine("  --disablekeywarns    Disables warning output when loading external keys.");
         sb.AppendLine("  --enableallkeywarns  Enables warning output when loading unknown external keys.");
         sb.AppendLine("  --version            Display version information and exit.");
@@ -337,6 +396,7 @@ internal static class CliParser
         sb.AppendLine("  --outdir <dir>       Specify INI1 directory path.");
         sb.AppendLine("Switch FS options:");
         sb.AppendLine("  --sdseed <seed>      Set console unique seed for SD card NAX0 encryption.");
+        sb.AppendLine("  --metacache <file>   Cache NCA metadata in the specified file to speed up reopening the same dump.");
         sb.AppendLine("  --listapps           List application info.");
         sb.AppendLine("  --listtitles         List title info for all titles.");
         sb.AppendLine("  --listncas           List info for all NCAs.");
@@ -366,6 +426,10 @@ internal static class CliParser
         sb.AppendLine("  --outfile            Specify patched file path.");
         sb.AppendLine("Keygen options:");
         sb.AppendLine("  --outdir <dir>       Specify directory path to save key files to.");
+        sb.AppendLine("Storage benchmark options (-t bench --bench storage):");
+        sb.AppendLine("  --benchthreads <n,...> Comma-separated thread counts to run each benchmark with. (Default: 1)");
+        sb.AppendLine("  --benchjson <file>   Write the benchmark results to a JSON file.");
+        sb.AppendLine("  --benchbaseline <file> Compare the benchmark results to a JSON file from a previous run.");
 
         return sb.ToString();
     }
@@ -1,5 +1,6 @@
 ﻿using System;
 using System.Buffers;
+using System.Collections.Generic;
 using LibHac;
 using LibHac.Common;
 using LibHac.Fs;
@@ -12,12 +13,15 @@ namespace hactoolnet;
 public static class FsUtils
 {
     public static Result CopyDirectoryWithProgress(FileSystemClient fs, U8Span sourcePath, U8Span destPath,
-        CreateFileOptions options = CreateFileOptions.None, IProgressReport logger = null)
+        CreateFileOptions options = CreateFileOptions.None, IProgressReport logger = null, int threadCount = 1)
     {
         try
         {
             logger?.SetTotal(GetTotalSize(fs, sourcePath));
 
+            if (threadCount > 1)
+                return CopyDirectoryWithProgressParallel(fs, sourcePath, destPath, options, logger, threadCount);
+
             return CopyDirectoryWithProgressInternal(fs, sourcePath, destPath, options, logger);
         }
         finally
@@ -71,6 +75,61 @@ public static class FsUtils
         return Result.Success;
     }
 
+    private static Result CopyDirectoryWithProgressParallel(FileSystemClient fs, U8Span sourcePath, U8Span destPath,
+        CreateFileOptions options, IProgressReport logger, int threadCount)
+    {
+        var sourceFiles = new List<string>();
+        var destFiles = new List<string>();
+        var fileSizes = new List<long>();
+
+        // Create the directory tree and the empty files before copying anything
+        Result res = CreateDirectoryTree(fs, sourcePath.ToString(), destPath.ToString(), options, sourceFiles,
+            destFiles, fileSizes);
+        if (res.IsFailure()) return res.Miss();
+
+        return CopyPipeline.CopyFiles(fileSizes, threadCount, (index, readerCount) =>
+        {
+            logger?.LogMessage(sourceFiles[index]);
+
+            Result copyResult = CopyFileWithProgress(fs, sourceFiles[index].ToU8Span(),
+                destFiles[index].ToU8Span(), logger, readerCount);
+            if (copyResult.IsFailure()) return copyResult.Miss();
+
+            return Result.Success;
+        });
+    }
+
+    private static Result CreateDirectoryTree(FileSystemClient fs, string sourcePath, string destPath,
+        CreateFileOptions options, List<string> sourceFiles, List<string> destFiles, List<long> fileSizes)
+    {
+        foreach (DirectoryEntryEx entry in fs.EnumerateEntries(sourcePath, "*", SearchOptions.Default))
+        {
+            string subSrcPath = PathTools.Normalize(PathTools.Combine(sourcePath, entry.Name));
+            string subDstPath = PathTools.Normalize(PathTools.Combine(destPath, entry.Name));
+
+            if (entry.Type == DirectoryEntryType.Directory)
+            {
+                fs.EnsureDirectoryExists(subDstPath);
+
+                Result res = CreateDirectoryTree(fs, subSrcPath, subDstPath, options, sourceFiles, destFiles,
+                    fileSizes);
+                if (res.IsFailure()) return res.Miss();
+            }
+
+            if (entry.Type == DirectoryEntryType.File)
+            {
+                Result res = fs.CreateOrOverwriteFile(subDstPath, entry.Size, options);
+                if (res.IsFailure()) return res.Miss();
+
+                sourceFiles.Add(subSrcPath);
+                destFiles.Add(subDstPath);
+                fileSizes.Add(entry.Size);
+            }
+        }
+
+        return Result.Success;
+    }
+
     public static long GetTotalSize(FileSystemClient fs, U8Span path, string searchPattern = "*")
     {
         long size = 0;
@@ -83,7 +142,8 @@ public static class FsUtils
         return size;
     }
 
-    public static Result CopyFileWithProgress(FileSystemClient fs, U8Span sourcePath, U8Span destPath, IProgressReport logger = null)
+    public static Result CopyFileWithProgress(FileSystemClient fs, U8Span sourcePath, U8Span destPath,
+        IProgressReport logger = null, int readerCount = 0)
     {
         Result res = fs.OpenFile(out FileHandle sourceHandle, sourcePath, OpenMode.Read);
         if (res.IsFailure()) return res.Miss();
@@ -100,6 +160,20 @@ public static class FsUtils
                 res = fs.GetFileSize(out long fileSize, sourceHandle);
                 if (res.IsFailure()) return res.Miss();
 
+                if (readerCount > 0)
+                {
+                    res = CopyPipeline.Copy(
+                        (offset, destination) => fs.ReadFile(sourceHandle, offset, destination),
+                        (offset, source) => fs.WriteFile(destHandle, offset, source, WriteOption.None),
+                        fileSize, readerCount, logger);
+                    if (res.IsFailure()) return res.Miss();
+
+                    res = fs.FlushFile(destHandle);
+                    if (res.IsFailure()) return res.Miss();
+
+                    return Result.Success;
+                }
+
                 int bufferSize = (int)Math.Min(maxBufferSize, fileSize);
 
                 byte[] buffer = ArrayPool<byte>.Shared.Rent(bufferSize);
@@ -1,6 +1,7 @@
 ﻿using LibHac;
 using LibHac.Common;
 using LibHac.Common.Keys;
+using LibHac.FsSystem;
 using LibHac.Tools.FsSystem;
 
 namespace hactoolnet;
@@ -24,6 +25,8 @@ internal class Options
     public string ConsoleKeyFile;
     public string AccessLog;
     public string ResultLog;
+    public bool StorageTrace;
+    public bool SparseOutput;
     public string[] SectionOut = new string[4];
     public string[] SectionOutDir = new string[4];
     public string HeaderOut;
@@ -40,6 +43,7 @@ internal class Options
     public string CiphertextOut;
     public string UncompressedOut;
     public string SdSeed;
+    public string MetadataCache;
     public string NspOut;
     public string SdPath;
     public string BaseNca;
@@ -66,7 +70,12 @@ internal class Options
     public byte[] TitleKey;
     public byte[] BaseTitleKey;
     public string BenchType;
+    public int[] BenchThreadCounts;
+    public string BenchJsonOut;
+    public string BenchBaseline;
     public double CpuFrequencyGhz;
+    public int ThreadCount = 1;
+    public LocalFileIoMode IoMode = LocalFileIoMode.RandomAccess;
 
     public string ParseErrorMessage;
     public bool IsParseSuccessful;
@@ -112,4 +121,5 @@ internal class Context
     public KeySet KeySet;
     public ProgressBar Logger;
     public HorizonClient Horizon;
+    public StorageTracer StorageTracer;
 }
\ No newline at end of file
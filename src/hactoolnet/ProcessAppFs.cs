@@ -40,7 +40,7 @@ internal static class ProcessAppFs
     {
         ImportTickets(ctx, fileSystem);
 
-        SwitchFs switchFs = SwitchFs.OpenNcaDirectory(ctx.KeySet, fileSystem);
+        SwitchFs switchFs = SwitchFs.OpenNcaDirectory(ctx.KeySet, fileSystem, ctx.Options.ThreadCount);
 
         if (ctx.Options.ListNcas)
         {
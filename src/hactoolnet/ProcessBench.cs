@@ -1,14 +1,19 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Diagnostics;
+using System.IO;
 using System.Linq;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 using System.Runtime.Intrinsics;
+using LibHac;
 using LibHac.Common;
 using LibHac.Crypto;
 using LibHac.Crypto.Impl;
 using LibHac.Fs;
+using LibHac.FsSystem;
 using LibHac.Tools.FsSystem;
+using LibHac.Util;
 
 namespace hactoolnet;
 
@@ -23,6 +28,12 @@ internal static class ProcessBench
     // ReSharper disable once UnusedMember.Local
     private const int SingleBlockCipherBenchSize = 1024 * 128;
     private const int ShaBenchSize = 1024 * 128;
+    private const int ShaBlockBenchBlockSize = 0x200;
+    private const int Lz4BenchBlockSize = 0x10000;
+    private const int Lz4BenchBlockCount = 16;
+    private const int PathBenchIterations = 200;
+    private const int BufferManagerBenchHeapSize = 1024 * 1024 * 16;
+    private const int BufferManagerBenchCacheCount = 1024;
 
     private static double CpuFrequency { get; set; }
 
@@ -230,6 +241,57 @@ internal static class ProcessBench
         }
     }
 
+    // Benchmarks the CTR and XTS modes using the sector sizes they're used with when reading NCAs and NAND images
+    private static void RegisterAesSectorBenchmarks(MultiBenchmark bench)
+    {
+        byte[] input = new byte[BatchCipherBenchSize];
+        byte[] output = new byte[BatchCipherBenchSize];
+        byte[] key1 = new byte[0x10];
+        byte[] key2 = new byte[0x10];
+        byte[] iv = new byte[0x10];
+
+        Func<double, string> resultPrinter = time => GetPerformanceString(time, BatchCipherBenchSize);
+
+        // Skip the first benchmark set if we don't have AES-NI intrinsics
+        for (int i = Aes.IsAesNiSupported() ? 0 : 1; i < 2; i++)
+        {
+            bool preferDotNetImpl = i == 1;
+            string implName = preferDotNetImpl ? "built-in" : GetAesIsaTierName();
+
+            bench.Register($"AES-CTR 0x4000 sectors ({implName})", () => { }, () =>
+            {
+                for (int offset = 0; offset < input.Length; offset += 0x4000)
+                {
+                    Aes.DecryptCtr128(input.AsSpan(offset, 0x4000), output.AsSpan(offset, 0x4000), key1, iv,
+                        preferDotNetImpl);
+                }
+            }, resultPrinter);
+
+            RegisterXts(0x200);
+            RegisterXts(0x4000);
+
+            void RegisterXts(int sectorSize)
+            {
+                bench.Register($"AES-XTS 0x{sectorSize:x} sectors ({implName})", () => { }, () =>
+                {
+                    for (int offset = 0; offset < input.Length; offset += sectorSize)
+                    {
+                        Aes.DecryptXts128(input.AsSpan(offset, sectorSize), output.AsSpan(offset, sectorSize), key1,
+                            key2, iv, preferDotNetImpl);
+                    }
+                }, resultPrinter);
+            }
+        }
+    }
+
+    private static string GetAesIsaTierName()
+    {
+        if (!Aes.IsAesNiSupported())
+            return "software";
+
+        return System.Runtime.Intrinsics.X86.Pclmulqdq.IsSupported ? "AES-NI + PCLMULQDQ" : "AES-NI";
+    }
+
     // ReSharper disable once UnusedParameter.Local
     private static void RegisterAesSingleBlockBenchmarks(MultiBenchmark bench)
     {
@@ -313,6 +375,316 @@ internal static class ProcessBench
         }
     }
 
+    private static void RegisterShaBlockBenchmarks(MultiBenchmark bench)
+    {
+        byte[] input = new byte[ShaBenchSize];
+        byte[] hashes = new byte[ShaBenchSize / ShaBlockBenchBlockSize * Sha256.DigestSize];
+
+        Func<double, string> resultPrinter = time => GetPerformanceString(time, ShaBenchSize);
+
+        bench.Register("SHA-256 blocks single-buffer", () => { },
+            () => Sha256.GenerateSha256Hashes(default, input, ShaBlockBenchBlockSize, hashes, false), resultPrinter);
+
+        if (Sha256MultiBuffer.IsAvx2Supported || Sha256MultiBuffer.IsSsse3Supported)
+        {
+            bench.Register("SHA-256 blocks multi-buffer", () => { },
+                () => Sha256.GenerateSha256Hashes(default, input, ShaBlockBenchBlockSize, hashes, true), resultPrinter);
+        }
+    }
+
+    private static void RegisterLz4Benchmarks(MultiBenchmark bench)
+    {
+        byte[][] compressedBlocks = new byte[Lz4BenchBlockCount][];
+        byte[] output = new byte[Lz4BenchBlockSize];
+
+        for (int i = 0; i < compressedBlocks.Length; i++)
+        {
+            compressedBlocks[i] = CreateLz4Block(i, Lz4BenchBlockSize);
+        }
+
+        Func<double, string> resultPrinter = time => GetPerformanceString(time, Lz4BenchBlockSize * Lz4BenchBlockCount);
+
+        bench.Register("LZ4 decompress (byte loop baseline)", () => { }, () =>
+        {
+            foreach (byte[] block in compressedBlocks)
+                DecompressLz4Baseline(block, output);
+        }, resultPrinter);
+
+        bench.Register("LZ4 decompress (allocating)", () => { }, () =>
+        {
+            foreach (byte[] block in compressedBlocks)
+                Lz4.Decompress(block, Lz4BenchBlockSize);
+        }, resultPrinter);
+
+        bench.Register("LZ4 decompress (span)", () => { }, () =>
+        {
+            foreach (byte[] block in compressedBlocks)
+                Lz4.Decompress(block, output.AsSpan());
+        }, resultPrinter);
+    }
+
+    // Times already-normalized paths, which take the vectorized fast path, against paths that need the full checks
+    private static void RegisterPathBenchmarks(MultiBenchmark bench)
+    {
+        byte[][] normalizedPaths =
+        {
+            "/"u8.ToArray(),
+            "/save/0000000000000001/data.bin"u8.ToArray(),
+            "/Nintendo/Contents/registered/000000A1/0123456789abcdef0123456789abcdef.nca"u8.ToArray(),
+            "/Nintendo/save/8000000000000010/directory/with/many/nested/levels/and_a_long_file_name.dat"u8.ToArray()
+        };
+
+        byte[][] unnormalizedPaths =
+        {
+            "/save//0000000000000001/data.bin"u8.ToArray(),
+            "/Nintendo/Contents/./registered/../registered/000000A1/"u8.ToArray(),
+            "sdcard:/Nintendo/Contents/registered/000000A1/0123456789abcdef0123456789abcdef.nca"u8.ToArray(),
+            "/Nintendo\\save\\8000000000000010\\data.dat"u8.ToArray()
+        };
+
+        var flags = new PathFlags();
+        flags.AllowMountName();
+        flags.AllowBackslash();
+
+        Func<double, string> resultPrinter = time =>
+            $"{time * 1_000_000_000 / (PathBenchIterations * normalizedPaths.Length):N1} ns/path";
+
+        bench.Register("Path IsNormalized, normalized", () => { },
+            () => RunPathBench(normalizedPaths, p => PathFormatter.IsNormalized(out _, out _, p, flags)),
+            resultPrinter);
+
+        bench.Register("Path IsNormalized, not normalized", () => { },
+            () => RunPathBench(unnormalizedPaths, p => PathFormatter.IsNormalized(out _, out _, p, flags)),
+            resultPrinter);
+
+        bench.Register("Path Initialize + Normalize, normalized", () => { },
+            () => RunPathBench(normalizedPaths, p => InitializeAndNormalize(p, flags)), resultPrinter);
+
+        bench.Register("Path Initialize + Normalize, not normalized", () => { },
+            () => RunPathBench(unnormalizedPaths, p => InitializeAndNormalize(p, flags)), resultPrinter);
+
+        static Result InitializeAndNormalize(ReadOnlySpan<byte> pathBytes, PathFlags flags)
+        {
+            using var path = new LibHac.Fs.Path();
+
+            Result res = path.Initialize(pathBytes);
+            if (res.IsFailure()) return res;
+
+            return path.Normalize(flags);
+        }
+
+        static void RunPathBench(byte[][] paths, PathBenchFunc func)
+        {
+            for (int i = 0; i < PathBenchIterations; i++)
+            {
+                foreach (byte[] path in paths)
+                {
+                    func(path).ThrowIfFailure();
+                }
+            }
+        }
+    }
+
+    private delegate Result PathBenchFunc(ReadOnlySpan<byte> path);
+
+    // Allocates, caches and frees buffers from every benchmark thread at once to compare lock contention
+    // in the buffer manager's single-lock and sharded modes
+    private static void RegisterBufferManagerBenchmarks(StorageBenchmark bench)
+    {
+        RegisterBufferManagerBenchmark(bench, "FileSystemBufferManager (single lock)", 1);
+        RegisterBufferManagerBenchmark(bench, "FileSystemBufferManager (sharded)", Environment.ProcessorCount);
+    }
+
+    private static void RegisterBufferManagerBenchmark(StorageBenchmark bench, string name, int shardCount)
+    {
+        FileSystemBufferManager sharedManager = null;
+
+        bench.Register(name, (threadIndex, _, pattern) =>
+        {
+            // Thread 0 is always created first, so every thread in a run shares the same buffer manager
+            if (threadIndex == 0)
+            {
+                sharedManager = new FileSystemBufferManager(shardCount);
+                sharedManager.Initialize(BufferManagerBenchCacheCount, new byte[BufferManagerBenchHeapSize], 0x4000)
+                    .ThrowIfFailure();
+            }
+
+            FileSystemBufferManager manager = sharedManager;
+            var random = new Random(threadIndex + 1);
+            ulong[] handles = new ulong[4];
+
+            return operationIndex =>
+            {
+                int slot = (int)(operationIndex % handles.Length);
+
+                LibHac.Mem.Buffer oldBuffer = manager.AcquireCache(handles[slot]);
+                if (!oldBuffer.IsNull)
+                    manager.DeallocateBuffer(oldBuffer);
+
+                int size = pattern == AccessPattern.Sequential ? 0x4000 : 0x4000 << random.Next(3);
+
+                LibHac.Mem.Buffer buffer = manager.AllocateBuffer(size);
+                if (buffer.IsNull)
+                {
+                    handles[slot] = 0;
+                    return 0;
+                }
+
+                handles[slot] = manager.RegisterCache(buffer, new IBufferManager.BufferAttribute());
+                return size;
+            };
+        });
+    }
+
+    /// <summary>
+    /// Creates an LZ4 block made of random sequences with a mix of short and long literals and matches.
+    /// </summary>
+    private static byte[] CreateLz4Block(int seed, int decompressedSize)
+    {
+        var random = new Random(seed);
+        var compressed = new List<byte>();
+
+        int position = 0;
+
+        while (position < decompressedSize)
+        {
+            int remaining = decompressedSize - position;
+            int literalLength = random.Next(4) == 0 ? random.Next(15, 100) : random.Next(position == 0 ? 1 : 0, 15);
+
+            bool isLastSequence = remaining - literalLength < 12;
+            if (isLastSequence)
+                literalLength = remaining;
+
+            int matchLength = Math.Min(random.Next(4) == 0 ? random.Next(19, 300) : random.Next(4, 19),
+                remaining - literalLength - 5);
+
+            compressed.Add((byte)(Math.Min(literalLength, 0xF) << 4 | (isLastSequence ? 0 : Math.Min(matchLength - 4, 0xF))));
+            AddLength(literalLength);
+
+            for (int i = 0; i < literalLength; i++)
+                compressed.Add((byte)random.Next(0x20, 0x80));
+
+            position += literalLength;
+
+            if (isLastSequence)
+                break;
+
+            int matchOffset = Math.Min(random.Next(4) == 0 ? random.Next(1, 16) : random.Next(16, 0x4000), position);
+
+            compressed.Add((byte)matchOffset);
+            compressed.Add((byte)(matchOffset >> 8));
+            AddLength(matchLength - 4);
+
+            position += matchLength;
+        }
+
+        return compressed.ToArray();
+
+        void AddLength(int length)
+        {
+            if (length < 0xF)
+                return;
+
+            for (length -= 0xF; length >= 0xFF; length -= 0xFF)
+                compressed.Add(0xFF);
+
+            compressed.Add((byte)length);
+        }
+    }
+
+    // The byte-at-a-time LZ4 decoder LibHac used before the span-based decoder. Kept as a benchmark baseline.
+    private static void DecompressLz4Baseline(ReadOnlySpan<byte> cmp, Span<byte> dec)
+    {
+        int cmpPos = 0;
+        int decPos = 0;
+
+        do
+        {
+            byte token = cmp[cmpPos++];
+
+            int encCount = (token >> 0) & 0xf;
+            int litCount = GetLength((token >> 4) & 0xf, cmp, ref cmpPos);
+
+            cmp.Slice(cmpPos, litCount).CopyTo(dec.Slice(decPos));
+
+            cmpPos += litCount;
+            decPos += litCount;
+
+            if (cmpPos >= cmp.Length)
+                break;
+
+            int back = cmp[cmpPos++] << 0 | cmp[cmpPos++] << 8;
+
+            encCount = GetLength(encCount, cmp, ref cmpPos) + 4;
+
+            int encPos = decPos - back;
+
+            if (encCount <= back)
+            {
+                dec.Slice(encPos, encCount).CopyTo(dec.Slice(decPos));
+                decPos += encCount;
+            }
+            else
+            {
+                while (encCount-- > 0)
+                {
+                    dec[decPos++] = dec[encPos++];
+                }
+            }
+        } while (cmpPos < cmp.Length && decPos < dec.Length);
+
+        static int GetLength(int length, ReadOnlySpan<byte> cmp, ref int cmpPos)
+        {
+            byte sum;
+
+            if (length == 0xf)
+            {
+                do
+                {
+                    length += sum = cmp[cmpPos++];
+                } while (sum == 0xff);
+            }
+
+            return length;
+        }
+    }
+
+    private static void RunStorageBenchmarks(Context ctx)
+    {
+        var bench = new StorageBenchmark();
+
+        if (ctx.Options.BenchThreadCounts != null)
+            bench.ThreadCounts = ctx.Options.BenchThreadCounts;
+
+        StorageBenchmarkImages.Register(bench, CreateLz4Block);
+        RegisterBufferManagerBenchmarks(bench);
+
+        List<StorageBenchmarkResult> results = bench.Run(ctx.Logger);
+        ctx.Logger.LogMessage(StorageBenchmark.PrintResults(results));
+
+        if (ctx.Options.BenchJsonOut != null)
+        {
+            using var stream = new FileStream(ctx.Options.BenchJsonOut, FileMode.Create, FileAccess.Write);
+            StorageBenchmark.WriteJson(stream, results);
+        }
+
+        if (ctx.Options.BenchBaseline != null)
+        {
+            List<StorageBenchmarkResult> baseline;
+
+            using (var stream = new FileStream(ctx.Options.BenchBaseline, FileMode.Open, FileAccess.Read))
+            {
+                baseline = StorageBenchmark.ReadJson(stream);
+            }
+
+            ctx.Logger.LogMessage("Comparison with baseline:");
+            ctx.Logger.LogMessage(StorageBenchmark.CompareResults(results, baseline, out int regressionCount));
+
+            if (regressionCount > 0)
+                ctx.Logger.LogMessage($"{regressionCount} benchmark(s) regressed compared to the baseline.");
+        }
+    }
+
     private static void RunCipherBenchmark(Func<ICipher> cipherNet, Func<ICipher> cipherLibHac,
         CipherTaskSeparate function, bool benchBlocked, string label, IProgressReport logger)
     {
@@ -510,12 +882,40 @@ internal static class ProcessBench
 
                 RegisterAesSequentialBenchmarks(bench);
                 RegisterAesSingleBlockBenchmarks(bench);
+                RegisterAesSectorBenchmarks(bench);
                 RegisterShaBenchmarks(bench);
+                RegisterShaBlockBenchmarks(bench);
 
                 bench.Run();
                 break;
             }
 
+            case "compression":
+            {
+                var bench = new MultiBenchmark();
+
+                RegisterLz4Benchmarks(bench);
+
+                bench.Run();
+                break;
+            }
+
+            case "path":
+            {
+                var bench = new MultiBenchmark();
+
+                RegisterPathBenchmarks(bench);
+
+                bench.Run();
+                break;
+            }
+
+            case "storage":
+            {
+                RunStorageBenchmarks(ctx);
+                break;
+            }
+
             default:
                 ctx.Logger.LogMessage("Unknown benchmark type.");
                 return;
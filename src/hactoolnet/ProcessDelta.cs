@@ -19,7 +19,7 @@ internal static class ProcessDelta
 
     public static void Process(Context ctx)
     {
-        using (IStorage deltaFile = new LocalStorage(ctx.Options.InFile, FileAccess.Read))
+        using (IStorage deltaFile = new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode))
         {
             IStorage deltaStorage = deltaFile;
             Span<byte> magic = stackalloc byte[4];
@@ -49,7 +49,7 @@ internal static class ProcessDelta
 
             if (ctx.Options.BaseFile != null)
             {
-                using (IStorage baseFile = new LocalStorage(ctx.Options.BaseFile, FileAccess.Read))
+                using (IStorage baseFile = new LocalStorage(ctx.Options.BaseFile, FileAccess.Read, ctx.Options.IoMode))
                 {
                     delta.SetBaseStorage(baseFile);
 
@@ -16,7 +16,7 @@ internal static class ProcessFsBuild
             return;
         }
 
-        LocalFileSystem.Create(out LocalFileSystem localFs, ctx.Options.InFile).ThrowIfFailure();
+        LocalFileSystem.Create(out LocalFileSystem localFs, ctx.Options.InFile, fileIoMode: ctx.Options.IoMode).ThrowIfFailure();
 
         var builder = new RomFsBuilder(localFs);
         IStorage romFs = builder.Build();
@@ -45,10 +45,10 @@ internal static class ProcessFsBuild
             ? PartitionFileSystemType.Hashed
             : PartitionFileSystemType.Standard;
 
-        var localFs = new LocalFileSystem(ctx.Options.InFile);
+        var localFs = new LocalFileSystem(ctx.Options.InFile, ctx.Options.IoMode);
 
         var builder = new PartitionFileSystemBuilder(localFs);
-        IStorage partitionFs = builder.Build(type);
+        IStorage partitionFs = builder.Build(type, ctx.Options.ThreadCount);
 
         ctx.Logger.LogMessage($"Building Partition FS as {ctx.Options.OutFile}");
 
@@ -11,7 +11,7 @@ internal static class ProcessKip
 {
     public static void ProcessKip1(Context ctx)
     {
-        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read));
+        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode));
 
         using var kip = new KipReader();
         kip.Initialize(in file).ThrowIfFailure();
@@ -28,7 +28,7 @@ internal static class ProcessKip
 
     public static void ProcessIni1(Context ctx)
     {
-        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read));
+        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode));
 
         string outDir = ctx.Options.OutDir;
 
@@ -24,7 +24,7 @@ internal static class ProcessNax0
 
         Span<AesXtsKey> keys = ctx.KeySet.SdCardEncryptionKeys;
 
-        using var baseFile = new UniqueRef<IFile>(new LocalFile(ctx.Options.InFile, OpenMode.Read));
+        using var baseFile = new UniqueRef<IFile>(new LocalFile(ctx.Options.InFile, OpenMode.Read, ctx.Options.IoMode));
 
         AesXtsFile xtsFile = null;
         int contentType = 0;
@@ -54,7 +54,7 @@ internal static class ProcessNax0
 
         if (string.IsNullOrWhiteSpace(ctx.Options.PlaintextOut)) return;
 
-        xtsFile.AsStorage().WriteAllBytes(ctx.Options.PlaintextOut, ctx.Logger);
+        xtsFile.AsStorage().WriteAllBytes(ctx.Options.PlaintextOut, ctx.Options.SparseOutput, ctx.Logger);
         ctx.Logger.LogMessage($"Saved Decrypted NAX0 Content to {ctx.Options.PlaintextOut}...");
     }
 
@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.IO;
 using System.Text;
 using LibHac;
@@ -22,9 +23,17 @@ internal static class ProcessNca
 {
     public static void Process(Context ctx)
     {
-        using (IStorage file = new LocalStorage(ctx.Options.InFile, FileAccess.Read))
+        using (IStorage file = new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode))
+        using (WorkerThreadPool readThreadPool = CreateReadThreadPool(ctx))
         {
-            var nca = new Nca(ctx.KeySet, file);
+            // A patched section reads through the patch's relocation and AES-CTR-Ex tables, and either NCA may
+            // also have sparse and compression tables, so the cache is sized for a few trees
+            var nodeCache = new BucketTreeNodeCache(BucketTreeNodeCache.DefaultCapacity * 4);
+
+            var nca = new Nca(ctx.KeySet, file, ctx.StorageTracer);
+            nca.DecompressionThreadCount = GetDecompressionThreadCount(ctx);
+            nca.ReadThreadPool = readThreadPool;
+            nca.NodeCache = nodeCache;
             Nca baseNca = null;
 
             if (ctx.Options.TitleKey != null && nca.Header.HasRightsId)
@@ -48,8 +57,11 @@ internal static class ProcessNca
 
             if (ctx.Options.BaseNca != null)
             {
-                IStorage baseFile = new LocalStorage(ctx.Options.BaseNca, FileAccess.Read);
-                baseNca = new Nca(ctx.KeySet, baseFile);
+                IStorage baseFile = new LocalStorage(ctx.Options.BaseNca, FileAccess.Read, ctx.Options.IoMode);
+                baseNca = new Nca(ctx.KeySet, baseFile, ctx.StorageTracer);
+                baseNca.DecompressionThreadCount = GetDecompressionThreadCount(ctx);
+                baseNca.ReadThreadPool = readThreadPool;
+                baseNca.NodeCache = nodeCache;
 
                 if (ctx.Options.BaseTitleKey != null && baseNca.Header.HasRightsId)
                 {
@@ -78,7 +90,7 @@ internal static class ProcessNca
                     if (Nca.GetSectionTypeFromIndex(i, nca.Header.ContentType) == NcaSectionType.Data && ctx.Options.RomfsOut is not null)
                         continue;
 
-                    OpenStorage(i).WriteAllBytes(ctx.Options.SectionOut[i], ctx.Logger);
+                    WriteStorage(i, ctx.Options.SectionOut[i]);
                 }
 
                 if (ctx.Options.SectionOutDir[i] is not null)
@@ -95,7 +107,7 @@ internal static class ProcessNca
                     string mountName = $"section{i}";
 
                     using var inputFs = new UniqueRef<IFileSystem>(OpenFileSystem(i));
-                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.SectionOutDir[i]));
+                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.SectionOutDir[i], ctx.Options.IoMode));
 
                     fs.Register(mountName.ToU8Span(), ref inputFs.Ref);
                     fs.Register("output"u8, ref outputFs.Ref);
@@ -103,7 +115,8 @@ internal static class ProcessNca
                     fs.Impl.EnableFileSystemAccessorAccessLog(mountName.ToU8Span());
                     fs.Impl.EnableFileSystemAccessorAccessLog("output"u8);
 
-                    FsUtils.CopyDirectoryWithProgress(fs, (mountName + ":/").ToU8Span(), "output:/"u8, logger: ctx.Logger).ThrowIfFailure();
+                    FsUtils.CopyDirectoryWithProgress(fs, (mountName + ":/").ToU8Span(), "output:/"u8, logger: ctx.Logger,
+                        threadCount: ctx.Options.ThreadCount).ThrowIfFailure();
 
                     fs.Unmount(mountName.ToU8Span());
                     fs.Unmount("output"u8);
@@ -113,11 +126,11 @@ internal static class ProcessNca
                 {
                     if (nca.GetFsHeader(i).IsPatchSection() && baseNca != null)
                     {
-                        ncaHolder.Validities[i] = baseNca.VerifySection(nca, i, ctx.Logger);
+                        ncaHolder.Validities[i] = baseNca.VerifySection(nca, i, ctx.Logger, threadCount: ctx.Options.ThreadCount);
                     }
                     else
                     {
-                        ncaHolder.Validities[i] = nca.VerifySection(i, ctx.Logger);
+                        ncaHolder.Validities[i] = nca.VerifySection(i, ctx.Logger, threadCount: ctx.Options.ThreadCount);
                     }
                 }
             }
@@ -142,7 +155,7 @@ internal static class ProcessNca
 
                 if (ctx.Options.RomfsOut != null)
                 {
-                    OpenStorageByType(NcaSectionType.Data).WriteAllBytes(ctx.Options.RomfsOut, ctx.Logger);
+                    WriteStorage(Nca.GetSectionIndexFromType(NcaSectionType.Data, nca.Header.ContentType), ctx.Options.RomfsOut);
                 }
 
                 if (ctx.Options.RomfsOutDir != null)
@@ -150,7 +163,7 @@ internal static class ProcessNca
                     FileSystemClient fs = ctx.Horizon.Fs;
 
                     using var inputFs = new UniqueRef<IFileSystem>(OpenFileSystemByType(NcaSectionType.Data));
-                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.RomfsOutDir));
+                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.RomfsOutDir, ctx.Options.IoMode));
 
                     fs.Register("rom"u8, ref inputFs.Ref);
                     fs.Register("output"u8, ref outputFs.Ref);
@@ -158,7 +171,8 @@ internal static class ProcessNca
                     fs.Impl.EnableFileSystemAccessorAccessLog("rom"u8);
                     fs.Impl.EnableFileSystemAccessorAccessLog("output"u8);
 
-                    FsUtils.CopyDirectoryWithProgress(fs, "rom:/"u8, "output:/"u8, logger: ctx.Logger).ThrowIfFailure();
+                    FsUtils.CopyDirectoryWithProgress(fs, "rom:/"u8, "output:/"u8, logger: ctx.Logger,
+                        threadCount: ctx.Options.ThreadCount).ThrowIfFailure();
 
                     fs.Unmount("rom"u8);
                     fs.Unmount("output"u8);
@@ -205,7 +219,7 @@ internal static class ProcessNca
 
                 if (ctx.Options.ExefsOut != null)
                 {
-                    OpenStorageByType(NcaSectionType.Code).WriteAllBytes(ctx.Options.ExefsOut, ctx.Logger);
+                    WriteStorage(Nca.GetSectionIndexFromType(NcaSectionType.Code, nca.Header.ContentType), ctx.Options.ExefsOut);
                 }
 
                 if (ctx.Options.ExefsOutDir != null)
@@ -213,7 +227,7 @@ internal static class ProcessNca
                     FileSystemClient fs = ctx.Horizon.Fs;
 
                     using var inputFs = new UniqueRef<IFileSystem>(OpenFileSystemByType(NcaSectionType.Code));
-                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.ExefsOutDir));
+                    using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.ExefsOutDir, ctx.Options.IoMode));
 
                     fs.Register("code"u8, ref inputFs.Ref);
                     fs.Register("output"u8, ref outputFs.Ref);
@@ -221,7 +235,8 @@ internal static class ProcessNca
                     fs.Impl.EnableFileSystemAccessorAccessLog("code"u8);
                     fs.Impl.EnableFileSystemAccessorAccessLog("output"u8);
 
-                    FsUtils.CopyDirectoryWithProgress(fs, "code:/"u8, "output:/"u8, logger: ctx.Logger).ThrowIfFailure();
+                    FsUtils.CopyDirectoryWithProgress(fs, "code:/"u8, "output:/"u8, logger: ctx.Logger,
+                        threadCount: ctx.Options.ThreadCount).ThrowIfFailure();
 
                     fs.Unmount("code"u8);
                     fs.Unmount("output"u8);
@@ -230,12 +245,12 @@ internal static class ProcessNca
 
             if (ctx.Options.PlaintextOut != null)
             {
-                nca.OpenDecryptedNca().WriteAllBytes(ctx.Options.PlaintextOut, ctx.Logger);
+                nca.OpenDecryptedNca().WriteAllBytes(ctx.Options.PlaintextOut, ctx.Options.SparseOutput, ctx.Logger);
             }
 
             if (ctx.Options.CiphertextOut != null)
             {
-                nca.OpenEncryptedNca().WriteAllBytes(ctx.Options.CiphertextOut, ctx.Logger);
+                nca.OpenEncryptedNca().WriteAllBytes(ctx.Options.CiphertextOut, ctx.Options.SparseOutput, ctx.Logger);
             }
 
             if (!ctx.Options.ReadBench) ctx.Logger.LogMessage(ncaHolder.Print(ctx.Options));
@@ -254,6 +269,21 @@ internal static class ProcessNca
                 return nca.OpenStorage(index, ctx.Options.IntegrityLevel);
             }
 
+            void WriteStorage(int index, string path)
+            {
+                // The ranges removed by a sparse layer are hidden beneath the decryption and verification layers,
+                // so get them from the NCA. They don't map onto a section merged with a base NCA, so skip them then.
+                List<(long Offset, long Size)> zeroRanges = null;
+
+                if (ctx.Options.SparseOutput && baseNca == null)
+                {
+                    zeroRanges = new List<(long Offset, long Size)>();
+                    nca.GetSparseZeroRanges(index, ctx.Options.Raw, zeroRanges);
+                }
+
+                OpenStorage(index).WriteAllBytes(path, ctx.Options.SparseOutput, zeroRanges, ctx.Logger);
+            }
+
             IFileSystem OpenFileSystem(int index)
             {
                 if (baseNca != null) return baseNca.OpenFileSystemWithPatch(nca, index, ctx.Options.IntegrityLevel);
@@ -273,6 +303,21 @@ internal static class ProcessNca
         }
     }
 
+    // Extraction and verification already run --threads workers, so split the cores between them
+    // instead of letting every worker decompress on all of them.
+    private static int GetDecompressionThreadCount(Context ctx)
+    {
+        return Math.Max(1, Environment.ProcessorCount / ctx.Options.ThreadCount);
+    }
+
+    // Large section reads are split across the same share of the cores. The thread doing the read
+    // also reads part of it, so the pool needs one less thread.
+    private static WorkerThreadPool CreateReadThreadPool(Context ctx)
+    {
+        int threadCount = GetDecompressionThreadCount(ctx) - 1;
+        return threadCount > 0 ? new WorkerThreadPool(threadCount) : null;
+    }
+
     private static bool TryAddTitleKey(KeySet keySet, ReadOnlySpan<byte> key, ReadOnlySpan<byte> rightsId)
     {
         if (key.Length != 32)
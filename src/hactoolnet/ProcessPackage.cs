@@ -17,7 +17,7 @@ internal static class ProcessPackage
 {
     public static void ProcessPk11(Context ctx)
     {
-        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read));
+        using var file = new SharedRef<IStorage>(new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode));
 
         var package1 = new Package1();
         package1.Initialize(ctx.KeySet, in file).ThrowIfFailure();
@@ -121,7 +121,7 @@ internal static class ProcessPackage
 
     public static void ProcessPk21(Context ctx)
     {
-        using var file = new SharedRef<IStorage>(new CachedStorage(new LocalStorage(ctx.Options.InFile, FileAccess.Read), 0x4000, 4, false));
+        using var file = new SharedRef<IStorage>(new CachedStorage(new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode), 0x4000, 4, false));
 
         using var package2 = new Package2StorageReader();
         package2.Initialize(ctx.KeySet, in file).ThrowIfFailure();
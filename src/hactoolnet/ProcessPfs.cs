@@ -21,7 +21,7 @@ internal static class ProcessPfs
 {
     public static void Process(Context ctx)
     {
-        using var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read);
+        using var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode);
 
         IFileSystem fs = null;
         using UniqueRef<PartitionFileSystem> pfs = new UniqueRef<PartitionFileSystem>();
@@ -59,7 +59,7 @@ internal static class ProcessPfs
 
         if (ctx.Options.OutDir != null)
         {
-            fs.Extract(ctx.Options.OutDir, ctx.Logger);
+            fs.Extract(ctx.Options.OutDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (fs.EnumerateEntries("*.nca", SearchOptions.Default).Any())
@@ -11,7 +11,7 @@ internal static class ProcessRomfs
 {
     public static void Process(Context ctx)
     {
-        using (var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read))
+        using (var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode))
         {
             Process(ctx, file);
         }
@@ -41,7 +41,7 @@ internal static class ProcessRomfs
 
         if (ctx.Options.RomfsOutDir != null)
         {
-            romfs.Extract(ctx.Options.RomfsOutDir, ctx.Logger);
+            romfs.Extract(ctx.Options.RomfsOutDir, ctx.Logger, ctx.Options.ThreadCount);
         }
     }
 }
\ No newline at end of file
@@ -30,7 +30,7 @@ internal static class ProcessSave
             accessNeeded = FileAccess.ReadWrite;
         }
 
-        using (var file = new LocalStorage(ctx.Options.InFile, accessNeeded))
+        using (var file = new LocalStorage(ctx.Options.InFile, accessNeeded, ctx.Options.IoMode))
         {
             bool signNeeded = ctx.Options.SignSave;
 
@@ -48,7 +48,7 @@ internal static class ProcessSave
 
             if (ctx.Options.OutDir != null)
             {
-                using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.OutDir));
+                using var outputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.OutDir, ctx.Options.IoMode));
                 fs.Register("output"u8, ref outputFs.Ref);
                 fs.Impl.EnableFileSystemAccessorAccessLog("output"u8);
 
@@ -71,7 +71,7 @@ internal static class ProcessSave
                     string destFilename = ctx.Options.ReplaceFileDest;
                     if (!destFilename.StartsWith("/")) destFilename = '/' + destFilename;
 
-                    using var inFile = new UniqueRef<IFile>(new LocalFile(ctx.Options.ReplaceFileSource, OpenMode.Read));
+                    using var inFile = new UniqueRef<IFile>(new LocalFile(ctx.Options.ReplaceFileSource, OpenMode.Read, ctx.Options.IoMode));
 
                     using var outFile = new UniqueRef<IFile>();
                     save.OpenFile(ref outFile.Ref, destFilename.ToU8Span(), OpenMode.ReadWrite).ThrowIfFailure();
@@ -93,7 +93,7 @@ internal static class ProcessSave
 
                 if (ctx.Options.RepackSource != null)
                 {
-                    using var inputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.RepackSource));
+                    using var inputFs = new UniqueRef<IFileSystem>(new LocalFileSystem(ctx.Options.RepackSource, ctx.Options.IoMode));
                     fs.Register("input"u8, ref inputFs.Ref);
                     fs.Impl.EnableFileSystemAccessorAccessLog("input"u8);
 
@@ -173,74 +173,74 @@ internal static class ProcessSave
         string mainRemapDir = Path.Combine(dir, "main_remap");
         Directory.CreateDirectory(mainRemapDir);
 
-        save.DataRemapStorage.GetBaseStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Data"));
-        save.DataRemapStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Header"));
-        save.DataRemapStorage.GetMapEntryStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Map entries"));
+        save.DataRemapStorage.GetBaseStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Data"), ctx.Options.SparseOutput);
+        save.DataRemapStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Header"), ctx.Options.SparseOutput);
+        save.DataRemapStorage.GetMapEntryStorage().WriteAllBytes(Path.Combine(mainRemapDir, "Map entries"), ctx.Options.SparseOutput);
 
         string metadataRemapDir = Path.Combine(dir, "metadata_remap");
         Directory.CreateDirectory(metadataRemapDir);
 
-        save.MetaRemapStorage.GetBaseStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Data"));
-        save.MetaRemapStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Header"));
-        save.MetaRemapStorage.GetMapEntryStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Map entries"));
+        save.MetaRemapStorage.GetBaseStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Data"), ctx.Options.SparseOutput);
+        save.MetaRemapStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Header"), ctx.Options.SparseOutput);
+        save.MetaRemapStorage.GetMapEntryStorage().WriteAllBytes(Path.Combine(metadataRemapDir, "Map entries"), ctx.Options.SparseOutput);
 
         string journalDir = Path.Combine(dir, "journal");
         Directory.CreateDirectory(journalDir);
 
-        save.JournalStorage.GetBaseStorage().WriteAllBytes(Path.Combine(journalDir, "Data"));
-        save.JournalStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(journalDir, "Header"));
-        save.JournalStorage.Map.GetHeaderStorage().WriteAllBytes(Path.Combine(journalDir, "Map_header"));
-        save.JournalStorage.Map.GetMapStorage().WriteAllBytes(Path.Combine(journalDir, "Map"));
+        save.JournalStorage.GetBaseStorage().WriteAllBytes(Path.Combine(journalDir, "Data"), ctx.Options.SparseOutput);
+        save.JournalStorage.GetHeaderStorage().WriteAllBytes(Path.Combine(journalDir, "Header"), ctx.Options.SparseOutput);
+        save.JournalStorage.Map.GetHeaderStorage().WriteAllBytes(Path.Combine(journalDir, "Map_header"), ctx.Options.SparseOutput);
+        save.JournalStorage.Map.GetMapStorage().WriteAllBytes(Path.Combine(journalDir, "Map"), ctx.Options.SparseOutput);
         save.JournalStorage.Map.GetModifiedPhysicalBlocksStorage()
-            .WriteAllBytes(Path.Combine(journalDir, "ModifiedPhysicalBlocks"));
+            .WriteAllBytes(Path.Combine(journalDir, "ModifiedPhysicalBlocks"), ctx.Options.SparseOutput);
         save.JournalStorage.Map.GetModifiedVirtualBlocksStorage()
-            .WriteAllBytes(Path.Combine(journalDir, "ModifiedVirtualBlocks"));
-        save.JournalStorage.Map.GetFreeBlocksStorage().WriteAllBytes(Path.Combine(journalDir, "FreeBlocks"));
+            .WriteAllBytes(Path.Combine(journalDir, "ModifiedVirtualBlocks"), ctx.Options.SparseOutput);
+        save.JournalStorage.Map.GetFreeBlocksStorage().WriteAllBytes(Path.Combine(journalDir, "FreeBlocks"), ctx.Options.SparseOutput);
 
         string saveDir = Path.Combine(dir, "save");
         Directory.CreateDirectory(saveDir);
 
-        save.SaveDataFileSystemCore.GetHeaderStorage().WriteAllBytes(Path.Combine(saveDir, "Save_Header"));
-        save.SaveDataFileSystemCore.GetBaseStorage().WriteAllBytes(Path.Combine(saveDir, "Save_Data"));
-        save.SaveDataFileSystemCore.AllocationTable.GetHeaderStorage().WriteAllBytes(Path.Combine(saveDir, "FAT_header"));
-        save.SaveDataFileSystemCore.AllocationTable.GetBaseStorage().WriteAllBytes(Path.Combine(saveDir, "FAT_Data"));
+        save.SaveDataFileSystemCore.GetHeaderStorage().WriteAllBytes(Path.Combine(saveDir, "Save_Header"), ctx.Options.SparseOutput);
+        save.SaveDataFileSystemCore.GetBaseStorage().WriteAllBytes(Path.Combine(saveDir, "Save_Data"), ctx.Options.SparseOutput);
+        save.SaveDataFileSystemCore.AllocationTable.GetHeaderStorage().WriteAllBytes(Path.Combine(saveDir, "FAT_header"), ctx.Options.SparseOutput);
+        save.SaveDataFileSystemCore.AllocationTable.GetBaseStorage().WriteAllBytes(Path.Combine(saveDir, "FAT_Data"), ctx.Options.SparseOutput);
 
-        save.Header.DataIvfcMaster.WriteAllBytes(Path.Combine(saveDir, "Save_MasterHash"));
+        save.Header.DataIvfcMaster.WriteAllBytes(Path.Combine(saveDir, "Save_MasterHash"), ctx.Options.SparseOutput);
 
         IStorage saveLayer1Hash = save.MetaRemapStorage.Slice(layout.IvfcL1Offset, layout.IvfcL1Size);
         IStorage saveLayer2Hash = save.MetaRemapStorage.Slice(layout.IvfcL2Offset, layout.IvfcL2Size);
         IStorage saveLayer3Hash = save.MetaRemapStorage.Slice(layout.IvfcL3Offset, layout.IvfcL3Size);
 
-        saveLayer1Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer1Hash"), ctx.Logger);
-        saveLayer2Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer2Hash"), ctx.Logger);
-        saveLayer3Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer3Hash"), ctx.Logger);
+        saveLayer1Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer1Hash"), ctx.Options.SparseOutput, ctx.Logger);
+        saveLayer2Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer2Hash"), ctx.Options.SparseOutput, ctx.Logger);
+        saveLayer3Hash.WriteAllBytes(Path.Combine(saveDir, "Save_Layer3Hash"), ctx.Options.SparseOutput, ctx.Logger);
 
         if (layout.Version >= 0x50000)
         {
-            save.Header.FatIvfcMaster.WriteAllBytes(Path.Combine(saveDir, "Fat_MasterHash"));
+            save.Header.FatIvfcMaster.WriteAllBytes(Path.Combine(saveDir, "Fat_MasterHash"), ctx.Options.SparseOutput);
 
             IStorage fatLayer1Hash = save.MetaRemapStorage.Slice(layout.FatIvfcL1Offset, layout.FatIvfcL1Size);
             IStorage fatLayer2Hash = save.MetaRemapStorage.Slice(layout.FatIvfcL2Offset, layout.FatIvfcL1Size);
 
-            fatLayer1Hash.WriteAllBytes(Path.Combine(saveDir, "Fat_Layer1Hash"), ctx.Logger);
-            fatLayer2Hash.WriteAllBytes(Path.Combine(saveDir, "Fat_Layer2Hash"), ctx.Logger);
+            fatLayer1Hash.WriteAllBytes(Path.Combine(saveDir, "Fat_Layer1Hash"), ctx.Options.SparseOutput, ctx.Logger);
+            fatLayer2Hash.WriteAllBytes(Path.Combine(saveDir, "Fat_Layer2Hash"), ctx.Options.SparseOutput, ctx.Logger);
         }
 
         string duplexDir = Path.Combine(dir, "duplex");
         Directory.CreateDirectory(duplexDir);
 
-        save.Header.DuplexMasterBitmapA.WriteAllBytes(Path.Combine(duplexDir, "MasterBitmapA"));
-        save.Header.DuplexMasterBitmapB.WriteAllBytes(Path.Combine(duplexDir, "MasterBitmapB"));
+        save.Header.DuplexMasterBitmapA.WriteAllBytes(Path.Combine(duplexDir, "MasterBitmapA"), ctx.Options.SparseOutput);
+        save.Header.DuplexMasterBitmapB.WriteAllBytes(Path.Combine(duplexDir, "MasterBitmapB"), ctx.Options.SparseOutput);
 
         IStorage duplexL1A = save.DataRemapStorage.Slice(layout.DuplexL1OffsetA, layout.DuplexL1Size);
         IStorage duplexL1B = save.DataRemapStorage.Slice(layout.DuplexL1OffsetB, layout.DuplexL1Size);
         IStorage duplexDataA = save.DataRemapStorage.Slice(layout.DuplexDataOffsetA, layout.DuplexDataSize);
         IStorage duplexDataB = save.DataRemapStorage.Slice(layout.DuplexDataOffsetB, layout.DuplexDataSize);
 
-        duplexL1A.WriteAllBytes(Path.Combine(duplexDir, "L1BitmapA"), ctx.Logger);
-        duplexL1B.WriteAllBytes(Path.Combine(duplexDir, "L1BitmapB"), ctx.Logger);
-        duplexDataA.WriteAllBytes(Path.Combine(duplexDir, "DataA"), ctx.Logger);
-        duplexDataB.WriteAllBytes(Path.Combine(duplexDir, "DataB"), ctx.Logger);
+        duplexL1A.WriteAllBytes(Path.Combine(duplexDir, "L1BitmapA"), ctx.Options.SparseOutput, ctx.Logger);
+        duplexL1B.WriteAllBytes(Path.Combine(duplexDir, "L1BitmapB"), ctx.Options.SparseOutput, ctx.Logger);
+        duplexDataA.WriteAllBytes(Path.Combine(duplexDir, "DataA"), ctx.Options.SparseOutput, ctx.Logger);
+        duplexDataB.WriteAllBytes(Path.Combine(duplexDir, "DataB"), ctx.Options.SparseOutput, ctx.Logger);
     }
 
     // ReSharper disable once UnusedMember.Local
@@ -22,26 +22,39 @@ internal static class ProcessSwitchFs
     public static void Process(Context ctx)
     {
         SwitchFs switchFs;
-        using var baseFs = new UniqueRef<IAttributeFileSystem>(new LocalFileSystem(ctx.Options.InFile));
+        int threadCount = ctx.Options.ThreadCount;
+        SwitchFsMetadataCache metadataCache = null;
+
+        if (ctx.Options.MetadataCache != null)
+        {
+            metadataCache = SwitchFsMetadataCache.Load(ctx.Options.MetadataCache);
+        }
+
+        using var baseFs = new UniqueRef<IAttributeFileSystem>(new LocalFileSystem(ctx.Options.InFile, ctx.Options.IoMode));
 
         if (Directory.Exists(Path.Combine(ctx.Options.InFile, "Nintendo", "Contents", "registered")))
         {
             ctx.Logger.LogMessage("Treating path as SD card storage");
-            switchFs = SwitchFs.OpenSdCard(ctx.KeySet, ref baseFs.Ref);
+            switchFs = SwitchFs.OpenSdCard(ctx.KeySet, ref baseFs.Ref, threadCount, metadataCache);
 
             CheckForNcaFolders(ctx, switchFs);
         }
         else if (Directory.Exists(Path.Combine(ctx.Options.InFile, "Contents", "registered")))
         {
             ctx.Logger.LogMessage("Treating path as NAND storage");
-            switchFs = SwitchFs.OpenNandPartition(ctx.KeySet, ref baseFs.Ref);
+            switchFs = SwitchFs.OpenNandPartition(ctx.KeySet, ref baseFs.Ref, threadCount, metadataCache);
 
             CheckForNcaFolders(ctx, switchFs);
         }
         else
         {
             ctx.Logger.LogMessage("Treating path as a directory of loose NCAs");
-            switchFs = SwitchFs.OpenNcaDirectory(ctx.KeySet, baseFs.Get);
+            switchFs = SwitchFs.OpenNcaDirectory(ctx.KeySet, baseFs.Get, threadCount, metadataCache);
+        }
+
+        if (metadataCache is { IsModified: true })
+        {
+            metadataCache.Save(ctx.Options.MetadataCache);
         }
 
         if (ctx.Options.ListNcas)
@@ -94,7 +107,7 @@ internal static class ProcessSwitchFs
 
             if (ctx.Options.ExefsOut != null)
             {
-                title.MainNca.OpenStorage(NcaSectionType.Code, ctx.Options.IntegrityLevel).WriteAllBytes(ctx.Options.ExefsOut, ctx.Logger);
+                title.MainNca.OpenStorage(NcaSectionType.Code, ctx.Options.IntegrityLevel).WriteAllBytes(ctx.Options.ExefsOut, ctx.Options.SparseOutput, ctx.Logger);
             }
         }
 
@@ -194,7 +207,7 @@ internal static class ProcessSwitchFs
             {
                 ctx.Logger.LogMessage($"    {nca.Nca.Header.ContentType.Print()}");
 
-                Validity validity = nca.VerifyNca(ctx.Logger, true);
+                Validity validity = nca.VerifyNca(ctx.Logger, true, ctx.Options.ThreadCount);
 
                 ctx.Logger.LogMessage($"      {validity.Print()}");
             }
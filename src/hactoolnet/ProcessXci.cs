@@ -18,34 +18,34 @@ internal static class ProcessXci
 {
     public static void Process(Context ctx)
     {
-        using var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read);
+        using var file = new LocalStorage(ctx.Options.InFile, FileAccess.Read, ctx.Options.IoMode);
         var xci = new Xci(ctx.KeySet, file);
 
         ctx.Logger.LogMessage(xci.Print());
 
         if (ctx.Options.RootDir != null)
         {
-            xci.OpenPartition(XciPartitionType.Root).Extract(ctx.Options.RootDir, ctx.Logger);
+            xci.OpenPartition(XciPartitionType.Root).Extract(ctx.Options.RootDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (ctx.Options.UpdateDir != null && xci.HasPartition(XciPartitionType.Update))
         {
-            xci.OpenPartition(XciPartitionType.Update).Extract(ctx.Options.UpdateDir, ctx.Logger);
+            xci.OpenPartition(XciPartitionType.Update).Extract(ctx.Options.UpdateDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (ctx.Options.NormalDir != null && xci.HasPartition(XciPartitionType.Normal))
         {
-            xci.OpenPartition(XciPartitionType.Normal).Extract(ctx.Options.NormalDir, ctx.Logger);
+            xci.OpenPartition(XciPartitionType.Normal).Extract(ctx.Options.NormalDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (ctx.Options.SecureDir != null && xci.HasPartition(XciPartitionType.Secure))
         {
-            xci.OpenPartition(XciPartitionType.Secure).Extract(ctx.Options.SecureDir, ctx.Logger);
+            xci.OpenPartition(XciPartitionType.Secure).Extract(ctx.Options.SecureDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (ctx.Options.LogoDir != null && xci.HasPartition(XciPartitionType.Logo))
         {
-            xci.OpenPartition(XciPartitionType.Logo).Extract(ctx.Options.LogoDir, ctx.Logger);
+            xci.OpenPartition(XciPartitionType.Logo).Extract(ctx.Options.LogoDir, ctx.Logger, ctx.Options.ThreadCount);
         }
 
         if (ctx.Options.OutDir != null)
@@ -66,7 +66,7 @@ internal static class ProcessXci
                 subPfs.Get.Initialize(subPfsFile.Get.AsStorage()).ThrowIfFailure();
 
                 string subDir = System.IO.Path.Combine(ctx.Options.OutDir, sub.Name);
-                subPfs.Get.Extract(subDir, ctx.Logger);
+                subPfs.Get.Extract(subDir, ctx.Logger, ctx.Options.ThreadCount);
             }
         }
 
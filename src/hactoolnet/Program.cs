@@ -8,6 +8,7 @@ using LibHac.Diag;
 using LibHac.Fs;
 using LibHac.Util;
 using Path = System.IO.Path;
+using StorageTracer = LibHac.FsSystem.StorageTracer;
 
 namespace hactoolnet;
 
@@ -107,7 +108,18 @@ public static class Program
                     return true;
                 }
 
+                if (ctx.Options.StorageTrace)
+                {
+                    ctx.StorageTracer = new StorageTracer();
+                }
+
                 RunTask(ctx);
+
+                if (ctx.StorageTracer != null)
+                {
+                    StorageTraceReport.Print(ctx.StorageTracer.GetSnapshot(), logger);
+                    ctx.StorageTracer.Dispose();
+                }
             }
         }
         finally
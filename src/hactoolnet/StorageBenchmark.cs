@@ -0,0 +1,386 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Runtime.ExceptionServices;
+using System.Text.Json;
+using System.Threading;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Util;
+
+namespace hactoolnet;
+
+internal enum AccessPattern
+{
+    Sequential,
+    Random
+}
+
+/// <summary>
+/// Runs workloads against storage stacks with each combination of access pattern and thread count,
+/// recording the latency of every operation.
+/// </summary>
+/// <remarks>Each thread gets its own operation from the benchmark's <see cref="OperationFactory"/>. The threads
+/// run a short warmup, wait for each other, and then run <see cref="OperationCount"/> operations each.
+/// Results can be written to and compared against a JSON file so runs from different versions can be compared.</remarks>
+internal class StorageBenchmark
+{
+    private const int FormatVersion = 1;
+    private const int RandomSeed = 0x4C48;
+
+    // A benchmark has regressed if its throughput drops or its p99 latency rises by more than these fractions
+    private const double ThroughputRegressionThreshold = 0.10;
+    private const double LatencyRegressionThreshold = 0.25;
+
+    /// <summary>
+    /// Runs a single operation and returns the number of bytes it processed.
+    /// </summary>
+    public delegate long Operation(long operationIndex);
+
+    /// <summary>
+    /// Creates the operation that will be run by a single benchmark thread.
+    /// </summary>
+    public delegate Operation OperationFactory(int threadIndex, int threadCount, AccessPattern pattern);
+
+    public int OperationCount { get; set; } = 2000;
+    public int[] ThreadCounts { get; set; } = [1];
+
+    private List<BenchmarkItem> Benchmarks { get; } = new List<BenchmarkItem>();
+
+    public void Register(string name, OperationFactory operationFactory)
+    {
+        Benchmarks.Add(new BenchmarkItem { Name = name, CreateOperation = operationFactory });
+    }
+
+    /// <summary>
+    /// Registers a benchmark that reads fixed-size blocks from a storage.
+    /// </summary>
+    /// <param name="name">The name of the benchmark.</param>
+    /// <param name="storageFactory">Creates the storage stack to read from.</param>
+    /// <param name="isThreadSafe">If <see langword="true"/>, a single storage is created for each run and
+    /// shared between all threads. Otherwise, each thread creates its own storage.</param>
+    /// <param name="readSize">The size of each read.</param>
+    public void RegisterStorage(string name, Func<IStorage> storageFactory, bool isThreadSafe, int readSize)
+    {
+        IStorage sharedStorage = null;
+
+        Register(name, (threadIndex, threadCount, pattern) =>
+        {
+            IStorage storage;
+
+            if (isThreadSafe)
+            {
+                // Thread 0 is always created first so the storage is created before any other thread uses it
+                if (threadIndex == 0)
+                    sharedStorage = storageFactory();
+
+                storage = sharedStorage;
+            }
+            else
+            {
+                storage = storageFactory();
+            }
+
+            storage.GetSize(out long storageSize).ThrowIfFailure();
+
+            byte[] buffer = new byte[readSize];
+            long blockCount = storageSize / readSize;
+
+            // Each thread reads sequentially from a different part of the storage
+            long startBlock = blockCount * threadIndex / threadCount;
+            var random = new Random(RandomSeed + threadIndex);
+
+            return operationIndex =>
+            {
+                long block = pattern == AccessPattern.Sequential
+                    ? (startBlock + operationIndex) % blockCount
+                    : random.NextInt64(blockCount);
+
+                storage.Read(block * readSize, buffer).ThrowIfFailure();
+                return readSize;
+            };
+        });
+    }
+
+    public List<StorageBenchmarkResult> Run(IProgressReport logger)
+    {
+        var results = new List<StorageBenchmarkResult>();
+
+        foreach (BenchmarkItem item in Benchmarks)
+        {
+            foreach (AccessPattern pattern in new[] { AccessPattern.Sequential, AccessPattern.Random })
+            {
+                foreach (int threadCount in ThreadCounts)
+                {
+                    logger?.LogMessage($"Running {item.Name} ({GetPatternName(pattern)}, {threadCount} thread(s))");
+                    results.Add(RunBenchmark(item, pattern, threadCount));
+                }
+            }
+        }
+
+        return results;
+    }
+
+    private StorageBenchmarkResult RunBenchmark(BenchmarkItem item, AccessPattern pattern, int threadCount)
+    {
+        int operationCount = OperationCount;
+        int warmupCount = Math.Max(operationCount / 10, 1);
+
+        // Create the operations in thread order so thread 0 can set up anything shared
+        var operations = new Operation[threadCount];
+        for (int i = 0; i < threadCount; i++)
+        {
+            operations[i] = item.CreateOperation(i, threadCount, pattern);
+        }
+
+        long[][] latencies = new long[threadCount][];
+        long[] bytesProcessed = new long[threadCount];
+        var exceptions = new Exception[threadCount];
+        var threads = new System.Threading.Thread[threadCount];
+
+        using var startBarrier = new Barrier(threadCount + 1);
+
+        for (int i = 0; i < threadCount; i++)
+        {
+            int threadIndex = i;
+
+            threads[i] = new System.Threading.Thread(() =>
+            {
+                Operation operation = operations[threadIndex];
+                long[] threadLatencies = new long[operationCount];
+                long bytes = 0;
+                bool isWaitingForStart = true;
+
+                try
+                {
+                    for (int op = 0; op < warmupCount; op++)
+                    {
+                        operation(op);
+                    }
+
+                    startBarrier.SignalAndWait();
+                    isWaitingForStart = false;
+
+                    for (int op = 0; op < operationCount; op++)
+                    {
+                        long startTime = Stopwatch.GetTimestamp();
+                        bytes += operation(warmupCount + op);
+                        threadLatencies[op] = Stopwatch.GetTimestamp() - startTime;
+                    }
+                }
+                catch (Exception ex)
+                {
+                    exceptions[threadIndex] = ex;
+
+                    if (isWaitingForStart)
+                        startBarrier.RemoveParticipant();
+                }
+
+                latencies[threadIndex] = threadLatencies;
+                bytesProcessed[threadIndex] = bytes;
+            });
+
+            threads[i].Start();
+        }
+
+        startBarrier.SignalAndWait();
+        long runStartTime = Stopwatch.GetTimestamp();
+
+        foreach (System.Threading.Thread thread in threads)
+        {
+            thread.Join();
+        }
+
+        long elapsedTicks = Stopwatch.GetTimestamp() - runStartTime;
+
+        Exception exception = exceptions.FirstOrDefault(e => e is not null);
+        if (exception is not null)
+            ExceptionDispatchInfo.Capture(exception).Throw();
+
+        long[] allLatencies = latencies.SelectMany(l => l).ToArray();
+        Array.Sort(allLatencies);
+
+        double seconds = (double)elapsedTicks / Stopwatch.Frequency;
+        long totalBytes = bytesProcessed.Sum();
+
+        return new StorageBenchmarkResult
+        {
+            Name = item.Name,
+            Pattern = GetPatternName(pattern),
+            ThreadCount = threadCount,
+            OperationCount = allLatencies.Length,
+            TotalBytes = totalBytes,
+            Seconds = seconds,
+            BytesPerSecond = totalBytes / seconds,
+            OperationsPerSecond = allLatencies.Length / seconds,
+            P50Microseconds = GetPercentileMicroseconds(allLatencies, 0.50),
+            P99Microseconds = GetPercentileMicroseconds(allLatencies, 0.99)
+        };
+    }
+
+    private static double GetPercentileMicroseconds(long[] sortedTicks, double percentile)
+    {
+        if (sortedTicks.Length == 0)
+            return 0;
+
+        // Nearest-rank percentile
+        int index = Math.Max((int)Math.Ceiling(percentile * sortedTicks.Length) - 1, 0);
+        return sortedTicks[index] * 1_000_000.0 / Stopwatch.Frequency;
+    }
+
+    private static string GetPatternName(AccessPattern pattern) =>
+        pattern == AccessPattern.Sequential ? "sequential" : "random";
+
+    public static string PrintResults(List<StorageBenchmarkResult> results)
+    {
+        var table = new TableBuilder("Benchmark", "Pattern", "Threads", "Throughput", "Ops/s", "p50 (us)", "p99 (us)");
+
+        foreach (StorageBenchmarkResult result in results)
+        {
+            string throughput = result.TotalBytes == 0
+                ? "-"
+                : Utilities.GetBytesReadable((long)result.BytesPerSecond) + "/s";
+
+            table.AddRow(result.Name, result.Pattern, result.ThreadCount.ToString(), throughput,
+                result.OperationsPerSecond.ToString("F0", CultureInfo.InvariantCulture),
+                result.P50Microseconds.ToString("F1", CultureInfo.InvariantCulture),
+                result.P99Microseconds.ToString("F1", CultureInfo.InvariantCulture));
+        }
+
+        return table.Print();
+    }
+
+    /// <summary>
+    /// Compares results against the results from a previous run. A result is compared against the
+    /// baseline result with the same name, access pattern and thread count.
+    /// </summary>
+    /// <param name="results">The results of the current run.</param>
+    /// <param name="baseline">The results to compare against.</param>
+    /// <param name="regressionCount">The number of results that were significantly slower than the baseline.</param>
+    /// <returns>A table showing the difference between each result and its baseline.</returns>
+    public static string CompareResults(List<StorageBenchmarkResult> results, List<StorageBenchmarkResult> baseline,
+        out int regressionCount)
+    {
+        var table = new TableBuilder("Benchmark", "Pattern", "Threads", "Ops/s change", "p99 change", "");
+        regressionCount = 0;
+
+        foreach (StorageBenchmarkResult result in results)
+        {
+            StorageBenchmarkResult baseResult = baseline.FirstOrDefault(b =>
+                b.Name == result.Name && b.Pattern == result.Pattern && b.ThreadCount == result.ThreadCount);
+
+            if (baseResult is null)
+            {
+                table.AddRow(result.Name, result.Pattern, result.ThreadCount.ToString(), "-", "-", "(new)");
+                continue;
+            }
+
+            double throughputChange = result.OperationsPerSecond / baseResult.OperationsPerSecond - 1;
+            double latencyChange = result.P99Microseconds / baseResult.P99Microseconds - 1;
+
+            bool isRegression = throughputChange < -ThroughputRegressionThreshold ||
+                                latencyChange > LatencyRegressionThreshold;
+
+            if (isRegression)
+                regressionCount++;
+
+            table.AddRow(result.Name, result.Pattern, result.ThreadCount.ToString(), FormatChange(throughputChange),
+                FormatChange(latencyChange), isRegression ? "REGRESSED" : string.Empty);
+        }
+
+        return table.Print();
+
+        static string FormatChange(double change)
+        {
+            if (double.IsNaN(change) || double.IsInfinity(change))
+                return "-";
+
+            return change.ToString("+0.0%;-0.0%", CultureInfo.InvariantCulture);
+        }
+    }
+
+    public static void WriteJson(Stream stream, List<StorageBenchmarkResult> results)
+    {
+        using var writer = new Utf8JsonWriter(stream, new JsonWriterOptions { Indented = true });
+
+        writer.WriteStartObject();
+        writer.WriteNumber("version", FormatVersion);
+        writer.WriteString("hactoolnetVersion", VersionInfo.Version);
+        writer.WriteString("timestamp", DateTime.UtcNow.ToString("O", CultureInfo.InvariantCulture));
+        writer.WriteNumber("processorCount", Environment.ProcessorCount);
+
+        writer.WriteStartArray("results");
+
+        foreach (StorageBenchmarkResult result in results)
+        {
+            writer.WriteStartObject();
+            writer.WriteString("name", result.Name);
+            writer.WriteString("pattern", result.Pattern);
+            writer.WriteNumber("threads", result.ThreadCount);
+            writer.WriteNumber("operations", result.OperationCount);
+            writer.WriteNumber("bytes", result.TotalBytes);
+            writer.WriteNumber("seconds", result.Seconds);
+            writer.WriteNumber("bytesPerSecond", result.BytesPerSecond);
+            writer.WriteNumber("operationsPerSecond", result.OperationsPerSecond);
+            writer.WriteNumber("p50Microseconds", result.P50Microseconds);
+            writer.WriteNumber("p99Microseconds", result.P99Microseconds);
+            writer.WriteEndObject();
+        }
+
+        writer.WriteEndArray();
+        writer.WriteEndObject();
+    }
+
+    public static List<StorageBenchmarkResult> ReadJson(Stream stream)
+    {
+        using JsonDocument document = JsonDocument.Parse(stream);
+        JsonElement root = document.RootElement;
+
+        if (root.GetProperty("version").GetInt32() != FormatVersion)
+            throw new InvalidDataException("Unsupported benchmark result file version.");
+
+        var results = new List<StorageBenchmarkResult>();
+
+        foreach (JsonElement element in root.GetProperty("results").EnumerateArray())
+        {
+            results.Add(new StorageBenchmarkResult
+            {
+                Name = element.GetProperty("name").GetString(),
+                Pattern = element.GetProperty("pattern").GetString(),
+                ThreadCount = element.GetProperty("threads").GetInt32(),
+                OperationCount = element.GetProperty("operations").GetInt64(),
+                TotalBytes = element.GetProperty("bytes").GetInt64(),
+                Seconds = element.GetProperty("seconds").GetDouble(),
+                BytesPerSecond = element.GetProperty("bytesPerSecond").GetDouble(),
+                OperationsPerSecond = element.GetProperty("operationsPerSecond").GetDouble(),
+                P50Microseconds = element.GetProperty("p50Microseconds").GetDouble(),
+                P99Microseconds = element.GetProperty("p99Microseconds").GetDouble()
+            });
+        }
+
+        return results;
+    }
+
+    private class BenchmarkItem
+    {
+        public string Name { get; set; }
+        public OperationFactory CreateOperation { get; set; }
+    }
+}
+
+internal class StorageBenchmarkResult
+{
+    public string Name { get; set; }
+    public string Pattern { get; set; }
+    public int ThreadCount { get; set; }
+    public long OperationCount { get; set; }
+    public long TotalBytes { get; set; }
+    public double Seconds { get; set; }
+    public double BytesPerSecond { get; set; }
+    public double OperationsPerSecond { get; set; }
+    public double P50Microseconds { get; set; }
+    public double P99Microseconds { get; set; }
+}
@@ -0,0 +1,732 @@
+﻿using System;
+using System.Buffers.Binary;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using LibHac;
+using LibHac.Common;
+using LibHac.Common.Keys;
+using LibHac.Crypto;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.FsSystem;
+using LibHac.Tools.Fs;
+using LibHac.Tools.FsSystem;
+using LibHac.Tools.FsSystem.NcaUtils;
+using LibHac.Tools.FsSystem.RomFs;
+using LibHac.Tools.FsSystem.Save;
+using LibHac.Util;
+using CompressedStorage = LibHac.FsSystem.CompressedStorage;
+using HierarchicalIntegrityVerificationStorage = LibHac.Tools.FsSystem.HierarchicalIntegrityVerificationStorage;
+using NcaFsHeader = LibHac.Tools.FsSystem.NcaUtils.NcaFsHeader;
+
+namespace hactoolnet;
+
+/// <summary>
+/// Generates the synthetic images used by the storage benchmarks and registers a benchmark for each storage stack.
+/// </summary>
+/// <remarks>The images only need to have the same structure as real images. The data is random
+/// and the keys are all zeros.</remarks>
+internal static class StorageBenchmarkImages
+{
+    private const int ImageSize = 1024 * 1024 * 16;
+    private const int ReadSize = 0x4000;
+    private const int HashBlockSize = 0x4000;
+    private const int SaveBlockSizePower = 14;
+    private const int SaveBlockSize = 1 << SaveBlockSizePower;
+    private const int SaveFileSize = ImageSize / 2;
+    private const string SaveFilePath = "/file.bin";
+    private const int RomFsFileCount = 2000;
+    private const int RomFsDirectoryCount = 50;
+
+    /// <summary>
+    /// Registers a benchmark for each storage stack.
+    /// </summary>
+    /// <param name="bench">The benchmark to register the storage stacks with.</param>
+    /// <param name="createLz4Block">Creates an LZ4 block from a seed and the size of the decompressed data.</param>
+    public static void Register(StorageBenchmark bench, Func<int, int, byte[]> createLz4Block)
+    {
+        byte[] data = CreateRandomData(ImageSize, 1);
+
+        bench.RegisterStorage("NCA section (AES-CTR + IVFC)", CreateIntegrityStorageFactory(data), false, ReadSize);
+        bench.RegisterStorage("Patched (Indirect + AES-CTR-Ex)", CreatePatchedStorageFactory(data), false, ReadSize);
+        bench.RegisterStorage("NCA section (compressed)", CreateCompressedStorageFactory(createLz4Block), false,
+            ReadSize);
+        bench.RegisterStorage("BufferedStorage", CreateBufferedStorageFactory(data), true, ReadSize);
+        bench.RegisterStorage("Save data file (journal + IVFC + remap)", CreateSaveDataFileFactory(data), false,
+            ReadSize);
+
+        RegisterRomFsBenchmarks(bench);
+    }
+
+    private static byte[] CreateRandomData(int size, int seed)
+    {
+        byte[] data = new byte[size];
+        new Random(seed).NextBytes(data);
+        return data;
+    }
+
+    /// <summary>
+    /// An AES-CTR encrypted data section verified by a hierarchical SHA-256 hash tree,
+    /// which is how the sections of most NCAs are read.
+    /// </summary>
+    private static Func<IStorage> CreateIntegrityStorageFactory(byte[] data)
+    {
+        byte[] key = new byte[0x10];
+        byte[] counter = new byte[0x10];
+
+        byte[] encryptedData = new byte[data.Length];
+        using (var encryptor = new Aes128CtrStorage(new MemoryStorage(encryptedData), key, counter, true))
+        {
+            encryptor.Write(0, data).ThrowIfFailure();
+        }
+
+        byte[] level2 = HashBlocks(data);
+        byte[] level1 = HashBlocks(level2);
+        byte[] masterHash = HashBlocks(level1);
+
+        return () =>
+        {
+            var levelInfo = new IntegrityVerificationInfo[4];
+
+            levelInfo[0] = new IntegrityVerificationInfo { Data = new MemoryStorage(masterHash), BlockSize = 0 };
+            levelInfo[1] = CreateLevelInfo(new MemoryStorage(level1));
+            levelInfo[2] = CreateLevelInfo(new MemoryStorage(level2));
+            levelInfo[3] = CreateLevelInfo(new Aes128CtrStorage(new MemoryStorage(encryptedData), key, counter, true));
+
+            return new HierarchicalIntegrityVerificationStorage(levelInfo, IntegrityCheckLevel.ErrorOnInvalid, false);
+        };
+
+        static IntegrityVerificationInfo CreateLevelInfo(IStorage storage) => new IntegrityVerificationInfo
+        {
+            Data = storage,
+            BlockSize = HashBlockSize,
+            Type = IntegrityStorageType.RomFs
+        };
+    }
+
+    private static byte[] HashBlocks(byte[] data)
+    {
+        int blockCount = (data.Length + HashBlockSize - 1) / HashBlockSize;
+        byte[] hashes = new byte[blockCount * Sha256.DigestSize];
+        byte[] block = new byte[HashBlockSize];
+
+        for (int i = 0; i < blockCount; i++)
+        {
+            int size = Math.Min(HashBlockSize, data.Length - i * HashBlockSize);
+
+            block.AsSpan().Clear();
+            data.AsSpan(i * HashBlockSize, size).CopyTo(block);
+
+            Sha256.GenerateSha256Hash(block, hashes.AsSpan(i * Sha256.DigestSize, Sha256.DigestSize));
+        }
+
+        return hashes;
+    }
+
+    /// <summary>
+    /// An update that replaces parts of a base image. Reads are split between the unencrypted base data and
+    /// AES-CTR-Ex encrypted patch data, the same as when reading an NCA with a patch.
+    /// </summary>
+    private static Func<IStorage> CreatePatchedStorageFactory(byte[] baseData)
+    {
+        const int ctrExEntrySize = 1024 * 1024;
+
+        var random = new Random(2);
+        var indirectEntries = new List<IndirectStorage.Entry>();
+        long patchSize = 0;
+
+        for (long offset = 0; offset < baseData.Length;)
+        {
+            long size = Math.Min(random.Next(1, 64) * 0x1000L, baseData.Length - offset);
+            int storageIndex = indirectEntries.Count % 2;
+
+            var entry = new IndirectStorage.Entry { StorageIndex = storageIndex };
+            entry.SetVirtualOffset(offset);
+            entry.SetPhysicalOffset(storageIndex == 0 ? offset : patchSize);
+            indirectEntries.Add(entry);
+
+            if (storageIndex == 1)
+                patchSize += size;
+
+            offset += size;
+        }
+
+        var ctrExEntries = new List<Aes128CtrExStorage.Entry>();
+        for (long offset = 0; offset < patchSize; offset += ctrExEntrySize)
+        {
+            ctrExEntries.Add(new Aes128CtrExStorage.Entry { Offset = offset, Generation = ctrExEntries.Count });
+        }
+
+        byte[] patchData = CreateRandomData((int)patchSize, 3);
+        BucketTreeData indirectTable = BuildBucketTree(indirectEntries, IndirectStorage.NodeSize, baseData.Length);
+        BucketTreeData ctrExTable = BuildBucketTree(ctrExEntries, Aes128CtrExStorage.NodeSize, patchSize);
+
+        byte[] key = new byte[0x10];
+        byte[] counter = new byte[0x10];
+
+        return () =>
+        {
+            var patchStorage = new Aes128CtrExStorage(new MemoryStorage(patchData),
+                new SubStorage(new MemoryStorage(ctrExTable.Nodes), 0, ctrExTable.Nodes.Length),
+                new SubStorage(new MemoryStorage(ctrExTable.Entries), 0, ctrExTable.Entries.Length),
+                ctrExTable.EntryCount, key, counter, false);
+
+            using var nodeStorage = new ValueSubStorage(new MemoryStorage(indirectTable.Nodes), 0,
+                indirectTable.Nodes.Length);
+            using var entryStorage = new ValueSubStorage(new MemoryStorage(indirectTable.Entries), 0,
+                indirectTable.Entries.Length);
+
+            var storage = new IndirectStorage();
+            storage.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage, indirectTable.EntryCount)
+                .ThrowIfFailure();
+
+            storage.SetStorage(0, new MemoryStorage(baseData), 0, baseData.Length);
+            storage.SetStorage(1, patchStorage, 0, patchSize);
+
+            return storage;
+        };
+    }
+
+    /// <summary>
+    /// A plaintext NCA section with a compression layer containing a mix of LZ4 compressed, uncompressed and
+    /// zeroed entries. The section is opened through <see cref="Nca.OpenStorage(int, IntegrityCheckLevel)"/>
+    /// without integrity checks so the benchmark measures the compression layer.
+    /// </summary>
+    private static Func<IStorage> CreateCompressedStorageFactory(Func<int, int, byte[]> createLz4Block)
+    {
+        const int compressedEntrySize = 0x10000;
+        const int ncaHeaderSize = 0xC00;
+
+        var random = new Random(4);
+        var physicalData = new List<byte>();
+        var entries = new List<CompressedStorage.Entry>();
+        long virtualSize = 0;
+
+        while (virtualSize < ImageSize)
+        {
+            var entry = new CompressedStorage.Entry
+            {
+                VirtualOffset = virtualSize,
+                PhysicalOffset = physicalData.Count
+            };
+
+            switch (random.Next(0, 8))
+            {
+                case 0:
+                {
+                    byte[] data = CreateRandomData(compressedEntrySize, entries.Count);
+
+                    entry.CompressionType = CompressionType.None;
+                    entry.PhysicalSize = compressedEntrySize;
+                    physicalData.AddRange(data);
+                    break;
+                }
+                case 1:
+                    entry.CompressionType = CompressionType.Zeroed;
+                    break;
+                default:
+                {
+                    byte[] compressed = createLz4Block(entries.Count, compressedEntrySize);
+
+                    entry.CompressionType = CompressionType.Lz4;
+                    entry.PhysicalSize = (uint)compressed.Length;
+                    physicalData.AddRange(compressed);
+                    break;
+                }
+            }
+
+            entries.Add(entry);
+            virtualSize += compressedEntrySize;
+        }
+
+        BucketTreeData table = BuildBucketTree(entries, CompressedStorage.NodeSize, virtualSize);
+
+        // The section's data is the compressed data followed by the compression table
+        long tableOffset = Alignment.AlignUp(physicalData.Count, 0x10);
+        long tableSize = table.Nodes.Length + table.Entries.Length;
+        long dataSize = tableOffset + tableSize;
+
+        // The hash level is left empty because the section is read without integrity checks
+        long hashLevelSize = Alignment.AlignUp(BitUtil.DivideUp(dataSize, HashBlockSize) * Sha256.DigestSize, 0x200);
+        long sectionSize = Alignment.AlignUp(hashLevelSize + dataSize, 0x200);
+
+        byte[] nca = new byte[ncaHeaderSize + sectionSize];
+
+        Span<byte> header = nca.AsSpan(0, ncaHeaderSize);
+        "NCA3"u8.CopyTo(header.Slice(0x200));
+        header[0x204] = (byte)DistributionType.Download;
+        header[0x205] = (byte)NcaContentType.Data;
+        BinaryPrimitives.WriteInt64LittleEndian(header.Slice(0x208), nca.Length);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x240), ncaHeaderSize / 0x200);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x244), nca.Length / 0x200);
+        header[0x248] = 1;
+
+        var fsHeader = new NcaFsHeader(nca.AsMemory(0x400, 0x200));
+        fsHeader.Version = 2;
+        fsHeader.FormatType = NcaFormatType.Romfs;
+        fsHeader.HashType = NcaHashType.Sha256;
+        fsHeader.EncryptionType = NcaEncryptionType.None;
+
+        NcaFsIntegrityInfoSha256 integrityInfo = fsHeader.GetIntegrityInfoSha256();
+        integrityInfo.BlockSize = HashBlockSize;
+        integrityInfo.LevelCount = 2;
+        integrityInfo.GetLevelOffset(0) = 0;
+        integrityInfo.GetLevelSize(0) = hashLevelSize;
+        integrityInfo.GetLevelOffset(1) = hashLevelSize;
+        integrityInfo.GetLevelSize(1) = dataSize;
+
+        ref NcaCompressionInfo compressionInfo = ref fsHeader.GetCompressionInfo();
+        compressionInfo.TableOffset = tableOffset;
+        compressionInfo.TableSize = tableSize;
+        table.Header.CopyTo(compressionInfo.TableHeader);
+
+        Sha256.GenerateSha256Hash(nca.AsSpan(0x400, 0x200), header.Slice(0x280, Sha256.DigestSize));
+
+        Span<byte> sectionData = nca.AsSpan(ncaHeaderSize + (int)hashLevelSize, (int)dataSize);
+        physicalData.ToArray().CopyTo(sectionData);
+        table.Nodes.CopyTo(sectionData.Slice((int)tableOffset));
+        table.Entries.CopyTo(sectionData.Slice((int)tableOffset + table.Nodes.Length));
+
+        var keySet = new KeySet();
+
+        return () => new Nca(keySet, new MemoryStorage(nca)).OpenStorage(0, IntegrityCheckLevel.None);
+    }
+
+    /// <summary>
+    /// A <see cref="BufferedStorage"/> shared between all threads, with a cache a quarter of the image's size.
+    /// </summary>
+    private static Func<IStorage> CreateBufferedStorageFactory(byte[] data)
+    {
+        const int blockSize = 0x4000;
+        const int heapSize = ImageSize / 4;
+
+        return () =>
+        {
+            var bufferManager = new FileSystemBufferManager(FileSystemBufferManager.DefaultShardCount);
+            bufferManager.Initialize(heapSize / blockSize, new byte[heapSize], blockSize).ThrowIfFailure();
+
+            using var baseStorage = new ValueSubStorage(new MemoryStorage(data), 0, data.Length);
+
+            var storage = new BufferedStorage();
+            storage.Initialize(in baseStorage, bufferManager, blockSize, 16).ThrowIfFailure();
+
+            return storage;
+        };
+    }
+
+    /// <summary>
+    /// A file read through a journaled save data file system. The file's blocks are split into many segments
+    /// that are interleaved with other files', and each read goes through the allocation table, the IVFC hashes,
+    /// the journal, the duplex storage and both remap storages.
+    /// </summary>
+    private static Func<IStorage> CreateSaveDataFileFactory(byte[] data)
+    {
+        byte[] image = CreateSaveDataImage(data.AsSpan(0, SaveFileSize));
+        var keySet = new KeySet();
+
+        return () =>
+        {
+            var saveFs = new SaveDataFileSystem(keySet, new MemoryStorage(image), IntegrityCheckLevel.ErrorOnInvalid,
+                false);
+
+            using var file = new UniqueRef<IFile>();
+            saveFs.OpenFile(ref file.Ref, SaveFilePath.ToU8Span(), OpenMode.Read).ThrowIfFailure();
+
+            return new FileStorage(file.Release());
+        };
+    }
+
+    /// <summary>
+    /// Creates a save data image containing a file with the specified data.
+    /// </summary>
+    /// <remarks>Each remap storage maps its whole storage with a single entry, every duplex block uses
+    /// the first copy and the journal maps each block to itself. The file system inside is written through
+    /// the same IVFC storage that <see cref="SaveDataFileSystem"/> reads it with.</remarks>
+    private static byte[] CreateSaveDataImage(ReadOnlySpan<byte> fileData)
+    {
+        const int headerSize = 0x4000;
+        const int dataBlockCount = ImageSize / SaveBlockSize;
+        const int journalBlockCount = 8;
+        const int duplexMasterBitmapSize = 0x80;
+        const int fillerFileCount = 120;
+        const int fillerFileBlockCount = 7;
+
+        // The layout of the meta remap storage, which holds the journal map, the IVFC hash levels and the FAT
+        long dataLevelSize = (long)dataBlockCount * SaveBlockSize;
+        long ivfcL3Size = GetHashLevelSize(dataLevelSize);
+        long ivfcL2Size = GetHashLevelSize(ivfcL3Size);
+        long ivfcL1Size = GetHashLevelSize(ivfcL2Size);
+        long masterHashSize = ivfcL1Size / SaveBlockSize * Sha256.DigestSize;
+
+        long journalMapTableOffset = 0;
+        long journalMapTableSize = Alignment.AlignUp(dataBlockCount * 8L, SaveBlockSize);
+        long journalBitmapSize = SaveBlockSize;
+        long physicalBitmapOffset = journalMapTableOffset + journalMapTableSize;
+        long virtualBitmapOffset = physicalBitmapOffset + journalBitmapSize;
+        long freeBitmapOffset = virtualBitmapOffset + journalBitmapSize;
+        long ivfcL1Offset = freeBitmapOffset + journalBitmapSize;
+        long ivfcL2Offset = ivfcL1Offset + ivfcL1Size;
+        long ivfcL3Offset = ivfcL2Offset + ivfcL2Size;
+        long fatOffset = ivfcL3Offset + ivfcL3Size;
+        long fatSize = Alignment.AlignUp((dataBlockCount + 1) * 8L, SaveBlockSize);
+        long metaSize = fatOffset + fatSize;
+
+        // The layout of the data remap storage, which holds both copies of each duplex layer and the journal data
+        long duplexL1Size = SaveBlockSize;
+        long duplexL1OffsetA = 0;
+        long duplexL1OffsetB = duplexL1OffsetA + duplexL1Size;
+        long duplexDataOffsetA = duplexL1OffsetB + duplexL1Size;
+        long duplexDataOffsetB = duplexDataOffsetA + metaSize;
+        long journalDataOffset = duplexDataOffsetB + metaSize;
+        long journalSize = (long)journalBlockCount * SaveBlockSize;
+        long fileMapDataSize = journalDataOffset + dataLevelSize + journalSize;
+
+        // The layout of the image. The duplex master bitmaps and the IVFC master hash are kept in the header.
+        long fileMapEntryOffset = headerSize * 2;
+        long metaMapEntryOffset = fileMapEntryOffset + SaveBlockSize;
+        long fileMapDataOffset = metaMapEntryOffset + SaveBlockSize;
+        long duplexMasterOffsetA = 0x1000;
+        long duplexMasterOffsetB = duplexMasterOffsetA + duplexMasterBitmapSize;
+        long ivfcMasterHashOffsetA = 0x1200;
+        long ivfcMasterHashOffsetB = ivfcMasterHashOffsetA + masterHashSize;
+
+        byte[] image = new byte[fileMapDataOffset + fileMapDataSize];
+        Span<byte> header = image.AsSpan(0, headerSize);
+
+        "DISF"u8.CopyTo(header.Slice(0x100));
+        BinaryPrimitives.WriteUInt32LittleEndian(header.Slice(0x104), 0x40000);
+
+        long[] layout =
+        [
+            fileMapEntryOffset, SaveBlockSize, metaMapEntryOffset, SaveBlockSize, fileMapDataOffset, fileMapDataSize,
+            duplexL1OffsetA, duplexL1OffsetB, duplexL1Size, duplexDataOffsetA, duplexDataOffsetB, metaSize,
+            journalDataOffset, dataLevelSize, dataLevelSize, journalSize,
+            duplexMasterOffsetA, duplexMasterOffsetB, duplexMasterBitmapSize,
+            ivfcMasterHashOffsetA, ivfcMasterHashOffsetB, masterHashSize,
+            journalMapTableOffset, journalMapTableSize, physicalBitmapOffset, journalBitmapSize,
+            virtualBitmapOffset, journalBitmapSize, freeBitmapOffset, journalBitmapSize,
+            ivfcL1Offset, ivfcL1Size, ivfcL2Offset, ivfcL2Size, ivfcL3Offset, ivfcL3Size, fatOffset, fatSize,
+            0 // Duplex index
+        ];
+
+        MemoryMarshal.Cast<long, byte>(layout).CopyTo(header.Slice(0x128));
+
+        Span<byte> duplexHeader = header.Slice(0x300, 0x44);
+        "DPFS"u8.CopyTo(duplexHeader);
+        BinaryPrimitives.WriteUInt32LittleEndian(duplexHeader.Slice(0x4), 0x10000);
+        WriteDuplexInfo(duplexHeader.Slice(0x8), duplexMasterOffsetA, duplexMasterBitmapSize);
+        WriteDuplexInfo(duplexHeader.Slice(0x1C), duplexL1OffsetA, duplexL1Size);
+        WriteDuplexInfo(duplexHeader.Slice(0x30), duplexDataOffsetA, metaSize);
+
+        Span<byte> ivfcHeader = header.Slice(0x344, 0xC0);
+        "IVFC"u8.CopyTo(ivfcHeader);
+        BinaryPrimitives.WriteUInt32LittleEndian(ivfcHeader.Slice(0x4), 0x20000);
+        BinaryPrimitives.WriteInt32LittleEndian(ivfcHeader.Slice(0x8), (int)masterHashSize);
+        BinaryPrimitives.WriteInt32LittleEndian(ivfcHeader.Slice(0xC), 5);
+        WriteIvfcLevelHeader(ivfcHeader.Slice(0x10), ivfcL1Offset, ivfcL1Size);
+        WriteIvfcLevelHeader(ivfcHeader.Slice(0x28), ivfcL2Offset, ivfcL2Size);
+        WriteIvfcLevelHeader(ivfcHeader.Slice(0x40), ivfcL3Offset, ivfcL3Size);
+        WriteIvfcLevelHeader(ivfcHeader.Slice(0x58), 0, dataLevelSize);
+        new Random(6).NextBytes(ivfcHeader.Slice(0xA0, 0x20));
+
+        Span<byte> journalHeader = header.Slice(0x408, 0x200);
+        "JNGL"u8.CopyTo(journalHeader);
+        BinaryPrimitives.WriteUInt32LittleEndian(journalHeader.Slice(0x4), 0x10000);
+        BinaryPrimitives.WriteInt64LittleEndian(journalHeader.Slice(0x8), dataLevelSize + journalSize);
+        BinaryPrimitives.WriteInt64LittleEndian(journalHeader.Slice(0x10), journalSize);
+        BinaryPrimitives.WriteInt64LittleEndian(journalHeader.Slice(0x18), SaveBlockSize);
+        BinaryPrimitives.WriteInt32LittleEndian(journalHeader.Slice(0x20), 0x10000);
+        BinaryPrimitives.WriteInt32LittleEndian(journalHeader.Slice(0x24), dataBlockCount);
+        BinaryPrimitives.WriteInt32LittleEndian(journalHeader.Slice(0x28), journalBlockCount);
+
+        Span<byte> saveHeader = header.Slice(0x608, 0x48);
+        "SAVE"u8.CopyTo(saveHeader);
+        BinaryPrimitives.WriteUInt32LittleEndian(saveHeader.Slice(0x4), 0x60000);
+        BinaryPrimitives.WriteInt64LittleEndian(saveHeader.Slice(0x8), dataBlockCount);
+        BinaryPrimitives.WriteInt64LittleEndian(saveHeader.Slice(0x10), SaveBlockSize);
+
+        WriteRemapStorage(header.Slice(0x650, 0x40), image.AsSpan((int)fileMapEntryOffset), fileMapDataSize);
+        WriteRemapStorage(header.Slice(0x690, 0x40), image.AsSpan((int)metaMapEntryOffset), metaSize);
+
+        // Every duplex block uses the first copy, so the meta remap storage is stored in duplex data A
+        var imageStorage = new MemoryStorage(image);
+        IStorage metaStorage = imageStorage.Slice(fileMapDataOffset + duplexDataOffsetA, metaSize);
+        IStorage journalDataStorage = imageStorage.Slice(fileMapDataOffset + journalDataOffset, dataLevelSize);
+
+        Span<byte> journalMap = image.AsSpan((int)(fileMapDataOffset + duplexDataOffsetA + journalMapTableOffset),
+            dataBlockCount * 8);
+
+        for (int i = 0; i < dataBlockCount; i++)
+        {
+            BinaryPrimitives.WriteUInt32LittleEndian(journalMap.Slice(i * 8), (uint)i | 0x80000000);
+            BinaryPrimitives.WriteUInt32LittleEndian(journalMap.Slice(i * 8 + 4), (uint)i | 0x80000000);
+        }
+
+        var levels = new List<IStorage>
+        {
+            imageStorage.Slice(ivfcMasterHashOffsetA, masterHashSize),
+            metaStorage.Slice(ivfcL1Offset, ivfcL1Size),
+            metaStorage.Slice(ivfcL2Offset, ivfcL2Size),
+            metaStorage.Slice(ivfcL3Offset, ivfcL3Size),
+            journalDataStorage
+        };
+
+        var ivfcInfo = new IvfcHeader(imageStorage.Slice(0x344, 0xC0)) { NumLevels = 5 };
+
+        using var coreDataStorage = new HierarchicalIntegrityVerificationStorage(ivfcInfo, levels,
+            IntegrityStorageType.Save, IntegrityCheckLevel.None, true);
+
+        IStorage fatStorage = metaStorage.Slice(fatOffset, fatSize);
+        AllocationTable table = CreateAllocationTable(fatStorage, imageStorage.Slice(0x620, 0x30), dataBlockCount);
+
+        // The directory and file tables start out containing only the heads of their free and used lists
+        int directoryTableBlock = table.Allocate(1);
+        int fileTableBlock = table.Allocate(1);
+        BinaryPrimitives.WriteInt32LittleEndian(saveHeader.Slice(0x40), directoryTableBlock);
+        BinaryPrimitives.WriteInt32LittleEndian(saveHeader.Slice(0x44), fileTableBlock);
+
+        Span<byte> tableHeader = stackalloc byte[8];
+        BinaryPrimitives.WriteInt32LittleEndian(tableHeader, 2);
+
+        new AllocationTableStorage(coreDataStorage, table, SaveBlockSize, directoryTableBlock).Write(0, tableHeader)
+            .ThrowIfFailure();
+        new AllocationTableStorage(coreDataStorage, table, SaveBlockSize, fileTableBlock).Write(0, tableHeader)
+            .ThrowIfFailure();
+
+        var saveFs = new SaveDataFileSystemCore(coreDataStorage, fatStorage, imageStorage.Slice(0x608, 0x48));
+
+        // Deleting every other filler file leaves the free list split into many small segments
+        for (int i = 0; i < fillerFileCount; i++)
+        {
+            CreateSaveFile(saveFs, $"/filler{i}.bin", fillerFileBlockCount * SaveBlockSize);
+        }
+
+        for (int i = 0; i < fillerFileCount; i += 2)
+        {
+            using var path = new Path();
+            path.InitializeWithNormalization($"/filler{i}.bin".ToU8Span()).ThrowIfFailure();
+            saveFs.DeleteFile(in path).ThrowIfFailure();
+        }
+
+        CreateSaveFile(saveFs, SaveFilePath, fileData.Length);
+
+        using (var file = new UniqueRef<IFile>())
+        {
+            saveFs.OpenFile(ref file.Ref, SaveFilePath.ToU8Span(), OpenMode.Write).ThrowIfFailure();
+            file.Get.Write(0, fileData, WriteOption.None).ThrowIfFailure();
+        }
+
+        coreDataStorage.Flush().ThrowIfFailure();
+
+        // Hash the header last because it contains the IVFC master hash
+        Sha256.GenerateSha256Hash(header.Slice(0x300, 0x3D00), header.Slice(0x108, Sha256.DigestSize));
+
+        return image;
+
+        static long GetHashLevelSize(long levelSize) =>
+            Alignment.AlignUp(levelSize / SaveBlockSize * Sha256.DigestSize, SaveBlockSize);
+    }
+
+    private static void WriteDuplexInfo(Span<byte> info, long offset, long size)
+    {
+        BinaryPrimitives.WriteInt64LittleEndian(info, offset);
+        BinaryPrimitives.WriteInt64LittleEndian(info.Slice(0x8), size);
+        BinaryPrimitives.WriteInt32LittleEndian(info.Slice(0x10), SaveBlockSizePower);
+    }
+
+    private static void WriteIvfcLevelHeader(Span<byte> level, long offset, long size)
+    {
+        BinaryPrimitives.WriteInt64LittleEndian(level, offset);
+        BinaryPrimitives.WriteInt64LittleEndian(level.Slice(0x8), size);
+        BinaryPrimitives.WriteInt32LittleEndian(level.Slice(0x10), SaveBlockSizePower);
+    }
+
+    /// <summary>
+    /// Writes the header of a remap storage with a single entry that maps the storage to itself.
+    /// </summary>
+    private static void WriteRemapStorage(Span<byte> header, Span<byte> entry, long size)
+    {
+        "RMAP"u8.CopyTo(header);
+        BinaryPrimitives.WriteUInt32LittleEndian(header.Slice(0x4), 0x10000);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x8), 1);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0xC), 1);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x10), 20);
+
+        BinaryPrimitives.WriteInt64LittleEndian(entry, 0);
+        BinaryPrimitives.WriteInt64LittleEndian(entry.Slice(0x8), 0);
+        BinaryPrimitives.WriteInt64LittleEndian(entry.Slice(0x10), size);
+        BinaryPrimitives.WriteInt32LittleEndian(entry.Slice(0x18), SaveBlockSize);
+    }
+
+    private static void CreateSaveFile(IFileSystem fs, string name, long size)
+    {
+        using var path = new Path();
+        path.InitializeWithNormalization(name.ToU8Span()).ThrowIfFailure();
+        fs.CreateFile(in path, size).ThrowIfFailure();
+    }
+
+    private static AllocationTable CreateAllocationTable(IStorage tableStorage, IStorage headerStorage, int blockCount)
+    {
+        Span<byte> header = stackalloc byte[0x30];
+        header.Clear();
+        BinaryPrimitives.WriteInt64LittleEndian(header, SaveBlockSize);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x10), blockCount);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x20), blockCount);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x28), -1);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x2C), -1);
+        headerStorage.Write(0, header).ThrowIfFailure();
+
+        // Entry 0 is the head of the free list, which starts as one segment containing every block
+        var entries = new AllocationTableEntry[blockCount + 1];
+        entries[0].Next = 1;
+        entries[1].MakeListStart();
+        entries[1].MakeMultiBlockSegment();
+        entries[2].SetRange(1, blockCount);
+        entries[blockCount].SetRange(1, blockCount);
+
+        tableStorage.Write(0, MemoryMarshal.Cast<AllocationTableEntry, byte>(entries)).ThrowIfFailure();
+
+        return new AllocationTable(tableStorage, headerStorage);
+    }
+
+    /// <summary>
+    /// Registers benchmarks that open and read files from a RomFS, and that enumerate its directories.
+    /// </summary>
+    private static void RegisterRomFsBenchmarks(StorageBenchmark bench)
+    {
+        var random = new Random(5);
+        var builder = new RomFsBuilder();
+        string[] filePaths = new string[RomFsFileCount];
+        string[] directoryPaths = new string[RomFsDirectoryCount];
+
+        for (int i = 0; i < directoryPaths.Length; i++)
+        {
+            directoryPaths[i] = $"/dir{i % 10}/sub{i}";
+        }
+
+        for (int i = 0; i < filePaths.Length; i++)
+        {
+            filePaths[i] = $"{directoryPaths[random.Next(directoryPaths.Length)]}/file{i}.bin";
+
+            byte[] fileData = CreateRandomData(random.Next(0x100, 0x10000), i);
+            builder.AddFile(filePaths[i], new MemoryStorage(fileData).AsFile(OpenMode.Read));
+        }
+
+        IStorage romFsStorage = builder.Build();
+
+        RegisterRomFsOpenBenchmark(bench, romFsStorage, filePaths, false);
+        RegisterRomFsOpenBenchmark(bench, romFsStorage, filePaths, true);
+
+        RegisterRomFsEnumerateBenchmark(bench, romFsStorage, directoryPaths, false);
+        RegisterRomFsEnumerateBenchmark(bench, romFsStorage, directoryPaths, true);
+    }
+
+    private static void RegisterRomFsOpenBenchmark(StorageBenchmark bench, IStorage romFsStorage, string[] filePaths,
+        bool usePathIndex)
+    {
+        RomFsFileSystem sharedFs = null;
+
+        bench.Register(usePathIndex ? "RomFS open + read file (path index)" : "RomFS open + read file",
+            (threadIndex, threadCount, pattern) =>
+        {
+            if (threadIndex == 0)
+            {
+                sharedFs = new RomFsFileSystem(romFsStorage) { UsePathIndex = usePathIndex };
+
+                // Build the index before the timed operations
+                if (usePathIndex)
+                    sharedFs.GetPathIndex();
+            }
+
+            RomFsFileSystem fs = sharedFs;
+            byte[] buffer = new byte[0x10000];
+            int startIndex = filePaths.Length * threadIndex / threadCount;
+            var threadRandom = new Random(threadIndex);
+
+            return operationIndex =>
+            {
+                int fileIndex = pattern == AccessPattern.Sequential
+                    ? (int)((startIndex + operationIndex) % filePaths.Length)
+                    : threadRandom.Next(filePaths.Length);
+
+                using var file = new UniqueRef<IFile>();
+                fs.OpenFile(ref file.Ref, filePaths[fileIndex].ToU8Span(), OpenMode.Read).ThrowIfFailure();
+                file.Get.Read(out long bytesRead, 0, buffer).ThrowIfFailure();
+
+                return bytesRead;
+            };
+        });
+    }
+
+    // Sequential enumerates the whole file system. Random enumerates a single random directory.
+    private static void RegisterRomFsEnumerateBenchmark(StorageBenchmark bench, IStorage romFsStorage,
+        string[] directoryPaths, bool usePathIndex)
+    {
+        RomFsFileSystem sharedFs = null;
+
+        bench.Register(usePathIndex ? "RomFS enumerate (path index)" : "RomFS enumerate", (threadIndex, _, pattern) =>
+        {
+            if (threadIndex == 0)
+            {
+                sharedFs = new RomFsFileSystem(romFsStorage) { UsePathIndex = usePathIndex };
+
+                // Build the index before the timed operations
+                if (usePathIndex)
+                    sharedFs.GetPathIndex();
+            }
+
+            RomFsFileSystem fs = sharedFs;
+            var threadRandom = new Random(threadIndex);
+
+            return _ =>
+            {
+                string path = pattern == AccessPattern.Sequential
+                    ? "/"
+                    : directoryPaths[threadRandom.Next(directoryPaths.Length)];
+
+                fs.EnumerateEntries(path, "*").Count();
+                return 0;
+            };
+        });
+    }
+
+    private class BucketTreeData
+    {
+        public byte[] Header;
+        public byte[] Nodes;
+        public byte[] Entries;
+        public int EntryCount;
+    }
+
+    private static BucketTreeData BuildBucketTree<T>(List<T> entries, int nodeSize, long endOffset) where T : unmanaged
+    {
+        int entrySize = Unsafe.SizeOf<T>();
+
+        var result = new BucketTreeData
+        {
+            Header = new byte[BucketTree.QueryHeaderStorageSize()],
+            Nodes = new byte[BucketTree.QueryNodeStorageSize(nodeSize, entrySize, entries.Count)],
+            Entries = new byte[BucketTree.QueryEntryStorageSize(nodeSize, entrySize, entries.Count)],
+            EntryCount = entries.Count
+        };
+
+        using var headerStorage = new ValueSubStorage(new MemoryStorage(result.Header), 0, result.Header.Length);
+        using var nodeStorage = new ValueSubStorage(new MemoryStorage(result.Nodes), 0, result.Nodes.Length);
+        using var entryStorage = new ValueSubStorage(new MemoryStorage(result.Entries), 0, result.Entries.Length);
+
+        var builder = new BucketTree.Builder();
+        builder.Initialize(new ArrayPoolMemoryResource(), in headerStorage, in nodeStorage, in entryStorage, nodeSize,
+            entrySize, entries.Count).ThrowIfFailure();
+
+        foreach (T entry in entries)
+        {
+            builder.Add(in entry).ThrowIfFailure();
+        }
+
+        builder.Finalize(endOffset).ThrowIfFailure();
+
+        return result;
+    }
+}
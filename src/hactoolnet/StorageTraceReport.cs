@@ -0,0 +1,81 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using LibHac.FsSystem;
+using LibHac.Common;
+
+namespace hactoolnet;
+
+/// <summary>
+/// Prints the statistics recorded by a <see cref="StorageTracer"/> as a tree of layers, similar to a flame graph.
+/// </summary>
+internal static class StorageTraceReport
+{
+    private const int BarWidth = 20;
+
+    public static void Print(StorageTraceSnapshot snapshot, ProgressBar logger)
+    {
+        double rootTime = snapshot.GetRootLayers().Sum(l => l.TotalNanoseconds);
+
+        if (rootTime <= 0)
+        {
+            logger.LogMessage("No storage operations were traced.");
+            return;
+        }
+
+        var table = new TableBuilder("Layer", "Total", "Self", "Self time", "Ops", "Read", "Cache hits",
+            "Read p50", "Read p99", "Failed");
+
+        var printedLayers = new HashSet<StorageLayerSnapshot>();
+
+        foreach (StorageLayerSnapshot root in snapshot.GetRootLayers().OrderByDescending(l => l.TotalNanoseconds))
+        {
+            AddLayer(table, snapshot, root, 0, rootTime, printedLayers);
+        }
+
+        var sb = new StringBuilder();
+        sb.AppendLine("Storage trace (time as a percentage of all traced time):");
+        sb.Append(table.Print());
+
+        logger.LogMessage(sb.ToString());
+    }
+
+    private static void AddLayer(TableBuilder table, StorageTraceSnapshot snapshot, StorageLayerSnapshot layer,
+        int depth, double rootTime, HashSet<StorageLayerSnapshot> printedLayers)
+    {
+        if (!printedLayers.Add(layer))
+            return;
+
+        double selfFraction = layer.SelfNanoseconds / rootTime;
+        string bar = new string('#', (int)Math.Round(selfFraction * BarWidth)).PadRight(BarWidth, '.');
+
+        long cacheLookups = layer.CacheHitCount + layer.CacheMissCount;
+        string cacheHits = cacheLookups == 0 ? "-" : $"{(double)layer.CacheHitCount / cacheLookups:P1}";
+
+        table.AddRow(
+            new string(' ', depth * 2) + layer.Name,
+            $"{layer.TotalNanoseconds / rootTime:P1}",
+            $"{selfFraction:P1}",
+            bar,
+            layer.OperationCount.ToString(),
+            Utilities.GetBytesReadable(layer.ReadBytes),
+            cacheHits,
+            FormatLatency(layer.ReadCount, layer.ReadLatency.GetValueAtPercentile(50)),
+            FormatLatency(layer.ReadCount, layer.ReadLatency.GetValueAtPercentile(99)),
+            layer.FailureCount.ToString());
+
+        foreach (StorageLayerSnapshot child in snapshot.GetChildLayers(layer).OrderByDescending(l => l.TotalNanoseconds))
+        {
+            AddLayer(table, snapshot, child, depth + 1, rootTime, printedLayers);
+        }
+    }
+
+    private static string FormatLatency(long count, long nanoseconds)
+    {
+        if (count == 0)
+            return "-";
+
+        return nanoseconds < 1_000_000 ? $"{nanoseconds / 1000.0:0.0} us" : $"{nanoseconds / 1_000_000.0:0.00} ms";
+    }
+}
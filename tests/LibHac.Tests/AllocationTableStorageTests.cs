@@ -0,0 +1,193 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using LibHac.Fs;
+using LibHac.Tools.FsSystem.Save;
+using Xunit;
+
+namespace LibHac.Tests;
+
+public class AllocationTableStorageTests
+{
+    private const int BlockSize = 0x100;
+    private const int BlockCount = 64;
+
+    private class CountingStorage : MemoryStorage
+    {
+        public int ReadCount;
+
+        public CountingStorage(byte[] buffer) : base(buffer) { }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            ReadCount++;
+            return base.Read(offset, destination);
+        }
+    }
+
+    private static AllocationTable CreateTable()
+    {
+        byte[] header = new byte[0x30];
+        MemoryMarshal.Write(header.AsSpan(0x00), (long)BlockSize);
+        MemoryMarshal.Write(header.AsSpan(0x10), BlockCount);
+        MemoryMarshal.Write(header.AsSpan(0x28), -1);
+        MemoryMarshal.Write(header.AsSpan(0x2C), -1);
+
+        // Entry 0 is the head of the free list, which starts as one segment containing every block
+        var entries = new AllocationTableEntry[BlockCount + 1];
+        entries[0].Next = 1;
+        entries[1].MakeListStart();
+        entries[1].MakeMultiBlockSegment();
+        entries[2].SetRange(1, BlockCount);
+        entries[BlockCount].SetRange(1, BlockCount);
+
+        byte[] table = MemoryMarshal.Cast<AllocationTableEntry, byte>(entries).ToArray();
+
+        return new AllocationTable(new MemoryStorage(table), new MemoryStorage(header));
+    }
+
+    /// <summary>
+    /// Creates a list whose segments are interleaved with another list's.
+    /// </summary>
+    private static int CreateFragmentedList(AllocationTable table, int segmentCount, int segmentLength)
+    {
+        int list = table.Allocate(segmentLength);
+        Assert.NotEqual(-1, list);
+
+        for (int i = 1; i < segmentCount; i++)
+        {
+            Assert.NotEqual(-1, table.Allocate(1));
+
+            int segment = table.Allocate(segmentLength);
+            Assert.NotEqual(-1, segment);
+
+            table.Join(list, segment);
+        }
+
+        return list;
+    }
+
+    private static byte[] CreateData(int length)
+    {
+        byte[] data = new byte[length];
+        new Random(1234).NextBytes(data);
+        return data;
+    }
+
+    [Fact]
+    public void GetSize_FragmentedList_ReturnsListLength()
+    {
+        AllocationTable table = CreateTable();
+        int list = CreateFragmentedList(table, 5, 3);
+
+        var storage = new AllocationTableStorage(new MemoryStorage(new byte[BlockSize * BlockCount]), table,
+            BlockSize, list);
+
+        Assert.Success(storage.GetSize(out long size));
+        Assert.Equal(5 * 3 * BlockSize, size);
+    }
+
+    [Fact]
+    public void Read_FragmentedList_ReadsFromEachSegment()
+    {
+        AllocationTable table = CreateTable();
+        int list = CreateFragmentedList(table, 6, 2);
+
+        var baseStorage = new CountingStorage(new byte[BlockSize * BlockCount]);
+        var storage = new AllocationTableStorage(baseStorage, table, BlockSize, list);
+
+        byte[] data = CreateData(6 * 2 * BlockSize);
+        Assert.Success(storage.Write(0, data));
+
+        // Reading across every segment only needs one base read per segment
+        byte[] actual = new byte[data.Length - 0x10];
+        baseStorage.ReadCount = 0;
+        Assert.Success(storage.Read(0x10, actual));
+
+        Assert.Equal(6, baseStorage.ReadCount);
+        Assert.Equal(data.AsSpan(0x10).ToArray(), actual);
+
+        // Segments 2 and 3 are stored at physical blocks 6-7 and 9-10
+        byte[] physical = new byte[BlockSize];
+        Assert.Success(baseStorage.Read(9 * BlockSize, physical));
+        Assert.Equal(data.AsSpan(6 * BlockSize, BlockSize).ToArray(), physical);
+    }
+
+    [Fact]
+    public void Read_ContiguousSegments_AreCoalescedIntoOneRead()
+    {
+        AllocationTable table = CreateTable();
+
+        // Allocating twice in a row and joining gives 2 segments that are next to each other in the base storage
+        int list = table.Allocate(3);
+        table.Join(list, table.Allocate(4));
+        Assert.Equal(2, CountSegments(table, list));
+
+        var baseStorage = new CountingStorage(new byte[BlockSize * BlockCount]);
+        var storage = new AllocationTableStorage(baseStorage, table, BlockSize, list);
+
+        Assert.Success(storage.Read(0, new byte[7 * BlockSize]));
+        Assert.Equal(1, baseStorage.ReadCount);
+    }
+
+    [Fact]
+    public void Read_PastEndOfList_ReturnsInvalidAllocationTableOffset()
+    {
+        AllocationTable table = CreateTable();
+        int list = CreateFragmentedList(table, 2, 2);
+
+        var storage = new AllocationTableStorage(new MemoryStorage(new byte[BlockSize * BlockCount]), table,
+            BlockSize, list);
+
+        Assert.Result(ResultFs.InvalidAllocationTableOffset, storage.Read(4 * BlockSize - 0x10, new byte[0x20]));
+        Assert.Result(ResultFs.InvalidAllocationTableOffset, storage.Read(4 * BlockSize, new byte[0x10]));
+    }
+
+    [Fact]
+    public void SetSize_ListModifiedAfterRead_ReadsNewLayout()
+    {
+        AllocationTable table = CreateTable();
+        int list = CreateFragmentedList(table, 3, 2);
+
+        var baseStorage = new MemoryStorage(new byte[BlockSize * BlockCount]);
+        var storage = new AllocationTableStorage(baseStorage, table, BlockSize, list);
+
+        byte[] data = CreateData(10 * BlockSize);
+        Assert.Success(storage.Write(0, data.AsSpan(0, 6 * BlockSize)));
+
+        // Fragment the free list so the new blocks aren't next to the existing ones
+        Assert.NotEqual(-1, table.Allocate(1));
+
+        Assert.Success(storage.SetSize(10 * BlockSize));
+        Assert.Success(storage.GetSize(out long size));
+        Assert.Equal(10 * BlockSize, size);
+
+        Assert.Success(storage.Write(6 * BlockSize, data.AsSpan(6 * BlockSize)));
+
+        byte[] actual = new byte[data.Length];
+        Assert.Success(storage.Read(0, actual));
+        Assert.Equal(data, actual);
+
+        // Another storage over the same list sees the same data
+        var otherStorage = new AllocationTableStorage(baseStorage, table, BlockSize, list);
+        Array.Clear(actual);
+        Assert.Success(otherStorage.Read(0, actual));
+        Assert.Equal(data, actual);
+
+        Assert.Success(storage.SetSize(3 * BlockSize));
+        Assert.Success(otherStorage.GetSize(out size));
+        Assert.Equal(3 * BlockSize, size);
+        Assert.Result(ResultFs.InvalidAllocationTableOffset, otherStorage.Read(3 * BlockSize, new byte[1]));
+    }
+
+    private static int CountSegments(AllocationTable table, int list)
+    {
+        int count = 0;
+
+        foreach ((int _, int _) in table.DumpChain(list))
+        {
+            count++;
+        }
+
+        return count;
+    }
+}
@@ -0,0 +1,362 @@
+﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Fs;
+using LibHac.Tools.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests;
+
+public class CachedStorageTests
+{
+    private const int BlockSize = 0x200;
+
+    private static byte[] CreateData(int length, ulong rngSeed)
+    {
+        byte[] data = new byte[length];
+        new Random(rngSeed).NextBytes(data);
+        return data;
+    }
+
+    /// <summary>
+    /// A storage whose async reads copy the data as soon as they start, but don't complete until
+    /// <see cref="Gate"/> is set.
+    /// </summary>
+    private class GatedReadAsyncStorage : IStorage
+    {
+        private readonly IStorage _baseStorage;
+
+        public TaskCompletionSource Gate { get; } = new(TaskCreationOptions.RunContinuationsAsynchronously);
+
+        public GatedReadAsyncStorage(IStorage baseStorage)
+        {
+            _baseStorage = baseStorage;
+        }
+
+        public override async ValueTask<Result> ReadAsync(long offset, Memory<byte> destination,
+            CancellationToken cancellationToken = default)
+        {
+            Result res = _baseStorage.Read(offset, destination.Span);
+            await Gate.Task.ConfigureAwait(false);
+
+            return res;
+        }
+
+        public override Result Read(long offset, Span<byte> destination) => _baseStorage.Read(offset, destination);
+        public override Result Write(long offset, ReadOnlySpan<byte> source) => _baseStorage.Write(offset, source);
+        public override Result Flush() => _baseStorage.Flush();
+        public override Result SetSize(long size) => _baseStorage.SetSize(size);
+        public override Result GetSize(out long size) => _baseStorage.GetSize(out size);
+
+        public override Result OperateRange(Span<byte> outBuffer, OperationId operationId, long offset, long size,
+            ReadOnlySpan<byte> inBuffer)
+        {
+            return _baseStorage.OperateRange(outBuffer, operationId, offset, size, inBuffer);
+        }
+    }
+
+    /// <summary>
+    /// A storage that records the largest number of reads that were in progress at the same time.
+    /// </summary>
+    private class ConcurrencyRecordingStorage : MemoryStorage
+    {
+        private int _activeReads;
+        private int _maxActiveReads;
+
+        public int MaxActiveReads => _maxActiveReads;
+
+        public ConcurrencyRecordingStorage(byte[] data) : base(data) { }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            int activeReads = Interlocked.Increment(ref _activeReads);
+
+            int maxActiveReads = _maxActiveReads;
+            while (activeReads > maxActiveReads)
+            {
+                maxActiveReads = Interlocked.CompareExchange(ref _maxActiveReads, activeReads, maxActiveReads);
+            }
+
+            // Give other readers a chance to overlap with this one
+            Thread.Sleep(1);
+
+            Result res = base.Read(offset, destination);
+            Interlocked.Decrement(ref _activeReads);
+
+            return res;
+        }
+    }
+
+    [Theory]
+    [InlineData(1, 1)]
+    [InlineData(4, 1)]
+    [InlineData(4, 2)]
+    [InlineData(16, 4)]
+    public void Read_UnalignedRanges_ReturnsBaseData(int cacheSize, int shardCount)
+    {
+        byte[] data = CreateData(BlockSize * 40 + 0x123, 1);
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, cacheSize, shardCount, false);
+
+        var random = new Random(2);
+        byte[] buffer = new byte[BlockSize * 5];
+
+        for (int i = 0; i < 500; i++)
+        {
+            int offset = random.Next(0, data.Length);
+            int size = random.Next(0, Math.Min(buffer.Length, data.Length - offset));
+
+            Assert.Success(storage.Read(offset, buffer.AsSpan(0, size)));
+            Assert.True(data.AsSpan(offset, size).SequenceEqual(buffer.AsSpan(0, size)));
+        }
+    }
+
+    [Fact]
+    public async Task ReadAsync_UnalignedRanges_ReturnsBaseData()
+    {
+        byte[] data = CreateData(BlockSize * 40 + 0x123, 5);
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 4, 2, false);
+
+        var random = new Random(6);
+        byte[] buffer = new byte[BlockSize * 5];
+
+        for (int i = 0; i < 200; i++)
+        {
+            int offset = random.Next(0, data.Length);
+            int size = random.Next(0, Math.Min(buffer.Length, data.Length - offset));
+
+            Assert.Success(await storage.ReadAsync(offset, buffer.AsMemory(0, size)));
+            Assert.True(data.AsSpan(offset, size).SequenceEqual(buffer.AsSpan(0, size)));
+        }
+    }
+
+    [Fact]
+    public async Task ReadAsync_ReturnsDataWrittenToCache()
+    {
+        byte[] data = CreateData(BlockSize * 4, 7);
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 4, false);
+
+        Assert.Success(storage.Write(0x10, new byte[] { 1, 2, 3 }));
+
+        byte[] buffer = new byte[3];
+        Assert.Success(await storage.ReadAsync(0x10, buffer));
+
+        Assert.Equal(new byte[] { 1, 2, 3 }, buffer);
+    }
+
+    [Fact]
+    public async Task ReadAsync_BlockCachedByAnotherReadFirst_CountsHit()
+    {
+        byte[] data = CreateData(BlockSize * 4, 8);
+        var baseStorage = new GatedReadAsyncStorage(new MemoryStorage(data));
+        using var storage = new CachedStorage(baseStorage, BlockSize, 2, 1, false);
+
+        byte[] asyncBuffer = new byte[BlockSize];
+        ValueTask<Result> asyncRead = storage.ReadAsync(0, asyncBuffer);
+
+        Assert.Success(storage.Read(0, new byte[BlockSize]));
+
+        baseStorage.Gate.SetResult();
+        Assert.Success(await asyncRead);
+
+        Assert.True(data.AsSpan(0, BlockSize).SequenceEqual(asyncBuffer));
+        Assert.Equal(1, storage.HitCount);
+        Assert.Equal(1, storage.MissCount);
+    }
+
+    [Fact]
+    public async Task ReadAsync_BlockWrittenBackDuringRead_StaleDataIsNotCached()
+    {
+        byte[] data = new byte[BlockSize * 4];
+        var baseStorage = new GatedReadAsyncStorage(new MemoryStorage(data));
+        using var storage = new CachedStorage(baseStorage, BlockSize, 1, 1, false);
+
+        byte[] asyncBuffer = new byte[3];
+        ValueTask<Result> asyncRead = storage.ReadAsync(0, asyncBuffer);
+
+        // Write the block and then evict it so the new data is only in the base storage.
+        Assert.Success(storage.Write(0, new byte[] { 1, 2, 3 }));
+        Assert.Success(storage.Read(BlockSize, new byte[1]));
+
+        baseStorage.Gate.SetResult();
+        Assert.Success(await asyncRead);
+
+        Assert.Equal(new byte[] { 1, 2, 3 }, asyncBuffer);
+
+        byte[] buffer = new byte[3];
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Equal(new byte[] { 1, 2, 3 }, buffer);
+    }
+
+    [Fact]
+    public void Write_IsWrittenToBaseStorageOnFlush()
+    {
+        byte[] data = CreateData(BlockSize * 10, 3);
+        byte[] expected = data.AsSpan().ToArray();
+        byte[] writeData = CreateData(BlockSize * 2, 4);
+
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 4, false);
+
+        Assert.Success(storage.Write(0x150, writeData));
+        writeData.CopyTo(expected.AsSpan(0x150));
+
+        byte[] readBuffer = new byte[data.Length];
+        Assert.Success(storage.Read(0, readBuffer));
+        Assert.Equal(expected, readBuffer);
+
+        Assert.Success(storage.Flush());
+        Assert.Equal(expected, data);
+    }
+
+    [Fact]
+    public void Write_EvictedDirtyBlockIsWrittenToBaseStorage()
+    {
+        byte[] data = new byte[BlockSize * 8];
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 1, false);
+
+        Assert.Success(storage.Write(0, new byte[] { 1, 2, 3 }));
+        Assert.Success(storage.Read(BlockSize * 4, new byte[1]));
+
+        Assert.Equal(new byte[] { 1, 2, 3 }, data.AsSpan(0, 3).ToArray());
+    }
+
+    [Fact]
+    public void Read_CountsHitsMissesAndEvictions()
+    {
+        byte[] data = new byte[BlockSize * 8];
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 2, 1, false);
+        byte[] buffer = new byte[1];
+
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Success(storage.Read(1, buffer));
+        Assert.Success(storage.Read(BlockSize, buffer));
+        Assert.Success(storage.Read(BlockSize * 2, buffer));
+
+        Assert.Equal(1, storage.HitCount);
+        Assert.Equal(3, storage.MissCount);
+        Assert.Equal(1, storage.EvictionCount);
+    }
+
+    [Fact]
+    public void Read_RecentlyUsedBlockGetsSecondChance()
+    {
+        byte[] data = new byte[BlockSize * 8];
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 3, 1, false);
+        byte[] buffer = new byte[1];
+
+        // Fill the cache, then clear every block's referenced bit by evicting block 0
+        Assert.Success(storage.Read(BlockSize * 0, buffer));
+        Assert.Success(storage.Read(BlockSize * 1, buffer));
+        Assert.Success(storage.Read(BlockSize * 2, buffer));
+        Assert.Success(storage.Read(BlockSize * 3, buffer));
+
+        // Reference block 1 so block 2 is evicted next instead of it
+        Assert.Success(storage.Read(BlockSize * 1, buffer));
+        Assert.Success(storage.Read(BlockSize * 4, buffer));
+
+        long missCount = storage.MissCount;
+        Assert.Success(storage.Read(BlockSize * 1, buffer));
+        Assert.Equal(missCount, storage.MissCount);
+
+        Assert.Success(storage.Read(BlockSize * 2, buffer));
+        Assert.Equal(missCount + 1, storage.MissCount);
+    }
+
+    [Fact]
+    public void CreateWithByteBudget_CachesWholeBlocksWithinBudget()
+    {
+        byte[] data = new byte[BlockSize * 16];
+        using CachedStorage storage = CachedStorage.CreateWithByteBudget(new MemoryStorage(data), BlockSize,
+            BlockSize * 4 + 0x10, false);
+
+        byte[] buffer = new byte[BlockSize * 4];
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Success(storage.Read(0, buffer));
+
+        Assert.Equal(4, storage.MissCount);
+        Assert.Equal(4, storage.HitCount);
+        Assert.Equal(0, storage.EvictionCount);
+    }
+
+    [Fact]
+    public void Read_ConcurrentReaders_ReturnBaseData()
+    {
+        byte[] data = CreateData(BlockSize * 64, 5);
+        using var storage = new CachedStorage(new MemoryStorage(data), BlockSize, 8, 4, false);
+
+        Parallel.For(0, 8, new ParallelOptions { MaxDegreeOfParallelism = 8 }, threadIndex =>
+        {
+            var random = new Random((ulong)threadIndex + 10);
+            byte[] buffer = new byte[BlockSize * 2];
+
+            for (int i = 0; i < 1000; i++)
+            {
+                int offset = random.Next(0, data.Length - buffer.Length);
+
+                storage.Read(offset, buffer).ThrowIfFailure();
+
+                if (!data.AsSpan(offset, buffer.Length).SequenceEqual(buffer))
+                    throw new InvalidOperationException($"Read at offset 0x{offset:x} returned the wrong data.");
+            }
+        });
+
+        // Each read touches either 2 or 3 blocks
+        Assert.InRange(storage.HitCount + storage.MissCount, 8 * 1000 * 2, 8 * 1000 * 3);
+    }
+
+    [Fact]
+    public void Read_ConcurrentReadersWithoutShardCount_ReadBaseStorageOneAtATime()
+    {
+        byte[] data = CreateData(BlockSize * 64, 8);
+        var baseStorage = new ConcurrencyRecordingStorage(data);
+        using var storage = new CachedStorage(baseStorage, BlockSize, 16, false);
+
+        Parallel.For(0, 4, new ParallelOptions { MaxDegreeOfParallelism = 4 }, threadIndex =>
+        {
+            var random = new Random((ulong)threadIndex + 30);
+            byte[] buffer = new byte[BlockSize];
+
+            for (int i = 0; i < 50; i++)
+            {
+                int offset = random.Next(0, data.Length - buffer.Length);
+                storage.Read(offset, buffer).ThrowIfFailure();
+            }
+        });
+
+        Assert.Equal(1, baseStorage.MaxActiveReads);
+    }
+
+    [Fact]
+    public void Read_ConcurrentReadersOverXtsStorage_ReturnDecryptedData()
+    {
+        byte[] key = CreateData(0x20, 6);
+        byte[] plainData = CreateData(BlockSize * 64, 7);
+        byte[] encryptedData = new byte[plainData.Length];
+
+        using (var encryptor = new Aes128XtsStorage(new MemoryStorage(encryptedData), key, BlockSize, false))
+        {
+            for (int offset = 0; offset < plainData.Length; offset += BlockSize)
+            {
+                Assert.Success(encryptor.Write(offset, plainData.AsSpan(offset, BlockSize)));
+            }
+        }
+
+        var xtsStorage = new Aes128XtsStorage(new MemoryStorage(encryptedData), key, BlockSize, false);
+        using var storage = new CachedStorage(xtsStorage, BlockSize, 8, 4, false);
+
+        Parallel.For(0, 8, new ParallelOptions { MaxDegreeOfParallelism = 8 }, threadIndex =>
+        {
+            var random = new Random((ulong)threadIndex + 20);
+            byte[] buffer = new byte[BlockSize * 2];
+
+            for (int i = 0; i < 1000; i++)
+            {
+                int offset = random.Next(0, plainData.Length - buffer.Length);
+
+                storage.Read(offset, buffer).ThrowIfFailure();
+
+                if (!plainData.AsSpan(offset, buffer.Length).SequenceEqual(buffer))
+                    throw new InvalidOperationException($"Read at offset 0x{offset:x} returned the wrong data.");
+            }
+        });
+    }
+}
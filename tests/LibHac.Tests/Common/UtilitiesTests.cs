@@ -0,0 +1,43 @@
+﻿using System;
+using LibHac.Common;
+using Xunit;
+
+namespace LibHac.Tests.Common;
+
+public class UtilitiesTests
+{
+    [Fact]
+    public void IsZeros_AllZeros_ReturnsTrue()
+    {
+        byte[] data = new byte[300];
+
+        for (int length = 0; length <= data.Length; length++)
+        {
+            Assert.True(data.AsSpan(0, length).IsZeros());
+        }
+    }
+
+    [Fact]
+    public void IsZeros_SingleNonZeroByte_ReturnsFalse()
+    {
+        byte[] data = new byte[300];
+
+        for (int length = 1; length <= data.Length; length += 7)
+        {
+            for (int position = 0; position < length; position++)
+            {
+                data[position] = 0x80;
+                Assert.False(data.AsSpan(0, length).IsZeros());
+                data[position] = 0;
+
+                // Bytes outside the span shouldn't be checked
+                if (length < data.Length)
+                {
+                    data[length] = 1;
+                    Assert.True(data.AsSpan(0, length).IsZeros());
+                    data[length] = 0;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.CompilerServices;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Tests.Util;
+using Xunit;
+using CompressedStorage = LibHac.Tools.FsSystem.CompressedStorage;
+
+namespace LibHac.Tests;
+
+public class CompressedStorageTests
+{
+    private const int NodeSize = 0x4000;
+    private const int CompressedEntrySize = 0x10000;
+
+    private class CompressedStorageData
+    {
+        public byte[] Header;
+        public byte[] Nodes;
+        public byte[] Entries;
+        public byte[] PhysicalData;
+        public byte[] VirtualData;
+        public int EntryCount;
+    }
+
+    private static CompressedStorageData CreateData(ulong seed, int entryCount)
+    {
+        var random = new Random(seed);
+        var physicalData = new List<byte>();
+        var virtualData = new List<byte>();
+        var entries = new List<CompressedStorage.Entry>();
+
+        for (int i = 0; i < entryCount; i++)
+        {
+            var entry = new CompressedStorage.Entry
+            {
+                VirtualOffset = virtualData.Count,
+                PhysicalOffset = physicalData.Count
+            };
+
+            switch (random.Next(0, 6))
+            {
+                case 0:
+                {
+                    byte[] data = new byte[random.Next(1, 0x8000)];
+                    random.NextBytes(data);
+
+                    entry.CompressionType = CompressionType.None;
+                    entry.PhysicalSize = (uint)data.Length;
+                    physicalData.AddRange(data);
+                    virtualData.AddRange(data);
+                    break;
+                }
+                case 1:
+                {
+                    int size = random.Next(1, 0x8000);
+
+                    entry.CompressionType = CompressionType.Zeroed;
+                    virtualData.AddRange(new byte[size]);
+                    break;
+                }
+                default:
+                {
+                    byte[] compressed = Lz4Tests.CreateCompressedBlock((ulong)(seed * 1000 + (ulong)i),
+                        CompressedEntrySize, out byte[] decompressed);
+
+                    entry.CompressionType = CompressionType.Lz4;
+                    entry.PhysicalSize = (uint)compressed.Length;
+                    physicalData.AddRange(compressed);
+                    virtualData.AddRange(decompressed);
+                    break;
+                }
+            }
+
+            entries.Add(entry);
+        }
+
+        int entrySize = Unsafe.SizeOf<CompressedStorage.Entry>();
+
+        var result = new CompressedStorageData
+        {
+            Header = new byte[BucketTree.QueryHeaderStorageSize()],
+            Nodes = new byte[BucketTree.QueryNodeStorageSize(NodeSize, entrySize, entryCount)],
+            Entries = new byte[BucketTree.QueryEntryStorageSize(NodeSize, entrySize, entryCount)],
+            PhysicalData = physicalData.ToArray(),
+            VirtualData = virtualData.ToArray(),
+            EntryCount = entryCount
+        };
+
+        using var headerStorage = new ValueSubStorage(new MemoryStorage(result.Header), 0, result.Header.Length);
+        using var nodeStorage = new ValueSubStorage(new MemoryStorage(result.Nodes), 0, result.Nodes.Length);
+        using var entryStorage = new ValueSubStorage(new MemoryStorage(result.Entries), 0, result.Entries.Length);
+
+        var builder = new BucketTree.Builder();
+        Assert.Success(builder.Initialize(new ArrayPoolMemoryResource(), in headerStorage, in nodeStorage,
+            in entryStorage, NodeSize, entrySize, entryCount));
+
+        foreach (CompressedStorage.Entry entry in entries)
+        {
+            Assert.Success(builder.Add(in entry));
+        }
+
+        Assert.Success(builder.Finalize(result.VirtualData.Length));
+
+        return result;
+    }
+
+    private static CompressedStorage CreateStorage(CompressedStorageData data)
+    {
+        using var dataStorage = new ValueSubStorage(new MemoryStorage(data.PhysicalData), 0, data.PhysicalData.Length);
+        using var nodeStorage = new ValueSubStorage(new MemoryStorage(data.Nodes), 0, data.Nodes.Length);
+        using var entryStorage = new ValueSubStorage(new MemoryStorage(data.Entries), 0, data.Entries.Length);
+
+        var storage = new CompressedStorage();
+        Assert.Success(storage.Initialize(new ArrayPoolMemoryResource(), in dataStorage, in nodeStorage,
+            in entryStorage, data.EntryCount));
+
+        return storage;
+    }
+
+    [Fact]
+    public void Read_EntireStorage_ReturnsDecompressedData()
+    {
+        CompressedStorageData data = CreateData(1, 100);
+        using CompressedStorage storage = CreateStorage(data);
+
+        byte[] buffer = new byte[data.VirtualData.Length];
+        Assert.Success(storage.Read(0, buffer));
+
+        Assert.Equal(data.VirtualData, buffer);
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void Read_EntireStorageWithThreadCount_ReturnsDecompressedData(int threadCount)
+    {
+        CompressedStorageData data = CreateData(1, 100);
+        using CompressedStorage storage = CreateStorage(data);
+        storage.DecompressionThreadCount = threadCount;
+
+        byte[] buffer = new byte[data.VirtualData.Length];
+        Assert.Success(storage.Read(0, buffer));
+
+        Assert.Equal(data.VirtualData, buffer);
+    }
+
+    [Theory]
+    [InlineData(0x10)]
+    [InlineData(0x4000)]
+    [InlineData(0x12345)]
+    public void Read_SequentialChunks_ReturnsDecompressedData(int chunkSize)
+    {
+        CompressedStorageData data = CreateData(2, 40);
+        using CompressedStorage storage = CreateStorage(data);
+
+        byte[] buffer = new byte[data.VirtualData.Length];
+
+        for (int offset = 0; offset < buffer.Length; offset += chunkSize)
+        {
+            int size = Math.Min(chunkSize, buffer.Length - offset);
+            Assert.Success(storage.Read(offset, buffer.AsSpan(offset, size)));
+        }
+
+        Assert.Equal(data.VirtualData, buffer);
+    }
+
+    [Fact]
+    public void Read_RandomRanges_ReturnsDecompressedData()
+    {
+        CompressedStorageData data = CreateData(3, 60);
+        using CompressedStorage storage = CreateStorage(data);
+
+        var random = new Random(3);
+
+        for (int i = 0; i < 200; i++)
+        {
+            int offset = random.Next(0, data.VirtualData.Length - 1);
+            int size = random.Next(1, Math.Min(0x50000, data.VirtualData.Length - offset));
+
+            byte[] buffer = new byte[size];
+            Assert.Success(storage.Read(offset, buffer));
+
+            Assert.True(data.VirtualData.AsSpan(offset, size).SequenceEqual(buffer));
+        }
+    }
+
+    [Fact]
+    public void Read_CorruptedCompressedData_ReturnsFailure()
+    {
+        CompressedStorageData data = CreateData(4, 10);
+
+        // Replace the compressed data with a block that references data before the start of the output
+        data.PhysicalData.AsSpan().Fill(0x1F);
+
+        using CompressedStorage storage = CreateStorage(data);
+
+        Assert.Failure(storage.Read(0, new byte[data.VirtualData.Length]));
+    }
+}
@@ -0,0 +1,197 @@
+﻿using System;
+using System.Threading;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.Tests.Fs;
+using LibHac.Tools.Fs;
+using LibHac.Tools.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests;
+
+public class CopyPipelineTests
+{
+    private class CountingProgressReport : IProgressReport
+    {
+        private long _value;
+
+        public long Value => Interlocked.Read(ref _value);
+
+        public void Report(long value) => Interlocked.Exchange(ref _value, value);
+        public void ReportAdd(long value) => Interlocked.Add(ref _value, value);
+        public void SetTotal(long value) { }
+        public void LogMessage(string message) { }
+    }
+
+    public static TheoryData<int, int, int> CopySizes => new()
+    {
+        { 0, 1, 0x1000 },
+        { 0x800, 1, 0x1000 },
+        { 0x1000, 2, 0x1000 },
+        { 0x1001, 1, 0x1000 },
+        { 0x7A31, 1, 0x1000 },
+        { 0x7A31, 3, 0x1000 },
+        { 0x10000, 8, 0x1000 },
+        { 0x10000, 32, 0x1000 }
+    };
+
+    [Theory, MemberData(nameof(CopySizes))]
+    public void Copy_CopiesAllData(int size, int readerCount, int chunkSize)
+    {
+        byte[] source = new byte[size];
+        byte[] dest = new byte[size];
+        new Random(1234).NextBytes(source);
+
+        var progress = new CountingProgressReport();
+
+        Result res = CopyPipeline.Copy(
+            (offset, destination) =>
+            {
+                source.AsSpan((int)offset, destination.Length).CopyTo(destination);
+                return Result.Success;
+            },
+            (offset, data) =>
+            {
+                data.CopyTo(dest.AsSpan((int)offset));
+                return Result.Success;
+            },
+            size, readerCount, progress, chunkSize);
+
+        Assert.Success(res);
+        Assert.Equal(source, dest);
+        Assert.Equal(size, progress.Value);
+    }
+
+    [Fact]
+    public void Copy_ReadFails_ReturnsFailureWithoutWritingFailedChunk()
+    {
+        const int chunkSize = 0x1000;
+        byte[] dest = new byte[chunkSize * 8];
+        long highestWrittenOffset = -1;
+
+        Result res = CopyPipeline.Copy(
+            (offset, destination) =>
+            {
+                if (offset == chunkSize * 3)
+                    return ResultFs.OutOfRange.Log();
+
+                destination.Fill(1);
+                return Result.Success;
+            },
+            (offset, data) =>
+            {
+                highestWrittenOffset = Math.Max(highestWrittenOffset, offset);
+                data.CopyTo(dest.AsSpan((int)offset));
+                return Result.Success;
+            },
+            dest.Length, 2, chunkSize: chunkSize);
+
+        Assert.Result(ResultFs.OutOfRange, res);
+        Assert.Equal(chunkSize * 2, highestWrittenOffset);
+    }
+
+    [Fact]
+    public void Copy_ReadThrowsAfterWriteFails_ExceptionIsThrown()
+    {
+        const int chunkSize = 0x1000;
+
+        Assert.Throws<InvalidOperationException>(() => CopyPipeline.Copy(
+            (offset, destination) =>
+            {
+                if (offset == chunkSize)
+                    throw new InvalidOperationException();
+
+                return Result.Success;
+            },
+            (_, _) => ResultFs.OutOfRange.Log(),
+            chunkSize * 8, 2, chunkSize: chunkSize));
+    }
+
+    [Fact]
+    public void CopyFiles_CopyFails_ReturnsFailure()
+    {
+        long[] sizes = [0x100, 0x200, CopyPipeline.LargeFileThreshold, 0x300];
+
+        Result res = CopyPipeline.CopyFiles(sizes, 4,
+            (index, _) => index == 2 ? ResultFs.OutOfRange.Log() : Result.Success);
+
+        Assert.Result(ResultFs.OutOfRange, res);
+    }
+
+    [Fact]
+    public void CopyFiles_LargeFilesUseAllThreads()
+    {
+        long[] sizes = [0x100, CopyPipeline.LargeFileThreshold, 0x300];
+        int[] readerCounts = new int[sizes.Length];
+
+        Result res = CopyPipeline.CopyFiles(sizes, 4, (index, readerCount) =>
+        {
+            readerCounts[index] = readerCount;
+            return Result.Success;
+        });
+
+        Assert.Success(res);
+        Assert.Equal(new[] { 1, 4, 1 }, readerCounts);
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void CopyDirectory_CopiesAllFiles(int threadCount)
+    {
+        (string Path, int Size)[] files =
+        [
+            ("/a", 0),
+            ("/b", 0x1234),
+            ("/dir/c", 0x100000),
+            ("/dir/sub/d", 0x250000),
+            ("/dir/sub/e", 0x10)
+        ];
+
+        var sourceFs = new InMemoryFileSystem();
+        var destFs = new InMemoryFileSystem();
+        var random = new Random(5678);
+
+        Assert.Success(sourceFs.CreateDirectory("/dir"));
+        Assert.Success(sourceFs.CreateDirectory("/dir/sub"));
+        Assert.Success(sourceFs.CreateDirectory("/empty"));
+
+        foreach ((string path, int size) in files)
+        {
+            byte[] data = new byte[size];
+            random.NextBytes(data);
+
+            Assert.Success(sourceFs.CreateFile(path, size));
+
+            using var file = new UniqueRef<IFile>();
+            Assert.Success(sourceFs.OpenFile(ref file.Ref, path, OpenMode.Write));
+            Assert.Success(file.Get.Write(0, data, WriteOption.None));
+        }
+
+        var progress = new CountingProgressReport();
+
+        Assert.Success(sourceFs.CopyDirectory(destFs, "/", "/", progress, threadCount: threadCount));
+
+        Assert.Success(destFs.GetEntryType(out DirectoryEntryType type, "/empty"));
+        Assert.Equal(DirectoryEntryType.Directory, type);
+
+        foreach ((string path, int size) in files)
+        {
+            using var sourceFile = new UniqueRef<IFile>();
+            using var destFile = new UniqueRef<IFile>();
+            Assert.Success(sourceFs.OpenFile(ref sourceFile.Ref, path, OpenMode.Read));
+            Assert.Success(destFs.OpenFile(ref destFile.Ref, path, OpenMode.Read));
+
+            Assert.Success(destFile.Get.GetSize(out long destSize));
+            Assert.Equal(size, destSize);
+
+            byte[] expected = new byte[size];
+            byte[] actual = new byte[size];
+            Assert.Success(sourceFile.Get.Read(out _, 0, expected, ReadOption.None));
+            Assert.Success(destFile.Get.Read(out _, 0, actual, ReadOption.None));
+
+            Assert.Equal(expected, actual);
+        }
+    }
+}
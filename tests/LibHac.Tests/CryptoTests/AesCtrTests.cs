@@ -1,4 +1,5 @@
-﻿using LibHac.Crypto;
+﻿using System;
+using LibHac.Crypto;
 using Xunit;
 
 namespace LibHac.Tests.CryptoTests;
@@ -20,4 +21,19 @@ public class AesCtrTests
     {
         Common.CipherTestCore(tv.PlainText, tv.CipherText, Aes.CreateCtrEncryptor(tv.Key, tv.Iv));
     }
+
+    [AesIntrinsicsRequiredFact]
+    public static void TransformIntrinsics_LongInput_MatchesSoftware()
+    {
+        byte[] key = [0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C];
+        byte[] iv = [0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xF0];
+
+        byte[] input = new byte[0x1234];
+        new Random(123).NextBytes(input);
+
+        byte[] expected = new byte[input.Length];
+        Aes.CreateCtrEncryptor(key, iv, true).Transform(input, expected);
+
+        Common.CipherTestCore(input, expected, Aes.CreateCtrEncryptor(key, iv));
+    }
 }
\ No newline at end of file
@@ -58,6 +58,30 @@ public class AesXtsTests
             (key, iv) => Aes.CreateXtsDecryptor(key.AsSpan(0, 0x10), key.AsSpan(0x10, 0x10), iv));
     }
 
+    [AesIntrinsicsRequiredTheory]
+    [InlineData(0x4000)]
+    [InlineData(0x4000 + 0x70)]
+    [InlineData(0x4000 + 0x79)]
+    public static void TransformIntrinsics_LongInput_MatchesSoftware(int length)
+    {
+        byte[] key1 = new byte[0x10];
+        byte[] key2 = new byte[0x10];
+        byte[] iv = new byte[0x10];
+        byte[] plainText = new byte[length];
+
+        var random = new Random((ulong)length);
+        random.NextBytes(key1);
+        random.NextBytes(key2);
+        random.NextBytes(iv);
+        random.NextBytes(plainText);
+
+        byte[] cipherText = new byte[length];
+        Aes.CreateXtsEncryptor(key1, key2, iv, true).Transform(plainText, cipherText);
+
+        Common.CipherTestCore(plainText, cipherText, Aes.CreateXtsEncryptor(key1, key2, iv));
+        Common.CipherTestCore(cipherText, plainText, Aes.CreateXtsDecryptor(key1, key2, iv));
+    }
+
 
     // The above tests run all the test vectors in a single test to avoid having thousands of tests.
     // Use the below tests if running each test vector as an individual test is needed.
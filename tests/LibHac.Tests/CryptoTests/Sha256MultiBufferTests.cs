@@ -0,0 +1,114 @@
+﻿using System;
+using System.Security.Cryptography;
+using LibHac.Crypto;
+using LibHac.Crypto.Impl;
+using Xunit;
+
+namespace LibHac.Tests.CryptoTests;
+
+public class Sha256MultiBufferTests
+{
+    public static TheoryData<int, int, int> BlockSizes => new()
+    {
+        // Block size, block count, prefix size
+        { 0x4000, 8, 0 },
+        { 0x4000, 19, 0x20 },
+        { 0x200, 13, 0 },
+        { 0x40, 8, 0 },
+        { 0x37, 8, 0 },
+        { 0x38, 12, 0 },
+        { 0x3F, 4, 0x20 },
+        { 1, 16, 0 },
+        { 0x1000, 9, 0x40 },
+        { 0x1001, 11, 0x47 }
+    };
+
+    private static byte[] CalculateExpectedHashes(byte[] prefix, byte[] data, int blockSize)
+    {
+        int blockCount = (data.Length + blockSize - 1) / blockSize;
+        byte[] hashes = new byte[blockCount * Sha256.DigestSize];
+
+        for (int i = 0; i < blockCount; i++)
+        {
+            int size = Math.Min(blockSize, data.Length - i * blockSize);
+
+            using var hash = IncrementalHash.CreateHash(HashAlgorithmName.SHA256);
+            hash.AppendData(prefix);
+            hash.AppendData(data, i * blockSize, size);
+            hash.GetHashAndReset(hashes.AsSpan(i * Sha256.DigestSize, Sha256.DigestSize));
+        }
+
+        return hashes;
+    }
+
+    private static (byte[] Prefix, byte[] Data) CreateData(int blockSize, int blockCount, int prefixSize)
+    {
+        byte[] prefix = new byte[prefixSize];
+        byte[] data = new byte[blockSize * blockCount];
+
+        var random = new Random(12345);
+        random.NextBytes(prefix);
+        random.NextBytes(data);
+
+        return (prefix, data);
+    }
+
+    [Theory, MemberData(nameof(BlockSizes))]
+    public static void GenerateSha256Hashes_MultiBuffer_MatchesSingleBuffer(int blockSize, int blockCount,
+        int prefixSize)
+    {
+        (byte[] prefix, byte[] data) = CreateData(blockSize, blockCount, prefixSize);
+        byte[] expected = CalculateExpectedHashes(prefix, data, blockSize);
+
+        byte[] actual = new byte[expected.Length];
+        Sha256.GenerateSha256Hashes(prefix, data, blockSize, actual, useMultiBuffer: true);
+
+        Assert.Equal(expected, actual);
+    }
+
+    [Fact]
+    public static void GenerateSha256Hashes_PartialLastBlock_HashesPartialBlock()
+    {
+        const int blockSize = 0x100;
+
+        byte[] data = new byte[blockSize * 9 + 0x33];
+        new Random(6789).NextBytes(data);
+
+        byte[] expected = CalculateExpectedHashes([], data, blockSize);
+
+        byte[] actual = new byte[expected.Length];
+        Sha256.GenerateSha256Hashes(data, blockSize, actual);
+
+        Assert.Equal(expected, actual);
+    }
+
+    [Theory, MemberData(nameof(BlockSizes))]
+    public static void HashEightAvx2_MatchesSingleBuffer(int blockSize, int blockCount, int prefixSize)
+    {
+        if (!Sha256MultiBuffer.IsAvx2Supported || blockCount < 8)
+            return;
+
+        (byte[] prefix, byte[] data) = CreateData(blockSize, 8, prefixSize);
+        byte[] expected = CalculateExpectedHashes(prefix, data, blockSize);
+
+        byte[] actual = new byte[expected.Length];
+        Sha256MultiBuffer.HashEightAvx2(prefix, data, blockSize, actual);
+
+        Assert.Equal(expected, actual);
+    }
+
+    [Theory, MemberData(nameof(BlockSizes))]
+    public static void HashFourSsse3_MatchesSingleBuffer(int blockSize, int blockCount, int prefixSize)
+    {
+        if (!Sha256MultiBuffer.IsSsse3Supported || blockCount < 4)
+            return;
+
+        (byte[] prefix, byte[] data) = CreateData(blockSize, 4, prefixSize);
+        byte[] expected = CalculateExpectedHashes(prefix, data, blockSize);
+
+        byte[] actual = new byte[expected.Length];
+        Sha256MultiBuffer.HashFourSsse3(prefix, data, blockSize, actual);
+
+        Assert.Equal(expected, actual);
+    }
+}
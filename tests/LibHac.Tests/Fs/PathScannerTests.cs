@@ -0,0 +1,146 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+using LibHac.Fs;
+using Xunit;
+
+namespace LibHac.Tests.Fs;
+
+public class PathScannerTests
+{
+    public static TheoryData<string, bool, int> TestData_IsSimpleNormalizedPath => new()
+    {
+        { @"/", true, 1 },
+        { @"/a", true, 2 },
+        { @"/dir/file.txt", true, 13 },
+        { @"/dir/file.txt\0/garbage//", true, 13 },
+        { @"/a/b/c/d/e/f/g/h/i/j/k/l/m/n/o/p/q/r/s/t/u/v/w/x/y/z/0123456789", true, 63 },
+        { @"/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\0/aaaaaaaaaaaaaaaaa", true, 48 },
+        { @"", false, 0 },
+        { @"a/b", false, 0 },
+        { @"/a/", false, 0 },
+        { @"//a", false, 0 },
+        { @"/a//b", false, 0 },
+        { @"/a/./b", false, 0 },
+        { @"/a/../b", false, 0 },
+        { @"/a/.b", false, 0 },
+        { @"/a\b", false, 0 },
+        { @"/a:b", false, 0 },
+        { @"/a*b", false, 0 },
+        { @"/a|b", false, 0 },
+        { @"/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/", false, 0 },
+        { @"/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa//aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", false, 0 },
+        { @"/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\aaaaaaaaaaaaaa", false, 0 },
+    };
+
+    [Theory, MemberData(nameof(TestData_IsSimpleNormalizedPath))]
+    public static void IsSimpleNormalizedPath(string path, bool expectedIsSimple, int expectedLength)
+    {
+        byte[] pathBytes = Encoding.UTF8.GetBytes(path.Replace(@"\0", "\0"));
+
+        bool isSimple = PathScanner.IsSimpleNormalizedPath(pathBytes, out int length);
+
+        Assert.Equal(expectedIsSimple, isSimple);
+        Assert.Equal(expectedLength, length);
+    }
+
+    [Fact]
+    public static void IsSimpleNormalizedPath_NonAsciiCharacter_ReturnsFalse()
+    {
+        byte[] pathBytes = Encoding.UTF8.GetBytes("/dir/\u00e9t\u00e9");
+
+        Assert.False(PathScanner.IsSimpleNormalizedPath(pathBytes, out _));
+    }
+
+    [Fact]
+    public static void IsNormalized_RandomPaths_MatchesReferenceImplementation()
+    {
+        var random = new Random(12345);
+        var pathFlags = new List<PathFlags>();
+
+        for (int i = 0; i < 64; i++)
+        {
+            pathFlags.Add(CreatePathFlags(i));
+        }
+
+        for (int i = 0; i < 5000; i++)
+        {
+            byte[] path = CreateRandomPath(ref random);
+
+            foreach (PathFlags flags in pathFlags)
+            {
+                Result expectedResult = PathFormatter.IsNormalizedImpl(out bool expectedIsNormalized,
+                    out int expectedLength, path, flags);
+                Result result = PathFormatter.IsNormalized(out bool isNormalized, out int length, path, flags);
+
+                Assert.Equal(expectedResult, result);
+
+                if (expectedResult.IsSuccess())
+                {
+                    Assert.Equal(expectedIsNormalized, isNormalized);
+
+                    if (expectedIsNormalized)
+                        Assert.Equal(expectedLength, length);
+                }
+            }
+
+            foreach (bool allowAllCharacters in new[] { false, true })
+            {
+                Result expectedResult = PathNormalizer.IsNormalizedImpl(out bool expectedIsNormalized,
+                    out int expectedLength, path, allowAllCharacters);
+                Result result = PathNormalizer.IsNormalized(out bool isNormalized, out int length, path,
+                    allowAllCharacters);
+
+                Assert.Equal(expectedResult, result);
+
+                if (expectedResult.IsSuccess())
+                {
+                    Assert.Equal(expectedIsNormalized, isNormalized);
+                    Assert.Equal(expectedLength, length);
+                }
+            }
+        }
+    }
+
+    private static PathFlags CreatePathFlags(int bits)
+    {
+        var flags = new PathFlags();
+
+        if ((bits & 1) != 0) flags.AllowBackslash();
+        if ((bits & 2) != 0) flags.AllowEmptyPath();
+        if ((bits & 4) != 0) flags.AllowMountName();
+        if ((bits & 8) != 0) flags.AllowRelativePath();
+        if ((bits & 16) != 0) flags.AllowWindowsPath();
+        if ((bits & 32) != 0) flags.AllowInvalidCharacter();
+
+        return flags;
+    }
+
+    private static byte[] CreateRandomPath(ref Random random)
+    {
+        string[] prefixes = { "/", "/", "/", "", "mount:", "./", "C:/", "//" };
+        string[] segments =
+        {
+            "a", "dir", "file.txt", "longer_directory_name", "0123456789abcdef0123456789", ".", "..", "",
+            ".hidden", "a:b", "a\\b", "a*", "?", "\u00e9", "\0", "a\0b"
+        };
+
+        var builder = new StringBuilder(prefixes[random.Next(0, prefixes.Length)]);
+        int segmentCount = random.Next(0, 12);
+
+        for (int i = 0; i < segmentCount; i++)
+        {
+            if (i != 0)
+                builder.Append('/');
+
+            // Mostly use simple segments so that long simple paths are common
+            int segmentIndex = random.Next(0, 4) == 0 ? random.Next(0, segments.Length) : random.Next(0, 5);
+            builder.Append(segments[segmentIndex]);
+        }
+
+        if (random.Next(0, 8) == 0)
+            builder.Append('/');
+
+        return Encoding.UTF8.GetBytes(builder.ToString());
+    }
+}
@@ -0,0 +1,132 @@
+﻿using System;
+using System.Collections.Concurrent;
+using System.Linq;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class AsynchronousAccessStorageTests
+{
+    private class ReadRecordingStorage : MemoryStorage
+    {
+        public ConcurrentQueue<(long Offset, long Size)> Reads { get; } = new();
+        public long FailingOffset { get; set; } = -1;
+
+        public ReadRecordingStorage(byte[] data) : base(data) { }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            Reads.Enqueue((offset, destination.Length));
+
+            if (FailingOffset >= offset && FailingOffset < offset + destination.Length)
+                return ResultFs.DataCorrupted.Log();
+
+            return base.Read(offset, destination);
+        }
+    }
+
+    // Only allows splitting requests at multiples of 0x30000
+    private class CoarseAccessSplitter : IAsynchronousAccessSplitter
+    {
+        public const long SplitAlignment = 0x30000;
+
+        public void Dispose() { }
+
+        public Result QueryAppropriateOffset(out long offsetAppropriate, long startOffset, long accessSize,
+            long alignmentSize)
+        {
+            offsetAppropriate = (startOffset + accessSize) / SplitAlignment * SplitAlignment;
+
+            if (offsetAppropriate <= startOffset)
+                offsetAppropriate = (startOffset / SplitAlignment + 1) * SplitAlignment;
+
+            return Result.Success;
+        }
+    }
+
+    private static byte[] CreateData(int size)
+    {
+        byte[] data = new byte[size];
+        new Random(12345).NextBytes(data);
+        return data;
+    }
+
+    private static AsynchronousAccessStorage CreateStorage(ReadRecordingStorage baseStorage,
+        IAsynchronousAccessSplitter splitter, IThreadPool threadPool)
+    {
+        using var sharedBaseStorage = new SharedRef<IStorage>(baseStorage);
+        return new AsynchronousAccessStorage(in sharedBaseStorage, splitter, threadPool);
+    }
+
+    [Fact]
+    public void Read_NoThreadPool_ReadsBaseStorageOnce()
+    {
+        byte[] data = CreateData(0x100000);
+        var baseStorage = new ReadRecordingStorage(data);
+        using AsynchronousAccessStorage storage = CreateStorage(baseStorage,
+            IAsynchronousAccessSplitter.GetDefaultAsynchronousAccessSplitter(), null);
+
+        byte[] buffer = new byte[data.Length];
+        Assert.Success(storage.Read(0, buffer));
+
+        Assert.Equal(data, buffer);
+        Assert.Equal(1, baseStorage.Reads.Count);
+    }
+
+    [Theory]
+    [InlineData(0, 0x100000)]
+    [InlineData(0x1234, 0xF1234)]
+    [InlineData(0x3FFF, 0x8001)]
+    public void Read_WithThreadPool_SplitsReadAndReturnsBaseData(int offset, int size)
+    {
+        byte[] data = CreateData(0x100000 + 0x2000);
+        var baseStorage = new ReadRecordingStorage(data);
+        using var threadPool = new WorkerThreadPool(3, 0x4000);
+        using AsynchronousAccessStorage storage = CreateStorage(baseStorage,
+            IAsynchronousAccessSplitter.GetDefaultAsynchronousAccessSplitter(), threadPool);
+
+        byte[] buffer = new byte[size];
+        Assert.Success(storage.Read(offset, buffer));
+
+        Assert.True(data.AsSpan(offset, size).SequenceEqual(buffer));
+        Assert.True(baseStorage.Reads.Count > 1);
+        Assert.Equal(size, baseStorage.Reads.Sum(r => r.Size));
+    }
+
+    [Fact]
+    public void Read_WithSplitter_ChunksEndOnSplitterBoundaries()
+    {
+        byte[] data = CreateData(0x200000);
+        var baseStorage = new ReadRecordingStorage(data);
+        using var threadPool = new WorkerThreadPool(2, 0x4000);
+        using AsynchronousAccessStorage storage = CreateStorage(baseStorage, new CoarseAccessSplitter(), threadPool);
+
+        const int offset = 0x1000;
+        byte[] buffer = new byte[0x180000];
+        Assert.Success(storage.Read(offset, buffer));
+
+        Assert.True(data.AsSpan(offset, buffer.Length).SequenceEqual(buffer));
+        Assert.True(baseStorage.Reads.Count > 1);
+
+        foreach ((long readOffset, long readSize) in baseStorage.Reads)
+        {
+            long readEnd = readOffset + readSize;
+            Assert.True(readEnd == offset + buffer.Length || readEnd % CoarseAccessSplitter.SplitAlignment == 0);
+        }
+    }
+
+    [Fact]
+    public void Read_ChunkFails_ReturnsFailure()
+    {
+        byte[] data = CreateData(0x100000);
+        var baseStorage = new ReadRecordingStorage(data) { FailingOffset = 0xC0000 };
+        using var threadPool = new WorkerThreadPool(3, 0x4000);
+        using AsynchronousAccessStorage storage = CreateStorage(baseStorage,
+            IAsynchronousAccessSplitter.GetDefaultAsynchronousAccessSplitter(), threadPool);
+
+        Assert.Result(ResultFs.DataCorrupted, storage.Read(0, new byte[data.Length]));
+    }
+}
@@ -61,6 +61,11 @@ public class BucketTreeTests : IClassFixture<BucketTreeBuffers>
         public byte[] Entries;
 
         public BucketTree CreateBucketTree()
+        {
+            return CreateBucketTree(new BucketTreeNodeCache(BucketTreeNodeCache.DefaultCapacity));
+        }
+
+        public BucketTree CreateBucketTree(BucketTreeNodeCache nodeCache)
         {
             int entrySize = Unsafe.SizeOf<IndirectStorage.Entry>();
 
@@ -69,6 +74,8 @@ public class BucketTreeTests : IClassFixture<BucketTreeBuffers>
             using var entryStorage = new ValueSubStorage(new MemoryStorage(Entries), 0, Entries.Length);
 
             var tree = new BucketTree();
+            tree.SetNodeCache(nodeCache);
+
             Assert.Success(tree.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage, NodeSize, entrySize, header.EntryCount));
 
             return tree;
@@ -183,6 +190,122 @@ public class BucketTreeTests : IClassFixture<BucketTreeBuffers>
         }
     }
 
+    [Theory, MemberData(nameof(BucketTreeTestTheoryData))]
+    private void Find_NodeCacheDisabled_ReturnsCorrectEntries(int treeIndex)
+    {
+        const int findCount = 1000;
+
+        ReadOnlySpan<IndirectStorage.Entry> entries = _entries.AsSpan(0, _treeData[treeIndex].EntryCount);
+        BucketTree tree = _treeData[treeIndex].CreateBucketTree(nodeCache: null);
+        Assert.Null(tree.GetNodeCache());
+
+        var random = new Random(654321);
+
+        for (int i = 0; i < findCount; i++)
+        {
+            int entryIndex = random.Next(0, entries.Length);
+
+            using var visitor = new BucketTree.Visitor();
+            Assert.Success(tree.Find(ref visitor.Ref, entries[entryIndex].GetVirtualOffset()));
+            Assert.Equal(entries[entryIndex].GetPhysicalOffset(), visitor.Get<IndirectStorage.Entry>().GetPhysicalOffset());
+
+            if (visitor.CanMoveNext())
+            {
+                Assert.Success(visitor.MoveNext());
+                Assert.Equal(entries[entryIndex + 1].GetVirtualOffset(), visitor.Get<IndirectStorage.Entry>().GetVirtualOffset());
+            }
+        }
+    }
+
+    [Fact]
+    private void Find_SharedNodeCache_CountsHitsAndEvictions()
+    {
+        // Room for about two entry sets
+        var cache = new BucketTreeNodeCache(0x8000 + 0x2000);
+        BucketTreeData data = _treeData[2];
+
+        BucketTree tree1 = data.CreateBucketTree(cache);
+        BucketTree tree2 = data.CreateBucketTree(cache);
+
+        long offset = _entries[100].GetVirtualOffset();
+
+        using (var visitor = new BucketTree.Visitor())
+        {
+            Assert.Success(tree1.Find(ref visitor.Ref, offset));
+        }
+
+        long missCount = cache.MissCount;
+        Assert.NotEqual(0, missCount);
+        Assert.Equal(0, cache.HitCount);
+
+        // The same tree hits the cache, but a different tree has its own nodes
+        using (var visitor = new BucketTree.Visitor())
+        {
+            Assert.Success(tree1.Find(ref visitor.Ref, offset));
+        }
+
+        Assert.Equal(missCount, cache.MissCount);
+        Assert.NotEqual(0, cache.HitCount);
+
+        using (var visitor = new BucketTree.Visitor())
+        {
+            Assert.Success(tree2.Find(ref visitor.Ref, offset));
+        }
+
+        Assert.Equal(missCount * 2, cache.MissCount);
+        Assert.NotEqual(0, cache.EvictionCount);
+        Assert.True(cache.Size <= cache.Capacity);
+
+        tree2.FinalizeObject();
+        tree1.FinalizeObject();
+        Assert.Equal(0, cache.Size);
+    }
+
+    [Fact]
+    private void Initialize_NoNodeCacheSet_NodeCacheIsDisabled()
+    {
+        BucketTreeData data = _treeData[1];
+        int entrySize = Unsafe.SizeOf<IndirectStorage.Entry>();
+
+        BucketTree.Header header = MemoryMarshal.Cast<byte, BucketTree.Header>(data.Header.AsSpan())[0];
+        using var nodeStorage = new ValueSubStorage(new MemoryStorage(data.Nodes), 0, data.Nodes.Length);
+        using var entryStorage = new ValueSubStorage(new MemoryStorage(data.Entries), 0, data.Entries.Length);
+
+        using var tree = new BucketTree();
+        Assert.Success(tree.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage, data.NodeSize,
+            entrySize, header.EntryCount));
+
+        Assert.Null(tree.GetNodeCache());
+    }
+
+    [Fact]
+    private void SetNodeCache_SharedCache_DoesNotKeepTreeAlive()
+    {
+        var cache = new BucketTreeNodeCache(BucketTreeNodeCache.DefaultCapacity);
+        WeakReference treeReference = FindWithUnreferencedTree(cache, _treeData[2], _entries[100].GetVirtualOffset());
+
+        GC.Collect();
+        GC.WaitForPendingFinalizers();
+        GC.Collect();
+
+        Assert.NotEqual(0, cache.Size);
+        Assert.False(treeReference.IsAlive);
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    private static WeakReference FindWithUnreferencedTree(BucketTreeNodeCache cache, BucketTreeData data,
+        long offset)
+    {
+        BucketTree tree = data.CreateBucketTree(cache);
+
+        using (var visitor = new BucketTree.Visitor())
+        {
+            Assert.Success(tree.Find(ref visitor.Ref, offset));
+        }
+
+        return new WeakReference(tree);
+    }
+
     [Theory, MemberData(nameof(BucketTreeTestTheoryData))]
     private void GetEntryCount_ReturnsCorrectCount(int treeIndex)
     {
@@ -1,5 +1,8 @@
 ﻿using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
+using System.Threading;
+using System.Threading.Tasks;
 using LibHac.Fs;
 using LibHac.FsSystem;
 using LibHac.Tests.Fs;
@@ -9,6 +12,51 @@ namespace LibHac.Tests.FsSystem;
 
 public class BufferedStorageTests
 {
+    // Calls a callback after the first base storage read of at least the given size completes,
+    // or after every such read if IsRepeating is set
+    private class HookedReadStorage : IStorage
+    {
+        private readonly IStorage _baseStorage;
+        private readonly int _minReadSize;
+        private Action<long, int> _onRead;
+
+        public bool IsRepeating { get; init; }
+
+        public HookedReadStorage(IStorage baseStorage, int minReadSize, Action<long, int> onRead)
+        {
+            _baseStorage = baseStorage;
+            _minReadSize = minReadSize;
+            _onRead = onRead;
+        }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            Result res = _baseStorage.Read(offset, destination);
+
+            Action<long, int> onRead = _onRead;
+            if (onRead is not null && destination.Length >= _minReadSize)
+            {
+                if (!IsRepeating)
+                    _onRead = null;
+
+                onRead(offset, destination.Length);
+            }
+
+            return res;
+        }
+
+        public override Result Write(long offset, ReadOnlySpan<byte> source) => _baseStorage.Write(offset, source);
+        public override Result Flush() => _baseStorage.Flush();
+        public override Result SetSize(long size) => _baseStorage.SetSize(size);
+        public override Result GetSize(out long size) => _baseStorage.GetSize(out size);
+
+        public override Result OperateRange(Span<byte> outBuffer, OperationId operationId, long offset, long size,
+            ReadOnlySpan<byte> inBuffer)
+        {
+            return _baseStorage.OperateRange(outBuffer, operationId, offset, size, inBuffer);
+        }
+    }
+
     [Fact]
     public void Write_SingleBlock_CanReadBack()
     {
@@ -33,6 +81,167 @@ public class BufferedStorageTests
         Assert.Equal(writeBuffer, readBuffer);
     }
 
+    [Fact]
+    public void Read_SequentialSmallReadsWithReadAhead_ReadsCorrectDataFromPrefetchedBlocks()
+    {
+        byte[] buffer = new byte[0x100000];
+        byte[] workBuffer = new byte[0x18000];
+        var bufferManager = new FileSystemBufferManager();
+        Assert.Success(bufferManager.Initialize(0x40, buffer, 0x4000, workBuffer));
+
+        byte[] storageBuffer = new byte[0x80000];
+        new Random(2432).NextBytes(storageBuffer);
+        using var baseStorage = new ValueSubStorage(new MemoryStorage(storageBuffer), 0, storageBuffer.Length);
+
+        var bufferedStorage = new BufferedStorage();
+        Assert.Success(bufferedStorage.Initialize(in baseStorage, bufferManager, 0x4000, 16));
+        bufferedStorage.EnableReadAhead(8);
+
+        byte[] readBuffer = new byte[0x1000];
+
+        for (int offset = 0; offset < storageBuffer.Length; offset += readBuffer.Length)
+        {
+            Assert.Success(bufferedStorage.Read(offset, readBuffer));
+            Assert.True(storageBuffer.AsSpan(offset, readBuffer.Length).SequenceEqual(readBuffer));
+        }
+
+        ReadAheadStatistics stats = bufferedStorage.GetReadAheadStatistics();
+
+        Assert.Equal(1, stats.SequentialStreamCount);
+        Assert.True(stats.PrefetchedBlockCount > 0);
+        Assert.Equal(stats.PrefetchedBlockCount, stats.PrefetchHitCount);
+    }
+
+    [Fact]
+    public void Read_SequentialSmallReadsWithReadAheadThreadPool_ReadsAheadOnPoolThread()
+    {
+        const int blockSize = 0x4000;
+
+        byte[] buffer = new byte[0x100000];
+        byte[] workBuffer = new byte[0x18000];
+        var bufferManager = new FileSystemBufferManager();
+        Assert.Success(bufferManager.Initialize(0x40, buffer, blockSize, workBuffer));
+
+        byte[] storageBuffer = new byte[0x80000];
+        new Random(2432).NextBytes(storageBuffer);
+
+        // Only read-ahead reads more than one block at a time from the base storage
+        var readAheadThreads = new ConcurrentDictionary<int, bool>();
+        var hookedStorage = new HookedReadStorage(new MemoryStorage(storageBuffer), blockSize * 2,
+            (_, _) => readAheadThreads.TryAdd(Environment.CurrentManagedThreadId, true)) { IsRepeating = true };
+
+        using var baseStorage = new ValueSubStorage(hookedStorage, 0, storageBuffer.Length);
+        using var threadPool = new WorkerThreadPool(1);
+
+        using var bufferedStorage = new BufferedStorage();
+        Assert.Success(bufferedStorage.Initialize(in baseStorage, bufferManager, blockSize, 16));
+        bufferedStorage.EnableReadAhead(8, threadPool);
+
+        byte[] readBuffer = new byte[0x1000];
+
+        for (int offset = 0; offset < storageBuffer.Length; offset += readBuffer.Length)
+        {
+            Assert.Success(bufferedStorage.Read(offset, readBuffer));
+            Assert.True(storageBuffer.AsSpan(offset, readBuffer.Length).SequenceEqual(readBuffer));
+        }
+
+        Assert.True(SpinWait.SpinUntil(() => bufferedStorage.GetReadAheadStatistics().PrefetchCount > 0, 5000));
+        Assert.False(readAheadThreads.IsEmpty);
+        Assert.False(readAheadThreads.ContainsKey(Environment.CurrentManagedThreadId));
+    }
+
+    [Fact]
+    public void Read_SequentialSmallReadsAfterWrite_ReadAheadResumes()
+    {
+        byte[] buffer = new byte[0x100000];
+        byte[] workBuffer = new byte[0x18000];
+        var bufferManager = new FileSystemBufferManager();
+        Assert.Success(bufferManager.Initialize(0x40, buffer, 0x4000, workBuffer));
+
+        byte[] storageBuffer = new byte[0x80000];
+        new Random(2432).NextBytes(storageBuffer);
+        using var baseStorage = new ValueSubStorage(new MemoryStorage(storageBuffer.AsSpan().ToArray()), 0,
+            storageBuffer.Length);
+
+        var bufferedStorage = new BufferedStorage();
+        Assert.Success(bufferedStorage.Initialize(in baseStorage, bufferManager, 0x4000, 16));
+        bufferedStorage.EnableReadAhead(8);
+
+        byte[] writeBuffer = new byte[0x400];
+        writeBuffer.AsSpan().Fill(0xAA);
+        writeBuffer.CopyTo(storageBuffer, 0x10000);
+        Assert.Success(bufferedStorage.Write(0x10000, writeBuffer));
+
+        byte[] readBuffer = new byte[0x1000];
+
+        for (int offset = 0; offset < storageBuffer.Length; offset += readBuffer.Length)
+        {
+            Assert.Success(bufferedStorage.Read(offset, readBuffer));
+            Assert.True(storageBuffer.AsSpan(offset, readBuffer.Length).SequenceEqual(readBuffer));
+        }
+
+        ReadAheadStatistics stats = bufferedStorage.GetReadAheadStatistics();
+
+        Assert.True(stats.PrefetchedBlockCount > 0);
+        Assert.Equal(stats.PrefetchedBlockCount, stats.PrefetchHitCount);
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void Write_DuringReadAheadBaseRead_PrefetchedDataDoesNotReplaceWrittenData(bool useThreadPool)
+    {
+        const int blockSize = 0x4000;
+
+        byte[] buffer = new byte[0x100000];
+        byte[] workBuffer = new byte[0x18000];
+        var bufferManager = new FileSystemBufferManager();
+        Assert.Success(bufferManager.Initialize(0x40, buffer, blockSize, workBuffer));
+
+        byte[] storageBuffer = new byte[0x80000];
+        new Random(2432).NextBytes(storageBuffer);
+
+        var bufferedStorage = new BufferedStorage();
+        Task<Result> writeTask = null;
+        long writeOffset = 0;
+        byte[] writeBuffer = null;
+
+        // Write over the prefetched range after read-ahead has read the old data from the base storage,
+        // but before it has added that data to the cache.
+        var hookedStorage = new HookedReadStorage(new MemoryStorage(storageBuffer), blockSize * 2, (offset, size) =>
+        {
+            writeOffset = offset;
+            writeBuffer = new byte[size];
+            writeBuffer.AsSpan().Fill(0xAA);
+
+            writeTask = Task.Run(() => bufferedStorage.Write(writeOffset, writeBuffer));
+            writeTask.Wait(200);
+        });
+
+        using var baseStorage = new ValueSubStorage(hookedStorage, 0, storageBuffer.Length);
+        using WorkerThreadPool threadPool = useThreadPool ? new WorkerThreadPool(1) : null;
+
+        Assert.Success(bufferedStorage.Initialize(in baseStorage, bufferManager, blockSize, 16));
+        bufferedStorage.EnableReadAhead(8, threadPool);
+
+        byte[] readBuffer = new byte[0x1000];
+
+        for (int offset = 0; offset < storageBuffer.Length && writeTask is null; offset += readBuffer.Length)
+        {
+            Assert.Success(bufferedStorage.Read(offset, readBuffer));
+        }
+
+        // Read-ahead on the thread pool may not have reached the hook yet
+        Assert.True(SpinWait.SpinUntil(() => Volatile.Read(ref writeTask) is not null, 5000));
+        Assert.Success(writeTask.Result);
+
+        for (int offset = 0; offset < writeBuffer.Length; offset += readBuffer.Length)
+        {
+            Assert.Success(bufferedStorage.Read(writeOffset + offset, readBuffer));
+            Assert.True(writeBuffer.AsSpan(offset, readBuffer.Length).SequenceEqual(readBuffer));
+        }
+    }
+
     public class AccessTestConfig
     {
         public int[] SizeClassProbs { get; set; }
@@ -44,6 +253,7 @@ public class BufferedStorageTests
         public int BlockSize { get; set; }
         public int StorageCacheCount { get; set; }
         public bool EnableBulkRead { get; set; }
+        public int ReadAheadBlockCount { get; set; }
         public int StorageSize { get; set; }
         public int HeapSize { get; set; }
         public int HeapBlockSize { get; set; }
@@ -163,6 +373,40 @@ public class BufferedStorageTests
             HeapSize = 0xE00000,
             HeapBlockSize = 0x4000,
             BufferManagerCacheCount = 0x400
+        },
+        new()
+        {
+            SizeClassProbs = [50, 50, 0],
+            SizeClassMaxSizes = [0x4000, 0x80000, 0x800000], // 16 KB, 512 KB, 8 MB
+            TaskProbs = [50, 50, 1], // Read, Write, Flush
+            AccessTypeProbs = [10, 20, 5], // Random, Sequential, Frequent block
+            RngSeed = 4120567,
+            FrequentAccessBlockCount = 6,
+            BlockSize = 0x4000,
+            StorageCacheCount = 16,
+            EnableBulkRead = false,
+            ReadAheadBlockCount = 8,
+            StorageSize = 0x100000,
+            HeapSize = 0x180000,
+            HeapBlockSize = 0x4000,
+            BufferManagerCacheCount = 50
+        },
+        new()
+        {
+            SizeClassProbs = [50, 50, 5],
+            SizeClassMaxSizes = [0x4000, 0x80000, 0x800000], // 16 KB, 512 KB, 8 MB
+            TaskProbs = [50, 50, 1], // Read, Write, Flush
+            AccessTypeProbs = [10, 20, 5], // Random, Sequential, Frequent block
+            RngSeed = 871203,
+            FrequentAccessBlockCount = 16,
+            BlockSize = 0x4000,
+            StorageCacheCount = 8,
+            EnableBulkRead = true,
+            ReadAheadBlockCount = 4,
+            StorageSize = 0x1000000,
+            HeapSize = 0xE00000,
+            HeapBlockSize = 0x4000,
+            BufferManagerCacheCount = 0x400
         }
     ];
 
@@ -206,6 +450,11 @@ public class BufferedStorageTests
             bufferedStorage.EnableBulkRead();
         }
 
+        if (config.ReadAheadBlockCount > 0)
+        {
+            bufferedStorage.EnableReadAhead(config.ReadAheadBlockCount);
+        }
+
         var memoryStorageEntry = new StorageTester.Entry(memoryStorage, memoryStorageArray);
         var bufferedStorageEntry = new StorageTester.Entry(bufferedStorage, bufferedStorageArray);
 
@@ -1,21 +1,25 @@
-﻿using LibHac.Fs;
+﻿using System;
+using System.Threading.Tasks;
+using LibHac.Fs;
 using LibHac.FsSystem;
 using LibHac.Mem;
 using Xunit;
+using Buffer = LibHac.Mem.Buffer;
 using CacheHandle = System.UInt64;
 
 namespace LibHac.Tests.FsSystem;
 
 public class FileSystemBufferManagerTests
 {
-    private FileSystemBufferManager CreateManager(int size, int blockSize = 0x4000, int maxCacheCount = 16)
+    private FileSystemBufferManager CreateManager(int size, int blockSize = 0x4000, int maxCacheCount = 16,
+        int shardCount = 1)
     {
         int orderMax = FileSystemBuddyHeap.QueryOrderMax((nuint)size, (nuint)blockSize);
         nuint workBufferSize = FileSystemBuddyHeap.QueryWorkBufferSize(orderMax);
         byte[] workBuffer = new byte[workBufferSize];
         byte[] heapBuffer = new byte[size];
 
-        var bufferManager = new FileSystemBufferManager();
+        var bufferManager = new FileSystemBufferManager(shardCount);
         Assert.Success(bufferManager.Initialize(maxCacheCount, heapBuffer, blockSize, workBuffer));
         return bufferManager;
     }
@@ -87,4 +91,181 @@ public class FileSystemBufferManagerTests
         Assert.Equal(buffer3, buffer3B);
         Assert.Equal(buffer4, buffer4B);
     }
+
+    [Fact]
+    public void Sharded_MultipleEntriesEvicted_OldestAreEvicted()
+    {
+        FileSystemBufferManager manager = CreateManager(0x20000, shardCount: 4);
+        Buffer buffer1 = manager.AllocateBuffer(0x8000);
+        Buffer buffer2 = manager.AllocateBuffer(0x8000);
+        Buffer buffer3 = manager.AllocateBuffer(0x8000);
+        Buffer buffer4 = manager.AllocateBuffer(0x8000);
+
+        CacheHandle handle1 = manager.RegisterCache(buffer1, new IBufferManager.BufferAttribute());
+        CacheHandle handle2 = manager.RegisterCache(buffer2, new IBufferManager.BufferAttribute());
+        CacheHandle handle3 = manager.RegisterCache(buffer3, new IBufferManager.BufferAttribute());
+        CacheHandle handle4 = manager.RegisterCache(buffer4, new IBufferManager.BufferAttribute());
+
+        Assert.False(manager.AllocateBuffer(0x10000).IsNull);
+
+        Assert.True(manager.AcquireCache(handle1).IsNull);
+        Assert.True(manager.AcquireCache(handle2).IsNull);
+        Assert.Equal(buffer3, manager.AcquireCache(handle3));
+        Assert.Equal(buffer4, manager.AcquireCache(handle4));
+        Assert.Equal(2, manager.GetRetriedCount());
+    }
+
+    [Fact]
+    public void Sharded_BuffersHeldInMagazines_AreReturnedForLargeAllocations()
+    {
+        const int heapSize = 0x400000;
+        FileSystemBufferManager manager = CreateManager(heapSize, shardCount: 2);
+
+        var buffers = new Buffer[0x40];
+        for (int i = 0; i < buffers.Length; i++)
+        {
+            buffers[i] = manager.AllocateBuffer(0x4000);
+            Assert.False(buffers[i].IsNull);
+        }
+
+        foreach (Buffer buffer in buffers)
+        {
+            manager.DeallocateBuffer(buffer);
+        }
+
+        Assert.Equal(heapSize, manager.GetFreeSize());
+        Assert.Equal(heapSize - buffers.Length * 0x4000, manager.GetFreeSizePeak());
+
+        // The whole heap can only be allocated if the freed blocks were coalesced.
+        Buffer wholeHeap = manager.AllocateBuffer(heapSize);
+        Assert.False(wholeHeap.IsNull);
+        Assert.Equal(0, manager.GetFreeSize());
+        Assert.Equal(0, manager.GetRetriedCount());
+
+        manager.DeallocateBuffer(wholeHeap);
+        manager.ClearPeak();
+        Assert.Equal(heapSize, manager.GetFreeSizePeak());
+        Assert.Equal(heapSize, manager.GetTotalAllocatableSizePeak());
+    }
+
+    [Fact]
+    public void Sharded_CacheTableFull_RegisterEvictsOldest()
+    {
+        FileSystemBufferManager manager = CreateManager(0x40000, maxCacheCount: 2, shardCount: 4);
+        Buffer buffer1 = manager.AllocateBuffer(0x4000);
+        Buffer buffer2 = manager.AllocateBuffer(0x4000);
+        Buffer buffer3 = manager.AllocateBuffer(0x4000);
+
+        CacheHandle handle1 = manager.RegisterCache(buffer1, new IBufferManager.BufferAttribute());
+        CacheHandle handle2 = manager.RegisterCache(buffer2, new IBufferManager.BufferAttribute());
+        CacheHandle handle3 = manager.RegisterCache(buffer3, new IBufferManager.BufferAttribute());
+
+        Assert.Equal(0x4000 * 2, manager.GetTotalAllocatableSize() - manager.GetFreeSize());
+
+        Assert.True(manager.AcquireCache(handle1).IsNull);
+        Assert.Equal(buffer2, manager.AcquireCache(handle2));
+        Assert.Equal(buffer3, manager.AcquireCache(handle3));
+        Assert.Equal(1, manager.GetRetriedCount());
+        Assert.Equal(0x40000 - 0x4000 * 2, manager.GetFreeSize());
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void CacheTableFull_MinimumCacheCountAppliesToWholeCache(int shardCount)
+    {
+        // 32 entries keep at least 2 cached buffers of each level, which is less than 1 per shard with 4 shards.
+        FileSystemBufferManager manager = CreateManager(0x200000, maxCacheCount: 32, shardCount: shardCount);
+        var keptAttribute = new IBufferManager.BufferAttribute(1);
+
+        Buffer buffer1 = manager.AllocateBuffer(0x4000);
+        Buffer buffer2 = manager.AllocateBuffer(0x4000);
+        CacheHandle handle1 = manager.RegisterCache(buffer1, keptAttribute);
+        CacheHandle handle2 = manager.RegisterCache(buffer2, keptAttribute);
+
+        // Fill the table and then keep registering so the oldest entries are evicted.
+        for (int i = 0; i < 60; i++)
+        {
+            Buffer buffer = manager.AllocateBuffer(0x4000);
+            Assert.False(buffer.IsNull);
+            manager.RegisterCache(buffer, new IBufferManager.BufferAttribute());
+        }
+
+        Assert.Equal(30, manager.GetRetriedCount());
+        Assert.Equal(buffer1, manager.AcquireCache(handle1));
+        Assert.Equal(buffer2, manager.AcquireCache(handle2));
+    }
+
+    /// <summary>
+    /// Runs a mixed allocate/register/acquire/deallocate workload from several threads at once and checks that
+    /// no buffer is handed out twice and that the accounting balances afterward.
+    /// </summary>
+    private static void RunContentionWorkload(FileSystemBufferManager manager, int threadCount, int iterations)
+    {
+        Parallel.For(0, threadCount, new ParallelOptions { MaxDegreeOfParallelism = threadCount }, threadIndex =>
+        {
+            var random = new Random((ulong)threadIndex + 1);
+            var handles = new CacheHandle[4];
+            byte fill = (byte)(threadIndex + 1);
+
+            for (int i = 0; i < iterations; i++)
+            {
+                int size = 0x4000 << random.Next(0, 3);
+                Buffer buffer = manager.AllocateBuffer(size);
+                if (buffer.IsNull)
+                    continue;
+
+                buffer.Span.Fill(fill);
+
+                int slot = i % handles.Length;
+                Buffer oldBuffer = manager.AcquireCache(handles[slot]);
+                if (!oldBuffer.IsNull)
+                {
+                    Assert.True(oldBuffer.Span.IndexOfAnyExcept(fill) < 0);
+                    manager.DeallocateBuffer(oldBuffer);
+                }
+
+                if (random.Next(0, 2) == 0)
+                {
+                    handles[slot] = manager.RegisterCache(buffer, new IBufferManager.BufferAttribute());
+                }
+                else
+                {
+                    Assert.True(buffer.Span.IndexOfAnyExcept(fill) < 0);
+                    manager.DeallocateBuffer(buffer);
+                    handles[slot] = 0;
+                }
+            }
+
+            foreach (CacheHandle handle in handles)
+            {
+                Buffer cachedBuffer = manager.AcquireCache(handle);
+                if (!cachedBuffer.IsNull)
+                {
+                    Assert.True(cachedBuffer.Span.IndexOfAnyExcept(fill) < 0);
+                    manager.DeallocateBuffer(cachedBuffer);
+                }
+            }
+        });
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(8)]
+    public void ManyThreads_AccountingBalances(int shardCount)
+    {
+        const int heapSize = 0x200000;
+        const int threadCount = 8;
+
+        FileSystemBufferManager manager = CreateManager(heapSize, maxCacheCount: 64, shardCount: shardCount);
+
+        RunContentionWorkload(manager, threadCount, 2000);
+
+        Assert.Equal(heapSize, manager.GetFreeSize());
+        Assert.Equal(heapSize, manager.GetTotalAllocatableSize());
+        Assert.True(manager.GetFreeSizePeak() < heapSize);
+
+        // Every block must be back in the heap and coalesced.
+        Assert.False(manager.AllocateBuffer(heapSize).IsNull);
+    }
 }
\ No newline at end of file
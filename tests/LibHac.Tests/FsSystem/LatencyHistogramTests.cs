@@ -0,0 +1,80 @@
+﻿using LibHac.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class LatencyHistogramTests
+{
+    [Fact]
+    public void GetValueAtPercentile_NoValues_ReturnsZero()
+    {
+        var histogram = new LatencyHistogram();
+
+        Assert.Equal(0, histogram.GetValueAtPercentile(50));
+        Assert.Equal(0, histogram.TotalCount);
+        Assert.Equal(0, histogram.Mean);
+    }
+
+    [Fact]
+    public void GetValueAtPercentile_SmallValues_AreExact()
+    {
+        var histogram = new LatencyHistogram();
+
+        for (int i = 1; i <= 10; i++)
+        {
+            histogram.Record(i);
+        }
+
+        Assert.Equal(1, histogram.GetValueAtPercentile(0));
+        Assert.Equal(5, histogram.GetValueAtPercentile(50));
+        Assert.Equal(9, histogram.GetValueAtPercentile(90));
+        Assert.Equal(10, histogram.GetValueAtPercentile(100));
+        Assert.Equal(10, histogram.MaxValue);
+        Assert.Equal(5.5, histogram.Mean);
+    }
+
+    [Theory]
+    [InlineData(17)]
+    [InlineData(1000)]
+    [InlineData(123_456_789)]
+    [InlineData(long.MaxValue)]
+    public void GetValueAtPercentile_LargeValues_AreWithinRelativeError(long value)
+    {
+        var histogram = new LatencyHistogram();
+        histogram.Record(value / 2);
+        histogram.Record(value);
+
+        long result = histogram.GetValueAtPercentile(50);
+        long expected = value / 2;
+
+        Assert.InRange(result, expected, expected + expected / LatencyHistogram.SubBucketCount);
+        Assert.Equal(value, histogram.GetValueAtPercentile(100));
+    }
+
+    [Fact]
+    public void Record_NegativeValue_IsRecordedAsZero()
+    {
+        var histogram = new LatencyHistogram();
+        histogram.Record(-5);
+
+        Assert.Equal(1, histogram.TotalCount);
+        Assert.Equal(0, histogram.GetValueAtPercentile(100));
+    }
+
+    [Fact]
+    public void Clone_CopiesValues()
+    {
+        var histogram = new LatencyHistogram();
+        histogram.Record(100);
+        histogram.Record(200);
+
+        LatencyHistogram copy = histogram.Clone();
+        histogram.Reset();
+
+        Assert.Equal(2, copy.TotalCount);
+        Assert.Equal(200, copy.MaxValue);
+        Assert.Equal(150, copy.Mean);
+        Assert.Equal(0, histogram.TotalCount);
+        Assert.Equal(0, histogram.GetValueAtPercentile(100));
+    }
+}
@@ -0,0 +1,205 @@
+﻿using System;
+using System.IO;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class LocalStorageTests : IDisposable
+{
+    private const int FileSize = 0x20000;
+
+    private readonly string _path;
+    private readonly byte[] _data;
+
+    public LocalStorageTests()
+    {
+        _path = System.IO.Path.GetTempFileName();
+        _data = new byte[FileSize];
+        new Random(1234).NextBytes(_data);
+
+        File.WriteAllBytes(_path, _data);
+    }
+
+    public void Dispose()
+    {
+        File.Delete(_path);
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.Stream)]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.MemoryMapped)]
+    public void Read_AllModes_ReturnsFileData(LocalFileIoMode ioMode)
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, ioMode);
+
+        Assert.Success(storage.GetSize(out long size));
+        Assert.Equal(FileSize, size);
+
+        byte[] buffer = new byte[0x1234];
+        Assert.Success(storage.Read(0x5678, buffer));
+
+        Assert.True(_data.AsSpan(0x5678, buffer.Length).SequenceEqual(buffer));
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.Stream)]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.MemoryMapped)]
+    public void Read_PastEndOfFile_ReturnsOutOfRange(LocalFileIoMode ioMode)
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, ioMode);
+
+        Assert.Result(ResultFs.OutOfRange, storage.Read(FileSize - 0x10, new byte[0x20]));
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.MemoryMapped)]
+    public void Read_ConcurrentReaders_ReturnFileData(LocalFileIoMode ioMode)
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, ioMode);
+
+        Parallel.For(0, 64, i =>
+        {
+            int offset = i * 0x700;
+            byte[] buffer = new byte[0x800];
+
+            Assert.Success(storage.Read(offset, buffer));
+            Assert.True(_data.AsSpan(offset, buffer.Length).SequenceEqual(buffer));
+        });
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.Stream)]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.MemoryMapped)]
+    [InlineData(LocalFileIoMode.Asynchronous)]
+    public async Task ReadAsync_AllModes_ReturnsFileData(LocalFileIoMode ioMode)
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, ioMode);
+
+        byte[] buffer = new byte[0x1234];
+        Assert.Success(await storage.ReadAsync(0x5678, buffer));
+
+        Assert.True(_data.AsSpan(0x5678, buffer.Length).SequenceEqual(buffer));
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.Asynchronous)]
+    public async Task ReadAsync_PastEndOfFile_ReturnsOutOfRange(LocalFileIoMode ioMode)
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, ioMode);
+
+        Assert.Result(ResultFs.OutOfRange, await storage.ReadAsync(FileSize - 0x10, new byte[0x20]));
+    }
+
+    [Fact]
+    public async Task ReadAsync_ManyOutstandingReads_ReturnFileData()
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, LocalFileIoMode.Asynchronous);
+
+        byte[][] buffers = Enumerable.Range(0, 64).Select(_ => new byte[0x800]).ToArray();
+        Result[] results = await Task.WhenAll(buffers.Select((b, i) => storage.ReadAsync(i * 0x700, b).AsTask()));
+
+        for (int i = 0; i < buffers.Length; i++)
+        {
+            Assert.Success(results[i]);
+            Assert.True(_data.AsSpan(i * 0x700, buffers[i].Length).SequenceEqual(buffers[i]));
+        }
+    }
+
+    [Fact]
+    public void ReadAsync_CanceledToken_ThrowsTaskCanceledException()
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, LocalFileIoMode.Asynchronous);
+        using var cts = new CancellationTokenSource();
+        cts.Cancel();
+
+        Assert.Throws<TaskCanceledException>(() =>
+            storage.ReadAsync(0, new byte[0x100], cts.Token).AsTask().GetAwaiter().GetResult());
+    }
+
+    [Fact]
+    public void GetMappedSpan_MemoryMapped_ReturnsFileData()
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, LocalFileIoMode.MemoryMapped);
+
+        Assert.Success(storage.GetMappedSpan(out ReadOnlySpan<byte> span, 0x100, 0x1000));
+        Assert.True(_data.AsSpan(0x100, 0x1000).SequenceEqual(span));
+
+        Assert.Result(ResultFs.OutOfRange, storage.GetMappedSpan(out _, FileSize - 0x10, 0x20));
+    }
+
+    [Fact]
+    public void GetMappedSpan_NotMemoryMapped_ReturnsUnsupportedOperation()
+    {
+        using var storage = new LocalStorage(_path, FileAccess.Read, LocalFileIoMode.RandomAccess);
+
+        Assert.Result(ResultFs.UnsupportedOperation, storage.GetMappedSpan(out _, 0, 0x10));
+    }
+
+    [Fact]
+    public void Write_RandomAccess_WritesToFile()
+    {
+        byte[] newData = new byte[0x300];
+        new Random(5678).NextBytes(newData);
+
+        using (var storage = new LocalStorage(_path, FileAccess.ReadWrite, LocalFileIoMode.RandomAccess))
+        {
+            Assert.Success(storage.Write(0x1000, newData));
+            Assert.Success(storage.Flush());
+        }
+
+        newData.CopyTo(_data, 0x1000);
+        Assert.Equal(_data, File.ReadAllBytes(_path));
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.Stream)]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.MemoryMapped)]
+    public void LocalFile_Read_ReturnsFileDataUpToEndOfFile(LocalFileIoMode ioMode)
+    {
+        using var file = new LocalFile(_path, OpenMode.Read, ioMode);
+
+        byte[] buffer = new byte[0x100];
+        Assert.Success(file.Read(out long bytesRead, FileSize - 0x80, buffer, ReadOption.None));
+
+        Assert.Equal(0x80, bytesRead);
+        Assert.True(_data.AsSpan(FileSize - 0x80).SequenceEqual(buffer.AsSpan(0, 0x80)));
+    }
+
+    [Theory]
+    [InlineData(LocalFileIoMode.Stream)]
+    [InlineData(LocalFileIoMode.RandomAccess)]
+    [InlineData(LocalFileIoMode.Asynchronous)]
+    public async Task LocalFile_ReadAsync_ReturnsFileDataUpToEndOfFile(LocalFileIoMode ioMode)
+    {
+        using var file = new LocalFile(_path, OpenMode.Read, ioMode);
+
+        byte[] buffer = new byte[0x100];
+        (Result res, long bytesRead) = await file.ReadAsync(FileSize - 0x80, buffer);
+
+        Assert.Success(res);
+        Assert.Equal(0x80, bytesRead);
+        Assert.True(_data.AsSpan(FileSize - 0x80).SequenceEqual(buffer.AsSpan(0, 0x80)));
+    }
+
+    [Theory]
+    [InlineData(OpenMode.Read, LocalFileIoMode.Stream, FileShare.ReadWrite)]
+    [InlineData(OpenMode.Read, LocalFileIoMode.RandomAccess, FileShare.ReadWrite)]
+    [InlineData(OpenMode.Read, LocalFileIoMode.MemoryMapped, FileShare.Read)]
+    [InlineData(OpenMode.ReadWrite, LocalFileIoMode.RandomAccess, FileShare.Read)]
+    public void GetFileShare_OnlyUnmappedReadOnlyFilesAllowSharedWrites(OpenMode mode, LocalFileIoMode ioMode,
+        FileShare expectedShare)
+    {
+        Assert.Equal(expectedShare, LocalFileSystem.GetFileShare(mode, ioMode));
+    }
+}
@@ -0,0 +1,130 @@
+﻿using LibHac.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class ReadAheadControllerTests
+{
+    [Theory]
+    [InlineData(100, 1000, 8)]
+    [InlineData(100, 150, 3)]
+    [InlineData(1000, 100, ReadAheadController.InitialWindowBlockCount)]
+    public void OnRead_TimedReadAhead_WindowCoversTwiceTheReadAheadTime(long readTicksPerBlock, long prefetchTicks,
+        int expectedWindowBlockCount)
+    {
+        long timestamp = 0;
+        var controller = new ReadAheadController(8, () => timestamp);
+
+        timestamp += readTicksPerBlock;
+        Assert.Equal(0, controller.OnRead(0, 1, out _));
+        timestamp += readTicksPerBlock;
+        Assert.Equal(0, controller.OnRead(1, 1, out _));
+
+        // The stream is detected as sequential on the second read that continues it.
+        // The first read-ahead hasn't been timed yet, so it uses the initial window.
+        timestamp += readTicksPerBlock;
+        Assert.Equal(2, controller.OnRead(2, 1, out long prefetchIndex));
+        Assert.Equal(3, prefetchIndex);
+        controller.OnPrefetched(3, 2, prefetchTicks);
+
+        long nextPrefetchIndex = 5;
+        int windowBlockCount = 0;
+
+        for (long i = 3; i < 64; i++)
+        {
+            timestamp += readTicksPerBlock;
+            int count = controller.OnRead(i, 1, out prefetchIndex);
+            if (count == 0)
+                continue;
+
+            // Each read-ahead starts where the previous one ended
+            Assert.Equal(nextPrefetchIndex, prefetchIndex);
+            nextPrefetchIndex = prefetchIndex + count;
+            windowBlockCount = (int)(nextPrefetchIndex - (i + 1));
+
+            controller.OnPrefetched(prefetchIndex, count, prefetchTicks);
+        }
+
+        Assert.Equal(expectedWindowBlockCount, windowBlockCount);
+        Assert.Equal(1, controller.GetStatistics().SequentialStreamCount);
+    }
+
+    [Fact]
+    public void OnRead_ReaderSlowsDown_WindowShrinks()
+    {
+        long timestamp = 0;
+        var controller = new ReadAheadController(16, () => timestamp);
+        int fastWindowBlockCount = 0;
+        int slowWindowBlockCount = 0;
+
+        for (long i = 0; i < 256; i++)
+        {
+            // The reader becomes 10 times slower halfway through
+            timestamp += i < 128 ? 100 : 1000;
+
+            int count = controller.OnRead(i, 1, out long prefetchIndex);
+            if (count == 0)
+                continue;
+
+            int windowBlockCount = (int)(prefetchIndex + count - (i + 1));
+
+            if (i < 128)
+                fastWindowBlockCount = windowBlockCount;
+            else
+                slowWindowBlockCount = windowBlockCount;
+
+            controller.OnPrefetched(prefetchIndex, count, 800);
+        }
+
+        Assert.Equal(16, fastWindowBlockCount);
+        Assert.Equal(2, slowWindowBlockCount);
+    }
+
+    [Fact]
+    public void OnRead_InterleavedStreams_BothStreamsAreDetected()
+    {
+        var controller = new ReadAheadController(4);
+
+        for (long i = 0; i < 8; i++)
+        {
+            controller.OnRead(i, 1, out _);
+            controller.OnRead(1000 + i, 1, out _);
+        }
+
+        ReadAheadStatistics stats = controller.GetStatistics();
+
+        Assert.Equal(2, stats.SequentialStreamCount);
+        Assert.Equal(2, stats.RandomReadCount);
+    }
+
+    [Fact]
+    public void OnRead_RepeatedReadsOfSameBlock_DoesNotReadAhead()
+    {
+        var controller = new ReadAheadController(4);
+
+        for (int i = 0; i < 8; i++)
+        {
+            Assert.Equal(0, controller.OnRead(10, 1, out _));
+        }
+
+        Assert.Equal(0, controller.GetStatistics().SequentialStreamCount);
+    }
+
+    [Fact]
+    public void GetStatistics_PrefetchedBlocksReadOrDropped_CountsHitsAndWastedBlocks()
+    {
+        var controller = new ReadAheadController(4);
+
+        controller.OnPrefetched(10, 4, 0);
+        controller.OnRead(10, 1, out _);
+        controller.OnRead(11, 1, out _);
+        controller.Reset();
+
+        ReadAheadStatistics stats = controller.GetStatistics();
+
+        Assert.Equal(4, stats.PrefetchedBlockCount);
+        Assert.Equal(2, stats.PrefetchHitCount);
+        Assert.Equal(2, stats.WastedBlockCount);
+        Assert.Equal(0.5, stats.Accuracy);
+    }
+}
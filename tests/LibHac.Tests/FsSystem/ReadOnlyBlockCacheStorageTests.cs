@@ -9,6 +9,19 @@ namespace LibHac.Tests.FsSystem;
 
 public class ReadOnlyBlockCacheStorageTests
 {
+    private class ReadCountingStorage : MemoryStorage
+    {
+        public int ReadCount { get; private set; }
+
+        public ReadCountingStorage(byte[] data) : base(data) { }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            ReadCount++;
+            return base.Read(offset, destination);
+        }
+    }
+
     private class TestContext
     {
         private int _blockSize;
@@ -19,6 +32,7 @@ public class ReadOnlyBlockCacheStorageTests
         public byte[] CacheBuffer;
 
         public ReadOnlyBlockCacheStorage CacheStorage;
+        public ReadCountingStorage BaseStorage;
 
         public TestContext(int blockSize, int cacheBlockCount, int storageBlockCount, ulong rngSeed)
         {
@@ -37,7 +51,8 @@ public class ReadOnlyBlockCacheStorageTests
                 ModifyBlock(GetModifiedBaseDataBlock(i));
             }
 
-            using var baseStorage = new SharedRef<IStorage>(new MemoryStorage(BaseData));
+            BaseStorage = new ReadCountingStorage(BaseData);
+            using var baseStorage = new SharedRef<IStorage>(BaseStorage);
             CacheStorage = new ReadOnlyBlockCacheStorage(in baseStorage, _blockSize, CacheBuffer, _cacheBlockCount);
         }
 
@@ -197,4 +212,43 @@ public class ReadOnlyBlockCacheStorageTests
         context.InvalidateCache();
         Assert.True(context.GetBaseDataBlock(index).SequenceEqual(context.ReadCachedStorage(index)));
     }
+
+    [Fact]
+    public void Read_SequentialBlocksWithReadAhead_ReadsCorrectDataWithFewerBaseReads()
+    {
+        const int storageBlockCount = 64;
+        var context = new TestContext(BlockSize, 8, storageBlockCount, 21341);
+        context.CacheStorage.EnableReadAhead(16);
+
+        for (int i = 0; i < storageBlockCount; i++)
+        {
+            Assert.True(context.GetBaseDataBlock(i).SequenceEqual(context.ReadCachedStorage(i)));
+        }
+
+        ReadAheadStatistics stats = context.CacheStorage.GetReadAheadStatistics();
+
+        Assert.True(context.BaseStorage.ReadCount < storageBlockCount);
+        Assert.Equal(1, stats.SequentialStreamCount);
+        Assert.True(stats.PrefetchedBlockCount > 0);
+        Assert.Equal(stats.PrefetchedBlockCount, stats.PrefetchHitCount);
+    }
+
+    [Fact]
+    public void Read_RandomBlocksWithReadAhead_DoesNotReadAhead()
+    {
+        int[] blockIndexes = [5, 1, 9, 3, 12, 7];
+        var context = new TestContext(BlockSize, 8, StorageBlockCount, 21341);
+        context.CacheStorage.EnableReadAhead(4);
+
+        foreach (int index in blockIndexes)
+        {
+            Assert.True(context.GetBaseDataBlock(index).SequenceEqual(context.ReadCachedStorage(index)));
+        }
+
+        ReadAheadStatistics stats = context.CacheStorage.GetReadAheadStatistics();
+
+        Assert.Equal(blockIndexes.Length, context.BaseStorage.ReadCount);
+        Assert.Equal(blockIndexes.Length, stats.RandomReadCount);
+        Assert.Equal(0, stats.PrefetchedBlockCount);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Tools.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class SparseStorageTests
+{
+    private static IndirectStorageTests.IndirectStorageData CreateTestData()
+    {
+        return IndirectStorageCreator.Create(1234, new SizeRange(0x1000, 1, 10), new SizeRange(0x800, 1, 6),
+            0x200000);
+    }
+
+    private static SparseStorage CreateSparseStorage(ReadOnlySpan<(long VirtualOffset, int StorageIndex)> entries,
+        long endOffset)
+    {
+        const int nodeSize = 0x4000;
+        int entrySize = Unsafe.SizeOf<IndirectStorage.Entry>();
+
+        byte[] headerBuffer = new byte[BucketTree.QueryHeaderStorageSize()];
+        byte[] nodeBuffer = new byte[(int)BucketTree.QueryNodeStorageSize(nodeSize, entrySize, entries.Length)];
+        byte[] entryBuffer = new byte[(int)BucketTree.QueryEntryStorageSize(nodeSize, entrySize, entries.Length)];
+
+        using var headerStorage = new ValueSubStorage(new MemoryStorage(headerBuffer), 0, headerBuffer.Length);
+        using var nodeStorage = new ValueSubStorage(new MemoryStorage(nodeBuffer), 0, nodeBuffer.Length);
+        using var entryStorage = new ValueSubStorage(new MemoryStorage(entryBuffer), 0, entryBuffer.Length);
+
+        var builder = new BucketTree.Builder();
+        Assert.Success(builder.Initialize(new ArrayPoolMemoryResource(), in headerStorage, in nodeStorage,
+            in entryStorage, nodeSize, entrySize, entries.Length));
+
+        // The data entries all read from the start of the zeroed data storage
+        foreach ((long virtualOffset, int storageIndex) in entries)
+        {
+            var entry = new IndirectStorage.Entry { StorageIndex = storageIndex };
+            entry.SetVirtualOffset(virtualOffset);
+
+            Assert.Success(builder.Add(in entry));
+        }
+
+        Assert.Success(builder.Finalize(endOffset));
+
+        BucketTree.Header header = MemoryMarshal.Cast<byte, BucketTree.Header>(headerBuffer)[0];
+
+        using var dataStorage = new ValueSubStorage(new MemoryStorage(new byte[endOffset]), 0, endOffset);
+
+        var storage = new SparseStorage();
+        Assert.Success(storage.Initialize(new ArrayPoolMemoryResource(), in nodeStorage, in entryStorage,
+            header.EntryCount));
+        storage.SetDataStorage(in dataStorage);
+
+        return storage;
+    }
+
+    [Fact]
+    public void GetZeroRanges_FixedTable_AdjacentZeroEntriesAreMerged()
+    {
+        // Storage index 1 entries have no stored data
+        ReadOnlySpan<(long, int)> entries =
+        [
+            (0x0000, 0),
+            (0x1000, 1),
+            (0x1800, 1),
+            (0x3000, 0),
+            (0x4000, 1),
+            (0x4400, 0),
+            (0x5000, 1)
+        ];
+
+        using SparseStorage storage = CreateSparseStorage(entries, 0x6000);
+
+        var ranges = new List<(long Offset, long Size)>();
+        Assert.Success(storage.GetZeroRanges(ranges));
+
+        Assert.Equal(new List<(long, long)> { (0x1000, 0x2000), (0x4000, 0x400), (0x5000, 0x1000) }, ranges);
+    }
+
+    [Fact]
+    public void GetZeroRanges_EmptyTable_EntireStorageIsZero()
+    {
+        using var storage = new SparseStorage();
+        storage.Initialize(0x12345);
+
+        var ranges = new List<(long Offset, long Size)>();
+        Assert.Success(storage.GetZeroRanges(ranges));
+
+        Assert.Equal(new List<(long, long)> { (0, 0x12345) }, ranges);
+    }
+
+    [Fact]
+    public void CopyToStreamSparse_SparseStorage_SkipsZeroRangesAndOutputMatches()
+    {
+        IndirectStorageTests.IndirectStorageData data = CreateTestData();
+        using SparseStorage storage = data.CreateSparseStorage();
+
+        var zeroRanges = new List<(long Offset, long Size)>();
+        Assert.Success(storage.GetZeroRanges(zeroRanges));
+
+        long zeroRangeTotal = 0;
+        foreach ((long _, long size) in zeroRanges)
+            zeroRangeTotal += size;
+
+        using var output = new MemoryStream();
+        long skipped = storage.CopyToStreamSparse(output, data.OriginalStorageBuffer.Length, bufferSize: 0x10000);
+
+        Assert.Equal(data.OriginalStorageBuffer, output.ToArray());
+        Assert.True(skipped >= zeroRangeTotal);
+    }
+
+    [Fact]
+    public void CopyToStreamSparse_ZeroBlocks_AreSkippedAndOutputMatches()
+    {
+        const int blockSize = StorageExtensions.SparseBlockSize;
+
+        byte[] data = new byte[blockSize * 40 + 0x123];
+        new Random(55).NextBytes(data.AsSpan(blockSize * 3, blockSize * 2 + 7));
+        new Random(56).NextBytes(data.AsSpan(blockSize * 20 - 1, 2));
+
+        // Blocks 0-2, 6-18 and 21-40 are zeros
+        long expectedSkipped = blockSize * 3 + blockSize * 13 + (data.Length - blockSize * 21);
+
+        using var output = new MemoryStream();
+        long skipped = new MemoryStorage(data).CopyToStreamSparse(output, data.Length, bufferSize: blockSize * 4 + 0x10);
+
+        Assert.Equal(data, output.ToArray());
+        Assert.Equal(expectedSkipped, skipped);
+    }
+}
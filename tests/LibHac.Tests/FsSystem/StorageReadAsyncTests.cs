@@ -0,0 +1,100 @@
+﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Tools.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests.FsSystem;
+
+public class StorageReadAsyncTests
+{
+    private static byte[] CreateData(int length, ulong rngSeed)
+    {
+        byte[] data = new byte[length];
+        new Random(rngSeed).NextBytes(data);
+        return data;
+    }
+
+    private static byte[] CreateKey(ulong rngSeed) => CreateData(0x10, rngSeed);
+
+    private static async Task AssertAsyncReadMatchesSync(IStorage storage, long offset, int size)
+    {
+        byte[] expected = new byte[size];
+        byte[] actual = new byte[size];
+
+        Assert.Success(storage.Read(offset, expected));
+        Assert.Success(await storage.ReadAsync(offset, actual));
+
+        Assert.Equal(expected, actual);
+    }
+
+    [Fact]
+    public async Task IStorage_DefaultReadAsync_ReturnsSameDataAsRead()
+    {
+        byte[] data = CreateData(0x1000, 1);
+        using var storage = new MemoryStorage(data);
+
+        await AssertAsyncReadMatchesSync(storage, 0x123, 0x456);
+    }
+
+    [Fact]
+    public void IStorage_DefaultReadAsync_CanceledToken_ThrowsTaskCanceledException()
+    {
+        using var storage = new MemoryStorage(new byte[0x100]);
+        using var cts = new CancellationTokenSource();
+        cts.Cancel();
+
+        Assert.Throws<TaskCanceledException>(() =>
+            storage.ReadAsync(0, new byte[0x10], cts.Token).AsTask().GetAwaiter().GetResult());
+    }
+
+    [Fact]
+    public async Task SubStorage_ReadAsync_ReadsFromOffsetInBaseStorage()
+    {
+        byte[] data = CreateData(0x1000, 2);
+        using var subStorage = new SubStorage(new MemoryStorage(data), 0x200, 0x400);
+
+        byte[] buffer = new byte[0x100];
+        Assert.Success(await subStorage.ReadAsync(0x80, buffer));
+
+        Assert.True(data.AsSpan(0x280, buffer.Length).SequenceEqual(buffer));
+        Assert.Result(ResultFs.OutOfRange, await subStorage.ReadAsync(0x380, buffer));
+    }
+
+    [Fact]
+    public async Task AesCtrStorage_ReadAsync_ReturnsSameDataAsRead()
+    {
+        using var storage = new AesCtrStorage(new MemoryStorage(CreateData(0x4000, 3)), CreateKey(4), CreateKey(5));
+
+        await AssertAsyncReadMatchesSync(storage, 0x1230, 0x2000);
+    }
+
+    [Fact]
+    public async Task Aes128CtrStorage_ReadAsync_ReturnsSameDataAsRead()
+    {
+        using var storage = new Aes128CtrStorage(new MemoryStorage(CreateData(0x4000, 6)), CreateKey(7), 0x800,
+            CreateKey(8)[..8], false);
+
+        await AssertAsyncReadMatchesSync(storage, 0x1230, 0x2000);
+    }
+
+    [Fact]
+    public async Task Aes128XtsStorage_ReadAsync_ReturnsSameDataAsRead()
+    {
+        byte[] keys = CreateData(0x20, 9);
+        using var storage = new Aes128XtsStorage(new MemoryStorage(CreateData(0x4000, 10)), keys, 0x200, false);
+
+        await AssertAsyncReadMatchesSync(storage, 0x400, 0x1000);
+    }
+
+    [Fact]
+    public async Task AesCbcStorage_ReadAsync_ReturnsSameDataAsRead()
+    {
+        using var storage = new AesCbcStorage(new MemoryStorage(CreateData(0x4000, 11)), CreateKey(12),
+            CreateKey(13), false);
+
+        await AssertAsyncReadMatchesSync(storage, 0x400, 0x1000);
+    }
+}
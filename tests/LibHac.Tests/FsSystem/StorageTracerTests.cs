@@ -0,0 +1,216 @@
+﻿using System;
+using System.Linq;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.FsSystem;
+using LibHac.Tests.Fs;
+using LibHac.Tools.Fs;
+using Xunit;
+using CachedStorage = LibHac.Tools.FsSystem.CachedStorage;
+
+namespace LibHac.Tests.FsSystem;
+
+public class StorageTracerTests
+{
+    private const int BlockSize = 0x200;
+
+    private static StorageTracer CreateTracedStack(int blockCount, out IStorage storage)
+    {
+        var tracer = new StorageTracer();
+
+        var data = new byte[BlockSize * blockCount];
+        new Random(1234).NextBytes(data);
+
+        storage = tracer.WrapStorage(new MemoryStorage(data), "Base");
+        storage = tracer.WrapStorage(new CachedStorage(storage, BlockSize, 2, true), "Cache");
+        storage = tracer.WrapStorage(new SubStorage(storage, 0, data.Length), "Top");
+
+        return tracer;
+    }
+
+    [Fact]
+    public void Read_StackedLayers_RecordsParentsAndCounts()
+    {
+        using StorageTracer tracer = CreateTracedStack(4, out IStorage storage);
+
+        var buffer = new byte[BlockSize];
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Success(storage.Read(BlockSize, buffer));
+
+        StorageTraceSnapshot snapshot = tracer.GetSnapshot();
+        StorageLayerSnapshot top = snapshot.FindLayer("Top");
+        StorageLayerSnapshot cache = snapshot.FindLayer("Cache");
+        StorageLayerSnapshot baseLayer = snapshot.FindLayer("Base");
+
+        Assert.Null(top.ParentName);
+        Assert.Equal("Top", cache.ParentName);
+        Assert.Equal("Cache", baseLayer.ParentName);
+
+        Assert.Equal(2, top.ReadCount);
+        Assert.Equal(BlockSize * 2, top.ReadBytes);
+        Assert.Equal(2, baseLayer.ReadCount);
+        Assert.Equal(2, top.ReadLatency.TotalCount);
+
+        Assert.Equal(new[] { top }, snapshot.GetRootLayers());
+        Assert.Equal(new[] { cache }, snapshot.GetChildLayers(top));
+    }
+
+    [Fact]
+    public void Read_StackedLayers_SelfTimeExcludesChildTime()
+    {
+        using StorageTracer tracer = CreateTracedStack(8, out IStorage storage);
+
+        var buffer = new byte[BlockSize * 8];
+        for (int i = 0; i < 20; i++)
+        {
+            Assert.Success(storage.Read(0, buffer));
+        }
+
+        StorageTraceSnapshot snapshot = tracer.GetSnapshot();
+        StorageLayerSnapshot top = snapshot.FindLayer("Top");
+        StorageLayerSnapshot cache = snapshot.FindLayer("Cache");
+        StorageLayerSnapshot baseLayer = snapshot.FindLayer("Base");
+
+        Assert.True(top.TotalNanoseconds >= cache.TotalNanoseconds);
+        Assert.True(cache.TotalNanoseconds >= baseLayer.TotalNanoseconds);
+        Assert.Equal(baseLayer.TotalNanoseconds, baseLayer.SelfNanoseconds);
+
+        double selfSum = snapshot.Layers.Sum(l => l.SelfNanoseconds);
+        Assert.Equal(top.TotalNanoseconds, selfSum, 3);
+    }
+
+    [Fact]
+    public void Read_CachedStorage_RecordsCacheHitsOnItsLayer()
+    {
+        using StorageTracer tracer = CreateTracedStack(4, out IStorage storage);
+
+        var buffer = new byte[BlockSize];
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Success(storage.Read(0, buffer));
+
+        StorageTraceSnapshot snapshot = tracer.GetSnapshot();
+        StorageLayerSnapshot cache = snapshot.FindLayer("Cache");
+
+        Assert.Equal(2, cache.CacheHitCount);
+        Assert.Equal(1, cache.CacheMissCount);
+        Assert.Equal(0, snapshot.FindLayer("Top").CacheHitCount);
+        Assert.Equal(1, snapshot.FindLayer("Base").ReadCount);
+    }
+
+    [Fact]
+    public void Read_FailedOperation_IsCounted()
+    {
+        using var tracer = new StorageTracer();
+        IStorage storage = tracer.WrapStorage(new MemoryStorage(new byte[0x100]), "Base");
+
+        var buffer = new byte[0x200];
+        Assert.Result(ResultFs.OutOfRange, storage.Read(0, buffer));
+
+        StorageLayerSnapshot layer = tracer.GetSnapshot().FindLayer("Base");
+        Assert.Equal(1, layer.ReadCount);
+        Assert.Equal(1, layer.FailureCount);
+    }
+
+    [Fact]
+    public void Read_DisabledTracer_RecordsNothing()
+    {
+        using StorageTracer tracer = CreateTracedStack(4, out IStorage storage);
+        tracer.IsEnabled = false;
+
+        var buffer = new byte[BlockSize];
+        Assert.Success(storage.Read(0, buffer));
+
+        foreach (StorageLayerSnapshot layer in tracer.GetSnapshot().Layers)
+        {
+            Assert.Equal(0, layer.OperationCount);
+            Assert.Equal(0, layer.CacheMissCount);
+            Assert.Null(layer.ParentName);
+        }
+    }
+
+    [Fact]
+    public void Dispose_EnabledTracer_TracerIsDisabled()
+    {
+        StorageTracer tracer = CreateTracedStack(4, out IStorage storage);
+        tracer.Dispose();
+
+        Assert.False(tracer.IsEnabled);
+
+        var buffer = new byte[BlockSize];
+        Assert.Success(storage.Read(0, buffer));
+        Assert.Equal(0, tracer.GetSnapshot().FindLayer("Top").OperationCount);
+
+        Assert.Throws<ObjectDisposedException>(() => tracer.IsEnabled = true);
+    }
+
+    [Fact]
+    public void Reset_ClearsRecordedStatistics()
+    {
+        using StorageTracer tracer = CreateTracedStack(4, out IStorage storage);
+
+        var buffer = new byte[BlockSize];
+        Assert.Success(storage.Read(0, buffer));
+
+        tracer.Reset();
+
+        StorageLayerSnapshot top = tracer.GetSnapshot().FindLayer("Top");
+        Assert.Equal(0, top.ReadCount);
+        Assert.Equal(0, top.ReadLatency.TotalCount);
+        Assert.Equal(0, top.TotalNanoseconds);
+    }
+
+    [Fact]
+    public void WrapStorage_SameName_SharesLayer()
+    {
+        using var tracer = new StorageTracer();
+        IStorage storage1 = tracer.WrapStorage(new MemoryStorage(new byte[0x100]), "Layer");
+        IStorage storage2 = tracer.WrapStorage(new MemoryStorage(new byte[0x100]), "Layer");
+
+        var buffer = new byte[0x10];
+        Assert.Success(storage1.Read(0, buffer));
+        Assert.Success(storage2.Read(0, buffer));
+
+        StorageTraceSnapshot snapshot = tracer.GetSnapshot();
+        Assert.Equal(1, snapshot.Layers.Count);
+        Assert.Equal(2, snapshot.Layers[0].ReadCount);
+    }
+
+    [Fact]
+    public void Unwrap_ReturnsInnermostUntracedStorage()
+    {
+        using var tracer = new StorageTracer();
+        var baseStorage = new MemoryStorage(new byte[0x100]);
+        IStorage storage = tracer.WrapStorage(tracer.WrapStorage(baseStorage, "A"), "B");
+
+        Assert.True(ReferenceEquals(baseStorage, StorageTracer.Unwrap(storage)));
+        Assert.True(ReferenceEquals(baseStorage, StorageTracer.Unwrap(baseStorage)));
+    }
+
+    [Fact]
+    public void WrapFileSystem_OpenedFiles_AreTraced()
+    {
+        using var tracer = new StorageTracer();
+        var baseFs = new InMemoryFileSystem();
+        baseFs.CreateFile("/file", 0x1000, CreateFileOptions.None).ThrowIfFailure();
+
+        IFileSystem fs = tracer.WrapFileSystem(baseFs, "FileSystem");
+
+        using var file = new UniqueRef<IFile>();
+        Assert.Success(fs.OpenFile(ref file.Ref, "/file", OpenMode.Read));
+
+        IStorage fileStorage = tracer.WrapStorage(new FileStorage(file.Get), "FileStorage");
+
+        var buffer = new byte[0x800];
+        Assert.Success(fileStorage.Read(0x400, buffer));
+
+        StorageTraceSnapshot snapshot = tracer.GetSnapshot();
+        StorageLayerSnapshot fsLayer = snapshot.FindLayer("FileSystem");
+
+        Assert.Equal(1, fsLayer.ReadCount);
+        Assert.Equal(0x800, fsLayer.ReadBytes);
+        Assert.Equal(1, fsLayer.OtherCount);
+        Assert.Equal("FileStorage", fsLayer.ParentName);
+    }
+}
@@ -0,0 +1,185 @@
+﻿using System;
+using LibHac.Common;
+using LibHac.Crypto;
+using LibHac.Fs;
+using LibHac.Tools.FsSystem;
+using Xunit;
+
+namespace LibHac.Tests;
+
+public class HierarchicalIntegrityVerificationStorageTests
+{
+    private const int BlockSize = 0x4000;
+    private const int DataSize = BlockSize * 300 + 0x1234;
+
+    private class TestContext
+    {
+        public byte[] Data;
+        public byte[] Level1;
+        public byte[] MasterHash;
+
+        public TestContext(ulong rngSeed)
+        {
+            Data = new byte[DataSize];
+            new Random(rngSeed).NextBytes(Data);
+
+            Level1 = HashBlocks(Data);
+            MasterHash = HashBlocks(Level1);
+        }
+
+        public HierarchicalIntegrityVerificationStorage CreateStorage()
+        {
+            var levelInfo = new IntegrityVerificationInfo[3];
+
+            levelInfo[0] = new IntegrityVerificationInfo { Data = new MemoryStorage(MasterHash), BlockSize = 0 };
+            levelInfo[1] = CreateLevelInfo(Level1);
+            levelInfo[2] = CreateLevelInfo(Data);
+
+            return new HierarchicalIntegrityVerificationStorage(levelInfo, IntegrityCheckLevel.IgnoreOnInvalid, false);
+        }
+
+        private static IntegrityVerificationInfo CreateLevelInfo(byte[] data)
+        {
+            return new IntegrityVerificationInfo
+            {
+                Data = new MemoryStorage(data),
+                BlockSize = BlockSize,
+                Type = IntegrityStorageType.RomFs
+            };
+        }
+
+        private static byte[] HashBlocks(byte[] data)
+        {
+            int blockCount = (data.Length + BlockSize - 1) / BlockSize;
+            byte[] hashes = new byte[blockCount * Sha256.DigestSize];
+            byte[] block = new byte[BlockSize];
+
+            for (int i = 0; i < blockCount; i++)
+            {
+                int size = Math.Min(BlockSize, data.Length - i * BlockSize);
+
+                block.AsSpan().Clear();
+                data.AsSpan(i * BlockSize, size).CopyTo(block);
+
+                Sha256.GenerateSha256Hash(block, hashes.AsSpan(i * Sha256.DigestSize, Sha256.DigestSize));
+            }
+
+            return hashes;
+        }
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(2)]
+    [InlineData(8)]
+    public void Validate_ValidData_AllBlocksAreValid(int threadCount)
+    {
+        var context = new TestContext(12345);
+        using HierarchicalIntegrityVerificationStorage storage = context.CreateStorage();
+
+        Assert.Equal(Validity.Valid, storage.Validate(true, threadCount));
+        Assert.True(Array.TrueForAll(storage.LevelValidities[1], x => x == Validity.Valid));
+    }
+
+    [Theory]
+    [InlineData(0)]
+    [InlineData(150)]
+    [InlineData(300)]
+    public void Validate_Parallel_InvalidBlockIsMarkedInvalid(int invalidBlock)
+    {
+        var context = new TestContext(12345);
+        context.Data[invalidBlock * BlockSize + 0x10] ^= 0xFF;
+
+        using HierarchicalIntegrityVerificationStorage storage = context.CreateStorage();
+
+        Assert.Equal(Validity.Invalid, storage.Validate(true, 4));
+
+        Validity[] validities = storage.LevelValidities[1];
+
+        for (int i = 0; i < validities.Length; i++)
+        {
+            Assert.Equal(i == invalidBlock ? Validity.Invalid : Validity.Valid, validities[i]);
+        }
+    }
+
+    [Fact]
+    public void Validate_Parallel_ResultDoesNotDependOnThreadCount()
+    {
+        var context = new TestContext(6789);
+        context.Data[25 * BlockSize] ^= 1;
+        context.Data[200 * BlockSize + 5] ^= 1;
+
+        using HierarchicalIntegrityVerificationStorage expectedStorage = context.CreateStorage();
+        Validity expectedValidity = expectedStorage.Validate(false, 1);
+
+        for (int threadCount = 2; threadCount <= 16; threadCount++)
+        {
+            using HierarchicalIntegrityVerificationStorage storage = context.CreateStorage();
+
+            Assert.Equal(expectedValidity, storage.Validate(false, threadCount));
+            Assert.Equal(expectedStorage.LevelValidities[0], storage.LevelValidities[0]);
+            Assert.Equal(expectedStorage.LevelValidities[1], storage.LevelValidities[1]);
+        }
+    }
+
+    private static HierarchicalIntegrityImage WriteImage(byte[] data, int threadCount)
+    {
+        using var writer = new HierarchicalIntegrityImageWriter(new MemoryStorage(new byte[data.Length]), threadCount);
+
+        Assert.Success(writer.Write(data));
+        Assert.Success(writer.Finish(out HierarchicalIntegrityImage image));
+
+        return image;
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(3)]
+    public void ImageWriter_WrittenImageIsValid(int threadCount)
+    {
+        var context = new TestContext(2468);
+        HierarchicalIntegrityImage image = WriteImage(context.Data, threadCount);
+
+        Assert.Equal(context.Data, image.DataStorage.ToArray());
+
+        using HierarchicalIntegrityVerificationStorage storage =
+            image.OpenVerificationStorage(IntegrityCheckLevel.ErrorOnInvalid);
+
+        Assert.Equal(Validity.Valid, storage.Validate(true, threadCount));
+        Assert.Equal(7, image.Header.NumLevels);
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(3)]
+    public void ImageWriter_RewindAndPatch_MatchesDirectlyWrittenImage(int threadCount)
+    {
+        var context = new TestContext(1357);
+        byte[] finalData = context.Data;
+        byte[] discarded = new byte[0x180000];
+        new Random(9).NextBytes(discarded);
+
+        byte[] patch = { 1, 2, 3, 4, 5 };
+        const long patchOffset = BlockSize * 2 - 2;
+        const int rewindPosition = 0x100000 - 0x123;
+
+        var destination = new MemoryStorage(new byte[finalData.Length + discarded.Length]);
+        using var writer = new HierarchicalIntegrityImageWriter(destination, threadCount);
+
+        // Write data that will be discarded past the end of the first batch
+        Assert.Success(writer.Write(finalData.AsSpan(0, rewindPosition)));
+        Assert.Success(writer.Write(discarded));
+        Assert.Success(writer.Rewind(rewindPosition));
+        Assert.Success(writer.Write(finalData.AsSpan(rewindPosition)));
+
+        patch.CopyTo(finalData.AsSpan((int)patchOffset));
+        Assert.Success(writer.Patch(patchOffset, patch));
+
+        Assert.Success(writer.Finish(out HierarchicalIntegrityImage image));
+        HierarchicalIntegrityImage expectedImage = WriteImage(finalData, 1);
+
+        Assert.Equal(finalData, image.DataStorage.ToArray());
+        Assert.Equal(expectedImage.Header.MasterHash, image.Header.MasterHash);
+        Assert.Equal(expectedImage.HashStorage.ToArray(), image.HashStorage.ToArray());
+    }
+}
@@ -0,0 +1,605 @@
+﻿using System;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.Kvdb;
+using LibHac.Tests.Fs.FileSystemClientTests;
+using LibHac.Tools.Fs;
+using Xunit;
+using TTest = System.Int32;
+
+namespace LibHac.Tests.Kvdb;
+
+public class ChunkedMapKeyValueStoreTests
+{
+    private static ReadOnlySpan<byte> MountName => "mount"u8;
+    private static ReadOnlySpan<byte> RootPath => "mount:/"u8;
+    private static ReadOnlySpan<byte> ArchiveFilePath => "mount:/imkvdb.arc"u8;
+    private static ReadOnlySpan<byte> LogFilePath => "mount:/imkvdb.log"u8;
+
+    private static (ChunkedMapKeyValueStore<T> kvStore, FileSystemClient fsClient) Create<T>(int capacity)
+        where T : unmanaged, IEquatable<T>, IComparable<T>
+    {
+        FileSystemClient fsClient = FileSystemServerFactory.CreateClient(false);
+
+        using var mountedFs = new UniqueRef<IFileSystem>(new InMemoryFileSystem());
+        fsClient.Register(MountName, ref mountedFs.Ref).ThrowIfFailure();
+
+        ChunkedMapKeyValueStore<T> kvStore = Create<T>(fsClient, capacity);
+
+        return (kvStore, fsClient);
+    }
+
+    private static ChunkedMapKeyValueStore<T> Create<T>(FileSystemClient fsClient, int capacity)
+        where T : unmanaged, IEquatable<T>, IComparable<T>
+    {
+        var memoryResource = new ArrayPoolMemoryResource();
+
+        var kvStore = new ChunkedMapKeyValueStore<T>();
+        kvStore.Initialize(fsClient, RootPath, capacity, memoryResource, memoryResource).ThrowIfFailure();
+
+        return kvStore;
+    }
+
+    private static byte[] GenerateValue(int key)
+    {
+        byte[] value = new byte[8 + key % 16];
+        value.AsSpan().Fill(unchecked((byte)key));
+        return value;
+    }
+
+    private static Result PopulateKvStore(ChunkedMapKeyValueStore<TTest> kvStore, int count, int seed = -1)
+    {
+        if (seed == -1 || count == 0)
+        {
+            for (TTest key = 0; key < count; key++)
+            {
+                Result res = kvStore.Set(in key, GenerateValue(key));
+                if (res.IsFailure()) return res.Miss();
+            }
+        }
+        else
+        {
+            var rng = new FullCycleRandom(count, seed);
+
+            for (int i = 0; i < count; i++)
+            {
+                TTest key = rng.Next();
+                Result res = kvStore.Set(in key, GenerateValue(key));
+                if (res.IsFailure()) return res.Miss();
+            }
+        }
+
+        return Result.Success;
+    }
+
+    private static void AssertEntries(ChunkedMapKeyValueStore<TTest> kvStore, Func<TTest, bool> shouldExist, int maxKey)
+    {
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetBeginIterator();
+        int expectedCount = 0;
+
+        for (TTest key = 0; key < maxKey; key++)
+        {
+            if (!shouldExist(key))
+                continue;
+
+            Assert.False(iterator.IsEnd());
+            Assert.Equal(key, iterator.Get().Key);
+            Assert.Equal(GenerateValue(key), iterator.GetValue().ToArray());
+
+            iterator.Next();
+            expectedCount++;
+        }
+
+        Assert.True(iterator.IsEnd());
+        Assert.Equal(expectedCount, kvStore.Count);
+    }
+
+    private static long GetFileSize(FileSystemClient fsClient, ReadOnlySpan<byte> path)
+    {
+        fsClient.OpenFile(out FileHandle file, new U8Span(path), OpenMode.Read).ThrowIfFailure();
+        fsClient.GetFileSize(out long size, file).ThrowIfFailure();
+        fsClient.CloseFile(file);
+
+        return size;
+    }
+
+    private static bool FileExists(FileSystemClient fsClient, ReadOnlySpan<byte> path)
+    {
+        return fsClient.GetEntryType(out _, new U8Span(path)).IsSuccess();
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(100)]
+    [InlineData(2000)]
+    public void Set_RandomOrder_EntriesAreSorted(int count)
+    {
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count, seed: 5));
+
+        AssertEntries(kvStore, _ => true, count);
+    }
+
+    [Fact]
+    public void Set_StoreIsFull_ReturnsOutOfKeyResource()
+    {
+        const int count = 10;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+
+        TTest key = count;
+        Assert.Result(ResultKvdb.OutOfKeyResource, kvStore.Set(in key, GenerateValue(key)));
+
+        // Replacing an existing value doesn't need any more capacity
+        key = 3;
+        Assert.Success(kvStore.Set(in key, GenerateValue(key)));
+    }
+
+    [Fact]
+    public void Delete_EveryOtherEntry_RemainingEntriesAreSorted()
+    {
+        const int count = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count, seed: 3));
+
+        for (TTest key = 0; key < count; key += 2)
+        {
+            Assert.Success(kvStore.Delete(in key));
+        }
+
+        TTest deletedKey = 10;
+        Assert.Result(ResultKvdb.KeyNotFound, kvStore.Delete(in deletedKey));
+        Assert.Result(ResultKvdb.KeyNotFound, kvStore.Get(out _, in deletedKey, new byte[0x20]));
+
+        AssertEntries(kvStore, key => key % 2 == 1, count);
+    }
+
+    [Theory]
+    [InlineData(-1, 1)]
+    [InlineData(500, 501)]
+    [InlineData(501, 501)]
+    [InlineData(1999, 1999)]
+    public void GetLowerBoundIterator_StartsAtFirstEntryGreaterOrEqual(int key, int expectedKey)
+    {
+        const int count = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+
+        for (TTest i = 0; i < count; i++)
+        {
+            TTest oddKey = i * 2 + 1;
+            Assert.Success(kvStore.Set(in oddKey, GenerateValue(oddKey)));
+        }
+
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetLowerBoundIterator(in key);
+
+        Assert.Equal(expectedKey, iterator.Get().Key);
+    }
+
+    [Fact]
+    public void GetLowerBoundIterator_KeyIsGreaterThanAllEntries_IteratorIsEnd()
+    {
+        const int count = 300;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+
+        TTest key = count;
+        Assert.True(kvStore.GetLowerBoundIterator(in key).IsEnd());
+    }
+
+    [Fact]
+    public void FixIterator_AddAndRemoveEntriesInOtherChunks_IteratorPointsToSameEntry()
+    {
+        const int count = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count * 2);
+
+        for (TTest i = 0; i < count; i++)
+        {
+            TTest key = i * 2;
+            Assert.Success(kvStore.Set(in key, GenerateValue(key)));
+        }
+
+        TTest startKey = 1000;
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetLowerBoundIterator(in startKey);
+
+        // Add enough entries before the iterator's position to split chunks
+        for (TTest key = 1; key < 600; key += 2)
+        {
+            Assert.Success(kvStore.Set(in key, GenerateValue(key)));
+            kvStore.FixIterator(ref iterator, in key);
+        }
+
+        Assert.Equal(startKey, iterator.Get().Key);
+
+        // Remove enough entries before the iterator's position to remove chunks
+        for (TTest key = 0; key < 900; key += 2)
+        {
+            Assert.Success(kvStore.Delete(in key));
+            kvStore.FixIterator(ref iterator, in key);
+        }
+
+        Assert.Equal(startKey, iterator.Get().Key);
+
+        iterator.Next();
+        Assert.Equal(startKey + 2, iterator.Get().Key);
+    }
+
+    [Fact]
+    public void FixIterator_RemoveCurrentEntry_IteratorPointsToNextEntry()
+    {
+        const int count = 200;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+
+        TTest key = 127;
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetLowerBoundIterator(in key);
+
+        Assert.Success(kvStore.Delete(in key));
+        kvStore.FixIterator(ref iterator, in key);
+
+        Assert.Equal(128, iterator.Get().Key);
+    }
+
+    [Fact]
+    public void Iterators_RandomSetsAndDeletes_MatchFlatMapKeyValueStore()
+    {
+        const int capacity = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> chunkedStore, FileSystemClient _) = Create<TTest>(capacity);
+
+        FileSystemClient flatFsClient = FileSystemServerFactory.CreateClient(false);
+        using var mountedFs = new UniqueRef<IFileSystem>(new InMemoryFileSystem());
+        flatFsClient.Register(MountName, ref mountedFs.Ref).ThrowIfFailure();
+
+        var memoryResource = new ArrayPoolMemoryResource();
+        var flatStore = new FlatMapKeyValueStore<TTest>();
+        Assert.Success(flatStore.Initialize(flatFsClient, RootPath, capacity, memoryResource, memoryResource));
+
+        var random = new Random(7);
+
+        for (int i = 0; i < 4000; i++)
+        {
+            // Keep an iterator into each store across the change and fix it afterward
+            TTest iteratorKey = random.Next(0, capacity);
+            FlatMapKeyValueStore<TTest>.Iterator flatIterator = flatStore.GetLowerBoundIterator(in iteratorKey);
+            ChunkedMapKeyValueStore<TTest>.Iterator chunkedIterator = chunkedStore.GetLowerBoundIterator(in iteratorKey);
+
+            TTest key = random.Next(0, capacity);
+
+            if (random.Next(0, 3) == 0)
+            {
+                Assert.Equal(flatStore.Delete(in key).IsSuccess(), chunkedStore.Delete(in key).IsSuccess());
+            }
+            else
+            {
+                Assert.Success(flatStore.Set(in key, GenerateValue(key)));
+                Assert.Success(chunkedStore.Set(in key, GenerateValue(key)));
+            }
+
+            if (!flatIterator.IsEnd())
+            {
+                TTest fixKey = flatIterator.Get().Key;
+                flatStore.FixIterator(ref flatIterator, in fixKey);
+                chunkedStore.FixIterator(ref chunkedIterator, in fixKey);
+
+                Assert.Equal(flatIterator.IsEnd(), chunkedIterator.IsEnd());
+                if (!flatIterator.IsEnd())
+                    Assert.Equal(flatIterator.Get().Key, chunkedIterator.Get().Key);
+            }
+
+            if (i % 200 == 0)
+            {
+                AssertSameEntries(flatStore.GetBeginIterator(), chunkedStore.GetBeginIterator());
+
+                TTest lowerBoundKey = random.Next(-1, capacity + 1);
+                AssertSameEntries(flatStore.GetLowerBoundIterator(in lowerBoundKey),
+                    chunkedStore.GetLowerBoundIterator(in lowerBoundKey));
+            }
+        }
+
+        Assert.Equal(flatStore.Count, chunkedStore.Count);
+        AssertSameEntries(flatStore.GetBeginIterator(), chunkedStore.GetBeginIterator());
+
+        static void AssertSameEntries(FlatMapKeyValueStore<TTest>.Iterator flatIterator,
+            ChunkedMapKeyValueStore<TTest>.Iterator chunkedIterator)
+        {
+            while (!flatIterator.IsEnd())
+            {
+                Assert.False(chunkedIterator.IsEnd());
+                Assert.Equal(flatIterator.Get().Key, chunkedIterator.Get().Key);
+                Assert.Equal(flatIterator.GetValue().ToArray(), chunkedIterator.GetValue().ToArray());
+
+                flatIterator.Next();
+                chunkedIterator.Next();
+            }
+
+            Assert.True(chunkedIterator.IsEnd());
+        }
+    }
+
+    [Theory]
+    [InlineData(0)]
+    [InlineData(1)]
+    [InlineData(10)]
+    [InlineData(1000)]
+    public void Load_AfterStoreHasBeenSaved_AllEntriesAreLoaded(int count)
+    {
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count + 5);
+        Assert.Success(PopulateKvStore(kvStore, count, seed: 7));
+
+        Assert.Success(kvStore.Save());
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count + 5);
+        Assert.Success(kvStore.Load());
+
+        AssertEntries(kvStore, _ => true, count);
+    }
+
+    [Fact]
+    public void Save_FewChanges_ChangesAreAppendedToLog()
+    {
+        const int count = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+        Assert.Success(kvStore.Save());
+
+        long archiveSize = GetFileSize(fsClient, ArchiveFilePath);
+        Assert.False(FileExists(fsClient, LogFilePath));
+
+        // Delete some entries and set some others twice across multiple saves
+        for (TTest key = 0; key < 20; key++)
+        {
+            Assert.Success(kvStore.Delete(in key));
+        }
+
+        Assert.Success(kvStore.Save());
+
+        for (TTest key = 0; key < 10; key++)
+        {
+            Assert.Success(kvStore.Set(in key, new byte[3]));
+            Assert.Success(kvStore.Set(in key, GenerateValue(key)));
+        }
+
+        Assert.Success(kvStore.Save());
+
+        Assert.Equal(archiveSize, GetFileSize(fsClient, ArchiveFilePath));
+        Assert.True(FileExists(fsClient, LogFilePath));
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count);
+        Assert.Success(kvStore.Load());
+
+        AssertEntries(kvStore, key => key < 10 || key >= 20, count);
+    }
+
+    [Fact]
+    public void Save_ValueModifiedThroughIterator_ChangeIsAppendedToLog()
+    {
+        const int count = 1000;
+        TTest modifiedKey = 500;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+        Assert.Success(kvStore.Save());
+
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetLowerBoundIterator(in modifiedKey);
+        iterator.GetValue().Fill(0xFF);
+
+        Assert.Success(kvStore.Save());
+        Assert.True(FileExists(fsClient, LogFilePath));
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count);
+        Assert.Success(kvStore.Load());
+
+        byte[] expectedValue = GenerateValue(modifiedKey);
+        expectedValue.AsSpan().Fill(0xFF);
+
+        byte[] value = new byte[expectedValue.Length];
+        Assert.Success(kvStore.Get(out int valueSize, in modifiedKey, value));
+        Assert.Equal(expectedValue.Length, valueSize);
+        Assert.Equal(expectedValue, value);
+    }
+
+    [Fact]
+    public void Save_ManyChanges_ArchiveIsRewrittenAndLogIsDeleted()
+    {
+        const int count = 1000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+        Assert.Success(kvStore.Save());
+
+        TTest key = 0;
+        Assert.Success(kvStore.Delete(in key));
+        Assert.Success(kvStore.Save());
+        Assert.True(FileExists(fsClient, LogFilePath));
+
+        // Change more entries than the log is allowed to hold
+        for (key = 1; key < count / 2; key++)
+        {
+            Assert.Success(kvStore.Delete(in key));
+        }
+
+        Assert.Success(kvStore.Save());
+        Assert.False(FileExists(fsClient, LogFilePath));
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count);
+        Assert.Success(kvStore.Load());
+
+        AssertEntries(kvStore, k => k >= count / 2, count);
+    }
+
+    [Fact]
+    public void Compact_LogExists_LogIsDeleted()
+    {
+        const int count = 100;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count + 1);
+        Assert.Success(PopulateKvStore(kvStore, count));
+        Assert.Success(kvStore.Save());
+
+        TTest key = count;
+        Assert.Success(kvStore.Set(in key, GenerateValue(key)));
+        Assert.Success(kvStore.Save());
+        Assert.True(FileExists(fsClient, LogFilePath));
+
+        Assert.Success(kvStore.Compact());
+        Assert.False(FileExists(fsClient, LogFilePath));
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count + 1);
+        Assert.Success(kvStore.Load());
+
+        AssertEntries(kvStore, _ => true, count + 1);
+    }
+
+    [Fact]
+    public void Load_StoreIsFullAndSaveBothRemovesAndAddsKeys_AllEntriesAreLoaded()
+    {
+        const int count = 100;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count);
+        Assert.Success(PopulateKvStore(kvStore, count));
+        Assert.Success(kvStore.Save());
+
+        // The new key is added before the other key is removed, but the store never holds more than its capacity.
+        TTest removedKey = 0;
+        TTest addedKey = count;
+        TTest laterRemovedKey = 1;
+        Assert.Success(kvStore.Delete(in removedKey));
+        Assert.Success(kvStore.Set(in addedKey, GenerateValue(addedKey)));
+        Assert.Success(kvStore.Delete(in laterRemovedKey));
+        Assert.Success(kvStore.Set(in removedKey, GenerateValue(removedKey)));
+
+        Assert.Success(kvStore.Save());
+        Assert.True(FileExists(fsClient, LogFilePath));
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count);
+        Assert.Success(kvStore.Load());
+
+        AssertEntries(kvStore, key => key != laterRemovedKey, count + 1);
+    }
+
+    [Fact]
+    public void Load_LogIsCorrupted_ReturnsInvalidKeyValue()
+    {
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(10);
+
+        Assert.Success(fsClient.CreateFile(LogFilePath, 0x10));
+
+        Assert.Result(ResultKvdb.InvalidKeyValue, kvStore.Load());
+    }
+
+    [Fact]
+    public void SetRange_MergesWithExistingEntries()
+    {
+        const int count = 1000;
+        const int valueSize = 4;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count * 2);
+
+        for (TTest i = 0; i < count; i++)
+        {
+            TTest key = i * 2;
+            Assert.Success(kvStore.Set(in key, new byte[] { 1, 1, 1, 1 }));
+        }
+
+        // Add the odd keys in reverse order, replace every 4th even key and give key 1 twice
+        TTest[] keys = new TTest[count + count / 4 + 1];
+        byte[] values = new byte[keys.Length * valueSize];
+        int index = 0;
+
+        for (TTest key = count * 2 - 1; key >= 0; key -= 2)
+        {
+            keys[index++] = key;
+        }
+
+        for (TTest key = 0; key < count * 2; key += 8)
+        {
+            keys[index] = key;
+            values.AsSpan(index * valueSize, valueSize).Fill(2);
+            index++;
+        }
+
+        keys[index] = 1;
+        values.AsSpan(index * valueSize, valueSize).Fill(3);
+
+        Assert.Success(kvStore.SetRange(keys, values, valueSize));
+        Assert.Equal(count * 2, kvStore.Count);
+
+        ChunkedMapKeyValueStore<TTest>.Iterator iterator = kvStore.GetBeginIterator();
+
+        for (TTest key = 0; key < count * 2; key++)
+        {
+            byte expected = key == 1 ? (byte)3 : key % 8 == 0 ? (byte)2 : key % 2 == 0 ? (byte)1 : (byte)0;
+
+            Assert.Equal(key, iterator.Get().Key);
+            Assert.Equal(new[] { expected, expected, expected, expected }, iterator.GetValue().ToArray());
+
+            iterator.Next();
+        }
+
+        Assert.True(iterator.IsEnd());
+    }
+
+    [Fact]
+    public void SetRange_StoreWouldBeFull_ReturnsOutOfKeyResourceAndStoreIsUnchanged()
+    {
+        const int count = 10;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient _) = Create<TTest>(count + 2);
+        Assert.Success(PopulateKvStore(kvStore, count));
+
+        TTest[] keys = [5, count, count + 1, count + 2];
+        byte[] values = new byte[keys.Length * 4];
+
+        Assert.Result(ResultKvdb.OutOfKeyResource, kvStore.SetRange(keys, values, 4));
+
+        AssertEntries(kvStore, _ => true, count);
+    }
+
+    [Fact]
+    public void SetRange_StoreIsSavedAndLoaded_AllEntriesAreLoaded()
+    {
+        const int count = 2000;
+
+        (ChunkedMapKeyValueStore<TTest> kvStore, FileSystemClient fsClient) = Create<TTest>(count);
+
+        TTest[] keys = new TTest[count];
+        byte[] values = new byte[count * sizeof(int)];
+        var rng = new FullCycleRandom(count, 11);
+
+        for (int i = 0; i < count; i++)
+        {
+            keys[i] = rng.Next();
+            BitConverter.TryWriteBytes(values.AsSpan(i * sizeof(int)), keys[i]);
+        }
+
+        Assert.Success(kvStore.SetRange(keys, values, sizeof(int)));
+        Assert.Success(kvStore.Save());
+        kvStore.Dispose();
+
+        kvStore = Create<TTest>(fsClient, count);
+        Assert.Success(kvStore.Load());
+        Assert.Equal(count, kvStore.Count);
+
+        for (TTest key = 0; key < count; key++)
+        {
+            byte[] value = new byte[sizeof(int)];
+            Assert.Success(kvStore.Get(out int valueSize, in key, value));
+            Assert.Equal(sizeof(int), valueSize);
+            Assert.Equal(key, BitConverter.ToInt32(value));
+        }
+    }
+}
@@ -0,0 +1,61 @@
+﻿using System;
+using System.Runtime.CompilerServices;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Loader;
+using LibHac.Tests.Util;
+using Xunit;
+
+namespace LibHac.Tests.Loader;
+
+public class NsoReaderTests
+{
+    /// <summary>
+    /// Creates an NSO with a single compressed text segment. The header says the segment decompresses to
+    /// <paramref name="segmentSize"/> bytes, and the compressed data decompresses to <paramref name="decompressedSize"/>.
+    /// </summary>
+    private static byte[] CreateCompressedNso(int segmentSize, int decompressedSize, out byte[] decompressed)
+    {
+        byte[] compressed = Lz4Tests.CreateCompressedBlock(1, decompressedSize, out decompressed);
+        int headerSize = Unsafe.SizeOf<NsoHeader>();
+
+        var header = new NsoHeader();
+        header.Flags = NsoHeader.Flag.TextCompress;
+        header.TextFileOffset = (uint)headerSize;
+        header.TextSize = (uint)segmentSize;
+        header.TextFileSize = (uint)compressed.Length;
+
+        byte[] nso = new byte[headerSize + compressed.Length];
+        SpanHelpers.AsReadOnlyByteSpan(in header).CopyTo(nso);
+        compressed.CopyTo(nso.AsSpan(headerSize));
+
+        return nso;
+    }
+
+    [Fact]
+    public void ReadSegment_CompressedSegment_ReadsDecompressedData()
+    {
+        byte[] nso = CreateCompressedNso(0x2000, 0x2000, out byte[] expected);
+
+        var reader = new NsoReader();
+        Assert.Success(reader.Initialize(new StorageFile(new MemoryStorage(nso), OpenMode.Read)));
+
+        byte[] buffer = new byte[0x2000];
+        Assert.Success(reader.ReadSegment(NsoReader.SegmentType.Text, buffer));
+
+        Assert.Equal(expected, buffer);
+    }
+
+    [Fact]
+    public void ReadSegment_CompressedDataShorterThanSegment_ReturnsInvalidNso()
+    {
+        byte[] nso = CreateCompressedNso(0x2000, 0x1000, out _);
+
+        var reader = new NsoReader();
+        Assert.Success(reader.Initialize(new StorageFile(new MemoryStorage(nso), OpenMode.Read)));
+
+        byte[] buffer = new byte[0x2000];
+        Assert.Result(ResultLoader.InvalidNso, reader.ReadSegment(NsoReader.SegmentType.Text, buffer));
+    }
+}
@@ -0,0 +1,429 @@
+﻿using System;
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Threading;
+using LibHac.Common;
+using LibHac.Common.Keys;
+using LibHac.Crypto;
+using LibHac.Fs;
+using LibHac.FsSystem;
+using LibHac.Tools.FsSystem;
+using LibHac.Tools.FsSystem.NcaUtils;
+using Xunit;
+using NcaFsHeader = LibHac.Tools.FsSystem.NcaUtils.NcaFsHeader;
+
+namespace LibHac.Tests;
+
+public class NcaTests
+{
+    private const int HeaderSize = 0xC00;
+    private const int HashLevelSize = 0x4000;
+    private const int HashBlockSize = 0x4000;
+
+    // Records the threads that read from the storage. When enabled, the first thread to read waits
+    // a few seconds for a second thread to start reading so the reads are sure to overlap.
+    private class ThreadRecordingStorage : MemoryStorage
+    {
+        public ConcurrentDictionary<int, bool> ReadingThreads { get; } = new();
+        public bool WaitForSecondThread { get; set; }
+
+        public ThreadRecordingStorage(byte[] data) : base(data) { }
+
+        public override Result Read(long offset, Span<byte> destination)
+        {
+            if (ReadingThreads.TryAdd(Environment.CurrentManagedThreadId, true) && WaitForSecondThread)
+            {
+                SpinWait.SpinUntil(() => ReadingThreads.Count >= 2, 5000);
+            }
+
+            return base.Read(offset, destination);
+        }
+    }
+
+    private class ProgressRecorder : IProgressReport
+    {
+        public long Total { get; private set; }
+        public long Progress { get; private set; }
+
+        public void Report(long value) => Progress = value;
+        public void ReportAdd(long value) => Progress += value;
+        public void LogMessage(string message) { }
+
+        public void SetTotal(long value)
+        {
+            // Validation resets the total to 0 when it finishes
+            if (value != 0)
+                Total = value;
+        }
+    }
+
+    /// <summary>
+    /// Creates a plaintext NCA with a single unencrypted PartitionFS section containing <paramref name="sectionData"/>.
+    /// The section's hash level is left empty, so it must be opened without integrity checks.
+    /// </summary>
+    private static byte[] CreatePlaintextNca(ReadOnlySpan<byte> sectionData)
+    {
+        int sectionSize = HashLevelSize + sectionData.Length;
+        byte[] nca = new byte[HeaderSize + sectionSize];
+
+        Span<byte> header = nca.AsSpan(0, HeaderSize);
+        "NCA3"u8.CopyTo(header.Slice(0x200));
+        header[0x204] = (byte)DistributionType.Download;
+        header[0x205] = (byte)NcaContentType.Program;
+        BinaryPrimitives.WriteInt64LittleEndian(header.Slice(0x208), nca.Length);
+
+        // Section 0's start and end blocks
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x240), HeaderSize / 0x200);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x244), nca.Length / 0x200);
+        header[0x248] = 1;
+
+        var fsHeader = new NcaFsHeader(nca.AsMemory(0x400, 0x200));
+        fsHeader.Version = 2;
+        fsHeader.FormatType = NcaFormatType.Pfs0;
+        fsHeader.HashType = NcaHashType.Sha256;
+        fsHeader.EncryptionType = NcaEncryptionType.None;
+
+        NcaFsIntegrityInfoSha256 integrityInfo = fsHeader.GetIntegrityInfoSha256();
+        integrityInfo.BlockSize = HashBlockSize;
+        integrityInfo.LevelCount = 2;
+        integrityInfo.GetLevelOffset(0) = 0;
+        integrityInfo.GetLevelSize(0) = HashLevelSize;
+        integrityInfo.GetLevelOffset(1) = HashLevelSize;
+        integrityInfo.GetLevelSize(1) = sectionData.Length;
+
+        Sha256.GenerateSha256Hash(nca.AsSpan(0x400, 0x200), header.Slice(0x280, Sha256.DigestSize));
+
+        sectionData.CopyTo(nca.AsSpan(HeaderSize + HashLevelSize));
+
+        return nca;
+    }
+
+    /// <summary>
+    /// Creates a plaintext NCA like <see cref="CreatePlaintextNca"/>, but with the section's hash level and
+    /// master hash filled in so the section can be verified.
+    /// </summary>
+    private static byte[] CreateVerifiablePlaintextNca(ReadOnlySpan<byte> sectionData)
+    {
+        byte[] nca = CreatePlaintextNca(sectionData);
+
+        Span<byte> hashLevel = nca.AsSpan(HeaderSize, HashLevelSize);
+        Assert.True(sectionData.Length / HashBlockSize * Sha256.DigestSize <= HashLevelSize);
+
+        for (int i = 0; i < sectionData.Length / HashBlockSize; i++)
+        {
+            Sha256.GenerateSha256Hash(sectionData.Slice(i * HashBlockSize, HashBlockSize),
+                hashLevel.Slice(i * Sha256.DigestSize, Sha256.DigestSize));
+        }
+
+        var fsHeader = new NcaFsHeader(nca.AsMemory(0x400, 0x200));
+        Sha256.GenerateSha256Hash(hashLevel, fsHeader.GetIntegrityInfoSha256().MasterHash);
+
+        Sha256.GenerateSha256Hash(nca.AsSpan(0x400, 0x200), nca.AsSpan(0x280, Sha256.DigestSize));
+
+        return nca;
+    }
+
+    /// <summary>
+    /// Creates an encrypted NCA with a single AES-CTR PartitionFS section containing <paramref name="sectionData"/>.
+    /// The section has a sparse layer that removes the data level range <paramref name="removedOffset"/> to
+    /// <paramref name="removedOffset"/> + <paramref name="removedSize"/>. The keys needed to open it are added to
+    /// <paramref name="keySet"/>, and the section's hash level is left empty.
+    /// </summary>
+    private static byte[] CreateEncryptedSparseNca(KeySet keySet, ReadOnlySpan<byte> sectionData, int removedOffset,
+        int removedSize)
+    {
+        const int nodeSize = 0x4000;
+        const ulong upperCounter = 0x1122334455667788;
+        int entrySize = Unsafe.SizeOf<IndirectStorage.Entry>();
+
+        new Random(1).NextBytes(keySet.HeaderKey.Data);
+        new Random(2).NextBytes(keySet.KeyAreaKeys[0][0].Data);
+        byte[] contentKey = new byte[Aes.KeySize128];
+        new Random(3).NextBytes(contentKey);
+
+        // The section's virtual layout is the hash level followed by the data level
+        int virtualSize = HashLevelSize + sectionData.Length;
+        int removedStart = HashLevelSize + removedOffset;
+        int removedEnd = removedStart + removedSize;
+        int physicalDataSize = virtualSize - removedSize;
+
+        ReadOnlySpan<(long VirtualOffset, long PhysicalOffset, int StorageIndex)> entries =
+        [
+            (0, 0, 0),
+            (removedStart, 0, 1),
+            (removedEnd, removedStart, 0)
+        ];
+
+        byte[] headerBuffer = new byte[BucketTree.QueryHeaderStorageSize()];
+        byte[] meta = new byte[(int)(IndirectStorage.QueryNodeStorageSize(entries.Length) +
+                                     IndirectStorage.QueryEntryStorageSize(entries.Length))];
+        int metaNodeSize = (int)IndirectStorage.QueryNodeStorageSize(entries.Length);
+
+        using (var headerStorage = new ValueSubStorage(new MemoryStorage(headerBuffer), 0, headerBuffer.Length))
+        using (var nodeStorage = new ValueSubStorage(new MemoryStorage(meta), 0, metaNodeSize))
+        using (var entryStorage = new ValueSubStorage(new MemoryStorage(meta), metaNodeSize, meta.Length - metaNodeSize))
+        {
+            var builder = new BucketTree.Builder();
+            Assert.Success(builder.Initialize(new ArrayPoolMemoryResource(), in headerStorage, in nodeStorage,
+                in entryStorage, nodeSize, entrySize, entries.Length));
+
+            foreach ((long virtualOffset, long physicalOffset, int storageIndex) in entries)
+            {
+                var entry = new IndirectStorage.Entry { StorageIndex = storageIndex };
+                entry.SetVirtualOffset(virtualOffset);
+                entry.SetPhysicalOffset(physicalOffset);
+
+                Assert.Success(builder.Add(in entry));
+            }
+
+            Assert.Success(builder.Finalize(virtualSize));
+        }
+
+        byte[] nca = new byte[HeaderSize + physicalDataSize + meta.Length];
+
+        Span<byte> header = nca.AsSpan(0, HeaderSize);
+        "NCA3"u8.CopyTo(header.Slice(0x200));
+        header[0x204] = (byte)DistributionType.Download;
+        header[0x205] = (byte)NcaContentType.Program;
+        BinaryPrimitives.WriteInt64LittleEndian(header.Slice(0x208), nca.Length);
+        Aes.EncryptEcb128(contentKey, header.Slice(0x300 + Aes.KeySize128 * 2, Aes.KeySize128),
+            keySet.KeyAreaKeys[0][0].DataRo);
+
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x240), HeaderSize / 0x200);
+        BinaryPrimitives.WriteInt32LittleEndian(header.Slice(0x244), nca.Length / 0x200);
+        header[0x248] = 1;
+
+        var fsHeader = new NcaFsHeader(nca.AsMemory(0x400, 0x200));
+        fsHeader.Version = 2;
+        fsHeader.FormatType = NcaFormatType.Pfs0;
+        fsHeader.HashType = NcaHashType.Sha256;
+        fsHeader.EncryptionType = NcaEncryptionType.AesCtr;
+        fsHeader.Counter = upperCounter;
+
+        NcaFsIntegrityInfoSha256 integrityInfo = fsHeader.GetIntegrityInfoSha256();
+        integrityInfo.BlockSize = HashBlockSize;
+        integrityInfo.LevelCount = 2;
+        integrityInfo.GetLevelOffset(0) = 0;
+        integrityInfo.GetLevelSize(0) = HashLevelSize;
+        integrityInfo.GetLevelOffset(1) = HashLevelSize;
+        integrityInfo.GetLevelSize(1) = sectionData.Length;
+
+        ref NcaSparseInfo sparseInfo = ref fsHeader.GetSparseInfo();
+        sparseInfo.MetaOffset = physicalDataSize;
+        sparseInfo.MetaSize = meta.Length;
+        headerBuffer.CopyTo(sparseInfo.MetaHeader[..]);
+        sparseInfo.PhysicalOffset = HeaderSize;
+        sparseInfo.Generation = 1;
+
+        Sha256.GenerateSha256Hash(nca.AsSpan(0x400, 0x200), header.Slice(0x280, Sha256.DigestSize));
+
+        // Encrypt the section as a whole, then keep only the ranges that aren't removed by the sparse layer
+        byte[] section = new byte[virtualSize];
+        byte[] sectionCounter = Aes128CtrStorage.CreateCounter(upperCounter, HeaderSize);
+        using (var sectionStorage = new Aes128CtrStorage(new MemoryStorage(section), contentKey, HeaderSize,
+                   sectionCounter, false))
+        {
+            byte[] plainSection = new byte[virtualSize];
+            sectionData.CopyTo(plainSection.AsSpan(HashLevelSize));
+            Assert.Success(sectionStorage.Write(0, plainSection));
+        }
+
+        section.AsSpan(0, removedStart).CopyTo(nca.AsSpan(HeaderSize));
+        section.AsSpan(removedEnd).CopyTo(nca.AsSpan(HeaderSize + removedStart));
+
+        ulong metaUpperCounter = sparseInfo.MakeAesCtrUpperIv(new NcaAesCtrUpperIv(upperCounter)).Value;
+        byte[] metaCounter = Aes128CtrStorage.CreateCounter(metaUpperCounter, HeaderSize);
+        byte[] encryptedMeta = new byte[meta.Length];
+        using (var metaStorage = new Aes128CtrStorage(new MemoryStorage(encryptedMeta), contentKey,
+                   HeaderSize + physicalDataSize, metaCounter, false))
+        {
+            Assert.Success(metaStorage.Write(0, meta));
+        }
+
+        encryptedMeta.CopyTo(nca.AsSpan(HeaderSize + physicalDataSize));
+
+        var headerTransform = new Aes128XtsTransform(keySet.HeaderKey.SubKeys[0].DataRo.ToArray(),
+            keySet.HeaderKey.SubKeys[1].DataRo.ToArray(), false);
+
+        for (int sector = 0; sector < HeaderSize / 0x200; sector++)
+        {
+            headerTransform.TransformBlock(nca, sector * 0x200, 0x200, (ulong)sector);
+        }
+
+        return nca;
+    }
+
+    [Fact]
+    public void OpenStorage_WithReadThreadPool_LargeReadIsSplitAcrossThreads()
+    {
+        byte[] sectionData = new byte[0x200000];
+        new Random(1234).NextBytes(sectionData);
+
+        var baseStorage = new ThreadRecordingStorage(CreatePlaintextNca(sectionData));
+        using var threadPool = new WorkerThreadPool(3, 0x40000);
+
+        var nca = new Nca(new KeySet(), baseStorage) { ReadThreadPool = threadPool };
+        using IStorage storage = nca.OpenStorage(0, IntegrityCheckLevel.None);
+
+        byte[] buffer = new byte[0x100000];
+        baseStorage.ReadingThreads.Clear();
+        baseStorage.WaitForSecondThread = true;
+        Assert.Success(storage.Read(0x20000, buffer));
+
+        Assert.True(sectionData.AsSpan(0x20000, buffer.Length).SequenceEqual(buffer));
+        Assert.True(baseStorage.ReadingThreads.Count > 1);
+    }
+
+    [Fact]
+    public void OpenStorage_NoReadThreadPool_ReadsOnCallingThread()
+    {
+        byte[] sectionData = new byte[0x200000];
+        new Random(1234).NextBytes(sectionData);
+
+        var baseStorage = new ThreadRecordingStorage(CreatePlaintextNca(sectionData));
+
+        var nca = new Nca(new KeySet(), baseStorage);
+        using IStorage storage = nca.OpenStorage(0, IntegrityCheckLevel.None);
+
+        byte[] buffer = new byte[0x100000];
+        baseStorage.ReadingThreads.Clear();
+        Assert.Success(storage.Read(0x20000, buffer));
+
+        Assert.True(sectionData.AsSpan(0x20000, buffer.Length).SequenceEqual(buffer));
+        Assert.Equal([Environment.CurrentManagedThreadId], baseStorage.ReadingThreads.Keys);
+    }
+
+    [Fact]
+    public void VerifySection_WithReadThreadPool_ValidSectionIsValid()
+    {
+        byte[] sectionData = new byte[0x20000];
+        new Random(1234).NextBytes(sectionData);
+
+        using var threadPool = new WorkerThreadPool(3, 0x40000);
+
+        var nca = new Nca(new KeySet(), new MemoryStorage(CreateVerifiablePlaintextNca(sectionData)))
+        {
+            ReadThreadPool = threadPool
+        };
+
+        Assert.Equal(Validity.Valid, nca.VerifySection(0));
+    }
+
+    [Fact]
+    public void VerifySection_WithReadThreadPool_CorruptSectionIsInvalid()
+    {
+        byte[] sectionData = new byte[0x20000];
+        new Random(1234).NextBytes(sectionData);
+
+        byte[] ncaData = CreateVerifiablePlaintextNca(sectionData);
+        ncaData[HeaderSize + HashLevelSize + 0x14000] ^= 0xFF;
+
+        using var threadPool = new WorkerThreadPool(3, 0x40000);
+
+        var nca = new Nca(new KeySet(), new MemoryStorage(ncaData)) { ReadThreadPool = threadPool };
+
+        Assert.Equal(Validity.Invalid, nca.VerifySection(0));
+    }
+
+    [Fact]
+    public void VerifySection_SingleThreadCorruptSection_StopsAtFirstInvalidDataBlock()
+    {
+        byte[] sectionData = new byte[0x20000];
+        new Random(1234).NextBytes(sectionData);
+
+        byte[] ncaData = CreateVerifiablePlaintextNca(sectionData);
+        ncaData[HeaderSize + HashLevelSize + 0x14000] ^= 0xFF;
+
+        var nca = new Nca(new KeySet(), new MemoryStorage(ncaData));
+        var progress = new ProgressRecorder();
+
+        Assert.Equal(Validity.Invalid, nca.VerifySection(0, progress, quiet: true));
+
+        // Only the data level's blocks are counted, and the blocks after the corrupt one aren't checked
+        Assert.Equal(sectionData.Length / HashBlockSize, progress.Total);
+        Assert.Equal(0x14000 / HashBlockSize, progress.Progress);
+    }
+
+    [Fact]
+    public void GetSparseZeroRanges_EncryptedSparseSection_RangesAreRelativeToOpenedStorage()
+    {
+        byte[] sectionData = new byte[0x10000];
+        new Random(1234).NextBytes(sectionData);
+
+        var keySet = new KeySet();
+        var nca = new Nca(keySet, new MemoryStorage(CreateEncryptedSparseNca(keySet, sectionData, 0x4000, 0x8000)));
+
+        var ranges = new List<(long Offset, long Size)>();
+        nca.GetSparseZeroRanges(0, false, ranges);
+        Assert.Equal(new List<(long, long)> { (0x4000, 0x8000) }, ranges);
+
+        var rawRanges = new List<(long Offset, long Size)>();
+        nca.GetSparseZeroRanges(0, true, rawRanges);
+        Assert.Equal(new List<(long, long)> { (HashLevelSize + 0x4000, 0x8000) }, rawRanges);
+    }
+
+    [Fact]
+    public void OpenStorage_NodeCacheIsSet_SparseTableLookupsUseCache()
+    {
+        byte[] sectionData = new byte[0x10000];
+        new Random(1234).NextBytes(sectionData);
+
+        var keySet = new KeySet();
+        var cache = new BucketTreeNodeCache(BucketTreeNodeCache.DefaultCapacity);
+
+        var nca = new Nca(keySet, new MemoryStorage(CreateEncryptedSparseNca(keySet, sectionData, 0x4000, 0x8000)))
+        {
+            NodeCache = cache
+        };
+
+        using IStorage storage = nca.OpenStorage(0, IntegrityCheckLevel.None);
+
+        byte[] buffer = new byte[0x1000];
+        Assert.Success(storage.Read(0xC000, buffer));
+        Assert.True(sectionData.AsSpan(0xC000, buffer.Length).SequenceEqual(buffer));
+
+        long missCount = cache.MissCount;
+        Assert.NotEqual(0, missCount);
+
+        // Read a block the storages above the sparse layer haven't cached yet
+        Assert.Success(storage.Read(0, buffer));
+        Assert.True(sectionData.AsSpan(0, buffer.Length).SequenceEqual(buffer));
+
+        Assert.Equal(missCount, cache.MissCount);
+        Assert.NotEqual(0, cache.HitCount);
+    }
+
+    [Fact]
+    public void CopyToStreamSparse_EncryptedSparseSectionWithZeroRanges_RemovedRangeIsLeftAsHole()
+    {
+        byte[] sectionData = new byte[0x10000];
+        new Random(1234).NextBytes(sectionData);
+
+        var keySet = new KeySet();
+        var nca = new Nca(keySet, new MemoryStorage(CreateEncryptedSparseNca(keySet, sectionData, 0x4000, 0x8000)));
+        using IStorage storage = nca.OpenStorage(0, IntegrityCheckLevel.None);
+
+        // The sparse layer is beneath the decryption and verification layers, so the removed range
+        // is read as the decryption of zeros
+        Assert.False(storage is SparseStorage);
+        byte[] removedData = new byte[0x8000];
+        Assert.Success(storage.Read(0x4000, removedData));
+        Assert.False(removedData.IsZeros());
+
+        var zeroRanges = new List<(long Offset, long Size)>();
+        nca.GetSparseZeroRanges(0, false, zeroRanges);
+
+        using var output = new MemoryStream();
+        long skipped = storage.CopyToStreamSparse(output, sectionData.Length, zeroRanges, bufferSize: 0x3000);
+
+        byte[] expected = (byte[])sectionData.Clone();
+        expected.AsSpan(0x4000, 0x8000).Clear();
+
+        Assert.Equal(expected, output.ToArray());
+        Assert.Equal(0x8000, skipped);
+    }
+}
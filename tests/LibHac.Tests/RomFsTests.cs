@@ -1,5 +1,13 @@
 ﻿using System;
+using System.Collections.Generic;
+using LibHac.Common;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.Tests.Fs;
+using LibHac.Tools.Fs;
+using LibHac.Tools.FsSystem;
 using LibHac.Tools.FsSystem.RomFs;
+using LibHac.Util;
 using Xunit;
 
 namespace LibHac.Tests;
@@ -200,4 +208,237 @@ public class RomFsTests
         Assert.Equal(itemC2, actualItemC2);
         Assert.Equal(itemC3, actualItemC3);
     }
+
+    private static readonly string[] IndexTestFilePaths =
+    {
+        "/file0", "/a/file1", "/a/file2", "/a/b/file3", "/a/b/c/file4", "/a/b2/file5", "/d/file6", "/d/e/f/g/file7",
+        "/d/e/file8", "/é/file9"
+    };
+
+    private static RomFsFileSystem CreateIndexTestFileSystem(bool usePathIndex)
+    {
+        var builder = new RomFsBuilder();
+
+        for (int i = 0; i < IndexTestFilePaths.Length; i++)
+        {
+            builder.AddFile(IndexTestFilePaths[i], new MemoryStorage(new byte[i * 0x10 + 1]).AsFile(OpenMode.Read));
+        }
+
+        return new RomFsFileSystem(builder.Build()) { UsePathIndex = usePathIndex };
+    }
+
+    [Fact]
+    public void PathIndex_ContainsEveryEntry()
+    {
+        RomFsFileSystem fs = CreateIndexTestFileSystem(false);
+        RomFsPathIndex index = fs.GetPathIndex();
+
+        Assert.Equal(IndexTestFilePaths.Length, index.FileCount);
+        Assert.Equal(10, index.DirectoryCount);
+        Assert.Equal("/", StringUtils.Utf8ToString(index.GetPath(0)));
+
+        foreach (DirectoryEntryEx entry in fs.EnumerateEntries())
+        {
+            int entryIndex = index.FindEntry(StringUtils.StringToUtf8(entry.FullPath));
+            Assert.True(entryIndex >= 0, entry.FullPath);
+
+            RomFsIndexEntry indexEntry = index.Entries[entryIndex];
+            Assert.Equal(entry.Type, indexEntry.Type);
+            Assert.Equal(entry.FullPath, StringUtils.Utf8ToString(index.GetPath(in indexEntry)));
+            Assert.Equal(entry.Name, StringUtils.Utf8ToString(index.GetName(in indexEntry)));
+
+            if (entry.Type == DirectoryEntryType.File)
+            {
+                Assert.True(fs.FileTable.TryOpenFile(entry.FullPath, out RomFileInfo info));
+                Assert.Equal(info.Offset, indexEntry.Offset);
+                Assert.Equal(info.Length, indexEntry.Size);
+            }
+        }
+
+        Assert.Equal(-1, index.FindEntry("/a/b/c/file"u8));
+        Assert.Equal(-1, index.FindEntry("/a/"u8));
+    }
+
+    [Fact]
+    public void PathIndex_ChildrenAreContiguousAndPointToTheirParent()
+    {
+        RomFsPathIndex index = CreateIndexTestFileSystem(false).GetPathIndex();
+        ReadOnlySpan<RomFsIndexEntry> entries = index.Entries;
+        int childCountTotal = 0;
+
+        for (int i = 0; i < entries.Length; i++)
+        {
+            if (!entries[i].IsDirectory)
+                continue;
+
+            bool foundFile = false;
+
+            foreach (RomFsIndexEntry child in index.GetChildren(i))
+            {
+                Assert.Equal(i, child.Parent);
+
+                // Directories come before files
+                Assert.False(foundFile && child.IsDirectory);
+                foundFile |= !child.IsDirectory;
+            }
+
+            childCountTotal += entries[i].ChildCount;
+        }
+
+        Assert.Equal(entries.Length - 1, childCountTotal);
+    }
+
+    [Fact]
+    public void UsePathIndex_FileSystemOperationsMatchFileTable()
+    {
+        RomFsFileSystem tableFs = CreateIndexTestFileSystem(false);
+        RomFsFileSystem indexFs = CreateIndexTestFileSystem(true);
+
+        var paths = new List<string> { "/", "/nonexistent", "/a/nonexistent", "/file0/x" };
+
+        foreach (DirectoryEntryEx entry in tableFs.EnumerateEntries())
+            paths.Add(entry.FullPath);
+
+        foreach (string path in paths)
+        {
+            Assert.Equal(tableFs.GetEntryType(out DirectoryEntryType expectedType, path),
+                indexFs.GetEntryType(out DirectoryEntryType actualType, path));
+            Assert.Equal(expectedType, actualType);
+
+            using var expectedFile = new UniqueRef<IFile>();
+            using var actualFile = new UniqueRef<IFile>();
+            Assert.Equal(tableFs.OpenFile(ref expectedFile.Ref, path, OpenMode.Read),
+                indexFs.OpenFile(ref actualFile.Ref, path, OpenMode.Read));
+
+            if (expectedFile.HasValue)
+            {
+                Assert.Success(expectedFile.Get.GetSize(out long expectedSize));
+                Assert.Success(actualFile.Get.GetSize(out long actualSize));
+                Assert.Equal(expectedSize, actualSize);
+            }
+
+            using var expectedDir = new UniqueRef<IDirectory>();
+            using var actualDir = new UniqueRef<IDirectory>();
+            Assert.Equal(tableFs.OpenDirectory(ref expectedDir.Ref, path, OpenDirectoryMode.All),
+                indexFs.OpenDirectory(ref actualDir.Ref, path, OpenDirectoryMode.All));
+
+            if (expectedDir.HasValue)
+            {
+                Assert.Equal(ReadDirectory(expectedDir.Get), ReadDirectory(actualDir.Get));
+
+                Assert.Success(expectedDir.Get.GetEntryCount(out long expectedCount));
+                Assert.Success(actualDir.Get.GetEntryCount(out long actualCount));
+                Assert.Equal(expectedCount, actualCount);
+            }
+        }
+
+        static List<string> ReadDirectory(IDirectory directory)
+        {
+            var entries = new List<string>();
+            var buffer = new DirectoryEntry[3];
+
+            while (true)
+            {
+                Assert.Success(directory.Read(out long entriesRead, buffer));
+                if (entriesRead == 0)
+                    return entries;
+
+                for (int i = 0; i < entriesRead; i++)
+                {
+                    entries.Add($"{StringUtils.Utf8ZToString(buffer[i].Name)} {buffer[i].Type} {buffer[i].Size}");
+                }
+            }
+        }
+    }
+    private static RomFsBuilder CreateIntegrityTestBuilder(out Dictionary<string, byte[]> files)
+    {
+        var random = new Random(4321);
+        byte[] sharedData = new byte[0x5123];
+        random.NextBytes(sharedData);
+
+        files = new Dictionary<string, byte[]>
+        {
+            ["/empty"] = Array.Empty<byte>(),
+            ["/a/large"] = new byte[0x280000 + 0x77],
+            ["/a/shared1"] = sharedData,
+            ["/a/b/sameSize"] = new byte[sharedData.Length],
+            ["/b/shared2"] = sharedData,
+            ["/b/small"] = new byte[0x31]
+        };
+
+        random.NextBytes(files["/a/large"]);
+        random.NextBytes(files["/a/b/sameSize"]);
+        random.NextBytes(files["/b/small"]);
+
+        var builder = new RomFsBuilder();
+
+        foreach (KeyValuePair<string, byte[]> file in files)
+        {
+            builder.AddFile(file.Key, new MemoryStorage(file.Value).AsFile(OpenMode.Read));
+        }
+
+        return builder;
+    }
+
+    private static void AssertFilesMatch(RomFsFileSystem fs, Dictionary<string, byte[]> files)
+    {
+        foreach (KeyValuePair<string, byte[]> file in files)
+        {
+            using var romFsFile = new UniqueRef<IFile>();
+            Assert.Success(fs.OpenFile(ref romFsFile.Ref, file.Key, OpenMode.Read));
+
+            byte[] actual = new byte[file.Value.Length];
+            Assert.Success(romFsFile.Get.Read(out long bytesRead, 0, actual));
+
+            Assert.Equal(file.Value.Length, bytesRead);
+            Assert.Equal(file.Value, actual);
+        }
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void BuildWithIntegrity_DataLevelMatchesBuildAndIsValid(int threadCount)
+    {
+        RomFsBuilder builder = CreateIntegrityTestBuilder(out Dictionary<string, byte[]> files);
+        byte[] expected = builder.Build().ToArray();
+
+        var destination = new MemoryStorage(new byte[builder.GetSize()]);
+        HierarchicalIntegrityImage image = builder.BuildWithIntegrity(destination, false, threadCount);
+
+        Assert.Equal(expected, image.DataStorage.ToArray());
+
+        using HierarchicalIntegrityVerificationStorage storage =
+            image.OpenVerificationStorage(IntegrityCheckLevel.ErrorOnInvalid);
+
+        Assert.Equal(Validity.Valid, storage.Validate(true));
+        AssertFilesMatch(new RomFsFileSystem(storage), files);
+    }
+
+    [Fact]
+    public void BuildWithIntegrity_Deduplicate_IdenticalFilesShareData()
+    {
+        RomFsBuilder builder = CreateIntegrityTestBuilder(out Dictionary<string, byte[]> files);
+
+        var destination = new MemoryStorage(new byte[builder.GetSize()]);
+        HierarchicalIntegrityImage image = builder.BuildWithIntegrity(destination, true, 4);
+
+        Assert.Success(image.DataStorage.GetSize(out long dataSize));
+        Assert.Equal(builder.GetSize() - Alignment.AlignUp(files["/b/shared2"].Length, 0x10), dataSize);
+
+        using HierarchicalIntegrityVerificationStorage storage =
+            image.OpenVerificationStorage(IntegrityCheckLevel.ErrorOnInvalid);
+
+        Assert.Equal(Validity.Valid, storage.Validate(true));
+
+        var fs = new RomFsFileSystem(storage);
+        AssertFilesMatch(fs, files);
+
+        Assert.True(fs.FileTable.TryOpenFile("/a/shared1", out RomFileInfo shared1));
+        Assert.True(fs.FileTable.TryOpenFile("/b/shared2", out RomFileInfo shared2));
+        Assert.True(fs.FileTable.TryOpenFile("/a/b/sameSize", out RomFileInfo sameSize));
+
+        Assert.Equal(shared1.Offset, shared2.Offset);
+        Assert.NotEqual(shared1.Offset, sameSize.Offset);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using LibHac.Common;
+using LibHac.Common.Keys;
+using LibHac.Fs;
+using LibHac.Fs.Fsa;
+using LibHac.FsSystem;
+using LibHac.Tests.Fs;
+using LibHac.Tools.Fs;
+using LibHac.Tools.FsSystem.NcaUtils;
+using Xunit;
+
+namespace LibHac.Tests;
+
+public class SwitchFsTests
+{
+    private static byte[] CreatePlaintextNcaHeader(NcaContentType contentType)
+    {
+        byte[] header = new byte[0xC00];
+        "NCA3"u8.CopyTo(header.AsSpan(0x200));
+        header[0x204] = (byte)DistributionType.Download;
+        header[0x205] = (byte)contentType;
+
+        return header;
+    }
+
+    private static string GetNcaName(int index) => $"{index:x32}";
+
+    private class TimeStampFileSystem : InMemoryFileSystem
+    {
+        public readonly Dictionary<string, long> ModifiedTimes = new();
+
+        protected override Result DoGetFileTimeStampRaw(out FileTimeStampRaw timeStamp,
+            ref readonly LibHac.Fs.Path path)
+        {
+            timeStamp = default;
+            ModifiedTimes.TryGetValue(path.ToString(), out timeStamp.Modified);
+
+            return Result.Success;
+        }
+    }
+
+    private static void WriteFile(IFileSystem fs, string path, byte[] data)
+    {
+        using var file = new UniqueRef<IFile>();
+        Assert.Success(fs.OpenFile(ref file.Ref, path, OpenMode.Write));
+        Assert.Success(file.Get.Write(0, data, WriteOption.None));
+    }
+
+    [Fact]
+    public void OpenNcaDirectory_MultipleThreads_OpensAllNcas()
+    {
+        const int ncaCount = 40;
+        var fs = new InMemoryFileSystem();
+
+        for (int i = 0; i < ncaCount; i++)
+        {
+            string directory = $"/{i % 4:D2}";
+            fs.CreateDirectory(directory);
+
+            string path = $"{directory}/{GetNcaName(i)}.nca";
+            fs.CreateFile(path, 0xC00);
+
+            using var file = new UniqueRef<IFile>();
+            fs.OpenFile(ref file.Ref, path, OpenMode.Write);
+            Assert.Success(file.Get.Write(0, CreatePlaintextNcaHeader(NcaContentType.Program), WriteOption.None));
+        }
+
+        using var switchFs = SwitchFs.OpenNcaDirectory(new KeySet(), fs, threadCount: 4);
+
+        Assert.Equal(ncaCount, switchFs.Ncas.Count);
+
+        for (int i = 0; i < ncaCount; i++)
+        {
+            SwitchFsNca nca = switchFs.Ncas[GetNcaName(i)];
+            Assert.Equal(NcaContentType.Program, nca.Nca.Header.ContentType);
+            Assert.Equal(GetNcaName(i) + ".nca", nca.Filename);
+        }
+    }
+
+    [Fact]
+    public void OpenNcaDirectory_WithMetadataCache_UnchangedNcasAreReadFromCache()
+    {
+        string rootPath = Directory.CreateTempSubdirectory("LibHac.Tests.").FullName;
+
+        try
+        {
+            const int ncaCount = 3;
+            var modifiedTime = new DateTime(2020, 1, 1, 0, 0, 0, DateTimeKind.Utc);
+
+            for (int i = 0; i < ncaCount; i++)
+            {
+                string path = System.IO.Path.Combine(rootPath, GetNcaName(i) + ".nca");
+                File.WriteAllBytes(path, CreatePlaintextNcaHeader(NcaContentType.Program));
+                File.SetLastWriteTimeUtc(path, modifiedTime);
+            }
+
+            var cache = new SwitchFsMetadataCache();
+
+            using (var switchFs = SwitchFs.OpenNcaDirectory(new KeySet(), new LocalFileSystem(rootPath), 2, cache))
+            {
+                Assert.Equal(ncaCount, switchFs.Ncas.Count);
+            }
+
+            Assert.Equal(ncaCount, cache.Count);
+            Assert.Equal(0, cache.HitCount);
+            Assert.Equal(ncaCount, cache.MissCount);
+            Assert.True(cache.IsModified);
+
+            // Round trip the cache
+            var stream = new MemoryStream();
+            cache.Write(stream);
+            stream.Position = 0;
+
+            var loadedCache = new SwitchFsMetadataCache();
+            loadedCache.Read(stream);
+            Assert.Equal(ncaCount, loadedCache.Count);
+            Assert.False(loadedCache.IsModified);
+
+            // Change an NCA without changing its size or modification time. The stale header should come from the cache.
+            string changedPath = System.IO.Path.Combine(rootPath, GetNcaName(1) + ".nca");
+            File.WriteAllBytes(changedPath, CreatePlaintextNcaHeader(NcaContentType.Control));
+            File.SetLastWriteTimeUtc(changedPath, modifiedTime);
+
+            using (var switchFs = SwitchFs.OpenNcaDirectory(new KeySet(), new LocalFileSystem(rootPath), 2, loadedCache))
+            {
+                Assert.Equal(NcaContentType.Program, switchFs.Ncas[GetNcaName(1)].Nca.Header.ContentType);
+            }
+
+            Assert.Equal(ncaCount, loadedCache.HitCount);
+            Assert.False(loadedCache.IsModified);
+
+            // A new modification time should cause the NCA to be read again.
+            File.SetLastWriteTimeUtc(changedPath, modifiedTime.AddHours(1));
+
+            using (var switchFs = SwitchFs.OpenNcaDirectory(new KeySet(), new LocalFileSystem(rootPath), 2, loadedCache))
+            {
+                Assert.Equal(NcaContentType.Control, switchFs.Ncas[GetNcaName(1)].Nca.Header.ContentType);
+                Assert.Equal(NcaContentType.Program, switchFs.Ncas[GetNcaName(0)].Nca.Header.ContentType);
+            }
+
+            Assert.Equal(ncaCount * 2 - 1, loadedCache.HitCount);
+            Assert.Equal(1, loadedCache.MissCount);
+            Assert.True(loadedCache.IsModified);
+            Assert.Equal(ncaCount, loadedCache.Count);
+        }
+        finally
+        {
+            Directory.Delete(rootPath, true);
+        }
+    }
+
+    [Fact]
+    public void OpenNandPartition_WithMetadataCache_ChangedInternalFileOfSplitNcaIsReadAgain()
+    {
+        string ncaPath = $"/Contents/{GetNcaName(0)}.nca";
+        string internalFilePath = ncaPath + "/00";
+
+        var fs = new TimeStampFileSystem();
+        Assert.Success(fs.CreateDirectory("/Contents"));
+        Assert.Success(fs.CreateDirectory(ncaPath, NxFileAttributes.Archive));
+        Assert.Success(fs.CreateFile(internalFilePath, 0xC00));
+        WriteFile(fs, internalFilePath, CreatePlaintextNcaHeader(NcaContentType.Program));
+
+        fs.ModifiedTimes[ncaPath] = 100;
+        fs.ModifiedTimes[internalFilePath] = 100;
+
+        var cache = new SwitchFsMetadataCache();
+
+        for (int i = 0; i < 2; i++)
+        {
+            using var baseFs = new UniqueRef<IAttributeFileSystem>(fs);
+            using var switchFs = SwitchFs.OpenNandPartition(new KeySet(), ref baseFs.Ref, 1, cache);
+            Assert.Equal(NcaContentType.Program, switchFs.Ncas[GetNcaName(0)].Nca.Header.ContentType);
+        }
+
+        Assert.Equal(1, cache.HitCount);
+
+        // Rewriting an internal file doesn't change the time stamp of the split NCA's directory
+        WriteFile(fs, internalFilePath, CreatePlaintextNcaHeader(NcaContentType.Control));
+        fs.ModifiedTimes[internalFilePath] = 200;
+
+        using (var baseFs = new UniqueRef<IAttributeFileSystem>(fs))
+        using (var switchFs = SwitchFs.OpenNandPartition(new KeySet(), ref baseFs.Ref, 1, cache))
+        {
+            Assert.Equal(NcaContentType.Control, switchFs.Ncas[GetNcaName(0)].Nca.Header.ContentType);
+        }
+
+        Assert.Equal(1, cache.HitCount);
+        Assert.Equal(2, cache.MissCount);
+    }
+
+    [Fact]
+    public void NcaHeaderFromDecryptedHeader_ArrayIsModified_HeaderIsUnchanged()
+    {
+        byte[] headerData = CreatePlaintextNcaHeader(NcaContentType.Program);
+        var header = new LibHac.Tools.FsSystem.NcaUtils.NcaHeader(headerData, isEncrypted: false);
+
+        headerData[0x205] = (byte)NcaContentType.Control;
+
+        Assert.Equal(NcaContentType.Program, header.ContentType);
+    }
+
+    [Fact]
+    public void MetadataCacheRead_InvalidData_ThrowsInvalidDataException()
+    {
+        var cache = new SwitchFsMetadataCache();
+        var stream = new MemoryStream(new byte[0x10]);
+
+        Assert.Throws<InvalidDataException>(() => cache.Read(stream));
+    }
+}
@@ -0,0 +1,154 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using LibHac.Util;
+using Xunit;
+
+namespace LibHac.Tests.Util;
+
+public class Lz4Tests
+{
+    /// <summary>
+    /// Creates an LZ4 block made of random sequences. Matches use a mix of short overlapping offsets
+    /// and longer offsets, and both literals and matches sometimes use extended lengths.
+    /// </summary>
+    public static byte[] CreateCompressedBlock(ulong seed, int decompressedSize, out byte[] decompressed)
+    {
+        var random = new Random(seed);
+        var compressed = new List<byte>();
+        decompressed = new byte[decompressedSize];
+
+        int position = 0;
+
+        while (position < decompressedSize)
+        {
+            int remaining = decompressedSize - position;
+
+            int literalLength = random.Next(0, 4) == 0 ? random.Next(15, 600) : random.Next(0, 15);
+            if (position == 0)
+                literalLength = Math.Max(literalLength, 1);
+
+            // Finish the block with a literal-only sequence
+            bool isLastSequence = remaining - literalLength < 12;
+            if (isLastSequence)
+                literalLength = remaining;
+
+            int matchLength = random.Next(0, 4) == 0 ? random.Next(19, 1000) : random.Next(4, 19);
+            matchLength = Math.Min(matchLength, remaining - literalLength - 5);
+
+            int token = Math.Min(literalLength, 0xF) << 4 | (isLastSequence ? 0 : Math.Min(matchLength - 4, 0xF));
+            compressed.Add((byte)token);
+            WriteExtendedLength(compressed, literalLength);
+
+            // Use a low range of byte values so the literals look a bit like real data
+            for (int i = 0; i < literalLength; i++)
+            {
+                byte value = (byte)random.Next(0, 8);
+                decompressed[position++] = value;
+                compressed.Add(value);
+            }
+
+            if (isLastSequence)
+                break;
+
+            int matchOffset = random.Next(0, 4) switch
+            {
+                0 => random.Next(1, 8),
+                1 => random.Next(8, 16),
+                2 => random.Next(16, 64),
+                _ => random.Next(1, 0x10000)
+            };
+
+            matchOffset = Math.Min(matchOffset, position);
+
+            compressed.Add(unchecked((byte)matchOffset));
+            compressed.Add((byte)(matchOffset >> 8));
+            WriteExtendedLength(compressed, matchLength - 4);
+
+            for (int i = 0; i < matchLength; i++)
+            {
+                decompressed[position] = decompressed[position - matchOffset];
+                position++;
+            }
+        }
+
+        return compressed.ToArray();
+
+        static void WriteExtendedLength(List<byte> output, int length)
+        {
+            if (length < 0xF)
+                return;
+
+            length -= 0xF;
+
+            while (length >= 0xFF)
+            {
+                output.Add(0xFF);
+                length -= 0xFF;
+            }
+
+            output.Add((byte)length);
+        }
+    }
+
+    [Theory]
+    [InlineData(1, 0x10)]
+    [InlineData(2, 0x1000)]
+    [InlineData(3, 0x10000)]
+    [InlineData(4, 0x12345)]
+    [InlineData(5, 0x100000)]
+    public void Decompress_RandomSequences_MatchesExpectedData(ulong seed, int size)
+    {
+        byte[] compressed = CreateCompressedBlock(seed, size, out byte[] expected);
+        byte[] actual = new byte[size];
+
+        int bytesWritten = Lz4.Decompress(compressed, actual.AsSpan());
+
+        Assert.Equal(size, bytesWritten);
+        Assert.Equal(expected, actual);
+    }
+
+    [Fact]
+    public void Decompress_LargerDestination_DoesNotWritePastEndOfBlockByMuch()
+    {
+        const int size = 0x10000;
+        byte[] compressed = CreateCompressedBlock(6, size, out byte[] expected);
+
+        byte[] actual = new byte[size + 0x100];
+        actual.AsSpan().Fill(0xCC);
+
+        Assert.True(Lz4.TryDecompress(compressed, actual, out int bytesWritten));
+
+        Assert.Equal(size, bytesWritten);
+        Assert.Equal(expected, actual.AsSpan(0, size).ToArray());
+        Assert.True(actual.AsSpan(size + 0x10).IndexOfAnyExcept((byte)0xCC) < 0);
+    }
+
+    [Fact]
+    public void Decompress_ArrayOverload_MatchesExpectedData()
+    {
+        byte[] compressed = CreateCompressedBlock(7, 0x8000, out byte[] expected);
+
+        Assert.Equal(expected, Lz4.Decompress(compressed, expected.Length));
+    }
+
+    [Fact]
+    public void TryDecompress_DestinationTooSmall_ReturnsFalse()
+    {
+        byte[] compressed = CreateCompressedBlock(8, 0x8000, out _);
+
+        Assert.False(Lz4.TryDecompress(compressed, new byte[0x7FFF], out _));
+    }
+
+    [Theory]
+    [InlineData(new byte[] { 0x10, 0xAA, 0x00, 0x00 })] // Match offset of 0
+    [InlineData(new byte[] { 0x10, 0xAA, 0x02, 0x00 })] // Match offset before the start of the output
+    [InlineData(new byte[] { 0x10, 0xAA, 0x01 })] // Truncated match offset
+    [InlineData(new byte[] { 0x50, 0xAA, 0xAA })] // Truncated literals
+    [InlineData(new byte[] { 0xF0, 0xFF })] // Truncated literal length
+    public void TryDecompress_InvalidData_ReturnsFalse(byte[] compressed)
+    {
+        Assert.False(Lz4.TryDecompress(compressed, new byte[0x100], out _));
+        Assert.Throws<InvalidDataException>(() => Lz4.Decompress(compressed, new byte[0x100].AsSpan()));
+    }
+}
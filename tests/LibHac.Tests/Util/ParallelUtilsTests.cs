@@ -0,0 +1,70 @@
+﻿using System;
+using System.Threading;
+using System.Threading.Tasks;
+using LibHac.Util;
+using Xunit;
+
+namespace LibHac.Tests.Util;
+
+public class ParallelUtilsTests
+{
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void For_AllIndexesAreRunOnce(int threadCount)
+    {
+        int[] counts = new int[100];
+
+        ParallelUtils.For(counts.Length, threadCount, i => Interlocked.Increment(ref counts[i]));
+
+        foreach (int count in counts)
+        {
+            Assert.Equal(1, count);
+        }
+    }
+
+    [Theory]
+    [InlineData(1)]
+    [InlineData(4)]
+    public void For_SingleIndexThrows_OriginalExceptionIsThrown(int threadCount)
+    {
+        Assert.Throws<InvalidOperationException>(() => ParallelUtils.For(100, threadCount, i =>
+        {
+            if (i == 37)
+                throw new InvalidOperationException();
+        }));
+    }
+
+    [Fact]
+    public void WaitAll_FirstTaskFails_WaitsForRemainingTasksBeforeThrowing()
+    {
+        var gate = new TaskCompletionSource();
+        bool isSecondTaskComplete = false;
+
+        Task failedTask = Task.Run(() => throw new InvalidOperationException());
+        Task gatedTask = Task.Run(async () =>
+        {
+            await gate.Task;
+            Volatile.Write(ref isSecondTaskComplete, true);
+        });
+
+        Task.Run(async () =>
+        {
+            await Task.Delay(50);
+            gate.SetResult();
+        });
+
+        Assert.Throws<InvalidOperationException>(() => ParallelUtils.WaitAll([failedTask, null, gatedTask]));
+        Assert.True(Volatile.Read(ref isSecondTaskComplete));
+    }
+
+    [Fact]
+    public void WaitAll_MultipleTasksFail_ThrowsAggregateException()
+    {
+        Task first = Task.Run(() => throw new InvalidOperationException());
+        Task second = Task.Run(() => throw new ArgumentException());
+
+        AggregateException ex = Assert.Throws<AggregateException>(() => ParallelUtils.WaitAll([first, second]));
+        Assert.Equal(2, ex.InnerExceptions.Count);
+    }
+}